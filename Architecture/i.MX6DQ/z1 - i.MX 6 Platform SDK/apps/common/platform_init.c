@@ -33,6 +33,7 @@
 #include "platform_init.h"
 #include "core/cortex_a9.h"
 #include "core/mmu.h"
+#include "utility/work_queue.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Code
@@ -44,7 +45,18 @@ void platform_init(void)
     disable_strict_align_check();
     mmu_init();
 
-    // Map some SDRAM for DMA
+    // The fixed address frame and video buffers are mapped non-cacheable. It is normal
+    // memory, so CPU writes to it are still merged in the write buffer. Descriptors and
+    // data buffers allocated through core/dma_alloc.h handle their own cache attributes.
+#if defined(CHIP_MX6DQ) || defined(CHIP_MX6SDL)
+    mmu_map_l1_range(DMA_FIXED_BUFFERS_START, DMA_FIXED_BUFFERS_START,
+                     DMA_FIXED_BUFFERS_END - DMA_FIXED_BUFFERS_START + 1,
+                     kNoncacheable, kShareable, kRWAccess);
+#endif
+
+    // Map some SDRAM for DMA. Drivers and tests not converted to core/dma_alloc.h still
+    // hand the hardware buffers at fixed addresses in this range without any cache
+    // maintenance, so it has to stay non-cacheable until they are.
 #if defined(BOARD_EVB)
     mmu_map_l1_range(0x30000000, 0x30000000, 0x70000000, kNoncacheable, kShareable, kRWAccess);
 #elif defined(BOARD_SMART_DEVICE)
@@ -60,6 +72,9 @@ void platform_init(void)
     
     // Configure the EPIT timer used for system delay function. 
     system_time_init();
+
+    // Run deferred work queued by interrupt handlers on this core.
+    work_queue_init_cpu();
     
     // Initialize the debug/console UART 
     uart_init(g_debug_uart_port, 115200, PARITY_NONE, STOPBITS_ONE, EIGHTBITS, FLOWCTRL_OFF);
@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file main.c
+ * @brief Compares memory copy, fill and compare throughput of the C library, the NEON
+ *      routines of utility/fast_string.h and the DMA engines.
+ *
+ * Each operation is timed for sizes from 64 bytes to 4MB, once with the buffers already in
+ * the caches and once with buffers that were not touched recently. DMA requests are queued one
+ * at a time and waited for, so their results include the submission and completion overhead
+ * a caller replacing a memcpy() would see.
+ */
+
+#include <string.h>
+#include "sdk.h"
+#include "platform_init.h"
+#include "print_version.h"
+#include "core/cortex_a9.h"
+#include "core/mmu.h"
+#include "core/pl310.h"
+#include "dmaengine/dmaengine.h"
+#include "timer/timer.h"
+#include "utility/fast_string.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Largest size measured.
+#define BENCH_MAX_SIZE (4 * 1024 * 1024)
+
+//! @brief Size of the source and of the destination region.
+//!
+//! Cold measurements walk through the regions, which are much larger than the L2, so every
+//! iteration uses lines that were evicted since their last use.
+#define BENCH_REGION_SIZE (2 * BENCH_MAX_SIZE)
+
+//! @brief Alignment of the buffers and of the steps of the walk.
+#define BENCH_ALIGNMENT (64)
+
+//! @brief Bytes processed for each measurement, within the iteration limits below.
+#define BENCH_BYTES_PER_POINT (16 * 1024 * 1024)
+
+//! @name Iteration limits
+//@{
+#define BENCH_MIN_ITERATIONS (4)
+#define BENCH_MAX_ITERATIONS (4096)
+//@}
+
+//! @brief Time allowed for a single DMA request, in microseconds.
+#define BENCH_DMA_TIMEOUT_US (1000000)
+
+//! @brief Byte value written by the fill methods.
+#define BENCH_FILL_VALUE (0x5a)
+
+//! @brief One way of doing an operation.
+typedef struct _bench_method {
+    const char * name;              //!< Column title.
+    bool (*run)(uint8_t * dst, const uint8_t * src, uint32_t length);   //!< Does one operation.
+    dma_channel_t ** channel;       //!< DMA channel the method needs, or NULL for the CPU.
+} bench_method_t;
+
+//! @brief The methods compared for one operation.
+typedef struct _bench_operation {
+    const char * name;              //!< Name of the operation.
+    const bench_method_t * methods; //!< Methods to compare.
+    uint32_t methodCount;           //!< Number of entries in @a methods.
+} bench_operation_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+static bool run_memcpy(uint8_t * dst, const uint8_t * src, uint32_t length);
+static bool run_fast_memcpy(uint8_t * dst, const uint8_t * src, uint32_t length);
+static bool run_sdma_memcpy(uint8_t * dst, const uint8_t * src, uint32_t length);
+static bool run_dcp_memcpy(uint8_t * dst, const uint8_t * src, uint32_t length);
+static bool run_memset(uint8_t * dst, const uint8_t * src, uint32_t length);
+static bool run_fast_memset(uint8_t * dst, const uint8_t * src, uint32_t length);
+static bool run_sdma_memset(uint8_t * dst, const uint8_t * src, uint32_t length);
+static bool run_dcp_memset(uint8_t * dst, const uint8_t * src, uint32_t length);
+static bool run_memcmp(uint8_t * dst, const uint8_t * src, uint32_t length);
+static bool run_fast_memcmp(uint8_t * dst, const uint8_t * src, uint32_t length);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static dma_channel_t * s_sdmaChannel;
+static dma_channel_t * s_dcpChannel;
+
+static uint8_t * s_src;
+static uint8_t * s_dst;
+
+//! @brief Keeps the compare results alive.
+static volatile int s_sink;
+
+static const uint32_t s_sizes[] = {
+    64, 256, 1024, 4096, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024, BENCH_MAX_SIZE
+};
+
+static const bench_method_t s_copyMethods[] = {
+    { "newlib", run_memcpy, NULL },
+    { "neon", run_fast_memcpy, NULL },
+    { "sdma", run_sdma_memcpy, &s_sdmaChannel },
+    { "dcp", run_dcp_memcpy, &s_dcpChannel }
+};
+
+static const bench_method_t s_fillMethods[] = {
+    { "newlib", run_memset, NULL },
+    { "neon", run_fast_memset, NULL },
+    { "sdma", run_sdma_memset, &s_sdmaChannel },
+    { "dcp", run_dcp_memset, &s_dcpChannel }
+};
+
+static const bench_method_t s_compareMethods[] = {
+    { "newlib", run_memcmp, NULL },
+    { "neon", run_fast_memcmp, NULL }
+};
+
+static const bench_operation_t s_operations[] = {
+    { "memcpy", s_copyMethods, ARRAY_SIZE(s_copyMethods) },
+    { "memset", s_fillMethods, ARRAY_SIZE(s_fillMethods) },
+    { "memcmp", s_compareMethods, ARRAY_SIZE(s_compareMethods) }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Wait for a request that was just queued on a channel.
+static bool dma_wait(dma_channel_t * channel, dma_cookie_t cookie)
+{
+    dma_fence_t fence = { channel, cookie };
+
+    return cookie >= 0 && dma_fence_wait(&fence, BENCH_DMA_TIMEOUT_US);
+}
+
+static bool dma_copy(dma_channel_t * channel, uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    dma_sg_entry_t entry = { dst, src, length };
+
+    return dma_wait(channel, dma_submit_sg(channel, &entry, 1, NULL, NULL));
+}
+
+static bool run_memcpy(uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    memcpy(dst, src, length);
+    return true;
+}
+
+static bool run_fast_memcpy(uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    fast_memcpy(dst, src, length);
+    return true;
+}
+
+static bool run_sdma_memcpy(uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    return dma_copy(s_sdmaChannel, dst, src, length);
+}
+
+static bool run_dcp_memcpy(uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    return dma_copy(s_dcpChannel, dst, src, length);
+}
+
+static bool run_memset(uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    memset(dst, BENCH_FILL_VALUE, length);
+    return true;
+}
+
+static bool run_fast_memset(uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    fast_memset(dst, BENCH_FILL_VALUE, length);
+    return true;
+}
+
+static bool run_sdma_memset(uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    return dma_wait(s_sdmaChannel, dma_submit_memset(s_sdmaChannel, dst, BENCH_FILL_VALUE, length, NULL, NULL));
+}
+
+static bool run_dcp_memset(uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    return dma_wait(s_dcpChannel, dma_submit_memset(s_dcpChannel, dst, BENCH_FILL_VALUE, length, NULL, NULL));
+}
+
+static bool run_memcmp(uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    s_sink += memcmp(dst, src, length);
+    return true;
+}
+
+static bool run_fast_memcmp(uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    s_sink += fast_memcmp(dst, src, length);
+    return true;
+}
+
+//! @brief Write back and discard both cache levels.
+static void evict_caches(void)
+{
+    arm_dcache_flush();
+    pl310_clean_invalidate_ways(pl310_all_ways());
+}
+
+//! @brief Time one method for one size.
+//!
+//! @return Throughput in MB/s, or 0 if the method failed.
+static uint32_t measure(const bench_method_t * method, uint32_t size, bool isCold)
+{
+    uint32_t step = (size + BENCH_ALIGNMENT - 1) & ~(BENCH_ALIGNMENT - 1);
+    uint32_t stepCount = isCold ? BENCH_REGION_SIZE / step : 1;
+    uint32_t iterations = BENCH_BYTES_PER_POINT / size;
+    uint64_t start;
+    uint64_t elapsed;
+    uint32_t i;
+
+    iterations = MIN(MAX(iterations, BENCH_MIN_ITERATIONS), BENCH_MAX_ITERATIONS);
+
+    // An untimed run first, which also loads the buffers for the warm measurement.
+    if (!method->run(s_dst, s_src, size))
+    {
+        return 0;
+    }
+    if (isCold)
+    {
+        evict_caches();
+    }
+
+    start = time_get_microseconds();
+    for (i = 1; i <= iterations; ++i)
+    {
+        uint32_t offset = (i % stepCount) * step;
+
+        if (!method->run(s_dst + offset, s_src + offset, size))
+        {
+            return 0;
+        }
+    }
+    elapsed = time_get_microseconds() - start;
+
+    // Bytes per microsecond are MB/s.
+    return (uint32_t)((uint64_t)size * iterations / (elapsed ? elapsed : 1));
+}
+
+static void run_operation(const bench_operation_t * operation, bool isCold)
+{
+    uint32_t i;
+    uint32_t m;
+
+    printf("\n%s, %s caches, MB/s\n", operation->name, isCold ? "cold" : "warm");
+    printf("%10s", "size");
+    for (m = 0; m < operation->methodCount; ++m)
+    {
+        printf("%10s", operation->methods[m].name);
+    }
+    printf("\n");
+
+    for (i = 0; i < ARRAY_SIZE(s_sizes); ++i)
+    {
+        printf("%10d", s_sizes[i]);
+        for (m = 0; m < operation->methodCount; ++m)
+        {
+            const bench_method_t * method = &operation->methods[m];
+
+            if (method->channel && !*method->channel)
+            {
+                printf("%10s", "-");
+            }
+            else
+            {
+                printf("%10d", measure(method, s_sizes[i], isCold));
+            }
+        }
+        printf("\n");
+    }
+}
+
+void main(void)
+{
+    uint8_t * buffer;
+    uint32_t i;
+
+    platform_init();
+    print_version();
+
+    arm_icache_enable();
+    arm_dcache_invalidate();
+    mmu_enable();
+    arm_dcache_enable();
+    pl310_enable();
+
+    buffer = (uint8_t *)malloc(2 * BENCH_REGION_SIZE + BENCH_ALIGNMENT);
+    if (!buffer)
+    {
+        printf("Not enough memory for the buffers\n");
+        return;
+    }
+    s_src = (uint8_t *)(((uint32_t)buffer + BENCH_ALIGNMENT - 1) & ~(BENCH_ALIGNMENT - 1));
+    s_dst = s_src + BENCH_REGION_SIZE;
+    for (i = 0; i < BENCH_REGION_SIZE; ++i)
+    {
+        s_src[i] = (uint8_t)(i * 7);
+    }
+
+    if (dma_engine_init() == kDmaSuccess)
+    {
+        s_sdmaChannel = dma_request_channel(kDmaEngine_Sdma);
+        s_dcpChannel = dma_request_channel(kDmaEngine_Dcp);
+    }
+    printf("SDMA %savailable, DCP %savailable\n", s_sdmaChannel ? "" : "not ", s_dcpChannel ? "" : "not ");
+
+    for (i = 0; i < ARRAY_SIZE(s_operations); ++i)
+    {
+        // The compares run over equal buffers, so they have to look at every byte.
+        if (s_operations[i].methods == s_compareMethods)
+        {
+            fast_memcpy(s_dst, s_src, BENCH_REGION_SIZE);
+        }
+        run_operation(&s_operations[i], false);
+        run_operation(&s_operations[i], true);
+    }
+
+    printf("\nDone\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -50,10 +50,16 @@ extern int wdog_test(void);
 extern void audio_test(void);
 extern void enet_test(void);
 extern void epit_test(void);
+extern void fast_string_test(void);
 extern void flexcan_test(void);
 extern void gic_test(void);
+extern void pl310_test(void);
+extern void dma_alloc_test(void);
+extern void dmaengine_test(void);
+extern void mmu_test(void);
 extern void gpt_test(void);
 extern void hdmi_test(void);
+extern void hrtimer_test(void);
 extern void i2c_test(void);
 extern void ipu_test(void);
 extern void microseconds_test(void);
@@ -68,6 +74,10 @@ extern void usdhc_test(void);
 extern void keypad_test(void);
 extern void accelerometer_test(void);
 extern void multicore_test(void);
+extern void scheduler_test(void);
+extern void spinlock_test(void);
+extern void smp_malloc_test(void);
+extern void work_queue_test(void);
 extern int cpu_wp_test(void);
 
 #ifdef CHIP_MX6DQ
@@ -119,7 +129,13 @@ const menuitem_t k_menuItems[] = {
         DEFINE_TEST_MENU_ITEM("u",  "uart test",        uart_test),
         DEFINE_TEST_MENU_ITEM("d",  "usdhc test",       usdhc_test),
         DEFINE_TEST_MENU_ITEM("c",  "gic test",         gic_test),
+        DEFINE_TEST_MENU_ITEM("l2", "l2 cache test",    pl310_test),
+        DEFINE_TEST_MENU_ITEM("dm", "dma buffer test",  dma_alloc_test),
+        DEFINE_TEST_MENU_ITEM("de", "dma engine test",  dmaengine_test),
+        DEFINE_TEST_MENU_ITEM("mm", "mmu test",         mmu_test),
         DEFINE_TEST_MENU_ITEM("m",  "microseconds timer test", microseconds_test),
+        DEFINE_TEST_MENU_ITEM("ht", "timer service test", hrtimer_test),
+        DEFINE_TEST_MENU_ITEM("fs", "fast string test", fast_string_test),
         DEFINE_TEST_MENU_ITEM("wa", "watchdog test",    wdog_test),
         DEFINE_TEST_MENU_ITEM("o",  "ocotp test",       ocotp_test),
         DEFINE_TEST_MENU_ITEM("wp", "cpu workpoint test", cpu_wp_test),
@@ -130,6 +146,10 @@ const menuitem_t k_menuItems[] = {
         DEFINE_TEST_MENU_ITEM("h",  "hdmi test",        hdmi_test),
         DEFINE_TEST_MENU_ITEM("ip", "ipu test",         ipu_test),
         DEFINE_TEST_MENU_ITEM("mc", "multicore test",   multicore_test),
+        DEFINE_TEST_MENU_ITEM("sc", "task scheduler test", scheduler_test),
+        DEFINE_TEST_MENU_ITEM("sl", "spinlock test",    spinlock_test),
+        DEFINE_TEST_MENU_ITEM("ma", "malloc test",      smp_malloc_test),
+        DEFINE_TEST_MENU_ITEM("wq", "work queue test",  work_queue_test),
         
 #if defined(CHIP_MX6DQ)
         // The sata test only applies to the mx6dq.
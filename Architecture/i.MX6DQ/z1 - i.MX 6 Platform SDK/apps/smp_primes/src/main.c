@@ -33,6 +33,7 @@
 #include "timer/timer.h"
 #include "cpu_utility/cpu_utility.h"
 #include "core/cortex_a9.h"
+#include "core/pl310.h"
 #include "utility/spinlock.h"
 #include "primes.h"
 
@@ -65,6 +66,12 @@ void configure_cpu(uint32_t cpu)
     arm_icache_enable();
     arm_icache_invalidate();
 
+    // The L2 is shared by all cores, so only the first one sets it up.
+    if (cpu == 0)
+    {
+        pl310_enable();
+    }
+
     // Invalidate SCU copy of TAG RAMs
     scu_secure_invalidate(cpu, all_ways);
 
@@ -93,7 +100,6 @@ void smp_primes(void * arg)
 
         scu_enable();
         configure_cpu(cpu_id);
-        spinlock_init(&prime_lock);
         all_done = (num_cpus == 1) ? 1 : 0;
 
         initPrimes();
@@ -106,15 +112,15 @@ void smp_primes(void * arg)
             cpu_start_secondary(i, &smp_primes, 0);
         }
 
-        spinlock_lock(&prime_lock, kSpinlockWaitForever);
+        ticket_lock_lock(&prime_lock);
         printf("CPU %d: Starting calculation\n", cpu_id);
-        spinlock_unlock(&prime_lock);
+        ticket_lock_unlock(&prime_lock);
 
         calculatePrimes(cpu_id);
 
-        spinlock_lock(&prime_lock, kSpinlockWaitForever);
+        ticket_lock_lock(&prime_lock);
         printf("CPU %d: Finished\n", cpu_id);
-        spinlock_unlock(&prime_lock);
+        ticket_lock_unlock(&prime_lock);
 
         while (!all_done)
         {
@@ -122,6 +128,8 @@ void smp_primes(void * arg)
         }
         done_time = time_get_microseconds();
         printf("Application finished in %d usecs\n", (uint32_t)(done_time - start_time));
+        spinlock_print_stats("prime_lock", SPINLOCK_STATS_OF(&prime_lock));
+        spinlock_print_stats("next_num_lock", SPINLOCK_STATS_OF(&next_num_lock));
 
         // put other cores back into reset
         for (i = 1; i < num_cpus; i++)
@@ -133,15 +141,15 @@ void smp_primes(void * arg)
     {
         configure_cpu(cpu_id);
 
-        spinlock_lock(&prime_lock, kSpinlockWaitForever);
+        ticket_lock_lock(&prime_lock);
         printf("CPU %d: Starting calculation\n", cpu_id);
-        spinlock_unlock(&prime_lock);
+        ticket_lock_unlock(&prime_lock);
 
         calculatePrimes(cpu_id);
 
-        spinlock_lock(&prime_lock, kSpinlockWaitForever);
+        ticket_lock_lock(&prime_lock);
         printf("CPU %d: Finished\n", cpu_id);
-        spinlock_unlock(&prime_lock);
+        ticket_lock_unlock(&prime_lock);
 
         // if last cpu, trigger test done
         if (cpu_id == (num_cpus - 1))
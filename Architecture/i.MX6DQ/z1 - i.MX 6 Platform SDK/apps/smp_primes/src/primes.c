@@ -17,8 +17,8 @@ unsigned int next_number;
 
 volatile unsigned int prime_count;
 
-spinlock_t prime_lock;
-spinlock_t next_num_lock;
+ticket_lock_t prime_lock;
+mcs_lock_t next_num_lock;
 
 // ------------------------------------------------------------
 
@@ -26,10 +26,10 @@ static unsigned int getNextNumber()
 {
   unsigned int number;
 
-  spinlock_lock(&next_num_lock, kSpinlockWaitForever);
+  mcs_lock_lock(&next_num_lock);
   number = next_number;
   next_number = next_number + 2;
-  spinlock_unlock(&next_num_lock);
+  mcs_lock_unlock(&next_num_lock);
 
   return number;
 }
@@ -38,7 +38,7 @@ static unsigned int getNextNumber()
 
 static void addPrime(unsigned int number, unsigned int id)
 {
-  spinlock_lock(&prime_lock, kSpinlockWaitForever);
+  ticket_lock_lock(&prime_lock);
 
   // It is possible a CPU could skid past the target number of primes
   // so adding a check to avoid potential writes past the end of the array
@@ -49,7 +49,7 @@ static void addPrime(unsigned int number, unsigned int id)
     printf("CPU %d: %d (prime %d of %d)\n", id, number, prime_count, target_count);
   }
 
-  spinlock_unlock(&prime_lock);
+  ticket_lock_unlock(&prime_lock);
 
   return;
 }
@@ -59,8 +59,8 @@ static void addPrime(unsigned int number, unsigned int id)
 void initPrimes(void)
 {
   // Initialize mutexes
-  spinlock_init(&prime_lock);
-  spinlock_init(&next_num_lock);
+  ticket_lock_init(&prime_lock);
+  mcs_lock_init(&next_num_lock);
 
   // Set initial
   target_count = TARGET_COUNT;
@@ -19,7 +19,10 @@ void initPrimes(void);
 void calculatePrimes(unsigned int id);
 
 // Shared with main to lock printfs
-extern spinlock_t prime_lock;
+extern ticket_lock_t prime_lock;
+
+// Hands out the numbers to test
+extern mcs_lock_t next_num_lock;
 
 #endif
 
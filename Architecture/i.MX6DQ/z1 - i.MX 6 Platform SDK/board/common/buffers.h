@@ -70,6 +70,14 @@
 #define VIDEO_BUFFERS_START     (0x48000000)
 #define VIDEO_BUFFERS_END       (0x4FFFFFFF)
 
+/* DDR holding all the fixed address IPU, VPU and HDMI audio buffers above.
+   platform_init() maps it non-cacheable on every board; DMA buffers
+   allocated at run time come from core/dma_alloc.h and manage their own
+   cache attributes.
+ */
+#define DMA_FIXED_BUFFERS_START IPU_DMA_MEMORY_START
+#define DMA_FIXED_BUFFERS_END   VIDEO_BUFFERS_END
+
 /*OCRAM partition table*/
 #define VPU_SEC_AXI_START	0x00910000
 #define VPU_SEC_AXI_END		0x0091FFFF
@@ -0,0 +1,1100 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ * iperf2 compatible throughput server and client on the raw API.
+ *
+ * The wire format follows iperf 2.0.x: a TCP test is a plain byte stream
+ * whose first 24 bytes carry the client header, a UDP test is a sequence of
+ * datagrams each starting with a sequence number and send timestamp, ended
+ * by a datagram with a negative sequence number that the server answers
+ * with its report. "-d" and "-r" requests from a host client are honoured
+ * by connecting back to the port it announces.
+ *
+ * Nothing here registers timers: the application calls iperf_poll() from
+ * its main loop, next to the stack's own timer processing, and that drives
+ * the periodic reports, the end of timed tests and UDP pacing.
+ */
+
+#include "lwip/opt.h"
+
+#include "iperf.h"
+
+#include "lwip/tcp.h"
+#include "lwip/udp.h"
+#include "lwip/pbuf.h"
+#include "lwip/sys.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/def.h"
+
+#include <string.h>
+
+#if LWIP_TCP || LWIP_UDP
+
+#ifndef IPERF_MAX_STREAMS
+#define IPERF_MAX_STREAMS   8
+#endif
+
+/** Size of the static transmit pattern, writes are clamped to this */
+#ifndef IPERF_BUFFER_SIZE
+#define IPERF_BUFFER_SIZE   8192
+#endif
+
+#ifndef IPERF_PRINTF
+#define IPERF_PRINTF(x)     LWIP_PLATFORM_DIAG(x)
+#endif
+
+/** Interval between retransmissions of the final UDP datagram */
+#define IPERF_UDP_FIN_MS    250
+#define IPERF_UDP_FIN_TRIES 10
+/** A UDP server stream is dropped after this long without datagrams */
+#define IPERF_UDP_IDLE_MS   10000
+
+/* client_hdr.flags */
+#define IPERF_HEADER_VERSION1 0x80000000UL
+#define IPERF_RUN_NOW         0x00000001UL
+
+/** Sent first on a TCP connection, after the datagram header over UDP */
+struct iperf_client_hdr {
+  s32_t flags;
+  s32_t num_threads;
+  s32_t port;
+  s32_t buffer_len;
+  s32_t win_band;
+  /** bytes when positive, time in units of 10ms when negative */
+  s32_t amount;
+};
+
+/** Start of every UDP datagram */
+struct iperf_udp_hdr {
+  s32_t id;
+  u32_t tv_sec;
+  u32_t tv_usec;
+};
+
+/** Returned by the server in reply to the final UDP datagram */
+struct iperf_server_hdr {
+  s32_t flags;
+  s32_t total_len1;
+  s32_t total_len2;
+  s32_t stop_sec;
+  s32_t stop_usec;
+  s32_t error_cnt;
+  s32_t outorder_cnt;
+  s32_t datagrams;
+  s32_t jitter1;
+  s32_t jitter2;
+};
+
+#define IPERF_CLIENT_HDR_LEN  sizeof(struct iperf_client_hdr)
+#define IPERF_UDP_HDR_LEN     sizeof(struct iperf_udp_hdr)
+#define IPERF_SERVER_HDR_LEN  sizeof(struct iperf_server_hdr)
+
+enum iperf_kind {
+  IPERF_FREE = 0,
+  IPERF_TCP_SERVER,
+  IPERF_TCP_CLIENT,
+  IPERF_UDP_SERVER,
+  IPERF_UDP_CLIENT
+};
+
+enum iperf_state {
+  IPERF_CONNECTING,
+  IPERF_RUNNING,
+  /** TCP: waiting for tcp_close() to succeed, UDP client: sending FIN */
+  IPERF_CLOSING,
+  /** UDP server: report sent, kept around to answer FIN retries */
+  IPERF_DONE
+};
+
+struct iperf_stream {
+  u8_t kind;
+  u8_t state;
+  u8_t id;
+  /** streams started together share a group and get a [SUM] line */
+  u8_t group;
+  u8_t flags;
+  union {
+    struct tcp_pcb *tcp;
+    struct udp_pcb *udp;
+  } pcb;
+  ip_addr_t remote;
+  u16_t remote_port;
+  u16_t len;
+
+  u32_t start_ms;
+  u32_t report_ms;
+  u32_t interval_ms;
+  u32_t time_ms;
+  /** bytes to send (TCP: still to send), 0 when the test is timed */
+  u32_t amount;
+
+  /** total transferred, as KiB plus remainder to stay within 32 bits */
+  u32_t kbytes;
+  u32_t rem;
+  u32_t interval_bytes;
+  u16_t chksum;
+
+  /* TCP server: client header collected from the start of the stream */
+  u8_t hdr_got;
+  struct iperf_client_hdr hdr;
+
+  /* UDP */
+  s32_t udp_id;
+  u32_t datagrams;
+  u32_t lost;
+  u32_t outorder;
+  u32_t last_ms;
+  s32_t transit;
+  /** jitter in us, scaled by 16 as in RFC 1889 */
+  u32_t jitter16;
+  u32_t bandwidth;
+  u32_t credit;
+  u32_t credit_ms;
+  u8_t  fin_tries;
+};
+
+static struct iperf_stream iperf_streams[IPERF_MAX_STREAMS];
+static struct iperf_settings iperf_server_settings;
+static struct udp_pcb *iperf_server_udp;
+static u8_t iperf_next_id = 3;
+static u8_t iperf_next_group;
+static u8_t iperf_pattern_ready;
+
+/** Transmit data, sent straight from here unless IPERF_FLAG_TX_COPY is set */
+static u8_t iperf_buf[IPERF_BUFFER_SIZE];
+
+static void iperf_start_reverse(struct iperf_stream *s);
+
+void
+iperf_settings_default(struct iperf_settings *settings)
+{
+  memset(settings, 0, sizeof(*settings));
+  settings->streams = 1;
+  settings->port = IPERF_DEFAULT_PORT;
+  settings->len = 8192;
+  settings->time_ms = 10000;
+  settings->bandwidth = 1000000;
+}
+
+static void
+iperf_init_pattern(void)
+{
+  u32_t i;
+
+  if (!iperf_pattern_ready) {
+    /* same pattern iperf fills its buffers with */
+    for (i = 0; i < sizeof(iperf_buf); i++) {
+      iperf_buf[i] = (u8_t)('0' + i % 10);
+    }
+    iperf_pattern_ready = 1;
+  }
+}
+
+static struct iperf_stream *
+iperf_stream_alloc(u8_t kind, u8_t group)
+{
+  u8_t i;
+
+  for (i = 0; i < IPERF_MAX_STREAMS; i++) {
+    struct iperf_stream *s = &iperf_streams[i];
+    if (s->kind == IPERF_FREE) {
+      memset(s, 0, sizeof(*s));
+      s->kind = kind;
+      s->group = group;
+      s->id = iperf_next_id++;
+      if (iperf_next_id == 0) {
+        iperf_next_id = 3;
+      }
+      s->start_ms = s->report_ms = sys_now();
+      return s;
+    }
+  }
+  return NULL;
+}
+
+static void
+iperf_add_bytes(struct iperf_stream *s, u32_t len)
+{
+  s->interval_bytes += len;
+  s->rem += len;
+  s->kbytes += s->rem >> 10;
+  s->rem &= 1023;
+}
+
+/** Print one iperf style result line, times in ms since the stream started */
+static void
+iperf_print(const char *tag, u32_t from_ms, u32_t to_ms, u32_t kbytes, u32_t rem)
+{
+  u32_t ms = to_ms - from_ms;
+  u32_t kbps;
+  u32_t mb100;
+
+  if (ms == 0) {
+    ms = 1;
+  }
+  /* bits per ms == kbit/s; split so that kbytes * 8192 cannot overflow */
+  kbps = (kbytes / ms) * 8192 + ((kbytes % ms) * 8192 + rem * 8) / ms;
+  mb100 = (kbytes / 1024) * 100 + ((kbytes % 1024) * 100) / 1024;
+
+  IPERF_PRINTF(("%s %2"U32_F".%"U32_F"-%2"U32_F".%"U32_F" sec  %4"U32_F".%02"U32_F" MBytes  %4"U32_F".%02"U32_F" Mbits/sec\n",
+    tag, from_ms / 1000, (from_ms % 1000) / 100, to_ms / 1000, (to_ms % 1000) / 100,
+    mb100 / 100, mb100 % 100, kbps / 1000, (kbps % 1000) / 10));
+}
+
+/** "[  3]", as iperf labels its streams */
+static void
+iperf_tag(struct iperf_stream *s, char *tag)
+{
+  tag[0] = '[';
+  tag[1] = (char)(s->id >= 100 ? '0' + s->id / 100 : ' ');
+  tag[2] = (char)(s->id >= 10 ? '0' + (s->id / 10) % 10 : ' ');
+  tag[3] = (char)('0' + s->id % 10);
+  tag[4] = ']';
+  tag[5] = '\0';
+}
+
+static void
+iperf_print_stream(struct iperf_stream *s, u32_t from_ms, u32_t to_ms, u32_t bytes)
+{
+  char tag[8];
+
+  iperf_tag(s, tag);
+  iperf_print(tag, from_ms, to_ms, bytes >> 10, bytes & 1023);
+}
+
+static void
+iperf_print_connected(struct iperf_stream *s, u16_t local_port)
+{
+  IPERF_PRINTF(("[%3"U16_F"] local port %"U16_F" connected with %s port %"U16_F"\n",
+    (u16_t)s->id, local_port, ipaddr_ntoa(&s->remote), s->remote_port));
+}
+
+/** Final report of a stream; prints the checksum when it was computed */
+static void
+iperf_print_total(struct iperf_stream *s, u32_t end_ms)
+{
+  char tag[8];
+
+  iperf_tag(s, tag);
+  iperf_print(tag, 0, end_ms - s->start_ms, s->kbytes, s->rem);
+  if ((s->flags & IPERF_FLAG_RX_CHKSUM) && (s->kind == IPERF_TCP_SERVER || s->kind == IPERF_UDP_SERVER)) {
+    IPERF_PRINTF(("%s data checksum 0x%04"X16_F"\n", tag, s->chksum));
+  }
+}
+
+static void
+iperf_rx_chksum(struct iperf_stream *s, struct pbuf *p, u16_t offset)
+{
+  struct pbuf *q;
+  u32_t acc = s->chksum;
+
+  if (!(s->flags & IPERF_FLAG_RX_CHKSUM)) {
+    return;
+  }
+  for (q = p; q != NULL; q = q->next) {
+    if (offset >= q->len) {
+      offset -= q->len;
+      continue;
+    }
+    /* per-segment sums folded together; the point is to touch every byte */
+    acc += (u16_t)~inet_chksum((u8_t *)q->payload + offset, q->len - offset);
+    offset = 0;
+  }
+  acc = (acc >> 16) + (acc & 0xffff);
+  acc = (acc >> 16) + (acc & 0xffff);
+  s->chksum = (u16_t)acc;
+}
+
+static void
+iperf_hdr_ntoh(struct iperf_client_hdr *hdr)
+{
+  hdr->flags = (s32_t)ntohl(hdr->flags);
+  hdr->num_threads = (s32_t)ntohl(hdr->num_threads);
+  hdr->port = (s32_t)ntohl(hdr->port);
+  hdr->buffer_len = (s32_t)ntohl(hdr->buffer_len);
+  hdr->win_band = (s32_t)ntohl(hdr->win_band);
+  hdr->amount = (s32_t)ntohl(hdr->amount);
+}
+
+static void
+iperf_stream_free(struct iperf_stream *s)
+{
+  s->kind = IPERF_FREE;
+}
+
+#if LWIP_TCP
+/*-------------------------------------------------------------------------
+ * TCP
+ *-----------------------------------------------------------------------*/
+
+static void
+iperf_tcp_detach(struct tcp_pcb *pcb)
+{
+  tcp_arg(pcb, NULL);
+  tcp_recv(pcb, NULL);
+  tcp_sent(pcb, NULL);
+  tcp_err(pcb, NULL);
+}
+
+static void iperf_tcp_err(void *arg, err_t err);
+
+/** Print the result and close; the stream is freed once the close succeeds */
+static void
+iperf_tcp_finish(struct iperf_stream *s)
+{
+  if (s->state != IPERF_CLOSING) {
+    s->state = IPERF_CLOSING;
+    iperf_print_total(s, sys_now());
+  }
+  /* once closed the pcb may outlive us, so no callback may refer to s */
+  iperf_tcp_detach(s->pcb.tcp);
+  if (tcp_close(s->pcb.tcp) == ERR_OK) {
+    if (s->kind == IPERF_TCP_SERVER && s->hdr_got == IPERF_CLIENT_HDR_LEN &&
+        (s->hdr.flags & IPERF_HEADER_VERSION1) && !(s->hdr.flags & IPERF_RUN_NOW)) {
+      /* "-r": our turn to send */
+      iperf_start_reverse(s);
+    }
+    iperf_stream_free(s);
+  } else {
+    /* retried from iperf_poll() */
+    tcp_arg(s->pcb.tcp, s);
+    tcp_err(s->pcb.tcp, iperf_tcp_err);
+  }
+}
+
+static void
+iperf_tcp_err(void *arg, err_t err)
+{
+  struct iperf_stream *s = (struct iperf_stream *)arg;
+
+  LWIP_UNUSED_ARG(err);
+  if (s != NULL) {
+    if (s->state != IPERF_CLOSING) {
+      IPERF_PRINTF(("[%3"U16_F"] connection error %d\n", (u16_t)s->id, err));
+      iperf_print_total(s, sys_now());
+    }
+    /* pcb is already gone */
+    iperf_stream_free(s);
+  }
+}
+
+static err_t
+iperf_tcp_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  struct iperf_stream *s = (struct iperf_stream *)arg;
+  u16_t offset = 0;
+
+  LWIP_UNUSED_ARG(err);
+  if (p == NULL) {
+    iperf_tcp_finish(s);
+    return ERR_OK;
+  }
+  if (s->hdr_got < IPERF_CLIENT_HDR_LEN) {
+    offset = pbuf_copy_partial(p, (u8_t *)&s->hdr + s->hdr_got,
+      (u16_t)(IPERF_CLIENT_HDR_LEN - s->hdr_got), 0);
+    s->hdr_got += (u8_t)offset;
+    if (s->hdr_got == IPERF_CLIENT_HDR_LEN) {
+      iperf_hdr_ntoh(&s->hdr);
+      if ((s->hdr.flags & IPERF_HEADER_VERSION1) && (s->hdr.flags & IPERF_RUN_NOW)) {
+        /* "-d": send back while we receive */
+        iperf_start_reverse(s);
+      }
+    }
+  }
+  iperf_rx_chksum(s, p, offset);
+  iperf_add_bytes(s, p->tot_len);
+  tcp_recved(pcb, p->tot_len);
+  pbuf_free(p);
+  return ERR_OK;
+}
+
+static err_t
+iperf_tcp_accept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+  struct iperf_stream *s;
+  u8_t i;
+  u8_t group;
+
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+
+  /* parallel connections from one client are summed together */
+  group = iperf_next_group;
+  for (i = 0; i < IPERF_MAX_STREAMS; i++) {
+    if (iperf_streams[i].kind == IPERF_TCP_SERVER &&
+        ip_addr_cmp(&iperf_streams[i].remote, &pcb->remote_ip)) {
+      group = iperf_streams[i].group;
+      break;
+    }
+  }
+  s = iperf_stream_alloc(IPERF_TCP_SERVER, group);
+  if (s == NULL) {
+    tcp_abort(pcb);
+    return ERR_ABRT;
+  }
+  if (group == iperf_next_group) {
+    iperf_next_group++;
+  }
+  s->state = IPERF_RUNNING;
+  s->flags = iperf_server_settings.flags;
+  s->interval_ms = iperf_server_settings.interval_ms;
+  s->pcb.tcp = pcb;
+  ip_addr_copy(s->remote, pcb->remote_ip);
+  s->remote_port = pcb->remote_port;
+  tcp_arg(pcb, s);
+  tcp_recv(pcb, iperf_tcp_recv);
+  tcp_err(pcb, iperf_tcp_err);
+  iperf_print_connected(s, pcb->local_port);
+  return ERR_OK;
+}
+
+/** Queue as much of the test data as the send buffer takes */
+static void
+iperf_tcp_send(struct iperf_stream *s)
+{
+  struct tcp_pcb *pcb = s->pcb.tcp;
+  u8_t apiflags = TCP_WRITE_FLAG_MORE;
+  u16_t n;
+
+  if (s->flags & IPERF_FLAG_TX_COPY) {
+    apiflags |= TCP_WRITE_FLAG_COPY;
+  }
+  while (s->state == IPERF_RUNNING) {
+    n = LWIP_MIN(tcp_sndbuf(pcb), s->len);
+    if (s->amount != 0 && n > s->amount) {
+      n = (u16_t)s->amount;
+    }
+    /* don't chop the stream into runts just because the window is nearly full */
+    if (n == 0 || (n < LWIP_MIN(s->len, TCP_MSS) && n != s->amount)) {
+      break;
+    }
+    if (tcp_sndqueuelen(pcb) >= TCP_SND_QUEUELEN) {
+      break;
+    }
+    if (tcp_write(pcb, iperf_buf, n, apiflags) != ERR_OK) {
+      break;
+    }
+    iperf_add_bytes(s, n);
+    if (s->amount != 0) {
+      s->amount -= n;
+      if (s->amount == 0) {
+        tcp_output(pcb);
+        iperf_tcp_finish(s);
+        return;
+      }
+    }
+  }
+  tcp_output(pcb);
+}
+
+static err_t
+iperf_tcp_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(len);
+  iperf_tcp_send((struct iperf_stream *)arg);
+  return ERR_OK;
+}
+
+static err_t
+iperf_tcp_connected(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+  struct iperf_stream *s = (struct iperf_stream *)arg;
+  struct iperf_client_hdr hdr;
+
+  LWIP_UNUSED_ARG(err);
+  memset(&hdr, 0, sizeof(hdr));
+  if (tcp_write(pcb, &hdr, sizeof(hdr), TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE) != ERR_OK) {
+    iperf_tcp_finish(s);
+    return ERR_OK;
+  }
+  s->state = IPERF_RUNNING;
+  s->start_ms = s->report_ms = sys_now();
+  iperf_add_bytes(s, sizeof(hdr));
+  if (s->amount != 0) {
+    s->amount = (s->amount > sizeof(hdr)) ? s->amount - sizeof(hdr) : 1;
+  }
+  iperf_print_connected(s, pcb->local_port);
+  tcp_sent(pcb, iperf_tcp_sent);
+  iperf_tcp_send(s);
+  return ERR_OK;
+}
+
+static err_t
+iperf_tcp_client_start(struct iperf_stream *s)
+{
+  struct tcp_pcb *pcb = tcp_new();
+  err_t err;
+
+  if (pcb == NULL) {
+    return ERR_MEM;
+  }
+  s->pcb.tcp = pcb;
+  s->state = IPERF_CONNECTING;
+  tcp_nagle_disable(pcb);
+  tcp_arg(pcb, s);
+  tcp_err(pcb, iperf_tcp_err);
+  err = tcp_connect(pcb, &s->remote, s->remote_port, iperf_tcp_connected);
+  if (err != ERR_OK) {
+    iperf_tcp_detach(pcb);
+    tcp_abort(pcb);
+  }
+  return err;
+}
+#endif /* LWIP_TCP */
+
+#if LWIP_UDP
+/*-------------------------------------------------------------------------
+ * UDP
+ *-----------------------------------------------------------------------*/
+
+/** Fill in a datagram header, the timestamp is our sys_now() */
+static void
+iperf_udp_fill(struct iperf_udp_hdr *h, s32_t id, u32_t now)
+{
+  h->id = (s32_t)htonl((u32_t)id);
+  h->tv_sec = htonl(now / 1000);
+  h->tv_usec = htonl((now % 1000) * 1000);
+}
+
+static void
+iperf_udp_send_report(struct iperf_stream *s, const struct iperf_udp_hdr *fin)
+{
+  struct pbuf *p;
+  struct iperf_server_hdr *sh;
+  u32_t dur = s->last_ms - s->start_ms;
+  u32_t jitter = s->jitter16 >> 4;
+  u32_t errors;
+
+  p = pbuf_alloc(PBUF_TRANSPORT, IPERF_UDP_HDR_LEN + IPERF_SERVER_HDR_LEN, PBUF_RAM);
+  if (p == NULL) {
+    return;
+  }
+  MEMCPY(p->payload, fin, IPERF_UDP_HDR_LEN);
+  sh = (struct iperf_server_hdr *)((u8_t *)p->payload + IPERF_UDP_HDR_LEN);
+  errors = (s->lost > s->outorder) ? s->lost - s->outorder : 0;
+  sh->flags = (s32_t)htonl(IPERF_HEADER_VERSION1);
+  sh->total_len1 = (s32_t)htonl(s->kbytes >> 22);
+  sh->total_len2 = (s32_t)htonl((s->kbytes << 10) + s->rem);
+  sh->stop_sec = (s32_t)htonl(dur / 1000);
+  sh->stop_usec = (s32_t)htonl((dur % 1000) * 1000);
+  sh->error_cnt = (s32_t)htonl(errors);
+  sh->outorder_cnt = (s32_t)htonl(s->outorder);
+  sh->datagrams = (s32_t)htonl((u32_t)s->udp_id);
+  sh->jitter1 = (s32_t)htonl(jitter / 1000000);
+  sh->jitter2 = (s32_t)htonl(jitter % 1000000);
+  udp_sendto(iperf_server_udp, p, &s->remote, s->remote_port);
+  pbuf_free(p);
+}
+
+static void
+iperf_udp_print_loss(struct iperf_stream *s, u32_t jitter_us, u32_t lost, u32_t total)
+{
+  IPERF_PRINTF(("[%3"U16_F"] jitter %"U32_F".%03"U32_F" ms  lost %"U32_F"/%"U32_F" datagrams, %"U32_F" out of order\n",
+    (u16_t)s->id, jitter_us / 1000, jitter_us % 1000, lost, total, s->outorder));
+}
+
+static void
+iperf_udp_server_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+  struct iperf_stream *s = NULL;
+  struct iperf_udp_hdr h;
+  u32_t now = sys_now();
+  s32_t id;
+  s32_t transit;
+  s32_t d;
+  u8_t i;
+
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+
+  if (pbuf_copy_partial(p, &h, IPERF_UDP_HDR_LEN, 0) != IPERF_UDP_HDR_LEN) {
+    pbuf_free(p);
+    return;
+  }
+  id = (s32_t)ntohl((u32_t)h.id);
+
+  for (i = 0; i < IPERF_MAX_STREAMS; i++) {
+    if (iperf_streams[i].kind == IPERF_UDP_SERVER && iperf_streams[i].remote_port == port &&
+        ip_addr_cmp(&iperf_streams[i].remote, addr)) {
+      s = &iperf_streams[i];
+      break;
+    }
+  }
+
+  if (s != NULL && s->state == IPERF_DONE) {
+    if (id < 0) {
+      /* our report got lost, the client is retrying */
+      iperf_udp_send_report(s, &h);
+      pbuf_free(p);
+      return;
+    }
+    /* a new test from the same address and port */
+    iperf_stream_free(s);
+    s = NULL;
+  }
+  if (s == NULL) {
+    if (id < 0) {
+      pbuf_free(p);
+      return;
+    }
+    s = iperf_stream_alloc(IPERF_UDP_SERVER, iperf_next_group++);
+    if (s == NULL) {
+      pbuf_free(p);
+      return;
+    }
+    s->state = IPERF_RUNNING;
+    s->flags = iperf_server_settings.flags;
+    s->interval_ms = iperf_server_settings.interval_ms;
+    ip_addr_copy(s->remote, *addr);
+    s->remote_port = port;
+    s->udp_id = -1;
+    if (pbuf_copy_partial(p, &s->hdr, IPERF_CLIENT_HDR_LEN, IPERF_UDP_HDR_LEN) == IPERF_CLIENT_HDR_LEN) {
+      s->hdr_got = IPERF_CLIENT_HDR_LEN;
+      iperf_hdr_ntoh(&s->hdr);
+    }
+    iperf_print_connected(s, iperf_server_settings.port);
+    if (s->hdr_got && (s->hdr.flags & IPERF_HEADER_VERSION1) && (s->hdr.flags & IPERF_RUN_NOW)) {
+      iperf_start_reverse(s);
+    }
+  }
+
+  s->last_ms = now;
+  if (id < 0) {
+    id = -id;
+    if (id - 1 > s->udp_id) {
+      s->lost += (u32_t)(id - 1 - s->udp_id);
+    }
+    s->udp_id = id;
+    s->state = IPERF_DONE;
+    iperf_print_total(s, now);
+    iperf_udp_print_loss(s, s->jitter16 >> 4, s->lost > s->outorder ? s->lost - s->outorder : 0, (u32_t)id);
+    iperf_udp_send_report(s, &h);
+    if (s->hdr_got && (s->hdr.flags & IPERF_HEADER_VERSION1) && !(s->hdr.flags & IPERF_RUN_NOW)) {
+      iperf_start_reverse(s);
+    }
+    pbuf_free(p);
+    return;
+  }
+
+  s->datagrams++;
+  if (id > s->udp_id + 1) {
+    s->lost += (u32_t)(id - s->udp_id - 1);
+  } else if (id <= s->udp_id) {
+    s->outorder++;
+  }
+  if (id > s->udp_id) {
+    s->udp_id = id;
+  }
+
+  /* RFC 1889 interarrival jitter; sender and receiver clocks need not
+   * agree, only the change in transit time matters */
+  transit = (s32_t)(now * 1000 - (ntohl(h.tv_sec) * 1000000 + ntohl(h.tv_usec)));
+  if (s->datagrams > 1) {
+    d = transit - s->transit;
+    if (d < 0) {
+      d = -d;
+    }
+    s->jitter16 += (u32_t)d - (s->jitter16 >> 4);
+  }
+  s->transit = transit;
+
+  iperf_rx_chksum(s, p, IPERF_UDP_HDR_LEN);
+  iperf_add_bytes(s, p->tot_len);
+  pbuf_free(p);
+}
+
+static void
+iperf_udp_client_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+  struct iperf_stream *s = (struct iperf_stream *)arg;
+  struct iperf_server_hdr sh;
+  u32_t stop_ms;
+  u32_t lost;
+  u32_t total;
+
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(addr);
+  LWIP_UNUSED_ARG(port);
+
+  if (s->state == IPERF_CLOSING &&
+      pbuf_copy_partial(p, &sh, IPERF_SERVER_HDR_LEN, IPERF_UDP_HDR_LEN) == IPERF_SERVER_HDR_LEN &&
+      (ntohl((u32_t)sh.flags) & IPERF_HEADER_VERSION1)) {
+    stop_ms = ntohl((u32_t)sh.stop_sec) * 1000 + ntohl((u32_t)sh.stop_usec) / 1000;
+    total = ntohl((u32_t)sh.total_len2);
+    IPERF_PRINTF(("[%3"U16_F"] Server Report:\n", (u16_t)s->id));
+    iperf_print("     ", 0, stop_ms, (ntohl((u32_t)sh.total_len1) << 22) | (total >> 10), total & 1023);
+    lost = ntohl((u32_t)sh.error_cnt);
+    s->outorder = ntohl((u32_t)sh.outorder_cnt);
+    iperf_udp_print_loss(s, ntohl((u32_t)sh.jitter1) * 1000000 + ntohl((u32_t)sh.jitter2),
+      lost, ntohl((u32_t)sh.datagrams));
+    s->state = IPERF_DONE;
+  }
+  pbuf_free(p);
+}
+
+/** Send one test datagram (or the FIN when id is negative) */
+static err_t
+iperf_udp_send(struct iperf_stream *s, s32_t id, u32_t now)
+{
+  struct pbuf *h;
+  struct pbuf *d;
+  u16_t hlen = IPERF_UDP_HDR_LEN + IPERF_CLIENT_HDR_LEN;
+  err_t err;
+
+  if (s->flags & IPERF_FLAG_TX_COPY) {
+    h = pbuf_alloc(PBUF_TRANSPORT, s->len, PBUF_RAM);
+    if (h == NULL) {
+      return ERR_MEM;
+    }
+    pbuf_take(h, iperf_buf, s->len);
+  } else {
+    h = pbuf_alloc(PBUF_TRANSPORT, hlen, PBUF_RAM);
+    if (h == NULL) {
+      return ERR_MEM;
+    }
+    d = pbuf_alloc(PBUF_RAW, (u16_t)(s->len - hlen), PBUF_ROM);
+    if (d == NULL) {
+      pbuf_free(h);
+      return ERR_MEM;
+    }
+    d->payload = iperf_buf;
+    pbuf_cat(h, d);
+  }
+  /* a zeroed client header: no "-d"/"-r" requested */
+  memset(h->payload, 0, hlen);
+  iperf_udp_fill((struct iperf_udp_hdr *)h->payload, id, now);
+  err = udp_sendto(s->pcb.udp, h, &s->remote, s->remote_port);
+  pbuf_free(h);
+  return err;
+}
+
+static u8_t
+iperf_udp_client_done(struct iperf_stream *s, u32_t now)
+{
+  if (s->amount != 0) {
+    return (u32_t)s->udp_id * s->len >= s->amount;
+  }
+  return (u32_t)(now - s->start_ms) >= s->time_ms;
+}
+
+/** Pace datagrams to the configured bandwidth using the time since last call */
+static void
+iperf_udp_client_run(struct iperf_stream *s, u32_t now)
+{
+  u32_t bits = (u32_t)s->len * 8;
+  u32_t per_ms = s->bandwidth / 1000;
+  u32_t cap;
+
+  if (per_ms == 0) {
+    per_ms = 1;
+  }
+  /* don't let a stalled main loop turn into a burst, but always allow a
+   * couple of datagrams so slow rates still send */
+  cap = LWIP_MAX(per_ms * 10, bits * 2);
+  s->credit += (now - s->credit_ms) * per_ms;
+  s->credit_ms = now;
+  if (s->credit > cap) {
+    s->credit = cap;
+  }
+  while (s->credit >= bits && !iperf_udp_client_done(s, now)) {
+    if (iperf_udp_send(s, s->udp_id, now) != ERR_OK) {
+      break;
+    }
+    s->udp_id++;
+    s->credit -= bits;
+    iperf_add_bytes(s, s->len);
+  }
+}
+
+static err_t
+iperf_udp_client_start(struct iperf_stream *s)
+{
+  struct udp_pcb *pcb = udp_new();
+
+  if (pcb == NULL) {
+    return ERR_MEM;
+  }
+  if (udp_bind(pcb, IP_ADDR_ANY, 0) != ERR_OK) {
+    udp_remove(pcb);
+    return ERR_USE;
+  }
+  udp_recv(pcb, iperf_udp_client_recv, s);
+  s->pcb.udp = pcb;
+  s->state = IPERF_RUNNING;
+  s->credit_ms = s->start_ms;
+  iperf_print_connected(s, pcb->local_port);
+  return ERR_OK;
+}
+
+/** Test time is over: print our side and start sending the FIN */
+static void
+iperf_udp_client_end(struct iperf_stream *s, u32_t now)
+{
+  s->state = IPERF_CLOSING;
+  iperf_print_total(s, now);
+  IPERF_PRINTF(("[%3"U16_F"] Sent %"S32_F" datagrams\n", (u16_t)s->id, s->udp_id));
+  s->fin_tries = 0;
+  s->last_ms = now - IPERF_UDP_FIN_MS;
+}
+#endif /* LWIP_UDP */
+
+/*-------------------------------------------------------------------------
+ * common
+ *-----------------------------------------------------------------------*/
+
+/** Answer a "-d" or "-r" request by testing in the other direction */
+static void
+iperf_start_reverse(struct iperf_stream *s)
+{
+  struct iperf_settings settings;
+  ip_addr_t remote;
+
+  iperf_settings_default(&settings);
+  settings.flags = s->flags & (u8_t)~IPERF_FLAG_RX_CHKSUM;
+  if (s->kind == IPERF_UDP_SERVER) {
+    settings.flags |= IPERF_FLAG_UDP;
+    settings.bandwidth = (u32_t)s->hdr.win_band;
+  }
+  settings.streams = (u8_t)LWIP_MAX(1, LWIP_MIN(s->hdr.num_threads, IPERF_MAX_STREAMS));
+  settings.port = (u16_t)s->hdr.port;
+  if (s->hdr.buffer_len > 0) {
+    settings.len = (u16_t)LWIP_MIN(s->hdr.buffer_len, IPERF_BUFFER_SIZE);
+  }
+  if (s->hdr.amount < 0) {
+    settings.time_ms = (u32_t)-s->hdr.amount * 10;
+  } else {
+    settings.amount = (u32_t)s->hdr.amount;
+  }
+  settings.interval_ms = s->interval_ms;
+  ip_addr_copy(remote, s->remote);
+  if (iperf_client_start(&remote, &settings) != ERR_OK) {
+    IPERF_PRINTF(("[%3"U16_F"] could not start reverse test\n", (u16_t)s->id));
+  }
+}
+
+err_t
+iperf_server_start(const struct iperf_settings *settings)
+{
+  iperf_server_settings = *settings;
+#if LWIP_TCP
+  {
+    struct tcp_pcb *pcb = tcp_new();
+    struct tcp_pcb *lpcb;
+
+    if (pcb == NULL) {
+      return ERR_MEM;
+    }
+    if (tcp_bind(pcb, IP_ADDR_ANY, settings->port) != ERR_OK) {
+      tcp_close(pcb);
+      return ERR_USE;
+    }
+    lpcb = tcp_listen(pcb);
+    if (lpcb == NULL) {
+      tcp_close(pcb);
+      return ERR_MEM;
+    }
+    tcp_accept(lpcb, iperf_tcp_accept);
+  }
+#endif /* LWIP_TCP */
+#if LWIP_UDP
+  iperf_server_udp = udp_new();
+  if (iperf_server_udp == NULL) {
+    return ERR_MEM;
+  }
+  if (udp_bind(iperf_server_udp, IP_ADDR_ANY, settings->port) != ERR_OK) {
+    udp_remove(iperf_server_udp);
+    iperf_server_udp = NULL;
+    return ERR_USE;
+  }
+  udp_recv(iperf_server_udp, iperf_udp_server_recv, NULL);
+#endif /* LWIP_UDP */
+  IPERF_PRINTF(("Server listening on port %"U16_F"\n", settings->port));
+  return ERR_OK;
+}
+
+err_t
+iperf_client_start(ip_addr_t *server, const struct iperf_settings *settings)
+{
+  struct iperf_stream *s;
+  u8_t group = iperf_next_group++;
+  u8_t udp = (settings->flags & IPERF_FLAG_UDP) != 0;
+  u16_t len = LWIP_MIN(settings->len, IPERF_BUFFER_SIZE);
+  u8_t i;
+  err_t err = ERR_OK;
+
+  iperf_init_pattern();
+  if (udp) {
+    len = LWIP_MAX(len, IPERF_UDP_HDR_LEN + IPERF_CLIENT_HDR_LEN);
+  } else if (len == 0) {
+    len = 1;
+  }
+  IPERF_PRINTF(("Client connecting to %s, %s port %"U16_F"\n", ipaddr_ntoa(server),
+    udp ? "UDP" : "TCP", settings->port));
+
+  for (i = 0; i < LWIP_MAX(settings->streams, 1); i++) {
+    s = iperf_stream_alloc(udp ? IPERF_UDP_CLIENT : IPERF_TCP_CLIENT, group);
+    if (s == NULL) {
+      return ERR_MEM;
+    }
+    s->flags = settings->flags;
+    s->len = len;
+    s->time_ms = settings->time_ms;
+    s->amount = settings->amount;
+    s->interval_ms = settings->interval_ms;
+    s->bandwidth = settings->bandwidth;
+    ip_addr_copy(s->remote, *server);
+    s->remote_port = settings->port;
+    if (udp) {
+#if LWIP_UDP
+      err = iperf_udp_client_start(s);
+#else
+      err = ERR_VAL;
+#endif
+    } else {
+#if LWIP_TCP
+      err = iperf_tcp_client_start(s);
+#else
+      err = ERR_VAL;
+#endif
+    }
+    if (err != ERR_OK) {
+      iperf_stream_free(s);
+      break;
+    }
+  }
+  return err;
+}
+
+/** Print the interval lines of every stream in a group that is due */
+static void
+iperf_report_group(u8_t first, u32_t now)
+{
+  struct iperf_stream *f = &iperf_streams[first];
+  u32_t from = f->report_ms - f->start_ms;
+  u32_t to = from + f->interval_ms;
+  u32_t sum = 0;
+  u8_t n = 0;
+  u8_t i;
+
+  for (i = first; i < IPERF_MAX_STREAMS; i++) {
+    struct iperf_stream *s = &iperf_streams[i];
+    if (s->kind != IPERF_FREE && s->group == f->group && s->state == IPERF_RUNNING &&
+        s->interval_ms != 0 && (u32_t)(now - s->report_ms) >= s->interval_ms) {
+      iperf_print_stream(s, s->report_ms - s->start_ms, s->report_ms - s->start_ms + s->interval_ms,
+        s->interval_bytes);
+      sum += s->interval_bytes;
+      s->interval_bytes = 0;
+      s->report_ms += s->interval_ms;
+      n++;
+    }
+  }
+  if (n > 1) {
+    iperf_print("[SUM]", from, to, sum >> 10, sum & 1023);
+  }
+}
+
+void
+iperf_poll(void)
+{
+  u32_t now = sys_now();
+  u8_t i;
+
+  for (i = 0; i < IPERF_MAX_STREAMS; i++) {
+    struct iperf_stream *s = &iperf_streams[i];
+
+    if (s->kind == IPERF_FREE) {
+      continue;
+    }
+    if (s->state == IPERF_RUNNING && s->interval_ms != 0 &&
+        (u32_t)(now - s->report_ms) >= s->interval_ms) {
+      iperf_report_group(i, now);
+    }
+    switch (s->kind) {
+#if LWIP_TCP
+    case IPERF_TCP_CLIENT:
+      if (s->state == IPERF_RUNNING && s->amount == 0 &&
+          (u32_t)(now - s->start_ms) >= s->time_ms) {
+        iperf_tcp_finish(s);
+      } else if (s->state == IPERF_RUNNING) {
+        /* nothing may have been acked since the last try */
+        iperf_tcp_send(s);
+      } else if (s->state == IPERF_CLOSING) {
+        iperf_tcp_finish(s);
+      }
+      break;
+    case IPERF_TCP_SERVER:
+      if (s->state == IPERF_CLOSING) {
+        iperf_tcp_finish(s);
+      }
+      break;
+#endif /* LWIP_TCP */
+#if LWIP_UDP
+    case IPERF_UDP_CLIENT:
+      if (s->state == IPERF_RUNNING) {
+        if (iperf_udp_client_done(s, now)) {
+          iperf_udp_client_end(s, now);
+        } else {
+          iperf_udp_client_run(s, now);
+        }
+      }
+      if (s->state == IPERF_CLOSING && (u32_t)(now - s->last_ms) >= IPERF_UDP_FIN_MS) {
+        if (s->fin_tries++ == IPERF_UDP_FIN_TRIES) {
+          IPERF_PRINTF(("[%3"U16_F"] WARNING: did not receive ack of last datagram\n", (u16_t)s->id));
+          s->state = IPERF_DONE;
+        } else {
+          iperf_udp_send(s, -s->udp_id, now);
+          s->last_ms = now;
+        }
+      }
+      if (s->state == IPERF_DONE) {
+        udp_remove(s->pcb.udp);
+        iperf_stream_free(s);
+      }
+      break;
+    case IPERF_UDP_SERVER:
+      /* there is no connection to tell us the client went away */
+      if ((u32_t)(now - s->last_ms) >= IPERF_UDP_IDLE_MS) {
+        if (s->state == IPERF_RUNNING) {
+          iperf_print_total(s, s->last_ms);
+        }
+        iperf_stream_free(s);
+      }
+      break;
+#endif /* LWIP_UDP */
+    default:
+      break;
+    }
+  }
+}
+
+#endif /* LWIP_TCP || LWIP_UDP */
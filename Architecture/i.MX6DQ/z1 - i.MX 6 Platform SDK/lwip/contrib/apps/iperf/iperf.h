@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __IPERF_H__
+#define __IPERF_H__
+
+#include "lwip/opt.h"
+#include "lwip/ip_addr.h"
+#include "lwip/err.h"
+
+/** Port iperf uses unless told otherwise */
+#define IPERF_DEFAULT_PORT      5001
+
+/* iperf_settings.flags */
+/** Run the test over UDP instead of TCP */
+#define IPERF_FLAG_UDP          0x01
+/** Checksum all received data, like an application that touches it would */
+#define IPERF_FLAG_RX_CHKSUM    0x02
+/** Copy transmit data into the stack instead of sending from the static buffer */
+#define IPERF_FLAG_TX_COPY      0x04
+
+/** Test parameters, the fields correspond to iperf2's command line */
+struct iperf_settings {
+  u8_t flags;
+  /** number of parallel client streams (-P) */
+  u8_t streams;
+  /** server port (-p) */
+  u16_t port;
+  /** write size, or UDP datagram size (-l) */
+  u16_t len;
+  /** test duration in ms (-t), used when amount is 0 */
+  u32_t time_ms;
+  /** bytes to send per stream (-n) */
+  u32_t amount;
+  /** UDP send rate in bits/s (-b) */
+  u32_t bandwidth;
+  /** interval between periodic reports in ms, 0 for none (-i) */
+  u32_t interval_ms;
+};
+
+void  iperf_settings_default(struct iperf_settings *settings);
+err_t iperf_server_start(const struct iperf_settings *settings);
+err_t iperf_client_start(ip_addr_t *server, const struct iperf_settings *settings);
+void  iperf_poll(void);
+
+#endif /* __IPERF_H__ */
@@ -47,6 +47,12 @@
 #define PERF_STOP(x) times(&__perf_end); \
                      perf_print_times(&__perf_start, &__perf_end, x);\
                      } while(0)*/
+#elif defined(PERF_ACCUM)
+/* Sum up the time spent between PERF_START and PERF_STOP per key instead of
+   printing every sample (see perf_report()). PERF_START is a declaration, so
+   several PERF_STOPs may share one PERF_START. */
+#define PERF_START    unsigned long long __perf_t0 = perf_now_ns()
+#define PERF_STOP(x)  perf_accum(x, perf_now_ns() - __perf_t0)
 #else /* PERF */
 #define PERF_START    /* null definition */
 #define PERF_STOP(x)  /* null definition */
@@ -60,4 +66,9 @@ void perf_print_times(struct tms *start, struct tms *end, char *key);
 
 void perf_init(char *fname);
 
+unsigned long long perf_now_ns(void);
+void perf_accum(const char *key, unsigned long long ns);
+void perf_reset(void);
+void perf_report(unsigned long count);
+
 #endif /* __ARCH_PERF_H__ */
@@ -33,9 +33,22 @@
 #include "arch/perf.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 static FILE *f;
 
+/** One PERF_ACCUM key: total time and number of PERF_STOPs */
+struct perf_accum_entry {
+  const char *key;
+  unsigned long long ns;
+  unsigned long calls;
+};
+
+#define PERF_ACCUM_KEYS 32
+static struct perf_accum_entry accum[PERF_ACCUM_KEYS];
+static int accum_keys;
+
 void
 perf_print(unsigned long c1l, unsigned long c1h,
 	   unsigned long c2l, unsigned long c2h,
@@ -62,4 +75,59 @@ perf_init(char *fname)
 {
   f = fopen(fname, "w");  
 }
-	
+
+unsigned long long
+perf_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+perf_accum(const char *key, unsigned long long ns)
+{
+  int i;
+
+  for (i = 0; i < accum_keys; i++) {
+    /* keys are string literals, but the same text may live at
+       different addresses in different files */
+    if (accum[i].key == key || strcmp(accum[i].key, key) == 0) {
+      break;
+    }
+  }
+  if (i == accum_keys) {
+    if (accum_keys == PERF_ACCUM_KEYS) {
+      return;
+    }
+    accum[i].key = key;
+    accum_keys++;
+  }
+  accum[i].ns += ns;
+  accum[i].calls++;
+}
+
+void
+perf_reset(void)
+{
+  accum_keys = 0;
+  memset(accum, 0, sizeof(accum));
+}
+
+/** Print every key's calls and time, both in total and per count
+    (e.g. per replayed packet). */
+void
+perf_report(unsigned long count)
+{
+  int i;
+
+  if (count == 0) {
+    count = 1;
+  }
+  printf("  %-16s %12s %8s %12s %10s\n", "hook", "calls", "per-pkt", "ns", "ns/pkt");
+  for (i = 0; i < accum_keys; i++) {
+    printf("  %-16s %12lu %8.2f %12llu %10.1f\n", accum[i].key, accum[i].calls,
+           (double)accum[i].calls / count, accum[i].ns, (double)accum[i].ns / count);
+  }
+}
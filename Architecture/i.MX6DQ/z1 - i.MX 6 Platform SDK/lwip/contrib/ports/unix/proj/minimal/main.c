@@ -55,6 +55,7 @@
 #include <signal.h>
 
 #include "echo.h"
+#include "iperf.h"
 #include "private_mib.h"
 
 /* (manual) host IP configuration */
@@ -64,6 +65,11 @@ static ip_addr_t ipaddr, netmask, gw;
 static unsigned char trap_flag;
 static ip_addr_t trap_addr;
 
+/* iperf client cmd options */
+static unsigned char iperf_client_flag;
+static ip_addr_t iperf_server_addr;
+static struct iperf_settings iperf_client_settings;
+
 /* nonstatic debug cmd option, exported in lwipopts.h */
 unsigned char debug_flags;
 
@@ -89,6 +95,10 @@ static struct option longopts[] = {
   {"netmask", required_argument, NULL, 'm'},
   /* ping destination */
   {"trap_destination", required_argument, NULL, 't'},
+  /* run an iperf test against this server */
+  {"iperf_client", required_argument, NULL, 'c'},
+  /* make the iperf test UDP */
+  {"udp", no_argument, NULL, 'u'},
   /* new command line options go here! */
   {NULL,   0,                 NULL,  0}
 };
@@ -121,7 +131,11 @@ main(int argc, char **argv)
   /* use debug flags defined by debug.h */
   debug_flags = LWIP_DBG_OFF;
 
-  while ((ch = getopt_long(argc, argv, "dhg:i:m:t:", longopts, NULL)) != -1) {
+  iperf_client_flag = 0;
+  iperf_settings_default(&iperf_client_settings);
+  iperf_client_settings.interval_ms = 1000;
+
+  while ((ch = getopt_long(argc, argv, "dhg:i:m:t:c:u", longopts, NULL)) != -1) {
     switch (ch) {
       case 'd':
         debug_flags |= (LWIP_DBG_ON|LWIP_DBG_TRACE|LWIP_DBG_STATE|LWIP_DBG_FRESH|LWIP_DBG_HALT);
@@ -148,6 +162,14 @@ main(int argc, char **argv)
         strncpy(ip_str, ipaddr_ntoa(&trap_addr),sizeof(ip_str));
         printf("SNMP trap destination %s\n", ip_str);
         break;
+      case 'c':
+        iperf_client_flag = !0;
+        ipaddr_aton(optarg, &iperf_server_addr);
+        break;
+      case 'u':
+        iperf_client_settings.flags |= IPERF_FLAG_UDP;
+        iperf_client_settings.len = 1470;
+        break;
       default:
         usage();
         break;
@@ -188,6 +210,15 @@ main(int argc, char **argv)
 
   echo_init();
 
+  {
+    struct iperf_settings settings;
+    iperf_settings_default(&settings);
+    iperf_server_start(&settings);
+  }
+  if (iperf_client_flag) {
+    iperf_client_start(&iperf_server_addr, &iperf_client_settings);
+  }
+
   timer_init();
   timer_set_interval(TIMER_EVT_ETHARPTMR, ARP_TMR_INTERVAL / 10);
   timer_set_interval(TIMER_EVT_TCPTMR, TCP_TMR_INTERVAL / 10);
@@ -237,6 +268,8 @@ main(int argc, char **argv)
       {
         etharp_tmr();
       }
+
+      iperf_poll();
       
   }
   
@@ -89,8 +89,9 @@ low_level_init(struct netif *netif)
 
   mintapif = netif->state;
   
-  /* Obtain MAC address from network interface. */
-  mintapif->ethaddr->addr[0] = 1;
+  /* Obtain MAC address from network interface. A locally administered
+     unicast address: the host drops frames from a multicast source. */
+  mintapif->ethaddr->addr[0] = 2;
   mintapif->ethaddr->addr[1] = 2;
   mintapif->ethaddr->addr[2] = 3;
   mintapif->ethaddr->addr[3] = 4;
@@ -298,6 +299,8 @@ mintapif_init(struct netif *netif)
   netif->output = etharp_output;
   netif->linkoutput = low_level_output;
   netif->mtu = 1500;
+  /* ethernet_input() ignores ARP on interfaces without NETIF_FLAG_ETHARP */
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
   
   mintapif->ethaddr = (struct eth_addr *)&(netif->hwaddr[0]);
   
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/* Single threaded raw API stack, driven by the replay loop */
+#define NO_SYS                          1
+#define LWIP_SOCKET                     0
+#define LWIP_NETCONN                    0
+
+/* ---------- Memory options ---------- */
+#define MEM_ALIGNMENT                   4
+#define MEM_SIZE                        (1024 * 1024)
+#define MEMP_NUM_PBUF                   256
+#define MEMP_NUM_UDP_PCB                16
+#define MEMP_NUM_TCP_PCB                512
+#define MEMP_NUM_TCP_PCB_LISTEN         16
+#define MEMP_NUM_TCP_SEG                1024
+#define MEMP_NUM_REASSDATA              32
+#define MEMP_NUM_ARP_QUEUE              64
+#define PBUF_POOL_SIZE                  1024
+/* one pool pbuf per standard frame, as with the ENET receive buffers */
+#define PBUF_POOL_BUFSIZE               1536
+
+/* ---------- ARP options ---------- */
+#define LWIP_ARP                        1
+#define ARP_TABLE_SIZE                  64
+#define ARP_TABLE_HASH_SIZE             32
+#define ARP_QUEUEING                    1
+#define ETHARP_TRUST_IP_MAC             1
+#define LWIP_NETIF_HWADDRHINT           1
+
+/* ---------- IP options ---------- */
+#define IP_REASSEMBLY                   1
+#define IP_FRAG                         1
+#define IP_REASS_MAX_PBUFS              256
+
+/* ---------- Protocols ---------- */
+#define LWIP_ICMP                       1
+#define LWIP_UDP                        1
+#define LWIP_TCP                        1
+#define LWIP_DHCP                       0
+#define LWIP_AUTOIP                     0
+#define LWIP_IGMP                       0
+#define LWIP_DNS                        0
+
+/* ---------- TCP options ---------- */
+#define TCP_MSS                         1460
+#define TCP_WND                         (44 * TCP_MSS)
+#define TCP_SND_BUF                     (32 * TCP_MSS)
+#define TCP_SND_QUEUELEN                (4 * TCP_SND_BUF / TCP_MSS)
+
+/* ---------- Statistics options ---------- */
+#define LWIP_STATS                      1
+#define LWIP_STATS_DISPLAY              0
+#define LWIP_STATS_LARGE                1
+
+#endif /* __LWIPOPTS_H__ */
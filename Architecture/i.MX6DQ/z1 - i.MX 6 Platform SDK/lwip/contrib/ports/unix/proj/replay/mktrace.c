@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Writes synthetic pcap traces for the replay benchmark, so there is a
+ * reproducible set of workloads without capturing anything:
+ *
+ * - tcp_upload.pcap:   one client sends 4 MiB to the server
+ * - tcp_download.pcap: one client fetches 4 MiB from the server
+ * - http_short.pcap:   1000 short request/response connections
+ * - udp_small.pcap:    20000 datagrams with 64 bytes of payload
+ * - udp_frag.pcap:     2000 datagrams of 4000 bytes, 3 IP fragments each
+ *
+ * The server is 192.168.0.1, clients are 192.168.0.2 and up. All checksums
+ * are valid and both directions of every TCP connection are present, the way
+ * replay expects a capture taken on the server.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/arch.h"
+
+#define PCAP_MAGIC_USEC     0xa1b2c3d4UL
+#define PCAP_LINKTYPE_ETHER 1
+
+#define MK_ETH_HLEN         14
+#define MK_IP_HLEN          20
+#define MK_TCP_HLEN         20
+#define MK_UDP_HLEN         8
+#define MK_MTU              1500
+#define MK_MSS              (MK_MTU - MK_IP_HLEN - MK_TCP_HLEN)
+/** client receive window, below lwIP's TCP_WND (44 * MSS) in the replay build */
+#define MK_CLIENT_WND       (40 * MK_MSS)
+/** segments a bulk sender has in flight before the receiver acks */
+#define MK_BURST            16
+
+#define MK_PROTO_TCP        6
+#define MK_PROTO_UDP        17
+#define MK_TCP_FIN          0x01
+#define MK_TCP_SYN          0x02
+#define MK_TCP_PSH          0x08
+#define MK_TCP_ACK          0x10
+
+#define MK_SERVER           0xc0a80001UL    /* 192.168.0.1 */
+#define MK_CLIENT(n)        (MK_SERVER + 1 + (n))
+
+#define MK_MIN(a, b)        (((a) < (b)) ? (a) : (b))
+
+/** One trace being written */
+struct trace {
+  FILE *f;
+  /** time stamp of the next frame */
+  unsigned long long us;
+  unsigned long frames;
+  u16_t ip_id;
+};
+
+/** One TCP connection, sequence numbers of both ends */
+struct conn {
+  u32_t client;
+  u16_t cport, sport;
+  u32_t cseq, sseq;
+};
+
+static u8_t frame[MK_ETH_HLEN + 65536];
+static u8_t payload[65536];
+
+static void
+put16(u8_t *p, u32_t v)
+{
+  p[0] = (u8_t)(v >> 8);
+  p[1] = (u8_t)v;
+}
+
+static void
+put32(u8_t *p, u32_t v)
+{
+  p[0] = (u8_t)(v >> 24);
+  p[1] = (u8_t)(v >> 16);
+  p[2] = (u8_t)(v >> 8);
+  p[3] = (u8_t)v;
+}
+
+/** little endian, the byte order pcap files are usually written in */
+static void
+put32le(u8_t *p, u32_t v)
+{
+  p[0] = (u8_t)v;
+  p[1] = (u8_t)(v >> 8);
+  p[2] = (u8_t)(v >> 16);
+  p[3] = (u8_t)(v >> 24);
+}
+
+static u32_t
+chksum_add(const u8_t *data, u32_t len, u32_t acc)
+{
+  while (len > 1) {
+    acc += ((u32_t)data[0] << 8) | data[1];
+    data += 2;
+    len -= 2;
+  }
+  if (len) {
+    acc += (u32_t)data[0] << 8;
+  }
+  return acc;
+}
+
+static u16_t
+chksum_fold(u32_t acc)
+{
+  while (acc >> 16) {
+    acc = (acc & 0xffff) + (acc >> 16);
+  }
+  return (u16_t)~acc;
+}
+
+/** Sum of the TCP/UDP pseudo header */
+static u32_t
+chksum_pseudo(u32_t src, u32_t dst, u8_t proto, u32_t len)
+{
+  return (src >> 16) + (src & 0xffff) + (dst >> 16) + (dst & 0xffff) + proto + len;
+}
+
+static int
+trace_open(struct trace *t, const char *dir, const char *name)
+{
+  char path[1024];
+  u8_t hdr[24];
+
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  memset(t, 0, sizeof(*t));
+  t->f = fopen(path, "wb");
+  if (t->f == NULL) {
+    perror(path);
+    return -1;
+  }
+  put32le(hdr, PCAP_MAGIC_USEC);
+  hdr[4] = 2; hdr[5] = 0;                 /* version 2.4 */
+  hdr[6] = 4; hdr[7] = 0;
+  put32le(hdr + 8, 0);                    /* time zone */
+  put32le(hdr + 12, 0);                   /* accuracy */
+  put32le(hdr + 16, 65535);               /* snap length */
+  put32le(hdr + 20, PCAP_LINKTYPE_ETHER);
+  fwrite(hdr, 1, sizeof(hdr), t->f);
+  return 0;
+}
+
+static int
+trace_close(struct trace *t, const char *name)
+{
+  int ret = ferror(t->f) ? -1 : 0;
+
+  if (fclose(t->f) != 0) {
+    ret = -1;
+  }
+  if (ret == 0) {
+    printf("%-18s %8lu frames, %7.3f s\n", name, t->frames, t->us / 1e6);
+  } else {
+    fprintf(stderr, "%s: write failed\n", name);
+  }
+  return ret;
+}
+
+/** Append the frame in 'frame' and advance the clock by its time on a 1 Gbit/s wire */
+static void
+trace_emit(struct trace *t, u32_t len)
+{
+  u8_t rec[16];
+
+  put32le(rec, (u32_t)(t->us / 1000000));
+  put32le(rec + 4, (u32_t)(t->us % 1000000));
+  put32le(rec + 8, len);
+  put32le(rec + 12, len);
+  fwrite(rec, 1, sizeof(rec), t->f);
+  fwrite(frame, 1, len, t->f);
+  t->frames++;
+  t->us += (len + 24) * 8 / 1000 + 1;
+}
+
+/** Locally administered MAC for an address, the server gets replay's own */
+static void
+mk_mac(u8_t *mac, u32_t addr)
+{
+  mac[0] = 0x02;
+  mac[1] = 0x00;
+  if (addr == MK_SERVER) {
+    put32(mac + 2, 1);
+  } else {
+    put32(mac + 2, addr);
+  }
+}
+
+/**
+ * Fill in the Ethernet and IP headers of 'frame'
+ *
+ * @param len IP payload length of this frame
+ * @param frag fragment offset (in 8-byte units) and flags field
+ * @return total frame length
+ */
+static u32_t
+mk_ip(u32_t src, u32_t dst, u8_t proto, u32_t len, u16_t id, u16_t frag)
+{
+  u8_t *ip = frame + MK_ETH_HLEN;
+
+  mk_mac(frame, dst);
+  mk_mac(frame + 6, src);
+  put16(frame + 12, 0x0800);
+
+  ip[0] = 0x45;
+  ip[1] = 0;
+  put16(ip + 2, MK_IP_HLEN + len);
+  put16(ip + 4, id);
+  put16(ip + 6, frag);
+  ip[8] = 64;
+  ip[9] = proto;
+  put16(ip + 10, 0);
+  put32(ip + 12, src);
+  put32(ip + 16, dst);
+  put16(ip + 10, chksum_fold(chksum_add(ip, MK_IP_HLEN, 0)));
+  return MK_ETH_HLEN + MK_IP_HLEN + len;
+}
+
+/** Emit one TCP segment of 'c', sent by the client if 'from_client' */
+static void
+mk_tcp(struct trace *t, struct conn *c, int from_client, u8_t flags, u32_t len)
+{
+  u8_t *th = frame + MK_ETH_HLEN + MK_IP_HLEN;
+  u32_t src = from_client ? c->client : MK_SERVER;
+  u32_t dst = from_client ? MK_SERVER : c->client;
+  u32_t *seq = from_client ? &c->cseq : &c->sseq;
+  u32_t hlen = MK_TCP_HLEN + ((flags & MK_TCP_SYN) ? 4 : 0);
+  u32_t flen;
+
+  flen = mk_ip(src, dst, MK_PROTO_TCP, hlen + len, t->ip_id++, 0x4000);
+  put16(th, from_client ? c->cport : c->sport);
+  put16(th + 2, from_client ? c->sport : c->cport);
+  put32(th + 4, *seq);
+  put32(th + 8, (flags & MK_TCP_ACK) ? (from_client ? c->sseq : c->cseq) : 0);
+  th[12] = (u8_t)((hlen / 4) << 4);
+  th[13] = flags;
+  put16(th + 14, from_client ? MK_CLIENT_WND : 0xffff);
+  put16(th + 16, 0);
+  put16(th + 18, 0);
+  if (flags & MK_TCP_SYN) {
+    th[20] = 2;                           /* MSS option */
+    th[21] = 4;
+    put16(th + 22, MK_MSS);
+  }
+  memcpy(th + hlen, payload, len);
+  put16(th + 16, chksum_fold(chksum_add(th, hlen + len,
+                                        chksum_pseudo(src, dst, MK_PROTO_TCP, hlen + len))));
+  trace_emit(t, flen);
+
+  *seq += len + ((flags & (MK_TCP_SYN | MK_TCP_FIN)) ? 1 : 0);
+}
+
+/** Three-way handshake, the client opens */
+static void
+mk_tcp_open(struct trace *t, struct conn *c, u32_t client, u16_t cport, u16_t sport)
+{
+  c->client = client;
+  c->cport = cport;
+  c->sport = sport;
+  c->cseq = 0x10000000UL + cport * 7919UL;
+  c->sseq = 0x60000000UL + cport * 104729UL;
+  mk_tcp(t, c, 1, MK_TCP_SYN, 0);
+  mk_tcp(t, c, 0, MK_TCP_SYN | MK_TCP_ACK, 0);
+  mk_tcp(t, c, 1, MK_TCP_ACK, 0);
+}
+
+/** Bulk transfer: bursts of full segments, the receiver acks every second one */
+static void
+mk_tcp_bulk(struct trace *t, struct conn *c, int from_client, u32_t bytes)
+{
+  u32_t n, seg;
+
+  while (bytes > 0) {
+    for (n = 0; (n < MK_BURST) && (bytes > 0); n++) {
+      seg = MK_MIN(bytes, MK_MSS);
+      mk_tcp(t, c, from_client, MK_TCP_ACK | ((bytes == seg) ? MK_TCP_PSH : 0), seg);
+      bytes -= seg;
+    }
+    for (; n > 0; n -= MK_MIN(n, 2)) {
+      mk_tcp(t, c, !from_client, MK_TCP_ACK, 0);
+    }
+  }
+}
+
+/** Closed by 'from_client' first, the other end closes right away */
+static void
+mk_tcp_close(struct trace *t, struct conn *c, int from_client)
+{
+  mk_tcp(t, c, from_client, MK_TCP_FIN | MK_TCP_ACK, 0);
+  mk_tcp(t, c, !from_client, MK_TCP_FIN | MK_TCP_ACK, 0);
+  mk_tcp(t, c, from_client, MK_TCP_ACK, 0);
+}
+
+/** Emit one UDP datagram from a client, in IP fragments if it exceeds the MTU */
+static void
+mk_udp(struct trace *t, u32_t client, u16_t cport, u16_t sport, u32_t len)
+{
+  static u8_t dgram[65536];
+  u32_t total = MK_UDP_HLEN + len, off, n;
+  u16_t id = t->ip_id++;
+  u16_t sum;
+
+  put16(dgram, cport);
+  put16(dgram + 2, sport);
+  put16(dgram + 4, total);
+  put16(dgram + 6, 0);
+  memcpy(dgram + MK_UDP_HLEN, payload, len);
+  sum = chksum_fold(chksum_add(dgram, total, chksum_pseudo(client, MK_SERVER, MK_PROTO_UDP, total)));
+  put16(dgram + 6, (sum == 0) ? 0xffff : sum);
+
+  for (off = 0; off < total; off += n) {
+    /* all fragments but the last carry a multiple of 8 bytes */
+    n = MK_MIN(total - off, (MK_MTU - MK_IP_HLEN) & ~7UL);
+    memcpy(frame + MK_ETH_HLEN + MK_IP_HLEN, dgram + off, n);
+    trace_emit(t, mk_ip(client, MK_SERVER, MK_PROTO_UDP, n, id,
+                        (u16_t)((off / 8) | ((off + n < total) ? 0x2000 : 0))));
+  }
+}
+
+static int
+gen_tcp_upload(const char *dir)
+{
+  struct trace t;
+  struct conn c;
+
+  if (trace_open(&t, dir, "tcp_upload.pcap") != 0) {
+    return -1;
+  }
+  mk_tcp_open(&t, &c, MK_CLIENT(0), 40000, 5001);
+  mk_tcp_bulk(&t, &c, 1, 4 * 1024 * 1024);
+  mk_tcp_close(&t, &c, 1);
+  return trace_close(&t, "tcp_upload.pcap");
+}
+
+static int
+gen_tcp_download(const char *dir)
+{
+  static const char req[] = "GET /4M HTTP/1.0\r\n\r\n";
+  struct trace t;
+  struct conn c;
+
+  if (trace_open(&t, dir, "tcp_download.pcap") != 0) {
+    return -1;
+  }
+  mk_tcp_open(&t, &c, MK_CLIENT(0), 40001, 80);
+  memcpy(payload, req, sizeof(req) - 1);
+  mk_tcp(&t, &c, 1, MK_TCP_ACK | MK_TCP_PSH, sizeof(req) - 1);
+  mk_tcp_bulk(&t, &c, 0, 4 * 1024 * 1024);
+  mk_tcp_close(&t, &c, 0);
+  return trace_close(&t, "tcp_download.pcap");
+}
+
+static int
+gen_http_short(const char *dir)
+{
+  static const char req[] =
+    "GET /index.html HTTP/1.1\r\nHost: 192.168.0.1\r\nConnection: close\r\n\r\n";
+  struct trace t;
+  struct conn c;
+  int i;
+
+  if (trace_open(&t, dir, "http_short.pcap") != 0) {
+    return -1;
+  }
+  for (i = 0; i < 1000; i++) {
+    mk_tcp_open(&t, &c, MK_CLIENT(i % 8), (u16_t)(41000 + i), 80);
+    memcpy(payload, req, sizeof(req) - 1);
+    mk_tcp(&t, &c, 1, MK_TCP_ACK | MK_TCP_PSH, sizeof(req) - 1);
+    /* a 2 KiB page: one full segment and the rest */
+    mk_tcp(&t, &c, 0, MK_TCP_ACK, MK_MSS);
+    mk_tcp(&t, &c, 0, MK_TCP_ACK | MK_TCP_PSH, 2048 - MK_MSS);
+    mk_tcp(&t, &c, 1, MK_TCP_ACK, 0);
+    mk_tcp_close(&t, &c, 0);
+    /* think time between connections */
+    t.us += 200;
+  }
+  return trace_close(&t, "http_short.pcap");
+}
+
+static int
+gen_udp(const char *dir, const char *name, int count, u32_t len)
+{
+  struct trace t;
+  int i;
+
+  if (trace_open(&t, dir, name) != 0) {
+    return -1;
+  }
+  for (i = 0; i < count; i++) {
+    mk_udp(&t, MK_CLIENT(i % 4), (u16_t)(50000 + i % 4), 5001, len);
+  }
+  return trace_close(&t, name);
+}
+
+int
+main(int argc, char **argv)
+{
+  const char *dir = (argc > 1) ? argv[1] : ".";
+  u32_t i;
+  int ret = 0;
+
+  if ((argc > 2) || ((argc == 2) && (argv[1][0] == '-'))) {
+    printf("usage: %s [directory]\n", argv[0]);
+    return 1;
+  }
+  for (i = 0; i < sizeof(payload); i++) {
+    payload[i] = (u8_t)i;
+  }
+  ret |= gen_tcp_upload(dir);
+  ret |= gen_tcp_download(dir);
+  ret |= gen_http_short(dir);
+  ret |= gen_udp(dir, "udp_small.pcap", 20000, 64);
+  ret |= gen_udp(dir, "udp_frag.pcap", 2000, 4000);
+  return ret ? 1 : 0;
+}
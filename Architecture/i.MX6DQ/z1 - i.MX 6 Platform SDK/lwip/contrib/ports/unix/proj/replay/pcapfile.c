@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Minimal reader for classic libpcap files, so the replay benchmark does not
+ * depend on libpcap. The whole file is read into memory up front: file I/O
+ * must not show up in the measurements.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pcapfile.h"
+
+#define PCAP_MAGIC_USEC     0xa1b2c3d4UL
+#define PCAP_MAGIC_NSEC     0xa1b23c4dUL
+#define PCAP_HDR_LEN        24
+#define PCAP_REC_HDR_LEN    16
+#define PCAP_LINKTYPE_ETHER 1
+
+static u32_t
+pcap_get32(const u8_t *p, int swapped)
+{
+  if (swapped) {
+    return ((u32_t)p[0] << 24) | ((u32_t)p[1] << 16) | ((u32_t)p[2] << 8) | p[3];
+  }
+  return ((u32_t)p[3] << 24) | ((u32_t)p[2] << 16) | ((u32_t)p[1] << 8) | p[0];
+}
+
+/**
+ * Load a pcap file into memory and index its frames.
+ *
+ * @param trace the trace to fill in
+ * @param path file to read
+ * @return 0 on success, -1 if the file can't be read or is no Ethernet pcap
+ */
+int
+pcap_trace_load(struct pcap_trace *trace, const char *path)
+{
+  FILE *f;
+  long size, off;
+  u32_t magic, count, usec_div;
+  unsigned long long t0 = 0;
+  int swapped;
+
+  memset(trace, 0, sizeof(*trace));
+  trace->name = path;
+
+  f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  fseek(f, 0, SEEK_END);
+  size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (size < PCAP_HDR_LEN) {
+    fprintf(stderr, "%s: not a pcap file\n", path);
+    fclose(f);
+    return -1;
+  }
+  trace->buf = (u8_t *)malloc(size);
+  if ((trace->buf == NULL) || (fread(trace->buf, 1, size, f) != (size_t)size)) {
+    fprintf(stderr, "%s: read failed\n", path);
+    fclose(f);
+    pcap_trace_free(trace);
+    return -1;
+  }
+  fclose(f);
+
+  /* the magic number tells both byte order and time stamp resolution */
+  magic = pcap_get32(trace->buf, 0);
+  swapped = 0;
+  if ((magic != PCAP_MAGIC_USEC) && (magic != PCAP_MAGIC_NSEC)) {
+    magic = pcap_get32(trace->buf, 1);
+    swapped = 1;
+  }
+  if ((magic != PCAP_MAGIC_USEC) && (magic != PCAP_MAGIC_NSEC)) {
+    fprintf(stderr, "%s: not a pcap file\n", path);
+    pcap_trace_free(trace);
+    return -1;
+  }
+  usec_div = (magic == PCAP_MAGIC_NSEC) ? 1000000 : 1000;
+  if ((pcap_get32(trace->buf + 20, swapped) & 0xffff) != PCAP_LINKTYPE_ETHER) {
+    fprintf(stderr, "%s: only Ethernet captures are supported\n", path);
+    pcap_trace_free(trace);
+    return -1;
+  }
+
+  /* first pass: count records, second pass: index them */
+  count = 0;
+  for (off = PCAP_HDR_LEN; off + PCAP_REC_HDR_LEN <= size; ) {
+    u32_t caplen = pcap_get32(trace->buf + off + 8, swapped);
+    if (off + PCAP_REC_HDR_LEN + (long)caplen > size) {
+      break;
+    }
+    off += PCAP_REC_HDR_LEN + caplen;
+    count++;
+  }
+  trace->frames = (struct pcap_frame *)calloc(count ? count : 1, sizeof(struct pcap_frame));
+  if (trace->frames == NULL) {
+    pcap_trace_free(trace);
+    return -1;
+  }
+  for (off = PCAP_HDR_LEN; trace->count < count; trace->count++) {
+    struct pcap_frame *frame = &trace->frames[trace->count];
+    const u8_t *rec = trace->buf + off;
+    unsigned long long ms = (unsigned long long)pcap_get32(rec, swapped) * 1000 +
+                            pcap_get32(rec + 4, swapped) / usec_div;
+    if (trace->count == 0) {
+      t0 = ms;
+    }
+    frame->ts_ms = (u32_t)(ms - t0);
+    frame->caplen = pcap_get32(rec + 8, swapped);
+    frame->len = pcap_get32(rec + 12, swapped);
+    frame->data = rec + PCAP_REC_HDR_LEN;
+    off += PCAP_REC_HDR_LEN + frame->caplen;
+  }
+  return 0;
+}
+
+void
+pcap_trace_free(struct pcap_trace *trace)
+{
+  free(trace->frames);
+  free(trace->buf);
+  trace->frames = NULL;
+  trace->buf = NULL;
+  trace->count = 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Timing wrappers for stack functions that have no PERF_START/PERF_STOP
+ * hook of their own. Linked with -Wl,--wrap=<function> (make PERF=1), so
+ * calls from other object files land here and the lwIP sources stay as they
+ * are. Calls from inside the function's own file (e.g. pbuf_alloc() in
+ * pbuf_coalesce()) bypass the wrapper and are not counted.
+ */
+
+#include "lwip/memp.h"
+#include "lwip/pbuf.h"
+#include "lwip/ip_frag.h"
+#include "arch/perf.h"
+
+#ifdef PERF_ACCUM
+
+#if MEMP_OVERFLOW_CHECK
+#error "memp_malloc() is a macro for memp_malloc_fn() with MEMP_OVERFLOW_CHECK"
+#endif /* MEMP_OVERFLOW_CHECK */
+
+struct pbuf *__real_pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+struct pbuf *__wrap_pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+void *__real_memp_malloc(memp_t type);
+void *__wrap_memp_malloc(memp_t type);
+struct pbuf *__real_ip_reass(struct pbuf *p);
+struct pbuf *__wrap_ip_reass(struct pbuf *p);
+
+struct pbuf *
+__wrap_pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type)
+{
+  struct pbuf *p;
+  PERF_START;
+
+  p = __real_pbuf_alloc(layer, length, type);
+  /* failed allocations are timed as well */
+  PERF_STOP("pbuf_alloc");
+  return p;
+}
+
+void *
+__wrap_memp_malloc(memp_t type)
+{
+  void *mem;
+  PERF_START;
+
+  mem = __real_memp_malloc(type);
+  PERF_STOP("memp_malloc");
+  return mem;
+}
+
+struct pbuf *
+__wrap_ip_reass(struct pbuf *p)
+{
+  PERF_START;
+
+  p = __real_ip_reass(p);
+  PERF_STOP("ip_reass");
+  return p;
+}
+
+#endif /* PERF_ACCUM */
@@ -0,0 +1,873 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Packet capture replay benchmark.
+ *
+ * Frames from a pcap trace that are addressed to one host (the "server",
+ * given with -a or taken from the first SYN in the trace) are copied into
+ * pool pbufs and handed to ethernet_input() of a netif that plays that host.
+ * Everything lwIP sends goes to a counting sink. Frames the server sent in
+ * the trace are not replayed but drive a responder instead:
+ *
+ * - TCP: each accepted connection writes as many bytes as the trace server
+ *   sent and closes when it closed. The client's acknowledgment numbers are
+ *   rebased onto lwIP's ISS (and clamped to snd_nxt), so bulk and
+ *   request/response flows keep moving instead of being reset.
+ * - UDP: every destination port in the trace gets a discarding pcb.
+ * - ARP requests from lwIP are answered by the sink.
+ *
+ * Timers run on the trace's own clock, so a replay is repeatable. Build with
+ * PERF=1 to also get the time spent in the stack's PERF_START/PERF_STOP hooks
+ * (pbuf_free, udp_input, tcp_input) and in the functions wrapped by
+ * perfwrap.c (pbuf_alloc, memp_malloc, ip_reass).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "lwip/init.h"
+#include "lwip/mem.h"
+#include "lwip/memp.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/sys.h"
+#include "lwip/timers.h"
+#include "lwip/ip.h"
+#include "lwip/udp.h"
+#include "lwip/tcp_impl.h"
+#include "netif/etharp.h"
+#include "arch/perf.h"
+
+#include "pcapfile.h"
+
+#define REPLAY_ETH_HLEN       14
+#define REPLAY_ETHTYPE_IP     0x0800
+#define REPLAY_ETHTYPE_ARP    0x0806
+#define REPLAY_PROTO_TCP      6
+#define REPLAY_PROTO_UDP      17
+#define REPLAY_TCP_FIN        0x01
+#define REPLAY_TCP_SYN        0x02
+#define REPLAY_TCP_ACK        0x10
+
+#define REPLAY_MAX_PORTS      16
+#define REPLAY_MAX_FLOWS      8192
+#define REPLAY_MAX_ARP        16
+#define REPLAY_MAX_FRAME      65536
+/** virtual time between two passes over a trace, lets reassembly and ARP expire */
+#define REPLAY_GAP_MS         (10 * 60 * 1000)
+
+#define GET16(p)  ((u16_t)(((p)[0] << 8) | (p)[1]))
+#define GET32(p)  (((u32_t)(p)[0] << 24) | ((u32_t)(p)[1] << 16) | \
+                   ((u32_t)(p)[2] << 8) | (p)[3])
+
+/* flow flags */
+#define FLOW_USED       0x01
+#define FLOW_TRACE_ISS  0x02
+#define FLOW_LWIP_ISS   0x04
+#define FLOW_CLOSE      0x08
+
+/** One TCP connection to the server, keyed by the client's address/port */
+struct flow {
+  u32_t client;         /* network byte order */
+  u16_t cport, sport;
+  u8_t flags;
+  u32_t trace_iss;      /* server ISS in the trace */
+  u32_t lwip_iss;       /* server ISS chosen by lwIP */
+  u32_t trace_nxt;      /* next server sequence number in the trace */
+  u32_t owed;           /* bytes the trace server sent that lwIP still has to */
+  struct tcp_pcb *pcb;
+};
+
+/** Counters for one replay */
+struct replay_stats {
+  unsigned long rx_frames, rx_bytes;
+  unsigned long server_frames, skipped, truncated, rewritten, dropped_acks;
+  unsigned long tx_frames, tx_bytes, arp_replies;
+  unsigned long long copy_ns, input_ns, output_ns, timer_ns;
+};
+
+static struct netif replay_netif;
+static ip_addr_t server_ip;
+static u32_t now_ms;
+static int fix_checksums;
+
+static struct flow flows[REPLAY_MAX_FLOWS];
+static struct replay_stats rs;
+
+static u32_t arp_pending[REPLAY_MAX_ARP];
+static int arp_npending;
+
+static struct tcp_pcb *tcp_listeners[REPLAY_MAX_PORTS];
+static struct udp_pcb *udp_sinks[REPLAY_MAX_PORTS];
+
+/** payload for the responder's writes */
+static u8_t pattern[TCP_SND_BUF];
+static u8_t scratch[REPLAY_MAX_FRAME];
+
+static const char *const pool_names[] = {
+#define LWIP_MEMPOOL(name,num,size,desc) desc,
+#include "lwip/memp_std.h"
+};
+
+u32_t
+sys_now(void)
+{
+  return now_ms;
+}
+
+static void
+put32(u8_t *p, u32_t v)
+{
+  p[0] = (u8_t)(v >> 24);
+  p[1] = (u8_t)(v >> 16);
+  p[2] = (u8_t)(v >> 8);
+  p[3] = (u8_t)v;
+}
+
+static u16_t
+replay_chksum(const u8_t *data, u32_t len, u32_t acc)
+{
+  while (len > 1) {
+    acc += GET16(data);
+    data += 2;
+    len -= 2;
+  }
+  if (len) {
+    acc += (u32_t)data[0] << 8;
+  }
+  while (acc >> 16) {
+    acc = (acc & 0xffff) + (acc >> 16);
+  }
+  return (u16_t)~acc;
+}
+
+/** Recompute the IP and (for unfragmented TCP/UDP) transport checksums */
+static void
+replay_fix_chksum(u8_t *ip, u32_t len)
+{
+  u32_t hlen = (ip[0] & 0x0f) * 4;
+  u32_t tlen = GET16(ip + 2);
+  u8_t proto = ip[9];
+  u8_t *th = ip + hlen;
+  u16_t sum;
+  int off;
+
+  if ((tlen > len) || (hlen > tlen)) {
+    return;
+  }
+  ip[10] = ip[11] = 0;
+  sum = replay_chksum(ip, hlen, 0);
+  ip[10] = (u8_t)(sum >> 8);
+  ip[11] = (u8_t)sum;
+
+  if (GET16(ip + 6) & 0x3fff) {
+    /* fragment: the transport checksum covers the whole datagram */
+    return;
+  }
+  if (proto == REPLAY_PROTO_TCP) {
+    off = 16;
+  } else if ((proto == REPLAY_PROTO_UDP) && (th[6] | th[7])) {
+    off = 6;
+  } else {
+    return;
+  }
+  th[off] = th[off + 1] = 0;
+  sum = replay_chksum(th, tlen - hlen,
+                      (u32_t)GET16(ip + 12) + GET16(ip + 14) + GET16(ip + 16) +
+                      GET16(ip + 18) + proto + (tlen - hlen));
+  if ((proto == REPLAY_PROTO_UDP) && (sum == 0)) {
+    sum = 0xffff;
+  }
+  th[off] = (u8_t)(sum >> 8);
+  th[off + 1] = (u8_t)sum;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/* flows */
+
+static struct flow *
+flow_find(u32_t client, u16_t cport, u16_t sport, int create)
+{
+  u32_t h = (client ^ (client >> 16) ^ ((u32_t)cport << 7) ^ sport) % REPLAY_MAX_FLOWS;
+  u32_t n;
+
+  for (n = 0; n < REPLAY_MAX_FLOWS; n++, h = (h + 1) % REPLAY_MAX_FLOWS) {
+    struct flow *flow = &flows[h];
+    if (!(flow->flags & FLOW_USED)) {
+      if (!create) {
+        return NULL;
+      }
+      memset(flow, 0, sizeof(*flow));
+      flow->flags = FLOW_USED;
+      flow->client = client;
+      flow->cport = cport;
+      flow->sport = sport;
+      return flow;
+    }
+    if ((flow->client == client) && (flow->cport == cport) && (flow->sport == sport)) {
+      return flow;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Write what lwIP owes the client (as far as the send buffer allows).
+ *
+ * @return ERR_ABRT if the pcb had to be aborted, ERR_OK otherwise
+ */
+static err_t
+flow_push(struct flow *flow)
+{
+  struct tcp_pcb *pcb = flow->pcb;
+  u32_t n;
+
+  if (pcb == NULL) {
+    return ERR_OK;
+  }
+  while (flow->owed > 0) {
+    n = LWIP_MIN(flow->owed, tcp_sndbuf(pcb));
+    if ((n == 0) || (tcp_write(pcb, pattern, (u16_t)n, TCP_WRITE_FLAG_COPY) != ERR_OK)) {
+      break;
+    }
+    flow->owed -= n;
+  }
+  if ((flow->owed == 0) && (flow->flags & FLOW_CLOSE)) {
+    tcp_arg(pcb, NULL);
+    flow->pcb = NULL;
+    if (tcp_close(pcb) != ERR_OK) {
+      tcp_abort(pcb);
+      return ERR_ABRT;
+    }
+    return ERR_OK;
+  }
+  tcp_output(pcb);
+  return ERR_OK;
+}
+
+static err_t
+replay_sent(void *arg, struct tcp_pcb *pcb, u16_t len)
+{
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(len);
+  if (arg != NULL) {
+    return flow_push((struct flow *)arg);
+  }
+  return ERR_OK;
+}
+
+static err_t
+replay_recv(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  /* on p == NULL, the trace decides when the server closes */
+  if (p != NULL) {
+    tcp_recved(pcb, p->tot_len);
+    pbuf_free(p);
+  }
+  return ERR_OK;
+}
+
+static void
+replay_err(void *arg, err_t err)
+{
+  LWIP_UNUSED_ARG(err);
+  if (arg != NULL) {
+    ((struct flow *)arg)->pcb = NULL;
+  }
+}
+
+static err_t
+replay_accept(void *arg, struct tcp_pcb *pcb, err_t err)
+{
+  struct flow *flow;
+
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(err);
+  flow = flow_find(ip4_addr_get_u32(ipX_2_ip(&pcb->remote_ip)), pcb->remote_port, pcb->local_port, 0);
+  tcp_arg(pcb, flow);
+  tcp_recv(pcb, replay_recv);
+  tcp_sent(pcb, replay_sent);
+  tcp_err(pcb, replay_err);
+  if (flow != NULL) {
+    flow->pcb = pcb;
+    return flow_push(flow);
+  }
+  return ERR_OK;
+}
+
+static void
+replay_udp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *addr, u16_t port)
+{
+  LWIP_UNUSED_ARG(arg);
+  LWIP_UNUSED_ARG(pcb);
+  LWIP_UNUSED_ARG(addr);
+  LWIP_UNUSED_ARG(port);
+  pbuf_free(p);
+}
+
+/*-----------------------------------------------------------------------------------*/
+/* netif */
+
+/** Counting sink: notes lwIP's ISS per flow and queues ARP replies */
+static err_t
+replay_linkoutput(struct netif *netif, struct pbuf *p)
+{
+  u8_t hdr[REPLAY_ETH_HLEN + 60 + 20];
+  u16_t len;
+
+  LWIP_UNUSED_ARG(netif);
+  rs.tx_frames++;
+  rs.tx_bytes += p->tot_len;
+
+  len = pbuf_copy_partial(p, hdr, sizeof(hdr), 0);
+  if (len < REPLAY_ETH_HLEN + 28) {
+    return ERR_OK;
+  }
+  if (GET16(hdr + 12) == REPLAY_ETHTYPE_ARP) {
+    /* ARP request: answer for the target address */
+    if ((GET16(hdr + 14 + 6) == 1) && (arp_npending < REPLAY_MAX_ARP)) {
+      memcpy(&arp_pending[arp_npending++], hdr + 14 + 24, 4);
+    }
+  } else if ((GET16(hdr + 12) == REPLAY_ETHTYPE_IP) && (hdr[14 + 9] == REPLAY_PROTO_TCP)) {
+    u8_t *th = hdr + 14 + (hdr[14] & 0x0f) * 4;
+    if ((th + 20 <= hdr + len) &&
+        ((th[13] & (REPLAY_TCP_SYN | REPLAY_TCP_ACK)) == (REPLAY_TCP_SYN | REPLAY_TCP_ACK))) {
+      u32_t client;
+      struct flow *flow;
+      memcpy(&client, hdr + 14 + 16, 4);
+      flow = flow_find(client, GET16(th + 2), GET16(th), 0);
+      if (flow != NULL) {
+        flow->lwip_iss = GET32(th + 4);
+        flow->flags |= FLOW_LWIP_ISS;
+      }
+    }
+  }
+  return ERR_OK;
+}
+
+static err_t
+replay_netif_init(struct netif *netif)
+{
+  netif->name[0] = 'r';
+  netif->name[1] = 'p';
+  netif->output = etharp_output;
+  netif->linkoutput = replay_linkoutput;
+  netif->mtu = 1500;
+  netif->hwaddr_len = ETHARP_HWADDR_LEN;
+  netif->hwaddr[0] = 0x02;
+  netif->hwaddr[5] = 0x01;
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/** Hand one frame to the stack the way a driver would */
+static void
+replay_input(const u8_t *frame, u32_t len)
+{
+  struct pbuf *p;
+  unsigned long long t0, t1;
+
+  t0 = perf_now_ns();
+  p = pbuf_alloc(PBUF_RAW, (u16_t)len, PBUF_POOL);
+  if (p == NULL) {
+    return;
+  }
+  pbuf_take(p, frame, (u16_t)len);
+  t1 = perf_now_ns();
+  if (replay_netif.input(p, &replay_netif) != ERR_OK) {
+    pbuf_free(p);
+  }
+  rs.copy_ns += t1 - t0;
+  rs.input_ns += perf_now_ns() - t1;
+}
+
+/** Deliver the ARP replies queued by the sink */
+static void
+replay_arp_replies(void)
+{
+  u8_t frame[REPLAY_ETH_HLEN + 28];
+  u8_t *arp = frame + REPLAY_ETH_HLEN;
+  int i;
+
+  for (i = 0; i < arp_npending; i++) {
+    u32_t ip = arp_pending[i];
+    memcpy(frame, replay_netif.hwaddr, 6);
+    /* locally administered MAC derived from the address */
+    frame[6] = 0x02;
+    frame[7] = 0x00;
+    memcpy(frame + 8, &ip, 4);
+    frame[12] = REPLAY_ETHTYPE_ARP >> 8;
+    frame[13] = REPLAY_ETHTYPE_ARP & 0xff;
+    arp[0] = 0; arp[1] = 1;                 /* Ethernet */
+    arp[2] = 0x08; arp[3] = 0x00;           /* IPv4 */
+    arp[4] = 6; arp[5] = 4;
+    arp[6] = 0; arp[7] = 2;                 /* reply */
+    memcpy(arp + 8, frame + 6, 6);
+    memcpy(arp + 14, &ip, 4);
+    memcpy(arp + 18, replay_netif.hwaddr, 6);
+    memcpy(arp + 24, &ip4_addr_get_u32(&replay_netif.ip_addr), 4);
+    rs.arp_replies++;
+    replay_input(frame, sizeof(frame));
+  }
+  arp_npending = 0;
+}
+
+/*-----------------------------------------------------------------------------------*/
+/* replay */
+
+/** The trace server sent this TCP segment: let lwIP send the same amount */
+static void
+replay_server_tcp(u32_t client, const u8_t *ip, u32_t iplen)
+{
+  const u8_t *th = ip + (ip[0] & 0x0f) * 4;
+  u32_t seq, end, datalen;
+  struct flow *flow;
+
+  if ((u32_t)(th - ip) + 20 > iplen) {
+    return;
+  }
+  flow = flow_find(client, GET16(th + 2), GET16(th), 0);
+  if (flow == NULL) {
+    return;
+  }
+  seq = GET32(th + 4);
+  if (th[13] & REPLAY_TCP_SYN) {
+    flow->trace_iss = seq;
+    flow->trace_nxt = seq + 1;
+    flow->flags |= FLOW_TRACE_ISS;
+    return;
+  }
+  if (!(flow->flags & FLOW_TRACE_ISS)) {
+    return;
+  }
+  datalen = iplen - (u32_t)(th - ip) - (th[12] >> 4) * 4;
+  end = seq + datalen;
+  if (TCP_SEQ_GT(end, flow->trace_nxt)) {
+    flow->owed += end - (TCP_SEQ_GT(seq, flow->trace_nxt) ? seq : flow->trace_nxt);
+    flow->trace_nxt = end;
+  }
+  if (th[13] & REPLAY_TCP_FIN) {
+    flow->flags |= FLOW_CLOSE;
+  }
+  if (flow->pcb != NULL) {
+    unsigned long long t0 = perf_now_ns();
+    flow_push(flow);
+    rs.output_ns += perf_now_ns() - t0;
+  }
+}
+
+/**
+ * Client to server TCP segment: rebase its acknowledgment onto lwIP's ISS.
+ *
+ * @return 0 if the segment must not be replayed
+ */
+static int
+replay_client_tcp(u8_t *ip, u32_t iplen)
+{
+  u8_t *th = ip + (ip[0] & 0x0f) * 4;
+  struct flow *flow;
+  u32_t client, ack;
+
+  if ((u32_t)(th - ip) + 20 > iplen) {
+    return 1;
+  }
+  memcpy(&client, ip + 12, 4);
+  if ((th[13] & (REPLAY_TCP_SYN | REPLAY_TCP_ACK)) == REPLAY_TCP_SYN) {
+    /* new connection (or a reused port): start over */
+    flow = flow_find(client, GET16(th), GET16(th + 2), 1);
+    if (flow != NULL) {
+      flow->flags = FLOW_USED;
+      flow->owed = 0;
+    }
+    return 1;
+  }
+  flow = flow_find(client, GET16(th), GET16(th + 2), 0);
+  if ((flow == NULL) || !(th[13] & REPLAY_TCP_ACK) ||
+      ((flow->flags & (FLOW_TRACE_ISS | FLOW_LWIP_ISS)) != (FLOW_TRACE_ISS | FLOW_LWIP_ISS))) {
+    return 1;
+  }
+  ack = GET32(th + 8) - flow->trace_iss + flow->lwip_iss;
+  if ((flow->pcb != NULL) && TCP_SEQ_GT(ack, flow->pcb->snd_nxt)) {
+    /* lwIP is behind the trace server (send buffer, cwnd): don't ack unsent
+       data, and don't turn pure acks into duplicate acks either, that would
+       trigger fast retransmits the trace never had */
+    ack = flow->pcb->snd_nxt;
+    if ((ack == flow->pcb->lastack) && (iplen == (u32_t)(th - ip) + (th[12] >> 4) * 4) &&
+        !(th[13] & REPLAY_TCP_FIN)) {
+      rs.dropped_acks++;
+      return 0;
+    }
+  }
+  if (ack != GET32(th + 8)) {
+    put32(th + 8, ack);
+    rs.rewritten++;
+    replay_fix_chksum(ip, iplen);
+  }
+  return 1;
+}
+
+static void
+replay_frame(const struct pcap_frame *frame)
+{
+  u8_t *ip = scratch + REPLAY_ETH_HLEN;
+  u32_t iplen, src, dst, server = ip4_addr_get_u32(&server_ip);
+  u16_t type;
+
+  if ((frame->caplen < frame->len) || (frame->len < REPLAY_ETH_HLEN + 20) ||
+      (frame->len >= REPLAY_MAX_FRAME)) {
+    rs.truncated++;
+    return;
+  }
+  type = GET16(frame->data + 12);
+  if (type == REPLAY_ETHTYPE_ARP) {
+    /* requests for the server only, lwIP answers them itself */
+    if ((frame->len >= REPLAY_ETH_HLEN + 28) &&
+        (memcmp(frame->data + REPLAY_ETH_HLEN + 24, &server, 4) == 0) &&
+        (GET16(frame->data + REPLAY_ETH_HLEN + 6) == 1)) {
+      replay_input(frame->data, frame->len);
+      rs.rx_frames++;
+      rs.rx_bytes += frame->len;
+    } else {
+      rs.skipped++;
+    }
+    return;
+  }
+  if ((type != REPLAY_ETHTYPE_IP) || ((frame->data[REPLAY_ETH_HLEN] >> 4) != 4)) {
+    rs.skipped++;
+    return;
+  }
+  memcpy(&src, frame->data + REPLAY_ETH_HLEN + 12, 4);
+  memcpy(&dst, frame->data + REPLAY_ETH_HLEN + 16, 4);
+  iplen = frame->len - REPLAY_ETH_HLEN;
+
+  if (src == server) {
+    rs.server_frames++;
+    if (frame->data[REPLAY_ETH_HLEN + 9] == REPLAY_PROTO_TCP) {
+      replay_server_tcp(dst, frame->data + REPLAY_ETH_HLEN, iplen);
+    }
+    return;
+  }
+  if (dst != server) {
+    rs.skipped++;
+    return;
+  }
+
+  memcpy(scratch, frame->data, frame->len);
+  if (fix_checksums) {
+    replay_fix_chksum(ip, iplen);
+  }
+  if ((ip[9] == REPLAY_PROTO_TCP) && !replay_client_tcp(ip, iplen)) {
+    return;
+  }
+  replay_input(scratch, frame->len);
+  replay_arp_replies();
+  rs.rx_frames++;
+  rs.rx_bytes += frame->len;
+}
+
+/** Let virtual time pass, running lwIP's timers */
+static void
+replay_advance(u32_t to_ms)
+{
+  unsigned long long t0 = perf_now_ns();
+
+  while ((s32_t)(to_ms - now_ms) > 0) {
+    now_ms += LWIP_MIN(to_ms - now_ms, TCP_TMR_INTERVAL);
+    sys_check_timeouts();
+  }
+  rs.timer_ns += perf_now_ns() - t0;
+}
+
+/** Pick the server address: destination of the first SYN, else of the first IPv4 packet */
+static int
+replay_find_server(const struct pcap_trace *trace, ip_addr_t *addr)
+{
+  u32_t i;
+  int found = 0;
+
+  for (i = 0; i < trace->count; i++) {
+    const u8_t *ip = trace->frames[i].data + REPLAY_ETH_HLEN;
+    if ((trace->frames[i].caplen < REPLAY_ETH_HLEN + 40) ||
+        (GET16(trace->frames[i].data + 12) != REPLAY_ETHTYPE_IP)) {
+      continue;
+    }
+    if (!found) {
+      memcpy(&ip4_addr_get_u32(addr), ip + 16, 4);
+      found = 1;
+    }
+    if ((ip[9] == REPLAY_PROTO_TCP) &&
+        ((ip[(ip[0] & 0x0f) * 4 + 13] & (REPLAY_TCP_SYN | REPLAY_TCP_ACK)) == REPLAY_TCP_SYN)) {
+      memcpy(&ip4_addr_get_u32(addr), ip + 16, 4);
+      return 1;
+    }
+  }
+  return found;
+}
+
+/** Open a listener for every TCP port and a sink for every UDP port the clients use */
+static void
+replay_open_ports(const struct pcap_trace *trace)
+{
+  u32_t i, server = ip4_addr_get_u32(&server_ip);
+  int k, ntcp = 0, nudp = 0;
+
+  for (i = 0; i < trace->count; i++) {
+    const u8_t *ip = trace->frames[i].data + REPLAY_ETH_HLEN;
+    const u8_t *th;
+    u16_t port;
+    if ((trace->frames[i].caplen < REPLAY_ETH_HLEN + 40) ||
+        (GET16(trace->frames[i].data + 12) != REPLAY_ETHTYPE_IP) ||
+        (memcmp(ip + 16, &server, 4) != 0) || (GET16(ip + 6) & 0x1fff)) {
+      continue;
+    }
+    th = ip + (ip[0] & 0x0f) * 4;
+    port = GET16(th + 2);
+    if ((ip[9] == REPLAY_PROTO_TCP) && (th[13] & REPLAY_TCP_SYN) && (ntcp < REPLAY_MAX_PORTS)) {
+      for (k = 0; (k < ntcp) && (tcp_listeners[k]->local_port != port); k++);
+      if (k == ntcp) {
+        struct tcp_pcb *pcb = tcp_new();
+        if ((pcb != NULL) && (tcp_bind(pcb, IP_ADDR_ANY, port) == ERR_OK) &&
+            ((tcp_listeners[ntcp] = tcp_listen(pcb)) != NULL)) {
+          tcp_accept(tcp_listeners[ntcp++], replay_accept);
+        }
+      }
+    } else if ((ip[9] == REPLAY_PROTO_UDP) && (nudp < REPLAY_MAX_PORTS)) {
+      for (k = 0; (k < nudp) && (udp_sinks[k]->local_port != port); k++);
+      if (k == nudp) {
+        struct udp_pcb *pcb = udp_new();
+        if ((pcb != NULL) && (udp_bind(pcb, IP_ADDR_ANY, port) == ERR_OK)) {
+          udp_recv(pcb, replay_udp_recv, NULL);
+          udp_sinks[nudp++] = pcb;
+        }
+      }
+    }
+  }
+}
+
+static void
+replay_close_ports(void)
+{
+  int k;
+
+  for (k = 0; k < REPLAY_MAX_PORTS; k++) {
+    if (tcp_listeners[k] != NULL) {
+      tcp_close(tcp_listeners[k]);
+      tcp_listeners[k] = NULL;
+    }
+    if (udp_sinks[k] != NULL) {
+      udp_remove(udp_sinks[k]);
+      udp_sinks[k] = NULL;
+    }
+  }
+}
+
+/** Drop all connections of a pass, so the next pass starts from scratch */
+static void
+replay_reset_flows(void)
+{
+  while (tcp_active_pcbs != NULL) {
+    tcp_abort(tcp_active_pcbs);
+  }
+  while (tcp_tw_pcbs != NULL) {
+    tcp_abort(tcp_tw_pcbs);
+  }
+  memset(flows, 0, sizeof(flows));
+}
+
+static void
+replay_reset_stats(void)
+{
+  int i;
+
+  memset(&rs, 0, sizeof(rs));
+  for (i = 0; i < MEMP_MAX; i++) {
+    lwip_stats.memp[i].max = lwip_stats.memp[i].used;
+    lwip_stats.memp[i].err = 0;
+  }
+  lwip_stats.mem.max = lwip_stats.mem.used;
+  lwip_stats.mem.err = 0;
+  memset(&lwip_stats.link, 0, sizeof(lwip_stats.link));
+  memset(&lwip_stats.etharp, 0, sizeof(lwip_stats.etharp));
+  memset(&lwip_stats.ip_frag, 0, sizeof(lwip_stats.ip_frag));
+  memset(&lwip_stats.ip, 0, sizeof(lwip_stats.ip));
+  memset(&lwip_stats.icmp, 0, sizeof(lwip_stats.icmp));
+  memset(&lwip_stats.udp, 0, sizeof(lwip_stats.udp));
+  memset(&lwip_stats.tcp, 0, sizeof(lwip_stats.tcp));
+#ifdef PERF_ACCUM
+  perf_reset();
+#endif /* PERF_ACCUM */
+}
+
+static void
+replay_report_proto(const char *name, struct stats_proto *proto)
+{
+  printf("  %-8s %10"U32_F" %10"U32_F" %8"U32_F" %8"U32_F" %8"U32_F"\n", name,
+         (u32_t)proto->recv, (u32_t)proto->xmit, (u32_t)proto->drop,
+         (u32_t)proto->chkerr, (u32_t)proto->memerr);
+}
+
+static void
+replay_report(const struct pcap_trace *trace, int passes)
+{
+  unsigned long long stack_ns = rs.input_ns + rs.output_ns;
+  unsigned long pkts = rs.rx_frames ? rs.rx_frames : 1;
+  double secs = (double)(rs.copy_ns + stack_ns) / 1e9;
+  int i;
+
+  printf("%s: %"U32_F" frames, server %s, %d pass(es)\n", trace->name, trace->count,
+         ipaddr_ntoa(&server_ip), passes);
+  printf("  replayed %lu frames (%lu bytes), server side %lu, skipped %lu, truncated %lu\n",
+         rs.rx_frames, rs.rx_bytes, rs.server_frames, rs.skipped, rs.truncated);
+  printf("  acks rebased %lu, held back %lu\n", rs.rewritten, rs.dropped_acks);
+  printf("  sent %lu frames (%lu bytes), %lu ARP replies\n",
+         rs.tx_frames, rs.tx_bytes, rs.arp_replies);
+  if (secs > 0) {
+    printf("  %.0f pkts/s, %.1f Mbit/s\n", rs.rx_frames / secs, rs.rx_bytes * 8 / secs / 1e6);
+  }
+  printf("  ns/pkt: copy-in %.1f, input %.1f, responder output %.1f, total %.1f (timers %.1f)\n",
+         (double)rs.copy_ns / pkts, (double)rs.input_ns / pkts, (double)rs.output_ns / pkts,
+         (double)(rs.copy_ns + stack_ns) / pkts, (double)rs.timer_ns / pkts);
+#ifdef PERF_ACCUM
+  perf_report(pkts);
+#endif /* PERF_ACCUM */
+  printf("  %-8s %10s %10s %8s %8s %8s\n", "proto", "recv", "xmit", "drop", "chkerr", "memerr");
+  replay_report_proto("link", &lwip_stats.link);
+  replay_report_proto("etharp", &lwip_stats.etharp);
+  replay_report_proto("ip", &lwip_stats.ip);
+  replay_report_proto("ip_frag", &lwip_stats.ip_frag);
+  replay_report_proto("icmp", &lwip_stats.icmp);
+  replay_report_proto("udp", &lwip_stats.udp);
+  replay_report_proto("tcp", &lwip_stats.tcp);
+  printf("  %-16s %8s %8s %8s\n", "pool", "used", "max", "err");
+  printf("  %-16s %8"U32_F" %8"U32_F" %8"U32_F"\n", "HEAP", (u32_t)lwip_stats.mem.used,
+         (u32_t)lwip_stats.mem.max, (u32_t)lwip_stats.mem.err);
+  for (i = 0; i < MEMP_MAX; i++) {
+    printf("  %-16s %8"U32_F" %8"U32_F" %8"U32_F"\n", pool_names[i], (u32_t)lwip_stats.memp[i].used,
+           (u32_t)lwip_stats.memp[i].max, (u32_t)lwip_stats.memp[i].err);
+  }
+}
+
+static int
+replay_trace(const char *path, int passes, ip_addr_t *addr)
+{
+  struct pcap_trace trace;
+  int pass;
+  u32_t i, base;
+
+  if (pcap_trace_load(&trace, path) != 0) {
+    return -1;
+  }
+  if (addr != NULL) {
+    ip_addr_copy(server_ip, *addr);
+  } else if (!replay_find_server(&trace, &server_ip)) {
+    fprintf(stderr, "%s: no IPv4 traffic\n", path);
+    pcap_trace_free(&trace);
+    return -1;
+  }
+  netif_set_ipaddr(&replay_netif, &server_ip);
+  replay_open_ports(&trace);
+  replay_reset_stats();
+
+  for (pass = 0; pass < passes; pass++) {
+    base = now_ms;
+    for (i = 0; i < trace.count; i++) {
+      replay_advance(base + trace.frames[i].ts_ms);
+      replay_frame(&trace.frames[i]);
+    }
+    replay_reset_flows();
+    replay_advance(now_ms + REPLAY_GAP_MS);
+  }
+
+  replay_report(&trace, passes);
+  replay_close_ports();
+  pcap_trace_free(&trace);
+  return 0;
+}
+
+static void
+usage(const char *prog)
+{
+  printf("usage: %s [-n passes] [-a server-ip] [-f] trace.pcap...\n", prog);
+  printf("  -n  replay every trace this many times (default 1)\n");
+  printf("  -a  address of the host lwIP plays (default: target of the first SYN)\n");
+  printf("  -f  recompute checksums (traces captured with checksum offload)\n");
+}
+
+int
+main(int argc, char **argv)
+{
+  ip_addr_t addr, any;
+  int ch, passes = 1, have_addr = 0, ret = 0;
+
+  while ((ch = getopt(argc, argv, "n:a:fh")) != -1) {
+    switch (ch) {
+    case 'n':
+      passes = atoi(optarg);
+      break;
+    case 'a':
+      if (!ipaddr_aton(optarg, &addr)) {
+        usage(argv[0]);
+        return 1;
+      }
+      have_addr = 1;
+      break;
+    case 'f':
+      fix_checksums = 1;
+      break;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if ((optind >= argc) || (passes < 1)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  memset(pattern, 'x', sizeof(pattern));
+  lwip_init();
+  /* netmask 0: every client is on-link, lwIP resolves it via (our) ARP */
+  ip_addr_set_zero(&any);
+  netif_add(&replay_netif, &any, &any, &any, NULL, replay_netif_init, ethernet_input);
+  netif_set_default(&replay_netif);
+  netif_set_up(&replay_netif);
+
+  for (; optind < argc; optind++) {
+    if (replay_trace(argv[optind], passes, have_addr ? &addr : NULL) != 0) {
+      ret = 1;
+    }
+  }
+  return ret;
+}
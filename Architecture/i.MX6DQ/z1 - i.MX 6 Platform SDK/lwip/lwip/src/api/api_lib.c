@@ -591,6 +591,40 @@ netconn_send(struct netconn *conn, struct netbuf *buf)
   return err;
 }
 
+#if LWIP_UDP
+/**
+ * Send several datagrams over a UDP netconn with a single call into the
+ * tcpip_thread. Each netbuf is sent like netconn_send() does (to buf->addr
+ * and buf->port, or to the connected remote if buf->addr is 'any').
+ * Sending stops at the first datagram that fails.
+ *
+ * @param conn the UDP netconn over which to send data
+ * @param bufs array of netbufs containing the datagrams to send
+ * @param count number of netbufs in bufs
+ * @param sent number of datagrams that were sent is stored here
+ * @return ERR_OK if all datagrams were sent, any other err_t on error
+ */
+err_t
+netconn_send_batch(struct netconn *conn, struct netbuf *bufs, u16_t count, u16_t *sent)
+{
+  struct api_msg msg;
+  err_t err;
+
+  LWIP_ERROR("netconn_send_batch: invalid conn",  (conn != NULL), return ERR_ARG;);
+  LWIP_ERROR("netconn_send_batch: invalid sent",  (sent != NULL), return ERR_ARG;);
+
+  LWIP_DEBUGF(API_LIB_DEBUG, ("netconn_send_batch: sending %"U16_F" datagrams\n", count));
+  msg.msg.conn = conn;
+  msg.msg.msg.sb.bufs = bufs;
+  msg.msg.msg.sb.count = count;
+  TCPIP_APIMSG(&msg, lwip_netconn_do_send_batch, err);
+  *sent = msg.msg.msg.sb.sent;
+
+  NETCONN_SET_SAFE_ERR(conn, err);
+  return err;
+}
+#endif /* LWIP_UDP */
+
 /**
  * Send data over a TCP netconn.
  *
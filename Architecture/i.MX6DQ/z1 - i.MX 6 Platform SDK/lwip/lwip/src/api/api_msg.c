@@ -1184,6 +1184,80 @@ lwip_netconn_do_send(struct api_msg_msg *msg)
   TCPIP_APIMSG_ACK(msg);
 }
 
+#if LWIP_UDP
+/**
+ * Send several datagrams on a UDP pcb contained in a netconn.
+ * The route is looked up once per destination (not once per datagram) and
+ * the outgoing netif sees the whole batch inside netif_tx_batch_begin()/
+ * netif_tx_batch_end(), so it can start transmission once.
+ * Called from netconn_send_batch
+ *
+ * @param msg the api_msg_msg pointing to the connection
+ */
+void
+lwip_netconn_do_send_batch(struct api_msg_msg *msg)
+{
+  struct udp_pcb *pcb = msg->conn->pcb.udp;
+  struct netif *netif = NULL;
+  ipX_addr_t *route_ip = NULL;
+  u16_t i;
+
+  msg->msg.sb.sent = 0;
+  if (ERR_IS_FATAL(msg->conn->last_err)) {
+    msg->err = msg->conn->last_err;
+  } else if ((pcb == NULL) || (NETCONNTYPE_GROUP(msg->conn->type) != NETCONN_UDP)) {
+    msg->err = ERR_CONN;
+  } else {
+    msg->err = ERR_OK;
+    for (i = 0; i < msg->msg.sb.count; i++) {
+      struct netbuf *buf = &msg->msg.sb.bufs[i];
+      ipX_addr_t *dst_ip;
+      u16_t dst_port;
+
+      if (ipX_addr_isany(PCB_ISIPV6(pcb), &buf->addr)) {
+        /* like udp_send(): to the connected remote */
+        dst_ip = &pcb->remote_ip;
+        dst_port = pcb->remote_port;
+      } else {
+        dst_ip = &buf->addr;
+        dst_port = buf->port;
+      }
+      if ((route_ip == NULL) || !ipX_addr_cmp(PCB_ISIPV6(pcb), route_ip, dst_ip)) {
+        struct netif *next = udp_route(pcb, ipX_2_ip(dst_ip));
+        if (next != netif) {
+          if (netif != NULL) {
+            netif_tx_batch_end(netif);
+          }
+          if (next != NULL) {
+            netif_tx_batch_begin(next);
+          }
+          netif = next;
+        }
+        if (netif == NULL) {
+          msg->err = ERR_RTE;
+          break;
+        }
+        route_ip = dst_ip;
+      }
+#if LWIP_CHECKSUM_ON_COPY
+      msg->err = udp_sendto_if_chksum(pcb, buf->p, ipX_2_ip(dst_ip), dst_port, netif,
+        buf->flags & NETBUF_FLAG_CHKSUM, buf->toport_chksum);
+#else /* LWIP_CHECKSUM_ON_COPY */
+      msg->err = udp_sendto_if(pcb, buf->p, ipX_2_ip(dst_ip), dst_port, netif);
+#endif /* LWIP_CHECKSUM_ON_COPY */
+      if (msg->err != ERR_OK) {
+        break;
+      }
+      msg->msg.sb.sent++;
+    }
+    if (netif != NULL) {
+      netif_tx_batch_end(netif);
+    }
+  }
+  TCPIP_APIMSG_ACK(msg);
+}
+#endif /* LWIP_UDP */
+
 #if LWIP_TCP
 /**
  * Indicate data has been received from a TCP pcb contained in a netconn
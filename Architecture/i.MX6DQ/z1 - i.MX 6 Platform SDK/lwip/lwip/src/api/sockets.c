@@ -1014,6 +1014,261 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
   return (err == ERR_OK ? short_size : -1);
 }
 
+#if LWIP_UDP
+/**
+ * Set up a netbuf (allocated by the caller, e.g. on the stack) to send the
+ * datagram described by a msghdr. The data is referenced, not copied,
+ * unless LWIP_NETIF_TX_SINGLE_PBUF is enabled.
+ *
+ * @param sock the UDP socket to send on
+ * @param msg the datagram: destination (or NULL) and iovecs
+ * @param buf the netbuf to set up; netbuf_free() it after sending
+ * @return ERR_OK if buf is ready to send, an err_t otherwise
+ */
+static err_t
+lwip_msghdr_to_netbuf(struct lwip_sock *sock, const struct msghdr *msg, struct netbuf *buf)
+{
+  const struct sockaddr *to = (const struct sockaddr *)msg->msg_name;
+  size_t size = 0;
+  u16_t remote_port;
+  int i;
+
+  buf->p = buf->ptr = NULL;
+#if LWIP_CHECKSUM_ON_COPY
+  buf->flags = 0;
+#endif /* LWIP_CHECKSUM_ON_COPY */
+
+  if ((msg->msg_control != NULL) || (msg->msg_iovlen < 0) ||
+      ((msg->msg_iovlen > 0) && (msg->msg_iov == NULL))) {
+    return ERR_VAL;
+  }
+  if (to != NULL) {
+    if (!IS_SOCK_ADDR_LEN_VALID(msg->msg_namelen) || !IS_SOCK_ADDR_TYPE_VALID(to) ||
+        !IS_SOCK_ADDR_ALIGNED(to) || !SOCK_ADDR_TYPE_MATCH(to, sock)) {
+      return ERR_VAL;
+    }
+    SOCKADDR_TO_IPXADDR_PORT((to->sa_family) == AF_INET6, to, &buf->addr, remote_port);
+  } else {
+    remote_port = 0;
+    ipX_addr_set_any(NETCONNTYPE_ISIPV6(netconn_type(sock->conn)), &buf->addr);
+  }
+  netbuf_fromport(buf) = remote_port;
+
+  for (i = 0; i < msg->msg_iovlen; i++) {
+    size += msg->msg_iov[i].iov_len;
+  }
+  if (size > 0xffff) {
+    return ERR_VAL;
+  }
+
+#if LWIP_NETIF_TX_SINGLE_PBUF
+  /* Allocate a new netbuf and copy the data into it. */
+  if (netbuf_alloc(buf, (u16_t)size) == NULL) {
+    return ERR_MEM;
+  }
+  size = 0;
+  for (i = 0; i < msg->msg_iovlen; i++) {
+    MEMCPY((u8_t*)buf->p->payload + size, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+    size += msg->msg_iov[i].iov_len;
+  }
+#else /* LWIP_NETIF_TX_SINGLE_PBUF */
+  /* one PBUF_REF per iovec, the first one has room for the headers */
+  if (netbuf_ref(buf, (msg->msg_iovlen > 0) ? msg->msg_iov[0].iov_base : NULL,
+      (u16_t)((msg->msg_iovlen > 0) ? msg->msg_iov[0].iov_len : 0)) != ERR_OK) {
+    return ERR_MEM;
+  }
+  for (i = 1; i < msg->msg_iovlen; i++) {
+    struct pbuf *q;
+    if (msg->msg_iov[i].iov_len == 0) {
+      continue;
+    }
+    q = pbuf_alloc(PBUF_RAW, (u16_t)msg->msg_iov[i].iov_len, PBUF_REF);
+    if (q == NULL) {
+      netbuf_free(buf);
+      return ERR_MEM;
+    }
+    q->payload = msg->msg_iov[i].iov_base;
+    pbuf_cat(buf->p, q);
+  }
+#endif /* LWIP_NETIF_TX_SINGLE_PBUF */
+  return ERR_OK;
+}
+
+/**
+ * Send several datagrams on a UDP socket. Up to LWIP_SOCKET_BATCH_MAX
+ * datagrams are handed to the tcpip_thread at once, so the cost of the
+ * thread switch, the route lookup and starting the transmitter is paid
+ * per batch rather than per datagram.
+ *
+ * @param s the UDP socket
+ * @param msgvec the datagrams to send; msg_len is set for each one sent
+ * @param vlen number of entries in msgvec
+ * @param flags not used (sending on UDP never blocks)
+ * @return number of datagrams sent, or -1 if none could be sent
+ */
+int
+lwip_sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+  struct lwip_sock *sock;
+  struct netbuf bufs[LWIP_SOCKET_BATCH_MAX];
+  unsigned int done = 0;
+  u16_t count, sent, i;
+  err_t err = ERR_OK;
+  err_t send_err;
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_sendmmsg(%d, msgvec=%p, vlen=%u, flags=0x%x)\n",
+                              s, (void *)msgvec, vlen, flags));
+  LWIP_UNUSED_ARG(flags);
+
+  sock = get_socket(s);
+  if (!sock) {
+    return -1;
+  }
+  if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) != NETCONN_UDP) {
+    sock_set_errno(sock, EOPNOTSUPP);
+    return -1;
+  }
+
+  while ((done < vlen) && (err == ERR_OK)) {
+    for (count = 0; (count < LWIP_SOCKET_BATCH_MAX) && (done + count < vlen); count++) {
+      err = lwip_msghdr_to_netbuf(sock, &msgvec[done + count].msg_hdr, &bufs[count]);
+      if (err != ERR_OK) {
+        break;
+      }
+    }
+    if (count == 0) {
+      break;
+    }
+    send_err = netconn_send_batch(sock->conn, bufs, count, &sent);
+    for (i = 0; i < count; i++) {
+      if (i < sent) {
+        msgvec[done + i].msg_len = bufs[i].p->tot_len;
+      }
+      netbuf_free(&bufs[i]);
+    }
+    done += sent;
+    if (err == ERR_OK) {
+      err = send_err;
+    }
+  }
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_sendmmsg(%d) err=%d sent=%u\n", s, err, done));
+  if (done > 0) {
+    sock_set_errno(sock, 0);
+    return (int)done;
+  }
+  sock_set_errno(sock, err_to_errno(err));
+  return -1;
+}
+
+/**
+ * Receive several datagrams from a UDP socket. Blocks (unless MSG_DONTWAIT
+ * is given or the socket is non-blocking) until the first datagram arrives,
+ * then returns as many as are already queued, up to vlen.
+ *
+ * @param s the UDP socket
+ * @param msgvec buffers for the datagrams; msg_len, msg_flags (MSG_TRUNC)
+ *        and msg_name/msg_namelen are filled in for each one received
+ * @param vlen number of entries in msgvec
+ * @param flags MSG_DONTWAIT and MSG_PEEK (which returns one datagram only)
+ * @param timeout not supported, must be NULL (use SO_RCVTIMEO instead);
+ *        a timeout fails with EINVAL
+ * @return number of datagrams received, or -1 on error
+ */
+int
+lwip_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+              struct timeval *timeout)
+{
+  struct lwip_sock *sock;
+  struct netbuf *buf;
+  unsigned int done;
+  err_t err;
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_recvmmsg(%d, msgvec=%p, vlen=%u, flags=0x%x)\n",
+                              s, (void *)msgvec, vlen, flags));
+  sock = get_socket(s);
+  if (!sock) {
+    return -1;
+  }
+  if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) != NETCONN_UDP) {
+    sock_set_errno(sock, EOPNOTSUPP);
+    return -1;
+  }
+  if (timeout != NULL) {
+    sock_set_errno(sock, EINVAL);
+    return -1;
+  }
+
+  for (done = 0; done < vlen; done++) {
+    struct msghdr *msg = &msgvec[done].msg_hdr;
+    struct pbuf *p;
+    u16_t off = 0;
+    int i;
+
+    if (sock->lastdata != NULL) {
+      /* left by MSG_PEEK */
+      buf = (struct netbuf *)sock->lastdata;
+      sock->lastdata = NULL;
+    } else {
+      if (sock->rcvevent <= 0) {
+        /* nothing queued: only wait for the first datagram */
+        if (done > 0) {
+          break;
+        }
+        if ((flags & MSG_DONTWAIT) || netconn_is_nonblocking(sock->conn)) {
+          sock_set_errno(sock, EWOULDBLOCK);
+          return -1;
+        }
+      }
+      err = netconn_recv(sock->conn, &buf);
+      if (err != ERR_OK) {
+        if (done > 0) {
+          break;
+        }
+        sock_set_errno(sock, err_to_errno(err));
+        return (err == ERR_CLSD) ? 0 : -1;
+      }
+    }
+
+    /* copy the datagram into the iovecs */
+    p = buf->p;
+    for (i = 0; (i < msg->msg_iovlen) && (off < p->tot_len); i++) {
+      u16_t copylen = p->tot_len - off;
+      if (msg->msg_iov[i].iov_len < copylen) {
+        copylen = (u16_t)msg->msg_iov[i].iov_len;
+      }
+      pbuf_copy_partial(p, msg->msg_iov[i].iov_base, copylen, off);
+      off += copylen;
+    }
+    msg->msg_flags = (off < p->tot_len) ? MSG_TRUNC : 0;
+    msg->msg_controllen = 0;
+    msgvec[done].msg_len = off;
+
+    if (msg->msg_name != NULL) {
+      union sockaddr_aligned saddr;
+      IPXADDR_PORT_TO_SOCKADDR(NETCONNTYPE_ISIPV6(netconn_type(sock->conn)),
+        &saddr, netbuf_fromaddr_ipX(buf), netbuf_fromport(buf));
+      if (msg->msg_namelen > saddr.sa.sa_len) {
+        msg->msg_namelen = saddr.sa.sa_len;
+      }
+      MEMCPY(msg->msg_name, &saddr, msg->msg_namelen);
+    }
+
+    if (flags & MSG_PEEK) {
+      /* keep it for the next receive call */
+      sock->lastdata = buf;
+      done++;
+      break;
+    }
+    netbuf_delete(buf);
+  }
+
+  LWIP_DEBUGF(SOCKETS_DEBUG, ("lwip_recvmmsg(%d) received=%u\n", s, done));
+  sock_set_errno(sock, 0);
+  return (int)done;
+}
+#endif /* LWIP_UDP */
+
 int
 lwip_socket(int domain, int type, int protocol)
 {
@@ -187,6 +187,15 @@
 #if IP_FRAG && IP_FRAG_USES_STATIC_BUF && LWIP_NETIF_TX_SINGLE_PBUF
   #error "LWIP_NETIF_TX_SINGLE_PBUF does not work with IP_FRAG_USES_STATIC_BUF==1 as that creates pbuf queues"
 #endif
+#if TCP_GSO && !LWIP_TCP
+  #error "If you want to use TCP_GSO, you have to define LWIP_TCP=1 in your lwipopts.h"
+#endif
+#if TCP_GSO && LWIP_NETIF_TX_SINGLE_PBUF
+  #error "TCP_GSO does not work with LWIP_NETIF_TX_SINGLE_PBUF==1 as that would preallocate TCP_GSO_MAX_SIZE for every segment"
+#endif
+#if TCP_GSO && ((TCP_GSO_MAX_SIZE < TCP_MSS) || (TCP_GSO_MAX_SIZE + PBUF_LINK_HLEN + 80 > 0xFFFF))
+  #error "TCP_GSO_MAX_SIZE must be at least TCP_MSS and leave room for all headers in an u16_t"
+#endif
 #if LWIP_NETCONN && LWIP_TCP
 #if NETCONN_COPY != TCP_WRITE_FLAG_COPY
   #error "NETCONN_COPY != TCP_WRITE_FLAG_COPY"
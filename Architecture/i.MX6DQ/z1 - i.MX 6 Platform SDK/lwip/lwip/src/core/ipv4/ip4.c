@@ -55,6 +55,7 @@
 #include "lwip/autoip.h"
 #include "lwip/stats.h"
 #include "arch/perf.h"
+#include "netif/gso.h"
 
 #include <string.h>
 
@@ -606,6 +607,24 @@ ip_input(struct pbuf *p, struct netif *inp)
   return ERR_OK;
 }
 
+#if TCP_GSO
+/**
+ * Sends one frame of a TCP super-segment that was cut up by IP because the
+ * outgoing netif can't do it (see gso_segment()).
+ *
+ * @param netif the netif on which to send this frame
+ * @param p the frame, p->payload pointing to its IP header
+ */
+static err_t
+ip_gso_output(struct netif *netif, struct pbuf *p)
+{
+  ip_addr_t dest;
+
+  ip_addr_copy(dest, ((struct ip_hdr *)p->payload)->dest);
+  return netif->output(netif, p, &dest);
+}
+#endif /* TCP_GSO */
+
 /**
  * Sends an IP packet on a network interface. This function constructs
  * the IP header and calculates the IP header checksum. If the source
@@ -735,6 +754,12 @@ err_t ip_output_if_opt(struct pbuf *p, ip_addr_t *src, ip_addr_t *dest,
     chk_sum += iphdr->_id;
 #endif /* CHECKSUM_GEN_IP_INLINE */
     ++ip_id;
+#if TCP_GSO
+    if (p->gso_mss != 0) {
+      /* reserve the ids gso_segment() assigns to the remaining frames */
+      ip_id += (p->tot_len - ip_hlen) / p->gso_mss;
+    }
+#endif /* TCP_GSO */
 
     if (ip_addr_isany(src)) {
       ip_addr_copy(iphdr->src, netif->ip_addr);
@@ -780,9 +805,23 @@ err_t ip_output_if_opt(struct pbuf *p, ip_addr_t *src, ip_addr_t *dest,
   }
 #endif /* LWIP_IGMP */
 #endif /* ENABLE_LOOPBACK */
+#if TCP_GSO
+  /* the TCP header (options included) follows the IP header in the first pbuf */
+  if ((p->gso_mss != 0) &&
+      (p->tot_len - IPH_HL(iphdr) * 4 -
+       TCPH_HDRLEN((struct tcp_hdr *)((u8_t *)iphdr + IPH_HL(iphdr) * 4)) * 4 > netif->gso_max_size)) {
+    /* TCP super-segment the netif can't split itself: cut it up here */
+    return gso_segment(netif, p, 0, ip_gso_output);
+  }
+#endif /* TCP_GSO */
 #if IP_FRAG
   /* don't fragment if interface has mtu set to 0 [loopif] */
-  if (netif->mtu && (p->tot_len > netif->mtu)) {
+  if (netif->mtu && (p->tot_len > netif->mtu)
+#if TCP_GSO
+      /* super-segments left to the netif are cut into TCP segments there */
+      && (p->gso_mss == 0)
+#endif /* TCP_GSO */
+      ) {
     return ip_frag(p, netif, dest);
   }
 #endif /* IP_FRAG */
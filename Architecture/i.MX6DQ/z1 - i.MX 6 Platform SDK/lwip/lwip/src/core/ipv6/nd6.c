@@ -74,6 +74,24 @@ u32_t retrans_timer = LWIP_ND6_RETRANS_TIMER; /* TODO implement this value in ti
 static u8_t nd6_cached_neighbor_index;
 static u8_t nd6_cached_destination_index;
 
+#if LWIP_ND6_NEIGHBOR_HASH_SIZE
+#if ((LWIP_ND6_NEIGHBOR_HASH_SIZE & (LWIP_ND6_NEIGHBOR_HASH_SIZE - 1)) != 0)
+#error "LWIP_ND6_NEIGHBOR_HASH_SIZE must be a power of 2, you have to change it in your lwipopts.h"
+#endif
+/* Neighbor cache hash bucket heads (index + 1, 0 is an empty bucket). */
+static u8_t nd6_neighbor_hash[LWIP_ND6_NEIGHBOR_HASH_SIZE];
+
+/* Fold all 16 address bytes, the result does not depend on byte order. */
+static u8_t
+nd6_neighbor_hash_index(ip6_addr_t * ip6addr)
+{
+  u32_t h = ip6addr->addr[0] ^ ip6addr->addr[1] ^ ip6addr->addr[2] ^ ip6addr->addr[3];
+  h ^= h >> 16;
+  h ^= h >> 8;
+  return (u8_t)(h & (LWIP_ND6_NEIGHBOR_HASH_SIZE - 1));
+}
+#endif /* LWIP_ND6_NEIGHBOR_HASH_SIZE */
+
 /* Multicast address holder. */
 static ip6_addr_t multicast_address;
 
@@ -84,6 +102,8 @@ static u8_t nd6_ra_buffer[sizeof(struct prefix_option)];
 static s8_t nd6_find_neighbor_cache_entry(ip6_addr_t * ip6addr);
 static s8_t nd6_new_neighbor_cache_entry(void);
 static void nd6_free_neighbor_cache_entry(s8_t i);
+static void nd6_set_neighbor_address(s8_t i, ip6_addr_t * ip6addr);
+static s8_t nd6_next_hop_neighbor(s8_t i);
 static s8_t nd6_find_destination_cache_entry(ip6_addr_t * ip6addr);
 static s8_t nd6_new_destination_cache_entry(void);
 static s8_t nd6_is_prefix_in_netif(ip6_addr_t * ip6addr, struct netif * netif);
@@ -339,7 +359,7 @@ nd6_input(struct pbuf *p, struct netif *inp)
         }
         neighbor_cache[i].netif = inp;
         MEMCPY(neighbor_cache[i].lladdr, lladdr_opt->addr, inp->hwaddr_len);
-        ip6_addr_set(&(neighbor_cache[i].next_hop_address), ip6_current_src_addr());
+        nd6_set_neighbor_address(i, ip6_current_src_addr());
 
         /* Receiving a message does not prove reachability: only in one direction.
          * Delay probe in case we get confirmation of reachability from upper layer (TCP). */
@@ -531,6 +551,7 @@ nd6_input(struct pbuf *p, struct netif *inp)
 
     /* Set the new target address. */
     ip6_addr_set(&(destination_cache[i].next_hop_addr), &(redir_hdr->target_address));
+    destination_cache[i].next_hop_neighbor = 0;
 
     /* If Link-layer address of other router is given, try to add to neighbor cache. */
     if (lladdr_opt != NULL) {
@@ -544,7 +565,7 @@ nd6_input(struct pbuf *p, struct netif *inp)
           if (i >= 0) {
             neighbor_cache[i].netif = inp;
             MEMCPY(neighbor_cache[i].lladdr, lladdr_opt->addr, inp->hwaddr_len);
-            ip6_addr_set(&(neighbor_cache[i].next_hop_address), ip6_current_src_addr());
+            nd6_set_neighbor_address(i, ip6_current_src_addr());
 
             /* Receiving a message does not prove reachability: only in one direction.
              * Delay probe in case we get confirmation of reachability from upper layer (TCP). */
@@ -998,7 +1019,13 @@ static s8_t
 nd6_find_neighbor_cache_entry(ip6_addr_t * ip6addr)
 {
   s8_t i;
+#if LWIP_ND6_NEIGHBOR_HASH_SIZE
+  u8_t n;
+  for (n = nd6_neighbor_hash[nd6_neighbor_hash_index(ip6addr)]; n != 0; n = neighbor_cache[n - 1].hnext) {
+    i = (s8_t)(n - 1);
+#else /* LWIP_ND6_NEIGHBOR_HASH_SIZE */
   for (i = 0; i < LWIP_ND6_NUM_NEIGHBORS; i++) {
+#endif /* LWIP_ND6_NEIGHBOR_HASH_SIZE */
     if (ip6_addr_cmp(ip6addr, &(neighbor_cache[i].next_hop_address))) {
       return i;
     }
@@ -1006,6 +1033,70 @@ nd6_find_neighbor_cache_entry(ip6_addr_t * ip6addr)
   return -1;
 }
 
+#if LWIP_ND6_NEIGHBOR_HASH_SIZE
+/**
+ * Remove a neighbor cache entry from the hash bucket of its address (if it
+ * is linked).
+ *
+ * @param i the neighbor cache entry index to remove
+ */
+static void
+nd6_neighbor_hash_unlink(s8_t i)
+{
+  u8_t *link = &nd6_neighbor_hash[nd6_neighbor_hash_index(&(neighbor_cache[i].next_hop_address))];
+  while (*link != 0) {
+    if (*link == (u8_t)(i + 1)) {
+      *link = neighbor_cache[i].hnext;
+      neighbor_cache[i].hnext = 0;
+      return;
+    }
+    link = &(neighbor_cache[*link - 1].hnext);
+  }
+}
+#endif /* LWIP_ND6_NEIGHBOR_HASH_SIZE */
+
+/**
+ * Give a neighbor cache entry its (new) address. References to the entry
+ * kept by destination cache entries become invalid.
+ *
+ * @param i the neighbor cache entry index
+ * @param ip6addr the IPv6 address of the neighbor
+ */
+static void
+nd6_set_neighbor_address(s8_t i, ip6_addr_t * ip6addr)
+{
+#if LWIP_ND6_NEIGHBOR_HASH_SIZE
+  u8_t h = nd6_neighbor_hash_index(ip6addr);
+  nd6_neighbor_hash_unlink(i);
+#endif /* LWIP_ND6_NEIGHBOR_HASH_SIZE */
+  ip6_addr_set(&(neighbor_cache[i].next_hop_address), ip6addr);
+  neighbor_cache[i].generation++;
+#if LWIP_ND6_NEIGHBOR_HASH_SIZE
+  neighbor_cache[i].hnext = nd6_neighbor_hash[h];
+  nd6_neighbor_hash[h] = (u8_t)(i + 1);
+#endif /* LWIP_ND6_NEIGHBOR_HASH_SIZE */
+}
+
+/**
+ * Get the neighbor cache entry a destination cache entry refers to for its
+ * next hop. This skips the neighbor cache lookup for destinations that were
+ * resolved before: the reference holds as long as the neighbor entry has
+ * been neither freed nor given another address.
+ *
+ * @param i the destination cache entry index
+ * @return the neighbor cache entry index, -1 if the reference is unset or
+ *         no longer valid
+ */
+static s8_t
+nd6_next_hop_neighbor(s8_t i)
+{
+  u8_t n = destination_cache[i].next_hop_neighbor;
+  if ((n != 0) && (neighbor_cache[n - 1].generation == destination_cache[i].next_hop_generation)) {
+    return (s8_t)(n - 1);
+  }
+  return -1;
+}
+
 /**
  * Create a new neighbor cache entry.
  *
@@ -1135,10 +1226,14 @@ nd6_free_neighbor_cache_entry(s8_t i)
     neighbor_cache[i].q = NULL;
   }
 
+#if LWIP_ND6_NEIGHBOR_HASH_SIZE
+  nd6_neighbor_hash_unlink(i);
+#endif /* LWIP_ND6_NEIGHBOR_HASH_SIZE */
   neighbor_cache[i].state = ND6_NO_ENTRY;
   neighbor_cache[i].isrouter = 0;
   neighbor_cache[i].netif = NULL;
   neighbor_cache[i].counter.reachable_time = 0;
+  neighbor_cache[i].generation++;
   ip6_addr_set_zero(&(neighbor_cache[i].next_hop_address));
 }
 
@@ -1327,7 +1422,7 @@ nd6_new_router(ip6_addr_t * router_addr, struct netif * netif)
       /* Could not create neighbor entry for this router. */
       return -1;
     }
-    ip6_addr_set(&(neighbor_cache[neighbor_index].next_hop_address), router_addr);
+    nd6_set_neighbor_address(neighbor_index, router_addr);
     neighbor_cache[neighbor_index].netif = netif;
     neighbor_cache[neighbor_index].q = NULL;
     neighbor_cache[neighbor_index].state = ND6_INCOMPLETE;
@@ -1458,6 +1553,7 @@ nd6_get_next_hop_entry(ip6_addr_t * ip6addr, struct netif * netif)
 
       /* Copy dest address to destination cache. */
       ip6_addr_set(&(destination_cache[nd6_cached_destination_index].destination_addr), ip6addr);
+      destination_cache[nd6_cached_destination_index].next_hop_neighbor = 0;
 
       /* Now find the next hop. is it a neighbor? */
       if (ip6_addr_islinklocal(ip6addr) ||
@@ -1488,8 +1584,13 @@ nd6_get_next_hop_entry(ip6_addr_t * ip6addr, struct netif * netif)
 #endif /* LWIP_NETIF_HWADDRHINT */
 
   /* Look in neighbor cache for the next-hop address. */
-  if (ip6_addr_cmp(&(destination_cache[nd6_cached_destination_index].next_hop_addr),
-                   &(neighbor_cache[nd6_cached_neighbor_index].next_hop_address))) {
+  i = nd6_next_hop_neighbor(nd6_cached_destination_index);
+  if (i >= 0) {
+    /* The destination still refers to its neighbor entry. */
+    nd6_cached_neighbor_index = i;
+    ND6_STATS_INC(nd6.cachehit);
+  } else if (ip6_addr_cmp(&(destination_cache[nd6_cached_destination_index].next_hop_addr),
+                          &(neighbor_cache[nd6_cached_neighbor_index].next_hop_address))) {
     /* Cache hit. */
     /* Do nothing. */
     ND6_STATS_INC(nd6.cachehit);
@@ -1511,8 +1612,7 @@ nd6_get_next_hop_entry(ip6_addr_t * ip6addr, struct netif * netif)
       }
 
       /* Initialize fields. */
-      ip6_addr_copy(neighbor_cache[i].next_hop_address,
-                   destination_cache[nd6_cached_destination_index].next_hop_addr);
+      nd6_set_neighbor_address(i, &(destination_cache[nd6_cached_destination_index].next_hop_addr));
       neighbor_cache[i].isrouter = 0;
       neighbor_cache[i].netif = netif;
       neighbor_cache[i].state = ND6_INCOMPLETE;
@@ -1520,6 +1620,11 @@ nd6_get_next_hop_entry(ip6_addr_t * ip6addr, struct netif * netif)
     }
   }
 
+  /* Refer to the neighbor entry from the destination, for the next packet. */
+  destination_cache[nd6_cached_destination_index].next_hop_neighbor = nd6_cached_neighbor_index + 1;
+  destination_cache[nd6_cached_destination_index].next_hop_generation =
+    neighbor_cache[nd6_cached_neighbor_index].generation;
+
   /* Reset this destination's age. */
   destination_cache[nd6_cached_destination_index].age = 0;
 
@@ -1750,7 +1855,7 @@ nd6_get_destination_mtu(ip6_addr_t * ip6addr, struct netif * netif)
 void
 nd6_reachability_hint(ip6_addr_t * ip6addr)
 {
-  s8_t i;
+  s8_t i, n;
 
   /* Find destination in cache. */
   if (ip6_addr_cmp(ip6addr, &(destination_cache[nd6_cached_destination_index].destination_addr))) {
@@ -1765,7 +1870,12 @@ nd6_reachability_hint(ip6_addr_t * ip6addr)
   }
 
   /* Find next hop neighbor in cache. */
-  if (ip6_addr_cmp(&(destination_cache[i].next_hop_addr), &(neighbor_cache[nd6_cached_neighbor_index].next_hop_address))) {
+  n = nd6_next_hop_neighbor(i);
+  if (n >= 0) {
+    i = n;
+    ND6_STATS_INC(nd6.cachehit);
+  }
+  else if (ip6_addr_cmp(&(destination_cache[i].next_hop_addr), &(neighbor_cache[nd6_cached_neighbor_index].next_hop_address))) {
     i = nd6_cached_neighbor_index;
     ND6_STATS_INC(nd6.cachehit);
   }
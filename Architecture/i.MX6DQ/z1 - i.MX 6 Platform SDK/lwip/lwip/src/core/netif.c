@@ -168,6 +168,9 @@ netif_add(struct netif *netif, ip_addr_t *ipaddr, ip_addr_t *netmask,
   netif->output_ip6 = netif_null_output_ip6;
 #endif /* LWIP_IPV6 */
   netif->flags = 0;
+#if TCP_GSO
+  netif->gso_max_size = 0;
+#endif /* TCP_GSO */
 #if LWIP_DHCP
   /* netif not under DHCP control by default */
   netif->dhcp = NULL;
@@ -193,6 +196,10 @@ netif_add(struct netif *netif, ip_addr_t *ipaddr, ip_addr_t *netmask,
 #if LWIP_NETIF_LINK_CALLBACK
   netif->link_callback = NULL;
 #endif /* LWIP_NETIF_LINK_CALLBACK */
+#if LWIP_NETIF_TX_BATCH
+  netif->tx_flush = NULL;
+  netif->tx_batch = 0;
+#endif /* LWIP_NETIF_TX_BATCH */
 #if LWIP_IGMP
   netif->igmp_mac_filter = NULL;
 #endif /* LWIP_IGMP */
@@ -644,6 +651,39 @@ void netif_set_link_callback(struct netif *netif, netif_status_callback_fn link_
 }
 #endif /* LWIP_NETIF_LINK_CALLBACK */
 
+#if LWIP_NETIF_TX_BATCH
+/**
+ * Open a batch of output calls on a netif: until the matching
+ * netif_tx_batch_end(), the driver may queue frames instead of
+ * starting transmission for each one. Batches may be nested.
+ *
+ * @param netif the lwip network interface structure
+ */
+void
+netif_tx_batch_begin(struct netif *netif)
+{
+  LWIP_ASSERT("netif_tx_batch_begin: too many open batches", netif->tx_batch < 0xff);
+  netif->tx_batch++;
+}
+
+/**
+ * Close a batch opened by netif_tx_batch_begin(). When the last open batch
+ * is closed, netif->tx_flush is called to start transmission of the frames
+ * queued in the meantime.
+ *
+ * @param netif the lwip network interface structure
+ */
+void
+netif_tx_batch_end(struct netif *netif)
+{
+  LWIP_ASSERT("netif_tx_batch_end: no open batch", netif->tx_batch > 0);
+  netif->tx_batch--;
+  if ((netif->tx_batch == 0) && (netif->tx_flush != NULL)) {
+    netif->tx_flush(netif);
+  }
+}
+#endif /* LWIP_NETIF_TX_BATCH */
+
 #if ENABLE_LOOPBACK
 /**
  * Send an IP packet to be received on the same netif (loopif-like).
@@ -344,6 +344,9 @@ pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type)
   p->ref = 1;
   /* set flags */
   p->flags = 0;
+#if TCP_GSO
+  p->gso_mss = 0;
+#endif /* TCP_GSO */
   LWIP_DEBUGF(PBUF_DEBUG | LWIP_DBG_TRACE, ("pbuf_alloc(length=%"U16_F") == %p\n", length, (void *)p));
   return p;
 }
@@ -407,6 +410,9 @@ pbuf_alloced_custom(pbuf_layer l, u16_t length, pbuf_type type, struct pbuf_cust
   p->pbuf.len = p->pbuf.tot_len = length;
   p->pbuf.type = type;
   p->pbuf.ref = 1;
+#if TCP_GSO
+  p->pbuf.gso_mss = 0;
+#endif /* TCP_GSO */
   return &p->pbuf;
 }
 #endif /* LWIP_SUPPORT_CUSTOM_PBUF */
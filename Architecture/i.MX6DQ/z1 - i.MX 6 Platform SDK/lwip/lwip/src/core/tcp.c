@@ -789,6 +789,9 @@ tcp_connect(struct tcp_pcb *pcb, ip_addr_t *ipaddr, u16_t port,
 #if TCP_CALCULATE_EFF_SEND_MSS
   pcb->mss = tcp_eff_send_mss(pcb->mss, &pcb->local_ip, &pcb->remote_ip, PCB_ISIPV6(pcb));
 #endif /* TCP_CALCULATE_EFF_SEND_MSS */
+#if TCP_GSO
+  tcp_gso_update(pcb);
+#endif /* TCP_GSO */
   pcb->cwnd = 1;
   pcb->ssthresh = pcb->mss * 10;
 #if LWIP_CALLBACK_API
@@ -1678,6 +1681,28 @@ tcp_eff_send_mss_impl(u16_t sendmss, ipX_addr_t *dest
 }
 #endif /* TCP_CALCULATE_EFF_SEND_MSS */
 
+#if TCP_GSO
+/**
+ * Remember the gso_max_size of the netif the peer is routed through, so that
+ * tcp_write() does not have to route on every call. A stale value only costs
+ * performance: ip_output_if() checks the netif it really sends on and cuts
+ * the super-segment in software if that netif can't.
+ */
+void
+tcp_gso_update(struct tcp_pcb *pcb)
+{
+  struct netif *netif;
+
+  pcb->gso_max_size = 0;
+  if (!PCB_ISIPV6(pcb)) {
+    netif = ip_route(ipX_2_ip(&pcb->remote_ip));
+    if (netif != NULL) {
+      pcb->gso_max_size = netif->gso_max_size;
+    }
+  }
+}
+#endif /* TCP_GSO */
+
 const char*
 tcp_debug_state_str(enum tcp_state s)
 {
@@ -520,6 +520,9 @@ tcp_listen_input(struct tcp_pcb_listen *pcb)
     npcb->mss = tcp_eff_send_mss(npcb->mss, &npcb->local_ip,
       &npcb->remote_ip, PCB_ISIPV6(npcb));
 #endif /* TCP_CALCULATE_EFF_SEND_MSS */
+#if TCP_GSO
+    tcp_gso_update(npcb);
+#endif /* TCP_GSO */
 
     snmp_inc_tcppassiveopens();
 
@@ -80,6 +80,12 @@
 #define TCP_CHECKSUM_ON_COPY_SANITY_CHECK   0
 #endif
 
+#if TCP_GSO
+/** Payload bytes per frame a super-segment is cut into (mss_local of tcp_write) */
+#define TCP_GSO_FRAME_LEN(pcb, optlen) \
+  (u16_t)(LWIP_MIN((pcb)->mss, (pcb)->snd_wnd_max/2) - (optlen))
+#endif /* TCP_GSO */
+
 /* Forward declarations.*/
 static void tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb);
 
@@ -337,6 +343,38 @@ tcp_write_checks(struct tcp_pcb *pcb, u16_t len)
   return ERR_OK;
 }
 
+#if TCP_GSO
+/**
+ * Get the size of the segments tcp_write creates (TCP options included).
+ *
+ * If the route to the peer goes through a netif that can cut super-segments
+ * into frames (pcb->gso_max_size, see tcp_gso_update()), this is a whole
+ * number of frames; otherwise, it is just mss_local.
+ *
+ * @param pcb the tcp_pcb data is enqueued for
+ * @param mss_local the largest segment put on the wire
+ * @param optlen length of the TCP options included in every segment
+ * @return the maximum segment size to use in tcp_write
+ */
+static u16_t
+tcp_gso_max_seg(struct tcp_pcb *pcb, u16_t mss_local, u8_t optlen)
+{
+  u16_t frame = mss_local - optlen;
+  u16_t limit;
+
+  if ((frame == 0) || (pcb->gso_max_size < optlen + 2 * frame)) {
+    return mss_local;
+  }
+  limit = LWIP_MIN(pcb->gso_max_size - optlen, TCP_GSO_MAX_SIZE);
+  /* like mss_local, stay below half of the largest window the peer offered */
+  limit = LWIP_MIN(limit, pcb->snd_wnd_max/2);
+  if (limit < 2 * frame) {
+    return mss_local;
+  }
+  return optlen + (limit / frame) * frame;
+}
+#endif /* TCP_GSO */
+
 /**
  * Write data for sending (but does not send it immediately).
  *
@@ -397,6 +435,10 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
     optlen = LWIP_TCP_OPT_LENGTH(TF_SEG_OPTS_TS);
   }
 #endif /* LWIP_TCP_TIMESTAMPS */
+#if TCP_GSO
+  /* queue super-segments if the netif cuts them into frames itself */
+  mss_local = tcp_gso_max_seg(pcb, mss_local, optlen);
+#endif /* TCP_GSO */
 
 
   /*
@@ -430,9 +472,11 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
     for (last_unsent = pcb->unsent; last_unsent->next != NULL;
          last_unsent = last_unsent->next);
 
-    /* Usable space at the end of the last unsent segment */
+    /* Usable space at the end of the last unsent segment (none if it was
+       built as a super-segment for a route with a larger GSO limit) */
     unsent_optlen = LWIP_TCP_OPT_LENGTH(last_unsent->flags);
-    space = mss_local - (last_unsent->len + unsent_optlen);
+    space = (last_unsent->len + unsent_optlen < mss_local) ?
+      (u16_t)(mss_local - (last_unsent->len + unsent_optlen)) : 0;
 
     /*
      * Phase 1: Copy data directly into an oversized pbuf.
@@ -454,7 +498,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
       oversize_used = oversize < len ? oversize : len;
       pos += oversize_used;
       oversize -= oversize_used;
-      space -= oversize_used;
+      space = (space > oversize_used) ? (u16_t)(space - oversize_used) : 0;
     }
     /* now we are either finished or oversize is zero */
     LWIP_ASSERT("inconsistend oversize vs. len", (oversize == 0) || (pos == len));
@@ -890,6 +934,178 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
   return ERR_OK;
 }
 
+#if TCP_GSO
+/**
+ * Split the first unsent segment if it is a super-segment that does not
+ * fit into the send window, so that tcp_output() can send the part that
+ * does. Without this, a super-segment larger than cwnd would never be sent.
+ *
+ * The split is done by reference: the part that fits (a whole number of
+ * frames) becomes a new segment that is queued in front of the original one
+ * and points into the original's pbufs (or takes over whole pbufs of it),
+ * and the original's TCP header is moved forward over the data that went to
+ * the new segment. Only the few bytes the moved header overwrites are
+ * copied. Pointing into the original is safe because the new segment has
+ * the lower sequence numbers, so it is always freed first.
+ *
+ * @param pcb the tcp_pcb whose first unsent segment is checked
+ * @param wnd the usable send window (the minimum of snd_wnd and cwnd)
+ */
+static void
+tcp_gso_fit_wnd(struct tcp_pcb *pcb, u32_t wnd)
+{
+  struct tcp_seg *seg = pcb->unsent;
+  struct tcp_seg *head;
+  struct pbuf *p, *q, *first, *last, *ref0, *cpy, *ref1;
+  u32_t used;
+  u16_t frame, split, hdrlen, len0, copylen, rest, clen;
+  u8_t optflags, optlen;
+
+  if (seg == NULL) {
+    return;
+  }
+  used = ntohl(seg->tcphdr->seqno) - pcb->lastack;
+  if (used + seg->len <= wnd) {
+    return;
+  }
+  optflags = seg->flags & (TF_SEG_OPTS_MSS | TF_SEG_OPTS_TS);
+  optlen = LWIP_TCP_OPT_LENGTH(optflags);
+  frame = TCP_GSO_FRAME_LEN(pcb, optlen);
+  if ((frame == 0) || (seg->len <= frame) || (used + frame > wnd)) {
+    /* not a super-segment, or not even one frame of it would fit */
+    return;
+  }
+  split = (u16_t)(((wnd - used) / frame) * frame);
+
+  /* remove the link/IP headers left by a previous transmission */
+  p = seg->p;
+  hdrlen = (u16_t)((u8_t *)seg->tcphdr - (u8_t *)p->payload);
+  p->len -= hdrlen;
+  p->tot_len -= hdrlen;
+  p->payload = seg->tcphdr;
+  hdrlen = TCPH_HDRLEN(seg->tcphdr) * 4;
+
+  /* The data before 'split' is: len0 bytes behind the header in the first
+     pbuf, whole pbufs first..last, and 'rest' bytes at the start of q.
+     Of the len0 bytes, the last copylen are copied out because that is
+     where seg's header will be moved to. */
+  len0 = LWIP_MIN(split, p->len - hdrlen);
+  copylen = LWIP_MIN(len0, hdrlen);
+  rest = split - len0;
+  first = last = NULL;
+  q = p->next;
+  while ((rest > 0) && (rest >= q->len)) {
+    if (first == NULL) {
+      first = q;
+    }
+    last = q;
+    rest -= q->len;
+    q = q->next;
+  }
+
+  /* allocate everything first so that a failure leaves seg unchanged */
+  ref0 = cpy = ref1 = NULL;
+  if (len0 > copylen) {
+    ref0 = pbuf_alloc(PBUF_RAW, len0 - copylen, PBUF_REF);
+  }
+  if (copylen > 0) {
+    cpy = pbuf_alloc(PBUF_RAW, copylen, PBUF_RAM);
+  }
+  if (rest > 0) {
+    ref1 = pbuf_alloc(PBUF_RAW, rest, PBUF_REF);
+  }
+  head = NULL;
+  if (((len0 == copylen) || (ref0 != NULL)) && ((copylen == 0) || (cpy != NULL)) &&
+      ((rest == 0) || (ref1 != NULL))) {
+    struct pbuf *h = pbuf_alloc(PBUF_TRANSPORT, optlen, PBUF_RAM);
+    if (h != NULL) {
+      head = tcp_create_segment(pcb, h, 0, ntohl(seg->tcphdr->seqno), optflags);
+    }
+  }
+  if (head == NULL) {
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 2, ("tcp_gso_fit_wnd: could not allocate memory\n"));
+    TCP_STATS_INC(tcp.memerr);
+    if (ref0 != NULL) {
+      pbuf_free(ref0);
+    }
+    if (cpy != NULL) {
+      pbuf_free(cpy);
+    }
+    if (ref1 != NULL) {
+      pbuf_free(ref1);
+    }
+    return;
+  }
+  clen = pbuf_clen(p);
+
+  /* build the head's data: a reference into the first pbuf, the copied
+     bytes, the whole pbufs it takes over and a reference into q */
+  if (ref0 != NULL) {
+    ref0->payload = (u8_t *)p->payload + hdrlen;
+    pbuf_cat(head->p, ref0);
+  }
+  if (cpy != NULL) {
+    MEMCPY(cpy->payload, (u8_t *)p->payload + hdrlen + len0 - copylen, copylen);
+    pbuf_cat(head->p, cpy);
+  }
+  if (first != NULL) {
+    for (p = first; p != last->next; p = p->next) {
+      p->tot_len -= q->tot_len;
+    }
+    last->next = NULL;
+    pbuf_cat(head->p, first);
+  }
+  if (ref1 != NULL) {
+    ref1->payload = q->payload;
+    pbuf_cat(head->p, ref1);
+    pbuf_header(q, -(s16_t)rest);
+  }
+  head->len = split;
+
+  /* move the original header over the data that went to the head */
+  p = seg->p;
+  if (len0 > 0) {
+    memmove((u8_t *)p->payload + len0, p->payload, hdrlen);
+    pbuf_header(p, -(s16_t)len0);
+  }
+  p->next = q;
+  p->tot_len = p->len + ((q != NULL) ? q->tot_len : 0);
+  seg->tcphdr = (struct tcp_hdr *)p->payload;
+  seg->tcphdr->seqno = htonl(ntohl(seg->tcphdr->seqno) + split);
+  seg->len -= split;
+  pcb->snd_queuelen += pbuf_clen(head->p) + pbuf_clen(seg->p) - clen;
+
+#if TCP_CHECKSUM_ON_COPY
+  if (seg->flags & TF_SEG_DATA_CHECKSUMMED) {
+    u32_t acc;
+    u16_t chksum = ~inet_chksum_pbuf(head->p->next);
+
+    head->chksum = chksum;
+    head->flags |= TF_SEG_DATA_CHECKSUMMED;
+
+    /* subtract the head's share from the data checksum that is left */
+    if (seg->chksum_swapped) {
+      seg->chksum = SWAP_BYTES_IN_WORD(seg->chksum);
+      seg->chksum_swapped = 0;
+    }
+    acc = (u32_t)seg->chksum + (u16_t)~chksum;
+    seg->chksum = FOLD_U32T(acc);
+    if (split & 1) {
+      seg->chksum = SWAP_BYTES_IN_WORD(seg->chksum);
+    }
+  }
+#endif /* TCP_CHECKSUM_ON_COPY */
+
+  /* the last pbuf (and with it the oversized tail) stays with seg */
+  head->next = seg;
+  pcb->unsent = head;
+
+  LWIP_DEBUGF(TCP_OUTPUT_DEBUG | LWIP_DBG_TRACE, ("tcp_gso_fit_wnd: split %"U32_F":%"U32_F" at %"U32_F"\n",
+              ntohl(head->tcphdr->seqno), ntohl(seg->tcphdr->seqno) + TCP_TCPLEN(seg),
+              ntohl(seg->tcphdr->seqno)));
+}
+#endif /* TCP_GSO */
+
 /**
  * Find out what we can send and send it
  *
@@ -920,6 +1136,9 @@ tcp_output(struct tcp_pcb *pcb)
 
   wnd = LWIP_MIN(pcb->snd_wnd, pcb->cwnd);
 
+#if TCP_GSO
+  tcp_gso_fit_wnd(pcb, wnd);
+#endif /* TCP_GSO */
   seg = pcb->unsent;
 
   /* If the TF_ACK_NOW flag is set and no data will be sent (either
@@ -1032,6 +1251,9 @@ tcp_output(struct tcp_pcb *pcb)
     } else {
       tcp_seg_free(seg);
     }
+#if TCP_GSO
+    tcp_gso_fit_wnd(pcb, wnd);
+#endif /* TCP_GSO */
     seg = pcb->unsent;
   }
 #if TCP_OVERSIZE
@@ -1126,9 +1348,23 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
 
   seg->p->payload = seg->tcphdr;
 
+#if TCP_GSO
+  /* A super-segment goes down the stack in one piece; the netif (or IP, if
+     the netif can't) cuts it into frames using gso_segment(). */
+  {
+    u16_t frame = TCP_GSO_FRAME_LEN(pcb, (LWIP_TCP_OPT_LENGTH(seg->flags)));
+    seg->p->gso_mss = (seg->len > frame) ? frame : 0;
+  }
+#endif /* TCP_GSO */
+
   seg->tcphdr->chksum = 0;
-#if TCP_CHECKSUM_ON_COPY
+#if TCP_GSO
+  if (seg->p->gso_mss != 0) {
+    /* gso_segment() computes the checksum of every frame */
+  } else
+#endif /* TCP_GSO */
   {
+#if TCP_CHECKSUM_ON_COPY
     u32_t acc;
 #if TCP_CHECKSUM_ON_COPY_SANITY_CHECK
     u16_t chksum_slow = ipX_chksum_pseudo(PCB_ISIPV6(pcb), seg->p, IP_PROTO_TCP,
@@ -1157,13 +1393,13 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
       seg->tcphdr->chksum = chksum_slow;
     }
 #endif /* TCP_CHECKSUM_ON_COPY_SANITY_CHECK */
-  }
 #else /* TCP_CHECKSUM_ON_COPY */
 #if CHECKSUM_GEN_TCP
-  seg->tcphdr->chksum = ipX_chksum_pseudo(PCB_ISIPV6(pcb), seg->p, IP_PROTO_TCP,
-    seg->p->tot_len, &pcb->local_ip, &pcb->remote_ip);
+    seg->tcphdr->chksum = ipX_chksum_pseudo(PCB_ISIPV6(pcb), seg->p, IP_PROTO_TCP,
+      seg->p->tot_len, &pcb->local_ip, &pcb->remote_ip);
 #endif /* CHECKSUM_GEN_TCP */
 #endif /* TCP_CHECKSUM_ON_COPY */
+  }
   TCP_STATS_INC(tcp.xmit);
 
 #if LWIP_NETIF_HWADDRHINT
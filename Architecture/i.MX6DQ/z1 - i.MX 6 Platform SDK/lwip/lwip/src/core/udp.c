@@ -554,10 +554,38 @@ udp_sendto_chksum(struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *dst_ip,
 {
 #endif /* LWIP_CHECKSUM_ON_COPY */
   struct netif *netif;
-  ipX_addr_t *dst_ip_route = ip_2_ipX(dst_ip);
 
   LWIP_DEBUGF(UDP_DEBUG | LWIP_DBG_TRACE, ("udp_send\n"));
 
+  /* find the outgoing network interface for this packet */
+  netif = udp_route(pcb, dst_ip);
+
+  /* no outgoing network interface could be found? */
+  if (netif == NULL) {
+    return ERR_RTE;
+  }
+#if LWIP_CHECKSUM_ON_COPY
+  return udp_sendto_if_chksum(pcb, p, dst_ip, dst_port, netif, have_chksum, chksum);
+#else /* LWIP_CHECKSUM_ON_COPY */
+  return udp_sendto_if(pcb, p, dst_ip, dst_port, netif);
+#endif /* LWIP_CHECKSUM_ON_COPY */
+}
+
+/**
+ * Find the netif a UDP pcb sends packets to a given destination through.
+ * udp_sendto() uses this for every packet; callers sending many packets
+ * to the same destination may call it once and use udp_sendto_if().
+ *
+ * @param pcb UDP PCB used to send the data.
+ * @param dst_ip Destination IP address.
+ * @return the outgoing netif, NULL if there is no route to dst_ip
+ */
+struct netif *
+udp_route(struct udp_pcb *pcb, ip_addr_t *dst_ip)
+{
+  struct netif *netif;
+  ipX_addr_t *dst_ip_route = ip_2_ipX(dst_ip);
+
 #if LWIP_IPV6 || LWIP_IGMP
   if (ipX_addr_ismulticast(PCB_ISIPV6(pcb), dst_ip_route)) {
     /* For multicast, find a netif based on source address. */
@@ -583,13 +611,8 @@ udp_sendto_chksum(struct udp_pcb *pcb, struct pbuf *p, ip_addr_t *dst_ip,
     ipX_addr_debug_print(PCB_ISIPV6(pcb), UDP_DEBUG | LWIP_DBG_LEVEL_SERIOUS, ip_2_ipX(dst_ip));
     LWIP_DEBUGF(UDP_DEBUG, ("\n"));
     UDP_STATS_INC(udp.rterr);
-    return ERR_RTE;
   }
-#if LWIP_CHECKSUM_ON_COPY
-  return udp_sendto_if_chksum(pcb, p, dst_ip, dst_port, netif, have_chksum, chksum);
-#else /* LWIP_CHECKSUM_ON_COPY */
-  return udp_sendto_if(pcb, p, dst_ip, dst_port, netif);
-#endif /* LWIP_CHECKSUM_ON_COPY */
+  return netif;
 }
 
 /**
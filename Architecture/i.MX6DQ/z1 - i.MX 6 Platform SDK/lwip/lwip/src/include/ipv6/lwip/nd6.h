@@ -73,6 +73,13 @@ struct nd6_neighbor_cache_entry {
 #endif /* LWIP_ND6_QUEUEING */
   u8_t state;
   u8_t isrouter;
+#if LWIP_ND6_NEIGHBOR_HASH_SIZE
+  /** Next entry in the same hash bucket (index + 1, 0 ends the chain) */
+  u8_t hnext;
+#endif /* LWIP_ND6_NEIGHBOR_HASH_SIZE */
+  /** Changes whenever the entry is freed or gets a new address, so that
+      references to it (see nd6_destination_cache_entry) can be checked */
+  u32_t generation;
   union {
     u32_t reachable_time;
     u32_t delay_time;
@@ -86,6 +93,10 @@ struct nd6_destination_cache_entry {
   ip6_addr_t next_hop_addr;
   u32_t pmtu;
   u32_t age;
+  /** Neighbor cache entry of next_hop_addr (index + 1, 0 if not known yet),
+      valid while its generation equals next_hop_generation */
+  u8_t next_hop_neighbor;
+  u32_t next_hop_generation;
 };
 
 struct nd6_prefix_list_entry {
@@ -262,6 +262,10 @@ void    netconn_recved(struct netconn *conn, u32_t length);
 err_t   netconn_sendto(struct netconn *conn, struct netbuf *buf,
                        ip_addr_t *addr, u16_t port);
 err_t   netconn_send(struct netconn *conn, struct netbuf *buf);
+#if LWIP_UDP
+err_t   netconn_send_batch(struct netconn *conn, struct netbuf *bufs, u16_t count,
+                           u16_t *sent);
+#endif /* LWIP_UDP */
 err_t   netconn_write_partly(struct netconn *conn, const void *dataptr, size_t size,
                              u8_t apiflags, size_t *bytes_written);
 #define netconn_write(conn, dataptr, size, apiflags) \
@@ -69,6 +69,14 @@ struct api_msg_msg {
   union {
     /** used for lwip_netconn_do_send */
     struct netbuf *b;
+#if LWIP_UDP
+    /** used for lwip_netconn_do_send_batch */
+    struct {
+      struct netbuf *bufs;
+      u16_t count;
+      u16_t sent;
+    } sb;
+#endif /* LWIP_UDP */
     /** used for lwip_netconn_do_newconn */
     struct {
       u8_t proto;
@@ -152,6 +160,9 @@ void lwip_netconn_do_connect         ( struct api_msg_msg *msg);
 void lwip_netconn_do_disconnect      ( struct api_msg_msg *msg);
 void lwip_netconn_do_listen          ( struct api_msg_msg *msg);
 void lwip_netconn_do_send            ( struct api_msg_msg *msg);
+#if LWIP_UDP
+void lwip_netconn_do_send_batch      ( struct api_msg_msg *msg);
+#endif /* LWIP_UDP */
 void lwip_netconn_do_recv            ( struct api_msg_msg *msg);
 void lwip_netconn_do_write           ( struct api_msg_msg *msg);
 void lwip_netconn_do_getaddr         ( struct api_msg_msg *msg);
@@ -142,6 +142,14 @@ typedef err_t (*netif_output_ip6_fn)(struct netif *netif, struct pbuf *p,
 typedef err_t (*netif_linkoutput_fn)(struct netif *netif, struct pbuf *p);
 /** Function prototype for netif status- or link-callback functions. */
 typedef void (*netif_status_callback_fn)(struct netif *netif);
+#if LWIP_NETIF_TX_BATCH
+/** Function prototype for netif->tx_flush functions. Called at the end of
+ * a batch to start transmission of all frames queued by linkoutput.
+ *
+ * @param netif The netif which shall start transmitting
+ */
+typedef void (*netif_tx_flush_fn)(struct netif *netif);
+#endif /* LWIP_NETIF_TX_BATCH */
 /** Function prototype for netif igmp_mac_filter functions */
 typedef err_t (*netif_igmp_mac_filter_fn)(struct netif *netif,
        ip_addr_t *group, u8_t action);
@@ -181,6 +189,14 @@ struct netif {
    *  to send a packet on the interface. This function outputs
    *  the pbuf as-is on the link medium. */
   netif_linkoutput_fn linkoutput;
+#if LWIP_NETIF_TX_BATCH
+  /** This function is called when the last open batch on the interface
+   *  ends (see netif_tx_batch_end()). NULL if the driver doesn't batch. */
+  netif_tx_flush_fn tx_flush;
+  /** number of open batches; linkoutput may defer starting transmission
+   *  while this is != 0 */
+  u8_t tx_batch;
+#endif /* LWIP_NETIF_TX_BATCH */
 #if LWIP_IPV6
   /** This function is called by the IPv6 module when it wants
    *  to send a packet on the interface. This function typically
@@ -240,6 +256,12 @@ struct netif {
   char name[2];
   /** number of this interface */
   u8_t num;
+#if TCP_GSO
+  /** maximum TCP super-segment payload (TCP options included) this netif
+   *  cuts into frames itself, by calling gso_segment() in linkoutput;
+   *  0 if it can't (IP then cuts super-segments in software) */
+  u16_t gso_max_size;
+#endif /* TCP_GSO */
 #if LWIP_SNMP
   /** link type (from "snmp_ifType" enum from snmp.h) */
   u8_t link_type;
@@ -348,6 +370,14 @@ void netif_set_link_down(struct netif *netif);
 void netif_set_link_callback(struct netif *netif, netif_status_callback_fn link_callback);
 #endif /* LWIP_NETIF_LINK_CALLBACK */
 
+#if LWIP_NETIF_TX_BATCH
+void netif_tx_batch_begin(struct netif *netif);
+void netif_tx_batch_end(struct netif *netif);
+#else /* LWIP_NETIF_TX_BATCH */
+#define netif_tx_batch_begin(netif)
+#define netif_tx_batch_end(netif)
+#endif /* LWIP_NETIF_TX_BATCH */
+
 #if LWIP_NETIF_HOSTNAME
 #define netif_set_hostname(netif, name) do { if((netif) != NULL) { (netif)->hostname = name; }}while(0)
 #define netif_get_hostname(netif) (((netif) != NULL) ? ((netif)->hostname) : NULL)
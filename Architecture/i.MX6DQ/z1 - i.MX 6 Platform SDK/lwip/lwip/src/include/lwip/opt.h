@@ -433,6 +433,16 @@
 #define ARP_TABLE_SIZE                  10
 #endif
 
+/**
+ * ARP_TABLE_HASH_SIZE: Number of hash buckets used to index the ARP table by
+ * IP address (must be a power of 2). With 0, lookups scan the whole table.
+ * A hash index pays off with large tables and with ETHARP_TRUST_IP_MAC, where
+ * every received IP packet looks up its source address.
+ */
+#ifndef ARP_TABLE_HASH_SIZE
+#define ARP_TABLE_HASH_SIZE             0
+#endif
+
 /**
  * ARP_QUEUEING==1: Multiple outgoing packets are queued during hardware address
  * resolution. By default, only the most recent packet is queued per IP address.
@@ -1060,6 +1070,27 @@
 #define LWIP_TCP_TIMESTAMPS             0
 #endif
 
+/**
+ * TCP_GSO==1: Enable the large-send path. When the route to the peer goes
+ * through a netif that has set netif->gso_max_size, tcp_write() queues
+ * super-segments spanning several MSS and tcp_output() passes each one down
+ * the stack in a single piece. The netif driver cuts them into MSS-sized
+ * frames right before transmission (see gso_segment() in netif/gso.h).
+ * Only used for IPv4 connections.
+ */
+#ifndef TCP_GSO
+#define TCP_GSO                         0
+#endif
+
+/**
+ * TCP_GSO_MAX_SIZE: The maximum number of payload bytes in one TCP
+ * super-segment. Link, IP and TCP headers must still fit into the 16 bit
+ * pbuf length fields on top of this.
+ */
+#ifndef TCP_GSO_MAX_SIZE
+#define TCP_GSO_MAX_SIZE                (0xFFFF - PBUF_LINK_HLEN - 80)
+#endif
+
 /**
  * TCP_WND_UPDATE_THRESHOLD: difference in window to trigger an
  * explicit window update
@@ -1205,6 +1236,16 @@
 #define LWIP_NETIF_TX_SINGLE_PBUF             0
 #endif /* LWIP_NETIF_TX_SINGLE_PBUF */
 
+/**
+ * LWIP_NETIF_TX_BATCH==1: Support netif->tx_flush and netif_tx_batch_begin()/
+ * netif_tx_batch_end(). While a batch is open (netif->tx_batch != 0), a
+ * driver may queue frames in linkoutput without starting the transmitter;
+ * tx_flush is called once at the end of the batch (e.g. by lwip_sendmmsg()).
+ */
+#ifndef LWIP_NETIF_TX_BATCH
+#define LWIP_NETIF_TX_BATCH                   0
+#endif /* LWIP_NETIF_TX_BATCH */
+
 /*
    ------------------------------------
    ---------- LOOPIF options ----------
@@ -1510,6 +1551,15 @@
 #define LWIP_FIONREAD_LINUXMODE         0
 #endif
 
+/**
+ * LWIP_SOCKET_BATCH_MAX: Number of datagrams lwip_sendmmsg() passes to the
+ * tcpip_thread in one message. The netbufs for them live on the stack of
+ * the calling thread.
+ */
+#ifndef LWIP_SOCKET_BATCH_MAX
+#define LWIP_SOCKET_BATCH_MAX           8
+#endif
+
 /*
    ----------------------------------------
    ---------- Statistics options ----------
@@ -1998,6 +2048,15 @@
 #define LWIP_ND6_NUM_NEIGHBORS          10
 #endif
 
+/**
+ * LWIP_ND6_NEIGHBOR_HASH_SIZE: Number of hash buckets used to index the IPv6
+ * neighbor cache by address (must be a power of 2). With 0, lookups scan the
+ * whole cache. Like ARP_TABLE_HASH_SIZE, this pays off with large caches.
+ */
+#ifndef LWIP_ND6_NEIGHBOR_HASH_SIZE
+#define LWIP_ND6_NEIGHBOR_HASH_SIZE     0
+#endif
+
 /**
  * LWIP_ND6_NUM_DESTINATIONS: number of entries in IPv6 destination cache
  */
@@ -114,6 +114,12 @@ struct pbuf {
    * the stack itself, or pbuf->next pointers from a chain.
    */
   u16_t ref;
+
+#if TCP_GSO
+  /** TCP payload bytes per frame if this packet is a TCP super-segment
+   *  that still has to be cut into frames by gso_segment(), 0 otherwise */
+  u16_t gso_mss;
+#endif /* TCP_GSO */
 };
 
 #if LWIP_SUPPORT_CUSTOM_PBUF
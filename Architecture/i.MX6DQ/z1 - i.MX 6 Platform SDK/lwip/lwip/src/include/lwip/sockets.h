@@ -84,6 +84,40 @@ struct sockaddr {
 typedef u32_t socklen_t;
 #endif
 
+/* If your port already defines struct iovec (e.g. by including <sys/uio.h>),
+   define LWIP_IOVEC_DEFINED to prevent this code from redefining it. */
+#ifndef LWIP_IOVEC_DEFINED
+#define LWIP_IOVEC_DEFINED
+struct iovec {
+  void  *iov_base;
+  size_t iov_len;
+};
+#endif /* LWIP_IOVEC_DEFINED */
+
+/* If your port already defines struct msghdr and struct mmsghdr (e.g. by
+   including <sys/socket.h>), define LWIP_MSGHDR_DEFINED to prevent this code
+   from redefining them. */
+#ifndef LWIP_MSGHDR_DEFINED
+#define LWIP_MSGHDR_DEFINED
+/** One datagram for lwip_sendmmsg()/lwip_recvmmsg().
+ * msg_control is not supported and must be NULL. */
+struct msghdr {
+  void         *msg_name;
+  socklen_t     msg_namelen;
+  struct iovec *msg_iov;
+  int           msg_iovlen;
+  void         *msg_control;
+  socklen_t     msg_controllen;
+  int           msg_flags;
+};
+
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  /** number of bytes sent/received for this datagram */
+  unsigned int  msg_len;
+};
+#endif /* LWIP_MSGHDR_DEFINED */
+
 /* Socket protocol types (TCP/UDP/RAW) */
 #define SOCK_STREAM     1
 #define SOCK_DGRAM      2
@@ -159,6 +193,7 @@ struct linger {
 #define MSG_OOB        0x04    /* Unimplemented: Requests out-of-band data. The significance and semantics of out-of-band data are protocol-specific */
 #define MSG_DONTWAIT   0x08    /* Nonblocking i/o for this operation only */
 #define MSG_MORE       0x10    /* Sender will send more */
+#define MSG_TRUNC      0x20    /* (msg_flags only) Datagram was longer than the buffers */
 
 
 /*
@@ -367,6 +402,11 @@ int lwip_recvfrom(int s, void *mem, size_t len, int flags,
 int lwip_send(int s, const void *dataptr, size_t size, int flags);
 int lwip_sendto(int s, const void *dataptr, size_t size, int flags,
     const struct sockaddr *to, socklen_t tolen);
+#if LWIP_UDP
+int lwip_sendmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags);
+int lwip_recvmmsg(int s, struct mmsghdr *msgvec, unsigned int vlen, int flags,
+                  struct timeval *timeout);
+#endif /* LWIP_UDP */
 int lwip_socket(int domain, int type, int protocol);
 int lwip_write(int s, const void *dataptr, size_t size);
 int lwip_select(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset,
@@ -389,6 +429,10 @@ int lwip_fcntl(int s, int cmd, int val);
 #define recvfrom(a,b,c,d,e,f) lwip_recvfrom(a,b,c,d,e,f)
 #define send(a,b,c,d)         lwip_send(a,b,c,d)
 #define sendto(a,b,c,d,e,f)   lwip_sendto(a,b,c,d,e,f)
+#if LWIP_UDP
+#define sendmmsg(a,b,c,d)     lwip_sendmmsg(a,b,c,d)
+#define recvmmsg(a,b,c,d,e)   lwip_recvmmsg(a,b,c,d,e)
+#endif /* LWIP_UDP */
 #define socket(a,b,c)         lwip_socket(a,b,c)
 #define select(a,b,c,d,e)     lwip_select(a,b,c,d,e)
 #define ioctlsocket(a,b,c)    lwip_ioctl(a,b,c)
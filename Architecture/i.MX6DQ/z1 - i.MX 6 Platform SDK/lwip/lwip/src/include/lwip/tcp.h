@@ -204,6 +204,9 @@ struct tcp_pcb {
   s16_t rtime;
 
   u16_t mss;   /* maximum segment size */
+#if TCP_GSO
+  u16_t gso_max_size; /* gso_max_size of the netif the peer is routed through */
+#endif /* TCP_GSO */
 
   /* RTT (round trip time) estimation variables */
   u32_t rttest; /* RTT estimate in 500ms ticks */
@@ -476,6 +476,10 @@ u16_t tcp_eff_send_mss_impl(u16_t sendmss, ipX_addr_t *dest
 #endif /* LWIP_IPV6 */
 #endif /* TCP_CALCULATE_EFF_SEND_MSS */
 
+#if TCP_GSO
+void tcp_gso_update(struct tcp_pcb *pcb);
+#endif /* TCP_GSO */
+
 #if LWIP_CALLBACK_API
 err_t tcp_recv_null(void *arg, struct tcp_pcb *pcb, struct pbuf *p, err_t err);
 #endif /* LWIP_CALLBACK_API */
@@ -159,6 +159,7 @@ err_t            udp_sendto_if  (struct udp_pcb *pcb, struct pbuf *p,
 err_t            udp_sendto     (struct udp_pcb *pcb, struct pbuf *p,
                                  ip_addr_t *dst_ip, u16_t dst_port);
 err_t            udp_send       (struct udp_pcb *pcb, struct pbuf *p);
+struct netif *   udp_route      (struct udp_pcb *pcb, ip_addr_t *dst_ip);
 
 #if LWIP_CHECKSUM_ON_COPY
 err_t            udp_sendto_if_chksum(struct udp_pcb *pcb, struct pbuf *p,
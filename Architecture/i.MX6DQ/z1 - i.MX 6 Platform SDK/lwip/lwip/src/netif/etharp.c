@@ -116,10 +116,26 @@ struct etharp_entry {
   struct eth_addr ethaddr;
   u8_t state;
   u8_t ctime;
+#if ARP_TABLE_HASH_SIZE
+  /** Next entry in the same hash bucket (index + 1, 0 ends the chain) */
+  u8_t hnext;
+#endif /* ARP_TABLE_HASH_SIZE */
 };
 
 static struct etharp_entry arp_table[ARP_TABLE_SIZE];
 
+#if ARP_TABLE_HASH_SIZE
+/** Hash bucket heads (index + 1 into arp_table, 0 is an empty bucket). This
+    way the zero-initialized table needs no init function. */
+static u8_t arp_hash[ARP_TABLE_HASH_SIZE];
+
+/** Fold all four address bytes so the result does not depend on byte order */
+#define ETHARP_HASH(ipaddr) ((u8_t)(((ip4_addr_get_u32(ipaddr) >> 24) ^ \
+                                      (ip4_addr_get_u32(ipaddr) >> 16) ^ \
+                                      (ip4_addr_get_u32(ipaddr) >> 8) ^  \
+                                      ip4_addr_get_u32(ipaddr)) & (ARP_TABLE_HASH_SIZE - 1)))
+#endif /* ARP_TABLE_HASH_SIZE */
+
 #if !LWIP_NETIF_HWADDRHINT
 static u8_t etharp_cached_entry;
 #endif /* !LWIP_NETIF_HWADDRHINT */
@@ -144,6 +160,63 @@ static u8_t etharp_cached_entry;
 #if (LWIP_ARP && (ARP_TABLE_SIZE > 0x7f))
   #error "ARP_TABLE_SIZE must fit in an s8_t, you have to reduce it in your lwipopts.h"
 #endif
+#if (LWIP_ARP && ((ARP_TABLE_HASH_SIZE & (ARP_TABLE_HASH_SIZE - 1)) != 0))
+  #error "ARP_TABLE_HASH_SIZE must be a power of 2, you have to change it in your lwipopts.h"
+#endif
+
+#if ARP_TABLE_HASH_SIZE
+/**
+ * Insert an ARP table entry into the hash bucket of its IP address.
+ * The entry's ipaddr must not change while it is linked.
+ *
+ * @param i index of the entry to insert
+ */
+static void
+etharp_hash_link(u8_t i)
+{
+  u8_t h = ETHARP_HASH(&arp_table[i].ipaddr);
+  arp_table[i].hnext = arp_hash[h];
+  arp_hash[h] = (u8_t)(i + 1);
+}
+
+/**
+ * Remove an ARP table entry from its hash bucket (if it is linked).
+ *
+ * @param i index of the entry to remove
+ */
+static void
+etharp_hash_unlink(u8_t i)
+{
+  u8_t *link = &arp_hash[ETHARP_HASH(&arp_table[i].ipaddr)];
+  while (*link != 0) {
+    if (*link == (u8_t)(i + 1)) {
+      *link = arp_table[i].hnext;
+      arp_table[i].hnext = 0;
+      return;
+    }
+    link = &arp_table[*link - 1].hnext;
+  }
+}
+
+/**
+ * Look up a non-empty ARP table entry by IP address via the hash index.
+ *
+ * @param ipaddr IP address to look for
+ * @return index of the pending or stable entry for ipaddr, or -1 if none
+ */
+static s8_t
+etharp_hash_lookup(ip_addr_t *ipaddr)
+{
+  u8_t n;
+  for (n = arp_hash[ETHARP_HASH(ipaddr)]; n != 0; n = arp_table[n - 1].hnext) {
+    if ((arp_table[n - 1].state != ETHARP_STATE_EMPTY) &&
+        ip_addr_cmp(ipaddr, &arp_table[n - 1].ipaddr)) {
+      return (s8_t)(n - 1);
+    }
+  }
+  return -1;
+}
+#endif /* ARP_TABLE_HASH_SIZE */
 
 
 #if ARP_QUEUEING
@@ -186,6 +259,9 @@ etharp_free_entry(int i)
     free_etharp_q(arp_table[i].q);
     arp_table[i].q = NULL;
   }
+#if ARP_TABLE_HASH_SIZE
+  etharp_hash_unlink((u8_t)i);
+#endif /* ARP_TABLE_HASH_SIZE */
   /* recycle entry for re-use */
   arp_table[i].state = ETHARP_STATE_EMPTY;
 #ifdef LWIP_DEBUG
@@ -287,8 +363,23 @@ etharp_find_entry(ip_addr_t *ipaddr, u8_t flags)
    * 4) remember the oldest pending entry with queued packets (if any)
    * 5) search for a matching IP entry, either pending or stable
    *    until 5 matches, or all entries are searched for.
+   * With ARP_TABLE_HASH_SIZE, 5) is done through the hash index up front and
+   * the sweep is only needed to pick an entry for a new address.
    */
 
+#if ARP_TABLE_HASH_SIZE
+  if (ipaddr != NULL) {
+    s8_t match = etharp_hash_lookup(ipaddr);
+    if (match >= 0) {
+      LWIP_DEBUGF(ETHARP_DEBUG | LWIP_DBG_TRACE, ("etharp_find_entry: found matching entry %"U16_F"\n", (u16_t)match));
+      return match;
+    }
+  }
+  if ((flags & ETHARP_FLAG_FIND_ONLY) != 0) {
+    return (s8_t)ERR_MEM;
+  }
+#endif /* ARP_TABLE_HASH_SIZE */
+
   for (i = 0; i < ARP_TABLE_SIZE; ++i) {
     u8_t state = arp_table[i].state;
     /* no empty entry found yet and now we do find one? */
@@ -299,12 +390,14 @@ etharp_find_entry(ip_addr_t *ipaddr, u8_t flags)
     } else if (state != ETHARP_STATE_EMPTY) {
       LWIP_ASSERT("state == ETHARP_STATE_PENDING || state >= ETHARP_STATE_STABLE",
         state == ETHARP_STATE_PENDING || state >= ETHARP_STATE_STABLE);
+#if !ARP_TABLE_HASH_SIZE
       /* if given, does IP address match IP address in ARP entry? */
       if (ipaddr && ip_addr_cmp(ipaddr, &arp_table[i].ipaddr)) {
         LWIP_DEBUGF(ETHARP_DEBUG | LWIP_DBG_TRACE, ("etharp_find_entry: found matching entry %"U16_F"\n", (u16_t)i));
         /* found exact IP address match, simply bail out */
         return i;
       }
+#endif /* !ARP_TABLE_HASH_SIZE */
       /* pending entry? */
       if (state == ETHARP_STATE_PENDING) {
         /* pending with queued packets? */
@@ -393,10 +486,17 @@ etharp_find_entry(ip_addr_t *ipaddr, u8_t flags)
   LWIP_ASSERT("arp_table[i].state == ETHARP_STATE_EMPTY",
     arp_table[i].state == ETHARP_STATE_EMPTY);
 
+#if ARP_TABLE_HASH_SIZE
+  /* an entry the caller left empty may still be linked under its old address */
+  etharp_hash_unlink(i);
+#endif /* ARP_TABLE_HASH_SIZE */
   /* IP address given? */
   if (ipaddr != NULL) {
     /* set IP address */
     ip_addr_copy(arp_table[i].ipaddr, *ipaddr);
+#if ARP_TABLE_HASH_SIZE
+    etharp_hash_link(i);
+#endif /* ARP_TABLE_HASH_SIZE */
   }
   arp_table[i].ctime = 0;
   return (err_t)i;
@@ -961,6 +1061,14 @@ etharp_output(struct netif *netif, struct pbuf *q, ip_addr_t *ipaddr)
 
     /* find stable entry: do this here since this is a critical path for
        throughput and etharp_find_entry() is kind of slow */
+#if ARP_TABLE_HASH_SIZE
+    i = etharp_hash_lookup(dst_addr);
+    if ((i >= 0) && (arp_table[i].state >= ETHARP_STATE_STABLE)) {
+      /* found an existing, stable entry */
+      ETHARP_SET_HINT(netif, i);
+      return etharp_output_to_arp_index(netif, q, i);
+    }
+#else /* ARP_TABLE_HASH_SIZE */
     for (i = 0; i < ARP_TABLE_SIZE; i++) {
       if ((arp_table[i].state >= ETHARP_STATE_STABLE) &&
           (ip_addr_cmp(dst_addr, &arp_table[i].ipaddr))) {
@@ -969,6 +1077,7 @@ etharp_output(struct netif *netif, struct pbuf *q, ip_addr_t *ipaddr)
         return etharp_output_to_arp_index(netif, q, i);
       }
     }
+#endif /* ARP_TABLE_HASH_SIZE */
     /* no stable entry found, use the (slower) query function:
        queue on destination Ethernet address belonging to ipaddr */
     return etharp_query(netif, dst_addr, q);
@@ -1099,6 +1208,12 @@ etharp_query(struct netif *netif, ip_addr_t *ipaddr, struct pbuf *q)
           pbuf_free(p);
           p = NULL;
         }
+#if TCP_GSO
+        else {
+          /* the copy still has to be cut into frames when it is sent */
+          p->gso_mss = q->gso_mss;
+        }
+#endif /* TCP_GSO */
       }
     } else {
       /* referencing the old pbuf is enough */
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file
+ *
+ * Generic segmentation of TCP super-segments.
+ *
+ * With TCP_GSO enabled, TCP passes segments carrying up to
+ * netif->gso_max_size payload bytes down the stack in one piece, so routing,
+ * ARP resolution and header construction are done once for all of them.
+ * A driver announcing such a limit calls gso_segment() from its linkoutput
+ * function: it cuts the packet into MSS-sized frames that are built from a
+ * copy of the original headers, patching only the fields that differ between
+ * frames.
+ */
+
+#include "lwip/opt.h"
+
+#if TCP_GSO /* don't build if not configured for use in lwipopts.h */
+
+#include "lwip/def.h"
+#include "lwip/ip.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/stats.h"
+#include "lwip/tcp_impl.h"
+#include "netif/gso.h"
+
+#include <string.h>
+
+#if CHECKSUM_GEN_IP
+/**
+ * Update a checksum for one changed 16-bit word (RFC 1624, eqn. 3).
+ * All values are in network byte order.
+ */
+static u16_t
+gso_chksum_adjust(u16_t chksum, u16_t old_val, u16_t new_val)
+{
+  u32_t acc;
+
+  acc = (u16_t)~chksum;
+  acc += (u16_t)~old_val;
+  acc += new_val;
+  acc = FOLD_U32T(acc);
+  acc = FOLD_U32T(acc);
+  return (u16_t)~acc;
+}
+#endif /* CHECKSUM_GEN_IP */
+
+/**
+ * Cut a TCP super-segment into frames of at most p->gso_mss payload bytes
+ * and send each of them through 'output'.
+ *
+ * The link, IP and TCP headers of p must all be in its first pbuf. Each
+ * frame gets a copy of them with IP length, IP id, TCP sequence number and
+ * checksums updated, while its payload only references the data in p. Like
+ * any packet given to linkoutput, a frame is therefore only valid during
+ * the call to 'output'; a driver that queues it has to copy it.
+ *
+ * @param netif the lwip network interface the packet is sent on
+ * @param p the super-segment (p->payload points to the link header, if any)
+ * @param ip_offset offset of the IP header in p (e.g. SIZEOF_ETH_HDR for
+ *        Ethernet frames, 0 for packets without link header)
+ * @param output function that sends one frame, usually the driver's
+ *        own low level output function
+ * @return ERR_OK if all frames were sent, the first error otherwise
+ */
+err_t
+gso_segment(struct netif *netif, struct pbuf *p, u16_t ip_offset,
+            netif_linkoutput_fn output)
+{
+  struct ip_hdr *iphdr;
+  struct tcp_hdr *tcphdr;
+  struct pbuf *q;
+  u32_t offset, seqno;
+  u16_t iphlen, tcphlen, hdrlen, datalen, q_offset, id;
+#if CHECKSUM_GEN_TCP
+  u32_t pseudo_acc;
+#endif /* CHECKSUM_GEN_TCP */
+
+  LWIP_ASSERT("gso_segment: p is not a super-segment", p->gso_mss != 0);
+
+  iphdr = (struct ip_hdr *)((u8_t *)p->payload + ip_offset);
+  LWIP_ERROR("gso_segment: no TCP/IP header in first pbuf",
+             (p->len >= ip_offset + IP_HLEN) && (IPH_PROTO(iphdr) == IP_PROTO_TCP),
+             return ERR_VAL;);
+  iphlen = IPH_HL(iphdr) * 4;
+  tcphdr = (struct tcp_hdr *)((u8_t *)iphdr + iphlen);
+  LWIP_ERROR("gso_segment: TCP header not in first pbuf",
+             p->len >= ip_offset + iphlen + TCP_HLEN, return ERR_VAL;);
+  tcphlen = TCPH_HDRLEN(tcphdr) * 4;
+  hdrlen = ip_offset + iphlen + tcphlen;
+  LWIP_ERROR("gso_segment: TCP options not in first pbuf",
+             (p->len >= hdrlen) && (p->tot_len > hdrlen), return ERR_VAL;);
+
+  datalen = p->tot_len - hdrlen;
+  seqno = ntohl(tcphdr->seqno);
+  id = ntohs(IPH_ID(iphdr));
+#if CHECKSUM_GEN_TCP
+  /* only the length field of the pseudo header differs between frames */
+  pseudo_acc = (ip4_addr_get_u32(&iphdr->src) & 0xFFFFUL) +
+               (ip4_addr_get_u32(&iphdr->src) >> 16) +
+               (ip4_addr_get_u32(&iphdr->dest) & 0xFFFFUL) +
+               (ip4_addr_get_u32(&iphdr->dest) >> 16) +
+               (u32_t)htons((u16_t)IP_PROTO_TCP);
+#endif /* CHECKSUM_GEN_TCP */
+
+  /* the payload of the first frame starts right behind the headers */
+  q = p;
+  q_offset = hdrlen;
+
+  for (offset = 0; offset < datalen; offset += p->gso_mss) {
+    struct pbuf *frame, *r;
+    struct ip_hdr *fiphdr;
+    struct tcp_hdr *ftcphdr;
+    u16_t len, left, chunk;
+    err_t err;
+
+    len = (u16_t)LWIP_MIN(p->gso_mss, datalen - offset);
+
+    /* clone the header template */
+    frame = pbuf_alloc(PBUF_RAW, hdrlen, PBUF_RAM);
+    if (frame == NULL) {
+      LINK_STATS_INC(link.memerr);
+      return ERR_MEM;
+    }
+    MEMCPY(frame->payload, p->payload, hdrlen);
+    fiphdr = (struct ip_hdr *)((u8_t *)frame->payload + ip_offset);
+    ftcphdr = (struct tcp_hdr *)((u8_t *)fiphdr + iphlen);
+
+    /* reference this frame's share of the payload (may span several pbufs) */
+    for (left = len; left > 0; left -= chunk) {
+      while (q_offset >= q->len) {
+        q_offset -= q->len;
+        q = q->next;
+        LWIP_ASSERT("gso_segment: pbuf chain shorter than tot_len", q != NULL);
+      }
+      chunk = LWIP_MIN(left, q->len - q_offset);
+      r = pbuf_alloc(PBUF_RAW, chunk, PBUF_REF);
+      if (r == NULL) {
+        pbuf_free(frame);
+        LINK_STATS_INC(link.memerr);
+        return ERR_MEM;
+      }
+      r->payload = (u8_t *)q->payload + q_offset;
+      pbuf_cat(frame, r);
+      q_offset += chunk;
+    }
+
+    /* IP: new length and id, checksum updated incrementally */
+    IPH_LEN_SET(fiphdr, htons(iphlen + tcphlen + len));
+    IPH_ID_SET(fiphdr, htons(id));
+#if CHECKSUM_GEN_IP
+    IPH_CHKSUM_SET(fiphdr, gso_chksum_adjust(IPH_CHKSUM(iphdr), IPH_LEN(iphdr), IPH_LEN(fiphdr)));
+    IPH_CHKSUM_SET(fiphdr, gso_chksum_adjust(IPH_CHKSUM(fiphdr), IPH_ID(iphdr), IPH_ID(fiphdr)));
+#endif /* CHECKSUM_GEN_IP */
+    id++;
+
+    /* TCP: new sequence number, FIN and PSH only go out with the last frame */
+    ftcphdr->seqno = htonl(seqno + offset);
+    if (offset + len < datalen) {
+      TCPH_HDRLEN_FLAGS_SET(ftcphdr, tcphlen / 4, TCPH_FLAGS(ftcphdr) & ~(TCP_FIN | TCP_PSH));
+    }
+#if CHECKSUM_GEN_TCP
+    {
+      u32_t acc = pseudo_acc + (u32_t)htons(tcphlen + len);
+      ftcphdr->chksum = 0;
+      acc += (u16_t)~inet_chksum(ftcphdr, tcphlen);
+      acc += (u16_t)~inet_chksum_pbuf(frame->next);
+      acc = FOLD_U32T(acc);
+      acc = FOLD_U32T(acc);
+      ftcphdr->chksum = (u16_t)~acc;
+    }
+#endif /* CHECKSUM_GEN_TCP */
+
+    err = output(netif, frame);
+    pbuf_free(frame);
+    if (err != ERR_OK) {
+      return err;
+    }
+  }
+  return ERR_OK;
+}
+
+#endif /* TCP_GSO */
@@ -250,13 +250,65 @@ START_TEST(test_etharp_table)
 }
 END_TEST
 
+/** Static entries whose addresses all hash to the same bucket: entries
+ * removed from the middle of a chain must not hide the rest of it. */
+START_TEST(test_etharp_hash_collisions)
+{
+  ip_addr_t adrs[ARP_TABLE_SIZE];
+  ip_addr_t *unused_ipaddr;
+  struct eth_addr *unused_ethaddr;
+  s8_t idx;
+  err_t err;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  /* 192.168.k.k: the two varying bytes cancel out in the bucket hash */
+  for(i = 0; i < ARP_TABLE_SIZE; i++) {
+    IP4_ADDR(&adrs[i], 192,168,i+2,i+2);
+    err = etharp_add_static_entry(&adrs[i], &test_ethaddr3);
+    fail_unless(err == ERR_OK);
+  }
+  for(i = 0; i < ARP_TABLE_SIZE; i++) {
+    idx = etharp_find_addr(NULL, &adrs[i], &unused_ethaddr, &unused_ipaddr);
+    fail_unless(idx == i);
+  }
+  /* remove every other entry */
+  for(i = 0; i < ARP_TABLE_SIZE; i += 2) {
+    err = etharp_remove_static_entry(&adrs[i]);
+    fail_unless(err == ERR_OK);
+  }
+  for(i = 0; i < ARP_TABLE_SIZE; i++) {
+    idx = etharp_find_addr(NULL, &adrs[i], &unused_ethaddr, &unused_ipaddr);
+    fail_unless(idx == ((i & 1) ? i : -1));
+  }
+  /* re-use the freed slots for new addresses in the same bucket */
+  for(i = 0; i < ARP_TABLE_SIZE; i += 2) {
+    IP4_ADDR(&adrs[i], 192,168,i+100,i+100);
+    err = etharp_add_static_entry(&adrs[i], &test_ethaddr4);
+    fail_unless(err == ERR_OK);
+  }
+  for(i = 0; i < ARP_TABLE_SIZE; i++) {
+    idx = etharp_find_addr(NULL, &adrs[i], &unused_ethaddr, &unused_ipaddr);
+    fail_unless(idx == i);
+    fail_unless(eth_addr_cmp(unused_ethaddr, (i & 1) ? &test_ethaddr3 : &test_ethaddr4));
+  }
+  for(i = 0; i < ARP_TABLE_SIZE; i++) {
+    err = etharp_remove_static_entry(&adrs[i]);
+    fail_unless(err == ERR_OK);
+    idx = etharp_find_addr(NULL, &adrs[i], &unused_ethaddr, &unused_ipaddr);
+    fail_unless(idx == -1);
+  }
+}
+END_TEST
+
 
 /** Create the suite including all tests for this module */
 Suite *
 etharp_suite(void)
 {
   TFun tests[] = {
-    test_etharp_table
+    test_etharp_table,
+    test_etharp_hash_collisions
   };
   return create_suite("ETHARP", tests, sizeof(tests)/sizeof(TFun), etharp_setup, etharp_teardown);
 }
@@ -32,10 +32,19 @@
 #ifndef __LWIPOPTS_H__
 #define __LWIPOPTS_H__
 
-/* Prevent having to link sys_arch.c (we don't test the API layers in unit tests) */
-#define NO_SYS                          1
-#define LWIP_NETCONN                    0
-#define LWIP_SOCKET                     0
+/* The socket tests need sys_arch.c (the unix port's) but no tcpip_thread:
+   with core locking, API calls run in the test's thread, and the tests poll
+   the netif they send to themselves on */
+#define NO_SYS                          0
+#define LWIP_NETCONN                    1
+#define LWIP_SOCKET                     1
+#define LWIP_COMPAT_SOCKETS             0
+/* let the socket functions set errno */
+#define ERRNO                           1
+#define LWIP_TCPIP_CORE_LOCKING         1
+#define LWIP_NETIF_LOOPBACK             1
+#define MEMP_NUM_NETBUF                 16
+#define LWIP_NETIF_LOOPBACK_MULTITHREADING 0
 
 /* Enable DHCP to test it, disable UDP checksum to easier inject packets */
 #define LWIP_DHCP                       1
@@ -46,8 +55,10 @@
 #define MEMP_NUM_TCP_SEG                TCP_SND_QUEUELEN
 #define TCP_SND_BUF                     (12 * TCP_MSS)
 #define TCP_WND                         (10 * TCP_MSS)
+#define TCP_GSO                         1
 
 /* Minimal changes to opt.h required for etharp unit tests: */
 #define ETHARP_SUPPORT_STATIC_ENTRIES   1
+#define ARP_TABLE_HASH_SIZE             4
 
 #endif /* __LWIPOPTS_H__ */
@@ -2,6 +2,8 @@
 
 #include "lwip/tcp_impl.h"
 #include "lwip/stats.h"
+#include "lwip/inet_chksum.h"
+#include "netif/gso.h"
 #include "tcp_helper.h"
 
 #ifdef _MSC_VER
@@ -654,6 +656,279 @@ START_TEST(test_tcp_tx_full_window_lost_from_unacked)
 }
 END_TEST
 
+#if TCP_GSO
+static u8_t gso_data[4 * TCP_MSS];
+static u32_t gso_frames;
+static u32_t gso_next_seqno;
+
+/* linkoutput for gso_segment(): check every frame is a valid TCP/IP packet */
+static err_t
+test_tcp_gso_linkoutput(struct netif *netif, struct pbuf *p)
+{
+  struct ip_hdr *iphdr = (struct ip_hdr*)p->payload;
+  struct tcp_hdr *tcphdr = (struct tcp_hdr*)(iphdr + 1);
+  u16_t datalen = p->tot_len - IP_HLEN - TCP_HLEN;
+  ip_addr_t src, dest;
+  u8_t buf[TCP_MSS];
+  LWIP_UNUSED_ARG(netif);
+
+  EXPECT(datalen <= TCP_MSS);
+  EXPECT(ntohs(IPH_LEN(iphdr)) == p->tot_len);
+  EXPECT(inet_chksum(iphdr, IP_HLEN) == 0);
+  EXPECT(ntohl(tcphdr->seqno) == gso_next_seqno);
+  ip_addr_copy(src, iphdr->src);
+  ip_addr_copy(dest, iphdr->dest);
+  pbuf_header(p, -IP_HLEN);
+  EXPECT(inet_chksum_pseudo(p, IP_PROTO_TCP, p->tot_len, &src, &dest) == 0);
+  EXPECT(pbuf_copy_partial(p, buf, datalen, TCP_HLEN) == datalen);
+  EXPECT(memcmp(buf, &gso_data[gso_next_seqno - 6510], datalen) == 0);
+  pbuf_header(p, IP_HLEN);
+
+  gso_frames++;
+  gso_next_seqno += datalen;
+  return ERR_OK;
+}
+
+/* cut the packet the netif was given into frames, check them and reset the
+   tx counters */
+static void
+test_tcp_gso_check_tx(struct netif *netif, struct test_tcp_txcounters *txcounters,
+                      u32_t seqno, u32_t frames)
+{
+  err_t err;
+
+  EXPECT_RET(txcounters->tx_packets != NULL);
+  gso_frames = 0;
+  gso_next_seqno = seqno;
+  txcounters->tx_packets->gso_mss = TCP_MSS;
+  err = gso_segment(netif, txcounters->tx_packets, 0, test_tcp_gso_linkoutput);
+  EXPECT(err == ERR_OK);
+  EXPECT(gso_frames == frames);
+  pbuf_free(txcounters->tx_packets);
+  txcounters->tx_packets = NULL;
+  txcounters->num_tx_calls = 0;
+  txcounters->num_tx_bytes = 0;
+}
+
+/** Send a super-segment through a GSO-capable netif, then cut it into
+ * frames with gso_segment() and check the frames */
+START_TEST(test_tcp_gso)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb* pcb;
+  ip_addr_t remote_ip, local_ip, netmask;
+  u16_t remote_port = 0x100, local_port = 0x101;
+  u32_t i;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < sizeof(gso_data); i++) {
+    gso_data[i] = (u8_t)(i * 7);
+  }
+
+  /* initialize local vars */
+  IP4_ADDR(&local_ip,  192, 168,   1, 1);
+  IP4_ADDR(&remote_ip, 192, 168,   1, 2);
+  IP4_ADDR(&netmask,   255, 255, 255, 0);
+  test_tcp_init_netif(&netif, &txcounters, &local_ip, &netmask);
+  netif.gso_max_size = TCP_GSO_MAX_SIZE;
+  /* a super-segment exceeds the mtu but must not be fragmented */
+  netif.mtu = 1500;
+  memset(&counters, 0, sizeof(counters));
+
+  /* create and initialize the pcb */
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &local_ip, &remote_ip, local_port, remote_port);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = pcb->snd_wnd;
+  tcp_gso_update(pcb);
+
+  /* all data goes into one segment and down to the netif in one piece */
+  err = tcp_write(pcb, gso_data, sizeof(gso_data), TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(pcb->unsent != NULL);
+  EXPECT(pcb->unsent->next == NULL);
+  EXPECT(pcb->unsent->len == sizeof(gso_data));
+  txcounters.copy_tx_packets = 1;
+  err = tcp_output(pcb);
+  txcounters.copy_tx_packets = 0;
+  EXPECT_RET(err == ERR_OK);
+  EXPECT(txcounters.num_tx_calls == 1);
+  EXPECT(txcounters.num_tx_bytes == sizeof(gso_data) + 40U);
+  EXPECT_RET(txcounters.tx_packets != NULL);
+  EXPECT(pcb->unacked != NULL && pcb->unacked->p->gso_mss == TCP_MSS);
+
+  /* cut it into frames */
+  gso_frames = 0;
+  gso_next_seqno = 6510;
+  txcounters.tx_packets->gso_mss = TCP_MSS;
+  err = gso_segment(&netif, txcounters.tx_packets, 0, test_tcp_gso_linkoutput);
+  EXPECT(err == ERR_OK);
+  EXPECT(gso_frames == sizeof(gso_data) / TCP_MSS);
+  EXPECT(gso_next_seqno == 6510 + sizeof(gso_data));
+  pbuf_free(txcounters.tx_packets);
+  txcounters.tx_packets = NULL;
+
+  /* make sure the pcb is freed */
+  EXPECT_RET(lwip_stats.memp[MEMP_TCP_PCB].used == 1);
+  tcp_abort(pcb);
+  EXPECT_RET(lwip_stats.memp[MEMP_TCP_PCB].used == 0);
+}
+END_TEST
+
+/** A super-segment bigger than cwnd must be split so that the part that
+ * fits is sent (instead of waiting forever for cwnd to grow) */
+START_TEST(test_tcp_gso_split_cwnd)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb* pcb;
+  struct pbuf* p;
+  ip_addr_t remote_ip, local_ip, netmask;
+  u16_t remote_port = 0x100, local_port = 0x101;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  /* initialize local vars */
+  IP4_ADDR(&local_ip,  192, 168,   1, 1);
+  IP4_ADDR(&remote_ip, 192, 168,   1, 2);
+  IP4_ADDR(&netmask,   255, 255, 255, 0);
+  test_tcp_init_netif(&netif, &txcounters, &local_ip, &netmask);
+  netif.gso_max_size = TCP_GSO_MAX_SIZE;
+  memset(&counters, 0, sizeof(counters));
+
+  /* create and initialize the pcb */
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &local_ip, &remote_ip, local_port, remote_port);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = 2 * TCP_MSS + 10;
+  tcp_gso_update(pcb);
+
+  err = tcp_write(pcb, gso_data, sizeof(gso_data), TCP_WRITE_FLAG_COPY);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT(pcb->snd_queuelen == 1);
+  txcounters.copy_tx_packets = 1;
+  err = tcp_output(pcb);
+  EXPECT_RET(err == ERR_OK);
+  /* two frames fit into cwnd */
+  EXPECT(txcounters.num_tx_calls == 1);
+  EXPECT(txcounters.num_tx_bytes == 2 * TCP_MSS + 40U);
+  EXPECT_RET(pcb->unacked != NULL && pcb->unsent != NULL);
+  EXPECT(pcb->unacked->len == 2 * TCP_MSS);
+  EXPECT(pcb->unsent->len == sizeof(gso_data) - 2 * TCP_MSS);
+  /* the head references the data of the original segment (but for the bytes
+     the original's header was moved to) */
+  EXPECT(pcb->snd_queuelen == 4);
+  test_tcp_gso_check_tx(&netif, &txcounters, 6510, 2);
+
+  /* ACK the first part: the rest goes out */
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 2 * TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(txcounters.num_tx_calls == 1);
+  EXPECT(txcounters.num_tx_bytes == sizeof(gso_data) - 2 * TCP_MSS + 40U);
+  EXPECT(pcb->unsent == NULL);
+  test_tcp_gso_check_tx(&netif, &txcounters, 6510 + 2 * TCP_MSS, 2);
+
+  /* make sure the pcb is freed */
+  EXPECT_RET(lwip_stats.memp[MEMP_TCP_PCB].used == 1);
+  tcp_abort(pcb);
+  EXPECT_RET(lwip_stats.memp[MEMP_TCP_PCB].used == 0);
+}
+END_TEST
+
+/** Split a super-segment built from several non-copied pbufs: the head
+ * takes over whole pbufs and references into the pbuf the split falls into */
+START_TEST(test_tcp_gso_split_nocopy)
+{
+  struct netif netif;
+  struct test_tcp_txcounters txcounters;
+  struct test_tcp_counters counters;
+  struct tcp_pcb* pcb;
+  struct pbuf* p;
+  ip_addr_t remote_ip, local_ip, netmask;
+  u16_t remote_port = 0x100, local_port = 0x101;
+  u32_t i;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  for (i = 0; i < sizeof(gso_data); i++) {
+    gso_data[i] = (u8_t)(i * 7);
+  }
+
+  /* initialize local vars */
+  IP4_ADDR(&local_ip,  192, 168,   1, 1);
+  IP4_ADDR(&remote_ip, 192, 168,   1, 2);
+  IP4_ADDR(&netmask,   255, 255, 255, 0);
+  test_tcp_init_netif(&netif, &txcounters, &local_ip, &netmask);
+  netif.gso_max_size = TCP_GSO_MAX_SIZE;
+  memset(&counters, 0, sizeof(counters));
+
+  /* create and initialize the pcb */
+  pcb = test_tcp_new_counters_pcb(&counters);
+  EXPECT_RET(pcb != NULL);
+  tcp_set_state(pcb, ESTABLISHED, &local_ip, &remote_ip, local_port, remote_port);
+  pcb->mss = TCP_MSS;
+  pcb->cwnd = 2 * TCP_MSS + 10;
+  tcp_gso_update(pcb);
+
+  /* one segment: header pbuf + ROM pbufs of 1.5, 1.5 and 1 frames */
+  err = tcp_write(pcb, gso_data, 3 * TCP_MSS / 2, 0);
+  EXPECT_RET(err == ERR_OK);
+  err = tcp_write(pcb, &gso_data[3 * TCP_MSS / 2], 3 * TCP_MSS / 2, 0);
+  EXPECT_RET(err == ERR_OK);
+  err = tcp_write(pcb, &gso_data[3 * TCP_MSS], TCP_MSS, 0);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT_RET(pcb->unsent != NULL && pcb->unsent->next == NULL);
+  EXPECT(pcb->snd_queuelen == 4);
+
+  /* split in the middle of the second ROM pbuf */
+  txcounters.copy_tx_packets = 1;
+  err = tcp_output(pcb);
+  EXPECT_RET(err == ERR_OK);
+  EXPECT(txcounters.num_tx_calls == 1);
+  EXPECT_RET(pcb->unacked != NULL && pcb->unsent != NULL);
+  EXPECT(pcb->unacked->len == 2 * TCP_MSS);
+  EXPECT(pcb->unsent->len == 2 * TCP_MSS);
+  EXPECT(pcb->snd_queuelen == 6);
+  test_tcp_gso_check_tx(&netif, &txcounters, 6510, 2);
+
+  /* ACK it with a smaller cwnd: only one frame (the rest of the second ROM
+     pbuf) goes out */
+  pcb->cwnd = 10;
+  pcb->ssthresh = 2 * TCP_MSS;
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, 2 * TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(txcounters.num_tx_calls == 1);
+  EXPECT(txcounters.num_tx_bytes == TCP_MSS + 40U);
+  EXPECT_RET(pcb->unacked != NULL && pcb->unsent != NULL);
+  EXPECT(pcb->unsent->len == TCP_MSS);
+  EXPECT(pcb->snd_queuelen == 4);
+  test_tcp_gso_check_tx(&netif, &txcounters, 6510 + 2 * TCP_MSS, 1);
+
+  /* ACK that: the last frame goes out */
+  p = tcp_create_rx_segment(pcb, NULL, 0, 0, TCP_MSS, TCP_ACK);
+  EXPECT_RET(p != NULL);
+  test_tcp_input(p, &netif);
+  EXPECT(txcounters.num_tx_calls == 1);
+  EXPECT(pcb->unsent == NULL);
+  EXPECT(pcb->snd_queuelen == 2);
+  test_tcp_gso_check_tx(&netif, &txcounters, 6510 + 3 * TCP_MSS, 1);
+
+  /* make sure the pcb is freed */
+  EXPECT_RET(lwip_stats.memp[MEMP_TCP_PCB].used == 1);
+  tcp_abort(pcb);
+  EXPECT_RET(lwip_stats.memp[MEMP_TCP_PCB].used == 0);
+}
+END_TEST
+#endif /* TCP_GSO */
+
 /** Create the suite including all tests for this module */
 Suite *
 tcp_suite(void)
@@ -666,6 +941,11 @@ tcp_suite(void)
     test_tcp_rto_rexmit_wraparound,
     test_tcp_tx_full_window_lost_from_unacked,
     test_tcp_tx_full_window_lost_from_unsent
+#if TCP_GSO
+    , test_tcp_gso
+    , test_tcp_gso_split_cwnd
+    , test_tcp_gso_split_nocopy
+#endif /* TCP_GSO */
   };
   return create_suite("TCP", tests, sizeof(tests)/sizeof(TFun), tcp_setup, tcp_teardown);
 }
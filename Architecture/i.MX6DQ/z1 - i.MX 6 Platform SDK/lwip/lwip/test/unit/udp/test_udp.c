@@ -2,6 +2,10 @@
 
 #include "lwip/udp.h"
 #include "lwip/stats.h"
+#include "lwip/tcpip.h"
+#include "lwip/sockets.h"
+
+#include <errno.h>
 
 #if !LWIP_STATS || !UDP_STATS || !MEMP_STATS
 #error "This tests needs UDP- and MEMP-statistics enabled"
@@ -56,13 +60,142 @@ START_TEST(test_udp_new_remove)
 }
 END_TEST
 
+#if LWIP_SOCKET
+#define UDP_MMSG_COUNT  (LWIP_SOCKET_BATCH_MAX + 2)
+
+static u8_t
+udp_mmsg_byte(int dgram, int i)
+{
+  return (u8_t)(dgram * 31 + i);
+}
+
+static err_t
+udp_mmsg_netif_output(struct netif *netif, struct pbuf *p, ip_addr_t *ipaddr)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(p);
+  LWIP_UNUSED_ARG(ipaddr);
+  /* only datagrams to the netif's own address are sent */
+  fail();
+  return ERR_IF;
+}
+
+static err_t
+udp_mmsg_netif_init(struct netif *netif)
+{
+  netif->output = udp_mmsg_netif_output;
+  netif->mtu = 1500;
+  return ERR_OK;
+}
+
+/** Send more datagrams than fit into one batch to the socket itself (looped
+ * back by the netif) with lwip_sendmmsg() and read them back with
+ * lwip_recvmmsg() */
+START_TEST(test_udp_sendmmsg_recvmmsg)
+{
+  struct netif netif;
+  ip_addr_t ipaddr, netmask, gw;
+  struct sockaddr_in addr;
+  struct mmsghdr tx[UDP_MMSG_COUNT], rx[UDP_MMSG_COUNT];
+  struct iovec tx_iov[UDP_MMSG_COUNT][2], rx_iov[UDP_MMSG_COUNT][2];
+  u8_t tx_buf[UDP_MMSG_COUNT][100], rx_buf[UDP_MMSG_COUNT][100];
+  struct timeval tv;
+  int s, ret, i, j;
+  LWIP_UNUSED_ARG(_i);
+
+  /* no tcpip_thread: the API calls take the core lock themselves */
+  fail_unless(sys_mutex_new(&lock_tcpip_core) == ERR_OK);
+  IP4_ADDR(&ipaddr, 192, 168, 1, 1);
+  IP4_ADDR(&netmask, 255, 255, 255, 0);
+  IP4_ADDR(&gw, 192, 168, 1, 2);
+  fail_unless(netif_add(&netif, &ipaddr, &netmask, &gw, NULL, udp_mmsg_netif_init, ip_input) == &netif);
+  netif_set_up(&netif);
+
+  s = lwip_socket(AF_INET, SOCK_DGRAM, 0);
+  fail_unless(s >= 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_len = sizeof(addr);
+  addr.sin_family = AF_INET;
+  addr.sin_port = PP_HTONS(7000);
+  inet_addr_from_ipaddr(&addr.sin_addr, &ipaddr);
+  fail_unless(lwip_bind(s, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+  /* datagram i: a 4-byte header and 10 * i bytes of data in two iovecs */
+  memset(tx, 0, sizeof(tx));
+  for (i = 0; i < UDP_MMSG_COUNT; i++) {
+    for (j = 0; j < 4 + 10 * i; j++) {
+      tx_buf[i][j] = udp_mmsg_byte(i, j);
+    }
+    tx_iov[i][0].iov_base = tx_buf[i];
+    tx_iov[i][0].iov_len = 4;
+    tx_iov[i][1].iov_base = &tx_buf[i][4];
+    tx_iov[i][1].iov_len = 10 * i;
+    tx[i].msg_hdr.msg_name = &addr;
+    tx[i].msg_hdr.msg_namelen = sizeof(addr);
+    tx[i].msg_hdr.msg_iov = tx_iov[i];
+    tx[i].msg_hdr.msg_iovlen = 2;
+  }
+  ret = lwip_sendmmsg(s, tx, UDP_MMSG_COUNT, 0);
+  fail_unless(ret == UDP_MMSG_COUNT);
+  for (i = 0; i < UDP_MMSG_COUNT; i++) {
+    fail_unless(tx[i].msg_len == (unsigned int)(4 + 10 * i));
+  }
+
+  /* the last datagram does not fit into its buffers */
+  memset(rx, 0, sizeof(rx));
+  for (i = 0; i < UDP_MMSG_COUNT; i++) {
+    rx_iov[i][0].iov_base = rx_buf[i];
+    rx_iov[i][0].iov_len = 16;
+    rx_iov[i][1].iov_base = &rx_buf[i][16];
+    rx_iov[i][1].iov_len = (i == UDP_MMSG_COUNT - 1) ? 20 : 84;
+    rx[i].msg_hdr.msg_iov = rx_iov[i];
+    rx[i].msg_hdr.msg_iovlen = 2;
+  }
+  /* deliver the datagrams the netif looped back */
+  LOCK_TCPIP_CORE();
+  netif_poll(&netif);
+  UNLOCK_TCPIP_CORE();
+  ret = lwip_recvmmsg(s, rx, UDP_MMSG_COUNT, 0, NULL);
+  fail_unless(ret == UDP_MMSG_COUNT);
+  for (i = 0; i < UDP_MMSG_COUNT - 1; i++) {
+    fail_unless(rx[i].msg_len == (unsigned int)(4 + 10 * i));
+    fail_unless(rx[i].msg_hdr.msg_flags == 0);
+    fail_unless(memcmp(rx_buf[i], tx_buf[i], rx[i].msg_len) == 0);
+  }
+  fail_unless(rx[i].msg_len == 36);
+  fail_unless(rx[i].msg_hdr.msg_flags == MSG_TRUNC);
+  fail_unless(memcmp(rx_buf[i], tx_buf[i], 36) == 0);
+
+  /* nothing left */
+  ret = lwip_recvmmsg(s, rx, UDP_MMSG_COUNT, MSG_DONTWAIT, NULL);
+  fail_unless(ret == -1);
+  fail_unless(errno == EWOULDBLOCK);
+
+  /* a timeout is rejected instead of being ignored */
+  tv.tv_sec = 1;
+  tv.tv_usec = 0;
+  ret = lwip_recvmmsg(s, rx, UDP_MMSG_COUNT, 0, &tv);
+  fail_unless(ret == -1);
+  fail_unless(errno == EINVAL);
+
+  /* lwip_close() needs the tcpip_thread (netconn_delete() does not use the
+     core lock), udp_teardown() removes the pcb */
+  netif_remove(&netif);
+  sys_mutex_free(&lock_tcpip_core);
+}
+END_TEST
+#endif /* LWIP_SOCKET */
+
 
 /** Create the suite including all tests for this module */
 Suite *
 udp_suite(void)
 {
   TFun tests[] = {
-    test_udp_new_remove,
+    test_udp_new_remove
+#if LWIP_SOCKET
+    , test_udp_sendmmsg_recvmmsg
+#endif /* LWIP_SOCKET */
   };
   return create_suite("UDP", tests, sizeof(tests)/sizeof(TFun), udp_setup, udp_teardown);
 }
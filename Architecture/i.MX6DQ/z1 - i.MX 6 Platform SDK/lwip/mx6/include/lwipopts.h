@@ -28,6 +28,10 @@
 #define MEM_ALIGNMENT					4
 #define MEM_SIZE						(128 * 1024)
 
+// Copy pbuf payloads with the NEON routines rather than newlib.
+#include "utility/fast_string.h"
+#define MEMCPY(dst,src,len)             fast_memcpy(dst,src,len)
+
 #define MEMP_SEPARATE_POOLS				1		// for PBUF_POOL alignment to cache line size
 
 #define LWIP_ALLOW_MEM_FREE_FROM_OTHER_CONTEXT 0
@@ -62,6 +66,7 @@
 #define ETH_PAD_SIZE					2
 #define LWIP_ARP						1
 #define ARP_TABLE_SIZE					30
+#define ARP_TABLE_HASH_SIZE				16
 #define ARP_QUEUEING					1
 #define ETHARP_TRUST_IP_MAC				1
 #define ETHARP_SUPPORT_VLAN				0
@@ -157,6 +162,7 @@
 #define TCP_SND_QUEUELEN				(2 * TCP_SND_BUF/TCP_MSS)
 #define TCP_SNDLOWAT					(TCP_SND_BUF/2)
 #define TCP_LISTEN_BACKLOG				1
+#define TCP_GSO							1
 
 /*
    ----------------------------------
@@ -177,6 +183,7 @@
 #define LWIP_NETIF_LOOPBACK				1
 #define LWIP_NETIF_STATUS_CALLBACK      1
 #define LWIP_NETIF_LINK_CALLBACK		1
+#define LWIP_NETIF_TX_BATCH				1
 
 /*
    ------------------------------------
@@ -48,10 +48,12 @@
 #include "lwip/ethip6.h"
 #include "netif/etharp.h"
 #include "netif/ppp_oe.h"
+#include "netif/gso.h"
 
 #include "sdk.h"
 #include "iomux_config.h"
 #include "registers/regsiomuxc.h"
+#include "utility/fast_string.h"
 
 #if CHIP_MX6DQ || CHIP_MX6SDL
 #include "enet/enet.h"
@@ -215,6 +217,11 @@ low_level_init(struct netif *netif)
     /* device capabilities */
     /* don't set NETIF_FLAG_ETHARP if this device is not an ethernet one */
     netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
+
+#if TCP_GSO
+    /* TCP super-segments are cut into frames in low_level_output() */
+    netif->gso_max_size = TCP_GSO_MAX_SIZE;
+#endif
  
     /* Do whatever else is needed to initialize interface. */    
 #if CHIP_MX6DQ || CHIP_MX6SDL
@@ -246,6 +253,14 @@ low_level_output(struct netif *netif, struct pbuf *p)
 //     struct enet *enet = netif->state;
     struct pbuf *q;
     u32_t l = 0;
+    int err = 0;
+
+#if TCP_GSO
+    if (p->gso_mss != 0) {
+        /* one TCP super-segment per routing/ARP pass, frames go out below */
+        return gso_segment(netif, p, SIZEOF_ETH_HDR, low_level_output);
+    }
+#endif
 
 //   initiate transfer();
     
@@ -257,26 +272,70 @@ low_level_output(struct netif *netif, struct pbuf *p)
         /* Send the data from the pbuf to the interface, one pbuf at a
              time. The size of the data in each pbuf is kept in the ->len
              variable. */
-        memcpy(&s_pkt_send[l], (u8_t*) q->payload, q->len);
+        fast_memcpy(&s_pkt_send[l], (u8_t*) q->payload, q->len);
         l += q->len;
     }
 
 //     printf("enetif: sending %d bytes\n", l);
+#if LWIP_NETIF_TX_BATCH
+    /* inside a batch, only queue the frame; low_level_tx_flush() starts
+       the transmitter once for all of them */
+    if (netif->tx_batch != 0) {
+#if CHIP_MX6DQ || CHIP_MX6SDL
+        if (imx_enet_send_queued(g_en0, s_pkt_send, l, 1) != 0) {
+            /* ring full: start the queued frames, fails if none is free yet */
+            err = imx_enet_send(g_en0, s_pkt_send, l, 1);
+        }
+#elif CHIP_MX6SL
+        if (imx_fec_send_queued(g_en0, s_pkt_send, l, 1) != 0) {
+            err = imx_fec_send(g_en0, s_pkt_send, l, 1);
+        }
+#endif
+    } else
+#endif /* LWIP_NETIF_TX_BATCH */
+    {
 #if CHIP_MX6DQ || CHIP_MX6SDL
-    imx_enet_send(g_en0, s_pkt_send, l, 1);
+        err = imx_enet_send(g_en0, s_pkt_send, l, 1);
 #elif CHIP_MX6SL
-    imx_fec_send(g_en0, s_pkt_send, l, 1);
+        err = imx_fec_send(g_en0, s_pkt_send, l, 1);
 #endif
+    }
 
 #if ETH_PAD_SIZE
     pbuf_header(p, ETH_PAD_SIZE); /* reclaim the padding word */
 #endif
+
+    if (err != 0) {
+        /* TX ring full; TCP retransmits the frame, other protocols drop it */
+        LINK_STATS_INC(link.memerr);
+        LINK_STATS_INC(link.drop);
+        return ERR_MEM;
+    }
     
     LINK_STATS_INC(link.xmit);
 
     return ERR_OK;
 }
 
+#if LWIP_NETIF_TX_BATCH
+/**
+ * Start transmission of the frames low_level_output() queued during a batch
+ * (see netif_tx_batch_end()): a single write to the TDAR doorbell.
+ *
+ * @param netif the lwip network interface structure for this enet
+ */
+static void
+low_level_tx_flush(struct netif *netif)
+{
+    LWIP_UNUSED_ARG(netif);
+#if CHIP_MX6DQ || CHIP_MX6SDL
+    imx_enet_send_flush(g_en0);
+#elif CHIP_MX6SL
+    imx_fec_send_flush(g_en0);
+#endif
+}
+#endif /* LWIP_NETIF_TX_BATCH */
+
 /**
  * Should allocate a pbuf and transfer the bytes of the incoming
  * packet from the interface into the pbuf.
@@ -326,7 +385,7 @@ low_level_input(struct netif *netif)
              * actually received size. In this case, ensure the tot_len member of the
              * pbuf is the sum of the chained pbuf len members.
              */
-            memcpy((u8_t*) q->payload, &s_pkt_recv[l], q->len);
+            fast_memcpy((u8_t*) q->payload, &s_pkt_recv[l], q->len);
             l = l + q->len;
         }
 //         acknowledge that packet has been read();
@@ -468,6 +527,9 @@ enet_init(struct netif *netif)
     netif->output_ip6 = ethip6_output;
 #endif /* LWIP_IPV6 */
     netif->linkoutput = low_level_output;
+#if LWIP_NETIF_TX_BATCH
+    netif->tx_flush = low_level_tx_flush;
+#endif /* LWIP_NETIF_TX_BATCH */
     
 //     enet->ethaddr = (struct eth_addr *)&(netif->hwaddr[0]);
     
@@ -97,3 +97,7 @@ USE_THUMB ?= 0
 # Enable debug build by default.
 DEBUG ?= 1
 
+# Set to 1 to collect acquisition, spin and hold time statistics in the ticket, MCS and
+# reader-writer spinlocks. The SDK library and the application must use the same value.
+SPINLOCK_STATS ?= 0
+DEFINES += -DSPINLOCK_STATS=$(SPINLOCK_STATS)
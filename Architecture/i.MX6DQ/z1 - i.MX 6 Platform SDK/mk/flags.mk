@@ -128,6 +128,10 @@ CXXFLAGS += -fno-exceptions -fno-rtti
 # against anything, even compiler libs because of -nostdlib.
 LDADD += -lm -lstdc++ -lc -lgcc
 
+# Pull the SDK allocator in utility/src/smp_malloc.c into the link first. Otherwise
+# newlib's own malloc could be linked to satisfy the calls made from within libc.
+LDFLAGS += --undefined=_malloc_r
+
 # These include paths have to be quoted because they may contain spaces,
 # particularly under cygwin.
 LDINC += -L '$(LIBGCC_LDPATH)' -L '$(LIBC_LDPATH)'
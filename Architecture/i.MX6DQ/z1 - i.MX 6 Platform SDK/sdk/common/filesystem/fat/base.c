@@ -45,6 +45,7 @@
 #include "usdhc/usdhc_ifc.h"
 #include "fat_internal.h"
 #include "diroffset.h"
+#include "utility/fast_string.h"
 #include <string.h>
 
 #define INVALID_CLUSTER     0x7fffffff
@@ -319,7 +320,7 @@ RtStatus_t Fread_FAT(int32_t HandleNumber, uint8_t * Buffer, int32_t NumBytesToR
 
             RemainBytesToRead -= BytesToCopy;
 
-            memcpy(Buffer + BuffOffset, buf + Handle[HandleNumber].BytePosInSector, BytesToCopy);
+            fast_memcpy(Buffer + BuffOffset, buf + Handle[HandleNumber].BytePosInSector, BytesToCopy);
 
             FSReleaseSector(cacheToken);
             LeaveNonReentrantSection();
@@ -602,7 +603,7 @@ RtStatus_t Fwrite_FAT(int32_t HandleNumber, uint8_t * Buffer, int32_t NumBytesTo
                 tempToken = malloc(BytesToCopy + 2 * cache_line);
                 tempBuffer =
                     (uint8_t *) (((uint32_t) tempToken + cache_line) & (~(cache_line - 1)));
-                memcpy(tempBuffer, (uint8_t *) (Buffer + BuffOffset), BytesToCopy);
+                fast_memcpy(tempBuffer, (uint8_t *) (Buffer + BuffOffset), BytesToCopy);
                 if ((RetValue = FSWriteMultiSectors(Device,
                                                     sectorStart,
                                                     WRITE_TYPE_RANDOM, tempBuffer, BytesToCopy))
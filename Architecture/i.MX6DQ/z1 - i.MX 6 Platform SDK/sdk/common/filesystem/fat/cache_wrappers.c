@@ -43,6 +43,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "usdhc/usdhc_ifc.h"
+#include "utility/fast_string.h"
 #include <assert.h>
 
 uint32_t g_usdhc_instance = HW_USDHC3;
@@ -284,8 +285,8 @@ RtStatus_t FSWriteSector(int32_t deviceNumber, int32_t sectorNumber, int32_t des
             if (fatCache->isValid)  // already in RAM
             {
                 /*copy the fat entry into the cache */
-                memcpy((uint8_t *) ((uint32_t) fatCache->buffer + destOffset),
-                       (uint8_t *) (sourceBuffer + sourceOffset), numBytesToWrite);
+                fast_memcpy((uint8_t *) ((uint32_t) fatCache->buffer + destOffset),
+                            (uint8_t *) (sourceBuffer + sourceOffset), numBytesToWrite);
                 return SUCCESS;
             } else {
                 card_wait_xfer_done(g_usdhc_instance);
@@ -293,8 +294,8 @@ RtStatus_t FSWriteSector(int32_t deviceNumber, int32_t sectorNumber, int32_t des
                     card_data_read(g_usdhc_instance, (int *)fatCache->buffer, writeSize,
                                    destAddrOffset);
                 card_wait_xfer_done(g_usdhc_instance);
-                memcpy((uint8_t *) ((uint32_t) fatCache->buffer + destOffset),
-                       (uint8_t *) (sourceBuffer + sourceOffset), numBytesToWrite);
+                fast_memcpy((uint8_t *) ((uint32_t) fatCache->buffer + destOffset),
+                            (uint8_t *) (sourceBuffer + sourceOffset), numBytesToWrite);
                 return SUCCESS;
             }
         } else {
@@ -309,8 +310,8 @@ RtStatus_t FSWriteSector(int32_t deviceNumber, int32_t sectorNumber, int32_t des
             status = card_data_read(g_usdhc_instance, (int *)buffer, writeSize, destAddrOffset);
             card_wait_xfer_done(g_usdhc_instance);
 
-            memcpy((uint8_t *) ((uint32_t) buffer + destOffset),
-                   (uint8_t *) (sourceBuffer + sourceOffset), numBytesToWrite);
+            fast_memcpy((uint8_t *) ((uint32_t) buffer + destOffset),
+                        (uint8_t *) (sourceBuffer + sourceOffset), numBytesToWrite);
             status = card_data_write(g_usdhc_instance, (int *)buffer, writeSize, destAddrOffset);
             card_wait_xfer_done(g_usdhc_instance);
             free(buffer_token);
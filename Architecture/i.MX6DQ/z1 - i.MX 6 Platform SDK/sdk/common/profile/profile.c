@@ -28,26 +28,504 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/*!
+ * @file profile.c
+ * @brief Cortex-A9 performance monitor counters and sampling profiler.
+ */
+
+#include "sdk.h"
+#include "core/cortex_a9.h"
+#include "core/gic.h"
+#include "core/interrupt.h"
+#include "utility/atomics.h"
+#include "utility/spinlock.h"
+#include "profile/profile.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Maximum number of cores that can be profiled.
+#define PROFILE_MAX_CPUS (4)
+
+//! @name PMCR bits
+//@{
+#define PMCR_E (1 << 0)     //!< Enable all counters.
+#define PMCR_P (1 << 1)     //!< Reset the event counters.
+#define PMCR_C (1 << 2)     //!< Reset the cycle counter.
+#define PMCR_D (1 << 3)     //!< Count every 64th cycle.
+//@}
+
+//! @brief Bit for the cycle counter in the enable, overflow and interrupt enable registers.
+#define PMU_CYCLE_COUNTER_BIT (1u << 31)
+
+//! @brief Bits for all counters in the enable, overflow and interrupt enable registers.
+#define PMU_ALL_COUNTERS (PMU_CYCLE_COUNTER_BIT | ((1 << PMU_EVENT_COUNTER_COUNT) - 1))
+
+//! @name PMU register accessors
+//@{
+#define PMU_WRITE_PMCR(v)       _ARM_MCR(15, 0, v, 9, 12, 0)
+#define PMU_READ_PMCR(v)        _ARM_MRC(15, 0, v, 9, 12, 0)
+#define PMU_WRITE_CNTENSET(v)   _ARM_MCR(15, 0, v, 9, 12, 1)
+#define PMU_WRITE_CNTENCLR(v)   _ARM_MCR(15, 0, v, 9, 12, 2)
+#define PMU_READ_OVSR(v)        _ARM_MRC(15, 0, v, 9, 12, 3)
+#define PMU_WRITE_OVSR(v)       _ARM_MCR(15, 0, v, 9, 12, 3)
+#define PMU_WRITE_SELR(v)       _ARM_MCR(15, 0, v, 9, 12, 5)
+#define PMU_READ_CCNTR(v)       _ARM_MRC(15, 0, v, 9, 13, 0)
+#define PMU_WRITE_EVTYPER(v)    _ARM_MCR(15, 0, v, 9, 13, 1)
+#define PMU_READ_EVCNTR(v)      _ARM_MRC(15, 0, v, 9, 13, 2)
+#define PMU_WRITE_EVCNTR(v)     _ARM_MCR(15, 0, v, 9, 13, 2)
+#define PMU_WRITE_INTENSET(v)   _ARM_MCR(15, 0, v, 9, 14, 1)
+#define PMU_WRITE_INTENCLR(v)   _ARM_MCR(15, 0, v, 9, 14, 2)
+//@}
+
+//! @brief Profiling state of one core.
+typedef struct _profile_cpu {
+    volatile uint32_t overflows[PMU_EVENT_COUNTER_COUNT];   //!< Upper 32 bits of each event count.
+    volatile uint32_t cycleOverflows;   //!< Upper 32 bits of the cycle count.
+    volatile uint32_t samples;          //!< Program counter samples taken.
+    volatile uint32_t outside;          //!< Samples outside of the histogram range.
+    uint32_t sampleCounter;             //!< Index of the sampling counter, or PMU_EVENT_COUNTER_COUNT.
+    uint32_t samplePeriod;              //!< Events between two samples.
+    profile_counts_t counts;            //!< Counts latched by profile_stop().
+    uint32_t histogram[PROFILE_BUCKET_COUNT];   //!< Program counter histogram.
+} profile_cpu_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Externs
+////////////////////////////////////////////////////////////////////////////////
+
+extern char __text_start;
+extern char __text_end;
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Profiling state of each core.
+static profile_cpu_t s_profileCpu[PROFILE_MAX_CPUS];
+
+//! @brief Mask of the cores between profile_start() and profile_stop().
+static volatile uint32_t s_runningCpus;
+
+//! @brief Serializes changes to s_runningCpus with the routing of the PMU interrupt.
+//!
+//! Zeroed .bss is the unlocked state.
+static ticket_lock_t s_routeLock;
+
+//! @brief Mask of the cores that have profiled since profile_init().
+static volatile uint32_t s_profiledCpus;
+
+//! @brief First address covered by the histograms.
+static uint32_t s_textStart;
+
+//! @brief Address past the range covered by the histograms.
+static uint32_t s_textEnd;
+
+//! @brief Log2 of the size of a histogram bucket.
+static uint32_t s_bucketShift;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
 void StartPerfCounter(void)
 {
-    asm("mov r1, #12");         /* divider enable (64 cycles/count), cycle counter reset */
-    asm("mcr p15, 0, r1, c9, c12, 0");
+    uint32_t value;
 
-    asm("ldr r1,=0x80000000");
-    asm("mcr p15, 0, r1, c9, c12, 1");  /*enable C bit of c9,Count Enable Set register */
+    // Enable the divider and reset the cycle counter.
+    value = PMCR_D | PMCR_C;
+    PMU_WRITE_PMCR(value);
 
-    asm("mov r1, #9");          /* Counter enable */
-    asm("mcr p15, 0, r1, c9, c12, 0");
+    value = PMU_CYCLE_COUNTER_BIT;
+    PMU_WRITE_CNTENSET(value);
+
+    value = PMCR_D | PMCR_E;
+    PMU_WRITE_PMCR(value);
 }
 
-unsigned int StopPerfCounter(void)
+uint32_t StopPerfCounter(void)
 {
-    unsigned int counter = 0;
-
-    asm volatile ("mrc p15, 0, %0, c9, c13, 0":"=r" (counter):);
+    uint32_t counter = 0;
+    uint32_t value = PMU_CYCLE_COUNTER_BIT;
 
-    asm("ldr r1,=0x80000000");
-    asm("mcr p15, 0, r1, c9, c12, 2 "); /*disable C bit of c9,Count Clear register */
+    PMU_READ_CCNTR(counter);
+    PMU_WRITE_CNTENCLR(value);
 
     return counter * 64;
 }
+
+//! @brief Atomically set or clear bits of a CPU mask.
+static void profile_update_mask(volatile uint32_t * mask, uint32_t bits, bool set)
+{
+    uint32_t oldValue;
+    
+    do
+    {
+        oldValue = *mask;
+    } while (!atomic_compare_and_swap(mask, oldValue, set ? (oldValue | bits) : (oldValue & ~bits)));
+}
+
+//! @brief Take the routing lock with IRQs masked on this core.
+//! @return The previous IRQ state, for profile_route_unlock().
+static bool profile_route_lock(void)
+{
+    bool wasEnabled = arm_set_interrupt_state(false);
+    ticket_lock_lock(&s_routeLock);
+    return wasEnabled;
+}
+
+static void profile_route_unlock(bool wasEnabled)
+{
+    ticket_lock_unlock(&s_routeLock);
+    arm_set_interrupt_state(wasEnabled);
+}
+
+//! @brief Handle the counter overflows of the current core.
+//! @return Whether any counter of this core had overflowed.
+static bool profile_service_overflow(void)
+{
+    uint32_t cpu = cpu_get_current();
+    profile_cpu_t * state = &s_profileCpu[cpu];
+    uint32_t overflow;
+    uint32_t i;
+    
+    PMU_READ_OVSR(overflow);
+    overflow &= PMU_ALL_COUNTERS;
+    if (!overflow)
+    {
+        return false;
+    }
+    
+    // Writing ones clears the flags and with them this core's interrupt request.
+    PMU_WRITE_OVSR(overflow);
+    
+    if (overflow & PMU_CYCLE_COUNTER_BIT)
+    {
+        ++state->cycleOverflows;
+    }
+    
+    for (i = 0; i < PMU_EVENT_COUNTER_COUNT; ++i)
+    {
+        if (!(overflow & (1 << i)))
+        {
+            continue;
+        }
+        
+        if (i == state->sampleCounter)
+        {
+            uint32_t pc = get_interrupted_pc();
+            uint32_t reload = -state->samplePeriod;
+            
+            if (pc >= s_textStart && pc < s_textEnd)
+            {
+                ++state->histogram[(pc - s_textStart) >> s_bucketShift];
+            }
+            else
+            {
+                ++state->outside;
+            }
+            ++state->samples;
+            
+            // Start counting down to the next sample.
+            PMU_WRITE_SELR(i);
+            PMU_WRITE_EVCNTR(reload);
+        }
+        else
+        {
+            ++state->overflows[i];
+        }
+    }
+    
+    return true;
+}
+
+//! @brief Handles the shared PMU interrupt.
+//!
+//! The interrupt is the OR of all cores' PMU interrupts. If the overflow was not this core's,
+//! another profiled core must own it.
+static void profile_pmu_isr(void)
+{
+    if (!profile_service_overflow())
+    {
+        uint32_t others = s_runningCpus & ~(1 << cpu_get_current());
+        
+        if (others)
+        {
+            gic_send_sgi(PROFILE_SGI, others, kGicSgiFilter_UseTargetList);
+        }
+    }
+}
+
+//! @brief Handles a PMU interrupt forwarded by another core.
+static void profile_sgi_isr(void)
+{
+    profile_service_overflow();
+}
+
+void profile_init(uint32_t textStart, uint32_t textEnd)
+{
+    if (!textStart && !textEnd)
+    {
+        textStart = (uint32_t)&__text_start;
+        textEnd = (uint32_t)&__text_end;
+    }
+    
+    s_textStart = textStart;
+    s_textEnd = textEnd;
+    
+    // Use the smallest power of two bucket that lets the histogram cover the whole range.
+    s_bucketShift = 2;
+    while (((textEnd - textStart + (1 << s_bucketShift) - 1) >> s_bucketShift) > PROFILE_BUCKET_COUNT)
+    {
+        ++s_bucketShift;
+    }
+    
+    memset(s_profileCpu, 0, sizeof(s_profileCpu));
+    s_runningCpus = 0;
+    s_profiledCpus = 0;
+    
+    register_interrupt_routine(IMX_INT_CHEETAH_PERFORM, profile_pmu_isr);
+    register_interrupt_routine(PROFILE_SGI, profile_sgi_isr);
+}
+
+bool profile_start(const pmu_event_t * events, uint32_t eventCount, pmu_event_t sampleEvent, uint32_t samplePeriod)
+{
+    uint32_t cpu = cpu_get_current();
+    profile_cpu_t * state;
+    uint32_t counterCount = eventCount + (samplePeriod ? 1 : 0);
+    uint32_t counters = ((1 << counterCount) - 1) | PMU_CYCLE_COUNTER_BIT;
+    uint32_t value;
+    uint32_t i;
+    bool wasEnabled;
+    
+    if (cpu >= PROFILE_MAX_CPUS || counterCount > PMU_EVENT_COUNTER_COUNT)
+    {
+        return false;
+    }
+    state = &s_profileCpu[cpu];
+    
+    // Stop and reset all counters before programming them.
+    value = PMU_ALL_COUNTERS;
+    PMU_WRITE_CNTENCLR(value);
+    PMU_WRITE_INTENCLR(value);
+    PMU_WRITE_OVSR(value);
+    value = PMCR_P | PMCR_C;
+    PMU_WRITE_PMCR(value);
+    
+    memset(state, 0, sizeof(*state));
+    state->sampleCounter = samplePeriod ? eventCount : PMU_EVENT_COUNTER_COUNT;
+    state->samplePeriod = samplePeriod;
+    state->counts.eventCount = counterCount;
+    
+    for (i = 0; i < eventCount; ++i)
+    {
+        state->counts.events[i] = events[i];
+        PMU_WRITE_SELR(i);
+        PMU_WRITE_EVTYPER(events[i]);
+    }
+    
+    if (samplePeriod)
+    {
+        value = -samplePeriod;
+        state->counts.events[i] = sampleEvent;
+        PMU_WRITE_SELR(i);
+        PMU_WRITE_EVTYPER(sampleEvent);
+        PMU_WRITE_EVCNTR(value);
+    }
+    
+    // Route the PMU interrupts to this core. The software interrupt is banked per core, so it
+    // has to be enabled here.
+    wasEnabled = profile_route_lock();
+    profile_update_mask(&s_runningCpus, 1 << cpu, true);
+    profile_update_mask(&s_profiledCpus, 1 << cpu, true);
+    enable_interrupt(IMX_INT_CHEETAH_PERFORM, cpu, PROFILE_IRQ_PRIORITY);
+    profile_route_unlock(wasEnabled);
+    enable_interrupt(PROFILE_SGI, cpu, PROFILE_IRQ_PRIORITY);
+    
+    PMU_WRITE_INTENSET(counters);
+    PMU_WRITE_CNTENSET(counters);
+    value = PMCR_E;
+    PMU_WRITE_PMCR(value);
+    
+    return true;
+}
+
+void profile_stop(void)
+{
+    uint32_t cpu = cpu_get_current();
+    profile_cpu_t * state;
+    uint32_t value = 0;
+    uint32_t i;
+    bool wasEnabled;
+    
+    if (cpu >= PROFILE_MAX_CPUS)
+    {
+        return;
+    }
+    state = &s_profileCpu[cpu];
+    
+    PMU_WRITE_PMCR(value);
+    
+    // Take any overflow that happened just before the counters stopped.
+    profile_service_overflow();
+    
+    value = PMU_ALL_COUNTERS;
+    PMU_WRITE_INTENCLR(value);
+    PMU_WRITE_CNTENCLR(value);
+    
+    // Stop routing the PMU interrupt here, and disable it once no core is profiling. Under the
+    // lock, so a core starting meanwhile can't have its enable undone.
+    wasEnabled = profile_route_lock();
+    profile_update_mask(&s_runningCpus, 1 << cpu, false);
+    gic_set_cpu_target(IMX_INT_CHEETAH_PERFORM, cpu, false);
+    if (!s_runningCpus)
+    {
+        gic_enable_irq(IMX_INT_CHEETAH_PERFORM, false);
+    }
+    profile_route_unlock(wasEnabled);
+    
+    PMU_READ_CCNTR(value);
+    state->counts.cycles = ((uint64_t)state->cycleOverflows << 32) | value;
+    
+    for (i = 0; i < state->counts.eventCount; ++i)
+    {
+        PMU_WRITE_SELR(i);
+        PMU_READ_EVCNTR(value);
+        
+        if (i == state->sampleCounter)
+        {
+            // The counter was reloaded with -period after every sample.
+            state->counts.counts[i] = (uint64_t)state->samples * state->samplePeriod + (uint32_t)(value + state->samplePeriod);
+        }
+        else
+        {
+            state->counts.counts[i] = ((uint64_t)state->overflows[i] << 32) | value;
+        }
+    }
+    
+    state->counts.samples = state->samples;
+    state->counts.outside = state->outside;
+}
+
+void profile_get_counts(uint32_t cpu, profile_counts_t * counts)
+{
+    if (cpu < PROFILE_MAX_CPUS && counts)
+    {
+        *counts = s_profileCpu[cpu].counts;
+    }
+}
+
+//! @brief Returns a printable name for an event.
+static const char * profile_event_name(pmu_event_t event)
+{
+    switch (event)
+    {
+        case kPmuEvent_SoftwareIncrement:
+            return "sw-increment";
+        case kPmuEvent_ICacheMiss:
+            return "icache-miss";
+        case kPmuEvent_ITlbMiss:
+            return "itlb-miss";
+        case kPmuEvent_DCacheMiss:
+            return "dcache-miss";
+        case kPmuEvent_DCacheAccess:
+            return "dcache-access";
+        case kPmuEvent_DTlbMiss:
+            return "dtlb-miss";
+        case kPmuEvent_DataRead:
+            return "loads";
+        case kPmuEvent_DataWrite:
+            return "stores";
+        case kPmuEvent_ExceptionTaken:
+            return "exceptions";
+        case kPmuEvent_ExceptionReturn:
+            return "exception-returns";
+        case kPmuEvent_PcWrite:
+            return "pc-writes";
+        case kPmuEvent_BranchImmediate:
+            return "immediate-branches";
+        case kPmuEvent_UnalignedAccess:
+            return "unaligned";
+        case kPmuEvent_BranchMispredict:
+            return "branch-mispredicts";
+        case kPmuEvent_CpuCycles:
+            return "cycles";
+        case kPmuEvent_BranchPredicted:
+            return "predicted-branches";
+        case kPmuEvent_CoherentLinefillMiss:
+            return "coherent-linefill-miss";
+        case kPmuEvent_CoherentLinefillHit:
+            return "coherent-linefill-hit";
+        case kPmuEvent_ICacheStall:
+            return "icache-stall-cycles";
+        case kPmuEvent_DCacheStall:
+            return "dcache-stall-cycles";
+        case kPmuEvent_MainTlbStall:
+            return "tlb-stall-cycles";
+        case kPmuEvent_StrexPassed:
+            return "strex-passed";
+        case kPmuEvent_StrexFailed:
+            return "strex-failed";
+        case kPmuEvent_DataEviction:
+            return "dcache-evictions";
+        case kPmuEvent_IssueStall:
+            return "issue-stall-cycles";
+        case kPmuEvent_IssueEmpty:
+            return "issue-empty-cycles";
+        case kPmuEvent_Instructions:
+            return "instructions";
+        case kPmuEvent_WriteBufferStall:
+            return "write-buffer-stall-cycles";
+        case kPmuEvent_DmbStall:
+            return "dmb-stall-cycles";
+        case kPmuEvent_ExternalInterrupts:
+            return "interrupts";
+    }
+    
+    return "unknown";
+}
+
+void profile_dump(void)
+{
+    uint32_t cpu;
+    uint32_t i;
+    
+    printf("# profile text 0x%08x-0x%08x bucket %d\n", s_textStart, s_textEnd, 1 << s_bucketShift);
+    
+    for (cpu = 0; cpu < PROFILE_MAX_CPUS; ++cpu)
+    {
+        profile_cpu_t * state = &s_profileCpu[cpu];
+        
+        if (!(s_profiledCpus & (1 << cpu)))
+        {
+            continue;
+        }
+        
+        // Counts are printed as two 32-bit words so as not to rely on 64-bit printf support.
+        printf("# cpu %d cycles 0x%08x%08x samples %d outside %d period %d\n", cpu,
+               (uint32_t)(state->counts.cycles >> 32), (uint32_t)state->counts.cycles,
+               state->counts.samples, state->counts.outside, state->samplePeriod);
+        
+        for (i = 0; i < state->counts.eventCount; ++i)
+        {
+            printf("# cpu %d event 0x%02x %s 0x%08x%08x\n", cpu, state->counts.events[i],
+                   profile_event_name(state->counts.events[i]),
+                   (uint32_t)(state->counts.counts[i] >> 32), (uint32_t)state->counts.counts[i]);
+        }
+        
+        for (i = 0; i < PROFILE_BUCKET_COUNT; ++i)
+        {
+            if (state->histogram[i])
+            {
+                printf("0x%08x %d\n", s_textStart + (i << s_bucketShift), state->histogram[i]);
+            }
+        }
+    }
+    
+    printf("# end\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -27,6 +27,38 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+//! @addtogroup diag_profile
+//! @{
+
+/*!
+ * @file profile.h
+ * @brief Cortex-A9 performance monitor counters and sampling profiler.
+ *
+ * The profiler programs the six event counters and the cycle counter of each core's
+ * performance monitor unit (PMU). Counter overflows raise the PMU interrupt, which is used
+ * both to extend all counts to 64 bits and, for one chosen counter, to take a program counter
+ * sample every @a period events. Samples go into a per-core histogram over the text section.
+ *
+ * Typical use:
+ * @code
+ *  static const pmu_event_t events[] = { kPmuEvent_DCacheMiss, kPmuEvent_BranchMispredict };
+ *
+ *  profile_init(0, 0);                    // once, on CPU 0
+ *  profile_start(events, 2, kPmuEvent_CpuCycles, 100000);    // on each core to profile
+ *  run_workload();
+ *  profile_stop();                        // on each profiled core
+ *  profile_dump();
+ * @endcode
+ *
+ * The i.MX6 ORs the PMU interrupts of all cores into the single shared interrupt
+ * IMX_INT_CHEETAH_PERFORM. A core that takes it without an overflow of its own forwards it to
+ * the other profiled cores with the software interrupt #PROFILE_SGI.
+ *
+ * profile_dump() prints the histograms as lines of "address count", which host tools can
+ * symbolize against the application ELF file, for instance with addr2line or
+ * tools/profile_report.py.
+ */
+
 #if !defined(__PROFILE_H__)
 #define __PROFILE_H__
 
@@ -36,9 +68,141 @@
 // Definitions
 ////////////////////////////////////////////////////////////////////////////////
 
+//! @brief Number of event counters in each Cortex-A9 PMU.
+#define PMU_EVENT_COUNTER_COUNT (6)
+
+//! @brief Number of program counter histogram buckets per core.
+#if !defined(PROFILE_BUCKET_COUNT)
+#define PROFILE_BUCKET_COUNT (4096)
+#endif
+
+//! @brief Software interrupt used to forward PMU interrupts between cores.
+#if !defined(PROFILE_SGI)
+#define PROFILE_SGI (SW_INTERRUPT_14)
+#endif
+
+//! @brief GIC priority of the PMU interrupts.
+#if !defined(PROFILE_IRQ_PRIORITY)
+#define PROFILE_IRQ_PRIORITY (0)
+#endif
+
+//! @brief Events the Cortex-A9 PMU can count.
+typedef enum _pmu_event {
+    kPmuEvent_SoftwareIncrement = 0x00,     //!< Writes to the software increment register.
+    kPmuEvent_ICacheMiss = 0x01,            //!< Instruction cache refills.
+    kPmuEvent_ITlbMiss = 0x02,              //!< Instruction micro TLB refills.
+    kPmuEvent_DCacheMiss = 0x03,            //!< Data cache refills.
+    kPmuEvent_DCacheAccess = 0x04,          //!< Data cache accesses.
+    kPmuEvent_DTlbMiss = 0x05,              //!< Data micro TLB refills.
+    kPmuEvent_DataRead = 0x06,              //!< Load instructions executed.
+    kPmuEvent_DataWrite = 0x07,             //!< Store instructions executed.
+    kPmuEvent_ExceptionTaken = 0x09,        //!< Exceptions taken.
+    kPmuEvent_ExceptionReturn = 0x0a,       //!< Exception returns executed.
+    kPmuEvent_PcWrite = 0x0c,               //!< Software changes of the PC.
+    kPmuEvent_BranchImmediate = 0x0d,       //!< Immediate branches executed.
+    kPmuEvent_UnalignedAccess = 0x0f,       //!< Unaligned loads and stores.
+    kPmuEvent_BranchMispredict = 0x10,      //!< Mispredicted or unpredicted branches.
+    kPmuEvent_CpuCycles = 0x11,             //!< Processor cycles.
+    kPmuEvent_BranchPredicted = 0x12,       //!< Predictable branches executed.
+    kPmuEvent_CoherentLinefillMiss = 0x50,  //!< Linefills that missed in the other cores too.
+    kPmuEvent_CoherentLinefillHit = 0x51,   //!< Linefills served by another core's cache.
+    kPmuEvent_ICacheStall = 0x60,           //!< Cycles stalled on instruction cache misses.
+    kPmuEvent_DCacheStall = 0x61,           //!< Cycles stalled on data cache misses.
+    kPmuEvent_MainTlbStall = 0x62,          //!< Cycles stalled on main TLB misses.
+    kPmuEvent_StrexPassed = 0x63,           //!< Successful exclusive stores.
+    kPmuEvent_StrexFailed = 0x64,           //!< Failed exclusive stores.
+    kPmuEvent_DataEviction = 0x65,          //!< Dirty data cache lines evicted.
+    kPmuEvent_IssueStall = 0x66,            //!< Cycles the issue stage dispatched nothing.
+    kPmuEvent_IssueEmpty = 0x67,            //!< Cycles the issue stage was empty.
+    kPmuEvent_Instructions = 0x68,          //!< Instructions out of the rename stage.
+    kPmuEvent_WriteBufferStall = 0x81,      //!< Cycles stalled on a full write buffer.
+    kPmuEvent_DmbStall = 0x86,              //!< Cycles stalled on DMB instructions.
+    kPmuEvent_ExternalInterrupts = 0x93     //!< Interrupts taken.
+} pmu_event_t;
+
+//! @brief Counts collected on one core between profile_start() and profile_stop().
+typedef struct _profile_counts {
+    uint64_t cycles;    //!< Processor cycles.
+    uint32_t eventCount;    //!< Number of valid entries in @a events and @a counts.
+    pmu_event_t events[PMU_EVENT_COUNTER_COUNT];    //!< Counted events, the sampled one last.
+    uint64_t counts[PMU_EVENT_COUNTER_COUNT];   //!< Number of each event.
+    uint32_t samples;   //!< Number of program counter samples taken.
+    uint32_t outside;   //!< Samples that fell outside the histogram range.
+} profile_counts_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @name Cycle counter
+//!
+//! Simple timing of a block of code on the current core. These share the cycle counter with
+//! the profiler and must not be used while it runs.
+//@{
+//! @brief Reset and start the cycle counter, counting every 64 cycles.
 void StartPerfCounter(void);
 
+//! @brief Stop the cycle counter.
+//! @return Cycles elapsed since StartPerfCounter(), in units of 64 cycles.
 uint32_t StopPerfCounter(void);
+//@}
+
+//! @name Profiler
+//@{
+//! @brief Set up the profiler.
+//!
+//! Clears the data of all cores and installs the PMU and #PROFILE_SGI interrupt handlers.
+//! Must be called once, before any core calls profile_start().
+//!
+//! @param textStart First address covered by the program counter histograms. If both
+//!     arguments are 0, the text section of the application is used.
+//! @param textEnd End of the range covered by the histograms, exclusive. The size of each
+//!     histogram bucket is the smallest power of two, at least 4 bytes, for which
+//!     #PROFILE_BUCKET_COUNT buckets cover the range.
+void profile_init(uint32_t textStart, uint32_t textEnd);
+
+//! @brief Start counting and sampling on the current core.
+//!
+//! Clears the counts and histogram of the current core, programs its PMU, and routes the
+//! PMU interrupt to it. Interrupts must be enabled on the core, which secondary cores do with
+//! gic_init_cpu() and arm_set_interrupt_state().
+//!
+//! @param events Events to count, may be NULL if @a eventCount is 0.
+//! @param eventCount Number of events, at most #PMU_EVENT_COUNTER_COUNT, or one less if
+//!     sampling.
+//! @param sampleEvent Event that drives program counter sampling. Counted in the last
+//!     counter used.
+//! @param samplePeriod Number of @a sampleEvent events between samples, or 0 not to sample.
+//! @retval true The core is profiling.
+//! @retval false Too many events were requested.
+bool profile_start(const pmu_event_t * events, uint32_t eventCount, pmu_event_t sampleEvent, uint32_t samplePeriod);
+
+//! @brief Stop counting and sampling on the current core and latch its counts.
+void profile_stop(void);
+
+//! @brief Read the counts latched by profile_stop() for a core.
+//!
+//! @param cpu Index of the core.
+//! @param[out] counts Filled in with the counts.
+void profile_get_counts(uint32_t cpu, profile_counts_t * counts);
+
+//! @brief Print the counts and program counter histograms of all profiled cores.
+//!
+//! For each core a comment line starting with '#' gives the counts, followed by one
+//! "0xaddress count" line for every non-empty histogram bucket. The address is the start of
+//! the bucket.
+void profile_dump(void);
+//@}
+
+#if defined(__cplusplus)
+}
+#endif
+
+//! @}
 
 #endif // __PROFILE_H__
 ////////////////////////////////////////////////////////////////////////////////
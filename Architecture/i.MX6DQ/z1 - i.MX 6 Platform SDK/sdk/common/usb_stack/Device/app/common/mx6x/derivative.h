@@ -1,6 +1,9 @@
 #ifndef _DERIVATIVE_H_
 #define _DERIVATIVE_H_
 
+/* the C library may already define it (as its byte order value) */
+#ifndef LITTLE_ENDIAN
 #define LITTLE_ENDIAN
+#endif
 
 #endif
@@ -72,6 +72,8 @@
 
 #define MSD_RECEIVE_BUFFER_SIZE				(512)
 #define MSD_SEND_BUFFER_SIZE				(512)
+/* number of LBA buffers, see MSC_LBA_BUFF_COUNT */
+#define MSD_BUFFER_COUNT					(2)
 
 /* Don't Change this definition*/
 #define USB_PACKET_SIZE						uint_32 
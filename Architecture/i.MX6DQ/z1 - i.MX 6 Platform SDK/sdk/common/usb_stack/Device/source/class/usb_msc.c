@@ -37,6 +37,7 @@
  *****************************************************************************/
 #include "usb_msc.h"
 #include "usb_descriptor.h"
+#include "utility/work_queue.h"
 /*****************************************************************************
  * Constant and Macro's
  *****************************************************************************/
@@ -47,9 +48,11 @@
  /* Add all the variables needed for usb_msc.c to this structure */
  MSC_GLOBAL_VARIABLE_STRUCT g_msc;
  
-static uint_32 g_current_offset = 0;
 static uint_32 g_transfer_remaining = 0;
 
+/* runs the media accesses of the LBA pipeline outside of the USB interrupt */
+static work_item_t g_msc_media_work;
+
 /*****************************************************************************
  * Local Types - None
  *****************************************************************************/
@@ -70,6 +73,12 @@ uint_8 process_mass_storage_command (uint_8 controller_ID,
 		PTR_CBW cbw_ptr, 
 		uint_32* csw_residue_ptr, 
 		uint_8* csw_status_ptr);                           
+static void msc_lba_pipe_media(uint_8 controller_ID, uint_8 event_type,
+		uint_8_ptr buff_ptr, uint_32 size);
+static void msc_lba_pipe_media_done(void);
+static boolean msc_lba_pipe_access(void);
+static void msc_lba_media_work(void *arg);
+static uint_8 msc_lba_pipe_run(uint_8 controller_ID);
                           
 /*****************************************************************************
  * Local Variables - None
@@ -173,6 +182,240 @@ uint_8 process_mass_storage_command
     return error;
 }
 
+/**************************************************************************//*!
+ *
+ * @name  msc_lba_pipe_media
+ *
+ * @brief Starts the media access of an LBA buffer
+ *        The access runs from deferred work, see utility/work_queue.h, so 
+ *        the application does not read or write the media in the USB 
+ *        interrupt. It runs right away if the work queue of the core is 
+ *        not enabled.
+ *
+ * @param controller_ID:  To identify the controller 
+ * @param event_type   :  USB_MSC_DEVICE_READ_REQUEST or 
+ *                        USB_MSC_DEVICE_WRITE_REQUEST
+ * @param buff_ptr     :  buffer at media_index
+ * @param size         :  bytes to read or write
+ *
+ * @return None
+ *
+ *****************************************************************************/
+static void msc_lba_pipe_media
+(
+	uint_8 controller_ID,
+	uint_8 event_type,
+	uint_8_ptr buff_ptr,
+	uint_32 size
+)
+{
+    PTR_MSC_LBA_PIPE_STRUCT pipe = &g_msc.lba_pipe;
+
+    pipe->controller_ID = controller_ID;
+    pipe->media_event = event_type;
+    pipe->media_pending = FALSE;
+    pipe->media.offset = pipe->offset;
+    pipe->media.size = size;
+    pipe->media.buff_ptr = buff_ptr;
+    pipe->media.pending = FALSE;
+
+    pipe->size[pipe->media_index] = size;
+    pipe->offset += size;
+    pipe->media_busy = TRUE;
+    if(event_type == USB_MSC_DEVICE_READ_REQUEST)
+    {
+        pipe->remaining -= size;
+    }
+    else
+    {
+        pipe->ready--;
+    }
+
+    if(!work_queue(&g_msc_media_work))
+    {
+        (void)msc_lba_pipe_access();
+    }
+}
+
+/**************************************************************************//*!
+ *
+ * @name  msc_lba_pipe_access
+ *
+ * @brief Hands the media access to the application
+ *        The application reads or writes the buffer in its callback, or 
+ *        sets pending and calls USB_MSC_LBA_Complete() when it is done
+ *
+ * @return TRUE when the access is done, FALSE when it is pending
+ *
+ *****************************************************************************/
+static boolean msc_lba_pipe_access(void)
+{
+    PTR_MSC_LBA_PIPE_STRUCT pipe = &g_msc.lba_pipe;
+
+    g_msc.param_callback(pipe->controller_ID, pipe->media_event, 
+        (void*)&pipe->media);
+
+    if(pipe->media.pending)
+    {
+        pipe->media_pending = TRUE;
+        return FALSE;
+    }
+    msc_lba_pipe_media_done();
+    return TRUE;
+}
+
+/**************************************************************************//*!
+ *
+ * @name  msc_lba_media_work
+ *
+ * @brief Work item of the LBA pipeline
+ *        Runs the media access started by msc_lba_pipe_media(), or finishes 
+ *        the one completed by USB_MSC_LBA_Complete(), and moves the 
+ *        pipeline on
+ *
+ * @param arg          :  Unused
+ *
+ * @return None
+ *
+ *****************************************************************************/
+static void msc_lba_media_work(void *arg)
+{
+    PTR_MSC_LBA_PIPE_STRUCT pipe = &g_msc.lba_pipe;
+
+    UNUSED(arg)
+
+    if((!pipe->active) || (!pipe->media_busy))
+    {   /* the data phase was cancelled */
+        return;
+    }
+
+    if(pipe->media_pending)
+    {   /* the application completed the access */
+        pipe->media_pending = FALSE;
+        msc_lba_pipe_media_done();
+    }
+    else if(!msc_lba_pipe_access())
+    {
+        return;
+    }
+
+    (void)msc_lba_pipe_run(pipe->controller_ID);
+}
+
+/**************************************************************************//*!
+ *
+ * @name  msc_lba_pipe_media_done
+ *
+ * @brief Passes the buffer at media_index on, to the bus for reads or 
+ *        back to the free buffers for writes
+ *
+ * @return None
+ *
+ *****************************************************************************/
+static void msc_lba_pipe_media_done(void)
+{
+    PTR_MSC_LBA_PIPE_STRUCT pipe = &g_msc.lba_pipe;
+
+    pipe->media_busy = FALSE;
+    pipe->media_index = (uint_8)((pipe->media_index + 1) % MSC_LBA_BUFF_COUNT);
+    if(pipe->direction == USB_SEND)
+    {
+        pipe->ready++;
+    }
+}
+
+/**************************************************************************//*!
+ *
+ * @name  msc_lba_pipe_run
+ *
+ * @brief Moves the LBA data pipeline on as far as the buffers allow
+ *        One media access is in progress at a time. It is started as soon 
+ *        as a buffer is available, so it overlaps the transfers of the other 
+ *        buffers on the bus. The transfers are queued on the controller 
+ *        directly rather than through the class queue, which only starts 
+ *        a transfer after the previous one completed.
+ *
+ * @param controller_ID:  To identify the controller 
+ *
+ * @return error of the first transfer that could not be queued
+ *
+ *****************************************************************************/
+static uint_8 msc_lba_pipe_run(uint_8 controller_ID)
+{
+    PTR_MSC_LBA_PIPE_STRUCT pipe = &g_msc.lba_pipe;
+    uint_8 error = USB_OK;
+
+    while((pipe->active) && (error == USB_OK))
+    {
+        /* buffers holding data or queued on the bus */
+        uint_8 used = (uint_8)(pipe->ready + pipe->on_bus + (pipe->media_busy ? 1 : 0));
+
+        if(pipe->direction == USB_SEND)
+        {
+            if(pipe->ready)
+            {   /* send the oldest buffer read from the media */
+                error = USB_Class_Send_Data(controller_ID, BULK_IN_ENDPOINT,
+                    g_msc.msc_lba_send_buff[pipe->bus_index], pipe->size[pipe->bus_index]);
+                pipe->bus_index = (uint_8)((pipe->bus_index + 1) % MSC_LBA_BUFF_COUNT);
+                pipe->ready--;
+                pipe->on_bus++;
+            }
+            else if((!pipe->media_busy) && (pipe->remaining) && (used < MSC_LBA_BUFF_COUNT))
+            {   /* read the next chunk into a free buffer */
+                msc_lba_pipe_media(controller_ID, USB_MSC_DEVICE_READ_REQUEST,
+                    g_msc.msc_lba_send_buff[pipe->media_index],
+                    (pipe->remaining > MSC_SEND_DATA_BUFF_SIZE) ? 
+                    MSC_SEND_DATA_BUFF_SIZE : pipe->remaining); /* whichever is smaller */
+            }
+            else
+            {
+                if((!pipe->remaining) && (!pipe->media_busy) && (pipe->tail_pending))
+                {   /* all the data is queued, the held back send follows it */
+                    pipe->tail_pending = FALSE;
+                    error = USB_Class_MSC_Send_Data(controller_ID, BULK_IN_ENDPOINT,
+                        pipe->tail.data_ptr, pipe->tail.data_size);
+                }
+                break;
+            }
+        }
+        else
+        {
+            if((pipe->remaining) && (used < MSC_LBA_BUFF_COUNT))
+            {   /* receive the next chunk into a free buffer */
+                uint_32 size = (pipe->remaining > MSC_RECV_DATA_BUFF_SIZE) ? 
+                    MSC_RECV_DATA_BUFF_SIZE : pipe->remaining; /* whichever is smaller */
+                error = USB_MSC_Bulk_Recv_Data(&controller_ID,
+                    g_msc.msc_lba_recv_buff[pipe->bus_index], size);
+                pipe->bus_index = (uint_8)((pipe->bus_index + 1) % MSC_LBA_BUFF_COUNT);
+                pipe->remaining -= size;
+                pipe->on_bus++;
+            }
+            else if((!pipe->media_busy) && (pipe->ready))
+            {   /* write the oldest buffer received to the media */
+                msc_lba_pipe_media(controller_ID, USB_MSC_DEVICE_WRITE_REQUEST,
+                    g_msc.msc_lba_recv_buff[pipe->media_index], 
+                    pipe->size[pipe->media_index]);
+            }
+            else
+            {
+                if((!g_transfer_remaining) && (!used))
+                {   /* marks the end of data phase, once all of it is on the media */
+                    pipe->active = FALSE;
+                    if(g_msc.out_flag)
+                    {
+                        g_msc.out_flag = FALSE; /* clear the flag for next CBW */
+                        /* Send the command status information */
+                        error = USB_MSC_Bulk_Send_Data(controller_ID, 
+                            (uint_8_ptr)&(g_msc.csw_struct), MSC_CSW_LENGTH);
+                    }
+                }
+                break;
+            }
+        }
+    }
+    return error;
+}
+
 /**************************************************************************//*!
  *
  * @name  USB_Service_Bulk_In
@@ -186,7 +429,9 @@ uint_8 process_mass_storage_command
  *****************************************************************************/
 void USB_Service_Bulk_In(PTR_USB_DEV_EVENT_STRUCT event)
 {
-    uint_8 event_type; 
+    /* LBA data is queued past the class queue, see msc_lba_pipe_run() */
+    boolean lba_data = (boolean)((g_msc.lba_pipe.active) && 
+        (g_msc.lba_pipe.direction == USB_SEND) && (g_msc.lba_pipe.on_bus));
     
 	#if IMPLEMENT_QUEUING    
 	    uint_8 index;
@@ -194,33 +439,49 @@ void USB_Service_Bulk_In(PTR_USB_DEV_EVENT_STRUCT event)
 	    USB_ENDPOINTS *usb_ep_data = USB_Desc_Get_Endpoints(event->controller_ID); 
 	    
 	    USB_CLASS_MSC_QUEUE queue;
-	    /* map the endpoint num to the index of the endpoint structure */
-	    for(index = 0; index < usb_ep_data->count; index++) 
+	#endif
+	
+    if(lba_data)
+    {
+        g_msc.lba_pipe.on_bus--;
+    }
+	
+	#if IMPLEMENT_QUEUING    
+	    if(!lba_data)
 	    {
-	        if(usb_ep_data->ep[index].ep_num == event->ep_num)
-	        break;
+	        /* map the endpoint num to the index of the endpoint structure */
+	        for(index = 0; index < usb_ep_data->count; index++) 
+	        {
+	            if(usb_ep_data->ep[index].ep_num == event->ep_num)
+	            break;
+	        }
+	                                                   
+	        producer = g_msc.ep[index].bin_producer;	        
+	        /* if there are no errors de-queue the queue and decrement the no. of 
+	           transfers left, else send the same data again */
+	        g_msc.ep[index].bin_consumer++;  	        
+	        consumer = g_msc.ep[index].bin_consumer;	        
+	        
+	        if(consumer != producer) 
+	        {/*if bin is not empty */
+	                            
+	            queue = g_msc.ep[index].queue[consumer%MAX_QUEUE_ELEMS];	                        
+	            (void)USB_Class_Send_Data(queue.controller_ID, queue.channel, 
+	            	queue.app_data.data_ptr, queue.app_data.data_size);
+	    		return;                           
+	        }          
 	    }
-	                                               
-	    producer = g_msc.ep[index].bin_producer;	        
-	    /* if there are no errors de-queue the queue and decrement the no. of 
-	       transfers left, else send the same data again */
-	    g_msc.ep[index].bin_consumer++;  	        
-	    consumer = g_msc.ep[index].bin_consumer;	        
-	    
-	    if(consumer != producer) 
-	    {/*if bin is not empty */
-	                        
-	        queue = g_msc.ep[index].queue[consumer%MAX_QUEUE_ELEMS];	                        
-	        (void)USB_Class_Send_Data(queue.controller_ID, queue.channel, 
-	        	queue.app_data.data_ptr, queue.app_data.data_size);
-			return;                           
-	    }          
 	#endif
      
     if(g_transfer_remaining >= event->len)
     {	/* decrement the global count */
 		g_transfer_remaining -= event->len;        	
 	 }
+    
+    if(lba_data && (!g_transfer_remaining))
+    {   /* all the LBA data was sent */
+        g_msc.lba_pipe.active = FALSE;
+    }
         
     /* check if there is need to stall BULK IN ENDPOINT And
        there isn't any transfer in progress*/
@@ -244,34 +505,17 @@ void USB_Service_Bulk_In(PTR_USB_DEV_EVENT_STRUCT event)
    
     if(g_msc.in_flag) /* bulk in transaction has occurred before CSW */
     {                           
-        if(g_msc.param_callback != NULL) 
+        if(g_transfer_remaining)
+        {   /* the buffer is free for the next chunk of LBA data */
+            (void)msc_lba_pipe_run(event->controller_ID);
+        }
+        else if(g_msc.param_callback != NULL) 
         {
- 			    event_type = (uint_8)(g_transfer_remaining?
- 				    USB_MSC_DEVICE_READ_REQUEST : USB_APP_SEND_COMPLETE);
-       		
- 			    if(event_type == USB_APP_SEND_COMPLETE)
- 			    {       
-            		APP_DATA_STRUCT bulk_in_recv;
-            		bulk_in_recv.data_ptr = event->buffer_ptr;
-            		bulk_in_recv.data_size = event->len; 
-                	g_msc.param_callback(event->controller_ID, event_type,
-                		(void*)&bulk_in_recv);
-            	}
-            	else
-            	{
-				      LBA_APP_STRUCT lba_data;		
-				      g_current_offset += event->len;
-				      lba_data.offset = g_current_offset;
-			      	lba_data.size = (g_transfer_remaining > MSC_SEND_DATA_BUFF_SIZE) ? 
-				          	MSC_SEND_DATA_BUFF_SIZE : g_transfer_remaining; 
-				     /* whichever is smaller */
-				     lba_data.buff_ptr = g_msc.msc_lba_send_buff;
-
-	  			   g_msc.param_callback(event->controller_ID, USB_MSC_DEVICE_READ_REQUEST,
-	  				          (void*)&lba_data);
-    			   (void)USB_MSC_Bulk_Send_Data(event->controller_ID, lba_data.buff_ptr, 
-    				         lba_data.size);	
-        	    }
+        	APP_DATA_STRUCT bulk_in_recv;
+        	bulk_in_recv.data_ptr = event->buffer_ptr;
+        	bulk_in_recv.data_size = event->len; 
+        	g_msc.param_callback(event->controller_ID, USB_APP_SEND_COMPLETE,
+        		(void*)&bulk_in_recv);
         }        
         
         if(!g_transfer_remaining)
@@ -306,7 +550,6 @@ void USB_Service_Bulk_In(PTR_USB_DEV_EVENT_STRUCT event)
  *****************************************************************************/
 void USB_Service_Bulk_Out(PTR_USB_DEV_EVENT_STRUCT event)
 {       
-    uint_8 event_type; 
     uint_8 error;
     
     /* check if there is need to stall BULK OUT ENDPOINT And 
@@ -324,6 +567,39 @@ void USB_Service_Bulk_Out(PTR_USB_DEV_EVENT_STRUCT event)
 		return;					
     }
     
+    if((g_msc.lba_pipe.active) && (g_msc.lba_pipe.direction == USB_RECV) && 
+        (g_msc.lba_pipe.on_bus))
+    {   /* a chunk of LBA data was received, it goes to the media next */
+        PTR_MSC_LBA_PIPE_STRUCT pipe = &g_msc.lba_pipe;
+        uint_8 index = (uint_8)((pipe->bus_index + MSC_LBA_BUFF_COUNT - pipe->on_bus) % 
+            MSC_LBA_BUFF_COUNT);
+        
+        pipe->size[index] = event->len;
+        pipe->on_bus--;
+        pipe->ready++;
+        
+        if(g_transfer_remaining >= event->len)
+        {	/* decrement the global count */
+			g_transfer_remaining -= event->len;
+        }
+        
+		if((g_msc.out_stall_flag == TRUE)&&(!g_transfer_remaining))
+        {
+   	        uint_8 component = (uint_8)(event->ep_num | 
+    	        (event->direction<<COMPONENT_PREPARE_SHIFT));
+           	g_msc.out_stall_flag = FALSE; /* clear the flag */
+           	g_msc.out_flag = FALSE; /* clear send flag */
+           	/* now, stalling the status phase - CASE 5th of THIRTEEN CASES*/           
+    		(void)_usb_device_set_status(&(event->controller_ID),
+    			    (uint_8)(component|USB_STATUS_ENDPOINT),
+    			    (uint_16)USB_STATUS_STALLED);
+        }
+        
+        /* the CSW is sent once the data is written to the media */
+        (void)msc_lba_pipe_run(event->controller_ID);
+        return;
+    }
+    
     /* If its not a data phase on bulk endpoint */
     if ((!g_msc.out_flag) && (event->len == MSC_CBW_LENGTH) && 
         (event->buffer_ptr != (uint_8_ptr)&(g_msc.cbw_struct)) )
@@ -337,63 +613,18 @@ void USB_Service_Bulk_Out(PTR_USB_DEV_EVENT_STRUCT event)
     {        
         if(g_msc.param_callback != NULL) 
         {
- 		    	event_type = (uint_8)(g_transfer_remaining?
- 				    USB_MSC_DEVICE_WRITE_REQUEST : USB_APP_DATA_RECEIVED);
- 			
-			    if(event_type == USB_APP_DATA_RECEIVED)
- 		    	{
-    				APP_DATA_STRUCT bulk_out_recv;				    
-    		        bulk_out_recv.data_ptr = event->buffer_ptr;
-    		        bulk_out_recv.data_size = event->len; 
-     				g_msc.param_callback(event->controller_ID, event_type,(void*)&bulk_out_recv);	
- 			    }
- 			    else
- 			    {
-     				LBA_APP_STRUCT lba_data1;
-     				lba_data1.buff_ptr = g_msc.msc_lba_recv_buff;
-     				lba_data1.offset = g_current_offset;
-     				lba_data1.size = event->len; 				    			
-     				g_msc.param_callback(event->controller_ID, event_type,(void*)&lba_data1);            
-     			}            
+			APP_DATA_STRUCT bulk_out_recv;				    
+	        bulk_out_recv.data_ptr = event->buffer_ptr;
+	        bulk_out_recv.data_size = event->len; 
+			g_msc.param_callback(event->controller_ID, USB_APP_DATA_RECEIVED,
+				(void*)&bulk_out_recv);	
         }
         
-        if(g_transfer_remaining >= event->len)
-        {	/* decrement the global count */
-			      g_transfer_remaining -= event->len;
-			      			      
-			if((g_msc.out_stall_flag == TRUE)&&(!g_transfer_remaining))
-            {
-       	        uint_8 component = (uint_8)(event->ep_num | 
-        	        (event->direction<<COMPONENT_PREPARE_SHIFT));
-               	g_msc.out_stall_flag = FALSE; /* clear the flag */
-               	g_msc.out_flag = FALSE; /* clear send flag */
-               	/* now, stalling the status phase - CASE 5th of THIRTEEN CASES*/           
-        		(void)_usb_device_set_status(&(event->controller_ID),
-        			    (uint_8)(component|USB_STATUS_ENDPOINT),
-        			    (uint_16)USB_STATUS_STALLED);
-        		return;					
-            }
-        }
-        
-        if(g_transfer_remaining)
-        {	/* Transfers Remaining -- Again invoke recv_data */   			
-	        LBA_APP_STRUCT lba_data0;	        
-	        g_current_offset += event->len;
-	        lba_data0.size = (g_transfer_remaining > MSC_RECV_DATA_BUFF_SIZE) ? 
-	            MSC_RECV_DATA_BUFF_SIZE : g_transfer_remaining; /* whichever is smaller */
-	        lba_data0.buff_ptr = g_msc.msc_lba_recv_buff;    	    	
-    	    (void)USB_MSC_Bulk_Recv_Data(&(event->controller_ID),
-    	    	lba_data0.buff_ptr,lba_data0.size);
-        	return;
-        	
-        }
-        else
-        {	/* marks the end of data phase */
-   	        g_msc.out_flag = FALSE; /* clear the flag for next CBW */
-        	/* Send the command status information */
-        	(void)USB_MSC_Bulk_Send_Data(event->controller_ID, 
-        		(uint_8_ptr)&(g_msc.csw_struct), MSC_CSW_LENGTH);         	
-        }
+    	/* marks the end of data phase */
+        g_msc.out_flag = FALSE; /* clear the flag for next CBW */
+    	/* Send the command status information */
+    	(void)USB_MSC_Bulk_Send_Data(event->controller_ID, 
+    		(uint_8_ptr)&(g_msc.csw_struct), MSC_CSW_LENGTH);         	
     } 
     else if(/* check for valid and meaningful CBW */
         /* CBW received after device had sent a CSW or after a reset */
@@ -573,6 +804,7 @@ void USB_Service_Bulk_Out(PTR_USB_DEV_EVENT_STRUCT event)
     	g_msc.out_stall_flag = FALSE;
     	g_msc.in_stall_flag = FALSE;
     	g_msc.cbw_valid_flag = TRUE; /*making the first CBW valid */ 
+    	g_msc.lba_pipe.active = FALSE;
     	g_transfer_remaining = 0; 
     }
     else if(event == USB_APP_BUS_RESET)
@@ -715,6 +947,7 @@ uint_8 USB_MSC_Other_Requests
                     g_msc.in_stall_flag = FALSE;
   					g_msc.cbw_valid_flag = TRUE; /*making the first CBW valid */               
   					g_msc.re_stall_flag = FALSE;
+  					g_msc.lba_pipe.active = FALSE;
   					g_transfer_remaining = 0; 
           	    }
           	    else 
@@ -817,6 +1050,7 @@ uint_8 USB_Class_MSC_Init
     
     /* initialize the Global Variable Structure */
 	USB_memzero(&g_msc, sizeof(MSC_GLOBAL_VARIABLE_STRUCT));
+	work_item_init(&g_msc_media_work, msc_lba_media_work, NULL);
 
 #ifndef COMPOSITE_DEV		
     /* Initialize the device layer*/
@@ -939,13 +1173,26 @@ uint_8 USB_Class_MSC_Send_Data
 ) 
 {
     uint_8 error = USB_OK;
+    PTR_MSC_LBA_PIPE_STRUCT pipe = &g_msc.lba_pipe;
 
 	#if IMPLEMENT_QUEUING    
 	    uint_8 index;
 	    uint_8 producer, consumer;       
 	    
 	    USB_ENDPOINTS *usb_ep_data = USB_Desc_Get_Endpoints(controller_ID); 
-	  
+	#endif
+	
+    if((pipe->active) && (pipe->direction == USB_SEND) && 
+        ((pipe->remaining) || (pipe->media_busy) || (pipe->ready)))
+    {   /* a send behind LBA data, like the zero length packet of CASE 5, 
+           is held back until the last chunk is queued, see msc_lba_pipe_run() */
+        pipe->tail.data_ptr = app_buff;
+        pipe->tail.data_size = size;
+        pipe->tail_pending = TRUE;
+        return USB_OK;
+    }
+
+	#if IMPLEMENT_QUEUING    
 	    /* map the endpoint num to the index of the endpoint structure */
 	    for(index = 0; index < usb_ep_data->count; index++) 
 	    {
@@ -1006,8 +1253,7 @@ uint_8 USB_MSC_LBA_Transfer
 	PTR_LBA_INFO_STRUCT lba_info_ptr
 )
 {
-	uint_8 error;
-	LBA_APP_STRUCT lba_data;	
+	PTR_MSC_LBA_PIPE_STRUCT pipe = &g_msc.lba_pipe;
 	
 	if((!((lba_info_ptr->starting_lba<g_msc.device_info.total_lba_device_supports)&&
     	(lba_info_ptr->lba_transfer_num <= (g_msc.device_info.total_lba_device_supports - 
@@ -1020,30 +1266,49 @@ uint_8 USB_MSC_LBA_Transfer
 
 	g_transfer_remaining = lba_info_ptr->lba_transfer_num * 
 	  g_msc.device_info.length_of_each_lba_of_device;				
-	g_current_offset = lba_info_ptr->starting_lba * 
+
+	USB_memzero(pipe, sizeof(MSC_LBA_PIPE_STRUCT));
+	pipe->direction = direction;
+	pipe->offset = lba_info_ptr->starting_lba * 
 	  g_msc.device_info.length_of_each_lba_of_device;
-	
-	lba_data.offset = g_current_offset;
+	pipe->remaining = g_transfer_remaining;
+	pipe->active = (boolean)(g_transfer_remaining != 0);
 
-	if(direction == USB_SEND)
-    {
-  		lba_data.size = (g_transfer_remaining > MSC_SEND_DATA_BUFF_SIZE) ? 
-			MSC_SEND_DATA_BUFF_SIZE : g_transfer_remaining; /* whichever is smaller */
-		lba_data.buff_ptr = g_msc.msc_lba_send_buff;
-	  	
-	  	g_msc.param_callback(controller_ID, USB_MSC_DEVICE_READ_REQUEST,
-	  		(void*)&lba_data);
+	/* fill the buffers from the media for reads, or queue them all for 
+	   receive for writes */
+    return msc_lba_pipe_run(controller_ID);
+}
 
-    	error = USB_MSC_Bulk_Send_Data(controller_ID,lba_data.buff_ptr,lba_data.size);
-    }
-    else
-    {
-  		lba_data.size = (g_transfer_remaining > MSC_RECV_DATA_BUFF_SIZE) ? 
-			MSC_RECV_DATA_BUFF_SIZE : g_transfer_remaining; /* whichever is smaller */
-		lba_data.buff_ptr = g_msc.msc_lba_recv_buff;
-	    error = USB_MSC_Bulk_Recv_Data(&controller_ID,lba_data.buff_ptr,lba_data.size);	
-    }	    		
-    return error;
+/**************************************************************************//*!
+ *
+ * @name  USB_MSC_LBA_Complete
+ *
+ * @brief Completes a media access the application left pending
+ *        The application sets pending in the LBA_APP_STRUCT of a 
+ *        USB_MSC_DEVICE_READ_REQUEST or USB_MSC_DEVICE_WRITE_REQUEST to 
+ *        start the access in the background, and calls this when it is done, 
+ *        on the core that services the USB interrupt. The pipeline moves on 
+ *        from deferred work. Without a work queue it has to be called with 
+ *        the USB interrupt masked, from an interrupt handler for example.
+ *
+ * @param controller_ID:     To identify the controller   
+ *
+ * @return None
+ *****************************************************************************/
+void USB_MSC_LBA_Complete
+(
+	uint_8 controller_ID
+)
+{
+	UNUSED(controller_ID)
+
+	if((g_msc.lba_pipe.active) && (g_msc.lba_pipe.media_busy))
+	{
+		if(!work_queue(&g_msc_media_work))
+		{
+			msc_lba_media_work(NULL);
+		}
+	}
 }
 
 /* EOF */
@@ -87,12 +87,26 @@
 #define  MSC_RECV_DATA_BUFF_SIZE		 (MSD_RECEIVE_BUFFER_SIZE)
 #define  MSC_SEND_DATA_BUFF_SIZE		 (MSD_SEND_BUFFER_SIZE)
 
+/* Number of LBA data buffers of each direction. While the media reads or 
+   writes one buffer, the others are transferred on the bus */
+#ifdef MSD_BUFFER_COUNT
+#define  MSC_LBA_BUFF_COUNT			 (MSD_BUFFER_COUNT)
+#else
+#define  MSC_LBA_BUFF_COUNT			 (2)
+#endif
+
 #define COMMAND_PASSED                (0x00)
 #define COMMAND_FAILED                (0x01)
 #define PHASE_ERROR                   (0x02)
 /* macros for queuing */
  #define MAX_QUEUE_ELEMS  (4)
 
+/* the LBA data buffers and a zero length packet behind them have to fit 
+   the transfers the controller queues on an endpoint */
+#if (MSC_LBA_BUFF_COUNT < 1) || (MSC_LBA_BUFF_COUNT > MAX_QUEUE_ELEMS)
+#error "MSD_BUFFER_COUNT must be from 1 to MAX_QUEUE_ELEMS"
+#endif
+
 /* MACROS FOR COMMANDS SUPPORTED */
  #define INQUIRY_COMMAND                    (0x12)
  #define READ_10_COMMAND                    (0x28)
@@ -174,8 +188,34 @@ typedef struct _lba_app_struct
 	uint_32 offset;
 	uint_32 size;
 	uint_8_ptr buff_ptr;
+	/* set by the application to finish the media access later and call 
+	   USB_MSC_LBA_Complete() then, left FALSE when done on return */
+	boolean pending;
 }LBA_APP_STRUCT, * PTR_LBA_APP_STRUCT;
 
+/* Pipeline of the LBA data buffers. Buffers are used round robin, for reads 
+   they are filled by the media and then sent, for writes received and then 
+   written to the media */
+typedef struct _msc_lba_pipe_struct
+{
+	boolean active;         /* an LBA data phase is in progress */
+	boolean direction;      /* USB_SEND for reads, USB_RECV for writes */
+	boolean media_busy;     /* the media is accessing the buffer at media_index */
+	uint_8 media_index;     /* buffer of the next media access */
+	uint_8 bus_index;       /* buffer of the next transfer on the bus */
+	uint_8 ready;           /* buffers done with the first stage, waiting for the second */
+	uint_8 on_bus;          /* buffers queued on the bus */
+	uint_32 offset;         /* media offset of the next media access */
+	uint_32 remaining;      /* bytes not yet read from the media or queued for receive */
+	uint_32 size[MSC_LBA_BUFF_COUNT];   /* bytes held by each buffer */
+	boolean tail_pending;   /* a send is held back behind the LBA data */
+	APP_DATA_STRUCT tail;   /* the send held back */
+	uint_8 controller_ID;   /* controller of the data phase */
+	uint_8 media_event;     /* USB_MSC_DEVICE_READ_REQUEST or USB_MSC_DEVICE_WRITE_REQUEST */
+	boolean media_pending;  /* the application finishes the media access later */
+	LBA_APP_STRUCT media;   /* the media access handed to the application */
+}MSC_LBA_PIPE_STRUCT, * PTR_MSC_LBA_PIPE_STRUCT;
+
 typedef struct _device_lba_info_struct
 {
  	uint_32 total_lba_device_supports;/* lba : LOGICAL BLOCK ADDRESS */ 
@@ -202,8 +242,9 @@ typedef struct _msc_variable_struct
  	USB_CLASS_CALLBACK msc_callback;
  	USB_REQ_FUNC       vendor_callback;            
  	USB_CLASS_CALLBACK param_callback; 
- 	uint_8 msc_lba_send_buff[MSC_SEND_DATA_BUFF_SIZE];
- 	uint_8 msc_lba_recv_buff[MSC_RECV_DATA_BUFF_SIZE];
+ 	uint_8 msc_lba_send_buff[MSC_LBA_BUFF_COUNT][MSC_SEND_DATA_BUFF_SIZE];
+ 	uint_8 msc_lba_recv_buff[MSC_LBA_BUFF_COUNT][MSC_RECV_DATA_BUFF_SIZE];
+ 	MSC_LBA_PIPE_STRUCT lba_pipe;
  	 /* contains the endpoint info */
 #ifndef COMPOSITE_DEV
  	USB_CLASS_MSC_ENDPOINT ep[MSC_DESC_ENDPOINT_COUNT];
@@ -280,6 +321,11 @@ extern uint_8 USB_MSC_LBA_Transfer
 	PTR_LBA_INFO_STRUCT lba_info_ptr
 );
 
+extern void USB_MSC_LBA_Complete
+(
+	uint_8 controller_ID
+);
+
 extern uint_8 USB_Class_MSC_Send_Data
 (
     uint_8              controller_ID,
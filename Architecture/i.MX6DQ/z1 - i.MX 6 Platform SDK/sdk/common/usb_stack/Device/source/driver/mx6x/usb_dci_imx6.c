@@ -3,6 +3,7 @@
  *****************************************************************************/
 #include "sdk_types.h"
 #include "core/interrupt.h"
+#include "core/cortex_a9.h"
 #include <string.h>
 #include "usb_dciapi.h" /* USB DCI API Header File */
 #include "usb_devapi.h" /* USB Device API Header File */
@@ -15,6 +16,8 @@
 #include "registers/regsccm.h"
 #include "registers/regsccmanalog.h"
 #include "buffers.h"
+#include "utility/atomics.h"
+#include "utility/work_queue.h"
 
 /*****************************************************************************
  * Forward function declarations
@@ -35,6 +38,7 @@ static unsigned int usbd_get_dqh(uint_8 controller_ID, unsigned char endpt_numbe
 static unsigned int usbd_get_dtd(uint_8 controller_ID, unsigned char endpt_number, unsigned char direction, unsigned int sz);
 
 static void usb0_isr(void);// *data);
+static void usb0_service(void *arg);
 // static void usb1_isr(void *data);
 
 static void USB_Bus_Reset_Handler(uint_8 controller_ID);
@@ -42,6 +46,8 @@ static void usbd_setup_packet_handler(USB_DEV_EVENT_STRUCT* event);
 static void usbd_ep_complete_handler(USB_DEV_EVENT_STRUCT* event);
 static void usbd_ep0_complete(USB_DEV_EVENT_STRUCT* event);
 static void usbd_dtd_complete(USB_DEV_EVENT_STRUCT* event);
+static void usbd_cancel_chain(uint_8 controller_ID, unsigned char ep_num, unsigned char direction);
+static void usbd_prime_ep(uint_8 controller_ID, unsigned char ep_num, unsigned char direction, unsigned int dtd_address);
 static void usbd_read_setup_packet(uint_8 controller_ID, unsigned char *setup_packet);
 static usb_status_t usbd_send_data_ep0in(uint_8 controller_ID,
                                          unsigned int ep0_data_buffer, unsigned int sz,
@@ -50,6 +56,7 @@ static usb_status_t usbd_receive_data_ep0out(uint_8 controller_ID, unsigned int
 static usb_status_t usbd_send_data_epxin(uint_8 controller_ID, unsigned int epx_data_buffer, uint_8 ep_num, unsigned int sz);
 static usb_status_t usbd_receive_data_epxout(uint_8 controller_ID, unsigned int epx_data_buffer, uint_8 ep_num, unsigned int sz);
 static void usbd_setup_td(struct dtd_t *td);
+static usb_status_t usbd_queue_epx(uint_8 controller_ID, unsigned int data_buffer, uint_8 ep_num, unsigned char direction, unsigned int sz);
 
 static inline void writel(unsigned int val, volatile unsigned int *addr);
 static inline unsigned int readl(volatile unsigned int * addr);
@@ -75,7 +82,8 @@ static inline unsigned int readl(volatile unsigned int * addr);
     #define printf_error(fmt, ...) 
 #endif
 
-#define MAX_DTDS_PER_EP     5
+// dTDs of all endpoints have to fit between TD_BUFFER and the next OCRAM buffer
+#define MAX_DTDS_PER_EP     12
 #define DTD_FREE            0
 #define DTD_BUSY            1
 #define MAX_ENDPOINT_NUMBER 4
@@ -85,6 +93,12 @@ static inline unsigned int readl(volatile unsigned int * addr);
 // TD structures are 64-byte aligned
 #define TOTAL_QTD_SIZE ((SIZE_OF_DTD0) * (MAX_ENDPOINT_NUMBER * 2) * MAX_DTDS_PER_EP)
 
+// A dTD points at five 4KB pages. Transfers larger than that are split into a chain
+// of dTDs, 20KB each from a page aligned buffer and 16KB each otherwise, so that every
+// dTD but the last covers a whole number of max packets.
+#define DTD_PAGE_SIZE       0x1000
+#define DTD_SPAN(addr)      (((addr) & (DTD_PAGE_SIZE - 1)) ? 4 * DTD_PAGE_SIZE : 5 * DTD_PAGE_SIZE)
+
 #define NO_ERRORS                       (0)   /* Init value for error */
 
 /* control endpoint transfer types */
@@ -133,18 +147,28 @@ static uint_8 g_dci_controller_Id[MAX_USB_STACKS] = {0};
 static struct _td_status
 {
     uint_8  status;                  // DTD_BUSY or DTD_FREE
+    uint_8  last;                    // Last dTD of a transfer (not used by EP0)
     unsigned int total_bytes;       // Original total bytes to transfer (not used by EP0)
     volatile struct dtd_setup_t *phys_td;   // Pointer to physical TD (not used by EP0)
 } g_usbd_td_flag[MAX_USB_STACKS][MAX_ENDPOINT_NUMBER * 2][MAX_DTDS_PER_EP];
 
-// Queue info
+// Queue info, updated with IRQs masked since transfers are queued from any context
 static struct _queue_info
 {
     uint_8 enq_idx;                 // Enqueue index
     uint_8 deq_idx;                 // Dequeue index
+    uint_8 busy;                    // Number of dTDs in use
     dtd_setup_t *tail;              // Pointer to dTD at tail
+    uint_8 *xfer_buffer;            // Buffer of the transfer being completed
+    unsigned int xfer_len;          // Bytes done by its retired dTDs
 } g_usbd_queue_info[MAX_USB_STACKS][MAX_ENDPOINT_NUMBER * 2];
 
+// USBSTS bits acknowledged by usb0_isr and not yet serviced
+static volatile uint32_t g_usbd0_pending_stat;
+
+// Services the device interrupts outside of the interrupt handler
+static work_item_t g_usbd0_work;
+
 /*****************************************************************************
  * Global Functions
  *****************************************************************************/
@@ -700,6 +724,7 @@ static usb_status_t usbd_usb_run(uint_8 controller_ID)
         uint32_t irqId = IMX_INT_USB_OTG1;
 #endif
 
+        work_item_init(&g_usbd0_work, usb0_service, NULL);
         register_interrupt_routine(irqId, usb0_isr);
         enable_interrupt(irqId, CPU_0, 0);
     }else{
@@ -971,12 +996,16 @@ static void usbd_ep_qh_init(uint_8 controller_ID,
     int td_index = (endpt_number * 2) + direction;
     g_usbd_queue_info[controller_ID][td_index].enq_idx = 0;
     g_usbd_queue_info[controller_ID][td_index].deq_idx = 0;
+    g_usbd_queue_info[controller_ID][td_index].busy = 0;
     g_usbd_queue_info[controller_ID][td_index].tail = NULL;
+    g_usbd_queue_info[controller_ID][td_index].xfer_buffer = NULL;
+    g_usbd_queue_info[controller_ID][td_index].xfer_len = 0;
 
     // Initialize TD flags
     for (int i = 0; i < MAX_DTDS_PER_EP; i++)
     {
         g_usbd_td_flag[controller_ID][td_index][i].status = DTD_FREE;
+        g_usbd_td_flag[controller_ID][td_index][i].last = TRUE;
         g_usbd_td_flag[controller_ID][td_index][i].total_bytes = 0;
         g_usbd_td_flag[controller_ID][td_index][i].phys_td = NULL;
    }
@@ -1135,10 +1164,12 @@ static unsigned int usbd_get_dtd(uint_8 controller_ID, unsigned char endpt_numbe
     int td_index = (endpt_number * 2) + direction;
     uint_8 *enq_idx = &g_usbd_queue_info[controller_ID][td_index].enq_idx;
     unsigned int phys_td;
+    bool wasEnabled = arm_set_interrupt_state(false);
     
     // Check if we are out of free TDs
     if (g_usbd_td_flag[controller_ID][td_index][*enq_idx].status == DTD_BUSY)
     {
+        arm_set_interrupt_state(wasEnabled);
         printf_error("Cannot get dTD!\n");
         return 0;
     }
@@ -1147,6 +1178,8 @@ static unsigned int usbd_get_dtd(uint_8 controller_ID, unsigned char endpt_numbe
     
     // We have found an available TD. Mark it as busy
     g_usbd_td_flag[controller_ID][td_index][*enq_idx].status = DTD_BUSY;
+    g_usbd_td_flag[controller_ID][td_index][*enq_idx].last = TRUE;
+    g_usbd_queue_info[controller_ID][td_index].busy++;
     g_usbd_td_flag[controller_ID][td_index][*enq_idx].phys_td = (volatile struct dtd_setup_t *)
         ((unsigned int) td_buf +
         (SIZE_OF_DTD0) *(td_index) * MAX_DTDS_PER_EP +
@@ -1160,6 +1193,7 @@ static unsigned int usbd_get_dtd(uint_8 controller_ID, unsigned char endpt_numbe
         *enq_idx = 0;
     }
 
+    arm_set_interrupt_state(wasEnabled);
     return phys_td;
 }
 
@@ -1178,14 +1212,15 @@ static uint_32 temp_sof0_counter = 0;
  * @return None
  *
  ******************************************************************************
- * This function handles the USB interrupts.
- * After handling the interrupt it calls the Device Layer to notify it about
- * the event.
+ * This function acknowledges the USB interrupts and counts SOFs. Everything
+ * else, including the Device Layer and class callbacks, runs in usb0_service
+ * as deferred work with interrupts enabled, see utility/work_queue.h, or
+ * directly from here if the work queue of the core is not enabled.
  *****************************************************************************/
 static void usb0_isr(void)// *data)
 {
     uint_32 intr_stat;
-    USB_DEV_EVENT_STRUCT event;
+    uint_32 pending;
 
     intr_stat = readl(&usbotg[0]->usbsts);
     // Only process the interrupts that are enabled
@@ -1193,20 +1228,12 @@ static void usb0_isr(void)// *data)
     
 //     printf("usb0_isr %x\n", intr_stat);
 
-    /* initialize event structure */
-    event.controller_ID = g_dci_controller_Id[0];
-    event.setup = FALSE;
-    event.buffer_ptr = NULL;
-    event.len = 0;
-    event.direction = USB_RECV;
-    event.errors = NO_ERRORS;
-    event.ep_num = (uint_8)UNINITIALISED_VAL;
+    /* Clear Interrupts, ENDPTCOMPLETE and ENDPTSETUPSTAT keep what UI stands for */
+    writel(intr_stat, &usbotg[0]->usbsts);
 
     // Handle SOF interrupt
 	if (intr_stat & BM_USBC_(USBSTS_SRI))
 	{
-        /* Clear Interrupt */
-        writel(BM_USBC_(USBSTS_SRI), &usbotg[0]->usbsts);
 #if FORCE_FULLSPEED
 		sof_counter[0]++;
 #else
@@ -1216,13 +1243,60 @@ static void usb0_isr(void)// *data)
 			temp_sof0_counter = 0;
 		}
 #endif
+        intr_stat &= ~BM_USBC_(USBSTS_SRI);
+    }
+
+    if (!intr_stat)
+    {
+        return;
+    }
+
+    do {
+        pending = g_usbd0_pending_stat;
+    } while (!atomic_compare_and_swap(&g_usbd0_pending_stat, pending, pending | intr_stat));
+
+    if (!work_queue(&g_usbd0_work))
+    {
+        usb0_service(NULL);
     }
+}
+
+/**************************************************************************//*!
+ *
+ * @name  usb0_service
+ *
+ * @brief The function services the USB interrupts acknowledged by usb0_isr.
+ *
+ * @param arg : Unused
+ *
+ * @return None
+ *
+ ******************************************************************************
+ * After handling the interrupt it calls the Device Layer to notify it about
+ * the event.
+ *****************************************************************************/
+static void usb0_service(void *arg)
+{
+    uint_32 intr_stat;
+    USB_DEV_EVENT_STRUCT event;
+
+    do {
+        intr_stat = g_usbd0_pending_stat;
+    } while (!atomic_compare_and_swap(&g_usbd0_pending_stat, intr_stat, 0));
+
+    /* initialize event structure */
+    event.controller_ID = g_dci_controller_Id[0];
+    event.setup = FALSE;
+    event.buffer_ptr = NULL;
+    event.len = 0;
+    event.direction = USB_RECV;
+    event.errors = NO_ERRORS;
+    event.ep_num = (uint_8)UNINITIALISED_VAL;
 
     // Handle suspend
     if (intr_stat & BM_USBC_(USBSTS_SLI))
 	{
 		printf_info("received suspend irq on device 0\n");
-		writel(BM_USBC_(USBSTS_SLI), &usbotg[0]->usbsts);
 		return;
 	}
 
@@ -1230,8 +1304,6 @@ static void usb0_isr(void)// *data)
     if (intr_stat & BM_USBC_(USBSTS_URI))
     {
 		printf_info("received bus reset irq on device 0\n");
-        /* Clear Interrupt */
-		writel(BM_USBC_(USBSTS_URI), &usbotg[0]->usbsts);
 
         /* Handle RESET Interrupt */
         USB_Bus_Reset_Handler(0);
@@ -1246,9 +1318,6 @@ static void usb0_isr(void)// *data)
     // Handle Transaction complete
     if (intr_stat & BM_USBC_(USBSTS_UI))
     {
-        /* Clear Interrupt */
-		writel(BM_USBC_(USBSTS_UI), &usbotg[0]->usbsts);
-
         // todo This does happen, what else triggers this interrupt?
 //        if (!(readl(&usbotg->endptsetupstat) && !(readl(&usbotg->endptcomplete))))
 //        {
@@ -1273,16 +1342,12 @@ static void usb0_isr(void)// *data)
     if (intr_stat & BM_USBC_(USBSTS_PCI))
     {
 		printf_info("received port change irq on device 0\n");
-        /* Clear Interrupt */
-		writel(BM_USBC_(USBSTS_PCI), &usbotg[0]->usbsts);
     }
 
     // Handle USB error
     if (intr_stat & BM_USBC_(USBSTS_UEI))
     {
 		printf_info("received usb error irq on device 0\n");
-        /* Clear Interrupt */
-		writel(BM_USBC_(USBSTS_UEI), &usbotg[0]->usbsts);
 
         event.errors = (uint_8)BM_USBC_(USBSTS_UEI);
 
@@ -1294,8 +1359,6 @@ static void usb0_isr(void)// *data)
     if (intr_stat & BM_USBC_(USBSTS_SEI))
     {
 		printf_info("received usb system error irq on device 0\n");
-        /* Clear Interrupt */
-		writel(BM_USBC_(USBSTS_SEI), &usbotg[0]->usbsts);
 
         event.errors = (uint_8)BM_USBC_(USBSTS_SEI);
 
@@ -1640,11 +1703,14 @@ static void usbd_ep0_complete(USB_DEV_EVENT_STRUCT* event)
     unsigned int direction = event->direction;
     unsigned int td_index = (endpt_number * 2) + direction;
     uint_8 *deq_idx = &g_usbd_queue_info[event->controller_ID][td_index].deq_idx;
+    bool wasEnabled;
     
     // Complete all retired TDs. TDs are retired in the order they were enqueued, in other words
     // starting at the current dequeue index.
     while (1)
     {
+        wasEnabled = arm_set_interrupt_state(false);
+
         // Get dTD associated with this endpoint and direction
         dtd_word = g_usbd_td_flag[event->controller_ID][td_index][*deq_idx].phys_td;
 
@@ -1656,11 +1722,12 @@ static void usbd_ep0_complete(USB_DEV_EVENT_STRUCT* event)
             // Get original number of bytes to transfer
             unsigned int total_bytes = g_usbd_td_flag[event->controller_ID][td_index][*deq_idx].total_bytes;
             // Subtract number of remaining bytes not transferred
-            event->len = total_bytes - (dtd_word->dtd_word1 >> 16) & 0x7FFF;
+            event->len = total_bytes - ((dtd_word->dtd_word1 >> 16) & 0x7FFF);
             event->buffer_ptr = (uint_8 *)dtd_word->dtd_word7;
 
             // Mark dTD as free
             g_usbd_td_flag[event->controller_ID][td_index][*deq_idx].status = DTD_FREE;
+            g_usbd_queue_info[event->controller_ID][td_index].busy--;
 			
             if (g_dci_address_state[event->controller_ID] == 1)
             {
@@ -1681,12 +1748,15 @@ static void usbd_ep0_complete(USB_DEV_EVENT_STRUCT* event)
             {
                 *deq_idx = 0;
             }
+            arm_set_interrupt_state(wasEnabled);
 			
             /* Notify Device Layer of Data Recieved or Sent Event */
             (void)USB_Device_Call_Service(event->ep_num, event);
         }
         else
         {
+            arm_set_interrupt_state(wasEnabled);
+
             // Since TDs will always be completed in order, once we have found a TD that is not completed we are done.
             break;
         }
@@ -1700,12 +1770,17 @@ static void usbd_dtd_complete(USB_DEV_EVENT_STRUCT* event)
     unsigned int endpt_number = event->ep_num;
     unsigned int direction = event->direction;
     unsigned int td_index = (endpt_number * 2) + direction;
-    uint_8 *deq_idx = &g_usbd_queue_info[event->controller_ID][td_index].deq_idx;
+    struct _queue_info *queue = &g_usbd_queue_info[event->controller_ID][td_index];
+    uint_8 *deq_idx = &queue->deq_idx;
+    bool wasEnabled;
     
     // Complete all retired TDs. TDs are retired in the order they were enqueued, in other words
-    // starting at the current dequeue index.
+    // starting at the current dequeue index. Only the last dTD of a transfer interrupts, so one
+    // pass may retire several transfers, each of them reported once with the bytes of all its dTDs.
     while (1)
     {
+        wasEnabled = arm_set_interrupt_state(false);
+
         // Get dTD associated with this endpoint and direction
         dtd_word = g_usbd_td_flag[event->controller_ID][td_index][*deq_idx].phys_td;
 
@@ -1716,17 +1791,26 @@ static void usbd_dtd_complete(USB_DEV_EVENT_STRUCT* event)
             
             // Get original number of bytes to transfer
             unsigned int total_bytes = g_usbd_td_flag[event->controller_ID][td_index][*deq_idx].total_bytes;
+            unsigned int remaining = (dtd_word->dtd_word1 >> 16) & 0x7FFF;
+            uint_8 last = g_usbd_td_flag[event->controller_ID][td_index][*deq_idx].last;
+
+            // The first dTD of a transfer holds its buffer address
+            if (queue->xfer_buffer == NULL)
+            {
+                queue->xfer_buffer = (uint_8 *)dtd_word->dtd_word7;
+                queue->xfer_len = 0;
+            }
             // Subtract number of remaining bytes not transferred
-            event->len = total_bytes - (dtd_word->dtd_word1 >> 16) & 0x7FFF;
-            event->buffer_ptr = (uint_8 *)dtd_word->dtd_word7;
+            queue->xfer_len += total_bytes - remaining;
 
             // Mark dTD as free
             g_usbd_td_flag[event->controller_ID][td_index][*deq_idx].status = DTD_FREE;
+            queue->busy--;
 			
             // If this was the tail, mark list as empty
-            if (dtd_word == g_usbd_queue_info[event->controller_ID][td_index].tail)
+            if (dtd_word == queue->tail)
             {
-                g_usbd_queue_info[event->controller_ID][td_index].tail = NULL;
+                queue->tail = NULL;
             }
             
             // Increment the dequeue TD index with wrapping
@@ -1734,20 +1818,84 @@ static void usbd_dtd_complete(USB_DEV_EVENT_STRUCT* event)
             {
                 *deq_idx = 0;
             }
-			
-            /* Notify Device Layer of Data Recieved or Sent Event */
-            (void)USB_Device_Call_Service(event->ep_num, event);
+
+            // A short packet ends a receive early, the rest of its chain gets no data
+            if (!last && remaining && (direction == USB_RECV))
+            {
+                usbd_cancel_chain(event->controller_ID, endpt_number, direction);
+                last = TRUE;
+            }
+            arm_set_interrupt_state(wasEnabled);
+
+            if (last)
+            {
+                event->buffer_ptr = queue->xfer_buffer;
+                event->len = queue->xfer_len;
+                queue->xfer_buffer = NULL;
+
+                /* Notify Device Layer of Data Recieved or Sent Event */
+                (void)USB_Device_Call_Service(event->ep_num, event);
+            }
         }
         else
         {
+            arm_set_interrupt_state(wasEnabled);
+
             // Since TDs will always be completed in order, once we have found a TD that is not completed we are done.
             break;
         }
     }
 }
 
+// Drop the dTDs left of a transfer that a short packet ended, with IRQs masked. The controller
+// has already moved on to them, so the endpoint is flushed first and primed again with the
+// transfers queued behind.
+static void usbd_cancel_chain(uint_8 controller_ID, unsigned char ep_num, unsigned char direction)
+{
+    unsigned int td_index = (ep_num * 2) + direction;
+    struct _queue_info *queue = &g_usbd_queue_info[controller_ID][td_index];
+    unsigned int ep_mask = (direction == OUT ? EPOUT_PRIME : EPIN_PRIME) << ep_num;
+    uint_8 last;
+
+    // Flush the endpoint, again if it was primed meanwhile
+    do
+    {
+        writel(ep_mask, &usbotg[controller_ID]->endptflush);
+        while (readl(&usbotg[controller_ID]->endptflush) & ep_mask) ;
+    } while (readl(&usbotg[controller_ID]->endptstat) & ep_mask);
+
+    // Free the dTDs up to the last one of the transfer
+    do
+    {
+        struct _td_status *td = &g_usbd_td_flag[controller_ID][td_index][queue->deq_idx];
+
+        last = td->last;
+        td->status = DTD_FREE;
+        queue->busy--;
+
+        // If this was the tail, mark list as empty
+        if (td->phys_td == queue->tail)
+        {
+            queue->tail = NULL;
+        }
+
+        // Increment the dequeue TD index with wrapping
+        if (++queue->deq_idx >= MAX_DTDS_PER_EP)
+        {
+            queue->deq_idx = 0;
+        }
+    } while (!last);
+
+    // Restart the endpoint on the next transfer
+    if (queue->tail != NULL)
+    {
+        usbd_prime_ep(controller_ID, ep_num, direction,
+                      (unsigned int)g_usbd_td_flag[controller_ID][td_index][queue->deq_idx].phys_td);
+    }
+}
+
 // Prime endpoint
-static void usbd_prime_ep(uint_8 controller_ID, unsigned char ep_num, unsigned char direction, struct dtd_t *td)
+static void usbd_prime_ep(uint_8 controller_ID, unsigned char ep_num, unsigned char direction, unsigned int dtd_address)
 {
     unsigned int temp;
     unsigned int ep_mask = (direction == OUT ? EPOUT_PRIME : EPIN_PRIME);
@@ -1763,7 +1911,7 @@ static void usbd_prime_ep(uint_8 controller_ID, unsigned char ep_num, unsigned c
     }
 
     /* 1. write dQH next ptr and dQH terminate bit to 0 */
-    *(volatile unsigned int *)(dqh_address + 0x8) = td->dtd_base;
+    *(volatile unsigned int *)(dqh_address + 0x8) = dtd_address;
 
     /* 2. clear active & halt bit in dQH */
     *(volatile unsigned int *)(dqh_address + 0xC) &= ~0xFF;
@@ -1798,7 +1946,11 @@ static void usbd_prime_ep(uint_8 controller_ID, unsigned char ep_num, unsigned c
 // 7. If status bit read in (4) is '1' DONE.
 // 8. If status bit read in (4) is '0' then Goto Case 1: Step 1.
 //
-static void usbd_add_td(uint_8 controller_ID, unsigned char ep_num, unsigned char direction, struct dtd_t *td)
+// The dTDs from first_dtd to last_dtd are already linked to each other, so a whole
+// chain is appended at once while the controller keeps working on the queue.
+//
+static void usbd_add_td(uint_8 controller_ID, unsigned char ep_num, unsigned char direction,
+                        unsigned int first_dtd, unsigned int last_dtd)
 {
     // Get the index into the TD list for this endpoint + direction
     int td_index = (ep_num * 2) + direction;
@@ -1807,7 +1959,7 @@ static void usbd_add_td(uint_8 controller_ID, unsigned char ep_num, unsigned cha
     {
         // Case 1: Link list is empty
 
-        usbd_prime_ep(controller_ID, ep_num, direction, td);
+        usbd_prime_ep(controller_ID, ep_num, direction, first_dtd);
     }
     else
     {
@@ -1817,7 +1969,7 @@ static void usbd_add_td(uint_8 controller_ID, unsigned char ep_num, unsigned cha
 
         // Add TD to tail next_link_ptr
         // Clear Terminate bit to indicate pointer is valid
-        g_usbd_queue_info[controller_ID][td_index].tail->dtd_word0 = td->dtd_base & 0xFFFFFFE0;
+        g_usbd_queue_info[controller_ID][td_index].tail->dtd_word0 = first_dtd & 0xFFFFFFE0;
 
         // If EP is already primed, we are done
         if (!(readl(&usbotg[controller_ID]->endptprime) & (ep_mask << ep_num)))
@@ -1837,7 +1989,7 @@ static void usbd_add_td(uint_8 controller_ID, unsigned char ep_num, unsigned cha
                 // Read endpoint status
                 ep_status = readl(&usbotg[controller_ID]->endptstat) & (ep_mask << ep_num);
 
-            } while (!readl(&usbotg[controller_ID]->usbcmd) & (0x1 << BP_USBC_(USBCMD_ATDTW)));
+            } while (!(readl(&usbotg[controller_ID]->usbcmd) & (0x1 << BP_USBC_(USBCMD_ATDTW))));
 
             /* write '0' to Add Tripwire (ATDTW) in USBCMD register */
             temp = readl(&usbotg[controller_ID]->usbcmd);
@@ -1847,67 +1999,135 @@ static void usbd_add_td(uint_8 controller_ID, unsigned char ep_num, unsigned cha
             if (!ep_status)
             {
                 // Status is inactive, so need to prime EP
-                usbd_prime_ep(controller_ID, ep_num, direction, td);
+                usbd_prime_ep(controller_ID, ep_num, direction, first_dtd);
             }
         }
     }
 
     // Make this TD the tail
-    g_usbd_queue_info[controller_ID][td_index].tail = (struct dtd_setup_t *)td->dtd_base;
+    g_usbd_queue_info[controller_ID][td_index].tail = (struct dtd_setup_t *)last_dtd;
 }
 
 /*!
- * Receive data through EPx
+ * Queue a transfer on endpoint x
  *
- * @param    epx_data_buffer    EPx receive buffer
- * @param    sz                 Number of bytes to receive
+ * The buffer is split over as many dTDs as it needs, linked to each other with only
+ * the last one interrupting on completion, and the chain is appended to the endpoint
+ * queue even while earlier transfers are still active.
  *
- * @return   SUCCESS on success, otherwise FAIL when timeout
+ * @param    data_buffer        Transfer buffer
+ * @param    direction          The In or Out endpoint
+ * @param    sz                 Number of bytes to transfer
+ *
+ * @return   SUCCESS on success, otherwise FAIL when the endpoint has not enough free dTDs
  */
-static usb_status_t usbd_receive_data_epxout(uint_8 controller_ID, unsigned int epx_data_buffer, uint_8 ep_num, unsigned int sz)
+static usb_status_t usbd_queue_epx(uint_8 controller_ID, unsigned int data_buffer, uint_8 ep_num, unsigned char direction, unsigned int sz)
 {
     struct dtd_t td;
-    unsigned int total_bytes;
+    int td_index = (ep_num * 2) + direction;
+    unsigned int count = 0;
+    unsigned int remaining = sz;
+    unsigned int buffer = data_buffer;
+    unsigned int first_dtd = 0;
     unsigned int dtd_address;
-    unsigned int direction = OUT;
+    unsigned int total_bytes;
+    uint_8 dtd_idx = 0;
+    uint_8 prev_idx;
+    bool wasEnabled;
 
-    //printf_info("%s, size is %d\n", __func__, sz);
-	
-    /* Get Device Transfer Descriptor of the requested endpoint */
-	dtd_address = usbd_get_dtd(controller_ID, ep_num, direction, sz);
-    if (!dtd_address)
+    // Count the dTDs of the transfer and make sure they are all available
+    do
+    {
+        total_bytes = (remaining > DTD_SPAN(buffer)) ? DTD_SPAN(buffer) : remaining;
+        buffer += total_bytes;
+        remaining -= total_bytes;
+        count++;
+    } while (remaining);
+
+    // The completion handler frees dTDs and may preempt us, keep it out until the chain is queued
+    wasEnabled = arm_set_interrupt_state(false);
+
+    if (g_usbd_queue_info[controller_ID][td_index].busy + count > MAX_DTDS_PER_EP)
     {
+        arm_set_interrupt_state(wasEnabled);
+        printf_error("Cannot get %d dTDs!\n", count);
         return USB_FAILURE;
     }
 
-    /* Get the total bytes to be received   */
-    total_bytes = sz;
+    remaining = sz;
+    buffer = data_buffer;
+    td.dtd_base = 0;
 
-	if (total_bytes > 20 * 1024)
-	    printf_error("Error!!! %s, size is %d\n", __func__, sz);
-		
-    td.dtd_base = dtd_address;
-   	td.next_link_ptr = 0;
-    td.terminate = TERMINATE;
-    td.total_bytes = total_bytes;
-    td.ioc = IOC_SET;
-    td.status = ACTIVE;
-    td.buffer_ptr0 = epx_data_buffer;
-    td.current_offset = (epx_data_buffer & 0xFFF);
-    td.buffer_ptr1 = (epx_data_buffer & 0xFFFFF000) + 0x1000;
-    td.buffer_ptr2 = (epx_data_buffer & 0xFFFFF000) + 0x2000;
-    td.buffer_ptr3 = (epx_data_buffer & 0xFFFFF000) + 0x3000;
-    td.buffer_ptr4 = (epx_data_buffer & 0xFFFFF000) + 0x4000;
+    do
+    {
+        total_bytes = (remaining > DTD_SPAN(buffer)) ? DTD_SPAN(buffer) : remaining;
+        prev_idx = dtd_idx;
+        dtd_idx = g_usbd_queue_info[controller_ID][td_index].enq_idx;
 
-    /* Set the Transfer Descriptor  */
+        /* Get Device Transfer Descriptor of the requested endpoint */
+        dtd_address = usbd_get_dtd(controller_ID, ep_num, direction, total_bytes);
+        if (!dtd_address)
+        {
+            arm_set_interrupt_state(wasEnabled);
+            return USB_FAILURE;
+        }
+
+        if (td.dtd_base)
+        {
+            // Link the previous dTD to this one now that its address is known
+            g_usbd_td_flag[controller_ID][td_index][prev_idx].last = FALSE;
+            td.next_link_ptr = dtd_address;
+            td.terminate = NOT_TERMINATE;
+            td.ioc = 0;
+            usbd_setup_td(&td);
+        }
+        else
+        {
+            first_dtd = dtd_address;
+        }
+
+        td.dtd_base = dtd_address;
+        td.next_link_ptr = 0;
+        td.terminate = TERMINATE;
+        td.total_bytes = total_bytes;
+        td.ioc = IOC_SET;
+        td.status = ACTIVE;
+        td.buffer_ptr0 = buffer;
+        td.current_offset = (buffer & 0xFFF);
+        td.buffer_ptr1 = (buffer & 0xFFFFF000) + 0x1000;
+        td.buffer_ptr2 = (buffer & 0xFFFFF000) + 0x2000;
+        td.buffer_ptr3 = (buffer & 0xFFFFF000) + 0x3000;
+        td.buffer_ptr4 = (buffer & 0xFFFFF000) + 0x4000;
+
+        buffer += total_bytes;
+        remaining -= total_bytes;
+    } while (remaining);
+
+    /* Set the last Transfer Descriptor */
     usbd_setup_td(&td);
 
-    // Add TD to TD list for this endpoint + direction
-    usbd_add_td(controller_ID, ep_num, direction, &td);
+    // Add the dTD chain to the TD list for this endpoint + direction
+    usbd_add_td(controller_ID, ep_num, direction, first_dtd, dtd_address);
 
+    arm_set_interrupt_state(wasEnabled);
     return USB_SUCCESS;
 }
 
+/*!
+ * Receive data through EPx
+ *
+ * @param    epx_data_buffer    EPx receive buffer
+ * @param    sz                 Number of bytes to receive
+ *
+ * @return   SUCCESS on success, otherwise FAIL when timeout
+ */
+static usb_status_t usbd_receive_data_epxout(uint_8 controller_ID, unsigned int epx_data_buffer, uint_8 ep_num, unsigned int sz)
+{
+    //printf_info("%s, size is %d\n", __func__, sz);
+
+    return usbd_queue_epx(controller_ID, epx_data_buffer, ep_num, OUT, sz);
+}
+
 /*!
  * Receive data through EP0
  *
@@ -1986,44 +2206,9 @@ static usb_status_t usbd_receive_data_ep0out(uint_8 controller_ID, unsigned int
  */
 static usb_status_t usbd_send_data_epxin(uint_8 controller_ID, unsigned int epx_data_buffer, uint_8 ep_num, unsigned int sz)
 {
-    struct dtd_t td;
-    unsigned int total_bytes;
-    unsigned int dtd_address;
-    unsigned int direction = IN;
-
 	printf_info("%s, size is %d\n", __func__, sz);
 
-    /* varify Endpoint Number and address */
-    /* Get Device Transfer Descriptor of the requested endpoint */
-    dtd_address = usbd_get_dtd(controller_ID, ep_num, direction, sz);
-    if (!dtd_address)
-    {
-        return USB_FAILURE;
-    }
-
-    /* Get Total Bytes to Be recieved */
-    total_bytes = sz;
-
-    td.dtd_base = dtd_address;
-    td.next_link_ptr = 0;
-    td.terminate = TERMINATE;
-    td.total_bytes = total_bytes;
-    td.ioc = IOC_SET;
-    td.status = ACTIVE;
-    td.buffer_ptr0 = epx_data_buffer;
-    td.current_offset = (epx_data_buffer & 0xFFF);
-    td.buffer_ptr1 = (epx_data_buffer & 0xFFFFF000) + 0x1000;
-    td.buffer_ptr2 = (epx_data_buffer & 0xFFFFF000) + 0x2000;
-    td.buffer_ptr3 = (epx_data_buffer & 0xFFFFF000) + 0x3000;
-    td.buffer_ptr4 = (epx_data_buffer & 0xFFFFF000) + 0x4000;
-
-    /* Set the transfer descriptor */
-    usbd_setup_td(&td);
-
-    // Add TD to TD list for this endpoint + direction
-    usbd_add_td(controller_ID, ep_num, direction, &td);
-
-    return USB_SUCCESS;
+    return usbd_queue_epx(controller_ID, epx_data_buffer, ep_num, IN, sz);
 }
 
 /*!
@@ -312,7 +312,7 @@ typedef struct _USB_EP_STRUCT
     USB_PACKET_SIZE	size ALIGN;  /* buffer size of endpoint */
 }ALIGN USB_EP_STRUCT, *USB_EP_STRUCT_PTR;
 
-#if (defined(__CWCC__)||defined(__GNUC__))
+#if defined(__CWCC__)
 	#pragma options align = reset
 #elif defined(__IAR_SYSTEMS_ICC__) || defined(__CC_ARM)
 	#pragma pack()
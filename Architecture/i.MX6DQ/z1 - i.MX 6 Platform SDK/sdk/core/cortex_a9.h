@@ -110,9 +110,14 @@ void arm_dcache_invalidate_line(const void * addr);
 //!
 //! Number of lines depends on length parameter and size of line.
 //! Size of line for A9 L1 cache is 32B.
+//!
+//! If the L2 cache is enabled, its lines for the range are invalidated as well, before the
+//! L1 ones.
 void arm_dcache_invalidate_mlines(const void * addr, size_t length);
 
 //! @brief Flush (clean) all lines of cache (all sets in all ways).
+//!
+//! Cleans the whole L2 cache too if it is enabled.
 void arm_dcache_flush();
 
 //! @brief Flush (clean) one line of cache.
@@ -121,6 +126,8 @@ void arm_dcache_flush_line(const void * addr);
 // @brief Flush (clean) multiple lines of cache.
 //!
 //! Number of lines depends on length parameter and size of line.
+//!
+//! If the L2 cache is enabled, the range is cleaned from it as well, after the L1.
 void arm_dcache_flush_mlines(const void * addr, size_t length);
 //@}
 
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#if !defined(__DMA_ALLOC_H__)
+#define __DMA_ALLOC_H__
+
+#include "sdk_types.h"
+
+//! @addtogroup dma_alloc
+//! @{
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Size in bytes of a cache line, the unit of all cache maintenance.
+//!
+//! The Cortex-A9 L1 and the PL310 L2 both use 32 byte lines.
+#define DMA_CACHE_LINE_SIZE (32)
+
+//! @brief Size in bytes of the non-cacheable pool backing dma_alloc_coherent().
+//!
+//! The pool is remapped with 4KB and 64KB pages, so this must be a multiple of 4KB.
+#if !defined(DMA_COHERENT_POOL_SIZE)
+#define DMA_COHERENT_POOL_SIZE (256 * 1024)
+#endif
+
+//! @brief Direction of a streaming DMA transfer, seen from the CPU.
+typedef enum _dma_direction {
+    kDmaToDevice,       //!< The device reads the buffer, e.g. a TX frame or a disk write.
+    kDmaFromDevice,     //!< The device writes the buffer, e.g. an RX frame or a disk read.
+    kDmaBidirectional   //!< The device both reads and writes the buffer.
+} dma_direction_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @name Coherent memory
+//!
+//! Coherent memory is mapped non-cacheable, so the CPU and DMA masters always see the same
+//! data without any cache maintenance. Every CPU access goes to DDR though, so it should be
+//! used for small structures both sides poll or update, such as buffer descriptors, and not
+//! for data buffers.
+//!
+//! The pool is mapped the first time it is used, which must be after mmu_init(). Writes to
+//! coherent memory may still be in the CPU write buffer, so drivers must issue _ARM_DSB()
+//! before telling a device to fetch a descriptor.
+//@{
+//! @brief Allocate zeroed memory from the non-cacheable pool.
+//!
+//! @param size Number of bytes to allocate.
+//! @param align Required alignment, a power of two. Blocks are always aligned to at least
+//!     64 bytes, so 0 may be passed when that is enough.
+//! @return The block address, which is also its physical address, or NULL if the pool is
+//!     exhausted.
+void * dma_alloc_coherent(size_t size, size_t align);
+
+//! @brief Return a block obtained from dma_alloc_coherent() to the pool.
+//!
+//! Passing NULL does nothing.
+void dma_free_coherent(void * ptr);
+
+//! @brief Returns the number of bytes still free in the coherent pool.
+size_t dma_coherent_get_free(void);
+//@}
+
+//! @name Streaming memory
+//!
+//! Streaming buffers live in normal cacheable memory, so the CPU fills and parses them at full
+//! speed. Ownership is passed explicitly: dma_sync_for_device() before the device accesses the
+//! buffer, and dma_sync_for_cpu() before the CPU looks at what the device wrote. Only the
+//! cache lines covering the given range are maintained.
+//!
+//! The sync functions may be used on any buffer, but a buffer that does not start and end on
+//! a cache line boundary shares its first and last lines with other data. That data must not
+//! be written by the CPU while the device is writing the buffer. Buffers returned by
+//! dma_alloc_streaming() never share lines.
+//@{
+//! @brief Allocate a cacheable buffer suitable for streaming DMA.
+//!
+//! @param size Number of bytes to allocate.
+//! @param align Required alignment, a power of two. The buffer is always aligned to at least
+//!     #DMA_CACHE_LINE_SIZE, so 0 may be passed when that is enough.
+//! @return The buffer address, or NULL if the heap is exhausted.
+void * dma_alloc_streaming(size_t size, size_t align);
+
+//! @brief Free a buffer obtained from dma_alloc_streaming().
+//!
+//! Passing NULL does nothing.
+void dma_free_streaming(void * ptr);
+
+//! @brief Hand a buffer to a device.
+//!
+//! For #kDmaToDevice and #kDmaBidirectional, dirty lines are written back so the device reads
+//! what the CPU wrote. For #kDmaFromDevice, the lines are discarded so no dirty line can later
+//! be evicted over the data written by the device.
+//!
+//! @param ptr Start of the range the device will access.
+//! @param size Number of bytes in the range.
+//! @param direction Direction of the transfer.
+void dma_sync_for_device(const void * ptr, size_t size, dma_direction_t direction);
+
+//! @brief Take a buffer back from a device once the transfer is complete.
+//!
+//! For #kDmaFromDevice and #kDmaBidirectional, the lines are discarded again, since the CPU
+//! may have speculatively fetched them while the transfer was running. Nothing needs to be
+//! done for #kDmaToDevice.
+//!
+//! @param ptr Start of the range the device accessed.
+//! @param size Number of bytes in the range.
+//! @param direction Direction of the transfer.
+void dma_sync_for_cpu(const void * ptr, size_t size, dma_direction_t direction);
+//@}
+
+#if defined(__cplusplus)
+}
+#endif
+
+//! @}
+
+#endif // __DMA_ALLOC_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
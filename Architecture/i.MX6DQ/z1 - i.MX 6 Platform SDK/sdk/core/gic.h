@@ -81,8 +81,8 @@ void gic_init(void);
 
 //! @brief Init the current CPU's GIC interface.
 //!
-//! @post Enables the CPU interface and sets the priority mask to 255. Interrupt preemption
-//!     is disabled by setting the Binary Point to a value of 7.
+//! @post Enables the CPU interface and sets the priority mask to 255. The Binary Point is set
+//!     to its minimum, so interrupts of a higher priority level preempt running handlers.
 void gic_init_cpu(void);
 //@}
 
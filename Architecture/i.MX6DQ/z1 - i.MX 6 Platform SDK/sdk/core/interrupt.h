@@ -56,6 +56,42 @@ typedef enum {
 //! @brief Interrupt service routine.
 typedef void (*irq_hdlr_t) (void);
 
+//! @brief Interrupt service routine taking the context registered with it.
+typedef void (*irq_context_hdlr_t) (void * context);
+
+//! @brief Suggested interrupt priorities.
+//!
+//! The GIC implements 32 priority levels, in steps of 8. Handlers run with IRQs enabled, so
+//! an interrupt of a higher priority (lower value) preempts the handler of a lower priority one.
+//! Interrupts of the same priority never preempt each other.
+enum _irq_priorities
+{
+    kIrqPriority_Highest = 0x00,    //!< Default for existing drivers, nothing preempts it.
+    kIrqPriority_High = 0x40,       //!< Latency sensitive sources such as network receive and timers.
+    kIrqPriority_Normal = 0x80,     //!< General purpose peripherals.
+    kIrqPriority_Low = 0xc0         //!< Slow handlers such as storage completion.
+};
+
+//! @brief Number of buckets of the histograms in #irq_stats_t.
+#define IRQ_HISTOGRAM_BUCKETS (12)
+
+//! @brief Statistics of one interrupt.
+//!
+//! All times are in microseconds. Bucket 0 of a histogram counts times below 1us, bucket
+//! @a n counts times from 2^(n-1) up to 2^n - 1 microseconds, and the last bucket also counts
+//! everything longer.
+typedef struct _irq_stats
+{
+    uint32_t count;             //!< Number of times the handler was called.
+    uint32_t nested;            //!< Number of times the handler preempted another handler.
+    uint64_t totalTime;         //!< Total time spent in the handler.
+    uint32_t maxTime;           //!< Longest handler run, including time preempted.
+    uint32_t latencyCount;      //!< Number of latencies reported with irq_record_latency().
+    uint32_t maxLatency;        //!< Worst latency reported with irq_record_latency().
+    uint32_t timeHistogram[IRQ_HISTOGRAM_BUCKETS];      //!< Distribution of handler run times.
+    uint32_t latencyHistogram[IRQ_HISTOGRAM_BUCKETS];   //!< Distribution of reported latencies.
+} irq_stats_t;
+
 ////////////////////////////////////////////////////////////////////////////////
 // API
 ////////////////////////////////////////////////////////////////////////////////
@@ -71,7 +107,8 @@ extern "C" {
 //!
 //! @param irq_id The interrupt number to enable.
 //! @param cpu_id The index of the CPU for which the interrupt will be enabled.
-//! @param priority The interrupt priority, from 0-255. Lower numbers have higher priority.
+//! @param priority The interrupt priority, from 0-255. Lower numbers have higher priority. Only
+//!     the upper 5 bits are used, see #_irq_priorities.
 void enable_interrupt(uint32_t irq_id, uint32_t cpu_id, uint32_t priority);
 
 //! @brief Disable an interrupt on the specified CPU.
@@ -86,6 +123,86 @@ void disable_interrupt(uint32_t irq_id, uint32_t cpu_id);
 //! @param isr Function that will be called to handle the interrupt.
 void register_interrupt_routine(uint32_t irq_id, irq_hdlr_t isr);
 
+//! @brief Set the interrupt service routine and its context for the specified interrupt.
+//!
+//! @param irq_id The interrupt number.
+//! @param handler Function that will be called to handle the interrupt.
+//! @param context Value passed to @a handler.
+void register_interrupt_handler(uint32_t irq_id, irq_context_hdlr_t handler, void * context);
+
+//! @brief Set a routine called whenever the outermost interrupt handler of a CPU returns.
+//!
+//! The routine runs after the end of interrupt has been signaled, with IRQs enabled, so it
+//! can be preempted by any interrupt. It is meant for running deferred work, see
+//! work_queue.h. Pass NULL to remove it.
+void register_irq_exit_routine(irq_hdlr_t routine);
+
+//! @brief Route a shared peripheral interrupt to a set of CPUs.
+//!
+//! The GIC delivers the interrupt to one of the CPUs in @a cpuMask. The targets of private
+//! interrupts and SGIs cannot be changed.
+//!
+//! @param irq_id The interrupt number.
+//! @param cpuMask Bit mask of the CPUs that may handle the interrupt.
+void irq_set_affinity(uint32_t irq_id, uint32_t cpuMask);
+
+//! @brief Returns the CPUs a shared peripheral interrupt is routed to.
+uint32_t irq_get_affinity(uint32_t irq_id);
+
+//! @brief Allow irq_balance() to move an interrupt between CPUs.
+//!
+//! Only handlers that do not assume they run on a particular CPU should be balanced.
+//!
+//! @param irq_id The interrupt number, a shared peripheral interrupt.
+//! @param isBalanced Whether the interrupt may be moved.
+void irq_set_balanced(uint32_t irq_id, bool isBalanced);
+
+//! @brief Spread the balanced interrupts over a set of CPUs.
+//!
+//! The load of each interrupt is the time spent in its handler since the previous call. The
+//! balanced interrupts are assigned from the heaviest to the lightest, each to the CPU that
+//! has the least load so far, counting the interrupts that stay where they are. Every CPU in
+//! @a cpuMask must have its GIC CPU interface enabled and IRQs unmasked.
+//!
+//! @param cpuMask Bit mask of the CPUs to spread the interrupts over.
+//! @return The number of interrupts that were moved to another CPU.
+uint32_t irq_balance(uint32_t cpuMask);
+
+//! @brief Returns how many interrupt handlers are active on the current CPU.
+//!
+//! Zero outside of interrupt context, more than one if handlers are nested.
+uint32_t irq_get_nesting_level(void);
+
+//! @brief Report the latency of the interrupt being handled on the current CPU.
+//!
+//! The interrupt manager cannot tell when a peripheral raised its interrupt. Handlers that
+//! know it, for example from the deadline of a timer or a hardware timestamp, call this to
+//! feed the latency histogram of their interrupt.
+//!
+//! @param latency Time from the event to the handler, in microseconds.
+void irq_record_latency(uint32_t latency);
+
+//! @brief Read the statistics of an interrupt.
+//!
+//! SGIs and private peripheral interrupts are counted separately for each CPU.
+//!
+//! @param irq_id The interrupt number.
+//! @param cpu_id CPU whose statistics to read for interrupts below 32, ignored otherwise.
+//! @param[out] stats Filled in with a copy of the statistics.
+void irq_get_stats(uint32_t irq_id, uint32_t cpu_id, irq_stats_t * stats);
+
+//! @brief Reset the statistics of all interrupts.
+void irq_clear_stats(void);
+
+//! @brief Print the statistics of all interrupts that were taken.
+void irq_print_stats(void);
+
+//! @brief Returns the address of the instruction the current CPU was interrupted at.
+//!
+//! Only meaningful when called from an interrupt service routine. It is used to take
+//! program counter samples from a periodic interrupt.
+uint32_t get_interrupted_pc(void);
+
 //! @brief Interrupt handler that simply prints a message.
 void default_interrupt_routine(void);
 
@@ -70,6 +70,42 @@ typedef enum _mmu_access
     kRWAccess
 } mmu_access_t;
 
+//! @brief Additional mapping options, ORed together in the @a flags parameter.
+enum _mmu_map_flags
+{
+    kExecuteNever = (1 << 0),       //!< Instruction fetches from the region fault.
+    kNoSupersections = (1 << 1)     //!< Never promote the range to 16MB supersections.
+};
+
+//! @brief Page sizes used by the translation tables.
+enum _mmu_page_sizes
+{
+    kMMU_SmallPageSize = 0x00001000,    //!< 4KB small page, second-level table.
+    kMMU_LargePageSize = 0x00010000,    //!< 64KB large page, second-level table.
+    kMMU_SectionSize = 0x00100000,      //!< 1MB section, first-level table.
+    kMMU_SupersectionSize = 0x01000000  //!< 16MB supersection, first-level table.
+};
+
+//! @brief Number of 1KB second-level page tables available for fine-grained mappings.
+//!
+//! Each second-level table covers 1MB of virtual address space with 4KB or 64KB pages. A table
+//! is taken from this pool whenever a section has to be split, and returned to it when the
+//! megabyte is mapped with a section again.
+#if !defined(MMU_L2_PAGE_TABLE_COUNT)
+#define MMU_L2_PAGE_TABLE_COUNT (32)
+#endif
+
+//! @brief Description of the translation for a single virtual address.
+typedef struct _mmu_mapping_info
+{
+    uint32_t pa;                    //!< Physical address the virtual address translates to.
+    uint32_t pageSize;              //!< Size of the page or section holding the address.
+    mmu_memory_type_t memoryType;   //!< Memory type of the page.
+    mmu_shareability_t isShareable; //!< Shareability of the page.
+    mmu_access_t access;            //!< Access permissions of the page.
+    uint32_t flags;                 //!< Set of #_mmu_map_flags values that apply to the page.
+} mmu_mapping_info_t;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Prototypes
 ////////////////////////////////////////////////////////////////////////////////
@@ -101,7 +137,8 @@ void mmu_disable();
  *  - For MX6SL: 0x80000000...0xc0000000 : DDR, normal, outer inner, write-back, write-allocate
  *
  * If the CPU is participating in SMP, then the DDR regions are made shareable. Otherwise they
- * are marked as non-shareable.
+ * are marked as non-shareable. DDR and the peripheral space above 16MB are mapped with 16MB
+ * supersections. All second-level page tables are returned to the pool.
  *
  * The TTBR0 register is set to the base of the L1 table.
  *
@@ -119,6 +156,9 @@ void mmu_init();
  * entries for the range of mapped memory have the same attributes, which are selected with
  * the @a memoryType, @a isShareable, and @a access parameters.
  *
+ * This is equivalent to mmu_map_range() with no flags, so 16MB aligned parts of the range
+ * are mapped with supersections.
+ *
  * @param pa The base physical address of the range to which the virtual address will be mapped.
  * @param va The base virtual address of the range.
  * @param length The size of the range to be mapped, in bytes. This value must be divisible by 1MB.
@@ -129,6 +169,81 @@ void mmu_init();
  */
 void mmu_map_l1_range(uint32_t pa, uint32_t va, uint32_t length, mmu_memory_type_t memoryType, mmu_shareability_t isShareable, mmu_access_t access);
 
+/*!
+ * @brief Maps a range of memory with the largest pages possible.
+ *
+ * The range is broken into 16MB supersections, 1MB sections, 64KB large pages and 4KB small
+ * pages, always picking the largest descriptor for which @a va, @a pa and the remaining length
+ * are suitably aligned. Supersections are only used if @a flags does not contain
+ * #kNoSupersections.
+ *
+ * Mapping part of an existing section or supersection splits it, so the rest of it keeps its
+ * old translation and attributes. Splitting a section takes a second-level table from a pool of
+ * #MMU_L2_PAGE_TABLE_COUNT tables. Mapping a whole megabyte with a section again returns its
+ * table to the pool.
+ *
+ * The TLB entries for the range are invalidated. Cache maintenance for a previous mapping
+ * of the range is the responsibility of the caller; use mmu_set_attributes() to change the
+ * attributes of memory that is already mapped.
+ *
+ * @param pa The base physical address of the range, 4KB aligned.
+ * @param va The base virtual address of the range, 4KB aligned.
+ * @param length The size of the range in bytes, a multiple of 4KB.
+ * @param memoryType The type of the memory region.
+ * @param isShareable The shareability of the physical memory. Ignored for strongly-ordered memory.
+ * @param access Access permissions.
+ * @param flags Set of #_mmu_map_flags values.
+ * @retval true The whole range was mapped.
+ * @retval false An argument is misaligned or the second-level table pool ran out. In the latter
+ *      case the range is only partially mapped.
+ */
+bool mmu_map_range(uint32_t pa, uint32_t va, uint32_t length, mmu_memory_type_t memoryType, mmu_shareability_t isShareable, mmu_access_t access, uint32_t flags);
+
+/*!
+ * @brief Changes the attributes of memory that is already mapped.
+ *
+ * The physical addresses of the range are kept, only the memory type, shareability, access
+ * permissions and flags change. Sections, supersections and large pages that are only partly
+ * covered by the range are split first. Unmapped parts of the range are skipped.
+ *
+ * Each part of the range is cleaned and invalidated from the data caches before its
+ * descriptor changes if it was cacheable, its TLB entries are invalidated, and it is
+ * invalidated from the data caches once more if it is no longer cacheable. This makes it safe to
+ * use on live memory, for instance to make a single descriptor page non-cacheable, to turn
+ * the page below a stack into a guard page with #kNoAccess, or to make code read-only.
+ *
+ * @param va The base virtual address of the range, 4KB aligned.
+ * @param length The size of the range in bytes, a multiple of 4KB.
+ * @param memoryType The new memory type.
+ * @param isShareable The new shareability.
+ * @param access The new access permissions.
+ * @param flags Set of #_mmu_map_flags values. #kNoSupersections is ignored.
+ * @retval true The attributes of the whole range were changed.
+ * @retval false An argument is misaligned or the second-level table pool ran out.
+ */
+bool mmu_set_attributes(uint32_t va, uint32_t length, mmu_memory_type_t memoryType, mmu_shareability_t isShareable, mmu_access_t access, uint32_t flags);
+
+/*!
+ * @brief Reads back the translation for a virtual address from the page tables.
+ *
+ * Unlike mmu_virtual_to_physical() this walks the tables in software, so it works whether or
+ * not the MMU is enabled and also reports the page size and attributes.
+ *
+ * @param va The virtual address to look up.
+ * @param[out] info Filled in with the translation. May be NULL.
+ * @retval true The address is mapped.
+ * @retval false The address is not mapped.
+ */
+bool mmu_get_mapping(uint32_t va, mmu_mapping_info_t * info);
+
+/*!
+ * @brief Prints all mappings in the page tables.
+ *
+ * Adjacent pages of the same size, with the same attributes and contiguous physical
+ * addresses, are printed as one line. Also prints how many second-level tables are in use.
+ */
+void mmu_dump_mappings(void);
+
 /*!
  * @brief Convert virtual address to physical.
  *
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#if !defined(__PL310_H__)
+#define __PL310_H__
+
+#include "sdk_types.h"
+
+//! @addtogroup pl310
+//! @{
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Size in bytes of an L2 cache line.
+#define PL310_LINE_SIZE (32)
+
+//! @brief Events that can be counted by the L2 event counters.
+//!
+//! The names and values are those of the L2C-310 TRM.
+typedef enum _pl310_event {
+    kPL310Event_Disabled = 0,   //!< Counter stopped.
+    kPL310Event_CO = 1,         //!< Eviction (castout) of a line to L3.
+    kPL310Event_DRHIT = 2,      //!< Data read hit.
+    kPL310Event_DRREQ = 3,      //!< Data read lookup.
+    kPL310Event_DWHIT = 4,      //!< Data write hit.
+    kPL310Event_DWREQ = 5,      //!< Data write lookup.
+    kPL310Event_DWTREQ = 6,     //!< Data write lookup with write-through attribute.
+    kPL310Event_IRHIT = 7,      //!< Instruction read hit.
+    kPL310Event_IRREQ = 8,      //!< Instruction read lookup.
+    kPL310Event_WA = 9,         //!< Allocation into L2 due to a write.
+    kPL310Event_IPFALLOC = 10,  //!< Allocation of a prefetch generated by L2.
+    kPL310Event_EPFHIT = 11,    //!< Prefetch hint hit.
+    kPL310Event_EPFALLOC = 12,  //!< Allocation of a prefetch hint.
+    kPL310Event_SRRCVD = 13,    //!< Speculative read received.
+    kPL310Event_SRCONF = 14,    //!< Speculative read confirmed.
+    kPL310Event_EPFRCVD = 15    //!< Prefetch hint received.
+} pl310_event_t;
+
+//! @brief L2 cache controller configuration.
+//!
+//! Latencies are given in cycles, 1 through 8. The values used by pl310_get_default_config()
+//! are the ones validated for the i.MX6 family.
+typedef struct _pl310_config {
+    uint8_t tagSetupLatency;    //!< Tag RAM setup latency.
+    uint8_t tagReadLatency;     //!< Tag RAM read access latency.
+    uint8_t tagWriteLatency;    //!< Tag RAM write access latency.
+    uint8_t dataSetupLatency;   //!< Data RAM setup latency.
+    uint8_t dataReadLatency;    //!< Data RAM read access latency.
+    uint8_t dataWriteLatency;   //!< Data RAM write access latency.
+    bool instrPrefetch;         //!< Prefetch the next lines on instruction fetches.
+    bool dataPrefetch;          //!< Prefetch the next lines on data reads.
+    uint8_t prefetchOffset;     //!< Lines ahead to prefetch, 0 through 31. 7 suits the i.MX6 DDR.
+    bool doubleLinefill;        //!< Issue 64 byte line fills to the DDR controller.
+    bool earlyBRESP;            //!< Return write responses as soon as the L2 accepts a write.
+    bool dynamicClockGating;    //!< Stop the controller clock while idle.
+    bool standby;               //!< Enter standby when the CPUs are in WFI.
+} pl310_config_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @name Initialization
+//@{
+//! @brief Fill in a configuration with the recommended i.MX6 settings.
+void pl310_get_default_config(pl310_config_t * config);
+
+//! @brief Configure the L2 cache controller and invalidate the whole cache.
+//!
+//! Must be called with the L2 disabled, and before pl310_enable(). The same configuration is
+//! reapplied if the L2 is later disabled and enabled again.
+//!
+//! @param config The configuration to apply. Pass NULL to use the defaults.
+void pl310_init(const pl310_config_t * config);
+
+//! @brief Enable the L2 cache.
+//!
+//! Only memory mapped as outer cacheable is cached in the L2, so the MMU must be set up
+//! first. Calls pl310_init() with the defaults if it has not been called yet.
+void pl310_enable(void);
+
+//! @brief Clean and invalidate the whole L2, then disable it.
+//!
+//! The L1 data cache must have been cleaned before calling this, otherwise dirty lines it
+//! evicts afterwards bypass the L2 and may be overwritten by stale L2 data.
+void pl310_disable(void);
+
+//! @brief Returns whether the L2 cache is enabled.
+bool pl310_is_enabled(void);
+
+//! @brief Returns the L2 cache size in bytes.
+uint32_t pl310_get_size(void);
+//@}
+
+//! @name Maintenance by physical address range
+//!
+//! The operations act on every line touched by [pa, pa + length). They wait for the
+//! controller to drain before returning, so a DMA transfer may be started right after.
+//!
+//! These only maintain the L2. The arm_dcache_*_mlines() functions in cortex_a9.h maintain
+//! L1 and L2 in the correct order and should be used by drivers.
+//@{
+//! @brief Write dirty lines in the range back to memory.
+void pl310_clean_range(uint32_t pa, uint32_t length);
+
+//! @brief Discard the lines in the range, dirty or not.
+void pl310_invalidate_range(uint32_t pa, uint32_t length);
+
+//! @brief Write back then discard (flush) the lines in the range.
+void pl310_clean_invalidate_range(uint32_t pa, uint32_t length);
+//@}
+
+//! @name Maintenance by way
+//!
+//! Each bit of @a ways selects one way, pass pl310_all_ways() to act on the whole cache.
+//! Way operations run in the background on the controller; these functions wait for them
+//! to complete. Other maintenance must not be issued by another CPU while they run.
+//@{
+//! @brief Mask with a bit set for every way of the cache.
+uint32_t pl310_all_ways(void);
+
+//! @brief Write all dirty lines of the selected ways back to memory.
+void pl310_clean_ways(uint32_t ways);
+
+//! @brief Discard all lines of the selected ways.
+void pl310_invalidate_ways(uint32_t ways);
+
+//! @brief Write back then discard (flush) all lines of the selected ways.
+void pl310_clean_invalidate_ways(uint32_t ways);
+
+//! @brief Wait for all outstanding L2 operations and buffered writes to complete.
+void pl310_sync(void);
+//@}
+
+//! @name Event counters
+//!
+//! The controller has two 32-bit counters that each count one event.
+//@{
+//! @brief Select the event counted by a counter and start counting.
+//!
+//! @param counter Counter number, 0 or 1.
+//! @param event The event to count.
+void pl310_event_counter_start(unsigned counter, pl310_event_t event);
+
+//! @brief Stop both counters. Their values are kept.
+void pl310_event_counters_stop(void);
+
+//! @brief Reset both counters to zero.
+void pl310_event_counters_reset(void);
+
+//! @brief Read the current value of a counter.
+//!
+//! @param counter Counter number, 0 or 1.
+uint32_t pl310_event_counter_read(unsigned counter);
+//@}
+
+#if defined(__cplusplus)
+}
+#endif
+
+//! @}
+
+#endif // __PL310_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
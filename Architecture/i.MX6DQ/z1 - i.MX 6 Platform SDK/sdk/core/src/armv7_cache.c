@@ -29,12 +29,62 @@
  */
 
 #include "core/cortex_a9.h"
+#include "core/mmu.h"
+#include "core/pl310.h"
 #include "arm_cp_registers.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Code
 ////////////////////////////////////////////////////////////////////////////////
 
+//! @brief Apply an L2 range operation to a virtual address range.
+//!
+//! The L2 cache controller works on physical addresses, so the range is translated one 4KB
+//! page at a time, and physically contiguous pages are passed to the L2 as a single range.
+//! Does nothing when the L2 is disabled.
+static void outer_cache_range(void (*op)(uint32_t pa, uint32_t length), const void * addr, size_t length)
+{
+    uint32_t va = (uint32_t)addr;
+    uint32_t end = va + length;
+    uint32_t run_pa = 0;
+    uint32_t run_length = 0;
+
+    if (!pl310_is_enabled())
+    {
+        return;
+    }
+
+    while (va < end)
+    {
+        uint32_t page_end = (va | 0xfff) + 1;
+        uint32_t chunk = ((page_end != 0 && page_end < end) ? page_end : end) - va;
+        uint32_t pa;
+        bool mapped = mmu_virtual_to_physical(va, &pa);
+
+        // Extend the current run while the pages stay physically contiguous.
+        if (mapped && run_length && pa == run_pa + run_length)
+        {
+            run_length += chunk;
+        }
+        else
+        {
+            if (run_length)
+            {
+                op(run_pa, run_length);
+            }
+            // An unmapped page cannot be cached either, so it is skipped.
+            run_pa = pa;
+            run_length = mapped ? chunk : 0;
+        }
+        va += chunk;
+    }
+
+    if (run_length)
+    {
+        op(run_pa, run_length);
+    }
+}
+
 //! @brief Check if dcache is enabled or disabled
 int arm_dcache_state_query()
 {
@@ -123,6 +173,9 @@ void arm_dcache_invalidate_line(const void * addr)
     uint32_t csidr = 0, line_size = 0;
     uint32_t va;
     
+    // Invalidate the outer cache first so L1 cannot refill from stale L2 lines.
+    outer_cache_range(pl310_invalidate_range, addr, 1);
+
     // get the cache line size
     _ARM_MRC(15, 1, csidr, 0, 0, 0);
     line_size = 1 << ((csidr & 0x7) + 4);    
@@ -147,6 +200,9 @@ void arm_dcache_invalidate_mlines(const void * addr, size_t length)
     // align the address with line
     const void * end_addr = (const void *)((uint32_t)addr + length);
             
+    // Invalidate the outer cache first so L1 cannot refill from stale L2 lines.
+    outer_cache_range(pl310_invalidate_range, addr, length);
+
     do
     {
         // Clean data cache line to PoC (Point of Coherence) by va. 
@@ -186,6 +242,12 @@ void arm_dcache_flush()
     
     // All Cache, Branch predictor and TLB maintenance operations before followed instruction complete
     _ARM_DSB();
+
+    // Then push everything the L1 wrote back out of the L2 as well.
+    if (pl310_is_enabled())
+    {
+        pl310_clean_ways(pl310_all_ways());
+    }
 }
 
 void arm_dcache_flush_line(const void * addr)
@@ -203,12 +265,16 @@ void arm_dcache_flush_line(const void * addr)
     
     // All Cache, Branch predictor and TLB maintenance operations before followed instruction complete
     _ARM_DSB();
+
+    // Then clean the outer cache, which now holds the line.
+    outer_cache_range(pl310_clean_range, addr, 1);
 }
 
 void arm_dcache_flush_mlines(const void * addr, size_t length)
 {
     uint32_t va;
     uint32_t csidr = 0, line_size = 0;
+    const void * start_addr = addr;
     const void * end_addr = (const void *)((uint32_t)addr + length);
 
     // get the cache line size
@@ -227,6 +293,9 @@ void arm_dcache_flush_mlines(const void * addr, size_t length)
     
     // All Cache, Branch predictor and TLB maintenance operations before followed instruction complete
     _ARM_DSB();
+
+    // Then clean the outer cache, which now holds the lines.
+    outer_cache_range(pl310_clean_range, start_addr, length);
 }
 
 int arm_icache_state_query()
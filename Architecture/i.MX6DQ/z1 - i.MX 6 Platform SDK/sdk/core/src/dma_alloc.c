@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file  dma_alloc.c
+ * @brief Coherent and streaming DMA buffer management.
+ */
+
+#include <string.h>
+#include <malloc.h>
+#include "core/dma_alloc.h"
+#include "core/cortex_a9.h"
+#include "core/mmu.h"
+#include "core/pl310.h"
+#include "utility/spinlock.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Allocation unit of the coherent pool, in bytes.
+#define DMA_COHERENT_GRANULE (64)
+
+//! @brief Number of allocation units in the coherent pool.
+#define DMA_COHERENT_GRANULES (DMA_COHERENT_POOL_SIZE / DMA_COHERENT_GRANULE)
+
+//! @brief Size of a 4KB small page, the mapping granularity of the pool.
+#define DMA_PAGE_SIZE (4 * 1024)
+
+//! @brief Alignment of the pool, so that whole 64KB large pages can map it.
+#define DMA_POOL_ALIGNMENT (64 * 1024)
+
+#if (DMA_COHERENT_POOL_SIZE % DMA_PAGE_SIZE) != 0
+#error DMA_COHERENT_POOL_SIZE must be a multiple of 4KB!
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Memory of the coherent pool.
+//!
+//! It starts out as part of the cacheable .bss and is remapped non-cacheable on first use.
+//! Its size is a whole number of pages and it starts on a page boundary, which keeps any other
+//! variable out of the remapped pages.
+static uint8_t s_coherentPool[DMA_COHERENT_POOL_SIZE] __attribute__ ((aligned(DMA_POOL_ALIGNMENT)));
+
+//! @brief One bit per granule, set when the granule is allocated.
+static uint32_t s_usedMap[DMA_COHERENT_GRANULES / 32];
+
+//! @brief One bit per granule, set on the last granule of each allocated block.
+static uint32_t s_lastMap[DMA_COHERENT_GRANULES / 32];
+
+//! @brief Number of free granules.
+static uint32_t s_freeGranules = DMA_COHERENT_GRANULES;
+
+//! @brief Whether the pool has been remapped non-cacheable.
+static bool s_isPoolMapped = false;
+
+//! @brief Protects the maps, the free count and the remapping of the pool.
+//!
+//! Zeroed .bss is the unlocked state, so allocations work before any init code has run.
+static ticket_lock_t s_poolLock;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+static bool dma_pool_lock(void)
+{
+    bool wasEnabled = arm_set_interrupt_state(false);
+    ticket_lock_lock(&s_poolLock);
+    return wasEnabled;
+}
+
+static void dma_pool_unlock(bool wasEnabled)
+{
+    ticket_lock_unlock(&s_poolLock);
+    arm_set_interrupt_state(wasEnabled);
+}
+
+static inline bool bit_test(const uint32_t * map, uint32_t n)
+{
+    return (map[n >> 5] >> (n & 31)) & 1;
+}
+
+static inline void bit_set(uint32_t * map, uint32_t n)
+{
+    map[n >> 5] |= 1u << (n & 31);
+}
+
+static inline void bit_clear(uint32_t * map, uint32_t n)
+{
+    map[n >> 5] &= ~(1u << (n & 31));
+}
+
+//! @brief Returns whether any cache may hold lines of cacheable memory.
+static inline bool dma_caches_active(void)
+{
+    return arm_dcache_state_query() || pl310_is_enabled();
+}
+
+//! @brief Remap the pool non-cacheable.
+//!
+//! Only the pages of the pool change, the rest of the section holding it stays cacheable.
+//! mmu_set_attributes() writes back and discards any lines of the pool that are still in the
+//! caches from while it was cacheable, since a cache hit on memory mapped non-cacheable would
+//! otherwise return stale data.
+static void dma_coherent_map_pool(void)
+{
+    mmu_set_attributes((uint32_t)s_coherentPool, sizeof(s_coherentPool), kNoncacheable, kShareable,
+                       kRWAccess, kExecuteNever);
+
+    s_isPoolMapped = true;
+}
+
+void * dma_alloc_coherent(size_t size, size_t align)
+{
+    uint32_t count = (size + DMA_COHERENT_GRANULE - 1) / DMA_COHERENT_GRANULE;
+    uint32_t step = (align > DMA_COHERENT_GRANULE) ? align / DMA_COHERENT_GRANULE : 1;
+    uint32_t first = 0;
+    uint32_t i;
+    void * block = NULL;
+
+    if (!count)
+    {
+        return NULL;
+    }
+
+    bool wasEnabled = dma_pool_lock();
+
+    if (!s_isPoolMapped)
+    {
+        dma_coherent_map_pool();
+    }
+
+    // First fit. On a collision, resume the search at the next aligned granule past it.
+    while (count <= s_freeGranules && first + count <= DMA_COHERENT_GRANULES)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            if (bit_test(s_usedMap, first + i))
+            {
+                break;
+            }
+        }
+
+        if (i == count)
+        {
+            for (i = 0; i < count; ++i)
+            {
+                bit_set(s_usedMap, first + i);
+            }
+            bit_set(s_lastMap, first + count - 1);
+            s_freeGranules -= count;
+
+            block = &s_coherentPool[first * DMA_COHERENT_GRANULE];
+            break;
+        }
+
+        first = (first + i + step) & ~(step - 1);
+    }
+
+    dma_pool_unlock(wasEnabled);
+
+    // The granules are ours now, clear them outside the lock.
+    if (block)
+    {
+        memset(block, 0, count * DMA_COHERENT_GRANULE);
+    }
+
+    return block;
+}
+
+void dma_free_coherent(void * ptr)
+{
+    uint32_t n;
+
+    if (!ptr)
+    {
+        return;
+    }
+
+    n = ((uint8_t *)ptr - s_coherentPool) / DMA_COHERENT_GRANULE;
+
+    bool wasEnabled = dma_pool_lock();
+
+    while (n < DMA_COHERENT_GRANULES && bit_test(s_usedMap, n))
+    {
+        bool isLast = bit_test(s_lastMap, n);
+
+        bit_clear(s_usedMap, n);
+        bit_clear(s_lastMap, n);
+        ++s_freeGranules;
+        ++n;
+
+        if (isLast)
+        {
+            break;
+        }
+    }
+
+    dma_pool_unlock(wasEnabled);
+}
+
+size_t dma_coherent_get_free(void)
+{
+    return s_freeGranules * DMA_COHERENT_GRANULE;
+}
+
+void * dma_alloc_streaming(size_t size, size_t align)
+{
+    // Round the size up too, so the last line of the buffer holds nothing else.
+    size = (size + DMA_CACHE_LINE_SIZE - 1) & ~(DMA_CACHE_LINE_SIZE - 1);
+
+    if (align < DMA_CACHE_LINE_SIZE)
+    {
+        align = DMA_CACHE_LINE_SIZE;
+    }
+
+    return memalign(align, size);
+}
+
+void dma_free_streaming(void * ptr)
+{
+    free(ptr);
+}
+
+void dma_sync_for_device(const void * ptr, size_t size, dma_direction_t direction)
+{
+    uint32_t start = (uint32_t)ptr & ~(DMA_CACHE_LINE_SIZE - 1);
+    uint32_t end = ((uint32_t)ptr + size + DMA_CACHE_LINE_SIZE - 1) & ~(DMA_CACHE_LINE_SIZE - 1);
+
+    if (!size || !dma_caches_active())
+    {
+        return;
+    }
+
+    if (direction == kDmaFromDevice)
+    {
+        // Partial lines at either end also hold other data, which must reach memory before
+        // the lines are discarded. Writing back the stale buffer bytes with it is harmless,
+        // the device has not started yet.
+        if ((uint32_t)ptr != start)
+        {
+            arm_dcache_flush_line((const void *)start);
+        }
+        if ((uint32_t)ptr + size != end)
+        {
+            arm_dcache_flush_line((const void *)(end - DMA_CACHE_LINE_SIZE));
+        }
+
+        arm_dcache_invalidate_mlines((const void *)start, end - start);
+    }
+    else
+    {
+        arm_dcache_flush_mlines((const void *)start, end - start);
+    }
+}
+
+void dma_sync_for_cpu(const void * ptr, size_t size, dma_direction_t direction)
+{
+    uint32_t start = (uint32_t)ptr & ~(DMA_CACHE_LINE_SIZE - 1);
+    uint32_t end = ((uint32_t)ptr + size + DMA_CACHE_LINE_SIZE - 1) & ~(DMA_CACHE_LINE_SIZE - 1);
+
+    if (!size || direction == kDmaToDevice || !dma_caches_active())
+    {
+        return;
+    }
+
+    arm_dcache_invalidate_mlines((const void *)start, end - start);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
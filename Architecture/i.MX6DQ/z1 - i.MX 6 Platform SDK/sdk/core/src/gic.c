@@ -230,9 +230,10 @@ void gic_init_cpu(void)
     // Init the GIC CPU interface.
     gic_set_cpu_priority_mask(0xff);
 
-    // Disable preemption.
+    // Use all priority bits for preemption, so a handler is preempted by any interrupt of a
+    // higher priority level. The GIC raises the value to the smallest one it supports.
     gicc_t * gicc = gic_get_gicc();
-    gicc->BPR = 7;
+    gicc->BPR = 0;
 
     // Enable signaling the CPU.
     gic_cpu_enable(true);
@@ -34,15 +34,52 @@
  * @ingroup diag_init
  */
 
+#include <stdio.h>
+#include <string.h>
 #include "core/interrupt.h"
 #include "core/gic.h"
+#include "core/cortex_a9.h"
+#include "registers/regsarmglobaltimer.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Number of CPUs the interrupt manager keeps state for.
+#define IRQ_MAX_CPUS (4)
+
+//! @brief SGIs and private peripheral interrupts are below this number.
+#define IRQ_FIRST_SPI (32)
+
+//! @brief Number of shared peripheral interrupts.
+#define IRQ_SPI_COUNT (IMX_INTERRUPT_COUNT - IRQ_FIRST_SPI)
+
+//! @brief Handler and context registered for one interrupt.
+typedef struct _irq_handler_entry
+{
+    irq_context_hdlr_t handler;     //!< Function to call.
+    void * context;                 //!< Argument passed to the handler.
+} irq_handler_entry_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Externs
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Global timer ticks per microsecond, set up by system_time_init().
+extern uint32_t g_microsecondTimerMultiple;
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void irq_dispatch(uint32_t interruptedPC);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Variables
 ////////////////////////////////////////////////////////////////////////////////
 
-//! @brief Array of handler functions assigned to each interrupt.
-irq_hdlr_t g_interrupt_handlers[IMX_INTERRUPT_COUNT];
+//! @brief Handler functions assigned to each interrupt.
+static irq_handler_entry_t s_handlers[IMX_INTERRUPT_COUNT];
 
 //! @brief Current interrupt being handled for each CPU.
 //!
@@ -51,15 +88,73 @@ irq_hdlr_t g_interrupt_handlers[IMX_INTERRUPT_COUNT];
 //!
 //! Being updated during an interrupt, therefore at any time,
 //! that variable shouldn't be used out of this particular context.
-volatile uint32_t g_vectNum[4];
+volatile uint32_t g_vectNum[IRQ_MAX_CPUS];
+
+//! @brief Routine run when the outermost handler returns.
+static volatile irq_hdlr_t s_exitRoutine;
+
+//! @brief Address of the instruction each CPU was interrupted at by its current interrupt.
+static volatile uint32_t s_interruptedPC[IRQ_MAX_CPUS];
+
+//! @brief Number of nested handlers running on each CPU.
+static volatile uint32_t s_nestingLevel[IRQ_MAX_CPUS];
+
+//! @brief Statistics of the banked interrupts, per CPU.
+static irq_stats_t s_bankedStats[IRQ_MAX_CPUS][IRQ_FIRST_SPI];
+
+//! @brief Statistics of the shared peripheral interrupts.
+//!
+//! The GIC makes an interrupt active on a single CPU at a time, so only one CPU updates
+//! an entry at any moment.
+static irq_stats_t s_spiStats[IRQ_SPI_COUNT];
+
+//! @brief CPUs each shared peripheral interrupt is routed to.
+static uint8_t s_affinity[IRQ_SPI_COUNT];
+
+//! @brief Shared peripheral interrupts irq_balance() may move.
+static bool s_isBalanced[IRQ_SPI_COUNT];
+
+//! @brief Handler time of each shared peripheral interrupt at the previous balancing.
+static uint64_t s_balancedTime[IRQ_SPI_COUNT];
+
+//! @brief Handler time of the banked interrupts of each CPU at the previous balancing.
+static uint64_t s_bankedBalancedTime[IRQ_MAX_CPUS];
 
 ////////////////////////////////////////////////////////////////////////////////
 // Code
 ////////////////////////////////////////////////////////////////////////////////
 
-//! @brief Handles IRQ exceptions.
-__attribute__ ((interrupt("IRQ")))
-void IRQ_HDLR(void)
+//! @brief Calls a handler registered with register_interrupt_routine().
+static void irq_call_routine(void * context)
+{
+    ((irq_hdlr_t)context)();
+}
+
+//! @brief Returns the statistics entry of an interrupt for a CPU.
+static inline irq_stats_t * irq_get_stats_entry(uint32_t irq, uint32_t cpu)
+{
+    return irq < IRQ_FIRST_SPI ? &s_bankedStats[cpu][irq] : &s_spiStats[irq - IRQ_FIRST_SPI];
+}
+
+//! @brief Returns the histogram bucket of a time in microseconds.
+static inline uint32_t irq_histogram_bucket(uint32_t time)
+{
+    uint32_t bucket = time ? 32 - __builtin_clz(time) : 0;
+    return bucket < IRQ_HISTOGRAM_BUCKETS ? bucket : IRQ_HISTOGRAM_BUCKETS - 1;
+}
+
+//! @brief Reads the low word of the global timer counter.
+static inline uint32_t irq_read_ticks(void)
+{
+    return HW_ARMGLOBALTIMER_COUNTERn_RD(0);
+}
+
+//! @brief Dispatches an IRQ exception.
+//!
+//! Called by IRQ_HDLR in vectors.S, in supervisor mode with IRQs masked and the interrupted
+//! state saved on the supervisor stack. IRQs are unmasked while the handler runs, so the GIC
+//! can preempt it with any interrupt of a higher priority.
+void irq_dispatch(uint32_t interruptedPC)
 {
     // vectNum = RESERVED[31:13] | CPUID[12:10] | INTERRUPT_ID[9:0] 
     // send ack and get ID source 
@@ -69,33 +164,65 @@ void IRQ_HDLR(void)
     if (vectNum & 0x0200)
     {
         gic_write_end_of_irq(vectNum);  // send end of irq 
+        return;
+    }
+
+    unsigned cpu = cpu_get_current();
+    unsigned irq = vectNum & 0x1FF;
+    irq_stats_t * stats = irq_get_stats_entry(irq, cpu);
+    uint32_t previousVectNum = g_vectNum[cpu];
+    uint32_t previousPC = s_interruptedPC[cpu];
+    
+    // Store the current interrupt number and where it interrupted.
+    g_vectNum[cpu] = irq;
+    s_interruptedPC[cpu] = interruptedPC;
+    if (s_nestingLevel[cpu]++)
+    {
+        ++stats->nested;
+    }
+    
+    uint32_t startTicks = irq_read_ticks();
+    
+    // Call the service routine stored in the handlers array. If there isn't
+    // one for this IRQ, then call the default handler.
+    irq_context_hdlr_t handler = s_handlers[irq].handler;
+    arm_set_interrupt_state(true);
+    if (handler)
+    {
+        handler(s_handlers[irq].context);
     }
     else
     {
-        // copy the local value to the global image of CPUID
-        unsigned cpu = (vectNum >> 10) & 0x7;
-        unsigned irq = vectNum & 0x1FF;
-        
-        // Store the current interrupt number.
-        g_vectNum[cpu] = irq;
-        
-        // Call the service routine stored in the handlers array. If there isn't
-        // one for this IRQ, then call the default handler.
-        irq_hdlr_t isr = g_interrupt_handlers[irq];
-        if (isr)
-        {
-            isr();
-        }
-        else
-        {
-            default_interrupt_routine();
-        }
-        
-        // Clear current interrupt number.
-        g_vectNum[cpu] = 0;
-        
-        // Signal the end of the irq.
-        gic_write_end_of_irq(vectNum);
+        default_interrupt_routine();
+    }
+    arm_set_interrupt_state(false);
+    
+    uint32_t time = (irq_read_ticks() - startTicks) / g_microsecondTimerMultiple;
+    ++stats->count;
+    stats->totalTime += time;
+    if (time > stats->maxTime)
+    {
+        stats->maxTime = time;
+    }
+    ++stats->timeHistogram[irq_histogram_bucket(time)];
+    
+    // Restore the state of the handler that was preempted, if any.
+    --s_nestingLevel[cpu];
+    s_interruptedPC[cpu] = previousPC;
+    g_vectNum[cpu] = previousVectNum;
+    
+    // Signal the end of the irq.
+    gic_write_end_of_irq(vectNum);
+    
+    // Once the outermost handler is done, run deferred work before returning to the
+    // interrupted code. The GIC no longer considers the interrupt active, so any interrupt
+    // can preempt the routine.
+    irq_hdlr_t exitRoutine = s_exitRoutine;
+    if (exitRoutine && s_nestingLevel[cpu] == 0)
+    {
+        arm_set_interrupt_state(true);
+        exitRoutine();
+        arm_set_interrupt_state(false);
     }
 }
 
@@ -103,6 +230,10 @@ void disable_interrupt(uint32_t irq_id, uint32_t cpu_id)
 {
     gic_enable_irq(irq_id, false);
     gic_set_cpu_target(irq_id, cpu_id, false);
+    if (irq_id >= IRQ_FIRST_SPI)
+    {
+        s_affinity[irq_id - IRQ_FIRST_SPI] &= ~(1 << cpu_id);
+    }
 }
 
 void enable_interrupt(uint32_t irq_id, uint32_t cpu_id, uint32_t priority)
@@ -110,20 +241,259 @@ void enable_interrupt(uint32_t irq_id, uint32_t cpu_id, uint32_t priority)
     gic_set_irq_priority(irq_id, priority);
     gic_set_irq_security(irq_id, false);    // set IRQ as non-secure
     gic_set_cpu_target(irq_id, cpu_id, true);
+    if (irq_id >= IRQ_FIRST_SPI)
+    {
+        s_affinity[irq_id - IRQ_FIRST_SPI] |= 1 << cpu_id;
+    }
     gic_enable_irq(irq_id, true);
 }
 
 // set funcISR as the ISR function for the source ID #
 void register_interrupt_routine(uint32_t irq_id, irq_hdlr_t isr)
 {
-    g_interrupt_handlers[irq_id] = isr;
+    if (isr)
+    {
+        register_interrupt_handler(irq_id, irq_call_routine, (void *)isr);
+    }
+    else
+    {
+        register_interrupt_handler(irq_id, NULL, NULL);
+    }
+}
+
+void register_interrupt_handler(uint32_t irq_id, irq_context_hdlr_t handler, void * context)
+{
+    // The dispatcher may run on another CPU, so never let it see a mismatched pair.
+    s_handlers[irq_id].handler = NULL;
+    __asm__ volatile ("dmb" ::: "memory");
+    s_handlers[irq_id].context = context;
+    __asm__ volatile ("dmb" ::: "memory");
+    s_handlers[irq_id].handler = handler;
+}
+
+void register_irq_exit_routine(irq_hdlr_t routine)
+{
+    s_exitRoutine = routine;
+}
+
+void irq_set_affinity(uint32_t irq_id, uint32_t cpuMask)
+{
+    if (irq_id < IRQ_FIRST_SPI)
+    {
+        return;
+    }
+
+    uint32_t cpu;
+    for (cpu = 0; cpu < IRQ_MAX_CPUS; ++cpu)
+    {
+        gic_set_cpu_target(irq_id, cpu, (cpuMask >> cpu) & 1);
+    }
+    s_affinity[irq_id - IRQ_FIRST_SPI] = cpuMask;
+}
+
+uint32_t irq_get_affinity(uint32_t irq_id)
+{
+    return irq_id < IRQ_FIRST_SPI ? 0 : s_affinity[irq_id - IRQ_FIRST_SPI];
+}
+
+void irq_set_balanced(uint32_t irq_id, bool isBalanced)
+{
+    if (irq_id >= IRQ_FIRST_SPI)
+    {
+        s_isBalanced[irq_id - IRQ_FIRST_SPI] = isBalanced;
+        s_balancedTime[irq_id - IRQ_FIRST_SPI] = s_spiStats[irq_id - IRQ_FIRST_SPI].totalTime;
+    }
+}
+
+uint32_t irq_balance(uint32_t cpuMask)
+{
+    uint64_t cpuLoad[IRQ_MAX_CPUS];
+    uint64_t irqLoad[IRQ_SPI_COUNT];
+    uint8_t order[IRQ_SPI_COUNT];
+    uint32_t balancedCount = 0;
+    uint32_t moved = 0;
+    uint32_t i;
+    uint32_t cpu;
+
+    cpuMask &= (1 << IRQ_MAX_CPUS) - 1;
+    if (!cpuMask)
+    {
+        return 0;
+    }
+
+    // Private interrupts are fixed to their CPU.
+    for (cpu = 0; cpu < IRQ_MAX_CPUS; ++cpu)
+    {
+        uint64_t total = 0;
+        for (i = 0; i < IRQ_FIRST_SPI; ++i)
+        {
+            total += s_bankedStats[cpu][i].totalTime;
+        }
+        cpuLoad[cpu] = total - s_bankedBalancedTime[cpu];
+        s_bankedBalancedTime[cpu] = total;
+    }
+
+    // Shared interrupts that are not balanced count towards the first CPU they go to. The
+    // balanced ones are sorted by decreasing load since the previous balancing.
+    for (i = 0; i < IRQ_SPI_COUNT; ++i)
+    {
+        uint64_t total = s_spiStats[i].totalTime;
+        uint64_t load = total - s_balancedTime[i];
+        s_balancedTime[i] = total;
+
+        if (!s_isBalanced[i])
+        {
+            if (s_affinity[i])
+            {
+                cpuLoad[__builtin_ctz(s_affinity[i])] += load;
+            }
+            continue;
+        }
+
+        uint32_t position = balancedCount++;
+        while (position > 0 && irqLoad[order[position - 1]] < load)
+        {
+            order[position] = order[position - 1];
+            --position;
+        }
+        order[position] = i;
+        irqLoad[i] = load;
+    }
+
+    // Greedily place each balanced interrupt on the least loaded CPU.
+    for (i = 0; i < balancedCount; ++i)
+    {
+        uint32_t spi = order[i];
+        uint32_t best = IRQ_MAX_CPUS;
+        for (cpu = 0; cpu < IRQ_MAX_CPUS; ++cpu)
+        {
+            if (((cpuMask >> cpu) & 1) && (best == IRQ_MAX_CPUS || cpuLoad[cpu] < cpuLoad[best]))
+            {
+                best = cpu;
+            }
+        }
+
+        cpuLoad[best] += irqLoad[spi];
+        if (s_affinity[spi] != (1 << best))
+        {
+            irq_set_affinity(spi + IRQ_FIRST_SPI, 1 << best);
+            ++moved;
+        }
+    }
+
+    return moved;
+}
+
+uint32_t irq_get_nesting_level(void)
+{
+    return s_nestingLevel[cpu_get_current()];
+}
+
+void irq_record_latency(uint32_t latency)
+{
+    bool wasEnabled = arm_set_interrupt_state(false);
+    uint32_t cpu = cpu_get_current();
+
+    if (s_nestingLevel[cpu])
+    {
+        irq_stats_t * stats = irq_get_stats_entry(g_vectNum[cpu], cpu);
+        ++stats->latencyCount;
+        if (latency > stats->maxLatency)
+        {
+            stats->maxLatency = latency;
+        }
+        ++stats->latencyHistogram[irq_histogram_bucket(latency)];
+    }
+
+    arm_set_interrupt_state(wasEnabled);
+}
+
+void irq_get_stats(uint32_t irq_id, uint32_t cpu_id, irq_stats_t * stats)
+{
+    bool wasEnabled = arm_set_interrupt_state(false);
+    *stats = *irq_get_stats_entry(irq_id, cpu_id);
+    arm_set_interrupt_state(wasEnabled);
+}
+
+void irq_clear_stats(void)
+{
+    bool wasEnabled = arm_set_interrupt_state(false);
+    memset(s_bankedStats, 0, sizeof(s_bankedStats));
+    memset(s_spiStats, 0, sizeof(s_spiStats));
+    memset(s_balancedTime, 0, sizeof(s_balancedTime));
+    memset(s_bankedBalancedTime, 0, sizeof(s_bankedBalancedTime));
+    arm_set_interrupt_state(wasEnabled);
+}
+
+//! @brief Prints one line of statistics and the non-empty part of a histogram.
+static void irq_print_stats_entry(uint32_t irq, int cpu, const irq_stats_t * stats)
+{
+    uint32_t i;
+
+    if (cpu < 0)
+    {
+        printf("%4d     ", irq);
+    }
+    else
+    {
+        printf("%4d/%d   ", irq, cpu);
+    }
+    printf("%10d %8d %8d %8d %8d  ", stats->count, stats->nested,
+           (uint32_t)(stats->totalTime / stats->count), stats->maxTime, stats->maxLatency);
+    for (i = 0; i < IRQ_HISTOGRAM_BUCKETS; ++i)
+    {
+        printf(" %d", stats->timeHistogram[i]);
+    }
+    printf("\n");
+
+    if (stats->latencyCount)
+    {
+        printf("         latency histogram:");
+        for (i = 0; i < IRQ_HISTOGRAM_BUCKETS; ++i)
+        {
+            printf(" %d", stats->latencyHistogram[i]);
+        }
+        printf("\n");
+    }
+}
+
+void irq_print_stats(void)
+{
+    irq_stats_t stats;
+    uint32_t irq;
+    uint32_t cpu;
+
+    printf(" irq      count   nested  avg(us)  max(us) maxlat(us)  run time histogram (<1, <2, <4, ... us)\n");
+    for (irq = 0; irq < IRQ_FIRST_SPI; ++irq)
+    {
+        for (cpu = 0; cpu < IRQ_MAX_CPUS; ++cpu)
+        {
+            irq_get_stats(irq, cpu, &stats);
+            if (stats.count)
+            {
+                irq_print_stats_entry(irq, cpu, &stats);
+            }
+        }
+    }
+    for (irq = IRQ_FIRST_SPI; irq < IMX_INTERRUPT_COUNT; ++irq)
+    {
+        irq_get_stats(irq, 0, &stats);
+        if (stats.count)
+        {
+            irq_print_stats_entry(irq, -1, &stats);
+        }
+    }
+}
+
+uint32_t get_interrupted_pc(void)
+{
+    return s_interruptedPC[cpu_get_current()];
 }
 
 void default_interrupt_routine(void)
 {
-    // find a way to address an IRQ handled by another CPU. Assumes
-    // here that CPU_0 is used.
-    printf("Interrupt %d has been asserted\n", g_vectNum[0]);
+    unsigned cpu = cpu_get_current();
+    printf("Interrupt %d has been asserted on CPU %d\n", g_vectNum[cpu], cpu);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -43,7 +43,16 @@
 //! @brief Size in bytes of the first-level page table.
 #define MMU_L1_PAGE_TABLE_SIZE (16 * 1024)
 
-//! @brief First-level 1MB section descriptor entry.
+//! @brief Size in bytes of a second-level page table.
+#define MMU_L2_PAGE_TABLE_SIZE (1024)
+
+//! @brief Size of an L1 data cache line, used when cleaning second-level table entries.
+#define MMU_CACHE_LINE_SIZE (32)
+
+//! @brief First-level 1MB section or 16MB supersection descriptor entry.
+//!
+//! For a supersection the low four bits of @a address and the @a domain field hold extended
+//! physical address bits, which are always zero here.
 typedef union mmu_l1_section {
     uint32_t u;
     struct {
@@ -58,27 +67,726 @@ typedef union mmu_l1_section {
         uint32_t ap2:1; //!< Access permissions AP[2] 
         uint32_t s:1;   //!< Shareable
         uint32_t ng:1;  //!< Not-global
-        uint32_t _zero:1;   //!< Should be zero.
+        uint32_t supersection:1;   //!< Set for a 16MB supersection.
         uint32_t ns:1;  //!< Non-secure
         uint32_t address:12;   //!< Physical base address
     };
 } mmu_l1_section_t;
 
+//! @brief First-level descriptor entry pointing to a second-level page table.
+typedef union mmu_l1_page_table {
+    uint32_t u;
+    struct {
+        uint32_t id:2;  //!< ID
+        uint32_t pxn:1; //!< Privileged execute-never, should be zero.
+        uint32_t ns:1;  //!< Non-secure
+        uint32_t _zero:1;   //!< Should be zero.
+        uint32_t domain:4;  //!< Domain
+        uint32_t _impl_defined:1;   //!< Implementation defined, should be zero.
+        uint32_t address:22;   //!< Physical base address of the second-level table
+    };
+} mmu_l1_page_table_t;
+
+//! @brief Second-level 64KB large page descriptor entry.
+typedef union mmu_l2_large_page {
+    uint32_t u;
+    struct {
+        uint32_t id:2;  //!< ID
+        uint32_t b:1;   //!< Bufferable
+        uint32_t c:1;   //!< Cacheable
+        uint32_t ap1_0:2;  //!< Access permissions AP[1:0]
+        uint32_t _zero:3;   //!< Should be zero.
+        uint32_t ap2:1; //!< Access permissions AP[2]
+        uint32_t s:1;   //!< Shareable
+        uint32_t ng:1;  //!< Not-global
+        uint32_t tex:3; //!< TEX remap
+        uint32_t xn:1;  //!< Execute-not
+        uint32_t address:16;   //!< Physical base address
+    };
+} mmu_l2_large_page_t;
+
+//! @brief Second-level 4KB small page descriptor entry.
+typedef union mmu_l2_small_page {
+    uint32_t u;
+    struct {
+        uint32_t xn:1;  //!< Execute-not
+        uint32_t id:1;  //!< ID
+        uint32_t b:1;   //!< Bufferable
+        uint32_t c:1;   //!< Cacheable
+        uint32_t ap1_0:2;  //!< Access permissions AP[1:0]
+        uint32_t tex:3; //!< TEX remap
+        uint32_t ap2:1; //!< Access permissions AP[2]
+        uint32_t s:1;   //!< Shareable
+        uint32_t ng:1;  //!< Not-global
+        uint32_t address:20;   //!< Physical base address
+    };
+} mmu_l2_small_page_t;
+
 enum {
+    kMMU_L1_Fault_ID = 0,       //!< ID value for an invalid first-level entry.
+    kMMU_L1_PageTable_ID = 1,   //!< ID value for a first-level entry pointing to a second-level table.
     kMMU_L1_Section_ID = 2,  //!< ID value for a 1MB section first-level entry.
-    kMMU_L1_Section_Address_Shift = 20  //!< Bit offset of the physical base address field.
+    kMMU_L1_Section_Address_Shift = 20,  //!< Bit offset of the physical base address field.
+    kMMU_L1_PageTable_Address_Shift = 10,   //!< Bit offset of the second-level table address field.
+    kMMU_L2_LargePage_ID = 1,   //!< ID value for a 64KB large page second-level entry.
+    kMMU_L2_SmallPage_ID = 1,   //!< ID bit value for a 4KB small page second-level entry.
+    kMMU_L2_LargePage_Address_Shift = 16,   //!< Bit offset of the large page base address field.
+    kMMU_L2_SmallPage_Address_Shift = 12,   //!< Bit offset of the small page base address field.
+    kMMU_L2_Entry_Count = MMU_L2_PAGE_TABLE_SIZE / sizeof(uint32_t), //!< Entries per second-level table.
+    kMMU_Replicated_Entries = 16    //!< Number of identical entries for a supersection or large page.
 };
 
+//! @brief Memory attributes shared by all of the descriptor formats.
+typedef struct mmu_attributes {
+    uint32_t tex;   //!< TEX remap
+    uint32_t c;     //!< Cacheable
+    uint32_t b;     //!< Bufferable
+    uint32_t s;     //!< Shareable
+    uint32_t ap2;   //!< Access permissions AP[2]
+    uint32_t ap1_0; //!< Access permissions AP[1:0]
+    uint32_t xn;    //!< Execute-not
+} mmu_attributes_t;
+
+//! @brief The descriptor that translates a virtual address.
+typedef struct mmu_descriptor {
+    uint32_t * entry;   //!< First table entry of the descriptor.
+    uint32_t size;      //!< Size of the page or section.
+    uint32_t pa;        //!< Physical address the virtual address translates to.
+    mmu_attributes_t attr;  //!< Attributes of the page or section.
+} mmu_descriptor_t;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Externs
 ////////////////////////////////////////////////////////////////////////////////
 
 extern char __l1_page_table_start;
 
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Pool of second-level page tables.
+//!
+//! The tables live in cacheable memory while the translation table walks are non-cacheable,
+//! so every entry written to them is cleaned to memory before it can be used. Memory is
+//! identity mapped, so the address of a table is also the physical address given to the
+//! first-level entry that points to it.
+static uint32_t s_l2PageTables[MMU_L2_PAGE_TABLE_COUNT][kMMU_L2_Entry_Count] __attribute__ ((aligned(MMU_L2_PAGE_TABLE_SIZE)));
+
+//! @brief Whether each of the second-level page tables is in use.
+static bool s_isL2PageTableUsed[MMU_L2_PAGE_TABLE_COUNT];
+
 ////////////////////////////////////////////////////////////////////////////////
 // Code
 ////////////////////////////////////////////////////////////////////////////////
 
+//! @brief Returns the first-level page table.
+static inline uint32_t * mmu_l1_table(void)
+{
+    return (uint32_t *)&__l1_page_table_start;
+}
+
+//! @brief Returns whether this CPU takes part in SMP coherency.
+static bool mmu_is_smp(void)
+{
+    uint32_t actlr = 0x0;
+    _ARM_MRC(15, 0, actlr, 1, 0, 1);
+    return (actlr & BM_ACTLR_SMP) != 0;
+}
+
+//! @brief Invalidate the TLB entries that translate one virtual address.
+//!
+//! Global entries are invalidated whatever their ASID. On an SMP system the operation is
+//! broadcast to the other cores in the inner shareable domain.
+static void mmu_tlb_invalidate_mva(uint32_t va, bool isSMP)
+{
+    va &= 0xfffff000;
+    if (isSMP)
+    {
+        _ARM_MCR(15, 0, va, 8, 3, 1); // TLBIMVAIS
+    }
+    else
+    {
+        _ARM_MCR(15, 0, va, 8, 7, 1); // TLBIMVA
+    }
+}
+
+//! @brief Converts the public memory type, shareability, and access to descriptor attributes.
+static void mmu_encode_attributes(mmu_attributes_t * attr, mmu_memory_type_t memoryType, mmu_shareability_t isShareable, mmu_access_t access, uint32_t flags)
+{
+    attr->xn = (flags & kExecuteNever) ? 1 : 0;
+    
+    // Set attributes based on the selected memory type.
+    switch (memoryType)
+    {
+        case kStronglyOrdered:
+            attr->c = 0;
+            attr->b = 0;
+            attr->tex = 0;
+            attr->s = 1; // Ignored
+            break;
+        case kDevice:
+            if (isShareable)
+            {
+                attr->c = 0;
+                attr->b = 1;
+                attr->tex = 0;
+                attr->s = 1; // Ignored
+            }
+            else
+            {
+                attr->c = 0;
+                attr->b = 0;
+                attr->tex = 2;
+                attr->s = 0; // Ignored
+            }
+            break;
+        case kOuterInner_WB_WA:
+            attr->c = 1;
+            attr->b = 1;
+            attr->tex = 1;
+            attr->s = isShareable;
+            break;
+        case kOuterInner_WT:
+            attr->c = 1;
+            attr->b = 0;
+            attr->tex = 0;
+            attr->s = isShareable;
+            break;
+        case kNoncacheable:
+            attr->c = 0;
+            attr->b = 0;
+            attr->tex = 1;
+            attr->s = isShareable;
+            break;
+    }
+    
+    // Set attributes from specified access mode.
+    switch (access)
+    {
+        case kNoAccess:
+            attr->ap2 = 0;
+            attr->ap1_0 = 0;
+            break;
+        case kROAccess:
+            attr->ap2 = 1;
+            attr->ap1_0 = 3;
+            break;
+        case kRWAccess:
+            attr->ap2 = 0;
+            attr->ap1_0 = 3;
+            break;
+    }
+}
+
+//! @brief Converts descriptor attributes back to the public memory type, shareability, and access.
+static void mmu_decode_attributes(const mmu_attributes_t * attr, mmu_mapping_info_t * info)
+{
+    info->isShareable = attr->s ? kShareable : kNonshareable;
+    
+    if (attr->tex == 1 && attr->c && attr->b)
+    {
+        info->memoryType = kOuterInner_WB_WA;
+    }
+    else if (attr->tex == 0 && attr->c && !attr->b)
+    {
+        info->memoryType = kOuterInner_WT;
+    }
+    else if (attr->tex == 1 && !attr->c && !attr->b)
+    {
+        info->memoryType = kNoncacheable;
+    }
+    else if ((attr->tex == 0 && !attr->c && attr->b) || (attr->tex == 2 && !attr->c && !attr->b))
+    {
+        info->memoryType = kDevice;
+    }
+    else
+    {
+        // Any other encoding is never written by this driver.
+        info->memoryType = kStronglyOrdered;
+    }
+    
+    if (attr->ap1_0 == 0)
+    {
+        info->access = kNoAccess;
+    }
+    else if (attr->ap2)
+    {
+        info->access = kROAccess;
+    }
+    else
+    {
+        info->access = kRWAccess;
+    }
+    
+    info->flags = attr->xn ? kExecuteNever : 0;
+}
+
+//! @brief Returns whether the attributes allow memory to be held in the data caches.
+static inline bool mmu_is_cacheable(const mmu_attributes_t * attr)
+{
+    return attr->c || (attr->tex & 4);
+}
+
+//! @brief Builds a section or supersection descriptor.
+static uint32_t mmu_make_section(uint32_t pa, const mmu_attributes_t * attr, bool isSupersection)
+{
+    mmu_l1_section_t entry;
+    entry.u = 0;
+    
+    entry.id = kMMU_L1_Section_ID;
+    entry.domain = 0; // Domain 0
+    entry.ng = 0; // Global
+    entry.ns = 0; // Secure
+    entry.supersection = isSupersection;
+    entry.tex = attr->tex;
+    entry.c = attr->c;
+    entry.b = attr->b;
+    entry.s = attr->s;
+    entry.ap2 = attr->ap2;
+    entry.ap1_0 = attr->ap1_0;
+    entry.xn = attr->xn;
+    entry.address = pa >> kMMU_L1_Section_Address_Shift;
+    
+    return entry.u;
+}
+
+//! @brief Builds a large page descriptor.
+static uint32_t mmu_make_large_page(uint32_t pa, const mmu_attributes_t * attr)
+{
+    mmu_l2_large_page_t entry;
+    entry.u = 0;
+    
+    entry.id = kMMU_L2_LargePage_ID;
+    entry.ng = 0; // Global
+    entry.tex = attr->tex;
+    entry.c = attr->c;
+    entry.b = attr->b;
+    entry.s = attr->s;
+    entry.ap2 = attr->ap2;
+    entry.ap1_0 = attr->ap1_0;
+    entry.xn = attr->xn;
+    entry.address = pa >> kMMU_L2_LargePage_Address_Shift;
+    
+    return entry.u;
+}
+
+//! @brief Builds a small page descriptor.
+static uint32_t mmu_make_small_page(uint32_t pa, const mmu_attributes_t * attr)
+{
+    mmu_l2_small_page_t entry;
+    entry.u = 0;
+    
+    entry.id = kMMU_L2_SmallPage_ID;
+    entry.ng = 0; // Global
+    entry.tex = attr->tex;
+    entry.c = attr->c;
+    entry.b = attr->b;
+    entry.s = attr->s;
+    entry.ap2 = attr->ap2;
+    entry.ap1_0 = attr->ap1_0;
+    entry.xn = attr->xn;
+    entry.address = pa >> kMMU_L2_SmallPage_Address_Shift;
+    
+    return entry.u;
+}
+
+//! @brief Returns the second-level table a first-level page table entry points to.
+static inline uint32_t * mmu_l2_table_from_entry(uint32_t entry)
+{
+    return (uint32_t *)(entry & ~(MMU_L2_PAGE_TABLE_SIZE - 1));
+}
+
+//! @brief Finds the descriptor translating a virtual address.
+//! @return Whether the address is mapped.
+static bool mmu_lookup(uint32_t va, mmu_descriptor_t * desc)
+{
+    uint32_t * table = mmu_l1_table();
+    uint32_t index = va >> kMMU_L1_Section_Address_Shift;
+    uint32_t entry = table[index];
+    
+    if ((entry & 3) == kMMU_L1_Section_ID)
+    {
+        mmu_l1_section_t section;
+        section.u = entry;
+        
+        if (section.supersection)
+        {
+            desc->entry = &table[index & ~(kMMU_Replicated_Entries - 1)];
+            desc->size = kMMU_SupersectionSize;
+            section.address &= ~(kMMU_Replicated_Entries - 1);
+        }
+        else
+        {
+            desc->entry = &table[index];
+            desc->size = kMMU_SectionSize;
+        }
+        
+        desc->pa = (section.address << kMMU_L1_Section_Address_Shift) | (va & (desc->size - 1));
+        desc->attr.tex = section.tex;
+        desc->attr.c = section.c;
+        desc->attr.b = section.b;
+        desc->attr.s = section.s;
+        desc->attr.ap2 = section.ap2;
+        desc->attr.ap1_0 = section.ap1_0;
+        desc->attr.xn = section.xn;
+        return true;
+    }
+    else if ((entry & 3) == kMMU_L1_PageTable_ID)
+    {
+        uint32_t * l2 = mmu_l2_table_from_entry(entry);
+        uint32_t l2Index = (va >> kMMU_L2_SmallPage_Address_Shift) & (kMMU_L2_Entry_Count - 1);
+        entry = l2[l2Index];
+        
+        if ((entry & 3) == kMMU_L2_LargePage_ID)
+        {
+            mmu_l2_large_page_t large;
+            large.u = entry;
+            
+            desc->entry = &l2[l2Index & ~(kMMU_Replicated_Entries - 1)];
+            desc->size = kMMU_LargePageSize;
+            desc->pa = (large.address << kMMU_L2_LargePage_Address_Shift) | (va & (kMMU_LargePageSize - 1));
+            desc->attr.tex = large.tex;
+            desc->attr.c = large.c;
+            desc->attr.b = large.b;
+            desc->attr.s = large.s;
+            desc->attr.ap2 = large.ap2;
+            desc->attr.ap1_0 = large.ap1_0;
+            desc->attr.xn = large.xn;
+            return true;
+        }
+        else if (entry & 2)
+        {
+            mmu_l2_small_page_t small;
+            small.u = entry;
+            
+            desc->entry = &l2[l2Index];
+            desc->size = kMMU_SmallPageSize;
+            desc->pa = (small.address << kMMU_L2_SmallPage_Address_Shift) | (va & (kMMU_SmallPageSize - 1));
+            desc->attr.tex = small.tex;
+            desc->attr.c = small.c;
+            desc->attr.b = small.b;
+            desc->attr.s = small.s;
+            desc->attr.ap2 = small.ap2;
+            desc->attr.ap1_0 = small.ap1_0;
+            desc->attr.xn = small.xn;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+//! @brief Write second-level entries back to memory, where the table walk reads them.
+static void mmu_clean_l2_entries(uint32_t * entry, uint32_t count)
+{
+    uint32_t start = (uint32_t)entry & ~(MMU_CACHE_LINE_SIZE - 1);
+    uint32_t end = (uint32_t)(entry + count);
+    
+    arm_dcache_flush_mlines((const void *)start, end - start);
+}
+
+//! @brief Return the second-level table a first-level entry points to back to the pool.
+static void mmu_free_l2_table(uint32_t entry)
+{
+    uint32_t * l2 = mmu_l2_table_from_entry(entry);
+    uint32_t index = (l2 - &s_l2PageTables[0][0]) / kMMU_L2_Entry_Count;
+    
+    if (index < MMU_L2_PAGE_TABLE_COUNT)
+    {
+        s_isL2PageTableUsed[index] = false;
+    }
+}
+
+//! @brief Replace the supersection covering an address with 16 equivalent sections.
+static void mmu_split_supersection(uint32_t va)
+{
+    uint32_t * entries = &mmu_l1_table()[(va >> kMMU_L1_Section_Address_Shift) & ~(kMMU_Replicated_Entries - 1)];
+    mmu_l1_section_t section;
+    section.u = entries[0];
+    
+    if (section.id != kMMU_L1_Section_ID || !section.supersection)
+    {
+        return;
+    }
+    
+    uint32_t base = section.address & ~(kMMU_Replicated_Entries - 1);
+    uint32_t i;
+    
+    section.supersection = 0;
+    for (i = 0; i < kMMU_Replicated_Entries; ++i)
+    {
+        section.address = base + i;
+        entries[i] = section.u;
+    }
+}
+
+//! @brief Replace the large page covering an entry of a second-level table with 16 equivalent small pages.
+static void mmu_split_large_page(uint32_t * l2, uint32_t index)
+{
+    uint32_t * entries = &l2[index & ~(kMMU_Replicated_Entries - 1)];
+    mmu_l2_large_page_t large;
+    large.u = entries[0];
+    
+    if ((large.u & 3) != kMMU_L2_LargePage_ID)
+    {
+        return;
+    }
+    
+    mmu_attributes_t attr;
+    attr.tex = large.tex;
+    attr.c = large.c;
+    attr.b = large.b;
+    attr.s = large.s;
+    attr.ap2 = large.ap2;
+    attr.ap1_0 = large.ap1_0;
+    attr.xn = large.xn;
+    
+    uint32_t pa = large.address << kMMU_L2_LargePage_Address_Shift;
+    uint32_t i;
+    for (i = 0; i < kMMU_Replicated_Entries; ++i, pa += kMMU_SmallPageSize)
+    {
+        entries[i] = mmu_make_small_page(pa, &attr);
+    }
+}
+
+//! @brief Returns the second-level table for the megabyte holding an address, creating it if needed.
+//!
+//! A section or supersection already mapping the megabyte is split. The new table reproduces
+//! the section with 64KB large pages, so the translation does not change and no TLB
+//! maintenance is needed for the part of the megabyte that is not remapped afterwards.
+//!
+//! @return The table, or NULL if the pool is exhausted.
+static uint32_t * mmu_get_l2_table(uint32_t va)
+{
+    uint32_t * l1 = &mmu_l1_table()[va >> kMMU_L1_Section_Address_Shift];
+    uint32_t * l2 = NULL;
+    uint32_t i;
+    
+    if ((*l1 & 3) == kMMU_L1_PageTable_ID)
+    {
+        return mmu_l2_table_from_entry(*l1);
+    }
+    
+    for (i = 0; i < MMU_L2_PAGE_TABLE_COUNT; ++i)
+    {
+        if (!s_isL2PageTableUsed[i])
+        {
+            s_isL2PageTableUsed[i] = true;
+            l2 = s_l2PageTables[i];
+            break;
+        }
+    }
+    
+    if (!l2)
+    {
+        return NULL;
+    }
+    
+    mmu_descriptor_t section;
+    if ((*l1 & 3) == kMMU_L1_Section_ID && mmu_lookup(va & ~(kMMU_SectionSize - 1), &section))
+    {
+        mmu_split_supersection(va);
+        
+        for (i = 0; i < kMMU_L2_Entry_Count; ++i)
+        {
+            l2[i] = mmu_make_large_page(section.pa + ((i / kMMU_Replicated_Entries) * kMMU_LargePageSize), &section.attr);
+        }
+    }
+    else
+    {
+        bzero(l2, MMU_L2_PAGE_TABLE_SIZE);
+    }
+    
+    mmu_clean_l2_entries(l2, kMMU_L2_Entry_Count);
+    
+    mmu_l1_page_table_t entry;
+    entry.u = 0;
+    entry.id = kMMU_L1_PageTable_ID;
+    entry.domain = 0; // Domain 0
+    entry.address = (uint32_t)l2 >> kMMU_L1_PageTable_Address_Shift;
+    *l1 = entry.u;
+    
+    return l2;
+}
+
+//! @brief Returns the largest page size usable at the current position of a range.
+static uint32_t mmu_best_page_size(uint32_t pa, uint32_t va, uint32_t length, uint32_t flags)
+{
+    uint32_t addresses = pa | va;
+    
+    if (!(flags & kNoSupersections) && !(addresses & (kMMU_SupersectionSize - 1)) && length >= kMMU_SupersectionSize)
+    {
+        return kMMU_SupersectionSize;
+    }
+    else if (!(addresses & (kMMU_SectionSize - 1)) && length >= kMMU_SectionSize)
+    {
+        return kMMU_SectionSize;
+    }
+    else if (!(addresses & (kMMU_LargePageSize - 1)) && length >= kMMU_LargePageSize)
+    {
+        return kMMU_LargePageSize;
+    }
+    
+    return kMMU_SmallPageSize;
+}
+
+//! @brief Rewrites the descriptors for a range of virtual addresses.
+//!
+//! Each step writes one descriptor of the largest possible size, splitting any coarser
+//! descriptor that is only partly rewritten, and then invalidates the TLB entries for the
+//! part of the range it covered. When @a keepAddress is set the range keeps its current
+//! physical addresses, unmapped parts are skipped, and the data caches are maintained around
+//! any change from cacheable memory.
+static bool mmu_update_range(uint32_t pa, uint32_t va, uint32_t length, const mmu_attributes_t * attr, uint32_t flags, bool keepAddress)
+{
+    uint32_t * table = mmu_l1_table();
+    bool isSMP = mmu_is_smp();
+    bool isTableReleased = false;
+    bool result = true;
+    
+    while (length)
+    {
+        mmu_descriptor_t old;
+        bool isMapped = mmu_lookup(va, &old);
+        uint32_t size;
+        uint32_t step;
+        uint32_t offset;
+        
+        if (keepAddress)
+        {
+            if (!isMapped)
+            {
+                // Skip to the next page, or the next megabyte if the whole megabyte is unmapped.
+                step = ((table[va >> kMMU_L1_Section_Address_Shift] & 3) == kMMU_L1_PageTable_ID) ? kMMU_SmallPageSize : kMMU_SectionSize - (va & (kMMU_SectionSize - 1));
+                step = (step < length) ? step : length;
+                va += step;
+                length -= step;
+                continue;
+            }
+            
+            // Never rewrite more than the old descriptor, the physical addresses of the
+            // descriptors that follow it need not be contiguous.
+            pa = old.pa;
+            size = mmu_best_page_size(pa, va, length, flags);
+            size = (size < old.size) ? size : old.size;
+        }
+        else
+        {
+            size = mmu_best_page_size(pa, va, length, flags);
+        }
+        
+        bool wasCached = keepAddress && mmu_is_cacheable(&old.attr) && old.attr.ap1_0 != 0;
+        if (wasCached)
+        {
+            arm_dcache_flush_mlines((const void *)va, size);
+            arm_dcache_invalidate_mlines((const void *)va, size);
+        }
+        
+        if (size >= kMMU_SectionSize)
+        {
+            uint32_t * l1 = &table[va >> kMMU_L1_Section_Address_Shift];
+            uint32_t count = size >> kMMU_L1_Section_Address_Shift;
+            uint32_t entry = mmu_make_section(pa, attr, size == kMMU_SupersectionSize);
+            uint32_t i;
+            
+            if (size == kMMU_SectionSize)
+            {
+                mmu_split_supersection(va);
+            }
+            
+            for (i = 0; i < count; ++i)
+            {
+                if ((l1[i] & 3) == kMMU_L1_PageTable_ID)
+                {
+                    mmu_free_l2_table(l1[i]);
+                    isTableReleased = true;
+                }
+                
+                // All 16 entries of a supersection are identical.
+                l1[i] = entry;
+            }
+            
+            step = kMMU_SectionSize;
+        }
+        else
+        {
+            uint32_t * l2 = mmu_get_l2_table(va);
+            if (!l2)
+            {
+                result = false;
+                break;
+            }
+            
+            uint32_t index = (va >> kMMU_L2_SmallPage_Address_Shift) & (kMMU_L2_Entry_Count - 1);
+            uint32_t count = size / kMMU_SmallPageSize;
+            uint32_t i;
+            
+            if (size == kMMU_SmallPageSize)
+            {
+                mmu_split_large_page(l2, index);
+                mmu_clean_l2_entries(&l2[index & ~(kMMU_Replicated_Entries - 1)], kMMU_Replicated_Entries);
+            }
+            
+            for (i = 0; i < count; ++i)
+            {
+                l2[index + i] = (size == kMMU_LargePageSize) ? mmu_make_large_page(pa, attr) : mmu_make_small_page(pa, attr);
+            }
+            
+            mmu_clean_l2_entries(&l2[index], count);
+            
+            step = kMMU_SmallPageSize;
+        }
+        
+        // Make the new descriptors visible to the table walk, then drop any TLB entry that
+        // covers the rewritten addresses.
+        _ARM_DSB();
+        for (offset = 0; offset < size; offset += step)
+        {
+            mmu_tlb_invalidate_mva(va + offset, isSMP);
+        }
+        _ARM_DSB();
+        
+        // Lines may have been speculatively fetched through the old mapping until now.
+        if (wasCached && !mmu_is_cacheable(attr))
+        {
+            arm_dcache_invalidate_mlines((const void *)va, size);
+        }
+        
+        pa += size;
+        va += size;
+        length -= size;
+    }
+    
+    // Entries for pages of a released second-level table may still be in the TLB.
+    if (isTableReleased)
+    {
+        if (isSMP)
+        {
+            arm_unified_tlb_invalidate_is();
+        }
+        else
+        {
+            arm_unified_tlb_invalidate();
+        }
+    }
+    
+    // Invalidate the branch predictor and resynchronise the instruction stream.
+    uint32_t zero = 0;
+    if (isSMP)
+    {
+        _ARM_MCR(15, 0, zero, 7, 1, 6); // BPIALLIS
+    }
+    else
+    {
+        _ARM_MCR(15, 0, zero, 7, 5, 6); // BPIALL
+    }
+    _ARM_DSB();
+    _ARM_ISB();
+    
+    return result;
+}
+
 void mmu_enable()
 {
     // invalidate all tlb 
@@ -111,7 +819,7 @@ void mmu_disable()
 void mmu_init()
 {
     // Get the L1 page table base address.
-    uint32_t * table = (uint32_t *)&__l1_page_table_start;
+    uint32_t * table = mmu_l1_table();
     uint32_t share_attr = kShareable;
 
     // write table address to TTBR0
@@ -121,8 +829,9 @@ void mmu_init()
     uint32_t dacr = 0x55555555; 
     _ARM_MCR(15, 0, dacr, 3, 0, 0); // MCR p15, 0, <Rd>, c3, c0, 0 ; Write DACR
 
-    // Clear the L1 table.
+    // Clear the L1 table and release all L2 tables.
     bzero(table, MMU_L1_PAGE_TABLE_SIZE);
+    bzero(s_isL2PageTableUsed, sizeof(s_isL2PageTableUsed));
     
     // Create default mappings.
     mmu_map_l1_range(0x00000000, 0x00000000, 0x00900000, kStronglyOrdered, kShareable, kRWAccess); // ROM and peripherals
@@ -130,9 +839,7 @@ void mmu_init()
     mmu_map_l1_range(0x00a00000, 0x00a00000, 0x0f600000, kStronglyOrdered, kShareable, kRWAccess); // More peripherals
    
     // Check whether SMP is enabled. If it is not, then we don't want to make SDRAM shareable.
-    uint32_t actlr = 0x0;
-    _ARM_MRC(15, 0, actlr, 1, 0, 1);
-    if (actlr & BM_ACTLR_SMP)
+    if (mmu_is_smp())
     {
         share_attr = kShareable;
     }
@@ -152,97 +859,159 @@ void mmu_init()
 
 void mmu_map_l1_range(uint32_t pa, uint32_t va, uint32_t length, mmu_memory_type_t memoryType, mmu_shareability_t isShareable, mmu_access_t access)
 {
-    register mmu_l1_section_t entry;
-    entry.u = 0;
+    mmu_map_range(pa, va, length, memoryType, isShareable, access, 0);
+}
+
+bool mmu_map_range(uint32_t pa, uint32_t va, uint32_t length, mmu_memory_type_t memoryType, mmu_shareability_t isShareable, mmu_access_t access, uint32_t flags)
+{
+    if ((pa | va | length) & (kMMU_SmallPageSize - 1))
+    {
+        return false;
+    }
     
-    // Set constant attributes.
-    entry.id = kMMU_L1_Section_ID;
-    entry.xn = 0; // Allow execution
-    entry.domain = 0; // Domain 0
-    entry.ng = 0; // Global
-    entry.ns = 0; // Secure
+    mmu_attributes_t attr;
+    mmu_encode_attributes(&attr, memoryType, isShareable, access, flags);
     
-    // Set attributes based on the selected memory type.
-    switch (memoryType)
+    return mmu_update_range(pa, va, length, &attr, flags, false);
+}
+
+bool mmu_set_attributes(uint32_t va, uint32_t length, mmu_memory_type_t memoryType, mmu_shareability_t isShareable, mmu_access_t access, uint32_t flags)
+{
+    if ((va | length) & (kMMU_SmallPageSize - 1))
     {
-        case kStronglyOrdered:
-            entry.c = 0;
-            entry.b = 0;
-            entry.tex = 0;
-            entry.s = 1; // Ignored
-            break;
-        case kDevice:
-            if (isShareable)
-            {
-                entry.c = 0;
-                entry.b = 1;
-                entry.tex = 0;
-                entry.s = 1; // Ignored
-            }
-            else
-            {
-                entry.c = 0;
-                entry.b = 0;
-                entry.tex = 2;
-                entry.s = 0; // Ignored
-            }
-            break;
-        case kOuterInner_WB_WA:
-            entry.c = 1;
-            entry.b = 1;
-            entry.tex = 1;
-            entry.s = isShareable;
-            break;
-        case kOuterInner_WT:
-            entry.c = 1;
-            entry.b = 0;
-            entry.tex = 0;
-            entry.s = isShareable;
-            break;
-        case kNoncacheable:
-            entry.c = 0;
-            entry.b = 0;
-            entry.tex = 1;
-            entry.s = isShareable;
-            break;
+        return false;
     }
     
-    // Set attributes from specified access mode.
-    switch (access)
+    mmu_attributes_t attr;
+    mmu_encode_attributes(&attr, memoryType, isShareable, access, flags);
+    
+    return mmu_update_range(0, va, length, &attr, flags, true);
+}
+
+bool mmu_get_mapping(uint32_t va, mmu_mapping_info_t * info)
+{
+    mmu_descriptor_t desc;
+    
+    if (!mmu_lookup(va, &desc))
     {
-        case kNoAccess:
-            entry.ap2 = 0;
-            entry.ap1_0 = 0;
+        return false;
+    }
+    
+    if (info)
+    {
+        info->pa = desc.pa;
+        info->pageSize = desc.size;
+        mmu_decode_attributes(&desc.attr, info);
+    }
+    
+    return true;
+}
+
+//! @brief Prints one line of mmu_dump_mappings().
+static void mmu_print_mapping(uint32_t first, uint32_t last, const mmu_mapping_info_t * info)
+{
+    static const char * const kTypeNames[] = {
+            [kStronglyOrdered] = "strongly-ordered",
+            [kDevice] = "device",
+            [kOuterInner_WB_WA] = "WB-WA",
+            [kOuterInner_WT] = "WT",
+            [kNoncacheable] = "non-cacheable"
+        };
+    static const char * const kAccessNames[] = {
+            [kNoAccess] = "--",
+            [kROAccess] = "RO",
+            [kRWAccess] = "RW"
+        };
+    const char * size;
+    
+    switch (info->pageSize)
+    {
+        case kMMU_SupersectionSize:
+            size = "16M";
             break;
-        case kROAccess:
-            entry.ap2 = 1;
-            entry.ap1_0 = 3;
+        case kMMU_SectionSize:
+            size = "1M";
             break;
-        case kRWAccess:
-            entry.ap2 = 0;
-            entry.ap1_0 = 3;
+        case kMMU_LargePageSize:
+            size = "64K";
+            break;
+        default:
+            size = "4K";
             break;
     }
     
-    // Get the L1 page table base address.
-    uint32_t * table = (uint32_t *)&__l1_page_table_start;
-    
-    // Convert addresses to 12-bit bases.
-    uint32_t vbase = va >> kMMU_L1_Section_Address_Shift;
-    uint32_t pbase = pa >> kMMU_L1_Section_Address_Shift;
-    uint32_t entries = length >> kMMU_L1_Section_Address_Shift;
+    printf("0x%08x-0x%08x -> 0x%08x %3s %-16s %s %s%s\n", first, last, info->pa, size,
+           kTypeNames[info->memoryType], info->isShareable ? "S" : "-",
+           kAccessNames[info->access], (info->flags & kExecuteNever) ? " XN" : "");
+}
 
-    // Fill in L1 page table entries.
-    for (; entries > 0; ++pbase, ++vbase, --entries)
+void mmu_dump_mappings(void)
+{
+    uint32_t * table = mmu_l1_table();
+    mmu_mapping_info_t run;
+    uint32_t runFirst = 0;
+    uint32_t runLast = 0;
+    bool isInRun = false;
+    uint32_t va = 0;
+    uint32_t used = 0;
+    uint32_t i;
+    
+    // Walk the whole address space a page or section at a time until the address wraps.
+    do
     {
-        entry.address = pbase;
-        table[vbase] = entry.u;
+        mmu_mapping_info_t info;
+        uint32_t step;
+        
+        if (mmu_get_mapping(va, &info))
+        {
+            step = info.pageSize;
+            
+            // Extend the current run if this page continues it exactly.
+            if (isInRun && va == runLast + 1 && info.pageSize == run.pageSize
+                && info.memoryType == run.memoryType && info.isShareable == run.isShareable
+                && info.access == run.access && info.flags == run.flags
+                && info.pa == run.pa + (va - runFirst))
+            {
+                runLast = va + step - 1;
+            }
+            else
+            {
+                if (isInRun)
+                {
+                    mmu_print_mapping(runFirst, runLast, &run);
+                }
+                
+                run = info;
+                runFirst = va;
+                runLast = va + step - 1;
+                isInRun = true;
+            }
+        }
+        else
+        {
+            step = ((table[va >> kMMU_L1_Section_Address_Shift] & 3) == kMMU_L1_PageTable_ID) ? kMMU_SmallPageSize : kMMU_SectionSize;
+            
+            if (isInRun)
+            {
+                mmu_print_mapping(runFirst, runLast, &run);
+                isInRun = false;
+            }
+        }
+        
+        va += step;
+    } while (va != 0);
+    
+    if (isInRun)
+    {
+        mmu_print_mapping(runFirst, runLast, &run);
     }
     
-    // Invalidate TLB
-    arm_unified_tlb_invalidate();
+    for (i = 0; i < MMU_L2_PAGE_TABLE_COUNT; ++i)
+    {
+        used += s_isL2PageTableUsed[i];
+    }
+    printf("%d of %d second-level page tables in use\n", used, MMU_L2_PAGE_TABLE_COUNT);
 }
-
 bool mmu_virtual_to_physical(uint32_t virtualAddress, uint32_t * physicalAddress)
 {
     uint32_t pa = 0;
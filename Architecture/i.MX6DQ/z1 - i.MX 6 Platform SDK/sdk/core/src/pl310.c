@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file  pl310.c
+ * @brief Driver for the ARM L2C-310 (PL310) level 2 cache controller.
+ */
+
+#include "core/pl310.h"
+#include "pl310_registers.h"
+#include "core/cortex_a9.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Ranges at least this many times the cache size are maintained by way.
+//!
+//! Walking the range line by line costs one register write per 32 bytes, while a way operation
+//! takes roughly constant time. Only used for clean and clean+invalidate; invalidating by way
+//! would discard unrelated dirty data.
+#define PL310_WAY_OP_THRESHOLD (1)
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Whether pl310_init() has run.
+static bool s_isInitialized = false;
+
+//! @brief Clean+invalidate by PA is broken before r1p0 (erratum 588369).
+static bool s_splitCleanInvalidate = false;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+static inline pl310_t * pl310_get_regs(void)
+{
+    uint32_t base = get_arm_private_peripheral_base() + kPL310BaseOffset;
+    return (pl310_t *)base;
+}
+
+//! @brief Convert a latency in cycles to a RAM control register value.
+static inline uint32_t pl310_latency(uint8_t setup, uint8_t read, uint8_t write)
+{
+    return (((setup - 1) & 0x7) << kBP_PL310_RAM_CTRL_Setup)
+        | (((read - 1) & 0x7) << kBP_PL310_RAM_CTRL_Read)
+        | (((write - 1) & 0x7) << kBP_PL310_RAM_CTRL_Write);
+}
+
+void pl310_get_default_config(pl310_config_t * config)
+{
+    // 4 cycle read, 2 cycle write and 3 cycle setup latencies for both RAMs, as validated for
+    // the i.MX6 family.
+    config->tagSetupLatency = 3;
+    config->tagReadLatency = 4;
+    config->tagWriteLatency = 2;
+    config->dataSetupLatency = 3;
+    config->dataReadLatency = 4;
+    config->dataWriteLatency = 2;
+    config->instrPrefetch = true;
+    config->dataPrefetch = true;
+    config->prefetchOffset = 7;
+    config->doubleLinefill = true;
+    config->earlyBRESP = true;
+    config->dynamicClockGating = true;
+    config->standby = true;
+}
+
+void pl310_init(const pl310_config_t * config)
+{
+    pl310_t * l2 = pl310_get_regs();
+    pl310_config_t defaults;
+
+    if (!config)
+    {
+        pl310_get_default_config(&defaults);
+        config = &defaults;
+    }
+
+    // The configuration registers may only be written while the cache is off.
+    if (l2->CTRL & kBM_PL310_CTRL_Enable)
+    {
+        return;
+    }
+
+    uint32_t release = (l2->CACHE_ID & kBM_PL310_CACHE_ID_RtlRelease) >> kBP_PL310_CACHE_ID_RtlRelease;
+    s_splitCleanInvalidate = (release < kPL310_RtlRelease_r1p0);
+
+    l2->TAG_RAM_CTRL = pl310_latency(config->tagSetupLatency, config->tagReadLatency, config->tagWriteLatency);
+    l2->DATA_RAM_CTRL = pl310_latency(config->dataSetupLatency, config->dataReadLatency, config->dataWriteLatency);
+
+    // Keep the associativity and way size strapped by the SoC, set everything else.
+    uint32_t aux = l2->AUX_CTRL;
+    aux &= ~(kBM_PL310_AUX_CTRL_DataPrefetch | kBM_PL310_AUX_CTRL_InstrPrefetch
+        | kBM_PL310_AUX_CTRL_EarlyBRESP | kBM_PL310_AUX_CTRL_FullLineOfZero);
+    aux |= kBM_PL310_AUX_CTRL_EventMonitorBus | kBM_PL310_AUX_CTRL_SharedOverride;
+    if (config->dataPrefetch)
+    {
+        aux |= kBM_PL310_AUX_CTRL_DataPrefetch;
+    }
+    if (config->instrPrefetch)
+    {
+        aux |= kBM_PL310_AUX_CTRL_InstrPrefetch;
+    }
+    if (config->earlyBRESP)
+    {
+        aux |= kBM_PL310_AUX_CTRL_EarlyBRESP;
+    }
+    l2->AUX_CTRL = aux;
+
+    // The prefetch enables in AUX_CTRL are aliases of the ones here, so repeat them.
+    uint32_t prefetch = (config->prefetchOffset << kBP_PL310_PREFETCH_CTRL_Offset) & kBM_PL310_PREFETCH_CTRL_Offset;
+    if (config->dataPrefetch)
+    {
+        prefetch |= kBM_PL310_PREFETCH_CTRL_DataPrefetch;
+    }
+    if (config->instrPrefetch)
+    {
+        prefetch |= kBM_PL310_PREFETCH_CTRL_InstrPrefetch;
+    }
+    if (config->doubleLinefill)
+    {
+        prefetch |= kBM_PL310_PREFETCH_CTRL_DoubleLinefill | kBM_PL310_PREFETCH_CTRL_IncrDoubleLinefill;
+    }
+    l2->PREFETCH_CTRL = prefetch;
+
+    uint32_t power = 0;
+    if (config->dynamicClockGating)
+    {
+        power |= kBM_PL310_POWER_CTRL_DynamicClockGating;
+    }
+    if (config->standby)
+    {
+        power |= kBM_PL310_POWER_CTRL_Standby;
+    }
+    l2->POWER_CTRL = power;
+
+    // Start from an empty cache with no pending interrupts.
+    pl310_invalidate_ways(pl310_all_ways());
+    l2->INT_MASK = 0;
+    l2->INT_CLEAR = 0xffffffff;
+
+    s_isInitialized = true;
+}
+
+void pl310_enable(void)
+{
+    pl310_t * l2 = pl310_get_regs();
+
+    if (l2->CTRL & kBM_PL310_CTRL_Enable)
+    {
+        return;
+    }
+
+    if (!s_isInitialized)
+    {
+        pl310_init(NULL);
+    }
+
+    l2->CTRL = kBM_PL310_CTRL_Enable;
+    _ARM_DSB();
+}
+
+void pl310_disable(void)
+{
+    pl310_t * l2 = pl310_get_regs();
+
+    if (!(l2->CTRL & kBM_PL310_CTRL_Enable))
+    {
+        return;
+    }
+
+    pl310_clean_invalidate_ways(pl310_all_ways());
+    l2->CTRL = 0;
+    _ARM_DSB();
+}
+
+bool pl310_is_enabled(void)
+{
+    return (pl310_get_regs()->CTRL & kBM_PL310_CTRL_Enable) != 0;
+}
+
+uint32_t pl310_all_ways(void)
+{
+    return (pl310_get_regs()->AUX_CTRL & kBM_PL310_AUX_CTRL_Associativity) ? 0xffff : 0xff;
+}
+
+uint32_t pl310_get_size(void)
+{
+    uint32_t aux = pl310_get_regs()->AUX_CTRL;
+    uint32_t waySize = (aux & kBM_PL310_AUX_CTRL_WaySize) >> kBP_PL310_AUX_CTRL_WaySize;
+    uint32_t ways = (aux & kBM_PL310_AUX_CTRL_Associativity) ? 16 : 8;
+
+    // Way size encoding 1 is 16KB, 2 is 32KB and so on up to 512KB.
+    if (waySize == 0)
+    {
+        waySize = 1;
+    }
+    return ways * (8 * 1024 << waySize);
+}
+
+void pl310_sync(void)
+{
+    pl310_t * l2 = pl310_get_regs();
+
+    _ARM_DSB();
+    l2->CACHE_SYNC = 0;
+    while (l2->CACHE_SYNC & 1)
+    {
+    }
+}
+
+//! @brief Start a background way operation and wait for it to finish.
+static void pl310_way_op(volatile uint32_t * reg, uint32_t ways)
+{
+    _ARM_DSB();
+    *reg = ways;
+    while (*reg & ways)
+    {
+    }
+    pl310_sync();
+}
+
+void pl310_clean_ways(uint32_t ways)
+{
+    pl310_way_op(&pl310_get_regs()->CLEAN_WAY, ways);
+}
+
+void pl310_invalidate_ways(uint32_t ways)
+{
+    pl310_way_op(&pl310_get_regs()->INV_WAY, ways);
+}
+
+void pl310_clean_invalidate_ways(uint32_t ways)
+{
+    pl310_way_op(&pl310_get_regs()->CLEAN_INV_WAY, ways);
+}
+
+//! @brief Write the address of each line of a range to one of the by-PA registers.
+static void pl310_range_op(volatile uint32_t * reg, uint32_t pa, uint32_t length)
+{
+    uint32_t end = pa + length;
+
+    pa &= ~(PL310_LINE_SIZE - 1);
+
+    // The CPU must have finished its own writes to the lines before the L2 acts on them.
+    _ARM_DSB();
+    for (; pa < end; pa += PL310_LINE_SIZE)
+    {
+        *reg = pa;
+    }
+    pl310_sync();
+}
+
+void pl310_clean_range(uint32_t pa, uint32_t length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+    if (length >= PL310_WAY_OP_THRESHOLD * pl310_get_size())
+    {
+        pl310_clean_ways(pl310_all_ways());
+        return;
+    }
+    pl310_range_op(&pl310_get_regs()->CLEAN_PA, pa, length);
+}
+
+void pl310_invalidate_range(uint32_t pa, uint32_t length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+    // Partial lines at either end may hold unrelated dirty data that must survive, so
+    // write those back first.
+    if (pa & (PL310_LINE_SIZE - 1))
+    {
+        pl310_clean_invalidate_range(pa, 1);
+    }
+    if ((pa + length) & (PL310_LINE_SIZE - 1))
+    {
+        pl310_clean_invalidate_range(pa + length - 1, 1);
+    }
+    pl310_range_op(&pl310_get_regs()->INV_PA, pa, length);
+}
+
+void pl310_clean_invalidate_range(uint32_t pa, uint32_t length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+    if (length >= PL310_WAY_OP_THRESHOLD * pl310_get_size())
+    {
+        pl310_clean_invalidate_ways(pl310_all_ways());
+        return;
+    }
+    if (s_splitCleanInvalidate)
+    {
+        pl310_range_op(&pl310_get_regs()->CLEAN_PA, pa, length);
+        pl310_range_op(&pl310_get_regs()->INV_PA, pa, length);
+        return;
+    }
+    pl310_range_op(&pl310_get_regs()->CLEAN_INV_PA, pa, length);
+}
+
+void pl310_event_counter_start(unsigned counter, pl310_event_t event)
+{
+    pl310_t * l2 = pl310_get_regs();
+    uint32_t config = (event << kBP_PL310_EV_CNT_CFG_Source) & kBM_PL310_EV_CNT_CFG_Source;
+
+    if (counter == 0)
+    {
+        l2->EV_CNT0_CFG = config;
+    }
+    else
+    {
+        l2->EV_CNT1_CFG = config;
+    }
+    l2->EV_CNT_CTRL |= kBM_PL310_EV_CNT_CTRL_Enable;
+}
+
+void pl310_event_counters_stop(void)
+{
+    pl310_get_regs()->EV_CNT_CTRL &= ~kBM_PL310_EV_CNT_CTRL_Enable;
+}
+
+void pl310_event_counters_reset(void)
+{
+    pl310_t * l2 = pl310_get_regs();
+
+    // The reset bits read as zero, so preserve only the enable.
+    l2->EV_CNT_CTRL = (l2->EV_CNT_CTRL & kBM_PL310_EV_CNT_CTRL_Enable)
+        | kBM_PL310_EV_CNT_CTRL_Reset0 | kBM_PL310_EV_CNT_CTRL_Reset1;
+}
+
+uint32_t pl310_event_counter_read(unsigned counter)
+{
+    pl310_t * l2 = pl310_get_regs();
+    return (counter == 0) ? l2->EV_CNT0 : l2->EV_CNT1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
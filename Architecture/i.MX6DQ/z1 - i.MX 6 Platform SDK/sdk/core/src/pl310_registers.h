@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#if !defined(__PL310_REGISTERS_H__)
+#define __PL310_REGISTERS_H__
+
+#include "sdk_types.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Offset of the L2 cache controller from the private peripheral base.
+enum _pl310_base_offsets
+{
+    kPL310BaseOffset = 0x2000   //!< L2C-310 register block offset.
+};
+
+//! @brief L2C-310 registers.
+//!
+//! Register names follow the ARM L2C-310 TRM. Only registers used by the driver have names,
+//! the rest of the block is padding.
+struct _pl310_registers
+{
+    uint32_t CACHE_ID;              //!< 0x000 Cache ID Register.
+    uint32_t CACHE_TYPE;            //!< 0x004 Cache Type Register.
+    uint32_t _reserved0[62];
+    uint32_t CTRL;                  //!< 0x100 Control Register.
+    uint32_t AUX_CTRL;              //!< 0x104 Auxiliary Control Register.
+    uint32_t TAG_RAM_CTRL;          //!< 0x108 Tag RAM Latency Control Register.
+    uint32_t DATA_RAM_CTRL;         //!< 0x10c Data RAM Latency Control Register.
+    uint32_t _reserved1[60];
+    uint32_t EV_CNT_CTRL;           //!< 0x200 Event Counter Control Register.
+    uint32_t EV_CNT1_CFG;           //!< 0x204 Event Counter 1 Configuration Register.
+    uint32_t EV_CNT0_CFG;           //!< 0x208 Event Counter 0 Configuration Register.
+    uint32_t EV_CNT1;               //!< 0x20c Event Counter 1 Value Register.
+    uint32_t EV_CNT0;               //!< 0x210 Event Counter 0 Value Register.
+    uint32_t INT_MASK;              //!< 0x214 Interrupt Mask Register.
+    uint32_t INT_MASK_STATUS;       //!< 0x218 Masked Interrupt Status Register.
+    uint32_t INT_RAW_STATUS;        //!< 0x21c Raw Interrupt Status Register.
+    uint32_t INT_CLEAR;             //!< 0x220 Interrupt Clear Register.
+    uint32_t _reserved2[323];
+    uint32_t CACHE_SYNC;            //!< 0x730 Cache Sync Register.
+    uint32_t _reserved3[15];
+    uint32_t INV_PA;                //!< 0x770 Invalidate Line by PA.
+    uint32_t _reserved4[2];
+    uint32_t INV_WAY;               //!< 0x77c Invalidate by Way.
+    uint32_t _reserved5[12];
+    uint32_t CLEAN_PA;              //!< 0x7b0 Clean Line by PA.
+    uint32_t _reserved6;
+    uint32_t CLEAN_INDEX;           //!< 0x7b8 Clean Line by Set/Way.
+    uint32_t CLEAN_WAY;             //!< 0x7bc Clean by Way.
+    uint32_t _reserved7[12];
+    uint32_t CLEAN_INV_PA;          //!< 0x7f0 Clean and Invalidate Line by PA.
+    uint32_t _reserved8;
+    uint32_t CLEAN_INV_INDEX;       //!< 0x7f8 Clean and Invalidate Line by Set/Way.
+    uint32_t CLEAN_INV_WAY;         //!< 0x7fc Clean and Invalidate by Way.
+    uint32_t _reserved9[64];
+    uint32_t LOCKDOWN[16];          //!< 0x900 Data and Instruction Lockdown for each master.
+    uint32_t _reserved10[4];
+    uint32_t LOCK_LINE_EN;          //!< 0x950 Lockdown by Line Enable.
+    uint32_t UNLOCK_WAY;            //!< 0x954 Unlock All Lines by Way.
+    uint32_t _reserved11[170];
+    uint32_t ADDR_FILTER_START;     //!< 0xc00 Address Filtering Start.
+    uint32_t ADDR_FILTER_END;       //!< 0xc04 Address Filtering End.
+    uint32_t _reserved12[206];
+    uint32_t DEBUG_CTRL;            //!< 0xf40 Debug Control Register.
+    uint32_t _reserved13[7];
+    uint32_t PREFETCH_CTRL;         //!< 0xf60 Prefetch Control Register.
+    uint32_t _reserved14[7];
+    uint32_t POWER_CTRL;            //!< 0xf80 Power Control Register.
+};
+
+//! @brief Bitfields constants for the CACHE_ID register.
+enum _pl310_cache_id_fields
+{
+    kBP_PL310_CACHE_ID_RtlRelease = 0,
+    kBM_PL310_CACHE_ID_RtlRelease = (0x3f << kBP_PL310_CACHE_ID_RtlRelease),
+
+    kBP_PL310_CACHE_ID_PartNumber = 6,
+    kBM_PL310_CACHE_ID_PartNumber = (0xf << kBP_PL310_CACHE_ID_PartNumber),
+
+    kPL310_RtlRelease_r1p0 = 0x2,   //!< First release with a working clean and invalidate by PA.
+    kPL310_RtlRelease_r3p2 = 0x8    //!< Release in the i.MX6 parts.
+};
+
+//! @brief Bitfields constants for the CTRL register.
+enum _pl310_ctrl_fields
+{
+    kBM_PL310_CTRL_Enable = (1 << 0)
+};
+
+//! @brief Bitfields constants for the AUX_CTRL register.
+enum _pl310_aux_ctrl_fields
+{
+    kBM_PL310_AUX_CTRL_FullLineOfZero = (1 << 0),
+    kBM_PL310_AUX_CTRL_SharedInvalidate = (1 << 13),
+
+    kBP_PL310_AUX_CTRL_Associativity = 16,
+    kBM_PL310_AUX_CTRL_Associativity = (1 << kBP_PL310_AUX_CTRL_Associativity),
+
+    kBP_PL310_AUX_CTRL_WaySize = 17,
+    kBM_PL310_AUX_CTRL_WaySize = (0x7 << kBP_PL310_AUX_CTRL_WaySize),
+
+    kBM_PL310_AUX_CTRL_EventMonitorBus = (1 << 20),
+    kBM_PL310_AUX_CTRL_Parity = (1 << 21),
+    kBM_PL310_AUX_CTRL_SharedOverride = (1 << 22),
+    kBM_PL310_AUX_CTRL_RoundRobin = (1 << 25),
+    kBM_PL310_AUX_CTRL_NSLockdown = (1 << 26),
+    kBM_PL310_AUX_CTRL_NSIntAccess = (1 << 27),
+    kBM_PL310_AUX_CTRL_DataPrefetch = (1 << 28),
+    kBM_PL310_AUX_CTRL_InstrPrefetch = (1 << 29),
+    kBM_PL310_AUX_CTRL_EarlyBRESP = (1 << 30)
+};
+
+//! @brief Bitfields constants for the TAG_RAM_CTRL and DATA_RAM_CTRL registers.
+//!
+//! Each field holds the latency in cycles minus one.
+enum _pl310_ram_ctrl_fields
+{
+    kBP_PL310_RAM_CTRL_Setup = 0,
+    kBM_PL310_RAM_CTRL_Setup = (0x7 << kBP_PL310_RAM_CTRL_Setup),
+
+    kBP_PL310_RAM_CTRL_Read = 4,
+    kBM_PL310_RAM_CTRL_Read = (0x7 << kBP_PL310_RAM_CTRL_Read),
+
+    kBP_PL310_RAM_CTRL_Write = 8,
+    kBM_PL310_RAM_CTRL_Write = (0x7 << kBP_PL310_RAM_CTRL_Write)
+};
+
+//! @brief Bitfields constants for the EV_CNT_CTRL and EV_CNTn_CFG registers.
+enum _pl310_event_fields
+{
+    kBM_PL310_EV_CNT_CTRL_Enable = (1 << 0),
+    kBM_PL310_EV_CNT_CTRL_Reset0 = (1 << 1),
+    kBM_PL310_EV_CNT_CTRL_Reset1 = (1 << 2),
+
+    kBP_PL310_EV_CNT_CFG_Source = 2,
+    kBM_PL310_EV_CNT_CFG_Source = (0xf << kBP_PL310_EV_CNT_CFG_Source)
+};
+
+//! @brief Bitfields constants for the PREFETCH_CTRL register.
+enum _pl310_prefetch_ctrl_fields
+{
+    kBP_PL310_PREFETCH_CTRL_Offset = 0,
+    kBM_PL310_PREFETCH_CTRL_Offset = (0x1f << kBP_PL310_PREFETCH_CTRL_Offset),
+
+    kBM_PL310_PREFETCH_CTRL_IncrDoubleLinefill = (1 << 23),
+    kBM_PL310_PREFETCH_CTRL_PrefetchDrop = (1 << 24),
+    kBM_PL310_PREFETCH_CTRL_DataPrefetch = (1 << 28),
+    kBM_PL310_PREFETCH_CTRL_InstrPrefetch = (1 << 29),
+    kBM_PL310_PREFETCH_CTRL_DoubleLinefill = (1 << 30)
+};
+
+//! @brief Bitfields constants for the POWER_CTRL register.
+enum _pl310_power_ctrl_fields
+{
+    kBM_PL310_POWER_CTRL_Standby = (1 << 0),
+    kBM_PL310_POWER_CTRL_DynamicClockGating = (1 << 1)
+};
+
+//! @brief Type for the L2C-310 registers.
+typedef volatile struct _pl310_registers pl310_t;
+
+#endif // __PL310_REGISTERS_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
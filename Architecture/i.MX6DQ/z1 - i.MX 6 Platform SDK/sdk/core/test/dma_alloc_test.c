@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//! @file dma_alloc_test.c
+//! @brief DMA buffer allocator test.
+//!
+//! Exercises the coherent pool, then checks that the streaming sync functions move data
+//! between the cached view of a buffer and memory. A non-cacheable alias of the buffer
+//! stands in for the device.
+
+#include "sdk.h"
+#include "core/cortex_a9.h"
+#include "core/mmu.h"
+#include "core/dma_alloc.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Virtual address of the non-cacheable alias. Unmapped on all supported chips.
+#define ALIAS_VA (0xf0000000)
+
+#define TEST_BUFFER_SIZE (16 * 1024)
+
+//! @brief Offset and length of the unaligned range used for the partial line check.
+#define PARTIAL_OFFSET (DMA_CACHE_LINE_SIZE + 5)
+#define PARTIAL_LENGTH (3 * DMA_CACHE_LINE_SIZE)
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Fill a range of bytes through the given view.
+static void fill(volatile uint8_t * p, uint32_t length, uint8_t seed)
+{
+    uint32_t i;
+    for (i = 0; i < length; ++i)
+    {
+        p[i] = seed + i;
+    }
+}
+
+//! @brief Return the number of bytes that differ from the pattern.
+static uint32_t check(volatile uint8_t * p, uint32_t length, uint8_t seed)
+{
+    uint32_t i;
+    uint32_t errors = 0;
+    for (i = 0; i < length; ++i)
+    {
+        if (p[i] != (uint8_t)(seed + i))
+        {
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+//! @brief Allocate, check and free coherent blocks.
+static bool coherent_test(void)
+{
+    static const uint32_t sizes[] = { 16, 100, 4096, 64, 2000 };
+    static const uint32_t aligns[] = { 0, 128, 4096, 256, 0 };
+    uint8_t * blocks[5];
+    size_t initialFree = dma_coherent_get_free();
+    bool passed = true;
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < 5; ++i)
+    {
+        blocks[i] = dma_alloc_coherent(sizes[i], aligns[i]);
+        if (!blocks[i] || ((uint32_t)blocks[i] & (aligns[i] ? aligns[i] - 1 : 63)))
+        {
+            printf("  block %d of %d bytes misplaced at 0x%08x\n", i, sizes[i], (uint32_t)blocks[i]);
+            passed = false;
+            continue;
+        }
+
+        // The block must be zeroed. Each one is then filled with its own value, checked
+        // below once all are allocated to catch overlaps.
+        for (j = 0; j < sizes[i]; ++j)
+        {
+            if (blocks[i][j])
+            {
+                printf("  block %d is not zeroed\n", i);
+                passed = false;
+                break;
+            }
+        }
+        memset(blocks[i], 0xa0 + i, sizes[i]);
+    }
+
+    for (i = 0; i < 5; ++i)
+    {
+        for (j = 0; blocks[i] && j < sizes[i]; ++j)
+        {
+            if (blocks[i][j] != 0xa0 + i)
+            {
+                printf("  block %d was overwritten\n", i);
+                passed = false;
+                break;
+            }
+        }
+        dma_free_coherent(blocks[i]);
+    }
+
+    if (dma_coherent_get_free() != initialFree)
+    {
+        printf("  %d bytes leaked\n", (int)(initialFree - dma_coherent_get_free()));
+        passed = false;
+    }
+
+    printf("  coherent pool:    %s (%d KB free)\n", passed ? "pass" : "FAIL", (int)(dma_coherent_get_free() / 1024));
+    return passed;
+}
+
+//! @brief Check the streaming sync functions against a non-cacheable alias.
+static bool streaming_test(void)
+{
+    uint8_t * buffer = dma_alloc_streaming(TEST_BUFFER_SIZE, 0);
+    uint32_t pa;
+    uint32_t errors;
+    bool passed = true;
+
+    if (!buffer || ((uint32_t)buffer & (DMA_CACHE_LINE_SIZE - 1)))
+    {
+        printf("  streaming buffer misaligned at 0x%08x\n", (uint32_t)buffer);
+        dma_free_streaming(buffer);
+        return false;
+    }
+
+    // Alias just the pages holding the buffer.
+    uint32_t offset;
+    if (!mmu_virtual_to_physical((uint32_t)buffer, &pa)
+        || !mmu_map_range(pa & ~(kMMU_SmallPageSize - 1), ALIAS_VA,
+                          ((pa & (kMMU_SmallPageSize - 1)) + TEST_BUFFER_SIZE + kMMU_SmallPageSize - 1) & ~(kMMU_SmallPageSize - 1),
+                          kNoncacheable, kShareable, kRWAccess, kExecuteNever))
+    {
+        printf("  could not map the alias\n");
+        dma_free_streaming(buffer);
+        return false;
+    }
+    offset = pa & (kMMU_SmallPageSize - 1);
+    volatile uint8_t * device = (volatile uint8_t *)(ALIAS_VA + offset);
+
+    // To device: what the CPU wrote must be in memory after the sync.
+    fill(buffer, TEST_BUFFER_SIZE, 0x11);
+    dma_sync_for_device(buffer, TEST_BUFFER_SIZE, kDmaToDevice);
+    errors = check(device, TEST_BUFFER_SIZE, 0x11);
+    printf("  to device:        %s (%d bytes differ)\n", errors ? "FAIL" : "pass", errors);
+    passed = passed && !errors;
+
+    // From device: what the device wrote must be seen after the sync, even with the buffer
+    // dirty in the caches beforehand.
+    fill(buffer, TEST_BUFFER_SIZE, 0x22);
+    dma_sync_for_device(buffer, TEST_BUFFER_SIZE, kDmaFromDevice);
+    fill(device, TEST_BUFFER_SIZE, 0x33);
+    dma_sync_for_cpu(buffer, TEST_BUFFER_SIZE, kDmaFromDevice);
+    errors = check(buffer, TEST_BUFFER_SIZE, 0x33);
+    printf("  from device:      %s (%d bytes differ)\n", errors ? "FAIL" : "pass", errors);
+    passed = passed && !errors;
+
+    // Unaligned range: the CPU's data sharing the first and last lines must survive.
+    fill(buffer, TEST_BUFFER_SIZE, 0x44);
+    dma_sync_for_device(buffer + PARTIAL_OFFSET, PARTIAL_LENGTH, kDmaFromDevice);
+    fill(device + PARTIAL_OFFSET, PARTIAL_LENGTH, 0x55);
+    dma_sync_for_cpu(buffer + PARTIAL_OFFSET, PARTIAL_LENGTH, kDmaFromDevice);
+    errors = check(buffer, PARTIAL_OFFSET, 0x44)
+        + check(buffer + PARTIAL_OFFSET, PARTIAL_LENGTH, 0x55)
+        + check(buffer + PARTIAL_OFFSET + PARTIAL_LENGTH, DMA_CACHE_LINE_SIZE,
+                0x44 + PARTIAL_OFFSET + PARTIAL_LENGTH);
+    printf("  partial lines:    %s (%d bytes differ)\n", errors ? "FAIL" : "pass", errors);
+    passed = passed && !errors;
+
+    // Drop the alias again. Mapping the whole megabyte as a section frees its second-level table.
+    mmu_map_l1_range(0, ALIAS_VA, kMMU_SectionSize, kStronglyOrdered, kShareable, kNoAccess);
+    dma_free_streaming(buffer);
+
+    return passed;
+}
+
+void dma_alloc_test(void)
+{
+    bool passed;
+
+    printf("Starting DMA buffer allocation test\n");
+
+    passed = coherent_test();
+    passed = streaming_test() && passed;
+
+    printf("DMA buffer allocation test %s\n", passed ? "passed" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
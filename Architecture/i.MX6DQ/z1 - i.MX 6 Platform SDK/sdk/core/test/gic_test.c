@@ -29,11 +29,22 @@
  */
 
 #include "sdk.h"
+#include "core/cortex_a9.h"
 #include "registers/regssrc.h"
 
 //globals used for gic_test
 unsigned int gicTestDone;
 
+//set by the high priority handler of the nesting test
+static volatile bool s_highHandled;
+
+//whether the high priority handler ran while the low priority one was active
+static volatile bool s_wasPreempted;
+
+//context passed to the low priority handler of the nesting test
+static uint32_t s_lowContext = 0x1234;
+static volatile uint32_t s_receivedContext;
+
 void gic_sgi_test_handler(void)
 {
     printf("In gic_sgi_test_handler()\n");
@@ -41,6 +52,58 @@ void gic_sgi_test_handler(void)
     gicTestDone = 0;            // test complete
 }
 
+static void gic_nesting_high_handler(void * context)
+{
+    s_highHandled = true;
+}
+
+static void gic_nesting_low_handler(void * context)
+{
+    uint32_t timeout = 1000000;
+
+    s_receivedContext = *(uint32_t *)context;
+
+    // Raise a higher priority interrupt and wait for it without leaving this handler.
+    gic_send_sgi(SW_INTERRUPT_5, 1 << cpu_get_current(), kGicSgiFilter_UseTargetList);
+    while (!s_highHandled && --timeout) ;
+
+    s_wasPreempted = s_highHandled && irq_get_nesting_level() == 1;
+}
+
+//! @brief Check that a higher priority interrupt preempts a running handler.
+static void gic_nesting_test(void)
+{
+    irq_stats_t stats;
+    uint32_t cpu = cpu_get_current();
+
+    printf("Starting nested interrupt test\n");
+
+    irq_clear_stats();
+    s_highHandled = false;
+    s_wasPreempted = false;
+    s_receivedContext = 0;
+
+    register_interrupt_handler(SW_INTERRUPT_4, gic_nesting_low_handler, &s_lowContext);
+    register_interrupt_handler(SW_INTERRUPT_5, gic_nesting_high_handler, NULL);
+    enable_interrupt(SW_INTERRUPT_4, cpu, kIrqPriority_Low);
+    enable_interrupt(SW_INTERRUPT_5, cpu, kIrqPriority_High);
+
+    gic_send_sgi(SW_INTERRUPT_4, 1 << cpu, kGicSgiFilter_UseTargetList);
+    while (!s_highHandled) ;
+
+    irq_get_stats(SW_INTERRUPT_5, cpu, &stats);
+    printf("Context %s, high priority handler %s, nested count %d\n",
+           s_receivedContext == s_lowContext ? "passed" : "lost",
+           s_wasPreempted ? "preempted the low priority one" : "did not preempt", stats.nested);
+
+    disable_interrupt(SW_INTERRUPT_4, cpu);
+    disable_interrupt(SW_INTERRUPT_5, cpu);
+    irq_print_stats();
+
+    bool isOk = s_receivedContext == s_lowContext && s_wasPreempted && stats.nested == 1;
+    printf("Nested interrupt test %s\n", isOk ? "PASSED" : "FAILED");
+}
+
 void gic_test(void)
 {
     printf("Starting GIC SGI test\n");
@@ -58,4 +121,6 @@ void gic_test(void)
     while (gicTestDone) ;
 
     printf("SGI was handled\n");
+
+    gic_nesting_test();
 }
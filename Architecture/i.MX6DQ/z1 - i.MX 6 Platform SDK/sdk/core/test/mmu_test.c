@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//! @file mmu_test.c
+//! @brief Page table test.
+//!
+//! Maps a small and a large page alias of a DDR buffer, checks the translations and
+//! attributes the tables report, then changes the attributes of a single live page and
+//! prints the resulting mappings.
+
+#include <malloc.h>
+#include "sdk.h"
+#include "core/cortex_a9.h"
+#include "core/mmu.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Virtual address of the aliases. Unmapped on all supported chips.
+#define ALIAS_VA (0xf0000000)
+
+//! @brief Size of the test buffer, two 64KB large pages so one of them is always aligned.
+#define TEST_BUFFER_SIZE (2 * kMMU_LargePageSize)
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Print the result of one check and fold it into the overall result.
+static bool report(const char * name, bool isOk, bool passed)
+{
+    printf("  %-24s %s\n", name, isOk ? "pass" : "FAIL");
+    return passed && isOk;
+}
+
+//! @brief Check the translation and attributes of a virtual address.
+static bool check_mapping(uint32_t va, uint32_t pa, uint32_t pageSize, mmu_memory_type_t memoryType, mmu_access_t access)
+{
+    mmu_mapping_info_t info;
+    uint32_t walkedPA = 0;
+    
+    return mmu_get_mapping(va, &info) && info.pa == pa && info.pageSize == pageSize
+        && info.memoryType == memoryType && info.access == access
+        && mmu_virtual_to_physical(va, &walkedPA) && walkedPA == pa;
+}
+
+void mmu_test(void)
+{
+    uint8_t * buffer = (uint8_t *)memalign(kMMU_SmallPageSize, TEST_BUFFER_SIZE);
+    volatile uint32_t * alias = (volatile uint32_t *)ALIAS_VA;
+    mmu_mapping_info_t info;
+    bool passed = true;
+    uint32_t pa;
+    uint32_t large;
+    
+    printf("Starting MMU test\n");
+    
+    if (!buffer || !mmu_virtual_to_physical((uint32_t)buffer, &pa))
+    {
+        printf("MMU test FAILED: no buffer\n");
+        free(buffer);
+        return;
+    }
+    
+    // DDR is mapped with supersections unless something split them.
+    passed = report("DDR mapped", mmu_get_mapping((uint32_t)&info, &info), passed);
+    printf("  DDR page size            0x%08x\n", info.pageSize);
+    
+    // A small page alias sees the same memory through a different address.
+    memset(buffer, 0, TEST_BUFFER_SIZE);
+    *(volatile uint32_t *)buffer = 0x5a5aa5a5;
+    passed = report("map small page", mmu_map_range(pa, ALIAS_VA, kMMU_SmallPageSize, kOuterInner_WB_WA, kShareable, kRWAccess, kExecuteNever), passed);
+    passed = report("small page translation", check_mapping(ALIAS_VA + 0x10, pa + 0x10, kMMU_SmallPageSize, kOuterInner_WB_WA, kRWAccess), passed);
+    passed = report("small page data", alias[0] == 0x5a5aa5a5, passed);
+    passed = report("next page unmapped", !mmu_get_mapping(ALIAS_VA + kMMU_SmallPageSize, NULL), passed);
+    
+    // A 64KB aligned range is mapped with a large page.
+    large = (pa + kMMU_LargePageSize - 1) & ~(kMMU_LargePageSize - 1);
+    passed = report("map large page", mmu_map_range(large, ALIAS_VA + kMMU_LargePageSize, kMMU_LargePageSize, kOuterInner_WB_WA, kShareable, kRWAccess, 0), passed);
+    passed = report("large page translation", check_mapping(ALIAS_VA + kMMU_LargePageSize + 0x1234, large + 0x1234, kMMU_LargePageSize, kOuterInner_WB_WA, kRWAccess), passed);
+    
+    // Changing one page of the live large page splits it and leaves its neighbours alone.
+    passed = report("set attributes", mmu_set_attributes(ALIAS_VA + kMMU_LargePageSize + kMMU_SmallPageSize, kMMU_SmallPageSize, kNoncacheable, kShareable, kROAccess, kExecuteNever), passed);
+    passed = report("changed page", check_mapping(ALIAS_VA + kMMU_LargePageSize + kMMU_SmallPageSize, large + kMMU_SmallPageSize, kMMU_SmallPageSize, kNoncacheable, kROAccess), passed);
+    passed = report("neighbour page", check_mapping(ALIAS_VA + kMMU_LargePageSize, large, kMMU_SmallPageSize, kOuterInner_WB_WA, kRWAccess), passed);
+    
+    mmu_dump_mappings();
+    
+    // Drop the aliases again. Mapping the whole megabyte as a section frees its second-level table.
+    mmu_map_l1_range(0, ALIAS_VA, kMMU_SectionSize, kStronglyOrdered, kShareable, kNoAccess);
+    free(buffer);
+    
+    printf("MMU test %s\n", passed ? "passed" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
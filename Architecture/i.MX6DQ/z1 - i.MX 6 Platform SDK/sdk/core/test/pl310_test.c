@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//! @file pl310_test.c
+//! @brief L2 cache controller test.
+//!
+//! Checks that range maintenance through the arm_dcache_*_mlines() helpers reaches memory
+//! with the L2 enabled, by comparing the cached view of a buffer with a non-cacheable alias
+//! of the same memory, and prints the L2 hit rate from the event counters.
+//!
+//! On QEMU's sabrelite machine the L2 controller is only a register model, so the coherency
+//! checks always pass and the counters read zero; the test then just verifies that the driver
+//! programs the controller without hanging.
+
+#include "sdk.h"
+#include "core/cortex_a9.h"
+#include "core/mmu.h"
+#include "core/pl310.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Virtual address of the non-cacheable alias. Unmapped on all supported chips.
+#define ALIAS_VA (0xf0000000)
+
+#define TEST_BUFFER_SIZE (64 * 1024)
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t s_buffer[TEST_BUFFER_SIZE / sizeof(uint32_t)] __attribute__ ((aligned (PL310_LINE_SIZE)));
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Fill the buffer through the given view.
+static void fill(volatile uint32_t * p, uint32_t seed)
+{
+    uint32_t i;
+    for (i = 0; i < TEST_BUFFER_SIZE / sizeof(uint32_t); ++i)
+    {
+        p[i] = seed + i;
+    }
+}
+
+//! @brief Return the number of words that differ from the pattern.
+static uint32_t check(volatile uint32_t * p, uint32_t seed)
+{
+    uint32_t i;
+    uint32_t errors = 0;
+    for (i = 0; i < TEST_BUFFER_SIZE / sizeof(uint32_t); ++i)
+    {
+        if (p[i] != seed + i)
+        {
+            ++errors;
+        }
+    }
+    return errors;
+}
+
+void pl310_test(void)
+{
+    uint32_t pa;
+    bool passed = true;
+
+    printf("Starting L2 cache test\n");
+
+    if (!mmu_virtual_to_physical((uint32_t)s_buffer, &pa))
+    {
+        printf("Cannot translate the test buffer address\n");
+        return;
+    }
+
+    // Map the 1MB section holding the buffer a second time, non-cacheable. The buffer must
+    // not straddle a section boundary for the alias to cover it.
+    if ((pa >> 20) != ((pa + TEST_BUFFER_SIZE - 1) >> 20))
+    {
+        printf("Test buffer crosses a 1MB section, skipping\n");
+        return;
+    }
+    mmu_map_l1_range(pa & 0xfff00000, ALIAS_VA, 0x00100000, kNoncacheable, kShareable, kRWAccess);
+    volatile uint32_t * alias = (volatile uint32_t *)(ALIAS_VA | (pa & 0x000fffff));
+
+    pl310_enable();
+    printf("L2 is %d KB, %s\n", pl310_get_size() / 1024, pl310_is_enabled() ? "enabled" : "disabled");
+
+    // Clean: data written through the caches must be visible in memory afterwards.
+    fill(s_buffer, 0x1000);
+    arm_dcache_flush_mlines(s_buffer, sizeof(s_buffer));
+    uint32_t errors = check(alias, 0x1000);
+    printf("  clean range:      %s (%d words differ)\n", errors ? "FAIL" : "pass", errors);
+    passed = passed && !errors;
+
+    // Invalidate: memory written behind the caches' back must be seen afterwards. The
+    // buffer is pulled into the caches first so a missing invalidate returns the stale copy.
+    fill(s_buffer, 0x2000);
+    arm_dcache_flush_mlines(s_buffer, sizeof(s_buffer));
+    check(s_buffer, 0x2000);
+    fill(alias, 0x3000);
+    arm_dcache_invalidate_mlines(s_buffer, sizeof(s_buffer));
+    errors = check(s_buffer, 0x3000);
+    printf("  invalidate range: %s (%d words differ)\n", errors ? "FAIL" : "pass", errors);
+    passed = passed && !errors;
+
+    // Whole cache clean by way.
+    fill(s_buffer, 0x4000);
+    arm_dcache_flush();
+    errors = check(alias, 0x4000);
+    printf("  clean all:        %s (%d words differ)\n", errors ? "FAIL" : "pass", errors);
+    passed = passed && !errors;
+
+    // Read the buffer twice; the second pass should hit in L1 or L2.
+    pl310_event_counters_reset();
+    pl310_event_counter_start(0, kPL310Event_DRREQ);
+    pl310_event_counter_start(1, kPL310Event_DRHIT);
+    check(s_buffer, 0x4000);
+    check(s_buffer, 0x4000);
+    pl310_event_counters_stop();
+    printf("  L2 data reads: %d, hits: %d\n", pl310_event_counter_read(0), pl310_event_counter_read(1));
+
+    // Drop the alias again.
+    mmu_map_l1_range(pa & 0xfff00000, ALIAS_VA, 0x00100000, kStronglyOrdered, kShareable, kNoAccess);
+
+    printf("L2 cache test %s\n", passed ? "passed" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
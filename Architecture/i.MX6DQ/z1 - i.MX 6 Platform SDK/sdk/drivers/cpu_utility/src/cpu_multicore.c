@@ -69,6 +69,10 @@ static void common_cpu_entry(void)
     uint32_t myCoreNumber = cpu_get_current();
     core_startup_info_t * info = &s_core_info[myCoreNumber];
     
+    // The IRQ entry saves NEON registers, so the FPU has to be usable before the entry
+    // point enables interrupts.
+    enable_neon_fpu();
+
     // Call the requested entry point for this CPU number.
     if (info->entry)
     {
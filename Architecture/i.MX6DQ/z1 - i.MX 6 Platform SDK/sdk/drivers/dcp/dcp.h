@@ -49,6 +49,22 @@
                                         ((ch) == 2) ? HW_DCP_CH2SEMA_WR((v)): \
                                         HW_DCP_CH3SEMA_WR((v)))
 
+#define HW_DCP_CHnSTAT_RD(ch)		(((ch) == 0) ? HW_DCP_CH0STAT_RD() : \
+                                        ((ch) == 1) ? HW_DCP_CH1STAT_RD(): \
+                                        ((ch) == 2) ? HW_DCP_CH2STAT_RD(): \
+                                        HW_DCP_CH3STAT_RD())
+
+#define HW_DCP_CHnSTAT_CLR(ch, v)	(((ch) == 0) ? HW_DCP_CH0STAT_CLR((v)) : \
+                                        ((ch) == 1) ? HW_DCP_CH1STAT_CLR((v)): \
+                                        ((ch) == 2) ? HW_DCP_CH2STAT_CLR((v)): \
+                                        HW_DCP_CH3STAT_CLR((v)))
+
+//! Error bits of the channel status registers
+#define DCP_CHnSTAT_ERROR_MASK		(BM_DCP_CH0STAT_HASH_MISMATCH | BM_DCP_CH0STAT_ERROR_SETUP | \
+                                        BM_DCP_CH0STAT_ERROR_PACKET | BM_DCP_CH0STAT_ERROR_SRC | \
+                                        BM_DCP_CH0STAT_ERROR_DST | BM_DCP_CH0STAT_ERROR_PAGEFAULT | \
+                                        BM_DCP_CH0STAT_ERROR_CODE)
+
 
 typedef enum {
     DCP_CHANNEL_1 = 0,
@@ -70,11 +86,18 @@ typedef struct {
     uint32_t stat;
 } dcp_work_pkt_t, *dcp_work_pkt_p;
 
+//! Function called when a work packet with the INTERRUPT bit set completes
+typedef void (*dcp_channel_isr) (uint32_t);
+
 int dcp_init(void);
 int dcp_deinit(void);
 int dcp_config_channel(uint32_t ch, dcp_work_pkt_p pkt_list);
 int dcp_start_channel(uint32_t ch, uint32_t pkt_num);
 int dcp_wait_channel_cmpl(uint32_t ch);
+uint32_t dcp_get_channel_error(uint32_t ch);
+void dcp_setup_interrupt(void);
+int dcp_channel_isr_attach(uint32_t ch, dcp_channel_isr isr);
 int dcp_memcpy(void* dst, void* src, uint32_t size);
+int dcp_memcpy_4ch(void* dst, void* src, uint32_t size);
 
 #endif
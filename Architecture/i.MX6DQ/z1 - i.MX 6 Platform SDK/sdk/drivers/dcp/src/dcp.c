@@ -29,6 +29,11 @@
  */
 
 #include "dcp/dcp.h"
+#include "core/cortex_a9.h"
+#include "core/interrupt.h"
+#include "core/dma_alloc.h"
+#include "utility/atomics.h"
+#include "utility/work_queue.h"
 
 #ifdef DCP_DEBUG
 #define TRACE(fmt, arg...) 	printf(fmt, ##arg)
@@ -36,6 +41,72 @@
 #define TRACE(fmt, arg...)	
 #endif
 
+/* One work packet per channel for the blocking copy routines, shared with the DCP */
+static dcp_work_pkt_p dcp_pkts = NULL;
+
+static dcp_channel_isr dcp_channel_isr_list[DCP_CHANNEL_MAX] = { NULL };
+
+/* Channels that interrupted and whose isr has not run yet */
+static volatile uint32_t dcp_pending_channels;
+
+/* Runs the channel isrs outside of the interrupt handler */
+static work_item_t dcp_channel_work;
+
+static void dcp_run_channel_isrs(void *arg)
+{
+    uint32_t int_flag;
+    uint32_t i;
+
+    do {
+        int_flag = dcp_pending_channels;
+    } while (!atomic_compare_and_swap(&dcp_pending_channels, int_flag, 0));
+
+    for (i = 0; i < DCP_CHANNEL_MAX; i++) {
+        if ((int_flag & (0x1 << i)) && (NULL != dcp_channel_isr_list[i])) {
+            dcp_channel_isr_list[i] (i);
+        }
+    }
+}
+
+static void dcp_interrupt_handler(void)
+{
+    uint32_t int_flag = HW_DCP_STAT.B.IRQ;
+    uint32_t pending;
+    uint32_t i;
+
+    /* Leave the status of polled channels alone */
+    for (i = 0; i < DCP_CHANNEL_MAX; i++) {
+        if (NULL == dcp_channel_isr_list[i]) {
+            int_flag &= ~(0x1 << i);
+        }
+    }
+
+    /* Acknowledge the channels right away, their isrs run as deferred work */
+    HW_DCP_STAT_CLR(int_flag);
+
+    do {
+        pending = dcp_pending_channels;
+    } while (!atomic_compare_and_swap(&dcp_pending_channels, pending, pending | int_flag));
+
+    if (!work_queue(&dcp_channel_work)) {
+        dcp_run_channel_isrs(NULL);
+    }
+}
+
+static void dcp_fill_memcpy_pkt(dcp_work_pkt_p pkt, void* dst, void* src, uint32_t size)
+{
+    pkt->next_pkt = 0;
+    pkt->ctrl0.U = 0;
+    pkt->ctrl0.B.ENABLE_MEMCOPY = 1;
+    pkt->ctrl0.B.DECR_SEMAPHORE = 1;
+    pkt->ctrl0.B.ENABLE_BLIT = 0;
+    pkt->ctrl0.B.INTERRUPT = 1;
+    pkt->ctrl1.U = 0;
+    pkt->dst_buf = dst;
+    pkt->src_buf = src;
+    pkt->buf_size = size;
+}
+
 /*! 
  * @brief Configure the dcp channel
  *  
@@ -51,21 +122,29 @@ int dcp_config_channel(uint32_t ch, dcp_work_pkt_p pkt_list)
 }
 
 /*! 
- * @brief Get the status of the dcp channel
+ * @brief Start the dcp channel
  *  
+ * The packets must be in memory the DCP sees, i.e. coherent memory.
+ *
  * @para    ch    the channel index
+ * @para    pkt_num	number of packets with DECR_SEMAPHORE set to process
  * @return	0 if succeed 
  */
 int dcp_start_channel(uint32_t ch, uint32_t pkt_num)
 {
+	 /* Make the packets visible to the DCP before it fetches them */
+	 _ARM_DSB();
 	 HW_DCP_CHnSEMA_WR(ch, pkt_num);
 
 	 return 0;
 }
 
 /*! 
- * @brief Get the status of the dcp channel
+ * @brief Wait for the completion of the dcp channel
  *  
+ * Only for channels without an isr attached, whose completion is not taken
+ * by the interrupt handler.
+ *
  * @para    ch    the channel index
  * @return	0 if succeed 
  */
@@ -77,13 +156,37 @@ int dcp_wait_channel_cmpl(uint32_t ch)
 	return 0;
 }
 
+/*! 
+ * @brief Read and clear the error status of the dcp channel
+ *  
+ * @para    ch    the channel index
+ * @return	the error bits of the channel status register, 0 if no error
+ */
+uint32_t dcp_get_channel_error(uint32_t ch)
+{
+    uint32_t err = HW_DCP_CHnSTAT_RD(ch) & DCP_CHnSTAT_ERROR_MASK;
+
+    if (err) {
+        HW_DCP_CHnSTAT_CLR(ch, err);
+    }
+
+    return err;
+}
+
 /*!
  * @breif	Initialize the DCP module
  * @para	none
- * @return 	none
+ * @return 	0 if succeed, -1 if the work packets could not be allocated
  */
 int dcp_init(void)
 {
+    if (dcp_pkts == NULL) {
+        dcp_pkts = (dcp_work_pkt_p) dma_alloc_coherent(DCP_CHANNEL_MAX * sizeof(dcp_work_pkt_t), 0);
+        if (dcp_pkts == NULL) {
+            return -1;
+        }
+    }
+
 	// reset the dcp module
     HW_DCP_CTRL_SET(BF_DCP_CTRL_SFTRST(1));
     HW_DCP_CTRL_CLR(BF_DCP_CTRL_SFTRST(1));
@@ -111,34 +214,85 @@ int dcp_deinit(void)
     return 0;
 }
 
+/*! 
+ * @brief Setup dcp interrupt
+ *
+ * Attaches dcp_interrupt_handler to the shared DCP interrupt. The handler only acknowledges
+ * the channels, their isrs run afterwards as deferred work, see utility/work_queue.h.
+ * Channels without an isr have their interrupt disabled so they can still be polled with
+ * dcp_wait_channel_cmpl().
+ *
+ *  @para	none
+ *  @return 	none
+ */
+void dcp_setup_interrupt(void)
+{
+    uint32_t i;
+
+    work_item_init(&dcp_channel_work, dcp_run_channel_isrs, NULL);
+    register_interrupt_routine(IMX_INT_DCP_GENERAL, dcp_interrupt_handler);
+
+    for (i = 0; i < DCP_CHANNEL_MAX; i++) {
+        if (NULL == dcp_channel_isr_list[i]) {
+            HW_DCP_CTRL_CLR(BF_DCP_CTRL_CHANNEL_INTERRUPT_ENABLE(0x1 << i));
+        }
+    }
+
+    enable_interrupt(IMX_INT_DCP_GENERAL, CPU_0, 0);
+}
+
+/*! 
+ * @brief Attach an isr to the dcp channel and enable its interrupt
+ *
+ *  @para	ch	the channel index
+ *  @para	isr	function called after a packet with the INTERRUPT bit set completes
+ *  @return 	0 if succeed, -1 if the channel index is invalid
+ */
+int dcp_channel_isr_attach(uint32_t ch, dcp_channel_isr isr)
+{
+    if (ch >= DCP_CHANNEL_MAX) {
+        return -1;
+    }
+
+    dcp_channel_isr_list[ch] = isr;
+
+    if (NULL != isr) {
+        HW_DCP_CTRL_SET(BF_DCP_CTRL_CHANNEL_INTERRUPT_ENABLE(0x1 << ch));
+    } else {
+        HW_DCP_CTRL_CLR(BF_DCP_CTRL_CHANNEL_INTERRUPT_ENABLE(0x1 << ch));
+    }
+
+    return 0;
+}
+
 /*! 
  * @brief memory copy routine impletemented using DCP channel 1
  *
  *  @para	dst	pointer to destination address
  *  @para	src	pointer to source address
  *  @para	size	bytes to copy
- *  @return 	0 if succeed
+ *  @return 	0 if succeed, -1 if the DCP is not initialized
  */
 int dcp_memcpy(void* dst, void* src, uint32_t size)
 {
-    dcp_work_pkt_p pkt = (dcp_work_pkt_p)malloc(sizeof(dcp_work_pkt_t));
-	
-    pkt->next_pkt = 0;
-    pkt->ctrl0.U = 0;
-    pkt->ctrl0.B.ENABLE_MEMCOPY = 1;
-    pkt->ctrl0.B.DECR_SEMAPHORE = 1;
-    pkt->ctrl0.B.ENABLE_BLIT = 0;
-    pkt->ctrl0.B.INTERRUPT = 1;
-    pkt->ctrl1.U = 0;
-    pkt->dst_buf = dst;
-    pkt->src_buf = src;
-    pkt->buf_size = size;
-    HW_DCP_CHnCMDPTR_WR(DCP_CHANNEL_1, (unsigned int)pkt);
+    dcp_work_pkt_p pkt;
+
+    if (dcp_pkts == NULL) {
+        return -1;
+    }
+
+    pkt = &dcp_pkts[DCP_CHANNEL_1];
+
+    dma_sync_for_device(src, size, kDmaToDevice);
+    dma_sync_for_device(dst, size, kDmaFromDevice);
+
+    dcp_fill_memcpy_pkt(pkt, dst, src, size);
+    dcp_config_channel(DCP_CHANNEL_1, pkt);
 
     dcp_start_channel(DCP_CHANNEL_1, 1);
     dcp_wait_channel_cmpl(DCP_CHANNEL_1);
-	
-    free(pkt);
+
+    dma_sync_for_cpu(dst, size, kDmaFromDevice);
 	
     return 0;
 }
@@ -149,41 +303,37 @@ int dcp_memcpy(void* dst, void* src, uint32_t size)
  *  @para	dst	pointer to destination address
  *  @para	src	pointer to source address
  *  @para	size	bytes to copy
- *  @return 	0 if succeed
+ *  @return 	0 if succeed, -1 if the DCP is not initialized
  */
 int dcp_memcpy_4ch(void* dst, void* src, uint32_t size)
 {
-    dcp_work_pkt_p pkt = (dcp_work_pkt_p)malloc(DCP_CHANNEL_MAX * sizeof(dcp_work_pkt_t));
-    dcp_work_pkt_p pkt_ptr;
+    uint32_t chunk = size / DCP_CHANNEL_MAX;
     int i;
 
-    pkt_ptr = pkt;
-    for(i = 0; i < DCP_CHANNEL_MAX; i++, pkt_ptr++) {
-	pkt_ptr->next_pkt = 0;
-	pkt_ptr->ctrl0.U = 0;
-	pkt_ptr->ctrl0.B.ENABLE_MEMCOPY = 1;
-	pkt_ptr->ctrl0.B.DECR_SEMAPHORE = 1;
-	pkt_ptr->ctrl0.B.ENABLE_BLIT = 0;
-	pkt_ptr->ctrl0.B.INTERRUPT = 1;
-	pkt_ptr->ctrl1.U = 0;
-	pkt_ptr->dst_buf = dst + (size/DCP_CHANNEL_MAX) * i;
-	pkt_ptr->src_buf = src + (size/DCP_CHANNEL_MAX) * i;
-	pkt_ptr->buf_size = size/DCP_CHANNEL_MAX;
-	HW_DCP_CHnCMDPTR_WR(DCP_CHANNEL_1, (unsigned int)pkt_ptr);
-    }  
-    pkt_ptr->buf_size = size - (size/DCP_CHANNEL_MAX) * i;
+    if (dcp_pkts == NULL) {
+        return -1;
+    }
 
-    dcp_start_channel(DCP_CHANNEL_1, 1);
-    dcp_start_channel(DCP_CHANNEL_2, 1);
-    dcp_start_channel(DCP_CHANNEL_3, 1);
-    dcp_start_channel(DCP_CHANNEL_4, 1);
+    dma_sync_for_device(src, size, kDmaToDevice);
+    dma_sync_for_device(dst, size, kDmaFromDevice);
 
-    dcp_wait_channel_cmpl(DCP_CHANNEL_1);
-    dcp_wait_channel_cmpl(DCP_CHANNEL_2);
-    dcp_wait_channel_cmpl(DCP_CHANNEL_3);
-    dcp_wait_channel_cmpl(DCP_CHANNEL_4);
+    for (i = 0; i < DCP_CHANNEL_MAX; i++) {
+        // the last channel also copies the remainder
+        uint32_t len = (i == DCP_CHANNEL_MAX - 1) ? size - chunk * i : chunk;
+
+        dcp_fill_memcpy_pkt(&dcp_pkts[i], (uint8_t *)dst + chunk * i, (uint8_t *)src + chunk * i, len);
+        dcp_config_channel(i, &dcp_pkts[i]);
+    }
+
+    for (i = 0; i < DCP_CHANNEL_MAX; i++) {
+        dcp_start_channel(i, 1);
+    }
+
+    for (i = 0; i < DCP_CHANNEL_MAX; i++) {
+        dcp_wait_channel_cmpl(i);
+    }
 
-    free(pkt);
+    dma_sync_for_cpu(dst, size, kDmaFromDevice);
 
     return 0;
 }
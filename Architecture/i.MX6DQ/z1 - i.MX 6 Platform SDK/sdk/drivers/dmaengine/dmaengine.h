@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//! @addtogroup dmaengine
+//! @{
+
+/*!
+ * @file dmaengine.h
+ * @brief Asynchronous memory to memory DMA over the SDMA and the DCP.
+ *
+ * The engine hands out channels backed by an SDMA channel running the AP_2_AP script or, on
+ * the MX6SL, by a DCP channel. Transfers are described by descriptors taken from a shared pool.
+ * Each descriptor holds a chain of hardware segments: SDMA buffer descriptors or DCP work
+ * packets. A scatter-gather list longer than one descriptor is split over several, which the
+ * channel processes back to back.
+ *
+ * Every submission returns a cookie. Cookies of a channel complete in order, so a
+ * #dma_fence_t of a channel and cookie tells whether all work queued before it is done.
+ * Completion callbacks run from the deferred work of the SDMA or DCP interrupt, see
+ * utility/work_queue.h.
+ *
+ * async_memcpy() and async_memset() pick the CPU, the DCP or the SDMA for each request from
+ * its size and how much work is already queued on the engine's channels.
+ */
+
+#if !defined(__DMAENGINE_H__)
+#define __DMAENGINE_H__
+
+#include "sdk.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Number of descriptors in the pool shared by all channels.
+#define DMA_DESCRIPTOR_COUNT (32)
+
+//! @brief Maximum number of hardware segments chained in one descriptor.
+#define DMA_MAX_SEGMENTS (16)
+
+//! @brief Maximum number of channels that can be requested at the same time.
+#define DMA_MAX_CHANNELS (6)
+
+//! @brief async_memcpy() and async_memset() use the CPU for requests shorter than this.
+//!
+//! Below a few KB, setting up the descriptor and the cache maintenance of the buffers cost
+//! more than the CPU needs for the copy.
+#define DMA_ASYNC_CPU_THRESHOLD (4096)
+
+//! @brief A channel with this many descriptors queued gets no more async requests.
+//!
+//! When all channels are that busy, the request is done by the CPU instead.
+#define DMA_ASYNC_MAX_QUEUE_DEPTH (8)
+
+//! @brief Size of the block an SDMA memset is replicated from.
+//!
+//! The SDMA has no fill operation, so the CPU sets the first block of the destination and the
+//! channel copies it over the rest.
+#define DMA_MEMSET_BLOCK_SIZE (8192)
+
+//! @brief Interval at which dma_fence_wait() checks a fence, in microseconds.
+//!
+//! Completion interrupts only wake up the core they are routed to, so other cores poll.
+#define DMA_FENCE_POLL_US (50)
+
+//! @brief Backend of a channel.
+typedef enum _dma_engine_type {
+    kDmaEngine_Sdma,    //!< An SDMA channel running the AP_2_AP script.
+    kDmaEngine_Dcp,     //!< A DCP channel in memcopy mode. Only on the MX6SL.
+    kDmaEngine_Any      //!< Any free channel, for dma_request_channel().
+} dma_engine_type_t;
+
+//! @brief Return codes of the DMA engine.
+enum _dma_engine_status {
+    kDmaSuccess = 0,                //!< No error.
+    kDmaError_NotInitialized = -1,  //!< dma_engine_init() was not called or failed.
+    kDmaError_NoChannel = -2,       //!< No free channel of the requested type.
+    kDmaError_NoDescriptor = -3,    //!< The descriptor pool is exhausted.
+    kDmaError_InvalidArgument = -4, //!< A NULL pointer or a zero length.
+    kDmaError_Transfer = -5         //!< The hardware reported a bus or setup error.
+};
+
+//! @brief Identifies a submission on a channel.
+//!
+//! Cookies are positive and increase with each submission. Negative values are errors.
+typedef int32_t dma_cookie_t;
+
+//! @brief Function called once a submission is complete.
+//!
+//! Called from deferred work with IRQs enabled, or from the interrupt handler if the work
+//! queue of the core is not enabled. The destination has already been synced for the CPU.
+//!
+//! @param arg The argument passed when the request was submitted.
+//! @param status #kDmaSuccess or #kDmaError_Transfer.
+typedef void (*dma_callback_t)(void * arg, int status);
+
+//! @brief One entry of a scatter-gather copy.
+typedef struct _dma_sg_entry {
+    void * dst;         //!< Destination of the entry.
+    const void * src;   //!< Source of the entry.
+    uint32_t length;    //!< Number of bytes to copy.
+} dma_sg_entry_t;
+
+//! @brief Opaque channel handle.
+typedef struct _dma_channel dma_channel_t;
+
+//! @brief Completion fence of a request.
+//!
+//! A fence with a NULL channel is always signaled. That is what async_memcpy() and
+//! async_memset() return when the CPU did the work.
+typedef struct _dma_fence {
+    dma_channel_t * channel;    //!< Channel the request was queued on.
+    dma_cookie_t cookie;        //!< Cookie of the request.
+} dma_fence_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @brief Initialize the SDMA, the DCP and the descriptor pool.
+//!
+//! Sets up the SDMA and DCP interrupts, so isrs that other drivers attached to their
+//! channels before are reset. One channel of each engine is kept for async_memcpy() and
+//! async_memset(). DCP channel 1 is left to the blocking dcp_memcpy(). Calling it again
+//! does nothing.
+//!
+//! @return #kDmaSuccess, or #kDmaError_NotInitialized if the SDMA failed to initialize or the
+//!     coherent pool is exhausted.
+int dma_engine_init(void);
+
+//! @name Channels
+//@{
+//! @brief Allocate a channel for exclusive use.
+//!
+//! @param type Backend of the channel, or #kDmaEngine_Any.
+//! @return The channel, or NULL if none is free.
+dma_channel_t * dma_request_channel(dma_engine_type_t type);
+
+//! @brief Wait for the work queued on a channel and free it.
+void dma_release_channel(dma_channel_t * channel);
+
+//! @brief Returns the backend of a channel.
+dma_engine_type_t dma_channel_get_type(dma_channel_t * channel);
+
+//! @brief Returns the number of descriptors queued or running on a channel.
+uint32_t dma_channel_get_depth(dma_channel_t * channel);
+//@}
+
+//! @name Submission
+//!
+//! The buffers may be in cacheable memory. They are synced for the device when the request
+//! is queued and the destination is synced for the CPU before it completes, so the caller
+//! must not touch them in between. See core/dma_alloc.h for the rules about buffers that
+//! share cache lines with other data.
+//@{
+//! @brief Queue a scatter-gather copy.
+//!
+//! The entries are copied in order. The request is split over as many descriptors as needed,
+//! which are all taken from the pool up front, so it is either queued completely or not at
+//! all.
+//!
+//! @param channel The channel to queue the request on.
+//! @param sg The entries to copy. The list itself may be reused once this returns.
+//! @param count Number of entries in @a sg.
+//! @param callback Function called once all entries are copied, or NULL.
+//! @param arg Argument passed to @a callback.
+//! @return The cookie of the request, or a negative error code.
+dma_cookie_t dma_submit_sg(dma_channel_t * channel, const dma_sg_entry_t * sg, uint32_t count, dma_callback_t callback, void * arg);
+
+//! @brief Queue a memory fill.
+//!
+//! The DCP fills the buffer with its constant fill mode. On the SDMA, the first
+//! #DMA_MEMSET_BLOCK_SIZE bytes are set by the CPU before the request is queued.
+//!
+//! @param channel The channel to queue the request on.
+//! @param dst Buffer to fill.
+//! @param value Byte value to store.
+//! @param length Number of bytes to fill.
+//! @param callback Function called once the buffer is filled, or NULL.
+//! @param arg Argument passed to @a callback.
+//! @return The cookie of the request, or a negative error code.
+dma_cookie_t dma_submit_memset(dma_channel_t * channel, void * dst, uint8_t value, uint32_t length, dma_callback_t callback, void * arg);
+
+//! @brief Returns whether a request of a channel is complete.
+bool dma_is_complete(dma_channel_t * channel, dma_cookie_t cookie);
+//@}
+
+//! @name Fences
+//@{
+//! @brief Returns whether the request of a fence is complete.
+bool dma_fence_is_signaled(const dma_fence_t * fence);
+
+//! @brief Wait until the request of a fence is complete.
+//!
+//! The core sleeps while waiting if it can, see hrtimer_can_sleep(). The completion runs
+//! from an interrupt, so this must not be called with IRQs masked on the core the SDMA and DCP
+//! interrupts are routed to.
+//!
+//! @param fence The fence to wait for.
+//! @param timeout Maximum time to wait, in microseconds.
+//! @retval true The request is complete.
+//! @retval false The timeout expired first.
+bool dma_fence_wait(const dma_fence_t * fence, uint32_t timeout);
+//@}
+
+//! @name Async memory operations
+//@{
+//! @brief Copy memory on whichever engine is the best fit.
+//!
+//! Requests shorter than #DMA_ASYNC_CPU_THRESHOLD, or arriving while every engine channel has
+//! #DMA_ASYNC_MAX_QUEUE_DEPTH descriptors queued or the pool is empty, are copied by the CPU
+//! before this returns. @a callback is then called directly and @a fence is signaled.
+//! Otherwise the request goes to the channel with the fewest bytes queued.
+//!
+//! The buffers must not overlap.
+//!
+//! @param dst Destination buffer.
+//! @param src Source buffer.
+//! @param length Number of bytes to copy.
+//! @param callback Function called once the copy is complete, or NULL.
+//! @param arg Argument passed to @a callback.
+//! @param[out] fence Set to the fence of the copy. May be NULL.
+//! @return #kDmaSuccess or #kDmaError_InvalidArgument.
+int async_memcpy(void * dst, const void * src, uint32_t length, dma_callback_t callback, void * arg, dma_fence_t * fence);
+
+//! @brief Fill memory on whichever engine is the best fit.
+//!
+//! Selects the engine like async_memcpy(), except that a DCP channel is preferred since it
+//! fills without reading memory.
+//!
+//! @param dst Buffer to fill.
+//! @param value Byte value to store.
+//! @param length Number of bytes to fill.
+//! @param callback Function called once the buffer is filled, or NULL.
+//! @param arg Argument passed to @a callback.
+//! @param[out] fence Set to the fence of the fill. May be NULL.
+//! @return #kDmaSuccess or #kDmaError_InvalidArgument.
+int async_memset(void * dst, uint8_t value, uint32_t length, dma_callback_t callback, void * arg, dma_fence_t * fence);
+//@}
+
+#if defined(__cplusplus)
+}
+#endif
+
+//! @}
+
+#endif // __DMAENGINE_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
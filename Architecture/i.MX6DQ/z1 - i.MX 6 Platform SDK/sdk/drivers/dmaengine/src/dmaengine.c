@@ -0,0 +1,979 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file dmaengine.c
+ * @brief Asynchronous DMA engine over the SDMA and the DCP.
+ *
+ * @ingroup dmaengine
+ */
+
+#include "sdk.h"
+#include "dmaengine/dmaengine.h"
+#include "sdma/sdma.h"
+#include "core/cortex_a9.h"
+#include "core/dma_alloc.h"
+#include "timer/hrtimer.h"
+#include "utility/spinlock.h"
+#include "utility/fast_string.h"
+#if defined(CHIP_MX6SL)
+#include "dcp/dcp.h"
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Largest byte count of one SDMA buffer descriptor.
+//!
+//! The count field is 16 bits wide. Keeping segments a multiple of 4KB leaves the alignment of
+//! the following segment unchanged.
+#define DMA_SDMA_MAX_SEGMENT_LENGTH (0xf000)
+
+//! @brief Room for one hardware segment, an SDMA buffer descriptor or a DCP work packet.
+#if defined(CHIP_MX6SL)
+#define DMA_HW_SEGMENT_SIZE (sizeof(dcp_work_pkt_t))
+#else
+#define DMA_HW_SEGMENT_SIZE (sizeof(sdma_bd_t))
+#endif
+
+//! @brief DCP channels run by the engine. Channel 1 is left to dcp_memcpy().
+#define DMA_DCP_FIRST_CHANNEL (1)
+
+//! @brief Number of DCP channels run by the engine.
+#if defined(CHIP_MX6SL)
+#define DMA_DCP_CHANNEL_COUNT (DCP_CHANNEL_MAX - DMA_DCP_FIRST_CHANNEL)
+#else
+#define DMA_DCP_CHANNEL_COUNT (0)
+#endif
+
+typedef struct _dma_descriptor dma_descriptor_t;
+
+//! @brief A chain of hardware segments the channel processes in one go.
+struct _dma_descriptor
+{
+    dma_descriptor_t * next;    //!< Next descriptor in a channel queue or in the pool.
+    dma_cookie_t cookie;        //!< Cookie of the request, only set in its last descriptor.
+    dma_callback_t callback;    //!< Completion callback, only set in the last descriptor.
+    void * arg;                 //!< Argument of the callback.
+    uint32_t count;             //!< Number of hardware segments in use.
+    uint32_t length;            //!< Number of bytes written by the segments.
+    void * hw;                  //!< #DMA_MAX_SEGMENTS hardware segments in coherent memory.
+};
+
+//! @brief State of a channel.
+struct _dma_channel
+{
+    ticket_lock_t lock;                 //!< Protects the queue against other cores and the isr.
+    dma_engine_type_t type;             //!< Backend of the channel.
+    uint32_t hwChannel;                 //!< SDMA channel number or DCP channel index.
+    bool isAllocated;                   //!< Set while the channel is requested.
+    dma_descriptor_t * active;          //!< Descriptor the hardware is working on.
+    dma_descriptor_t * head;            //!< First descriptor waiting for the hardware.
+    dma_descriptor_t * tail;            //!< Last descriptor waiting for the hardware.
+    volatile uint32_t depth;            //!< Number of active and waiting descriptors.
+    volatile uint32_t queuedBytes;      //!< Bytes still to be written by those descriptors.
+    int requestStatus;                  //!< Status of the request being completed.
+    dma_cookie_t lastCookie;            //!< Cookie of the last submission.
+    volatile dma_cookie_t completedCookie;  //!< Cookie of the last completed submission.
+    sdma_bd_p idleBd;                   //!< Empty table the SDMA channel is opened with.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief All channels, the DCP ones first.
+static dma_channel_t s_channels[DMA_MAX_CHANNELS];
+
+//! @brief Descriptor pool.
+static dma_descriptor_t s_descriptors[DMA_DESCRIPTOR_COUNT];
+
+//! @brief Free descriptors.
+static dma_descriptor_t * s_freeDescriptors;
+
+//! @brief Number of descriptors in #s_freeDescriptors.
+static uint32_t s_freeCount;
+
+//! @brief Protects the pool and the allocation of channels.
+static ticket_lock_t s_poolLock;
+
+//! @brief Channels kept for async_memcpy() and async_memset().
+static dma_channel_t * s_asyncChannels[2];
+
+//! @brief Address of the AP_2_AP script in SDMA memory.
+static uint32_t s_sdmaScript;
+
+static bool s_isInitialized = false;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+static bool dma_lock(ticket_lock_t * lock)
+{
+    bool wasEnabled = arm_set_interrupt_state(false);
+    ticket_lock_lock(lock);
+    return wasEnabled;
+}
+
+static void dma_unlock(ticket_lock_t * lock, bool wasEnabled)
+{
+    ticket_lock_unlock(lock);
+    arm_set_interrupt_state(wasEnabled);
+}
+
+//! @brief Take @a count descriptors from the pool, all or none.
+static dma_descriptor_t * dma_alloc_descriptors(uint32_t count)
+{
+    dma_descriptor_t * first = NULL;
+    bool wasEnabled = dma_lock(&s_poolLock);
+
+    if (s_freeCount >= count)
+    {
+        dma_descriptor_t * last = s_freeDescriptors;
+        uint32_t i;
+        for (i = 1; i < count; ++i)
+        {
+            last = last->next;
+        }
+
+        first = s_freeDescriptors;
+        s_freeDescriptors = last->next;
+        s_freeCount -= count;
+        last->next = NULL;
+    }
+
+    dma_unlock(&s_poolLock, wasEnabled);
+
+    dma_descriptor_t * desc;
+    for (desc = first; desc; desc = desc->next)
+    {
+        desc->cookie = 0;
+        desc->callback = NULL;
+        desc->arg = NULL;
+        desc->count = 0;
+        desc->length = 0;
+    }
+
+    return first;
+}
+
+//! @brief Return a list of descriptors to the pool.
+static void dma_free_descriptors(dma_descriptor_t * first)
+{
+    dma_descriptor_t * last = first;
+    uint32_t count = 1;
+
+    while (last->next)
+    {
+        last = last->next;
+        ++count;
+    }
+
+    bool wasEnabled = dma_lock(&s_poolLock);
+    last->next = s_freeDescriptors;
+    s_freeDescriptors = first;
+    s_freeCount += count;
+    dma_unlock(&s_poolLock, wasEnabled);
+}
+
+//! @brief Number of hardware segments needed to copy @a length bytes.
+static uint32_t dma_count_segments(dma_channel_t * channel, uint32_t length)
+{
+    if (channel->type == kDmaEngine_Sdma)
+    {
+        return (length + DMA_SDMA_MAX_SEGMENT_LENGTH - 1) / DMA_SDMA_MAX_SEGMENT_LENGTH;
+    }
+
+    return 1;
+}
+
+//! @brief Append one hardware segment to a descriptor.
+//!
+//! For a fill, @a src holds the 32-bit pattern rather than an address.
+static void dma_add_segment(dma_channel_t * channel, dma_descriptor_t * desc, void * dst, const void * src, uint32_t length, bool isFill)
+{
+    uint32_t i = desc->count++;
+    desc->length += length;
+
+    if (channel->type == kDmaEngine_Sdma)
+    {
+        sdma_bd_p bd = &((sdma_bd_p)desc->hw)[i];
+        uint32_t alignment = (uint32_t)dst | (uint32_t)src | length;
+        uint32_t width = SDMA_FLAGS_BW32;
+
+        if (alignment & 1)
+        {
+            width = SDMA_FLAGS_BW8;
+        }
+        else if (alignment & 2)
+        {
+            width = SDMA_FLAGS_BW16;
+        }
+
+        bd->mode = SDMA_FLAGS_BUSY | SDMA_FLAGS_CONT | width | length;
+        bd->buf_addr = (uint32_t)src;
+        bd->ext_buf_addr = (uint32_t)dst;
+    }
+#if defined(CHIP_MX6SL)
+    else
+    {
+        dcp_work_pkt_p pkt = &((dcp_work_pkt_p)desc->hw)[i];
+
+        pkt->next_pkt = 0;
+        pkt->ctrl0.U = 0;
+        pkt->ctrl0.B.ENABLE_MEMCOPY = 1;
+        pkt->ctrl0.B.CONSTANT_FILL = isFill;
+        pkt->ctrl0.B.DECR_SEMAPHORE = 1;
+        pkt->ctrl0.B.CHAIN = 1;
+        pkt->ctrl1.U = 0;
+        pkt->src_buf = (uint8_t *)src;
+        pkt->dst_buf = (uint8_t *)dst;
+        pkt->buf_size = length;
+        pkt->payload = NULL;
+        pkt->stat = 0;
+
+        if (i > 0)
+        {
+            pkt[-1].next_pkt = (uint32_t *)pkt;
+        }
+    }
+#endif
+}
+
+//! @brief Terminate the chain of a descriptor and have it interrupt on completion.
+static void dma_close_descriptor(dma_channel_t * channel, dma_descriptor_t * desc)
+{
+    if (channel->type == kDmaEngine_Sdma)
+    {
+        sdma_bd_p bd = &((sdma_bd_p)desc->hw)[desc->count - 1];
+        bd->mode = (bd->mode & ~SDMA_FLAGS_CONT) | SDMA_FLAGS_WRAP | SDMA_FLAGS_INTR;
+    }
+#if defined(CHIP_MX6SL)
+    else
+    {
+        dcp_work_pkt_p pkt = &((dcp_work_pkt_p)desc->hw)[desc->count - 1];
+        pkt->ctrl0.B.CHAIN = 0;
+        pkt->ctrl0.B.INTERRUPT = 1;
+    }
+#endif
+}
+
+//! @brief Hand a descriptor to the hardware. Called with the channel lock held.
+static void dma_start_descriptor(dma_channel_t * channel, dma_descriptor_t * desc)
+{
+    if (channel->type == kDmaEngine_Sdma)
+    {
+        sdma_channel_set_bd(channel->hwChannel, (sdma_bd_p)desc->hw);
+        sdma_channel_start(channel->hwChannel);
+    }
+#if defined(CHIP_MX6SL)
+    else
+    {
+        dcp_config_channel(channel->hwChannel, (dcp_work_pkt_p)desc->hw);
+        dcp_start_channel(channel->hwChannel, desc->count);
+    }
+#endif
+}
+
+//! @brief Returns the outcome of a descriptor the hardware is done with.
+static int dma_get_descriptor_status(dma_channel_t * channel, dma_descriptor_t * desc)
+{
+    if (channel->type == kDmaEngine_Sdma)
+    {
+        sdma_bd_p bd = (sdma_bd_p)desc->hw;
+        uint32_t i;
+        for (i = 0; i < desc->count; ++i)
+        {
+            if (bd[i].mode & SDMA_FLAGS_ERROR)
+            {
+                return kDmaError_Transfer;
+            }
+        }
+    }
+#if defined(CHIP_MX6SL)
+    else if (dcp_get_channel_error(channel->hwChannel))
+    {
+        return kDmaError_Transfer;
+    }
+#endif
+
+    return kDmaSuccess;
+}
+
+//! @brief Give the destination of a completed descriptor back to the CPU.
+static void dma_sync_descriptor_for_cpu(dma_channel_t * channel, dma_descriptor_t * desc)
+{
+    uint32_t i;
+
+    for (i = 0; i < desc->count; ++i)
+    {
+        if (channel->type == kDmaEngine_Sdma)
+        {
+            sdma_bd_p bd = &((sdma_bd_p)desc->hw)[i];
+            dma_sync_for_cpu((void *)bd->ext_buf_addr, bd->mode & 0xffff, kDmaFromDevice);
+        }
+#if defined(CHIP_MX6SL)
+        else
+        {
+            dcp_work_pkt_p pkt = &((dcp_work_pkt_p)desc->hw)[i];
+            dma_sync_for_cpu(pkt->dst_buf, pkt->buf_size, kDmaFromDevice);
+        }
+#endif
+    }
+}
+
+//! @brief Queue the descriptors of a request and start the channel if it is idle.
+static dma_cookie_t dma_queue_request(dma_channel_t * channel, dma_descriptor_t * first, dma_callback_t callback, void * arg)
+{
+    dma_descriptor_t * last = first;
+    uint32_t count = 1;
+    uint32_t length = first->length;
+
+    while (last->next)
+    {
+        last = last->next;
+        length += last->length;
+        ++count;
+    }
+
+    last->callback = callback;
+    last->arg = arg;
+
+    bool wasEnabled = dma_lock(&channel->lock);
+
+    // Cookies stay positive, dma_is_complete() copes with the wrap.
+    if (channel->lastCookie == INT32_MAX)
+    {
+        channel->lastCookie = 0;
+    }
+    dma_cookie_t cookie = ++channel->lastCookie;
+    last->cookie = cookie;
+
+    if (channel->tail)
+    {
+        channel->tail->next = first;
+    }
+    else
+    {
+        channel->head = first;
+    }
+    channel->tail = last;
+    channel->depth += count;
+    channel->queuedBytes += length;
+
+    if (!channel->active)
+    {
+        dma_descriptor_t * desc = channel->head;
+        channel->head = desc->next;
+        if (!channel->head)
+        {
+            channel->tail = NULL;
+        }
+        desc->next = NULL;
+        channel->active = desc;
+        dma_start_descriptor(channel, desc);
+    }
+
+    dma_unlock(&channel->lock, wasEnabled);
+
+    return cookie;
+}
+
+//! @brief Retire the active descriptor of a channel and start the next one.
+static void dma_channel_complete(dma_channel_t * channel)
+{
+    bool wasEnabled = dma_lock(&channel->lock);
+
+    dma_descriptor_t * desc = channel->active;
+    if (!desc)
+    {
+        dma_unlock(&channel->lock, wasEnabled);
+        return;
+    }
+
+    int status = dma_get_descriptor_status(channel, desc);
+
+    // Keep the hardware busy before doing the bookkeeping.
+    dma_descriptor_t * next = channel->head;
+    if (next)
+    {
+        channel->head = next->next;
+        if (!channel->head)
+        {
+            channel->tail = NULL;
+        }
+        next->next = NULL;
+        dma_start_descriptor(channel, next);
+    }
+    channel->active = next;
+    channel->depth--;
+    channel->queuedBytes -= desc->length;
+
+    dma_unlock(&channel->lock, wasEnabled);
+
+    dma_sync_descriptor_for_cpu(channel, desc);
+
+    if (status != kDmaSuccess)
+    {
+        channel->requestStatus = status;
+    }
+
+    if (desc->cookie)
+    {
+        status = channel->requestStatus;
+        channel->requestStatus = kDmaSuccess;
+
+        // The destination must be visible before the fence signals.
+        _ARM_DSB();
+        channel->completedCookie = desc->cookie;
+
+        if (desc->callback)
+        {
+            desc->callback(desc->arg, status);
+        }
+    }
+
+    dma_free_descriptors(desc);
+}
+
+static dma_channel_t * dma_find_channel(dma_engine_type_t type, uint32_t hwChannel)
+{
+    uint32_t i;
+
+    for (i = 0; i < DMA_MAX_CHANNELS; ++i)
+    {
+        dma_channel_t * channel = &s_channels[i];
+        if (channel->isAllocated && channel->type == type && channel->hwChannel == hwChannel)
+        {
+            return channel;
+        }
+    }
+
+    return NULL;
+}
+
+static void dma_sdma_isr(uint32_t hwChannel)
+{
+    dma_channel_t * channel = dma_find_channel(kDmaEngine_Sdma, hwChannel);
+    if (channel)
+    {
+        dma_channel_complete(channel);
+    }
+}
+
+#if defined(CHIP_MX6SL)
+static void dma_dcp_isr(uint32_t hwChannel)
+{
+    dma_channel_t * channel = dma_find_channel(kDmaEngine_Dcp, hwChannel);
+    if (channel)
+    {
+        dma_channel_complete(channel);
+    }
+}
+#endif
+
+//! @brief Open the SDMA channel behind a channel slot.
+static bool dma_open_sdma_channel(dma_channel_t * channel)
+{
+    sdma_chan_desc_t desc;
+    uint32_t i;
+
+    if (!channel->idleBd)
+    {
+        channel->idleBd = (sdma_bd_p)dma_alloc_coherent(sizeof(sdma_bd_t), 0);
+        if (!channel->idleBd)
+        {
+            return false;
+        }
+    }
+
+    // A single descriptor that is already done.
+    channel->idleBd->mode = 0;
+
+    desc.script_addr = s_sdmaScript;
+    desc.dma_mask[0] = desc.dma_mask[1] = 0;
+    desc.priority = SDMA_CHANNEL_PRIORITY_LOW;
+    for (i = 0; i < 8; ++i)
+    {
+        desc.gpr[i] = 0;
+    }
+
+    int32_t hwChannel = sdma_channel_request(&desc, channel->idleBd);
+    if (hwChannel < 0)
+    {
+        return false;
+    }
+
+    channel->hwChannel = hwChannel;
+    sdma_channel_isr_attach(hwChannel, dma_sdma_isr);
+
+    return true;
+}
+
+int dma_engine_init(void)
+{
+    uint32_t i;
+
+    if (s_isInitialized)
+    {
+        return kDmaSuccess;
+    }
+
+    if (sdma_init(NULL, SDMA_IPS_HOST_BASE_ADDR) != SDMA_RETV_SUCCESS
+        || sdma_lookup_script(SDMA_AP_2_AP, &s_sdmaScript) != SDMA_RETV_SUCCESS)
+    {
+        return kDmaError_NotInitialized;
+    }
+
+    uint8_t * hw = (uint8_t *)dma_alloc_coherent(DMA_DESCRIPTOR_COUNT * DMA_MAX_SEGMENTS * DMA_HW_SEGMENT_SIZE, DMA_CACHE_LINE_SIZE);
+    if (!hw)
+    {
+        return kDmaError_NotInitialized;
+    }
+
+#if defined(CHIP_MX6SL)
+    if (dcp_init() != 0)
+    {
+        dma_free_coherent(hw);
+        return kDmaError_NotInitialized;
+    }
+#endif
+
+    ticket_lock_init(&s_poolLock);
+    s_freeDescriptors = NULL;
+    for (i = 0; i < DMA_DESCRIPTOR_COUNT; ++i)
+    {
+        s_descriptors[i].hw = hw + i * DMA_MAX_SEGMENTS * DMA_HW_SEGMENT_SIZE;
+        s_descriptors[i].next = s_freeDescriptors;
+        s_freeDescriptors = &s_descriptors[i];
+    }
+    s_freeCount = DMA_DESCRIPTOR_COUNT;
+
+    for (i = 0; i < DMA_MAX_CHANNELS; ++i)
+    {
+        dma_channel_t * channel = &s_channels[i];
+
+        ticket_lock_init(&channel->lock);
+        channel->isAllocated = false;
+        channel->active = NULL;
+        channel->head = NULL;
+        channel->tail = NULL;
+        channel->depth = 0;
+        channel->queuedBytes = 0;
+        channel->requestStatus = kDmaSuccess;
+        channel->lastCookie = 0;
+        channel->completedCookie = 0;
+
+        if (i < DMA_DCP_CHANNEL_COUNT)
+        {
+            channel->type = kDmaEngine_Dcp;
+            channel->hwChannel = DMA_DCP_FIRST_CHANNEL + i;
+        }
+        else
+        {
+            channel->type = kDmaEngine_Sdma;
+        }
+    }
+
+    sdma_setup_interrupt();
+
+#if defined(CHIP_MX6SL)
+    for (i = 0; i < DMA_DCP_CHANNEL_COUNT; ++i)
+    {
+        dcp_channel_isr_attach(DMA_DCP_FIRST_CHANNEL + i, dma_dcp_isr);
+    }
+    dcp_setup_interrupt();
+#endif
+
+    s_isInitialized = true;
+
+    s_asyncChannels[0] = dma_request_channel(kDmaEngine_Sdma);
+#if defined(CHIP_MX6SL)
+    s_asyncChannels[1] = dma_request_channel(kDmaEngine_Dcp);
+#endif
+
+    return kDmaSuccess;
+}
+
+dma_channel_t * dma_request_channel(dma_engine_type_t type)
+{
+    dma_channel_t * channel = NULL;
+    uint32_t i;
+
+    if (!s_isInitialized)
+    {
+        return NULL;
+    }
+
+    bool wasEnabled = dma_lock(&s_poolLock);
+    for (i = 0; i < DMA_MAX_CHANNELS; ++i)
+    {
+        if (!s_channels[i].isAllocated && (type == kDmaEngine_Any || s_channels[i].type == type))
+        {
+            channel = &s_channels[i];
+            channel->isAllocated = true;
+            break;
+        }
+    }
+    dma_unlock(&s_poolLock, wasEnabled);
+
+    // Opening an SDMA channel loads its context through channel 0, so not with the lock held.
+    if (channel && channel->type == kDmaEngine_Sdma && !dma_open_sdma_channel(channel))
+    {
+        channel->isAllocated = false;
+        channel = NULL;
+    }
+
+    return channel;
+}
+
+static bool dma_channel_is_idle(void * arg)
+{
+    return ((dma_channel_t *)arg)->depth == 0;
+}
+
+void dma_release_channel(dma_channel_t * channel)
+{
+    if (!channel || !channel->isAllocated)
+    {
+        return;
+    }
+
+    while (!wait_event_timeout(dma_channel_is_idle, channel, 1000000, DMA_FENCE_POLL_US))
+    {
+    }
+
+    if (channel->type == kDmaEngine_Sdma)
+    {
+        sdma_channel_release(channel->hwChannel);
+    }
+
+    channel->isAllocated = false;
+}
+
+dma_engine_type_t dma_channel_get_type(dma_channel_t * channel)
+{
+    return channel->type;
+}
+
+uint32_t dma_channel_get_depth(dma_channel_t * channel)
+{
+    return channel->depth;
+}
+
+dma_cookie_t dma_submit_sg(dma_channel_t * channel, const dma_sg_entry_t * sg, uint32_t count, dma_callback_t callback, void * arg)
+{
+    uint32_t segments = 0;
+    uint32_t i;
+
+    if (!s_isInitialized)
+    {
+        return kDmaError_NotInitialized;
+    }
+
+    if (!channel || !sg || !count)
+    {
+        return kDmaError_InvalidArgument;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        if (!sg[i].dst || !sg[i].src || !sg[i].length)
+        {
+            return kDmaError_InvalidArgument;
+        }
+
+        segments += dma_count_segments(channel, sg[i].length);
+    }
+
+    dma_descriptor_t * first = dma_alloc_descriptors((segments + DMA_MAX_SEGMENTS - 1) / DMA_MAX_SEGMENTS);
+    if (!first)
+    {
+        return kDmaError_NoDescriptor;
+    }
+
+    dma_descriptor_t * desc = first;
+    for (i = 0; i < count; ++i)
+    {
+        uint8_t * dst = (uint8_t *)sg[i].dst;
+        const uint8_t * src = (const uint8_t *)sg[i].src;
+        uint32_t remaining = sg[i].length;
+
+        dma_sync_for_device(src, remaining, kDmaToDevice);
+        dma_sync_for_device(dst, remaining, kDmaFromDevice);
+
+        while (remaining)
+        {
+            uint32_t length = remaining;
+            if (channel->type == kDmaEngine_Sdma && length > DMA_SDMA_MAX_SEGMENT_LENGTH)
+            {
+                length = DMA_SDMA_MAX_SEGMENT_LENGTH;
+            }
+
+            if (desc->count == DMA_MAX_SEGMENTS)
+            {
+                dma_close_descriptor(channel, desc);
+                desc = desc->next;
+            }
+
+            dma_add_segment(channel, desc, dst, src, length, false);
+            dst += length;
+            src += length;
+            remaining -= length;
+        }
+    }
+    dma_close_descriptor(channel, desc);
+
+    return dma_queue_request(channel, first, callback, arg);
+}
+
+dma_cookie_t dma_submit_memset(dma_channel_t * channel, void * dst, uint8_t value, uint32_t length, dma_callback_t callback, void * arg)
+{
+    if (!s_isInitialized)
+    {
+        return kDmaError_NotInitialized;
+    }
+
+    if (!channel || !dst || !length)
+    {
+        return kDmaError_InvalidArgument;
+    }
+
+    uint32_t pattern = value * 0x01010101;
+
+    if (channel->type == kDmaEngine_Dcp)
+    {
+        dma_descriptor_t * desc = dma_alloc_descriptors(1);
+        if (!desc)
+        {
+            return kDmaError_NoDescriptor;
+        }
+
+        dma_sync_for_device(dst, length, kDmaFromDevice);
+        dma_add_segment(channel, desc, dst, (const void *)pattern, length, true);
+        dma_close_descriptor(channel, desc);
+
+        return dma_queue_request(channel, desc, callback, arg);
+    }
+
+    // The CPU sets the first block, the SDMA copies it over the rest. A single byte is
+    // copied onto itself so there is still a segment to complete.
+    uint32_t block = (length > DMA_MEMSET_BLOCK_SIZE) ? DMA_MEMSET_BLOCK_SIZE : (length + 1) / 2;
+    uint32_t remaining = length - block;
+    uint32_t segments = remaining ? (remaining + block - 1) / block : 1;
+
+    dma_descriptor_t * first = dma_alloc_descriptors((segments + DMA_MAX_SEGMENTS - 1) / DMA_MAX_SEGMENTS);
+    if (!first)
+    {
+        return kDmaError_NoDescriptor;
+    }
+
+    uint8_t * blockStart = (uint8_t *)dst;
+    uint8_t * next = blockStart + block;
+
+    fast_memset(blockStart, value, block);
+
+    // The block is written back before the lines it shares with the rest are discarded.
+    dma_sync_for_device(blockStart, block, kDmaToDevice);
+    if (remaining)
+    {
+        dma_sync_for_device(next, remaining, kDmaFromDevice);
+    }
+    else
+    {
+        next = blockStart;
+        remaining = block;
+    }
+
+    dma_descriptor_t * desc = first;
+    while (remaining)
+    {
+        uint32_t chunk = (remaining > block) ? block : remaining;
+
+        if (desc->count == DMA_MAX_SEGMENTS)
+        {
+            dma_close_descriptor(channel, desc);
+            desc = desc->next;
+        }
+
+        dma_add_segment(channel, desc, next, blockStart, chunk, false);
+        next += chunk;
+        remaining -= chunk;
+    }
+    dma_close_descriptor(channel, desc);
+
+    return dma_queue_request(channel, first, callback, arg);
+}
+
+bool dma_is_complete(dma_channel_t * channel, dma_cookie_t cookie)
+{
+    dma_cookie_t lastUsed = channel->lastCookie;
+    dma_cookie_t completed = channel->completedCookie;
+
+    if (completed <= lastUsed)
+    {
+        return (cookie <= completed) || (cookie > lastUsed);
+    }
+
+    // The cookies wrapped since the last completion.
+    return (cookie <= completed) && (cookie > lastUsed);
+}
+
+bool dma_fence_is_signaled(const dma_fence_t * fence)
+{
+    return !fence->channel || dma_is_complete(fence->channel, fence->cookie);
+}
+
+static bool dma_fence_condition(void * arg)
+{
+    return dma_fence_is_signaled((const dma_fence_t *)arg);
+}
+
+bool dma_fence_wait(const dma_fence_t * fence, uint32_t timeout)
+{
+    if (dma_fence_is_signaled(fence))
+    {
+        return true;
+    }
+
+    return wait_event_timeout(dma_fence_condition, (void *)fence, timeout, DMA_FENCE_POLL_US);
+}
+
+//! @brief Pick the least loaded async channel that still takes requests.
+static dma_channel_t * dma_select_async_channel(bool preferDcp)
+{
+    dma_channel_t * best = NULL;
+    uint32_t i;
+
+    for (i = 0; i < ARRAY_SIZE(s_asyncChannels); ++i)
+    {
+        dma_channel_t * channel = s_asyncChannels[i];
+        if (!channel || channel->depth >= DMA_ASYNC_MAX_QUEUE_DEPTH)
+        {
+            continue;
+        }
+
+        if (preferDcp && channel->type == kDmaEngine_Dcp)
+        {
+            return channel;
+        }
+
+        if (!best || channel->queuedBytes < best->queuedBytes)
+        {
+            best = channel;
+        }
+    }
+
+    return best;
+}
+
+//! @brief Report a request the CPU has done.
+static void dma_complete_on_cpu(dma_callback_t callback, void * arg, dma_fence_t * fence)
+{
+    if (fence)
+    {
+        fence->channel = NULL;
+        fence->cookie = 0;
+    }
+
+    if (callback)
+    {
+        callback(arg, kDmaSuccess);
+    }
+}
+
+int async_memcpy(void * dst, const void * src, uint32_t length, dma_callback_t callback, void * arg, dma_fence_t * fence)
+{
+    if (!dst || !src)
+    {
+        return kDmaError_InvalidArgument;
+    }
+
+    if (s_isInitialized && length >= DMA_ASYNC_CPU_THRESHOLD)
+    {
+        dma_channel_t * channel = dma_select_async_channel(false);
+        if (channel)
+        {
+            dma_sg_entry_t sg = { dst, src, length };
+            dma_cookie_t cookie = dma_submit_sg(channel, &sg, 1, callback, arg);
+            if (cookie > 0)
+            {
+                if (fence)
+                {
+                    fence->channel = channel;
+                    fence->cookie = cookie;
+                }
+                return kDmaSuccess;
+            }
+        }
+    }
+
+    fast_memcpy(dst, src, length);
+    dma_complete_on_cpu(callback, arg, fence);
+
+    return kDmaSuccess;
+}
+
+int async_memset(void * dst, uint8_t value, uint32_t length, dma_callback_t callback, void * arg, dma_fence_t * fence)
+{
+    if (!dst)
+    {
+        return kDmaError_InvalidArgument;
+    }
+
+    if (s_isInitialized && length >= DMA_ASYNC_CPU_THRESHOLD)
+    {
+        dma_channel_t * channel = dma_select_async_channel(true);
+        if (channel)
+        {
+            dma_cookie_t cookie = dma_submit_memset(channel, dst, value, length, callback, arg);
+            if (cookie > 0)
+            {
+                if (fence)
+                {
+                    fence->channel = channel;
+                    fence->cookie = cookie;
+                }
+                return kDmaSuccess;
+            }
+        }
+    }
+
+    fast_memset(dst, value, length);
+    dma_complete_on_cpu(callback, arg, fence);
+
+    return kDmaSuccess;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file dmaengine_test.c
+ * @brief Test of the asynchronous DMA engine.
+ *
+ * Runs scatter-gather copies and fills with odd alignments on every kind of channel, then
+ * floods async_memcpy() so that requests spill over to the CPU once the queues are full.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "sdk.h"
+#include "dmaengine/dmaengine.h"
+#include "core/dma_alloc.h"
+#include "timer/timer.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Size of each test buffer.
+#define TEST_BUFFER_SIZE (256 * 1024)
+
+//! @brief Number of async copies queued at once, more than all channels take.
+#define FLOOD_COUNT (32)
+
+//! @brief Time allowed for a request to complete, in microseconds.
+#define COMPLETION_TIMEOUT_US (1000000)
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void dmaengine_test(void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static uint8_t * s_src;
+static uint8_t * s_dst;
+
+//! @brief Number of callbacks that ran.
+static volatile uint32_t s_callbackCount;
+
+//! @brief Number of callbacks that reported an error.
+static volatile uint32_t s_errorCount;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+static void count_callback(void * arg, int status)
+{
+    ++s_callbackCount;
+    if (status != kDmaSuccess)
+    {
+        ++s_errorCount;
+    }
+}
+
+static void fill_pattern(uint8_t * buffer, uint32_t length, uint32_t seed)
+{
+    uint32_t i;
+    for (i = 0; i < length; ++i)
+    {
+        buffer[i] = (uint8_t)(i * 7 + seed);
+    }
+}
+
+static bool check_copy(const uint8_t * dst, const uint8_t * src, uint32_t length)
+{
+    uint32_t i;
+    for (i = 0; i < length; ++i)
+    {
+        if (dst[i] != src[i])
+        {
+            printf("  mismatch at 0x%08x: 0x%02x instead of 0x%02x\n", (uint32_t)&dst[i], dst[i], src[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check_fill(const uint8_t * dst, uint8_t value, uint32_t length)
+{
+    uint32_t i;
+    for (i = 0; i < length; ++i)
+    {
+        if (dst[i] != value)
+        {
+            printf("  mismatch at 0x%08x: 0x%02x instead of 0x%02x\n", (uint32_t)&dst[i], dst[i], value);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool wait_cookie(dma_channel_t * channel, dma_cookie_t cookie)
+{
+    dma_fence_t fence = { channel, cookie };
+
+    if (cookie <= 0)
+    {
+        printf("  submit failed with %d\n", cookie);
+        return false;
+    }
+
+    if (!dma_fence_wait(&fence, COMPLETION_TIMEOUT_US))
+    {
+        printf("  request %d timed out\n", cookie);
+        return false;
+    }
+
+    return true;
+}
+
+//! @brief Copy three misaligned pieces, one larger than an SDMA segment, and fill around them.
+static bool test_channel(dma_channel_t * channel)
+{
+    static const char * const k_names[] = { "sdma", "dcp" };
+    dma_sg_entry_t sg[3];
+    bool isOk = true;
+
+    printf("  %s channel\n", k_names[dma_channel_get_type(channel)]);
+
+    fill_pattern(s_src, TEST_BUFFER_SIZE, 0x11);
+    memset(s_dst, 0, TEST_BUFFER_SIZE);
+
+    sg[0].dst = s_dst + 1;
+    sg[0].src = s_src + 3;
+    sg[0].length = 100;
+    sg[1].dst = s_dst + 0x1000;
+    sg[1].src = s_src + 0x1002;
+    sg[1].length = 0x12345;
+    sg[2].dst = s_dst + 0x20000;
+    sg[2].src = s_src + 0x20000;
+    sg[2].length = 0x8000;
+
+    s_callbackCount = 0;
+    s_errorCount = 0;
+    isOk = wait_cookie(channel, dma_submit_sg(channel, sg, 3, count_callback, NULL)) && isOk;
+    isOk = check_copy(sg[0].dst, sg[0].src, sg[0].length) && isOk;
+    isOk = check_copy(sg[1].dst, sg[1].src, sg[1].length) && isOk;
+    isOk = check_copy(sg[2].dst, sg[2].src, sg[2].length) && isOk;
+    isOk = check_fill(s_dst, 0, 1) && check_fill(s_dst + 101, 0, 0x1000 - 101) && isOk;
+
+    isOk = wait_cookie(channel, dma_submit_memset(channel, s_dst + 5, 0xa5, 50000, count_callback, NULL)) && isOk;
+    isOk = check_fill(s_dst + 5, 0xa5, 50000) && isOk;
+    isOk = check_fill(s_dst + 50005, 0, 1) && isOk;
+
+    isOk = wait_cookie(channel, dma_submit_memset(channel, s_dst + 7, 0x3c, 1, count_callback, NULL)) && isOk;
+    isOk = check_fill(s_dst + 7, 0x3c, 1) && check_fill(s_dst + 8, 0xa5, 1) && isOk;
+
+    if (s_callbackCount != 3 || s_errorCount)
+    {
+        printf("  %d callbacks with %d errors, expected 3 without errors\n", s_callbackCount, s_errorCount);
+        isOk = false;
+    }
+
+    return isOk;
+}
+
+//! @brief Queue more async copies than the channels take and check them all.
+static bool test_async_flood(void)
+{
+    uint32_t chunk = TEST_BUFFER_SIZE / FLOOD_COUNT;
+    dma_fence_t fences[FLOOD_COUNT];
+    uint32_t onCpu = 0;
+    uint32_t i;
+    bool isOk = true;
+
+    fill_pattern(s_src, TEST_BUFFER_SIZE, 0x5a);
+    memset(s_dst, 0, TEST_BUFFER_SIZE);
+    s_callbackCount = 0;
+    s_errorCount = 0;
+
+    uint64_t start = time_get_microseconds();
+    for (i = 0; i < FLOOD_COUNT; ++i)
+    {
+        async_memcpy(s_dst + i * chunk, s_src + i * chunk, chunk, count_callback, NULL, &fences[i]);
+        if (!fences[i].channel)
+        {
+            ++onCpu;
+        }
+    }
+    uint64_t queued = time_get_microseconds();
+
+    for (i = 0; i < FLOOD_COUNT; ++i)
+    {
+        if (!dma_fence_wait(&fences[i], COMPLETION_TIMEOUT_US))
+        {
+            printf("  copy %d timed out\n", i);
+            isOk = false;
+        }
+    }
+    uint64_t done = time_get_microseconds();
+
+    printf("  %d copies of %d bytes, %d on the cpu: queued in %d us, done in %d us\n",
+           FLOOD_COUNT, chunk, onCpu, (uint32_t)(queued - start), (uint32_t)(done - start));
+
+    isOk = check_copy(s_dst, s_src, TEST_BUFFER_SIZE) && isOk;
+
+    // Short requests always go to the CPU and are done right away.
+    dma_fence_t fence;
+    async_memset(s_dst, 0x77, DMA_ASYNC_CPU_THRESHOLD - 1, count_callback, NULL, &fence);
+    if (fence.channel || !check_fill(s_dst, 0x77, DMA_ASYNC_CPU_THRESHOLD - 1))
+    {
+        printf("  short memset was not done by the cpu\n");
+        isOk = false;
+    }
+
+    async_memset(s_dst, 0x99, TEST_BUFFER_SIZE, count_callback, NULL, &fence);
+    if (!dma_fence_wait(&fence, COMPLETION_TIMEOUT_US))
+    {
+        printf("  memset timed out\n");
+        isOk = false;
+    }
+    isOk = check_fill(s_dst, 0x99, TEST_BUFFER_SIZE) && isOk;
+
+    if (s_callbackCount != FLOOD_COUNT + 2 || s_errorCount)
+    {
+        printf("  %d callbacks with %d errors, expected %d without errors\n", s_callbackCount, s_errorCount, FLOOD_COUNT + 2);
+        isOk = false;
+    }
+
+    return isOk;
+}
+
+void dmaengine_test(void)
+{
+    dma_channel_t * channel;
+    bool isOk = true;
+
+    printf("Running the dma engine test\n");
+
+    if (dma_engine_init() != kDmaSuccess)
+    {
+        printf("  initialization failed\n");
+        return;
+    }
+
+    s_src = (uint8_t *)dma_alloc_streaming(TEST_BUFFER_SIZE, 0);
+    s_dst = (uint8_t *)dma_alloc_streaming(TEST_BUFFER_SIZE, 0);
+    if (!s_src || !s_dst)
+    {
+        printf("  buffer allocation failed\n");
+        dma_free_streaming(s_src);
+        dma_free_streaming(s_dst);
+        return;
+    }
+
+    channel = dma_request_channel(kDmaEngine_Sdma);
+    if (channel)
+    {
+        isOk = test_channel(channel) && isOk;
+        dma_release_channel(channel);
+    }
+    else
+    {
+        printf("  no sdma channel\n");
+        isOk = false;
+    }
+
+#if defined(CHIP_MX6SL)
+    channel = dma_request_channel(kDmaEngine_Dcp);
+    if (channel)
+    {
+        isOk = test_channel(channel) && isOk;
+        dma_release_channel(channel);
+    }
+    else
+    {
+        printf("  no dcp channel\n");
+        isOk = false;
+    }
+#endif
+
+    isOk = test_async_flood() && isOk;
+
+    dma_free_streaming(s_src);
+    dma_free_streaming(s_dst);
+
+    printf("Dma engine test %s\n", isOk ? "PASSED" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
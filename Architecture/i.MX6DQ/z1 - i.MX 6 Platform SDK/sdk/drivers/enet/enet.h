@@ -168,15 +168,44 @@ int imx_enet_recv(imx_enet_priv_t * dev, unsigned char *buf, int *length);
 
 /*! 
  * @brief Transmit ENET packet
+ *
+ * If the MAC still owns the next TX buffer descriptor, frames queued with
+ * imx_enet_send_queued() are started and the call waits for the descriptor.
+ *
  * @param dev    a pointer of ENET interface(imx_enet_priv_t) 
  * @param buf       a pointer of buffer for packet to be sent
  * @param length the length of packet to be sent
  * @param key        key
  *
- * @return      zero
+ * @return      0 if succeeded,
+ *          -1 if the MAC did not release a TX buffer descriptor in time
  */
 int imx_enet_send(imx_enet_priv_t * dev, unsigned char *buf, int length, unsigned long key);
 
+/*!
+ * @brief Queue ENET packet without starting transmission
+ *
+ * Same as imx_enet_send(), but the MAC is not told about the new frame until
+ * imx_enet_send_flush() is called, so a burst of frames costs a single TDAR write.
+ *
+ * @param dev    a pointer of ENET interface(imx_enet_priv_t)
+ * @param buf        a pointer of buffer for packet to be sent
+ * @param length the length of packet to be sent
+ * @param key        key
+ *
+ * @return      0 if succeeded,
+ *          -1 if the TX ring is full
+ */
+int imx_enet_send_queued(imx_enet_priv_t * dev, unsigned char *buf, int length, unsigned long key);
+
+/*!
+ * @brief Start transmission of the frames queued by imx_enet_send_queued()
+ * @param dev    a pointer of ENET interface(imx_enet_priv_t)
+ *
+ * @return      none
+ */
+void imx_enet_send_flush(imx_enet_priv_t * dev);
+
 /*!
  * @brief Switch the PHY to external loopback mode for testing.
  */
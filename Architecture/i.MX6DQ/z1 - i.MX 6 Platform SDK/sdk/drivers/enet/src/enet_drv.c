@@ -38,30 +38,27 @@
 #include "sdk.h"
 #include "enet/enet.h"
 #include "enet_private.h"
+#include "core/cortex_a9.h"
+#include "core/dma_alloc.h"
+#include "utility/fast_string.h"
 
-/*!
- *Global variable which defines the buffer descriptions for receiving frame
- * 	comment:: it must aligned by 128-bits.
- */
-static imx_enet_bd_t imx_enet_rx_bd[ENET_BD_RX_NUM * NUM_OF_ETH_DEVS] __attribute__ ((aligned(32)));
-
-/*!
- *Global variable which defines the buffer descriptions for receiving frame
- * 	comment:: it must aligned by 128-bits.
- */
-static imx_enet_bd_t imx_enet_tx_bd[ENET_BD_TX_NUM * NUM_OF_ETH_DEVS] __attribute__ ((aligned(32)));
+/*! Size of each frame buffer, a multiple of the cache line size. */
+#define ENET_BUF_SIZE 2048
 
 /*!
- * Global variable which contains the frame buffers ,
+ * Buffer descriptor rings, shared with the MAC and so allocated from the
+ * coherent pool the first time a device is initialized.
+ * 	comment:: they must be aligned by 128-bits.
  */
-static unsigned char imx_enet_rx_buf[ENET_BD_RX_NUM * NUM_OF_ETH_DEVS][2048]
-    __attribute__ ((aligned(32)));
+static imx_enet_bd_t *imx_enet_rx_bd = NULL;
+static imx_enet_bd_t *imx_enet_tx_bd = NULL;
 
 /*!
- * Global variable which contains the frame buffers ,
+ * Frame buffers. They are cacheable streaming buffers, so each one is synced
+ * with the MAC around every transfer.
  */
-static unsigned char imx_enet_tx_buf[ENET_BD_TX_NUM * NUM_OF_ETH_DEVS][2048]
-    __attribute__ ((aligned(32)));
+static unsigned char *imx_enet_rx_buf = NULL;
+static unsigned char *imx_enet_tx_buf = NULL;
 
 /*!
  * This function gets the value of the PHY registers through the MII interface.
@@ -124,11 +121,32 @@ int imx_enet_mii_write(volatile hw_enet_t * enet_reg, unsigned char phy_addr,
 /*!
  * The function initializes the description buffer for receiving or transmitting.
  */
-static void imx_enet_bd_init(imx_enet_priv_t * dev, int dev_idx)
+static int imx_enet_bd_init(imx_enet_priv_t * dev, int dev_idx)
 {
     int i;
     imx_enet_bd_t *p;
-    imx_enet_bd_t *rx_bd_base = imx_enet_rx_bd, *tx_bd_base = imx_enet_tx_bd;
+    imx_enet_bd_t *rx_bd_base, *tx_bd_base;
+
+    if (imx_enet_rx_bd == NULL) {
+        imx_enet_rx_bd = dma_alloc_coherent(sizeof(imx_enet_bd_t) * ENET_BD_RX_NUM * NUM_OF_ETH_DEVS, 16);
+        imx_enet_tx_bd = dma_alloc_coherent(sizeof(imx_enet_bd_t) * ENET_BD_TX_NUM * NUM_OF_ETH_DEVS, 16);
+        imx_enet_rx_buf = dma_alloc_streaming(ENET_BUF_SIZE * ENET_BD_RX_NUM * NUM_OF_ETH_DEVS, 0);
+        imx_enet_tx_buf = dma_alloc_streaming(ENET_BUF_SIZE * ENET_BD_TX_NUM * NUM_OF_ETH_DEVS, 0);
+
+        if (!imx_enet_rx_bd || !imx_enet_tx_bd || !imx_enet_rx_buf || !imx_enet_tx_buf) {
+            printf("ENET: failed to allocate the DMA rings\n");
+            dma_free_coherent(imx_enet_rx_bd);
+            dma_free_coherent(imx_enet_tx_bd);
+            dma_free_streaming(imx_enet_rx_buf);
+            dma_free_streaming(imx_enet_tx_buf);
+            imx_enet_rx_bd = imx_enet_tx_bd = NULL;
+            imx_enet_rx_buf = imx_enet_tx_buf = NULL;
+            return -1;
+        }
+    }
+
+    rx_bd_base = imx_enet_rx_bd;
+    tx_bd_base = imx_enet_tx_bd;
 
     rx_bd_base += (dev_idx * ENET_BD_RX_NUM);
     tx_bd_base += (dev_idx * ENET_BD_TX_NUM);
@@ -138,26 +156,29 @@ static void imx_enet_bd_init(imx_enet_priv_t * dev, int dev_idx)
     for (i = 0; i < ENET_BD_RX_NUM; i++, p++) {
         p->status = BD_RX_ST_EMPTY;
         p->length = 0;
-        p->data = (unsigned char *)imx_enet_rx_buf[i + dev_idx * ENET_BD_RX_NUM];
+        p->data = imx_enet_rx_buf + (i + dev_idx * ENET_BD_RX_NUM) * ENET_BUF_SIZE;
         //printf("rx bd %x, buffer is %x\n", (unsigned int)p, (unsigned int)p->data);
     }
 
     dev->rx_bd[i - 1].status |= BD_RX_ST_WRAP;
     dev->rx_cur = dev->rx_bd;
 
+    /* the MAC owns the receive buffers until a frame is handed back */
+    dma_sync_for_device(dev->rx_bd[0].data, ENET_BUF_SIZE * ENET_BD_RX_NUM, kDmaFromDevice);
+
     p = dev->tx_bd = (imx_enet_bd_t *) tx_bd_base;
 
     for (i = 0; i < ENET_BD_TX_NUM; i++, p++) {
         p->status = 0;
         p->length = 0;
-        p->data = (unsigned char *)imx_enet_tx_buf[i + dev_idx * ENET_BD_TX_NUM];
+        p->data = imx_enet_tx_buf + (i + dev_idx * ENET_BD_TX_NUM) * ENET_BUF_SIZE;
         //printf("tx bd %x, buffer is %x\n", (unsigned int)p, (unsigned int)p->data);
     }
 
     dev->tx_bd[i - 1].status |= BD_TX_ST_WRAP;
     dev->tx_cur = dev->tx_bd;
 
-    /*TODO:: add the sync function for items */
+    return 0;
 }
 
 /*!
@@ -491,12 +512,16 @@ unsigned long imx_enet_poll(imx_enet_priv_t * dev)
     return value;
 }
 
-int imx_enet_send(imx_enet_priv_t * dev, unsigned char *buf, int length, unsigned long key)
+/*!
+ * Fill the next TX buffer descriptor and hand it to the MAC, without
+ * telling the MAC that a new descriptor is ready.
+ */
+static void imx_enet_fill_tx_bd(imx_enet_priv_t * dev, unsigned char *buf, int length, unsigned long key)
 {
-    volatile hw_enet_t *enet_reg = dev->enet_reg;
     imx_enet_bd_t *p = dev->tx_cur;
 
-    memcpy(p->data, buf, length);
+    fast_memcpy(p->data, buf, length);
+    dma_sync_for_device(p->data, length, kDmaToDevice);
 
     p->length = length;
     p->status &= ~(BD_TX_ST_LAST | BD_TX_ST_RDY | BD_TX_ST_TC | BD_TX_ST_ABC);
@@ -510,11 +535,51 @@ int imx_enet_send(imx_enet_priv_t * dev, unsigned char *buf, int length, unsigne
     dev->tx_cur = p;
     dev->tx_busy = 1;
     dev->tx_key = key;
+}
+
+int imx_enet_send(imx_enet_priv_t * dev, unsigned char *buf, int length, unsigned long key)
+{
+    volatile hw_enet_t *enet_reg = dev->enet_reg;
+
+    if (dev->tx_cur->status & BD_TX_ST_RDY) {
+        /*
+         * Ring full: start whatever is queued so the MAC frees descriptors,
+         * and let the caller drop or retry the frame instead of spinning here.
+         */
+        _ARM_DSB();
+        enet_reg->TDAR.U = ENET_RX_TX_ACTIVE;
+        return -1;
+    }
+
+    imx_enet_fill_tx_bd(dev, buf, length, key);
+
+    /* make the descriptor visible to the MAC before kicking it */
+    _ARM_DSB();
     enet_reg->TDAR.U = ENET_RX_TX_ACTIVE;
 
     return 0;
 }
 
+int imx_enet_send_queued(imx_enet_priv_t * dev, unsigned char *buf, int length, unsigned long key)
+{
+    if (dev->tx_cur->status & BD_TX_ST_RDY) {
+        /* ring full, the MAC still owns the next descriptor */
+        return -1;
+    }
+
+    imx_enet_fill_tx_bd(dev, buf, length, key);
+
+    return 0;
+}
+
+void imx_enet_send_flush(imx_enet_priv_t * dev)
+{
+    volatile hw_enet_t *enet_reg = dev->enet_reg;
+
+    _ARM_DSB();
+    enet_reg->TDAR.U = ENET_RX_TX_ACTIVE;
+}
+
 int imx_enet_recv(imx_enet_priv_t * dev, unsigned char *buf, int *length)
 {
     imx_enet_bd_t *p = dev->rx_cur;
@@ -532,10 +597,15 @@ int imx_enet_recv(imx_enet_priv_t * dev, unsigned char *buf, int *length)
     if ((p->status & BD_RX_ST_ERRS) || (p->length > ENET_FRAME_LEN)) {
         printf("BUG1[RX]: status=%x, length=%x\n", p->status, p->length);
     } else {
-        memcpy(buf, p->data, p->length - 4);
+        dma_sync_for_cpu(p->data, p->length - 4, kDmaFromDevice);
+        fast_memcpy(buf, p->data, p->length - 4);
         *length = p->length - 4;
     }
 
+    /*
+     * The CPU only read the buffer, so it holds no dirty lines and goes back
+     * to the MAC without another sync.
+     */
     p->status = (p->status & BD_RX_ST_WRAP) | BD_RX_ST_EMPTY;
 
     if (p->status & BD_RX_ST_WRAP) {
@@ -545,6 +615,7 @@ int imx_enet_recv(imx_enet_priv_t * dev, unsigned char *buf, int *length)
     }
 
     dev->rx_cur = p;
+    _ARM_DSB();
     enet_reg->ECR.U |= ENET_ETHER_EN;
     enet_reg->RDAR.U |= ENET_RX_TX_ACTIVE;
 
@@ -558,7 +629,8 @@ int imx_enet_init(imx_enet_priv_t * dev, unsigned long reg_base, int phy_addr)
     dev->status = 0;
     dev->phy_addr = phy_addr;   /* 0 or 1 */
 
-    imx_enet_bd_init(dev, phy_addr);
+    if (imx_enet_bd_init(dev, phy_addr) != 0)
+        return -1;
 
     imx_enet_chip_init(dev);
 
@@ -168,15 +168,44 @@ int imx_fec_recv(imx_fec_priv_t * dev, unsigned char *buf, int *length);
 
 /*! 
  * @brief Transmit FEC packet
+ *
+ * If the MAC still owns the next TX buffer descriptor, frames queued with
+ * imx_fec_send_queued() are started and the call waits for the descriptor.
+ *
  * @param dev    a pointer of FEC interface(imx_fec_priv_t) 
  * @param buf        a pointer of buffer for packet to be sent
  * @param length the length of packet to be sent
  * @param key        key
  *
- * @return      zero
+ * @return      0 if succeeded,
+ *          -1 if the MAC did not release a TX buffer descriptor in time
  */
 int imx_fec_send(imx_fec_priv_t * dev, unsigned char *buf, int length, unsigned long key);
 
+/*!
+ * @brief Queue FEC packet without starting transmission
+ *
+ * Same as imx_fec_send(), but the MAC is not told about the new frame until
+ * imx_fec_send_flush() is called, so a burst of frames costs a single TDAR write.
+ *
+ * @param dev    a pointer of FEC interface(imx_fec_priv_t)
+ * @param buf        a pointer of buffer for packet to be sent
+ * @param length the length of packet to be sent
+ * @param key        key
+ *
+ * @return      0 if succeeded,
+ *          -1 if the TX ring is full
+ */
+int imx_fec_send_queued(imx_fec_priv_t * dev, unsigned char *buf, int length, unsigned long key);
+
+/*!
+ * @brief Start transmission of the frames queued by imx_fec_send_queued()
+ * @param dev    a pointer of FEC interface(imx_fec_priv_t)
+ *
+ * @return      none
+ */
+void imx_fec_send_flush(imx_fec_priv_t * dev);
+
 #if defined(__cplusplus)
 }
 #endif
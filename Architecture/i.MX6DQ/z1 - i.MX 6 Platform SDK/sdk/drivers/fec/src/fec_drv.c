@@ -302,9 +302,12 @@ unsigned long imx_fec_poll(imx_fec_priv_t * dev)
     return value;
 }
 
-int imx_fec_send(imx_fec_priv_t * dev, unsigned char *buf, int length, unsigned long key)
+/*!
+ * Fill the next TX buffer descriptor and hand it to the MAC, without
+ * telling the MAC that a new descriptor is ready.
+ */
+static void imx_fec_fill_tx_bd(imx_fec_priv_t * dev, unsigned char *buf, int length, unsigned long key)
 {
-    volatile hw_fec_t *fec_reg = dev->fec_reg;
     imx_fec_bd_t *p = dev->tx_cur;
 
     memcpy(p->data, buf, length);
@@ -321,11 +324,46 @@ int imx_fec_send(imx_fec_priv_t * dev, unsigned char *buf, int length, unsigned
     dev->tx_cur = p;
     dev->tx_busy = 1;
     dev->tx_key = key;
+}
+
+int imx_fec_send(imx_fec_priv_t * dev, unsigned char *buf, int length, unsigned long key)
+{
+    volatile hw_fec_t *fec_reg = dev->fec_reg;
+
+    if (dev->tx_cur->status & BD_TX_ST_RDY) {
+        /*
+         * Ring full: start whatever is queued so the MAC frees descriptors,
+         * and let the caller drop or retry the frame instead of spinning here.
+         */
+        fec_reg->TDAR.U = FEC_RX_TX_ACTIVE;
+        return -1;
+    }
+
+    imx_fec_fill_tx_bd(dev, buf, length, key);
     fec_reg->TDAR.U = FEC_RX_TX_ACTIVE;
 
     return 0;
 }
 
+int imx_fec_send_queued(imx_fec_priv_t * dev, unsigned char *buf, int length, unsigned long key)
+{
+    if (dev->tx_cur->status & BD_TX_ST_RDY) {
+        /* ring full, the MAC still owns the next descriptor */
+        return -1;
+    }
+
+    imx_fec_fill_tx_bd(dev, buf, length, key);
+
+    return 0;
+}
+
+void imx_fec_send_flush(imx_fec_priv_t * dev)
+{
+    volatile hw_fec_t *fec_reg = dev->fec_reg;
+
+    fec_reg->TDAR.U = FEC_RX_TX_ACTIVE;
+}
+
 int imx_fec_recv(imx_fec_priv_t * dev, unsigned char *buf, int *length)
 {
     imx_fec_bd_t *p = dev->rx_cur;
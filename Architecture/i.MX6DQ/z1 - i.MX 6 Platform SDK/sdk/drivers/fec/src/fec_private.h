@@ -133,7 +133,11 @@
 /*the defines of buffer description*/
 #define FEC_BD_RX_NUM   8
 
-#define FEC_BD_TX_NUM   2
+/*
+ * Room for a whole TCP GSO super-segment: TCP_GSO_MAX_SIZE cut at a 1460-byte
+ * MSS is 45 frames. A send into a full ring fails rather than waiting.
+ */
+#define FEC_BD_TX_NUM   64
 
 #define BD_RX_ST_EMPTY 0x8000
 
@@ -32,6 +32,8 @@
 
 #include "sdk.h"
 #include "bch_ecc.h"
+#include "utility/block_queue.h"
+#include "utility/nand_ftl.h"
 
 /*!
  * @file gpmi.h
@@ -125,6 +127,17 @@ enum _nand_gpmi_dma_wait_mask {
 #define ERROR_DDI_NAND_HAL_WRITE_FAILED (5)
 //@}
 
+//! @brief One page of an operation spread across chip selects.
+//!
+//! See gpmi_nand_read_interleaved() and gpmi_nand_write_interleaved().
+typedef struct _gpmi_nand_page_op {
+    unsigned chipSelect;    //!< Chip select of the NAND, different for every page of an operation.
+    uint32_t pageNumber;    //!< Page on that NAND.
+    uint8_t * buffer;       //!< Page data, word aligned.
+    uint8_t * auxBuffer;    //!< Metadata and ECC status of the page, word aligned.
+    int status;             //!< Set to the result for this page when the operation returns.
+} gpmi_nand_page_op_t;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Prototypes
 ////////////////////////////////////////////////////////////////////////////////
@@ -217,6 +230,32 @@ void gpmi_enable_writes(bool doEnable);
 ////////////////////////////////////////////////////////////////////////////////
 int gpmi_run_dma(apbh_dma_t * theDma, unsigned chipSelect, uint16_t waitMask, uint32_t timeout);
 
+////////////////////////////////////////////////////////////////////////////////
+//! @brief Start a DMA descriptor chain without waiting for it.
+//!
+//! This is the first half of gpmi_run_dma(). The caller can do other work while the DMA
+//! runs, but must call gpmi_wait_for_dma() before starting another one.
+//!
+//! @param[in] theDma Pointer to dma command structure.
+//! @param[in] chipSelect Which NAND chip select should be started.
+//! @param[in] waitMask A bitmask used to indicate criteria for terminating the DMA.
+//!
+//! @retval SUCCESS The DMA is started.
+//! @retval ERROR_DDI_NAND_GPMI_DMA_BUSY Another DMA is already running.
+////////////////////////////////////////////////////////////////////////////////
+int gpmi_start_dma(apbh_dma_t * theDma, unsigned chipSelect, uint16_t waitMask);
+
+////////////////////////////////////////////////////////////////////////////////
+//! @brief Wait for a DMA started with gpmi_start_dma() to complete.
+//!
+//! @param[in] u32usec Number of microseconds to wait before timing out.
+//! @param[in] chipSelect The chip select passed to gpmi_start_dma().
+//!
+//! @retval SUCCESS The DMA completed.
+//! @retval ERROR_DDI_NAND_GPMI_DMA_TIMEOUT The DMA did not complete in time.
+////////////////////////////////////////////////////////////////////////////////
+int gpmi_wait_for_dma(uint32_t u32usec, uint32_t chipSelect);
+
 ////////////////////////////////////////////////////////////////////////////////
 //! @brief Returns a Boolean indicating if a DMA is currently running.
 //!
@@ -280,7 +319,7 @@ const GpmiNandTimings_t * gpmi_get_current_timings();
 //! @name Common NAND operations
 //!
 //! These functions are used to perform the common set of NAND read and write operations. They
-//! will build an appropriate DMA chain and execute it synchronously.
+//! build an appropriate DMA chain, or patch one prebuilt by gpmi_nand_configure(), and execute it.
 //@{
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -331,6 +370,104 @@ int gpmi_nand_read_metadata(unsigned chipSelect, uint32_t pageNumber, uint8_t *
 ////////////////////////////////////////////////////////////////////////////////
 int gpmi_nand_write_page(unsigned chipSelect, uint32_t pageNumber, const uint8_t * buffer, const uint8_t * auxBuffer);
 
+////////////////////////////////////////////////////////////////////////////////
+//! @brief Enable or disable the use of cache commands by the multi-page operations.
+//!
+//! gpmi_nand_configure() enables them. NANDs that do not support the read cache and
+//! program cache commands need them disabled, in which case gpmi_nand_read_pages() and
+//! gpmi_nand_write_pages() transfer one page at a time.
+////////////////////////////////////////////////////////////////////////////////
+void gpmi_nand_enable_cache_commands(bool enable);
+
+////////////////////////////////////////////////////////////////////////////////
+//! @brief Read consecutive pages using ECC.
+//!
+//! Up to eight pages of a block are read by a single DMA chain using the read cache
+//! commands, so the NAND loads each page while the previous one is transferred. The ECC
+//! results of each group of pages are checked while the next group is read.
+//!
+//! @param chipSelect Chip select of the NAND.
+//! @param firstPage First page to read.
+//! @param pageCount Number of pages to read.
+//! @param buffer Receives the page data, one page after the other.
+//! @param auxBuffer Receives the metadata and ECC status of each page.
+//! @param auxStride Distance in bytes between the aux areas of two pages, a multiple of 4.
+//!
+//! @retval SUCCESS All pages were read.
+//! @retval ERROR_DDI_NAND_GPMI_UNCORRECTABLE_ECC All pages were read, but at least one of
+//!     them has uncorrectable bit errors.
+//! @retval ERROR_DDI_NAND_GPMI_DMA_TIMEOUT
+////////////////////////////////////////////////////////////////////////////////
+int gpmi_nand_read_pages(unsigned chipSelect, uint32_t firstPage, uint32_t pageCount, uint8_t * buffer, uint8_t * auxBuffer, uint32_t auxStride);
+
+////////////////////////////////////////////////////////////////////////////////
+//! @brief Write consecutive erased pages using ECC.
+//!
+//! Up to eight pages of a block are written by a single DMA chain using the program cache
+//! command, so each page is transferred while the previous one is programmed. The buffer
+//! layout is the same as for gpmi_nand_read_pages().
+//!
+//! @retval SUCCESS
+//! @retval ERROR_DDI_NAND_HAL_WRITE_FAILED A page failed to program. Pages after the group
+//!     it belongs to are not written.
+////////////////////////////////////////////////////////////////////////////////
+int gpmi_nand_write_pages(unsigned chipSelect, uint32_t firstPage, uint32_t pageCount, const uint8_t * buffer, const uint8_t * auxBuffer, uint32_t auxStride);
+
+////////////////////////////////////////////////////////////////////////////////
+//! @brief Read one page from each of several NANDs using ECC.
+//!
+//! The read command is sent to all NANDs before waiting, so their array reads overlap.
+//!
+//! @param ops Pages to read, at most one per chip select.
+//! @param count Number of entries in @a ops, up to #GPMI_CHIP_SELECT_COUNT.
+//!
+//! @return SUCCESS, or the first error of any of the pages.
+////////////////////////////////////////////////////////////////////////////////
+int gpmi_nand_read_interleaved(gpmi_nand_page_op_t * ops, unsigned count);
+
+////////////////////////////////////////////////////////////////////////////////
+//! @brief Write one page to each of several NANDs using ECC.
+//!
+//! All pages are transferred before waiting, so the NANDs program at the same time.
+//!
+//! @param ops Pages to write, at most one per chip select.
+//! @param count Number of entries in @a ops, up to #GPMI_CHIP_SELECT_COUNT.
+//!
+//! @return SUCCESS, or the first error of any of the pages.
+////////////////////////////////////////////////////////////////////////////////
+int gpmi_nand_write_interleaved(gpmi_nand_page_op_t * ops, unsigned count);
+
+////////////////////////////////////////////////////////////////////////////////
+//! @brief Set up a read-only block device of ECC pages for a request queue.
+//!
+//! Sectors of the device are pages of @a pageSize bytes. Writes fail with #kBlkInvalid, since
+//! pages have to be erased before they are written again.
+//!
+//! @param device Filled in with the device description.
+//! @param chipSelect Chip select of the NAND.
+//! @param pageSize Size of the page data read by gpmi_nand_read_page().
+//! @param pageCount Number of pages of the NAND.
+//! @param auxBuffer DMA buffer for the metadata and ECC status of a page.
+////////////////////////////////////////////////////////////////////////////////
+void gpmi_nand_blk_device_init(blk_device_t * device, unsigned chipSelect, uint32_t pageSize, uint32_t pageCount, uint8_t * auxBuffer);
+
+////////////////////////////////////////////////////////////////////////////////
+//! @brief Set up the NAND access of a flash translation layer.
+//!
+//! Pages are read and programmed with ECC, keeping the FTL spare area in the metadata after
+//! the bad block marker byte, so the BCH layout needs at least 1 + #FTL_SPARE_BYTES metadata
+//! bytes.
+//!
+//! @param nand Filled in with the NAND access.
+//! @param chipSelect Chip select of the NAND.
+//! @param pageSize Size of the page data read by gpmi_nand_read_page().
+//! @param pagesPerBlock Pages of an erase block.
+//! @param blockCount Erase blocks of the NAND.
+//! @param refreshBitErrors Corrected bit errors at which a read asks the FTL to move the page.
+//! @param auxBuffer DMA buffer for the metadata and ECC status of a page.
+////////////////////////////////////////////////////////////////////////////////
+void gpmi_nand_ftl_init(ftl_nand_t * nand, unsigned chipSelect, uint32_t pageSize, uint32_t pagesPerBlock, uint32_t blockCount, uint32_t refreshBitErrors, uint8_t * auxBuffer);
+
 //@}
 
 //! @name Application APIs
@@ -916,6 +916,18 @@ int gpmi_wait_for_dma(uint32_t u32usec, uint32_t chipSelect)
 }
 
 int gpmi_run_dma(apbh_dma_t * theDma, unsigned chipSelect, uint16_t waitMask, uint32_t timeout)
+{
+    int rtStatus = gpmi_start_dma(theDma, chipSelect, waitMask);
+
+    if (rtStatus == SUCCESS)
+    {
+        rtStatus = gpmi_wait_for_dma(timeout, chipSelect);
+    }
+
+    return rtStatus;
+}
+
+int gpmi_start_dma(apbh_dma_t * theDma, unsigned chipSelect, uint16_t waitMask)
 {
     uint32_t    physicalCommandAddress;
     reg32_t     r32ChipDmaNumber        = (NAND0_APBH_CH); //+chipSelect);
@@ -979,8 +991,6 @@ int gpmi_run_dma(apbh_dma_t * theDma, unsigned chipSelect, uint16_t waitMask, ui
     // function above to determine timeouts.
     g_gpmi.dmaInfo.uStartDMATime = time_get_microseconds();
 
-    rtStatus = gpmi_wait_for_dma(timeout, chipSelect);
-
 _standardExit:
 
     return rtStatus;
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file gpmi_blk.c
+ * @brief Read-only block device for a request queue on top of the ECC page reads.
+ *
+ * Sectors are NAND pages. Raw NAND has to be erased a block at a time before it is written,
+ * so writes are left to a flash translation layer and fail here.
+ */
+
+#include "gpmi/gpmi.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Largest request in pages.
+#define GPMI_BLK_MAX_PAGES (64)
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Chip select and aux buffer of the device.
+static struct {
+    unsigned chipSelect;
+    uint8_t * auxBuffer;
+} s_gpmiBlk;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Read the pages of a request one by one and complete it.
+static int gpmi_blk_submit(blk_device_t * device, blk_request_t * request)
+{
+    uint32_t page = request->sector;
+    int status = kBlkSuccess;
+    blk_bio_t * bio;
+    uint32_t i;
+
+    if (request->op == kBlkWrite)
+    {
+        return kBlkInvalid;
+    }
+
+    for (bio = request->bios; bio && status == kBlkSuccess; bio = bio->next)
+    {
+        uint8_t * buffer = (uint8_t *)bio->buffer;
+
+        for (i = 0; i < bio->count; ++i, ++page, buffer += device->sectorSize)
+        {
+            if (gpmi_nand_read_page(s_gpmiBlk.chipSelect, page, buffer, s_gpmiBlk.auxBuffer) != SUCCESS)
+            {
+                status = kBlkError;
+                break;
+            }
+        }
+    }
+
+    blk_request_complete(request, status);
+    return kBlkSuccess;
+}
+
+void gpmi_nand_blk_device_init(blk_device_t * device, unsigned chipSelect, uint32_t pageSize,
+                               uint32_t pageCount, uint8_t * auxBuffer)
+{
+    s_gpmiBlk.chipSelect = chipSelect;
+    s_gpmiBlk.auxBuffer = auxBuffer;
+
+    device->name = "nand";
+    device->sectorSize = pageSize;
+    device->sectorCount = pageCount;
+    device->maxSectors = GPMI_BLK_MAX_PAGES;
+    device->maxSegments = 0;
+    device->queueDepth = 1;
+    device->submit = gpmi_blk_submit;
+    device->poll = NULL;
+    device->context = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -38,6 +38,17 @@ using namespace NandDma;
 // Code
 ////////////////////////////////////////////////////////////////////////////////
 
+//! @brief Fill in the column and row address bytes following a command byte.
+static void fill_address(uint8_t * addressBytes, uint32_t col, uint32_t row)
+{
+    addressBytes[0] = col & 0xff;
+    addressBytes[1] = (col >> 8) & 0xff;
+    addressBytes[2] = row & 0xff;
+    addressBytes[3] = (row >> 8) & 0xff;
+    addressBytes[4] = (row >> 16) & 0xff;
+    addressBytes[5] = (row >> 24) & 0xff;
+}
+
 void Sequence::init(unsigned chipSelect)
 {
     m_chipSelect = chipSelect;
@@ -50,6 +61,18 @@ int Sequence::run(uint32_t timeoutMicroseconds)
     return gpmi_run_dma(this->getFirstDescriptor(), m_chipSelect, getDmaWaitMask(), timeoutMicroseconds);
 }
 
+int Sequence::start(uint32_t timeoutMicroseconds)
+{
+    gpmi_set_busy_timeout(timeoutMicroseconds);
+    
+    return gpmi_start_dma(this->getFirstDescriptor(), m_chipSelect, getDmaWaitMask());
+}
+
+int Sequence::wait(uint32_t timeoutMicroseconds)
+{
+    return gpmi_wait_for_dma(timeoutMicroseconds, m_chipSelect);
+}
+
 void Sequence::dumpChain()
 {
     apbh_dma_t * desc = getFirstDescriptor();
@@ -251,12 +274,7 @@ void ReadWriteBase::setAddress(uint8_t * addressBytes)
 
 void ReadWriteBase::setAddress(uint32_t col, uint32_t row)
 {
-    m_cle1AddressBuffer[1] = col & 0xff;
-    m_cle1AddressBuffer[2] = (col >> 8) & 0xff;
-    m_cle1AddressBuffer[3] = row & 0xff;
-    m_cle1AddressBuffer[4] = (row >> 8) & 0xff;
-    m_cle1AddressBuffer[5] = (row >> 16) & 0xff;
-    m_cle1AddressBuffer[6] = (row >> 24) & 0xff;
+    fill_address(&m_cle1AddressBuffer[1], col, row);
 }
 
 void ReadWriteBase::setAddressByteCount(uint8_t addressByteCount)
@@ -560,6 +578,335 @@ uint16_t WriteEccData::getDmaWaitMask() const
     return kNandGpmiDmaWaitMask_GpmiDma | kNandGpmiDmaWaitMask_Ecc;
 }
 
+void ReadEccPages::init(unsigned chipSelect, uint8_t command1, uint8_t command2, uint8_t cacheCommand, uint8_t cacheEndCommand, unsigned addressByteCount, uint32_t readSize, const BchEccLayout_t & ecc, uint32_t eccMask)
+{
+    // Init superclass.
+    Sequence::init(chipSelect);
+    
+    // Fill in commands.
+    assert(addressByteCount <= MAX_ROWS+MAX_COLUMNS);
+    m_cle1AddressBuffer[0] = command1;
+    m_cle2Buffer = command2;
+    m_cacheBuffer = cacheCommand;
+    m_cacheEndBuffer = cacheEndCommand;
+    
+    // Save the read info.
+    m_readSize = readSize;
+    m_ecc = ecc;
+    m_eccMask = eccMask;
+    m_pageCount = 0;
+    
+    // Init the components. Buffers are filled in by setPages().
+    m_cle1Address.init(chipSelect, m_cle1AddressBuffer, addressByteCount);
+    m_cle2.init(chipSelect, &m_cle2Buffer, 0);
+    m_wait.init(chipSelect, &m_done);
+    m_done.init();
+    
+    unsigned i;
+    for (i = 0; i < NAND_MAX_CHAIN_PAGES; ++i)
+    {
+        m_cache[i].init(chipSelect, &m_cacheBuffer, 0);
+        m_cacheWait[i].init(chipSelect, &m_done);
+        m_readData[i].init(chipSelect, NULL, NULL, readSize, ecc, eccMask);
+    }
+    
+    // Chain up the components that never change.
+    m_cle1Address >> m_cle2 >> m_wait;
+}
+
+void ReadEccPages::setChipSelect(unsigned chipSelect)
+{
+    m_chipSelect = chipSelect;
+    
+    m_cle1Address.setChipSelect(chipSelect);
+    m_cle2.setChipSelect(chipSelect);
+    m_wait.setChipSelect(chipSelect);
+    
+    unsigned i;
+    for (i = 0; i < NAND_MAX_CHAIN_PAGES; ++i)
+    {
+        m_cache[i].setChipSelect(chipSelect);
+        m_cacheWait[i].setChipSelect(chipSelect);
+        m_readData[i].setChipSelect(chipSelect);
+    }
+}
+
+void ReadEccPages::setPages(uint32_t firstPage, unsigned pageCount, void * dataBuffer, uint32_t dataStride, void * auxBuffer, uint32_t auxStride)
+{
+    assert(pageCount > 0 && pageCount <= NAND_MAX_CHAIN_PAGES);
+    m_pageCount = pageCount;
+    
+    fill_address(&m_cle1AddressBuffer[1], 0, firstPage);
+    
+    uint8_t * data = (uint8_t *)dataBuffer;
+    uint8_t * aux = (uint8_t *)auxBuffer;
+    unsigned i;
+    for (i = 0; i < pageCount; ++i)
+    {
+        m_readData[i].setBufferAndSize(data + i * dataStride, aux + i * auxStride, m_readSize, m_ecc, m_eccMask);
+    }
+    
+    // A single page is read straight out of the data register.
+    if (pageCount == 1)
+    {
+        m_wait >> m_readData[0] >> m_done;
+        return;
+    }
+    
+    // Move each page into the cache register before reading it. Only the last cache command
+    // ends the sequence instead of loading the following page.
+    m_wait >> m_cache[0];
+    for (i = 0; i < pageCount; ++i)
+    {
+        bool isLast = (i == pageCount - 1);
+        
+        m_cache[i].setBufferAndCount(isLast ? &m_cacheEndBuffer : &m_cacheBuffer, 0);
+        m_cache[i] >> m_cacheWait[i] >> m_readData[i];
+        
+        if (isLast)
+        {
+            m_readData[i] >> m_done;
+        }
+        else
+        {
+            m_readData[i] >> m_cache[i + 1];
+        }
+    }
+}
+
+apbh_dma_t * ReadEccPages::getFirstDescriptor()
+{
+    return m_cle1Address.getFirstDescriptor();
+}
+
+void WriteEccPages::init(unsigned chipSelect, uint8_t command1, uint8_t command2, uint8_t cacheCommand, uint8_t statusCommand, unsigned addressByteCount, uint32_t sendSize, uint32_t dataSize, uint32_t leftoverSize, const BchEccLayout_t & ecc, uint32_t eccMask)
+{
+    // Init superclass.
+    Sequence::init(chipSelect);
+    
+    // Fill in commands.
+    assert(addressByteCount <= MAX_ROWS+MAX_COLUMNS);
+    m_cacheBuffer = cacheCommand;
+    m_cle2Buffer = command2;
+    
+    // Save info.
+    m_sendSize = sendSize;
+    m_dataSize = dataSize;
+    m_leftoverSize = leftoverSize;
+    m_ecc = ecc;
+    m_eccMask = eccMask;
+    m_pageCount = 0;
+    
+    // Init the components. Buffers are filled in by setPages().
+    unsigned i;
+    for (i = 0; i < NAND_MAX_CHAIN_PAGES; ++i)
+    {
+        m_cle1AddressBuffer[i][0] = command1;
+        
+        m_cle1Address[i].init(chipSelect, m_cle1AddressBuffer[i], addressByteCount);
+        m_writeData[i].init(chipSelect, NULL, NULL, sendSize, dataSize, leftoverSize, ecc, eccMask);
+        m_cle2[i].init(chipSelect, &m_cacheBuffer, 0);
+        m_status[i].init(chipSelect, statusCommand, m_statusBuffer[i]);
+    }
+    m_done.init();
+}
+
+void WriteEccPages::setChipSelect(unsigned chipSelect)
+{
+    m_chipSelect = chipSelect;
+    
+    unsigned i;
+    for (i = 0; i < NAND_MAX_CHAIN_PAGES; ++i)
+    {
+        m_cle1Address[i].setChipSelect(chipSelect);
+        m_writeData[i].setChipSelect(chipSelect);
+        m_cle2[i].setChipSelect(chipSelect);
+        m_status[i].setChipSelect(chipSelect);
+    }
+}
+
+void WriteEccPages::setPages(uint32_t firstPage, unsigned pageCount, const void * dataBuffer, uint32_t dataStride, const void * auxBuffer, uint32_t auxStride)
+{
+    assert(pageCount > 0 && pageCount <= NAND_MAX_CHAIN_PAGES);
+    m_pageCount = pageCount;
+    
+    const uint8_t * data = (const uint8_t *)dataBuffer;
+    const uint8_t * aux = (const uint8_t *)auxBuffer;
+    unsigned i;
+    for (i = 0; i < pageCount; ++i)
+    {
+        bool isLast = (i == pageCount - 1);
+        
+        fill_address(&m_cle1AddressBuffer[i][1], 0, firstPage + i);
+        m_writeData[i].setBufferAndSize(data + i * dataStride, aux + i * auxStride, m_sendSize, m_dataSize, m_leftoverSize, m_ecc, m_eccMask);
+        
+        // Only the last page is confirmed with the normal program command, so the chain ends
+        // once everything is programmed.
+        m_cle2[i].setBufferAndCount(isLast ? &m_cle2Buffer : &m_cacheBuffer, 0);
+        
+        m_cle1Address[i] >> m_writeData[i] >> m_cle2[i] >> m_status[i];
+        
+        if (isLast)
+        {
+            m_status[i] >> m_done;
+        }
+        else
+        {
+            m_status[i] >> m_cle1Address[i + 1];
+        }
+    }
+}
+
+uint16_t WriteEccPages::getDmaWaitMask() const
+{
+    // The BCH engine generates interrupts for write completion.
+    return kNandGpmiDmaWaitMask_GpmiDma | kNandGpmiDmaWaitMask_Ecc;
+}
+
+apbh_dma_t * WriteEccPages::getFirstDescriptor()
+{
+    return m_cle1Address[0].getFirstDescriptor();
+}
+
+void InterleavedReadEcc::init(uint8_t command1, uint8_t command2, uint8_t changeColumnCommand, uint8_t changeColumnConfirmCommand, unsigned columnByteCount, unsigned addressByteCount, uint32_t readSize, const BchEccLayout_t & ecc, uint32_t eccMask)
+{
+    // Init superclass.
+    Sequence::init(0);
+    
+    // Fill in commands. Every page is read from column 0.
+    assert(addressByteCount <= MAX_ROWS+MAX_COLUMNS);
+    assert(columnByteCount <= MAX_COLUMNS);
+    m_cle2Buffer = command2;
+    m_changeColumnConfirmBuffer = changeColumnConfirmCommand;
+    memset(m_changeColumnBuffer, 0, sizeof(m_changeColumnBuffer));
+    m_changeColumnBuffer[0] = changeColumnCommand;
+    
+    // Save the read info.
+    m_readSize = readSize;
+    m_ecc = ecc;
+    m_eccMask = eccMask;
+    
+    // Init the components. Chip selects and buffers are filled in by setPages().
+    unsigned i;
+    for (i = 0; i < GPMI_CHIP_SELECT_COUNT; ++i)
+    {
+        m_cle1AddressBuffer[i][0] = command1;
+        
+        m_cle1Address[i].init(i, m_cle1AddressBuffer[i], addressByteCount);
+        m_cle2[i].init(i, &m_cle2Buffer, 0);
+        m_changeColumn[i].init(i, m_changeColumnBuffer, columnByteCount);
+        m_changeColumnConfirm[i].init(i, &m_changeColumnConfirmBuffer, 0);
+        m_readData[i].init(i, NULL, NULL, readSize, ecc, eccMask);
+    }
+    m_wait.init(0, &m_done);
+    m_done.init();
+}
+
+void InterleavedReadEcc::setPages(unsigned count, const unsigned * chipSelects, const uint32_t * pages, void * const * dataBuffers, void * const * auxBuffers)
+{
+    assert(count > 0 && count <= GPMI_CHIP_SELECT_COUNT);
+    
+    unsigned i;
+    for (i = 0; i < count; ++i)
+    {
+        unsigned cs = chipSelects[i];
+        
+        fill_address(&m_cle1AddressBuffer[i][1], 0, pages[i]);
+        
+        m_cle1Address[i].setChipSelect(cs);
+        m_cle2[i].setChipSelect(cs);
+        m_changeColumn[i].setChipSelect(cs);
+        m_changeColumnConfirm[i].setChipSelect(cs);
+        m_readData[i].setChipSelect(cs);
+        m_readData[i].setBufferAndSize(dataBuffers[i], auxBuffers[i], m_readSize, m_ecc, m_eccMask);
+        
+        // Start the array read of every NAND first...
+        m_cle1Address[i] >> m_cle2[i];
+        m_cle2[i] >> ((i == count - 1) ? (Component::Base &)m_wait : (Component::Base &)m_cle1Address[i + 1]);
+        
+        // ...then transfer the pages one after the other.
+        m_changeColumn[i] >> m_changeColumnConfirm[i] >> m_readData[i];
+        m_readData[i] >> ((i == count - 1) ? (Component::Base &)m_done : (Component::Base &)m_changeColumn[i + 1]);
+    }
+    m_wait >> m_changeColumn[0];
+    
+    m_chipSelect = chipSelects[0];
+    m_wait.setChipSelect(m_chipSelect);
+}
+
+apbh_dma_t * InterleavedReadEcc::getFirstDescriptor()
+{
+    return m_cle1Address[0].getFirstDescriptor();
+}
+
+void InterleavedWriteEcc::init(uint8_t command1, uint8_t command2, uint8_t statusCommand, unsigned addressByteCount, uint32_t sendSize, uint32_t dataSize, uint32_t leftoverSize, const BchEccLayout_t & ecc, uint32_t eccMask)
+{
+    // Init superclass.
+    Sequence::init(0);
+    
+    assert(addressByteCount <= MAX_ROWS+MAX_COLUMNS);
+    m_cle2Buffer = command2;
+    
+    // Save info.
+    m_sendSize = sendSize;
+    m_dataSize = dataSize;
+    m_leftoverSize = leftoverSize;
+    m_ecc = ecc;
+    m_eccMask = eccMask;
+    
+    // Init the components. Chip selects and buffers are filled in by setPages().
+    unsigned i;
+    for (i = 0; i < GPMI_CHIP_SELECT_COUNT; ++i)
+    {
+        m_cle1AddressBuffer[i][0] = command1;
+        
+        m_cle1Address[i].init(i, m_cle1AddressBuffer[i], addressByteCount);
+        m_writeData[i].init(i, NULL, NULL, sendSize, dataSize, leftoverSize, ecc, eccMask);
+        m_cle2[i].init(i, &m_cle2Buffer, 0);
+        m_status[i].init(i, statusCommand, m_statusBuffer[i]);
+    }
+    m_done.init();
+}
+
+void InterleavedWriteEcc::setPages(unsigned count, const unsigned * chipSelects, const uint32_t * pages, const void * const * dataBuffers, const void * const * auxBuffers)
+{
+    assert(count > 0 && count <= GPMI_CHIP_SELECT_COUNT);
+    
+    unsigned i;
+    for (i = 0; i < count; ++i)
+    {
+        unsigned cs = chipSelects[i];
+        
+        fill_address(&m_cle1AddressBuffer[i][1], 0, pages[i]);
+        
+        m_cle1Address[i].setChipSelect(cs);
+        m_writeData[i].setChipSelect(cs);
+        m_writeData[i].setBufferAndSize(dataBuffers[i], auxBuffers[i], m_sendSize, m_dataSize, m_leftoverSize, m_ecc, m_eccMask);
+        m_cle2[i].setChipSelect(cs);
+        m_status[i].setChipSelect(cs);
+        
+        // Program every NAND first...
+        m_cle1Address[i] >> m_writeData[i] >> m_cle2[i];
+        m_cle2[i] >> ((i == count - 1) ? (Component::Base &)m_status[0] : (Component::Base &)m_cle1Address[i + 1]);
+        
+        // ...then collect their status once they are ready.
+        m_status[i] >> ((i == count - 1) ? (Component::Base &)m_done : (Component::Base &)m_status[i + 1]);
+    }
+    
+    m_chipSelect = chipSelects[0];
+}
+
+uint16_t InterleavedWriteEcc::getDmaWaitMask() const
+{
+    // The BCH engine generates interrupts for write completion.
+    return kNandGpmiDmaWaitMask_GpmiDma | kNandGpmiDmaWaitMask_Ecc;
+}
+
+apbh_dma_t * InterleavedWriteEcc::getFirstDescriptor()
+{
+    return m_cle1Address[0].getFirstDescriptor();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // End of file
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file gpmi_ftl.c
+ * @brief NAND access for the flash translation layer on top of the ECC page operations.
+ *
+ * The first metadata byte of a page is left at 0xff, as it is the bad block marker of the
+ * first page of a block. The FTL spare area is packed into the following bytes, which needs a
+ * BCH layout with at least 1 + #FTL_SPARE_BYTES metadata bytes.
+ */
+
+#include <string.h>
+#include "gpmi/gpmi.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Offset of the bad block marker in the metadata.
+#define GPMI_FTL_BAD_BLOCK_MARKER (0)
+
+//! @brief Offset of the FTL spare area in the metadata.
+#define GPMI_FTL_SPARE_OFFSET (1)
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Chip select, aux buffer and refresh threshold of the device.
+static struct {
+    unsigned chipSelect;
+    uint8_t * auxBuffer;
+    uint32_t refreshBitErrors;
+} s_gpmiFtl;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Copy a 32-bit value out of the metadata, least significant byte first.
+static uint32_t gpmi_ftl_get_word(const uint8_t * bytes)
+{
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+//! @brief Copy a 32-bit value into the metadata, least significant byte first.
+static void gpmi_ftl_set_word(uint8_t * bytes, uint32_t value)
+{
+    bytes[0] = value;
+    bytes[1] = value >> 8;
+    bytes[2] = value >> 16;
+    bytes[3] = value >> 24;
+}
+
+static int gpmi_ftl_read(const ftl_nand_t * nand, uint32_t page, void * data, ftl_spare_t * spare)
+{
+    uint8_t * aux = s_gpmiFtl.auxBuffer;
+    uint8_t * packed = aux + GPMI_FTL_SPARE_OFFSET;
+    BchEccCorrectionInfo_t info;
+    int status;
+
+    if (data)
+    {
+        status = gpmi_nand_read_page(s_gpmiFtl.chipSelect, page, (uint8_t *)data, aux);
+    }
+    else
+    {
+        status = gpmi_nand_read_metadata(s_gpmiFtl.chipSelect, page, aux);
+    }
+
+    if (status == ERROR_DDI_NAND_GPMI_UNCORRECTABLE_ECC)
+    {
+        return kFtlNandEccError;
+    }
+    else if (status != SUCCESS)
+    {
+        return kFtlNandFailed;
+    }
+
+    // Erased pages are not corrected, so their metadata is reported as it was read.
+    if (bch_read_correction_status(aux, &info) == kAllOnes)
+    {
+        memset(spare, 0xff, sizeof(*spare));
+        return kFtlNandSuccess;
+    }
+
+    spare->type = packed[0];
+    spare->id = gpmi_ftl_get_word(packed + 1);
+    spare->sequence = gpmi_ftl_get_word(packed + 5);
+
+    if (info.combinedStatus == kCorrectedBitErrors && info.maxBitErrors >= s_gpmiFtl.refreshBitErrors)
+    {
+        return kFtlNandCorrected;
+    }
+    return kFtlNandSuccess;
+}
+
+static int gpmi_ftl_program(const ftl_nand_t * nand, uint32_t page, const void * data, const ftl_spare_t * spare)
+{
+    uint8_t * aux = s_gpmiFtl.auxBuffer;
+    uint8_t * packed = aux + GPMI_FTL_SPARE_OFFSET;
+
+    memset(aux, 0xff, GPMI_FTL_SPARE_OFFSET + FTL_SPARE_BYTES);
+    packed[0] = spare->type;
+    gpmi_ftl_set_word(packed + 1, spare->id);
+    gpmi_ftl_set_word(packed + 5, spare->sequence);
+
+    if (gpmi_nand_write_page(s_gpmiFtl.chipSelect, page, (const uint8_t *)data, aux) != SUCCESS)
+    {
+        return kFtlNandFailed;
+    }
+    return kFtlNandSuccess;
+}
+
+static int gpmi_ftl_erase(const ftl_nand_t * nand, uint32_t block)
+{
+    if (gpmi_nand_erase_block(s_gpmiFtl.chipSelect, block) != SUCCESS)
+    {
+        return kFtlNandFailed;
+    }
+    return kFtlNandSuccess;
+}
+
+//! @brief Check the marker in the first byte of the first page of a block.
+//!
+//! The marker is read raw, since a page carrying it does not pass the ECC check.
+static bool gpmi_ftl_is_bad(const ftl_nand_t * nand, uint32_t block)
+{
+    uint8_t marker;
+
+    if (gpmi_nand_read_raw(s_gpmiFtl.chipSelect, block * nand->pagesPerBlock, &marker,
+                           GPMI_FTL_BAD_BLOCK_MARKER, sizeof(marker)) != SUCCESS)
+    {
+        return true;
+    }
+    return marker != 0xff;
+}
+
+static void gpmi_ftl_mark_bad(const ftl_nand_t * nand, uint32_t block)
+{
+    uint8_t marker = 0;
+
+    // The block may fail to erase, so the marker is programmed over whatever the page holds.
+    gpmi_nand_erase_block(s_gpmiFtl.chipSelect, block);
+    gpmi_nand_write_raw(s_gpmiFtl.chipSelect, block * nand->pagesPerBlock, &marker,
+                        GPMI_FTL_BAD_BLOCK_MARKER, sizeof(marker));
+}
+
+void gpmi_nand_ftl_init(ftl_nand_t * nand, unsigned chipSelect, uint32_t pageSize, uint32_t pagesPerBlock,
+                        uint32_t blockCount, uint32_t refreshBitErrors, uint8_t * auxBuffer)
+{
+    s_gpmiFtl.chipSelect = chipSelect;
+    s_gpmiFtl.auxBuffer = auxBuffer;
+    s_gpmiFtl.refreshBitErrors = refreshBitErrors;
+
+    nand->pageSize = pageSize;
+    nand->pagesPerBlock = pagesPerBlock;
+    nand->blockCount = blockCount;
+    nand->read = gpmi_ftl_read;
+    nand->program = gpmi_ftl_program;
+    nand->erase = gpmi_ftl_erase;
+    nand->isBad = gpmi_ftl_is_bad;
+    nand->markBad = gpmi_ftl_mark_bad;
+    nand->context = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
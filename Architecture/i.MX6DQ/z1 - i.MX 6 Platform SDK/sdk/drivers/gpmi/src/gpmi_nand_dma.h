@@ -103,6 +103,9 @@ typedef struct _apbh_dma_gpmi6_t
 //! @brief Size in bytes of a Read ID command result.
 #define NAND_READ_ID_RESULT_SIZE (6)
 
+//! @brief Maximum number of pages transferred by one multi-page DMA chain.
+#define NAND_MAX_CHAIN_PAGES (8)
+
 #if defined(__cplusplus)
 
 //! @brief Contains GPMI NAND DMA classes.
@@ -362,6 +365,14 @@ public:
     //! @brief Start DMA and wait for it to complete.
     virtual int run(uint32_t timeoutMicroseconds);
     
+    //! @brief Start DMA without waiting for it.
+    //!
+    //! The descriptors must not be modified until wait() returns.
+    virtual int start(uint32_t timeoutMicroseconds);
+    
+    //! @brief Wait for a DMA started with start() to complete.
+    virtual int wait(uint32_t timeoutMicroseconds);
+    
     //! @brief Returns the wait mask required for this DMA.
     virtual uint16_t getDmaWaitMask() const { return kNandGpmiDmaWaitMask_GpmiDma; }
     
@@ -856,11 +867,239 @@ public:
     //! @brief Chaining operator.
     virtual Base & operator >> (Base & rhs)
     {
-        m_writeData >> rhs;
+        m_wait >> rhs;
         return rhs;
     }
 };
 
+/*!
+ * @brief Read consecutive pages from the NAND with ECC enabled.
+ *
+ * The first page is loaded into the data register with the normal read commands. Before each
+ * page is transferred, a read cache command moves it into the cache register and starts loading
+ * the next page into the data register, so the array read of one page overlaps the transfer and
+ * correction of the previous one. The last page is moved with the read cache end command, which
+ * does not load another page.
+ *
+ * The chain is built once and repointed at other pages with setPages().
+ */
+class ReadEccPages : public Sequence
+{
+public:
+    //! @name DMA Components
+    //@{
+    Component::CommandAddress m_cle1Address;
+    Component::CommandAddress m_cle2;
+    Component::WaitForReady m_wait;
+    Component::CommandAddress m_cache[NAND_MAX_CHAIN_PAGES];
+    Component::WaitForReady m_cacheWait[NAND_MAX_CHAIN_PAGES];
+    Component::ReceiveEccData m_readData[NAND_MAX_CHAIN_PAGES];
+    Component::Terminator m_done;
+    //@}
+    
+    //! @name Buffers
+    //@{
+    uint8_t m_cle1AddressBuffer[1+MAX_ROWS+MAX_COLUMNS] __ALIGN4__;
+    uint8_t m_cle2Buffer __ALIGN4__;
+    uint8_t m_cacheBuffer __ALIGN4__;
+    uint8_t m_cacheEndBuffer __ALIGN4__;
+    //@}
+    
+    //! @name Save read info
+    //@{
+    uint32_t m_readSize;
+    BchEccLayout_t m_ecc;
+    uint32_t m_eccMask;
+    unsigned m_pageCount;
+    //@}
+    
+    //! @brief Default constructor.
+    inline ReadEccPages() : m_pageCount(0) {}
+    
+    //! @brief Initializer.
+    void init(unsigned chipSelect, uint8_t command1, uint8_t command2, uint8_t cacheCommand, uint8_t cacheEndCommand, unsigned addressByteCount, uint32_t readSize, const BchEccLayout_t & ecc, uint32_t eccMask);
+    
+    //! @name Modifiers
+    //@{
+    void setChipSelect(unsigned chipSelect);
+    void setPages(uint32_t firstPage, unsigned pageCount, void * dataBuffer, uint32_t dataStride, void * auxBuffer, uint32_t auxStride);
+    //@}
+    
+    //! @brief Returns the address of the first DMA descriptor.
+    virtual apbh_dma_t * getFirstDescriptor();
+    
+    //! @brief Operator to provide easy access to the first DMA descriptor.
+    inline operator apbh_dma_t * () { return getFirstDescriptor(); }        
+};
+
+/*!
+ * @brief Write consecutive pages to the NAND with ECC enabled.
+ *
+ * Every page but the last is confirmed with the cache program command, which returns ready as
+ * soon as the page has moved to the cache register, so the next page is transferred while the
+ * previous one is programmed. The status read after each page reports the result of the page
+ * before it, and the status read after the last page reports both of the final pages.
+ *
+ * The chain is built once and repointed at other pages with setPages().
+ */
+class WriteEccPages : public Sequence
+{
+public:
+    //! @name DMA Components
+    //@{
+    Component::CommandAddress m_cle1Address[NAND_MAX_CHAIN_PAGES];
+    Component::SendEccData m_writeData[NAND_MAX_CHAIN_PAGES];
+    Component::CommandAddress m_cle2[NAND_MAX_CHAIN_PAGES];
+    ReadStatus m_status[NAND_MAX_CHAIN_PAGES];
+    Component::Terminator m_done;
+    //@}
+    
+    //! @name Buffers
+    //@{
+    uint8_t m_cle1AddressBuffer[NAND_MAX_CHAIN_PAGES][8] __ALIGN4__;
+    uint8_t m_statusBuffer[NAND_MAX_CHAIN_PAGES][4] __ALIGN4__;
+    uint8_t m_cacheBuffer __ALIGN4__;
+    uint8_t m_cle2Buffer __ALIGN4__;
+    //@}
+    
+    //! @name Saved info
+    //@{
+    uint32_t m_sendSize;
+    uint32_t m_dataSize;
+    uint32_t m_leftoverSize;
+    BchEccLayout_t m_ecc;
+    uint32_t m_eccMask;
+    unsigned m_pageCount;
+    //@}
+    
+    //! @brief Default constructor.
+    inline WriteEccPages() : m_pageCount(0) {}
+    
+    //! @brief Initializer.
+    void init(unsigned chipSelect, uint8_t command1, uint8_t command2, uint8_t cacheCommand, uint8_t statusCommand, unsigned addressByteCount, uint32_t sendSize, uint32_t dataSize, uint32_t leftoverSize, const BchEccLayout_t & ecc, uint32_t eccMask);
+    
+    //! @name Modifiers
+    //@{
+    void setChipSelect(unsigned chipSelect);
+    void setPages(uint32_t firstPage, unsigned pageCount, const void * dataBuffer, uint32_t dataStride, const void * auxBuffer, uint32_t auxStride);
+    //@}
+    
+    //! @brief Returns the status byte read after a page.
+    inline uint8_t getStatus(unsigned page) const { return m_statusBuffer[page][0]; }
+    
+    //! @brief Returns the wait mask required for this DMA.
+    virtual uint16_t getDmaWaitMask() const;
+    
+    //! @brief Returns the address of the first DMA descriptor.
+    virtual apbh_dma_t * getFirstDescriptor();
+    
+    //! @brief Operator to provide easy access to the first DMA descriptor.
+    inline operator apbh_dma_t * () { return getFirstDescriptor(); }        
+};
+
+/*!
+ * @brief Read one page from each of several NANDs with ECC enabled.
+ *
+ * The read commands are sent to every chip select before waiting, so the array reads of all
+ * the NANDs run at the same time. With ganged ready/busy a single wait covers all of them.
+ * Each page is then transferred after a change read column command, which makes sure the data
+ * comes out of the start of the page register of that NAND.
+ */
+class InterleavedReadEcc : public Sequence
+{
+public:
+    //! @name DMA Components
+    //@{
+    Component::CommandAddress m_cle1Address[GPMI_CHIP_SELECT_COUNT];
+    Component::CommandAddress m_cle2[GPMI_CHIP_SELECT_COUNT];
+    Component::WaitForReady m_wait;
+    Component::CommandAddress m_changeColumn[GPMI_CHIP_SELECT_COUNT];
+    Component::CommandAddress m_changeColumnConfirm[GPMI_CHIP_SELECT_COUNT];
+    Component::ReceiveEccData m_readData[GPMI_CHIP_SELECT_COUNT];
+    Component::Terminator m_done;
+    //@}
+    
+    //! @name Buffers
+    //@{
+    uint8_t m_cle1AddressBuffer[GPMI_CHIP_SELECT_COUNT][8] __ALIGN4__;
+    uint8_t m_changeColumnBuffer[1+MAX_COLUMNS] __ALIGN4__;
+    uint8_t m_cle2Buffer __ALIGN4__;
+    uint8_t m_changeColumnConfirmBuffer __ALIGN4__;
+    //@}
+    
+    //! @name Save read info
+    //@{
+    uint32_t m_readSize;
+    BchEccLayout_t m_ecc;
+    uint32_t m_eccMask;
+    //@}
+    
+    //! @brief Initializer.
+    void init(uint8_t command1, uint8_t command2, uint8_t changeColumnCommand, uint8_t changeColumnConfirmCommand, unsigned columnByteCount, unsigned addressByteCount, uint32_t readSize, const BchEccLayout_t & ecc, uint32_t eccMask);
+    
+    //! @brief Set the chip select, page and buffers of each read and relink the chain.
+    void setPages(unsigned count, const unsigned * chipSelects, const uint32_t * pages, void * const * dataBuffers, void * const * auxBuffers);
+    
+    //! @brief Returns the address of the first DMA descriptor.
+    virtual apbh_dma_t * getFirstDescriptor();
+    
+    //! @brief Operator to provide easy access to the first DMA descriptor.
+    inline operator apbh_dma_t * () { return getFirstDescriptor(); }        
+};
+
+/*!
+ * @brief Write one page to each of several NANDs with ECC enabled.
+ *
+ * Each page is transferred and confirmed in turn without waiting, so the NANDs program at the
+ * same time. The status of every NAND is read once all of them are ready.
+ */
+class InterleavedWriteEcc : public Sequence
+{
+public:
+    //! @name DMA Components
+    //@{
+    Component::CommandAddress m_cle1Address[GPMI_CHIP_SELECT_COUNT];
+    Component::SendEccData m_writeData[GPMI_CHIP_SELECT_COUNT];
+    Component::CommandAddress m_cle2[GPMI_CHIP_SELECT_COUNT];
+    ReadStatus m_status[GPMI_CHIP_SELECT_COUNT];
+    Component::Terminator m_done;
+    //@}
+    
+    //! @name Buffers
+    //@{
+    uint8_t m_cle1AddressBuffer[GPMI_CHIP_SELECT_COUNT][8] __ALIGN4__;
+    uint8_t m_statusBuffer[GPMI_CHIP_SELECT_COUNT][4] __ALIGN4__;
+    uint8_t m_cle2Buffer __ALIGN4__;
+    //@}
+    
+    //! @name Saved info
+    //@{
+    uint32_t m_sendSize;
+    uint32_t m_dataSize;
+    uint32_t m_leftoverSize;
+    BchEccLayout_t m_ecc;
+    uint32_t m_eccMask;
+    //@}
+    
+    //! @brief Initializer.
+    void init(uint8_t command1, uint8_t command2, uint8_t statusCommand, unsigned addressByteCount, uint32_t sendSize, uint32_t dataSize, uint32_t leftoverSize, const BchEccLayout_t & ecc, uint32_t eccMask);
+    
+    //! @brief Set the chip select, page and buffers of each write and relink the chain.
+    void setPages(unsigned count, const unsigned * chipSelects, const uint32_t * pages, const void * const * dataBuffers, const void * const * auxBuffers);
+    
+    //! @brief Returns the status byte read from one of the NANDs.
+    inline uint8_t getStatus(unsigned index) const { return m_statusBuffer[index][0]; }
+    
+    //! @brief Returns the wait mask required for this DMA.
+    virtual uint16_t getDmaWaitMask() const;
+    
+    //! @brief Returns the address of the first DMA descriptor.
+    virtual apbh_dma_t * getFirstDescriptor();
+    
+    //! @brief Operator to provide easy access to the first DMA descriptor.
+    inline operator apbh_dma_t * () { return getFirstDescriptor(); }        
+};
+
 } // namespace NandDma
 
 #endif // defined(__cplusplus)
@@ -70,12 +70,24 @@ enum _nand_command_codes
     kNandCommand_ReadStatus = 0x70,
     kNandCommand_ReadPage1 = 0x00,
     kNandCommand_ReadPage2 = 0x30,
+    kNandCommand_ReadPageCache = 0x31,
+    kNandCommand_ReadPageCacheEnd = 0x3f,
+    kNandCommand_ChangeReadColumn1 = 0x05,
+    kNandCommand_ChangeReadColumn2 = 0xe0,
     kNandCommand_SerialDataInput = 0x80,
     kNandCommand_WritePage = 0x10,
+    kNandCommand_WritePageCache = 0x15,
     kNandCommand_AddressInput = 0x60,
     kNandCommand_BlockErase = 0xd0
 };
 
+//! @brief Bits of the 70h status byte.
+enum _nand_status_bits
+{
+    kNandStatus_Fail = 0x01,        //!< The last operation failed.
+    kNandStatus_CacheFail = 0x02    //!< The operation before the last cache operation failed.
+};
+
 //! \brief Simple macro to convert a number of bits into bytes, rounded up
 //!     to the nearest byte.
 #define BITS_TO_BYTES(bits) ((bits + 7) / 8)
@@ -93,13 +105,27 @@ typedef struct _nand_info {
     uint32_t columnAddressBytes;
     uint32_t totalAddressBytes;
     uint32_t pagesPerBlock;
+    bool useCacheCommands;
 } NandInfo_t;
 
+//! @brief DMA chains kept for a chip select.
+//!
+//! They are built once by gpmi_nand_configure(), and only the page address and buffers are
+//! patched for each operation.
+typedef struct _nand_dma_chains {
+    NandDma::ReadEccData readPage;      //!< Read a page with ECC.
+    NandDma::WriteEccData writePage;    //!< Write a page with ECC, followed by #writeStatus.
+    NandDma::ReadStatus writeStatus;    //!< Status read chained onto #writePage.
+} NandDmaChains_t;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Prototypes
 ////////////////////////////////////////////////////////////////////////////////
 
 static int gpmi_nand_check_status(uint8_t statusValue);
+static int gpmi_nand_check_ecc(const uint8_t * auxBuffer);
+static int gpmi_nand_check_ecc_pages(const uint8_t * auxBuffer, uint32_t pageCount, uint32_t auxStride);
+static uint32_t gpmi_nand_chain_pages(uint32_t pageNumber, uint32_t pageCount);
 
 ////////////////////////////////////////////////////////////////////////////////
 // Variables
@@ -111,6 +137,19 @@ NandInfo_t g_nandInfo;
 //! @brief Shared result buffer for status reads.
 static uint8_t s_resultBuffer[64] __ALIGN4__;
 
+//! @brief Single page DMA chains for each chip select.
+static NandDmaChains_t s_dmaChains[GPMI_CHIP_SELECT_COUNT];
+
+//! @name Multi-page DMA chains
+//!
+//! Only one DMA runs at a time, so these are shared by all chip selects.
+//@{
+static NandDma::ReadEccPages s_readPagesDma;
+static NandDma::WriteEccPages s_writePagesDma;
+static NandDma::InterleavedReadEcc s_interleavedReadDma;
+static NandDma::InterleavedWriteEcc s_interleavedWriteDma;
+//@}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Code
 ////////////////////////////////////////////////////////////////////////////////
@@ -135,9 +174,48 @@ int gpmi_nand_configure(unsigned rowBytes, unsigned columnBytes, unsigned pagesP
     bch_set_layout(&g_nandInfo.ecc);
     bch_set_erase_threshold(0);
     
+    g_nandInfo.useCacheCommands = true;
+    
+    // Build the DMA chains. Page reads and writes always transfer the whole page.
+    uint32_t pageSize = g_nandInfo.dataSize + g_nandInfo.auxSize;
+    uint32_t readMask = bch_get_buffer_mask(false, pageSize, &g_nandInfo.ecc);
+    uint32_t writeMask = bch_get_buffer_mask(true, pageSize, &g_nandInfo.ecc);
+    unsigned cs;
+    
+    for (cs = 0; cs < GPMI_CHIP_SELECT_COUNT; ++cs)
+    {
+        NandDmaChains_t * chains = &s_dmaChains[cs];
+        
+        chains->readPage.init(cs, kNandCommand_ReadPage1, NULL, g_nandInfo.totalAddressBytes,
+            kNandCommand_ReadPage2, NULL, NULL, pageSize, g_nandInfo.ecc, readMask);
+        
+        chains->writePage.init(cs, kNandCommand_SerialDataInput, NULL, g_nandInfo.totalAddressBytes,
+            kNandCommand_WritePage, NULL, NULL, pageSize, g_nandInfo.dataSize, g_nandInfo.auxSize,
+            g_nandInfo.ecc, writeMask);
+        chains->writeStatus.init(cs, kNandCommand_ReadStatus, s_resultBuffer);
+        chains->writePage >> chains->writeStatus;
+    }
+    
+    s_readPagesDma.init(0, kNandCommand_ReadPage1, kNandCommand_ReadPage2, kNandCommand_ReadPageCache,
+        kNandCommand_ReadPageCacheEnd, g_nandInfo.totalAddressBytes, pageSize, g_nandInfo.ecc, readMask);
+    s_writePagesDma.init(0, kNandCommand_SerialDataInput, kNandCommand_WritePage, kNandCommand_WritePageCache,
+        kNandCommand_ReadStatus, g_nandInfo.totalAddressBytes, pageSize, g_nandInfo.dataSize,
+        g_nandInfo.auxSize, g_nandInfo.ecc, writeMask);
+    s_interleavedReadDma.init(kNandCommand_ReadPage1, kNandCommand_ReadPage2, kNandCommand_ChangeReadColumn1,
+        kNandCommand_ChangeReadColumn2, columnBytes, g_nandInfo.totalAddressBytes, pageSize,
+        g_nandInfo.ecc, readMask);
+    s_interleavedWriteDma.init(kNandCommand_SerialDataInput, kNandCommand_WritePage, kNandCommand_ReadStatus,
+        g_nandInfo.totalAddressBytes, pageSize, g_nandInfo.dataSize, g_nandInfo.auxSize,
+        g_nandInfo.ecc, writeMask);
+    
     return SUCCESS;
 }
 
+void gpmi_nand_enable_cache_commands(bool enable)
+{
+    g_nandInfo.useCacheCommands = enable;
+}
+
 int gpmi_nand_reset(unsigned chipSelect)
 {
     NandDma::Reset resetDma(chipSelect, kNandCommand_Reset);
@@ -231,7 +309,43 @@ int gpmi_nand_read_raw(unsigned chipSelect, uint32_t pageNumber, uint8_t * buffe
 //! -  Bit 7 - Write Protect (0=Protected)
 int gpmi_nand_check_status(uint8_t statusValue)
 {
-    return (statusValue & 1) == 0 ? SUCCESS : -1;
+    return (statusValue & kNandStatus_Fail) == 0 ? SUCCESS : -1;
+}
+
+//! @brief Check the BCH results that a page read left in its aux buffer.
+int gpmi_nand_check_ecc(const uint8_t * auxBuffer)
+{
+    BchEccCorrectionInfo_t correctionInfo;
+    int correctionStatus = bch_read_correction_status(auxBuffer, &correctionInfo);
+    
+    return (correctionStatus == kUncorrectableBitErrors) ? ERROR_DDI_NAND_GPMI_UNCORRECTABLE_ECC : SUCCESS;
+}
+
+//! @brief Check the BCH results of several pages with consecutive aux buffers.
+int gpmi_nand_check_ecc_pages(const uint8_t * auxBuffer, uint32_t pageCount, uint32_t auxStride)
+{
+    int retval = SUCCESS;
+    
+    while (pageCount--)
+    {
+        if (gpmi_nand_check_ecc(auxBuffer) != SUCCESS)
+        {
+            retval = ERROR_DDI_NAND_GPMI_UNCORRECTABLE_ECC;
+        }
+        auxBuffer += auxStride;
+    }
+    
+    return retval;
+}
+
+//! @brief Number of pages from @a pageNumber that fit in one multi-page DMA.
+//!
+//! Cache operations are not allowed to cross a block boundary.
+uint32_t gpmi_nand_chain_pages(uint32_t pageNumber, uint32_t pageCount)
+{
+    uint32_t pagesLeftInBlock = g_nandInfo.pagesPerBlock - (pageNumber % g_nandInfo.pagesPerBlock);
+    
+    return std::min(pageCount, std::min(pagesLeftInBlock, (uint32_t)NAND_MAX_CHAIN_PAGES));
 }
 
 int gpmi_nand_write_raw(unsigned chipSelect, uint32_t pageNumber, const uint8_t * buffer, uint32_t offset, uint32_t count)
@@ -282,29 +396,12 @@ int gpmi_nand_read_page(unsigned chipSelect, uint32_t pageNumber, uint8_t * buff
 {
     int retval;
     
-    // Prepare some info.
-    uint32_t readSize = g_nandInfo.dataSize + g_nandInfo.auxSize;
-    uint32_t eccMask = bch_get_buffer_mask(false, readSize, &g_nandInfo.ecc);
-
-    // Construct the DMA descriptor chain.
-    NandDma::ReadEccData readDma(
-        chipSelect,  // chip enable
-        kNandCommand_ReadPage1,
-        NULL, // addressBytes
-        g_nandInfo.totalAddressBytes,  // addressByteCount
-        kNandCommand_ReadPage2,
-        buffer,  //dataBuffer
-        auxBuffer,   //auxBuffer
-        readSize,  //readSize
-        g_nandInfo.ecc,    //ecc
-        eccMask);   //eccMask
+    assert(chipSelect < GPMI_CHIP_SELECT_COUNT);
+    NandDma::ReadEccData & readDma = s_dmaChains[chipSelect].readPage;
     
-    // Update the DMA. By providing a valid aux buffer and aux read size, the DMA will use
-    // two separate read DMA descriptors.
+    // Patch the prebuilt chain with the page address and buffers.
     readDma.setAddress(0, pageNumber);
-
-    printf("Read DMA:\n");
-    readDma.dumpChain();
+    readDma.setBuffers(buffer, auxBuffer);
     
     // Make sure the BCH complete IRQ is cleared.
     bch_clear_complete_irq();
@@ -318,18 +415,133 @@ int gpmi_nand_read_page(unsigned chipSelect, uint32_t pageNumber, uint8_t * buff
     if (retval == SUCCESS)
     {
         // Check the ECC results.
-        BchEccCorrectionInfo_t correctionInfo;
-        int correctionStatus = bch_read_correction_status(auxBuffer, &correctionInfo);
+        retval = gpmi_nand_check_ecc(auxBuffer);
+    }
+
+    // Clear and reenable the BCH IRQ.
+    bch_clear_complete_irq();
+
+    return retval;
+}
+
+int gpmi_nand_read_pages(unsigned chipSelect, uint32_t firstPage, uint32_t pageCount, uint8_t * buffer, uint8_t * auxBuffer, uint32_t auxStride)
+{
+    int retval = SUCCESS;
+    int eccStatus = SUCCESS;
+    
+    assert(chipSelect < GPMI_CHIP_SELECT_COUNT);
+    
+    if (!g_nandInfo.useCacheCommands)
+    {
+        for (; pageCount; --pageCount)
+        {
+            // Keep reading past pages with uncorrectable errors, like the cache read does.
+            retval = gpmi_nand_read_page(chipSelect, firstPage++, buffer, auxBuffer);
+            if (retval == ERROR_DDI_NAND_GPMI_UNCORRECTABLE_ECC)
+            {
+                eccStatus = retval;
+            }
+            else if (retval != SUCCESS)
+            {
+                return retval;
+            }
+            
+            buffer += g_nandInfo.dataSize;
+            auxBuffer += auxStride;
+        }
+        return eccStatus;
+    }
+    
+    // Pages whose ECC results have not been checked yet.
+    const uint8_t * pendingAux = NULL;
+    uint32_t pendingCount = 0;
+    
+    s_readPagesDma.setChipSelect(chipSelect);
+    
+    while (pageCount && retval == SUCCESS)
+    {
+        uint32_t count = gpmi_nand_chain_pages(firstPage, pageCount);
         
-        if (correctionStatus == kUncorrectableBitErrors)
+        // The previous chain is done, so its descriptors can be repointed.
+        s_readPagesDma.setPages(firstPage, count, buffer, g_nandInfo.dataSize, auxBuffer, auxStride);
+        
+        bch_clear_complete_irq();
+        retval = s_readPagesDma.start(kNandReadPageTimeout);
+        
+        // Check the previous pages while these are read.
+        if (pendingCount && gpmi_nand_check_ecc_pages(pendingAux, pendingCount, auxStride) != SUCCESS)
         {
-            retval = ERROR_DDI_NAND_GPMI_UNCORRECTABLE_ECC;
+            eccStatus = ERROR_DDI_NAND_GPMI_UNCORRECTABLE_ECC;
+        }
+        
+        if (retval == SUCCESS)
+        {
+            retval = s_readPagesDma.wait(kNandReadPageTimeout * count);
         }
+        
+        pendingAux = auxBuffer;
+        pendingCount = count;
+        
+        firstPage += count;
+        pageCount -= count;
+        buffer += count * g_nandInfo.dataSize;
+        auxBuffer += count * auxStride;
     }
-
+    
+    if (retval == SUCCESS && gpmi_nand_check_ecc_pages(pendingAux, pendingCount, auxStride) != SUCCESS)
+    {
+        eccStatus = ERROR_DDI_NAND_GPMI_UNCORRECTABLE_ECC;
+    }
+    
     // Clear and reenable the BCH IRQ.
     bch_clear_complete_irq();
+    
+    return (retval != SUCCESS) ? retval : eccStatus;
+}
 
+int gpmi_nand_read_interleaved(gpmi_nand_page_op_t * ops, unsigned count)
+{
+    unsigned chipSelects[GPMI_CHIP_SELECT_COUNT];
+    uint32_t pages[GPMI_CHIP_SELECT_COUNT];
+    void * dataBuffers[GPMI_CHIP_SELECT_COUNT];
+    void * auxBuffers[GPMI_CHIP_SELECT_COUNT];
+    unsigned usedChips = 0;
+    unsigned i;
+    int retval;
+    
+    assert(count > 0 && count <= GPMI_CHIP_SELECT_COUNT);
+    
+    for (i = 0; i < count; ++i)
+    {
+        // Each NAND can only hold one page in its page register.
+        assert(ops[i].chipSelect < GPMI_CHIP_SELECT_COUNT);
+        assert((usedChips & (1 << ops[i].chipSelect)) == 0);
+        usedChips |= 1 << ops[i].chipSelect;
+        
+        chipSelects[i] = ops[i].chipSelect;
+        pages[i] = ops[i].pageNumber;
+        dataBuffers[i] = ops[i].buffer;
+        auxBuffers[i] = ops[i].auxBuffer;
+    }
+    
+    s_interleavedReadDma.setPages(count, chipSelects, pages, dataBuffers, auxBuffers);
+    
+    bch_clear_complete_irq();
+    retval = s_interleavedReadDma.run(kNandReadPageTimeout);
+    
+    for (i = 0; i < count; ++i)
+    {
+        ops[i].status = (retval == SUCCESS) ? gpmi_nand_check_ecc(ops[i].auxBuffer) : retval;
+        
+        if (retval == SUCCESS && ops[i].status != SUCCESS)
+        {
+            retval = ops[i].status;
+        }
+    }
+    
+    // Clear and reenable the BCH IRQ.
+    bch_clear_complete_irq();
+    
     return retval;
 }
 
@@ -391,39 +603,16 @@ int gpmi_nand_write_page(unsigned chipSelect, uint32_t pageNumber, const uint8_t
 {
     int rtCode = SUCCESS;
 
+    assert(chipSelect < GPMI_CHIP_SELECT_COUNT);
+    NandDma::WriteEccData & writeDma = s_dmaChains[chipSelect].writePage;
+
     // Enable writes to this NAND for this scope.
     gpmi_enable_writes(true);
 
-    // Prepare some info.
-    uint32_t sendSize = g_nandInfo.dataSize + g_nandInfo.auxSize;
-    uint32_t eccMask = bch_get_buffer_mask(true, sendSize, &g_nandInfo.ecc);
-
-    // Construct the write DMA descriptor chain.
-    NandDma::WriteEccData writeDma(
-        chipSelect, // chipSelect,
-        kNandCommand_SerialDataInput, // command1,
-        NULL, // addressBytes,
-        g_nandInfo.totalAddressBytes, // addressByteCount,
-        kNandCommand_WritePage, // command2,
-        buffer, // dataBuffer,
-        auxBuffer, // auxBuffer,
-        sendSize, // sendSize,
-        g_nandInfo.dataSize, // dataSize,
-        g_nandInfo.auxSize, // leftoverSize,
-        g_nandInfo.ecc,
-        eccMask);
-
-    // Update shared DMA descriptors.
+    // Patch the prebuilt chain with the page address and buffers. The status read stays
+    // chained on.
     writeDma.setAddress(0, pageNumber);
-    
-    // Init status read DMA.
-    NandDma::ReadStatus statusDma(chipSelect, kNandCommand_ReadStatus, s_resultBuffer);
-    
-    // Chain the status read onto the page write.
-    writeDma >> statusDma;
-
-    printf("Write DMA:\n");
-    writeDma.dumpChain();
+    writeDma.setBuffers(buffer, auxBuffer);
     
     // Make sure the BCH complete IRQ is cleared.
     bch_clear_complete_irq();
@@ -451,6 +640,142 @@ int gpmi_nand_write_page(unsigned chipSelect, uint32_t pageNumber, const uint8_t
     return rtCode;
 }
 
+int gpmi_nand_write_pages(unsigned chipSelect, uint32_t firstPage, uint32_t pageCount, const uint8_t * buffer, const uint8_t * auxBuffer, uint32_t auxStride)
+{
+    int rtCode = SUCCESS;
+    
+    assert(chipSelect < GPMI_CHIP_SELECT_COUNT);
+    
+    if (!g_nandInfo.useCacheCommands)
+    {
+        for (; pageCount && rtCode == SUCCESS; --pageCount)
+        {
+            rtCode = gpmi_nand_write_page(chipSelect, firstPage++, buffer, auxBuffer);
+            
+            buffer += g_nandInfo.dataSize;
+            auxBuffer += auxStride;
+        }
+        return rtCode;
+    }
+    
+    // Enable writes to this NAND for this scope.
+    gpmi_enable_writes(true);
+    
+    s_writePagesDma.setChipSelect(chipSelect);
+    
+    while (pageCount && rtCode == SUCCESS)
+    {
+        uint32_t count = gpmi_nand_chain_pages(firstPage, pageCount);
+        uint32_t i;
+        
+        s_writePagesDma.setPages(firstPage, count, buffer, g_nandInfo.dataSize, auxBuffer, auxStride);
+        
+        // Make sure the BCH complete IRQ is cleared.
+        bch_clear_complete_irq();
+        
+        rtCode = s_writePagesDma.run(kNandWritePageTimeout * count);
+        
+        if (rtCode == SUCCESS)
+        {
+            // Each status reports the page before it; the last one also reports its own.
+            for (i = 1; i < count; ++i)
+            {
+                if (s_writePagesDma.getStatus(i) & kNandStatus_CacheFail)
+                {
+                    rtCode = ERROR_DDI_NAND_HAL_WRITE_FAILED;
+                }
+            }
+            if (gpmi_nand_check_status(s_writePagesDma.getStatus(count - 1)) != SUCCESS)
+            {
+                rtCode = ERROR_DDI_NAND_HAL_WRITE_FAILED;
+            }
+        }
+        
+        firstPage += count;
+        pageCount -= count;
+        buffer += count * g_nandInfo.dataSize;
+        auxBuffer += count * auxStride;
+    }
+    
+    // Clear and reenable the BCH IRQ.
+    bch_clear_complete_irq();
+    
+    // Disable writes.
+    gpmi_enable_writes(false);
+    
+    return rtCode;
+}
+
+int gpmi_nand_write_interleaved(gpmi_nand_page_op_t * ops, unsigned count)
+{
+    unsigned chipSelects[GPMI_CHIP_SELECT_COUNT];
+    uint32_t pages[GPMI_CHIP_SELECT_COUNT];
+    const void * dataBuffers[GPMI_CHIP_SELECT_COUNT];
+    const void * auxBuffers[GPMI_CHIP_SELECT_COUNT];
+    unsigned usedChips = 0;
+    unsigned i;
+    int rtCode;
+    
+    assert(count > 0 && count <= GPMI_CHIP_SELECT_COUNT);
+    
+    for (i = 0; i < count; ++i)
+    {
+        assert(ops[i].chipSelect < GPMI_CHIP_SELECT_COUNT);
+        assert((usedChips & (1 << ops[i].chipSelect)) == 0);
+        usedChips |= 1 << ops[i].chipSelect;
+        
+        chipSelects[i] = ops[i].chipSelect;
+        pages[i] = ops[i].pageNumber;
+        dataBuffers[i] = ops[i].buffer;
+        auxBuffers[i] = ops[i].auxBuffer;
+    }
+    
+    // Enable writes to these NANDs for this scope.
+    gpmi_enable_writes(true);
+    
+    s_interleavedWriteDma.setPages(count, chipSelects, pages, dataBuffers, auxBuffers);
+    
+    // Make sure the BCH complete IRQ is cleared.
+    bch_clear_complete_irq();
+    
+    rtCode = s_interleavedWriteDma.run(kNandWritePageTimeout);
+    
+    for (i = 0; i < count; ++i)
+    {
+        if (rtCode != SUCCESS)
+        {
+            ops[i].status = rtCode;
+        }
+        else if (gpmi_nand_check_status(s_interleavedWriteDma.getStatus(i)) != SUCCESS)
+        {
+            ops[i].status = ERROR_DDI_NAND_HAL_WRITE_FAILED;
+        }
+        else
+        {
+            ops[i].status = SUCCESS;
+        }
+    }
+    
+    if (rtCode == SUCCESS)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            if (ops[i].status != SUCCESS)
+            {
+                rtCode = ops[i].status;
+            }
+        }
+    }
+    
+    // Clear and reenable the BCH IRQ.
+    bch_clear_complete_irq();
+    
+    // Disable writes.
+    gpmi_enable_writes(false);
+    
+    return rtCode;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // EOF
 ////////////////////////////////////////////////////////////////////////////////
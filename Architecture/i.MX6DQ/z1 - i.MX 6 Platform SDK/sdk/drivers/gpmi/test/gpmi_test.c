@@ -43,6 +43,16 @@ static uint8_t s_page_buffer[8192] __ALIGN4__;
 static uint8_t s_read_buffer[8192] __ALIGN4__;
 static uint8_t s_aux_buffer[1024] __ALIGN4__;
 
+//! Number of pages written and read by the multi-page test.
+#define MULTI_PAGE_COUNT (4)
+
+//! Distance between the aux areas of consecutive pages.
+#define MULTI_AUX_STRIDE (256)
+
+static uint8_t s_multi_page_buffer[MULTI_PAGE_COUNT * 4096] __ALIGN4__;
+static uint8_t s_multi_read_buffer[MULTI_PAGE_COUNT * 4096] __ALIGN4__;
+static uint8_t s_multi_aux_buffer[MULTI_PAGE_COUNT * MULTI_AUX_STRIDE] __ALIGN4__;
+
 const unsigned kMaxBufferBytes = sizeof(s_page_buffer);
 
 uint32_t g_actualBufferBytes = sizeof(s_page_buffer);
@@ -269,6 +279,40 @@ int gpmi_test(void)
         printf("Read back comparison failed!\n");
         return ~0;
     }
+    
+    // ---------- Multi-page r/w test
+    
+    // Write a pattern to the pages following page 0 with cache programming.
+    uint32_t page;
+    for (page = 0; page < MULTI_PAGE_COUNT; ++page)
+    {
+        fill_data_buffer(&s_multi_page_buffer[page * g_actualBufferBytes], page + 1, 0);
+        fill_aux(&s_aux_buffer[0], page + 1);
+        memcpy(&s_multi_aux_buffer[page * MULTI_AUX_STRIDE], s_aux_buffer, MULTI_AUX_STRIDE);
+    }
+    
+    printf("Writing pages 1-%d...\n", MULTI_PAGE_COUNT);
+    status = gpmi_nand_write_pages(0, 1, MULTI_PAGE_COUNT, s_multi_page_buffer, s_multi_aux_buffer, MULTI_AUX_STRIDE);
+    if (status)
+    {
+        printf("Failed to write pages with error %d\n", status);
+        return status;
+    }
+    
+    // Read them back with cache reads and compare.
+    printf("Reading pages 1-%d...\n", MULTI_PAGE_COUNT);
+    status = gpmi_nand_read_pages(0, 1, MULTI_PAGE_COUNT, s_multi_read_buffer, s_multi_aux_buffer, MULTI_AUX_STRIDE);
+    if (status)
+    {
+        printf("Failed to read pages with error %d\n", status);
+        return status;
+    }
+    
+    if (!compare_buffers(s_multi_page_buffer, s_multi_read_buffer, MULTI_PAGE_COUNT * g_actualBufferBytes))
+    {
+        printf("Multi-page read back comparison failed!\n");
+        return ~0;
+    }
 #endif // ENABLE_ECC_TEST
 
     printf("Done!\n");
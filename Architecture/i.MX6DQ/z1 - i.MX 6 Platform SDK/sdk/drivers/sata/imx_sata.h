@@ -32,6 +32,7 @@
 
 #include "sdk.h"
 #include "registers/regssata.h"
+#include "utility/block_queue.h"
 
 //////////////////////////////////////////////////////////////////////////////
 // Definitions
@@ -57,6 +58,13 @@ typedef signed int s32;
 #define SATA_MAX_TRANSFER_SECTOR_CNT    32
 #define SATA_MAX_TRANSFER_DATA_SZ     (SATA_HDD_SECTOR_SIZE*SATA_MAX_TRANSFER_SECTOR_CNT)
 
+//! @brief Scatter-gather DMA transfers
+#define SATA_MAX_LBA28_SECTOR_CNT       256     //READ/WRITE DMA, a sector count of 0 means 256
+#define SATA_MAX_LBA48_SECTOR_CNT       65536   //READ/WRITE DMA EXT, a sector count of 0 means 65536
+#define SATA_PRD_MAX_DATA_SZ            (4*1024*1024)   //Byte count limit of a single PRD
+#define SATA_PRDT_MAX_ENTRIES           65535   //PRDTL is a 16-bit field
+#define SATA_IDENTIFY_CMD_SET_LBA48     (1<<10) //Identify word 83, 48-bit address feature set supported
+
 #define MAX_TIMEOUT_COUNTER           0x1FFFF
 #define PORT_N_INIT_TIMEOUT           500000    // 500ms
 #define PORT_N_DET_TIEMOUT            1000  // 1ms
@@ -85,6 +93,13 @@ typedef signed int s32;
 
 #define IOC                                0x1  //Interrupt On Complete
 
+//! @brief Native Command Queuing
+#define SATA_NCQ_SLOTS                     32   //Command slots of a port, all usable for queued commands
+#define SATA_NCQ_MAX_TRANSFER_DATA_SZ      (4*1024*1024)    //Limit of the single PRD of a queued command
+#define SATA_NCQ_FPDMA_TAG_SHIFT           3    //Tag position in the sector count field of the FIS
+#define SATA_IDENTIFY_SATA_CAP_NCQ         (1<<8)   //Identify word 76, NCQ supported
+#define SATA_IDENTIFY_QUEUE_DEPTH_MASK     0x1F //Identify word 75, maximum queue depth - 1
+
 //! @brief TIMER1MS
 //! @brief 1ms is AHB Frequency 133MHz/1000, the default value is 100000 for 100Mhz frequency
 #define SATA_AHCI_HOST_TIMER1MS_MASK       133000
@@ -98,6 +113,13 @@ typedef signed int s32;
 #define SATA_AHCI_HOST_OOBR_COMINIT_MIN_VAL  (0x0b<<8)
 #define SATA_AHCI_HOST_OOBR_COMINIT_MAX_VAL  (0x14<<0)
 
+//! @brief Port interrupt status bits that mean the commands in progress failed
+#define SATA_AHCI_PORT_N_IS_ERROR_MASK     (BM_SATA_P0IS_TFES \
+                                           |BM_SATA_P0IS_HBFS \
+                                           |BM_SATA_P0IS_HBDS \
+                                           |BM_SATA_P0IS_IFS \
+                                           |BM_SATA_P0IS_OFS)
+
 #define SATA_AHCI_PORT_N_INTR_ENANBLE_MASK (BM_SATA_P0IE_TFEE \
                                            |BM_SATA_P0IE_HBFE \
                                            |BM_SATA_P0IE_HBDE \
@@ -516,10 +538,37 @@ typedef struct SATA_COMMAND_TABLE {
     sata_cfis_t cfis;           //defintion of
     u32 acmd[4];                //ATAPI Command, up to 16 Bytes
     u32 rsv[12];                //64 byte reserved.
-    sata_prd_t prdt;            //Base Address Physical Region Descriptor Table, max 65535 entries
-    //there is only one prdt
+    sata_prd_t prdt[1];         //Physical Region Descriptor Table, up to 65535 entries follow the first
 } sata_command_table_t;
 
+//! @brief Size of a command table with @a n PRD entries
+#define SATA_COMMAND_TABLE_SIZE_FOR(n) (sizeof(sata_command_table_t) + ((n) - 1) * sizeof(sata_prd_t))
+
+//! @brief Number of PRD entries that fit in the command table at SATA_COMMAND_TABLE_BASE
+#define SATA_COMMAND_TABLE_PRD_CNT     ((SATA_COMMAND_TABLE_SIZE - sizeof(sata_command_table_t)) / sizeof(sata_prd_t) + 1)
+
+//! @brief One buffer of a scatter-gather transfer, 2-byte aligned with an even length
+typedef struct sata_iovec {
+    u8 *buf;
+    u32 len;
+} sata_iovec_t;
+
+//! @brief Spacing of the per-slot command tables of queued commands, they must be 128-byte aligned
+#define SATA_NCQ_COMMAND_TABLE_SIZE    ((sizeof(sata_command_table_t) + 127) & ~127)
+
+/*!
+ * @brief Completion callback of a queued command
+ *
+ * Called from deferred work, or from the SATA interrupt handler when no work queue runs on
+ * the core. The buffer of a read already belongs to the CPU again when it is called, and the
+ * command slot is free, so the callback may queue the next command.
+ *
+ * @param port        - SATA port
+ * @param status      - SATA_PASS or SATA_FAIL
+ * @param arg         - Argument given when the command was queued
+ */
+typedef void (*sata_ncq_callback_t)(u32 port, sata_return_t status, void *arg);
+
 //////////////////////////////////////////////////////////////////////////////
 // API
 //////////////////////////////////////////////////////////////////////////////
@@ -569,6 +618,122 @@ sata_return_t sata_disk_write_sector(u32 start_block, u8 * buf, u32 len, u32 por
  */
 sata_return_t sata_disk_read_sector(u32 start_block, u8 * buf, u32 len, u32 port);
 
+/*!
+ * @brief Read sectors from SATA disk into a list of buffers
+ *
+ * The buffers are described by a Physical Region Descriptor Table, so a request moves with as
+ * few commands as possible: READ DMA EXT transfers up to SATA_MAX_LBA48_SECTOR_CNT sectors at a
+ * time if the disk supports 48-bit addressing, READ DMA up to SATA_MAX_LBA28_SECTOR_CNT
+ * otherwise. Tables with more PRD entries than fit at SATA_COMMAND_TABLE_BASE are allocated from
+ * the coherent DMA pool.
+ *
+ * @param start_block - Address of start sector
+ * @param iov         - Destination buffers, filled in order
+ * @param iovcnt      - Number of buffers
+ * @param port        - SATA port
+ * @return SATA_PASS or SATA_FAIL, also if the total length is not a multiple of the sector size
+ */
+sata_return_t sata_disk_readv(u32 start_block, const sata_iovec_t * iov, u32 iovcnt, u32 port);
+
+/*!
+ * @brief Write sectors to SATA disk from a list of buffers
+ *
+ * @param start_block - Address of start sector
+ * @param iov         - Source buffers, written in order
+ * @param iovcnt      - Number of buffers
+ * @param port        - SATA port
+ * @return SATA_PASS or SATA_FAIL
+ * @see sata_disk_readv()
+ */
+sata_return_t sata_disk_writev(u32 start_block, const sata_iovec_t * iov, u32 iovcnt, u32 port);
+
+/*!
+ * @brief Start a stream of sequential writes
+ *
+ * Until sata_stream_write_end() returns, no other command may be issued to the port.
+ *
+ * @param start_block - Sector the first buffer is written to
+ * @param port        - SATA port
+ * @return SATA_PASS or SATA_FAIL if a stream is already open
+ */
+sata_return_t sata_stream_write_begin(u32 start_block, u32 port);
+
+/*!
+ * @brief Write the next buffer of a stream
+ *
+ * Waits for the write of the previous buffer, then starts writing this one behind it and
+ * returns without waiting, so the caller can fill the next buffer meanwhile. The buffer is
+ * owned by the driver until the next call to sata_stream_write() or sata_stream_write_end()
+ * returns; two buffers used alternately keep the disk busy.
+ *
+ * @param buf         - Pointer of source buffer, 2-byte aligned
+ * @param len         - Length to write, a multiple of the sector size
+ * @param port        - SATA port
+ * @return SATA_PASS or SATA_FAIL if this or the previous write failed
+ */
+sata_return_t sata_stream_write(u8 * buf, u32 len, u32 port);
+
+/*!
+ * @brief Wait for the last write of a stream and close it
+ *
+ * @param port        - SATA port
+ * @return SATA_PASS or SATA_FAIL if the last write failed
+ */
+sata_return_t sata_stream_write_end(u32 port);
+
+/*!
+ * @brief Prepare a port for native command queuing
+ *
+ * Must be called after sata_identify() found a device that supports NCQ. Allocates a command
+ * table for each of the command slots and installs the SATA interrupt handler, which is
+ * only enabled while queued commands are outstanding so the polled commands above keep
+ * working. Those must not be issued while queued commands are outstanding.
+ *
+ * @param port        - SATA port
+ * @return SATA_PASS or SATA_FAIL
+ */
+sata_return_t sata_ncq_init(u32 port);
+
+/*!
+ * @brief Queue a READ FPDMA QUEUED command
+ *
+ * Returns as soon as the command is issued. Up to the queue depth of the device, commands
+ * run concurrently and may complete in any order.
+ *
+ * @param start_block - Address of start sector
+ * @param buf         - Pointer of destination buffer, 2-byte aligned
+ * @param len         - Length to read, a multiple of the sector size up to SATA_NCQ_MAX_TRANSFER_DATA_SZ
+ * @param port        - SATA port
+ * @param callback    - Called when the command completed
+ * @param arg         - Passed to the callback
+ * @return SATA_PASS if the command was queued, SATA_FAIL if all slots are busy or the arguments are
+ *         invalid, in which case the callback is not called
+ */
+sata_return_t sata_ncq_read_sector(u32 start_block, u8 * buf, u32 len, u32 port,
+                                   sata_ncq_callback_t callback, void *arg);
+
+/*!
+ * @brief Queue a WRITE FPDMA QUEUED command
+ *
+ * @param start_block - Address of start sector
+ * @param buf         - Pointer of source buffer, 2-byte aligned
+ * @param len         - Length to write, a multiple of the sector size up to SATA_NCQ_MAX_TRANSFER_DATA_SZ
+ * @param port        - SATA port
+ * @param callback    - Called when the command completed
+ * @param arg         - Passed to the callback
+ * @return SATA_PASS if the command was queued, SATA_FAIL otherwise
+ */
+sata_return_t sata_ncq_write_sector(u32 start_block, u8 * buf, u32 len, u32 port,
+                                    sata_ncq_callback_t callback, void *arg);
+
+/*!
+ * @brief Number of queued commands whose callback has not returned yet
+ *
+ * @param port        - SATA port
+ * @return Number of busy command slots
+ */
+u32 sata_ncq_pending(u32 port);
+
 /*!
  * @brief Print out buffer data
  *
@@ -578,6 +743,17 @@ sata_return_t sata_disk_read_sector(u32 start_block, u8 * buf, u32 len, u32 port
  */
 void printf_buffer(u32 buff, u32 size, u32 enable);
 
+/*!
+ * @brief Set up a block device for a request queue
+ *
+ * Requests are carried out with sata_disk_readv() and sata_disk_writev() and complete
+ * before the submit call returns, so the device handles one request at a time.
+ *
+ * @param port        - SATA port, already identified
+ * @param device      - Filled in with the device description
+ */
+void sata_blk_device_init(u32 port, blk_device_t * device);
+
 //! @}
 
 #endif
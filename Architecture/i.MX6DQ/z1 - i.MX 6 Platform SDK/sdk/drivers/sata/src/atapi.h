@@ -46,6 +46,8 @@ typedef enum ATAPI_COMMAND {
     ATAPI_COMMAND_WRITE_DMA = 0xCA,
     ATAPI_COMMAND_WRITE_SECTOR = 0x30,
     ATAPI_COMMAND_WRITE_DMA_QUEUED = 0xCC,
+    ATAPI_COMMAND_READ_DMA_EXT = 0x25,
+    ATAPI_COMMAND_WRITE_DMA_EXT = 0x35,
     ATAPI_COMMAND_DIAGNOSIS = 0x90,
     ATAPI_COMMAND_PACKET = 0xA0,
     ATAPI_COMMAND_READ_BUFFER = 0xE4,
@@ -60,6 +62,8 @@ typedef enum ATAPI_COMMAND {
     ATAPI_COMMAND_DEVICE_RESET = 0x08,
     ATAPI_COMMAND_CFA_WRITE_MULTI_W_OUT_ERASE = 0xCD,
     ATAPI_COMMAND_CFA_WRITE_SECTOR_W_OUT_ERASE = 0xCD,
+    ATAPI_COMMAND_READ_FPDMA_QUEUED = 0x60,
+    ATAPI_COMMAND_WRITE_FPDMA_QUEUED = 0x61,
 } atapi_cmd_t;
 
 //! @brief Data structure defined based on ATAPI7 specification(T13/1532D)
@@ -101,7 +105,8 @@ typedef struct sata_identify_data_t_ {
     u16 min_pio_iordy_timing;   // 68    : min PIO transfer time with IORDY flow control
     u16 rsv18[6];               // 69-74 : reserved
     u16 queue_depth;            // 75    : queue depth
-    u16 rsv19[4];               // 76-79 : reserved for SATA
+    u16 sata_capabilities;      // 76    : SATA capabilities, bit 8 -> NCQ supported
+    u16 rsv19[3];               // 77-79 : reserved for SATA
     u16 major_ver;              // 80    : major version number
     u16 minor_ver;              // 81    : minor version number
     u16 cmd_set_supp[3];        // 82-84 : command set supported
@@ -35,6 +35,11 @@
 #include "timer/timer.h"
 #include "registers.h"
 #include "buffers.h"
+#include "core/cortex_a9.h"
+#include "core/dma_alloc.h"
+#include "core/interrupt.h"
+#include "utility/atomics.h"
+#include "utility/work_queue.h"
 
 //////////////////////////////////////////////////////////////////////////////
 // Definitions
@@ -223,6 +228,8 @@ sata_return_t sata_dma_read_sector(u32 start_block, u8 * buf, u32 len, u32 port)
     sect_cnt = len / SATA_HDD_SECTOR_SIZE;
     sect_start_addr = start_block;  //*SATA_HDD_SECTOR_SIZE;
     u32 try_times = 10;
+
+    dma_sync_for_device(buf, len, kDmaFromDevice);
   exec:
 
     if (try_times == 0) {
@@ -261,6 +268,8 @@ sata_return_t sata_dma_read_sector(u32 start_block, u8 * buf, u32 len, u32 port)
         }
     }
 
+    dma_sync_for_cpu(buf, len, kDmaFromDevice);
+
     return (!ret);
 }
 
@@ -273,6 +282,8 @@ sata_return_t sata_dma_write_sector(u32 start_block, u8 * buf, u32 len, u32 port
     sect_cnt = len / SATA_HDD_SECTOR_SIZE;
     sect_start_addr = start_block;  //start_block*SATA_HDD_SECTOR_SIZE;
     u32 try_times = 10;
+
+    dma_sync_for_device(buf, len, kDmaToDevice);
   exec:
 
     if (try_times == 0) {
@@ -318,6 +329,17 @@ sata_return_t sata_dma_write_sector(u32 start_block, u8 * buf, u32 len, u32 port
 
 sata_return_t sata_disk_read_sector(u32 start_block, u8 * buf, u32 len, u32 port)
 {
+#ifdef SATA_PDMA_ENABLED
+    sata_iovec_t iov;
+
+    PRINT(0, "+SATAINFO: sata_disk_read_sector@blk %d, buf 0x%08x, sz %d\n", start_block, (u32) buf,
+          len);
+
+    iov.buf = buf;
+    iov.len = len;
+
+    return sata_disk_readv(start_block, &iov, 1, port);
+#else
     u32 i = 0;
     u32 cycle = 0;
     u32 sz = 0;
@@ -341,12 +363,8 @@ sata_return_t sata_disk_read_sector(u32 start_block, u8 * buf, u32 len, u32 port
             sz = len;
 
         PRINT(0, "+SATAINFO: sata_disk_read_sector cycle %d,blk %d,sz %d\n", i, blk, sz);
-#ifdef SATA_PDMA_ENABLED
 
-        if (!sata_dma_read_sector(blk, (buf + xfer_sz), sz, port))
-#else
         if (!sata_pio_read_sector(blk, (buf + xfer_sz), sz, port))
-#endif
         {
             PRINT(0, "+SATAERR: sata_disk_read_sector error@blk %d, buf 0x%08x, sz %d\n", blk,
                   (u32) ((u8 *) buf + i * single_rd_sz), sz);
@@ -359,17 +377,28 @@ sata_return_t sata_disk_read_sector(u32 start_block, u8 * buf, u32 len, u32 port
     }
 
     return SATA_PASS;
+#endif
 }
 
 sata_return_t sata_disk_write_sector(u32 start_block, u8 * buf, u32 len, u32 port)
 {
+#ifdef SATA_PDMA_ENABLED
+    sata_iovec_t iov;
+
+    PRINT(0, "+SATAINFO: sata_disk_write_sector@blk %d, buf 0x%08x, sz %d\n", start_block,
+          (u32) buf, len);
+
+    iov.buf = buf;
+    iov.len = len;
+
+    return sata_disk_writev(start_block, &iov, 1, port);
+#else
     u32 i = 0;
     u32 cycle = 0;
     u32 sz = 0;
     u32 single_wr_sz = SATA_MAX_TRANSFER_DATA_SZ;   // total 32 sectors was transferred each time
     u32 blk;
     u32 xfer_sz = 0;
-    cycle = len / single_wr_sz;
 
     cycle = len / single_wr_sz;
 
@@ -389,12 +418,7 @@ sata_return_t sata_disk_write_sector(u32 start_block, u8 * buf, u32 len, u32 por
 
         PRINT(0, "+SATAINFO: sata_disk_write_sector cycle%d,blk %d,sz %d\n", i, blk, sz);
 
-#ifdef SATA_PDMA_ENABLED
-
-        if (!sata_dma_write_sector(blk, (buf + xfer_sz), sz, port))
-#else
         if (!sata_pio_write_sector(blk, (buf + xfer_sz), sz, port))
-#endif
         {
             PRINT(0, "+SATAERR: sata_disk_write_sector error@%d\n", i);
             return SATA_FAIL;
@@ -406,6 +430,7 @@ sata_return_t sata_disk_write_sector(u32 start_block, u8 * buf, u32 len, u32 por
     }
 
     return SATA_PASS;
+#endif
 }
 
 void printf_buffer(u32 buff, u32 size, u32 enable)
@@ -998,8 +1023,8 @@ static sata_return_t sata_reg_fis_h2d(u32 port,
     cmdt->cfis.device = 0x40;
     cmdt->cfis.sectorNum = sect_cnt;
 
-    cmdt->prdt.dba = data_addr;
-    cmdt->prdt.dbc_ioc = ((size) - 1) | (IOC << 31);
+    cmdt->prdt[0].dba = data_addr;
+    cmdt->prdt[0].dbc_ioc = ((size) - 1) | (IOC << 31);
 
     //printf_buffer((u32)cmdt,sizeof(sata_command_table_t),0);
 
@@ -1603,6 +1628,776 @@ sata_return_t sata_identify(u32 port)
     return SATA_PASS;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Scatter-gather DMA
+//////////////////////////////////////////////////////////////////////////////
+
+//! @brief Timeout of a DMA transfer, 1s plus 16 bytes/us
+#define SATA_SG_TIMEOUT_US(len)     (1000000 + (len) / 16)
+
+//! @brief Command table for PRD tables too large for SATA_COMMAND_TABLE_BASE, grown on demand
+static sata_command_table_t *sata_sg_table = NULL;
+static u32 sata_sg_table_prds = 0;
+
+//! @brief The write of a stream in progress
+static struct {
+    u32 port;
+    u32 open;
+    u32 lba;                    //next sector of the stream
+    u32 busy;                   //a write was issued and not waited for
+    u32 busy_lba;
+    u32 busy_len;
+    u32 busy_prds;
+} sata_stream;
+
+/*!
+ * @brief Largest number of sectors a single DMA command moves on the attached disk
+ */
+static u32 sata_sg_max_sectors(void)
+{
+    if (hdd_ident.cmd_set_supp[1] & SATA_IDENTIFY_CMD_SET_LBA48) {
+        return SATA_MAX_LBA48_SECTOR_CNT;
+    }
+
+    return SATA_MAX_LBA28_SECTOR_CNT;
+}
+
+/*!
+ * @brief Pick a command table for a transfer
+ *
+ * @param prds PRD entries the whole transfer needs
+ * @param max_prds Returns the number of PRD entries the table holds
+ * @return The table
+ */
+static sata_command_table_t *sata_sg_get_table(u32 prds, u32 * max_prds)
+{
+    if (prds > SATA_PRDT_MAX_ENTRIES) {
+        prds = SATA_PRDT_MAX_ENTRIES;
+    }
+
+    if (prds > SATA_COMMAND_TABLE_PRD_CNT) {
+        if (sata_sg_table_prds < prds) {
+            if (sata_sg_table) {
+                dma_free_coherent(sata_sg_table);
+            }
+
+            sata_sg_table = dma_alloc_coherent(SATA_COMMAND_TABLE_SIZE_FOR(prds), 128);
+            sata_sg_table_prds = sata_sg_table ? prds : 0;
+        }
+
+        /*without memory the transfer takes more commands */
+        if (sata_sg_table) {
+            *max_prds = sata_sg_table_prds;
+            return sata_sg_table;
+        }
+    }
+
+    *max_prds = SATA_COMMAND_TABLE_PRD_CNT;
+    return (sata_command_table_t *) SATA_COMMAND_TABLE_BASE;
+}
+
+/*!
+ * @brief Fill a PRD table with the next part of a buffer list
+ *
+ * @param prdt PRD table
+ * @param max_prds Entries of the table
+ * @param iov Buffer list
+ * @param iovcnt Number of buffers
+ * @param idx Buffer the part starts in, advanced past it
+ * @param off Offset in that buffer, advanced past the part
+ * @param max_bytes Limit of the part
+ * @param bytes Returns the size of the part, a multiple of the sector size
+ * @return Number of PRD entries used
+ */
+static u32 sata_sg_fill_prdt(sata_prd_t * prdt, u32 max_prds, const sata_iovec_t * iov, u32 iovcnt,
+                             u32 * idx, u32 * off, u32 max_bytes, u32 * bytes)
+{
+    u32 n = 0;
+    u32 total = 0;
+    u32 i = *idx;
+    u32 o = *off;
+    u32 sz, rem;
+
+    while ((i < iovcnt) && (n < max_prds) && (total < max_bytes)) {
+        sz = iov[i].len - o;
+
+        if (sz == 0) {
+            i++;
+            o = 0;
+            continue;
+        }
+
+        if (sz > SATA_PRD_MAX_DATA_SZ)
+            sz = SATA_PRD_MAX_DATA_SZ;
+
+        if (sz > max_bytes - total)
+            sz = max_bytes - total;
+
+        prdt[n].dba = (u32) iov[i].buf + o;
+        prdt[n].dbau = 0;
+        prdt[n].rsv = 0;
+        prdt[n].dbc_ioc = sz - 1;
+        n++;
+        total += sz;
+        o += sz;
+    }
+
+    /*a command moves whole sectors, a partial one is left to the next command */
+    rem = total % SATA_HDD_SECTOR_SIZE;
+    total -= rem;
+
+    while (rem) {
+        sz = prdt[n - 1].dbc_ioc + 1;
+
+        if (sz > rem) {
+            prdt[n - 1].dbc_ioc = sz - rem - 1;
+            rem = 0;
+        } else {
+            rem -= sz;
+            n--;
+        }
+    }
+
+    if (n) {
+        prdt[n - 1].dbc_ioc |= (IOC << 31);
+    }
+
+    /*advance the position past the part */
+    i = *idx;
+    o = *off;
+    rem = total;
+
+    while (rem) {
+        sz = iov[i].len - o;
+
+        if (sz > rem) {
+            o += rem;
+            rem = 0;
+        } else {
+            rem -= sz;
+            i++;
+            o = 0;
+        }
+    }
+
+    *idx = i;
+    *off = o;
+    *bytes = total;
+
+    return n;
+}
+
+/*!
+ * @brief Issue a READ/WRITE DMA (EXT) command whose PRD table is already filled
+ *
+ * @param port SATA port
+ * @param sect_addr Start address of the first sector
+ * @param sect_cnt Sector number, up to sata_sg_max_sectors()
+ * @param rw Data transfer direction: read or write
+ * @param cmdt Command table
+ * @param prds Number of PRD entries of the table
+ * @return SATA_PASS or SATA_FAIL
+ */
+static sata_return_t sata_sg_issue(u32 port, u32 sect_addr, u32 sect_cnt, u32 rw,
+                                   sata_command_table_t * cmdt, u32 prds)
+{
+    s32 ept_cmd_slot;
+    sata_command_header_t *cmd_hdr;
+
+    ept_cmd_slot = ahci_find_empty_slot(port);
+
+    if (ept_cmd_slot == -1) {
+        return SATA_FAIL;
+    }
+
+    /*fill command header */
+    cmd_hdr = (sata_command_header_t *) SATA_COMMAND_LIST_BASE + ept_cmd_slot;
+    memset((void *)cmd_hdr, 0x0, sizeof(sata_command_header_t));
+    cmd_hdr->info.field.cfl = 5;
+    cmd_hdr->info.field.write = (rw == SATA_WRITE) ? 1 : 0;
+    cmd_hdr->info.field.prdtl = prds;
+    cmd_hdr->ctba = (u32) cmdt;
+
+    /*fill the command FIS, keep the PRD table */
+    memset((void *)cmdt, 0x0, (u32) cmdt->prdt - (u32) cmdt);
+
+    cmdt->cfis.fisType = SATA_FIS_TYPE_RFIS_H2D;
+    cmdt->cfis.pmPort_Cbit = 0x80;
+    cmdt->cfis.lbaLow = (sect_addr & 0xFF);
+    cmdt->cfis.lbaMid = ((sect_addr >> 8) & 0xFF);
+    cmdt->cfis.lbaHigh = ((sect_addr >> 16) & 0xFF);
+    cmdt->cfis.device = 0x40;
+
+    /*the largest count wraps to 0 */
+    cmdt->cfis.sectorNum = (sect_cnt & 0xFF);
+
+    if (sata_sg_max_sectors() == SATA_MAX_LBA48_SECTOR_CNT) {
+        cmdt->cfis.command = (rw == SATA_WRITE) ? ATAPI_COMMAND_WRITE_DMA_EXT
+                                                : ATAPI_COMMAND_READ_DMA_EXT;
+        cmdt->cfis.lbaLowExp = ((sect_addr >> 24) & 0xFF);
+        cmdt->cfis.sectorNumExp = ((sect_cnt >> 8) & 0xFF);
+    } else {
+        cmdt->cfis.command = (rw == SATA_WRITE) ? ATAPI_COMMAND_WRITE_DMA : ATAPI_COMMAND_READ_DMA;
+        cmdt->cfis.device |= ((sect_addr >> 24) & 0x0F);
+    }
+
+    /*a large command table is in non-cacheable memory, drain the write buffer before issuing */
+    _ARM_DSB();
+
+    /*execute the command */
+    (HW_SATA_PORT(port).CI).U = (1 << ept_cmd_slot);
+
+    return SATA_PASS;
+}
+
+/*!
+ * @brief Wait for a DMA command that can take much longer than a short one
+ *
+ * @param port SATA port
+ * @param len Data transfer size in byte
+ * @return SATA_PASS or SATA_FAIL
+ */
+static sata_return_t sata_sg_wait(u32 port, u32 len)
+{
+    uint64_t deadline = time_get_microseconds() + SATA_SG_TIMEOUT_US(len);
+
+    while (((HW_SATA_IS.U & SATA_AHCI_HOST_IS_PORT_N_INTR_ISSUED(port)) == 0)
+           && (time_get_microseconds() < deadline)) ;
+
+    /*checks the status and clears the interrupt, or times out too */
+    return sata_wait_command_done(port);
+}
+
+/*!
+ * @brief Run one command of a transfer, retrying after errors like the single-buffer functions
+ */
+static sata_return_t sata_sg_run(u32 port, u32 sect_addr, u32 len, u32 rw,
+                                 sata_command_table_t * cmdt, u32 prds)
+{
+    sata_return_t ret = SATA_FAIL;
+    u32 try_times = 10;
+
+    while (try_times--) {
+        ret = sata_sg_issue(port, sect_addr, len / SATA_HDD_SECTOR_SIZE, rw, cmdt, prds);
+
+        if (ret == SATA_PASS) {
+            ret = sata_sg_wait(port, len);
+        }
+
+        if (ret == SATA_PASS) {
+            break;
+        }
+
+        PRINT(0, "+SATAERR: !error@sata_sg_run blk%d,len%d\n", sect_addr, len);
+
+        if (SATA_PASS != sata_non_queued_error_recovery(port)) {
+            break;
+        }
+    }
+
+    return ret;
+}
+
+/*!
+ * @brief Transfer sectors between SATA disk and a list of buffers
+ *
+ * @param start_block Address of start sector
+ * @param iov Buffer list
+ * @param iovcnt Number of buffers
+ * @param port SATA port
+ * @param rw Data transfer direction: read or write
+ * @return SATA_PASS or SATA_FAIL
+ */
+static sata_return_t sata_disk_rw_sg(u32 start_block, const sata_iovec_t * iov, u32 iovcnt,
+                                     u32 port, u32 rw)
+{
+    sata_command_table_t *cmdt;
+    sata_return_t ret = SATA_PASS;
+    dma_direction_t dir = (rw == SATA_WRITE) ? kDmaToDevice : kDmaFromDevice;
+    u32 total = 0;
+    u32 prds = 0;
+    u32 max_prds, max_bytes, n, bytes;
+    u32 idx = 0;
+    u32 off = 0;
+    u32 i;
+
+    if (sata_stream.open) {
+        return SATA_FAIL;
+    }
+
+    for (i = 0; i < iovcnt; i++) {
+        if (((u32) iov[i].buf & 0x1) || (iov[i].len & 0x1)) {
+            PRINT(0, "+SATAERR: misaligned buffer 0x%08x,len%d\n", (u32) iov[i].buf, iov[i].len);
+            return SATA_FAIL;
+        }
+
+        total += iov[i].len;
+        prds += (iov[i].len + SATA_PRD_MAX_DATA_SZ - 1) / SATA_PRD_MAX_DATA_SZ;
+        dma_sync_for_device(iov[i].buf, iov[i].len, dir);
+    }
+
+    if ((total == 0) || (total % SATA_HDD_SECTOR_SIZE)) {
+        return SATA_FAIL;
+    }
+
+    cmdt = sata_sg_get_table(prds, &max_prds);
+    max_bytes = sata_sg_max_sectors() * SATA_HDD_SECTOR_SIZE;
+
+    while (total) {
+        n = sata_sg_fill_prdt(cmdt->prdt, max_prds, iov, iovcnt, &idx, &off, max_bytes, &bytes);
+
+        if (bytes == 0) {
+            /*less than a sector in all the PRD entries */
+            ret = SATA_FAIL;
+            break;
+        }
+
+        ret = sata_sg_run(port, start_block, bytes, rw, cmdt, n);
+
+        if (ret == SATA_FAIL) {
+            PRINT(0, "+SATAERR: sata_disk_rw_sg error@blk %d, sz %d\n", start_block, bytes);
+            break;
+        }
+
+        start_block += bytes / SATA_HDD_SECTOR_SIZE;
+        total -= bytes;
+    }
+
+    if (rw == SATA_READ) {
+        for (i = 0; i < iovcnt; i++) {
+            dma_sync_for_cpu(iov[i].buf, iov[i].len, kDmaFromDevice);
+        }
+    }
+
+    return ret;
+}
+
+sata_return_t sata_disk_readv(u32 start_block, const sata_iovec_t * iov, u32 iovcnt, u32 port)
+{
+    return sata_disk_rw_sg(start_block, iov, iovcnt, port, SATA_READ);
+}
+
+sata_return_t sata_disk_writev(u32 start_block, const sata_iovec_t * iov, u32 iovcnt, u32 port)
+{
+    return sata_disk_rw_sg(start_block, iov, iovcnt, port, SATA_WRITE);
+}
+
+/*!
+ * @brief Wait for the write in progress of the stream, rewriting it after errors
+ */
+static sata_return_t sata_stream_wait(u32 port)
+{
+    sata_command_table_t *cmdt = (sata_command_table_t *) SATA_COMMAND_TABLE_BASE;
+    sata_return_t ret;
+
+    if (!sata_stream.busy) {
+        return SATA_PASS;
+    }
+
+    sata_stream.busy = 0;
+
+    ret = sata_sg_wait(port, sata_stream.busy_len);
+
+    if ((ret == SATA_FAIL) && (SATA_PASS == sata_non_queued_error_recovery(port))) {
+        /*the PRD table is still intact */
+        ret = sata_sg_run(port, sata_stream.busy_lba, sata_stream.busy_len, SATA_WRITE, cmdt,
+                          sata_stream.busy_prds);
+    }
+
+    return ret;
+}
+
+sata_return_t sata_stream_write_begin(u32 start_block, u32 port)
+{
+    if (sata_stream.open) {
+        return SATA_FAIL;
+    }
+
+    sata_stream.port = port;
+    sata_stream.lba = start_block;
+    sata_stream.busy = 0;
+    sata_stream.open = 1;
+
+    return SATA_PASS;
+}
+
+sata_return_t sata_stream_write(u8 * buf, u32 len, u32 port)
+{
+    sata_command_table_t *cmdt = (sata_command_table_t *) SATA_COMMAND_TABLE_BASE;
+    sata_iovec_t iov;
+    u32 max_bytes = sata_sg_max_sectors() * SATA_HDD_SECTOR_SIZE;
+    u32 idx, off, bytes;
+
+    if (!sata_stream.open || (port != sata_stream.port)) {
+        return SATA_FAIL;
+    }
+
+    if ((len == 0) || (len % SATA_HDD_SECTOR_SIZE) || ((u32) buf & 0x1)) {
+        return SATA_FAIL;
+    }
+
+    if (sata_stream_wait(port) == SATA_FAIL) {
+        return SATA_FAIL;
+    }
+
+    dma_sync_for_device(buf, len, kDmaToDevice);
+
+    /*everything but the last command of a large buffer is written right away */
+    while (1) {
+        iov.buf = buf;
+        iov.len = (len > max_bytes) ? max_bytes : len;
+        idx = 0;
+        off = 0;
+        sata_stream.busy_prds = sata_sg_fill_prdt(cmdt->prdt, SATA_COMMAND_TABLE_PRD_CNT, &iov, 1,
+                                                  &idx, &off, max_bytes, &bytes);
+
+        if (bytes == len) {
+            break;
+        }
+
+        if (sata_sg_run(port, sata_stream.lba, bytes, SATA_WRITE, cmdt,
+                        sata_stream.busy_prds) == SATA_FAIL) {
+            return SATA_FAIL;
+        }
+
+        sata_stream.lba += bytes / SATA_HDD_SECTOR_SIZE;
+        buf += bytes;
+        len -= bytes;
+    }
+
+    if (sata_sg_issue(port, sata_stream.lba, len / SATA_HDD_SECTOR_SIZE, SATA_WRITE, cmdt,
+                      sata_stream.busy_prds) == SATA_FAIL) {
+        return SATA_FAIL;
+    }
+
+    sata_stream.busy = 1;
+    sata_stream.busy_lba = sata_stream.lba;
+    sata_stream.busy_len = len;
+    sata_stream.lba += len / SATA_HDD_SECTOR_SIZE;
+
+    return SATA_PASS;
+}
+
+sata_return_t sata_stream_write_end(u32 port)
+{
+    sata_return_t ret;
+
+    if (!sata_stream.open || (port != sata_stream.port)) {
+        return SATA_FAIL;
+    }
+
+    ret = sata_stream_wait(port);
+    sata_stream.open = 0;
+
+    return ret;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Native Command Queuing
+//////////////////////////////////////////////////////////////////////////////
+
+//! @brief A queued command, kept until its callback runs
+typedef struct sata_ncq_slot {
+    sata_ncq_callback_t callback;
+    void *arg;
+    u8 *buf;
+    u32 len;
+    u32 rw;
+} sata_ncq_slot_t;
+
+//! @brief Queuing state of the port passed to sata_ncq_init()
+static struct {
+    u32 port;
+    u32 ready;
+    u32 unusable;               //slots beyond the queue depth of the device, always busy
+    u8 *tables;                 //one command table per slot, SATA_NCQ_COMMAND_TABLE_SIZE apart
+    volatile u32 busy;          //slots owned by a command until its callback returns
+    volatile u32 active;        //slots issued to the device and not completed yet
+    volatile u32 done;          //completed slots whose callback has not run
+    volatile u32 failed;        //slots of done that completed with an error
+    sata_ncq_slot_t slot[SATA_NCQ_SLOTS];
+    work_item_t work;           //runs the callbacks outside of the interrupt handler
+} sata_ncq;
+
+static void sata_ncq_set_bits(volatile u32 * mask, u32 bits)
+{
+    u32 v;
+
+    do {
+        v = *mask;
+    } while (!atomic_compare_and_swap(mask, v, v | bits));
+}
+
+static void sata_ncq_clear_bits(volatile u32 * mask, u32 bits)
+{
+    u32 v;
+
+    do {
+        v = *mask;
+    } while (!atomic_compare_and_swap(mask, v, v & ~bits));
+}
+
+static u32 sata_ncq_take_bits(volatile u32 * mask)
+{
+    u32 v;
+
+    do {
+        v = *mask;
+    } while (!atomic_compare_and_swap(mask, v, 0));
+
+    return v;
+}
+
+/*!
+ * @brief Run the callbacks of the completed queued commands
+ *
+ * @param arg Unused
+ */
+static void sata_ncq_complete(void *arg)
+{
+    u32 port = sata_ncq.port;
+    u32 done = sata_ncq_take_bits(&sata_ncq.done);
+    u32 failed = sata_ncq_take_bits(&sata_ncq.failed);
+    u32 slot;
+    sata_ncq_slot_t cmd;
+
+    /*failures of commands that completed after done was taken are reported next time */
+    if (failed & ~done) {
+        sata_ncq_set_bits(&sata_ncq.failed, failed & ~done);
+        failed &= done;
+    }
+
+    if (failed) {
+        PRINT(1, "+SATAERR: queued commands 0x%08x failed\n", failed);
+
+        /*restarting the port clears PxSACT and PxCI */
+        sata_non_queued_error_recovery(port);
+    }
+
+    while (done) {
+        slot = __builtin_ctz(done);
+        done &= ~(1 << slot);
+
+        cmd = sata_ncq.slot[slot];
+
+        if (cmd.rw == SATA_READ) {
+            dma_sync_for_cpu(cmd.buf, cmd.len, kDmaFromDevice);
+        }
+
+        /*free the slot first, so the callback can queue the next command */
+        sata_ncq_clear_bits(&sata_ncq.busy, 1 << slot);
+
+        cmd.callback(port, (failed & (1 << slot)) ? SATA_FAIL : SATA_PASS, cmd.arg);
+    }
+}
+
+/*!
+ * @brief SATA interrupt handler, only enabled while queued commands are outstanding
+ */
+static void sata_ncq_isr(void)
+{
+    u32 port = sata_ncq.port;
+    u32 stat, err, finished;
+
+    stat = (HW_SATA_PORT(port).IS).U;
+    err = (HW_SATA_PORT(port).SERR).U;
+    (HW_SATA_PORT(port).SERR).U = err;
+    (HW_SATA_PORT(port).IS).U = stat;  //clear port interrupt status
+    HW_SATA_IS.U = SATA_AHCI_HOST_IS_PORT_N_INTR_ISSUED(port);    //clear host global interrupt status
+
+    if (stat & SATA_AHCI_PORT_N_IS_ERROR_MASK) {
+        /*the device aborts all outstanding queued commands on an error */
+        finished = sata_ncq.active;
+        sata_ncq_set_bits(&sata_ncq.failed, finished);
+        sata_port_status_parser(stat);
+    } else {
+        /*a command is done once the device cleared its SActive bit in a Set Device Bits FIS */
+        finished = sata_ncq.active & ~((HW_SATA_PORT(port).SACT).U | (HW_SATA_PORT(port).CI).U);
+    }
+
+    sata_ncq_clear_bits(&sata_ncq.active, finished);
+
+    /*leave the interrupt to polled commands once the queue is idle */
+    if (sata_ncq.active == 0) {
+        disable_interrupt(IMX_INT_SATA, CPU_0);
+
+        /*a command queued meanwhile on another core needs it again */
+        if (sata_ncq.active != 0) {
+            enable_interrupt(IMX_INT_SATA, CPU_0, kIrqPriority_Low);
+        }
+    }
+
+    if (finished) {
+        sata_ncq_set_bits(&sata_ncq.done, finished);
+
+        if (!work_queue(&sata_ncq.work)) {
+            sata_ncq_complete(NULL);
+        }
+    }
+}
+
+/*!
+ * @brief Issue a READ or WRITE FPDMA QUEUED command
+ *
+ * @param start_block Address of start sector
+ * @param buf Data buffer
+ * @param len Data transfer size in byte
+ * @param port SATA port
+ * @param rw Data transfer direction: read or write
+ * @param callback Called when the command completed
+ * @param arg Argument of the callback
+ * @return SATA_PASS or SATA_FAIL
+ */
+static sata_return_t sata_ncq_queue(u32 start_block, u8 * buf, u32 len, u32 port, u32 rw,
+                                    sata_ncq_callback_t callback, void *arg)
+{
+    u32 busy, slot, sect_cnt;
+    sata_command_header_t *cmd_hdr;
+    sata_command_table_t *cmdt;
+
+    if (!sata_ncq.ready || (port != sata_ncq.port) || (callback == NULL)) {
+        return SATA_FAIL;
+    }
+
+    if ((len == 0) || (len % SATA_HDD_SECTOR_SIZE) || (len > SATA_NCQ_MAX_TRANSFER_DATA_SZ)
+        || ((u32) buf & 0x1)) {
+        PRINT(0, "+SATAERR: invalid queued transfer 0x%08x,len%d\n", (u32) buf, len);
+        return SATA_FAIL;
+    }
+
+    /*claim a free slot, its number is also the tag of the command */
+    do {
+        busy = sata_ncq.busy;
+
+        if (busy == 0xFFFFFFFF) {
+            return SATA_FAIL;
+        }
+
+        slot = __builtin_ctz(~busy);
+    } while (!atomic_compare_and_swap(&sata_ncq.busy, busy, busy | (1 << slot)));
+
+    sata_ncq.slot[slot].callback = callback;
+    sata_ncq.slot[slot].arg = arg;
+    sata_ncq.slot[slot].buf = buf;
+    sata_ncq.slot[slot].len = len;
+    sata_ncq.slot[slot].rw = rw;
+
+    dma_sync_for_device(buf, len, (rw == SATA_READ) ? kDmaFromDevice : kDmaToDevice);
+
+    sect_cnt = len / SATA_HDD_SECTOR_SIZE;
+
+    /*fill command header */
+    cmd_hdr = (sata_command_header_t *) SATA_COMMAND_LIST_BASE + slot;
+    cmdt = (sata_command_table_t *) (sata_ncq.tables + slot * SATA_NCQ_COMMAND_TABLE_SIZE);
+
+    memset((void *)cmd_hdr, 0x0, sizeof(sata_command_header_t));
+    cmd_hdr->info.field.cfl = 5;
+    cmd_hdr->info.field.write = (rw == SATA_WRITE) ? 1 : 0;
+    cmd_hdr->info.field.prdtl = 1;
+    cmd_hdr->ctba = (u32) cmdt;
+
+    /*fill command table, the sector count goes to the features field and the tag to the count field */
+    memset((void *)cmdt, 0x0, sizeof(sata_command_table_t));
+
+    cmdt->cfis.fisType = SATA_FIS_TYPE_RFIS_H2D;
+    cmdt->cfis.pmPort_Cbit = 0x80;
+    cmdt->cfis.command = (rw == SATA_WRITE) ? ATAPI_COMMAND_WRITE_FPDMA_QUEUED
+                                            : ATAPI_COMMAND_READ_FPDMA_QUEUED;
+    cmdt->cfis.features = (sect_cnt & 0xFF);
+    cmdt->cfis.featuresExp = ((sect_cnt >> 8) & 0xFF);
+    cmdt->cfis.sectorNum = (slot << SATA_NCQ_FPDMA_TAG_SHIFT);
+    cmdt->cfis.lbaLow = (start_block & 0xFF);
+    cmdt->cfis.lbaMid = ((start_block >> 8) & 0xFF);
+    cmdt->cfis.lbaHigh = ((start_block >> 16) & 0xFF);
+    cmdt->cfis.lbaLowExp = ((start_block >> 24) & 0xFF);
+    cmdt->cfis.device = 0x40;
+
+    cmdt->prdt[0].dba = (u32) buf;
+    cmdt->prdt[0].dbc_ioc = len - 1;
+
+    /*the command table is in non-cacheable memory, drain the write buffer before issuing */
+    _ARM_DSB();
+
+    sata_ncq_set_bits(&sata_ncq.active, 1 << slot);
+
+    /*execute the command, PxSACT has to be set before PxCI */
+    (HW_SATA_PORT(port).SACT).U = (1 << slot);
+    (HW_SATA_PORT(port).CI).U = (1 << slot);
+
+    enable_interrupt(IMX_INT_SATA, CPU_0, kIrqPriority_Low);
+
+    return SATA_PASS;
+}
+
+sata_return_t sata_ncq_init(u32 port)
+{
+    u32 depth;
+
+    if (!(hdd_ident.sata_capabilities & SATA_IDENTIFY_SATA_CAP_NCQ) || !HW_SATA_CAP.B.SNCQ) {
+        PRINT(1, "+SATAINFO: Native Command Queuing not supported\n");
+        return SATA_FAIL;
+    }
+
+    if (sata_ncq.ready && sata_ncq_pending(sata_ncq.port)) {
+        PRINT(1, "+SATAERR: queued commands still outstanding\n");
+        return SATA_FAIL;
+    }
+
+    /*queue depth of the device, limited by the slots of the HBA */
+    depth = (hdd_ident.queue_depth & SATA_IDENTIFY_QUEUE_DEPTH_MASK) + 1;
+
+    if (depth > HW_SATA_CAP.B.NCS + 1) {
+        depth = HW_SATA_CAP.B.NCS + 1;
+    }
+
+    if (sata_ncq.tables == NULL) {
+        sata_ncq.tables = dma_alloc_coherent(SATA_NCQ_SLOTS * SATA_NCQ_COMMAND_TABLE_SIZE, 128);
+
+        if (sata_ncq.tables == NULL) {
+            PRINT(1, "+SATAERR: no memory for the command tables\n");
+            return SATA_FAIL;
+        }
+    }
+
+    sata_ncq.port = port;
+    sata_ncq.unusable = (depth == SATA_NCQ_SLOTS) ? 0 : (0xFFFFFFFF << depth);
+    sata_ncq.busy = sata_ncq.unusable;
+    sata_ncq.active = 0;
+    sata_ncq.done = 0;
+    sata_ncq.failed = 0;
+    work_item_init(&sata_ncq.work, sata_ncq_complete, NULL);
+
+    disable_interrupt(IMX_INT_SATA, CPU_0);
+    register_interrupt_routine(IMX_INT_SATA, sata_ncq_isr);
+
+    sata_ncq.ready = 1;
+
+    PRINT(1, "+SATAINFO: Native Command Queuing enabled, queue depth %d\n", depth);
+
+    return SATA_PASS;
+}
+
+sata_return_t sata_ncq_read_sector(u32 start_block, u8 * buf, u32 len, u32 port,
+                                   sata_ncq_callback_t callback, void *arg)
+{
+    return sata_ncq_queue(start_block, buf, len, port, SATA_READ, callback, arg);
+}
+
+sata_return_t sata_ncq_write_sector(u32 start_block, u8 * buf, u32 len, u32 port,
+                                    sata_ncq_callback_t callback, void *arg)
+{
+    return sata_ncq_queue(start_block, buf, len, port, SATA_WRITE, callback, arg);
+}
+
+u32 sata_ncq_pending(u32 port)
+{
+    if (!sata_ncq.ready || (port != sata_ncq.port)) {
+        return 0;
+    }
+
+    return __builtin_popcount(sata_ncq.busy & ~sata_ncq.unusable);
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // EOF
 //////////////////////////////////////////////////////////////////////////////
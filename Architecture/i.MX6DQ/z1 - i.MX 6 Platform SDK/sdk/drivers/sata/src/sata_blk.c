@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file sata_blk.c
+ * @brief Block device for a request queue on top of the scatter-gather DMA transfers.
+ */
+
+#include "sata/imx_sata.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// Definitions
+//////////////////////////////////////////////////////////////////////////////
+
+//! @brief Largest number of buffers in a request, so the PRD table fits in the protocol buffer
+#define SATA_BLK_MAX_SEGMENTS   128
+
+//////////////////////////////////////////////////////////////////////////////
+// Variables
+//////////////////////////////////////////////////////////////////////////////
+
+//! @brief Buffers of the request in progress
+static sata_iovec_t sata_blk_iov[SATA_BLK_MAX_SEGMENTS];
+
+//////////////////////////////////////////////////////////////////////////////
+// Code
+//////////////////////////////////////////////////////////////////////////////
+
+/*!
+ * @brief Carry out a request with one scatter-gather transfer and complete it
+ *
+ * The non-queued commands are polled, so the request is done when this returns.
+ */
+static int sata_blk_submit(blk_device_t * device, blk_request_t * request)
+{
+    u32 port = (u32) device->context;
+    blk_bio_t *bio;
+    u32 count = 0;
+    sata_return_t ret;
+
+    for (bio = request->bios; bio; bio = bio->next) {
+        sata_blk_iov[count].buf = bio->buffer;
+        sata_blk_iov[count].len = bio->count * SATA_HDD_SECTOR_SIZE;
+        count++;
+    }
+
+    if (request->op == kBlkWrite) {
+        ret = sata_disk_writev(request->sector, sata_blk_iov, count, port);
+    } else {
+        ret = sata_disk_readv(request->sector, sata_blk_iov, count, port);
+    }
+
+    blk_request_complete(request, ret == SATA_PASS ? kBlkSuccess : kBlkError);
+
+    return kBlkSuccess;
+}
+
+void sata_blk_device_init(u32 port, blk_device_t * device)
+{
+    device->name = "sata";
+    device->sectorSize = SATA_HDD_SECTOR_SIZE;
+    device->sectorCount = 0;
+    device->maxSectors = SATA_MAX_LBA48_SECTOR_CNT;
+    device->maxSegments = SATA_BLK_MAX_SEGMENTS;
+    device->queueDepth = 1;
+    device->submit = sata_blk_submit;
+    device->poll = NULL;
+    device->context = (void *)port;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// EOF
+//////////////////////////////////////////////////////////////////////////////
@@ -42,6 +42,15 @@ extern void sata_power_off(void);
 
 static void fill_buffer(u32 buff, u32 size_in_byte);
 
+//! Number of sectors written and read back by the queued test.
+#define SATA_NCQ_TEST_SECTORS   (SATA_NCQ_SLOTS * 2)
+
+//! Number of sectors written from a buffer list and read back.
+#define SATA_SG_TEST_SECTORS    64
+
+static volatile u32 ncq_completed;
+static volatile u32 ncq_errors;
+
 void fill_buffer(u32 buff, u32 size_in_byte)
 {
     u32 *ptr = (u32 *) buff;
@@ -55,6 +64,101 @@ void fill_buffer(u32 buff, u32 size_in_byte)
     }
 }
 
+/*!
+ * @brief Write sectors from a list of odd-sized buffers and as a stream, read them back in one go
+ *
+ * @return SATA_PASS, or SATA_FAIL on a transfer error or data mismatch
+ */
+static sata_return_t sata_sg_test(u8 * wr_buf, u8 * rd_buf)
+{
+    const u32 len = SATA_SG_TEST_SECTORS * SATA_HDD_SECTOR_SIZE;
+    const u32 split[] = { 1000, 24, 4098, 2, len / 2 - 5124 };
+    sata_iovec_t iov[sizeof(split) / sizeof(split[0])];
+    u32 i, off = 0;
+
+    for (i = 0; i < sizeof(split) / sizeof(split[0]); i++) {
+        iov[i].buf = wr_buf + off;
+        iov[i].len = split[i];
+        off += split[i];
+    }
+
+    /*first half from the buffer list, second half as a stream of two writes */
+    if (sata_disk_writev(0, iov, i, PORT0) == SATA_FAIL) {
+        return SATA_FAIL;
+    }
+
+    if ((sata_stream_write_begin(SATA_SG_TEST_SECTORS / 2, PORT0) == SATA_FAIL)
+        || (sata_stream_write(wr_buf + len / 2, len / 4, PORT0) == SATA_FAIL)
+        || (sata_stream_write(wr_buf + len / 2 + len / 4, len / 4, PORT0) == SATA_FAIL)
+        || (sata_stream_write_end(PORT0) == SATA_FAIL)) {
+        return SATA_FAIL;
+    }
+
+    if (sata_disk_read_sector(0, rd_buf, len, PORT0) == SATA_FAIL) {
+        return SATA_FAIL;
+    }
+
+    return memcmp(wr_buf, rd_buf, len) ? SATA_FAIL : SATA_PASS;
+}
+
+static void ncq_test_callback(u32 port, sata_return_t status, void *arg)
+{
+    if (status != SATA_PASS) {
+        ncq_errors++;
+    }
+    ncq_completed++;
+}
+
+/*!
+ * @brief Write and read back sectors with queued commands in scattered order
+ *
+ * @return SATA_PASS, or SATA_FAIL on a queuing error or data mismatch
+ */
+static sata_return_t sata_ncq_test(u8 * wr_buf, u8 * rd_buf)
+{
+    u32 i, sector, issued;
+    sata_return_t ret;
+
+    ncq_completed = 0;
+    ncq_errors = 0;
+
+    for (issued = 0; issued < SATA_NCQ_TEST_SECTORS * 2; issued++) {
+        /*odd sectors first, then even ones, so the drive has something to reorder */
+        i = issued % SATA_NCQ_TEST_SECTORS;
+        sector = (i < SATA_NCQ_TEST_SECTORS / 2) ? (2 * i + 1) : (2 * (i - SATA_NCQ_TEST_SECTORS / 2));
+
+        /*wait for a free slot */
+        do {
+            if (issued < SATA_NCQ_TEST_SECTORS) {
+                ret = sata_ncq_write_sector(sector, wr_buf + sector * SATA_HDD_SECTOR_SIZE,
+                                            SATA_HDD_SECTOR_SIZE, PORT0, ncq_test_callback, NULL);
+            } else {
+                ret = sata_ncq_read_sector(sector, rd_buf + sector * SATA_HDD_SECTOR_SIZE,
+                                           SATA_HDD_SECTOR_SIZE, PORT0, ncq_test_callback, NULL);
+            }
+        } while (ret == SATA_FAIL && sata_ncq_pending(PORT0) != 0);
+
+        if (ret == SATA_FAIL) {
+            return SATA_FAIL;
+        }
+
+        /*all writes have to complete before reading back */
+        if (issued == SATA_NCQ_TEST_SECTORS - 1) {
+            while (ncq_completed != SATA_NCQ_TEST_SECTORS) ;
+        }
+    }
+
+    while (ncq_completed != SATA_NCQ_TEST_SECTORS * 2) ;
+
+    printf("SATA queued write/read of %d sectors, %d errors\n", SATA_NCQ_TEST_SECTORS, ncq_errors);
+
+    if (ncq_errors || memcmp(wr_buf, rd_buf, SATA_NCQ_TEST_SECTORS * SATA_HDD_SECTOR_SIZE)) {
+        return SATA_FAIL;
+    }
+
+    return SATA_PASS;
+}
+
 test_return_t sata_test(void)
 {
     sata_return_t ret;
@@ -108,6 +212,34 @@ test_return_t sata_test(void)
             }
             i++;
         }
+
+        {
+            static u8 sg_wr_buf[SATA_SG_TEST_SECTORS * SATA_HDD_SECTOR_SIZE];
+            static u8 sg_rd_buf[SATA_SG_TEST_SECTORS * SATA_HDD_SECTOR_SIZE];
+
+            fill_buffer((u32) sg_wr_buf, sizeof(sg_wr_buf));
+            memset(sg_rd_buf, 0x00, sizeof(sg_rd_buf));
+
+            ret = sata_sg_test(sg_wr_buf, sg_rd_buf);
+            printf("SATA scatter-gather test,result is %d\n", ret);
+            if (ret == SATA_FAIL) {
+                goto error_handler;
+            }
+        }
+
+        if (sata_ncq_init(PORT0) == SATA_PASS) {
+            static u8 ncq_wr_buf[SATA_NCQ_TEST_SECTORS * SATA_HDD_SECTOR_SIZE];
+            static u8 ncq_rd_buf[SATA_NCQ_TEST_SECTORS * SATA_HDD_SECTOR_SIZE];
+
+            fill_buffer((u32) ncq_wr_buf, sizeof(ncq_wr_buf));
+            memset(ncq_rd_buf, 0x00, sizeof(ncq_rd_buf));
+
+            ret = sata_ncq_test(ncq_wr_buf, ncq_rd_buf);
+            printf("SATA queued command test,result is %d\n", ret);
+            if (ret == SATA_FAIL) {
+                goto error_handler;
+            }
+        }
     }
 
     sata_clock_disable();
@@ -116,6 +116,7 @@ int32_t sdma_channel_start(uint32_t);
 int32_t sdma_channel_stop(uint32_t);
 int32_t sdma_channel_request(sdma_chan_desc_p, sdma_bd_p);
 int32_t sdma_channel_release(uint32_t);
+int32_t sdma_channel_set_bd(uint32_t, sdma_bd_p);
 uint32_t sdma_channel_status(uint32_t, uint32_t *);
 int32_t sdma_lookup_script(script_name_e, uint32_t *);
 void sdma_setup_interrupt(void);
@@ -38,12 +38,19 @@
 #include "sdk.h"
 #include "sdma_priv.h"
 #include "core/interrupt.h"
+#include "core/cortex_a9.h"
+#include "core/dma_alloc.h"
+#include "utility/atomics.h"
+#include "utility/work_queue.h"
 #include "registers/regssdmaarm.h"
 
 extern sdma_script_info_t script_info;
 
 static sdma_env_p sdma_envp;
 
+/* Environment allocated by the driver when the user does not provide one */
+static sdma_env_p sdma_coherent_envp = NULL;
+
 static int32_t sdma_initialized = FALSE;
 
 /*---------------------------------------- static functions --------------------------------------------*/
@@ -75,6 +82,9 @@ static int32_t sdma_load_init_script(uint32_t sdma_dst, uint32_t ram_src, uint32
     sdma_envp->chan0BD.buf_addr = (uint32_t)ram_src;
     sdma_envp->chan0BD.ext_buf_addr = sdma_dst;
 
+    /* The script code is read from cacheable memory */
+    dma_sync_for_device((const void *)ram_src, count, kDmaToDevice);
+
     /* Set current BD pointer therefore could be reused */
     sdma_envp->sdma_ccb[0].currentBDptr = (uint32_t)&sdma_envp->chan0BD;
 
@@ -162,9 +172,19 @@ static void sdma_channel_default_isr(uint32_t channel)
 
 static sdma_channel_isr sdma_channel_isr_list[SDMA_NUM_CHANNELS] = { NULL };
 
-static void sdma_interrupt_handler(void)
+/* Channels that interrupted and whose isr has not run yet */
+static volatile uint32_t sdma_pending_channels;
+
+/* Runs the channel isrs outside of the interrupt handler */
+static work_item_t sdma_channel_work;
+
+static void sdma_run_channel_isrs(void *arg)
 {
-    uint32_t int_flag = HW_SDMAARM_INTR_RD();
+    uint32_t int_flag;
+
+    do {
+        int_flag = sdma_pending_channels;
+    } while (!atomic_compare_and_swap(&sdma_pending_channels, int_flag, 0));
 
     uint32_t i;
     for (i = 0; i < 32; i++) {
@@ -172,12 +192,27 @@ static void sdma_interrupt_handler(void)
             if (NULL != sdma_channel_isr_list[i]) {
                 sdma_channel_isr_list[i] (i);
             }
-
-            HW_SDMAARM_INTR_SET(0x01 << i);
         }
     }
 }
 
+static void sdma_interrupt_handler(void)
+{
+    uint32_t int_flag = HW_SDMAARM_INTR_RD();
+    uint32_t pending;
+
+    /* Acknowledge the channels right away, their isrs run as deferred work */
+    HW_SDMAARM_INTR_WR(int_flag);
+
+    do {
+        pending = sdma_pending_channels;
+    } while (!atomic_compare_and_swap(&sdma_pending_channels, pending, pending | int_flag));
+
+    if (!work_queue(&sdma_channel_work)) {
+        sdma_run_channel_isrs(NULL);
+    }
+}
+
 /*---------------------------------------- global functions --------------------------------------------*/
 
 /*! 
@@ -186,11 +221,12 @@ static void sdma_interrupt_handler(void)
  *    2. Setup configurations like AP DMA/SDMA clock ratio, CCB base address etc
  *    3. Use channel 0 script to load the RAM scripts into SDMA RAM
  *
- * @param    env_buf un-cacheable and un-bufferable buffer allocated by user
+ * @param    env_buf un-cacheable and un-bufferable buffer allocated by user, or NULL to
+ *           have the driver allocate it from the DMA coherent pool
  * @param    base_addr base address of SDMA registers in AP
  *
  * @return   0 on success, -1 when fail to download RAM scripts to SDMA RAM,
- *           -2 when environment pointer is NULL
+ *           -2 when the environment could not be allocated
  */
 int32_t sdma_init(uint32_t *env_buf, uint32_t base_addr)
 {
@@ -201,6 +237,14 @@ int32_t sdma_init(uint32_t *env_buf, uint32_t base_addr)
         return SDMA_RETV_SUCCESS;
     }
 
+    if (envp == NULL) {
+        if (sdma_coherent_envp == NULL) {
+            sdma_coherent_envp = (sdma_env_p) dma_alloc_coherent(sizeof(sdma_env_t), 0);
+        }
+
+        envp = sdma_coherent_envp;
+    }
+
     if (envp == NULL) {
         return SDMA_RETV_NULLP;
     }
@@ -289,6 +333,8 @@ int32_t sdma_channel_start(uint32_t channel)
     }
 
     if ((HW_SDMAARM_HSTART_RD() & (1 << channel)) == 0) {
+        /* Make the buffer descriptors visible to the SDMA before it fetches them */
+        _ARM_DSB();
         HW_SDMAARM_HSTART_SET(1 << channel);
     }
 
@@ -423,6 +469,45 @@ int32_t sdma_channel_request(sdma_chan_desc_p cdp, sdma_bd_p bdp)
     return channel;
 }
 
+/*!
+ * Replace the buffer descriptor table of an opened channel. The next start of the channel
+ * processes the new table from its first descriptor. The channel must not be running, i.e.
+ * its previous table must be done.
+ *
+ * @param    channel the channel number
+ * @param    bdp the un-cacheable and un-bufferable buffer descriptor table
+ *
+ * @return   0 on success, -1 when channel number not in range(0-31) or channel is free,
+ *           -2 when bdp is NULL, -6 when there are too many buffer descriptors
+ */
+int32_t sdma_channel_set_bd(uint32_t channel, sdma_bd_p bdp)
+{
+    uint32_t bd_num;
+
+    if (channel >= SDMA_NUM_CHANNELS) {
+        return SDMA_RETV_FAIL;
+    }
+
+    if (bdp == NULL) {
+        return SDMA_RETV_NULLP;
+    }
+
+    if (HW_SDMAARM_SDMA_CHNPRIn_RD(channel) == SDMA_CHANNEL_PRIORITY_FREE) {
+        return SDMA_RETV_FAIL;
+    }
+
+    if (FALSE == validate_buffer_descriptor(bdp, &bd_num)) {
+        return SDMA_RETV_BD_VALIDATE;
+    }
+
+    sdma_envp->sdma_bd_num[channel] = bd_num;
+    sdma_envp->sdma_ccb[channel].baseBDptr = (uint32_t)bdp;
+    sdma_envp->sdma_ccb[channel].currentBDptr = (uint32_t)bdp;
+    sdma_envp->sdma_bdp[channel] = bdp;
+
+    return SDMA_RETV_SUCCESS;
+}
+
 /*!
  * Close the channel selected. In this function will:
  *    1. Stop and free the channel
@@ -545,10 +630,15 @@ int32_t sdma_lookup_script(script_name_e script, uint32_t *addr)
  * Setup sdma interrupt. This function attach sdma_interrupt_handler to system and 
  * set the isr for every single channel to default one. 
  *
+ * The handler only acknowledges the interrupt. The channel isrs run afterwards as
+ * deferred work with interrupts enabled, see utility/work_queue.h, or directly from the
+ * handler if the work queue of the core is not enabled.
+ *
  * @return   none
  */
 void sdma_setup_interrupt(void)
 {
+    work_item_init(&sdma_channel_work, sdma_run_channel_isrs, NULL);
     register_interrupt_routine(IMX_INT_SDMA, sdma_interrupt_handler);
 
     uint32_t i;
@@ -561,7 +651,7 @@ void sdma_setup_interrupt(void)
 
 /*! 
  * This function attach isr for the channel to SDMA lib. The isr will be called  
- * in sdma_interrupt_handler.
+ * after sdma_interrupt_handler, as deferred work.
  * @param    channel channel number to be attached.	
  * @param    isr the interrupt service routine for the channel
  * @return   0 on success,
@@ -41,14 +41,13 @@
 #define MEM2MEM_TEST_BUF_SZ 		1024*8
 
 #if DDR_2_DDR
-/* Uncacheable & unbufferable area startes */
+/* Data buffers, synced with the SDMA around each transfer */
 static uint32_t src_buf[2][MEM2MEM_TEST_BUF_SZ];
 static uint32_t dst_buf[2][MEM2MEM_TEST_BUF_SZ];
 #endif
 
-static sdma_bd_t bd[2];
-static char env_buffer[SDMA_ENV_BUF_SIZE];
-/* Uncacheable & unbufferable area endes */
+/* Buffer descriptors, shared with the SDMA */
+static sdma_bd_p bd;
 
 int mem_2_mem_test(void)
 {
@@ -70,16 +69,11 @@ int mem_2_mem_test(void)
     dst_buf_p[1] = (uint32_t *) (IRAM_BASE_ADDR + MEM2MEM_TEST_BUF_SZ * 4 * 3);
 #endif
 
-    MEM_VIRTUAL_2_PHYSICAL(src_buf_p[0], sizeof(MEM2MEM_TEST_BUF_SZ * 4),
-                           MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(src_buf_p[1], sizeof(MEM2MEM_TEST_BUF_SZ * 4),
-                           MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(dst_buf_p[0], sizeof(MEM2MEM_TEST_BUF_SZ * 4),
-                           MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(dst_buf_p[1], sizeof(MEM2MEM_TEST_BUF_SZ * 4),
-                           MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(env_buf, sizeof(env_buffer), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(bd, sizeof(bd), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
+    bd = sdma_test_get_bd();
+    if (bd == NULL) {
+        printf("Buffer descriptor allocation failed.\n");
+        return FALSE;
+    }
 
     /* Initialize buffer for testing */
     memset(src_buf_p[0], 0x5A, MEM2MEM_TEST_BUF_SZ * 4);
@@ -88,9 +82,14 @@ int mem_2_mem_test(void)
     memset(dst_buf_p[0], 0x00, MEM2MEM_TEST_BUF_SZ * 4);
     memset(dst_buf_p[1], 0x00, MEM2MEM_TEST_BUF_SZ * 4);
 
+    for (idx = 0; idx < 2; idx++) {
+        dma_sync_for_device(src_buf_p[idx], MEM2MEM_TEST_BUF_SZ * 4, kDmaToDevice);
+        dma_sync_for_device(dst_buf_p[idx], MEM2MEM_TEST_BUF_SZ * 4, kDmaFromDevice);
+    }
+
     /* Initialize SDMA */
     printf("Initialize SDMA environment.\n");
-    if (SDMA_RETV_SUCCESS != sdma_init((uint32_t *) env_buffer, SDMA_IPS_HOST_BASE_ADDR)) {
+    if (SDMA_RETV_SUCCESS != sdma_init(NULL, SDMA_IPS_HOST_BASE_ADDR)) {
         printf("SDMA initialization failed.\n");
         return FALSE;
     }
@@ -148,6 +147,10 @@ int mem_2_mem_test(void)
     sdma_channel_release(channel);
     sdma_deinit();
 
+    for (idx = 0; idx < 2; idx++) {
+        dma_sync_for_cpu(dst_buf_p[idx], MEM2MEM_TEST_BUF_SZ * 4, kDmaFromDevice);
+    }
+
     /* Check data transfered */
     printf("Verify data transfered.\n");
     for (idx = 0; idx < MEM2MEM_TEST_BUF_SZ; idx++) {
@@ -41,6 +41,23 @@ static sdma_test_t sdma_tests[] = {
     {"UART5 loopback with interrupt supported", uart_app_interrupt_test},
 };
 
+/*!
+ * Get the two buffer descriptors used by the tests. They are read and
+ * updated by the SDMA, so they are allocated once from the coherent pool.
+ *
+ * @return   pointer to the descriptors, or NULL if the pool is exhausted
+ */
+sdma_bd_p sdma_test_get_bd(void)
+{
+    static sdma_bd_p bd = NULL;
+
+    if (bd == NULL) {
+        bd = (sdma_bd_p) dma_alloc_coherent(2 * sizeof(sdma_bd_t), 0);
+    }
+
+    return bd;
+}
+
 int sdma_test(void)
 {
     int retv = FALSE, idx;
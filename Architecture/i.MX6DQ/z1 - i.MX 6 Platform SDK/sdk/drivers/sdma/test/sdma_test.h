@@ -32,18 +32,15 @@
 #define __SDMA_TEST__
 
 #include "sdk.h"
-
-#define MEM_PRO_UNCACHEABLE
-#define MEM_PRO_UNBUFFERABEL
-
-/*This macro do nothing because the mmu and cache have been disabled*/
-#define MEM_VIRTUAL_2_PHYSICAL(addr,size,pro)
+#include "sdma/sdma.h"
+#include "core/dma_alloc.h"
 
 typedef struct {
     const char *name;
     int (*test) (void);
 } sdma_test_t;
 
+extern sdma_bd_p sdma_test_get_bd(void);
 extern int mem_2_mem_test(void);
 extern int ecspi_shp_test(void);
 extern int ecspi_app_test(void);
@@ -39,13 +39,12 @@
 
 #define SPI_LOOPBACK_TEST_BUF_SZ 	1024
 
-/* Uncacheable & unbufferable area start */
+/* Data buffers, synced with the SDMA around each transfer */
 static uint32_t src_buf[SPI_LOOPBACK_TEST_BUF_SZ];
 static uint32_t dst_buf[SPI_LOOPBACK_TEST_BUF_SZ];
 
-static char env_buffer[SDMA_ENV_BUF_SIZE];
-static sdma_bd_t bd[2];
-/* Uncacheable & unbufferable area end */
+/* Buffer descriptors, shared with the SDMA */
+static sdma_bd_p bd;
 
 static void ecspi_access_config(void)
 {
@@ -86,21 +85,24 @@ int ecspi_app_test(void)
 
     cspi2_reg_base = (ecspi_reg_p) ECSPI2_BASE_ADDR;
 
-    MEM_VIRTUAL_2_PHYSICAL(src_buf, sizeof(src_buf), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(dst_buf, sizeof(dst_buf), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(env_buf, sizeof(env_buffer), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(bd, sizeof(bd), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
+    bd = sdma_test_get_bd();
+    if (bd == NULL) {
+        printf("Buffer descriptor allocation failed.\n");
+        return FALSE;
+    }
 
     /* Initialize buffer for testing */
     memset(src_buf, 0x5A, sizeof(src_buf));
     memset(dst_buf, 0x00, sizeof(dst_buf));
+    dma_sync_for_device(src_buf, sizeof(src_buf), kDmaToDevice);
+    dma_sync_for_device(dst_buf, sizeof(dst_buf), kDmaFromDevice);
 
     /* Enable SDMA access to eCSPI2 */
     ecspi_access_config();
 
     /* Initialize SDMA */
     printf("Initialize SDMA environment.\n");
-    if (SDMA_RETV_SUCCESS != sdma_init((uint32_t *)env_buffer, SDMA_IPS_HOST_BASE_ADDR)) {
+    if (SDMA_RETV_SUCCESS != sdma_init(NULL, SDMA_IPS_HOST_BASE_ADDR)) {
         printf("SDMA initialization failed.\n");
         return FALSE;
     }
@@ -193,6 +195,7 @@ int ecspi_app_test(void)
     sdma_channel_release(channel[1]);
 
     sdma_deinit();
+    dma_sync_for_cpu(dst_buf, sizeof(dst_buf), kDmaFromDevice);
 
     printf("Transfer completed. Verify data...\n");
 
@@ -216,18 +219,21 @@ int ecspi_shp_test(void)
 
     cspi1_reg_base = (ecspi_reg_p) (ECSPI1_BASE_ADDR);
 
-    MEM_VIRTUAL_2_PHYSICAL(src_buf, sizeof(src_buf), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(dst_buf, sizeof(dst_buf), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(env_buf, sizeof(env_buffer), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(bd, sizeof(bd), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
+    bd = sdma_test_get_bd();
+    if (bd == NULL) {
+        printf("Buffer descriptor allocation failed.\n");
+        return FALSE;
+    }
 
     /* Initialize buffers for testing */
     memset(src_buf, 0x5A, sizeof(src_buf));
     memset(dst_buf, 0x00, sizeof(dst_buf));
+    dma_sync_for_device(src_buf, sizeof(src_buf), kDmaToDevice);
+    dma_sync_for_device(dst_buf, sizeof(dst_buf), kDmaFromDevice);
 
     /* Initialize SDMA */
     printf("Initialize SDMA environment.\n");
-    if (SDMA_RETV_SUCCESS != sdma_init((uint32_t *)env_buffer, SDMA_IPS_HOST_BASE_ADDR)) {
+    if (SDMA_RETV_SUCCESS != sdma_init(NULL, SDMA_IPS_HOST_BASE_ADDR)) {
         printf("SDMA initialization failed.\n");
         return FALSE;
     }
@@ -319,6 +325,7 @@ int ecspi_shp_test(void)
     sdma_channel_release(channel[1]);
 
     sdma_deinit();
+    dma_sync_for_cpu(dst_buf, sizeof(dst_buf), kDmaFromDevice);
 
     printf("Transfer completed. Verify data...\n");
 
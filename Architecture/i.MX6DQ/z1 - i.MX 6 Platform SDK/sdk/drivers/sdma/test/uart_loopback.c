@@ -43,13 +43,12 @@
 #define TX_FIFO_WATERMARK_LEVEL 4
 #define RX_FIFO_WATERMARK_LEVEL 16
 
-/* Uncacheable & unbufferable area start */
+/* Data buffers, synced with the SDMA around each transfer */
 static uint32_t tx_buf[UART_LOOPBACK_TEST_BUF_SZ];
 static uint32_t rx_buf[UART_LOOPBACK_TEST_BUF_SZ];
 
-static char env_buffer[SDMA_ENV_BUF_SIZE];
-static sdma_bd_t bd[2];
-/* Uncacheable & unbufferable area end */
+/* Buffer descriptors, shared with the SDMA */
+static sdma_bd_p bd;
 
 static void uart_access_config(void)
 {
@@ -123,18 +122,21 @@ int uart_app_test(void)
 
     printf("UART5 loopback test starts.\n");
 
-    MEM_VIRTUAL_2_PHYSICAL(tx_buf, sizeof(tx_buf), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(rx_buf, sizeof(tx_buf), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(env_buf, sizeof(env_buffer), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(bd, sizeof(bd), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
+    bd = sdma_test_get_bd();
+    if (bd == NULL) {
+        printf("Buffer descriptor allocation failed.\n");
+        return FALSE;
+    }
 
     /* Initialize buffers for testing */
     memset(tx_buf, 0x5A, sizeof(tx_buf));
     memset(rx_buf, 0x00, sizeof(rx_buf));
+    dma_sync_for_device(tx_buf, sizeof(tx_buf), kDmaToDevice);
+    dma_sync_for_device(rx_buf, sizeof(rx_buf), kDmaFromDevice);
 
     /* Initialize SDMA */
     printf("Initialize SDMA environment.\n");
-    if (SDMA_RETV_SUCCESS != sdma_init((uint32_t *)env_buffer, SDMA_IPS_HOST_BASE_ADDR)) {
+    if (SDMA_RETV_SUCCESS != sdma_init(NULL, SDMA_IPS_HOST_BASE_ADDR)) {
         printf("SDMA initialization failed.\n");
         return FALSE;
     }
@@ -226,6 +228,7 @@ int uart_app_test(void)
     sdma_channel_release(channel[0]);
     sdma_channel_release(channel[1]);
     sdma_deinit();
+    dma_sync_for_cpu(rx_buf, sizeof(rx_buf), kDmaFromDevice);
 
     /* Check data transfered */
     printf("Verify data transfered.\n");
@@ -249,18 +252,21 @@ int uart_shp_test(void)
 
     printf("UART%d loopback test starts.\n", uart_shp_test_instance);
 
-    MEM_VIRTUAL_2_PHYSICAL(tx_buf, sizeof(tx_buf), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(rx_buf, sizeof(tx_buf), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(env_buf, sizeof(env_buffer), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(bd, sizeof(bd), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
+    bd = sdma_test_get_bd();
+    if (bd == NULL) {
+        printf("Buffer descriptor allocation failed.\n");
+        return FALSE;
+    }
 
     /* Initialize buffer for testing */
     memset(tx_buf, 0xA5, sizeof(tx_buf));
     memset(rx_buf, 0x00, sizeof(rx_buf));
+    dma_sync_for_device(tx_buf, sizeof(tx_buf), kDmaToDevice);
+    dma_sync_for_device(rx_buf, sizeof(rx_buf), kDmaFromDevice);
 
     /* Initialize SDMA */
     printf("Initialize SDMA environment.\n");
-    if (SDMA_RETV_SUCCESS != sdma_init((uint32_t *)env_buffer, SDMA_IPS_HOST_BASE_ADDR)) {
+    if (SDMA_RETV_SUCCESS != sdma_init(NULL, SDMA_IPS_HOST_BASE_ADDR)) {
         printf("SDMA initialization failed.\n");
         return FALSE;
     }
@@ -368,6 +374,7 @@ int uart_shp_test(void)
     sdma_channel_release(channel[1]);
 
     sdma_deinit();
+    dma_sync_for_cpu(rx_buf, sizeof(rx_buf), kDmaFromDevice);
 
     /* Check data transfered */
     printf("Verify data transfered.\n");
@@ -403,18 +410,21 @@ int uart_app_interrupt_test(void)
 
     printf("UART5 loopback test with interrupt supported.\n");
 
-    MEM_VIRTUAL_2_PHYSICAL(tx_buf, sizeof(tx_buf), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(rx_buf, sizeof(tx_buf), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(env_buf, sizeof(env_buffer), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
-    MEM_VIRTUAL_2_PHYSICAL(bd, sizeof(bd), MEM_PRO_UNCACHEABLE | MEM_PRO_UNBUFFERABEL);
+    bd = sdma_test_get_bd();
+    if (bd == NULL) {
+        printf("Buffer descriptor allocation failed.\n");
+        return FALSE;
+    }
 
     /* Initialize buffers for testing */
     memset(tx_buf, 0x5A, sizeof(tx_buf));
     memset(rx_buf, 0x00, sizeof(rx_buf));
+    dma_sync_for_device(tx_buf, sizeof(tx_buf), kDmaToDevice);
+    dma_sync_for_device(rx_buf, sizeof(rx_buf), kDmaFromDevice);
 
     /* Initialize SDMA */
     printf("Initialize SDMA environment.\n");
-    if (SDMA_RETV_SUCCESS != sdma_init((uint32_t *)env_buffer, SDMA_IPS_HOST_BASE_ADDR)) {
+    if (SDMA_RETV_SUCCESS != sdma_init(NULL, SDMA_IPS_HOST_BASE_ADDR)) {
         printf("SDMA initialization failed.\n");
         return FALSE;
     }
@@ -500,6 +510,7 @@ int uart_app_interrupt_test(void)
     sdma_channel_release(channel[0]);
     sdma_channel_release(channel[1]);
     sdma_deinit();
+    dma_sync_for_cpu(rx_buf, sizeof(rx_buf), kDmaFromDevice);
 
     /* Check data transfered */
     printf("Verify data transfered.\n");
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//! @addtogroup diag_timer
+//! @{
+
+/*!
+ * @file hrtimer.h
+ * @brief One-shot timer service and sleeping waits.
+ *
+ * Each core keeps its own queue of pending timers, a binary min-heap ordered by deadline. The
+ * comparator of the Cortex-A9 global timer, which is banked per core, is only ever programmed
+ * for the earliest deadline of the queue and switched off when the queue is empty, so there is
+ * no periodic tick. Callbacks run from the global timer interrupt of the core that started the
+ * timer.
+ *
+ * sleep_until() and wait_event_timeout() build on the service to let drivers wait for a point
+ * in time or a condition in WFI instead of spinning. They fall back to polling when the calling
+ * core cannot sleep, that is before hrtimer_init_cpu() has been called on it or when running
+ * in an interrupt handler.
+ */
+
+#if !defined(__HRTIMER_H__)
+#define __HRTIMER_H__
+
+#include "sdk.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Maximum number of timers that can be pending on one core at the same time.
+#if !defined(HRTIMER_MAX_PENDING)
+#define HRTIMER_MAX_PENDING (32)
+#endif
+
+//! @brief Maximum number of cores using the timer service.
+#define HRTIMER_MAX_CPUS (4)
+
+//! @brief Private peripheral interrupt of the global timer.
+#define HRTIMER_IRQ (27)
+
+//! @brief Delays shorter than this many microseconds are busy-waited by hal_delay_us().
+#define HRTIMER_MIN_SLEEP_US (20)
+
+typedef struct _hrtimer hrtimer_t;
+
+//! @brief Function called when a timer expires.
+//!
+//! Called in interrupt context on the core that started the timer. The timer is no longer
+//! pending at that point, so it may be restarted from the callback.
+typedef void (*hrtimer_callback_t)(hrtimer_t * timer, void * arg);
+
+//! @brief Condition polled by wait_event_timeout().
+typedef bool (*hrtimer_condition_t)(void * arg);
+
+//! @brief A one-shot timer.
+//!
+//! The fields are private to the timer service. Use hrtimer_setup() to initialize a timer.
+struct _hrtimer
+{
+    uint64_t deadline;              //!< Expiry time in microseconds.
+    hrtimer_callback_t callback;    //!< Function to call on expiry, may be NULL.
+    void * arg;                     //!< Argument passed to the callback.
+    volatile int32_t cpu;           //!< Core whose queue holds the timer, or -1 if not pending.
+    uint32_t index;                 //!< Position in the heap of that queue.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @brief Enable the timer service on the calling core.
+//!
+//! system_time_init() calls this for the boot core. Secondary cores must call it themselves
+//! after their GIC CPU interface has been initialized and before they use timers.
+void hrtimer_init_cpu(void);
+
+//! @brief Initialize a timer.
+//!
+//! @param timer The timer to initialize. It must not be pending.
+//! @param callback Function called when the timer expires. Pass NULL for a timer that only
+//!     wakes the core up.
+//! @param arg Argument passed to @a callback.
+void hrtimer_setup(hrtimer_t * timer, hrtimer_callback_t callback, void * arg);
+
+//! @brief Start a timer on the calling core.
+//!
+//! A timer that is already pending is cancelled first. A deadline in the past makes the
+//! timer expire as soon as possible.
+//!
+//! @param timer The timer to start.
+//! @param deadline Absolute expiry time, in the time base of time_get_microseconds().
+//! @retval true The timer is pending.
+//! @retval false The service is not initialized on this core or its queue is full.
+bool hrtimer_start(hrtimer_t * timer, uint64_t deadline);
+
+//! @brief Stop a pending timer.
+//!
+//! May be called from any core. If the callback is already running on another core, this
+//! does not wait for it to return.
+//!
+//! @retval true The timer was pending and will not expire.
+//! @retval false The timer was not pending.
+bool hrtimer_cancel(hrtimer_t * timer);
+
+//! @brief Returns whether a timer is pending.
+static inline bool hrtimer_is_pending(const hrtimer_t * timer)
+{
+    return timer->cpu >= 0;
+}
+
+//! @brief Returns whether the calling core can wait in WFI.
+//!
+//! That is the case once hrtimer_init_cpu() has been called on the core, unless the core is
+//! running an interrupt handler, where the global timer interrupt would not be taken.
+bool hrtimer_can_sleep(void);
+
+//! @brief Wait until a point in time.
+//!
+//! The core sleeps in WFI between interrupts. Other interrupts are still serviced while
+//! sleeping if they were enabled by the caller.
+//!
+//! @param deadline Absolute wake-up time, in the time base of time_get_microseconds().
+void sleep_until(uint64_t deadline);
+
+//! @brief Wait until a condition is true or a timeout expires.
+//!
+//! The condition is checked with IRQs masked before every sleep, so an interrupt handler that
+//! makes it true cannot be missed. If the condition only depends on a status register and no
+//! interrupt signals the change, pass a non-zero @a pollInterval to have the core wake up
+//! periodically to check it again.
+//!
+//! @param condition Function returning true once the event occurred.
+//! @param arg Argument passed to @a condition.
+//! @param timeout Maximum time to wait, in microseconds.
+//! @param pollInterval Time between checks of the condition in microseconds, or 0 to only check
+//!     it after interrupts.
+//! @retval true The condition became true.
+//! @retval false The timeout expired first.
+bool wait_event_timeout(hrtimer_condition_t condition, void * arg, uint32_t timeout, uint32_t pollInterval);
+
+#if defined(__cplusplus)
+}
+#endif
+
+//! @}
+
+#endif // __HRTIMER_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
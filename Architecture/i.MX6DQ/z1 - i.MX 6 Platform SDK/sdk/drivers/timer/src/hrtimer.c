@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file hrtimer.c
+ * @brief One-shot timer service on the Cortex-A9 global timer comparator.
+ *
+ * @ingroup diag_timer
+ */
+
+#include "sdk.h"
+#include "core/cortex_a9.h"
+#include "core/interrupt.h"
+#include "timer/hrtimer.h"
+#include "timer/timer.h"
+#include "utility/spinlock.h"
+#include "registers/regsarmglobaltimer.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief GIC priority of the global timer interrupt.
+#define HRTIMER_IRQ_PRIORITY (kIrqPriority_High)
+
+//! @brief Timer queue of one core.
+typedef struct _hrtimer_queue
+{
+    ticket_lock_t lock;                         //!< Protects the heap against other cores.
+    hrtimer_t * heap[HRTIMER_MAX_PENDING];      //!< Min-heap of pending timers by deadline.
+    uint32_t count;                             //!< Number of pending timers.
+    bool isInitialized;                         //!< Set by hrtimer_init_cpu().
+} __attribute__ ((aligned (32))) hrtimer_queue_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Externs
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Global timer ticks per microsecond, set up by system_time_init().
+extern uint32_t g_microsecondTimerMultiple;
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static hrtimer_queue_t s_queues[HRTIMER_MAX_CPUS];
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Read the 64-bit global timer counter.
+static uint64_t hrtimer_read_counter(void)
+{
+    uint32_t upper = HW_ARMGLOBALTIMER_COUNTERn_RD(1);
+    uint32_t lower;
+    uint32_t newUpper;
+
+    // Read again if the upper word changed while reading the lower one.
+    while (true)
+    {
+        lower = HW_ARMGLOBALTIMER_COUNTERn_RD(0);
+        newUpper = HW_ARMGLOBALTIMER_COUNTERn_RD(1);
+        if (newUpper == upper)
+        {
+            return ((uint64_t)upper << 32) | lower;
+        }
+        upper = newUpper;
+    }
+}
+
+//! @brief Program the comparator of the calling core to fire at @a deadline.
+static void hrtimer_program(uint64_t deadline)
+{
+    uint64_t compare = deadline * g_microsecondTimerMultiple;
+
+    while (true)
+    {
+        // The comparator must be disabled while its two halves are written.
+        HW_ARMGLOBALTIMER_CONTROL_CLR(BM_ARMGLOBALTIMER_CONTROL_COMP_ENABLE);
+        HW_ARMGLOBALTIMER_COMPARATORn_WR(0, (uint32_t)compare);
+        HW_ARMGLOBALTIMER_COMPARATORn_WR(1, (uint32_t)(compare >> 32));
+        HW_ARMGLOBALTIMER_CONTROL_SET(BM_ARMGLOBALTIMER_CONTROL_COMP_ENABLE | BM_ARMGLOBALTIMER_CONTROL_IRQ_ENABLE);
+
+        // If the counter went past the compare value before the comparator was enabled, the
+        // event may never be raised. Move the compare value just ahead of the counter then.
+        uint64_t counter = hrtimer_read_counter();
+        if (counter < compare || (HW_ARMGLOBALTIMER_IRQSTATUS_RD() & BM_ARMGLOBALTIMER_IRQSTATUS_EVENT_FLAG))
+        {
+            return;
+        }
+        compare = counter + g_microsecondTimerMultiple;
+    }
+}
+
+//! @brief Switch off the comparator interrupt of the calling core.
+static void hrtimer_stop_comparator(void)
+{
+    HW_ARMGLOBALTIMER_CONTROL_CLR(BM_ARMGLOBALTIMER_CONTROL_COMP_ENABLE | BM_ARMGLOBALTIMER_CONTROL_IRQ_ENABLE);
+    HW_ARMGLOBALTIMER_IRQSTATUS_WR(BM_ARMGLOBALTIMER_IRQSTATUS_EVENT_FLAG);
+}
+
+//! @brief Store @a timer at heap position @a index.
+static inline void hrtimer_heap_set(hrtimer_queue_t * queue, uint32_t index, hrtimer_t * timer)
+{
+    queue->heap[index] = timer;
+    timer->index = index;
+}
+
+//! @brief Move the timer at @a index towards the root until the heap is ordered.
+static void hrtimer_sift_up(hrtimer_queue_t * queue, uint32_t index)
+{
+    hrtimer_t * timer = queue->heap[index];
+
+    while (index > 0)
+    {
+        uint32_t parent = (index - 1) / 2;
+        if (queue->heap[parent]->deadline <= timer->deadline)
+        {
+            break;
+        }
+        hrtimer_heap_set(queue, index, queue->heap[parent]);
+        index = parent;
+    }
+    hrtimer_heap_set(queue, index, timer);
+}
+
+//! @brief Move the timer at @a index towards the leaves until the heap is ordered.
+static void hrtimer_sift_down(hrtimer_queue_t * queue, uint32_t index)
+{
+    hrtimer_t * timer = queue->heap[index];
+
+    while (true)
+    {
+        uint32_t child = index * 2 + 1;
+        if (child >= queue->count)
+        {
+            break;
+        }
+        if (child + 1 < queue->count && queue->heap[child + 1]->deadline < queue->heap[child]->deadline)
+        {
+            ++child;
+        }
+        if (timer->deadline <= queue->heap[child]->deadline)
+        {
+            break;
+        }
+        hrtimer_heap_set(queue, index, queue->heap[child]);
+        index = child;
+    }
+    hrtimer_heap_set(queue, index, timer);
+}
+
+//! @brief Take the timer at @a index out of the heap. The queue lock must be held.
+static void hrtimer_heap_remove(hrtimer_queue_t * queue, uint32_t index)
+{
+    hrtimer_t * timer = queue->heap[index];
+    hrtimer_t * last = queue->heap[--queue->count];
+
+    timer->cpu = -1;
+    if (index == queue->count)
+    {
+        return;
+    }
+
+    // Fill the hole with the last timer, which may have to move in either direction.
+    hrtimer_heap_set(queue, index, last);
+    if (index > 0 && queue->heap[(index - 1) / 2]->deadline > last->deadline)
+    {
+        hrtimer_sift_up(queue, index);
+    }
+    else
+    {
+        hrtimer_sift_down(queue, index);
+    }
+}
+
+//! @brief Program the comparator for the earliest timer of the calling core's queue.
+//!
+//! The queue lock must be held.
+static void hrtimer_update_comparator(hrtimer_queue_t * queue)
+{
+    if (queue->count)
+    {
+        hrtimer_program(queue->heap[0]->deadline);
+    }
+    else
+    {
+        hrtimer_stop_comparator();
+    }
+}
+
+//! @brief Global timer interrupt handler, runs the expired timers of the calling core.
+//!
+//! The handler can be preempted, so IRQs are masked whenever the queue lock is held.
+static void hrtimer_isr(void)
+{
+    hrtimer_queue_t * queue = &s_queues[cpu_get_current()];
+    bool isFirst = true;
+
+    HW_ARMGLOBALTIMER_IRQSTATUS_WR(BM_ARMGLOBALTIMER_IRQSTATUS_EVENT_FLAG);
+
+    arm_set_interrupt_state(false);
+    ticket_lock_lock(&queue->lock);
+    while (queue->count)
+    {
+        hrtimer_t * timer = queue->heap[0];
+        uint64_t now = time_get_microseconds();
+        if (timer->deadline > now)
+        {
+            break;
+        }
+        hrtimer_heap_remove(queue, 0);
+
+        // The earliest deadline is the one the interrupt was raised for.
+        if (isFirst)
+        {
+            irq_record_latency(now - timer->deadline);
+            isFirst = false;
+        }
+
+        // The callback may restart the timer, so it runs without the lock.
+        if (timer->callback)
+        {
+            ticket_lock_unlock(&queue->lock);
+            arm_set_interrupt_state(true);
+            timer->callback(timer, timer->arg);
+            arm_set_interrupt_state(false);
+            ticket_lock_lock(&queue->lock);
+        }
+    }
+    hrtimer_update_comparator(queue);
+    ticket_lock_unlock(&queue->lock);
+    arm_set_interrupt_state(true);
+}
+
+void hrtimer_init_cpu(void)
+{
+    uint32_t cpu = cpu_get_current();
+    hrtimer_queue_t * queue = &s_queues[cpu];
+
+    hrtimer_stop_comparator();
+
+    ticket_lock_init(&queue->lock);
+    queue->count = 0;
+    queue->isInitialized = true;
+
+    // The handler table is shared, while the interrupt is private to each core.
+    register_interrupt_routine(HRTIMER_IRQ, hrtimer_isr);
+    enable_interrupt(HRTIMER_IRQ, cpu, HRTIMER_IRQ_PRIORITY);
+}
+
+void hrtimer_setup(hrtimer_t * timer, hrtimer_callback_t callback, void * arg)
+{
+    timer->deadline = 0;
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->cpu = -1;
+    timer->index = 0;
+}
+
+bool hrtimer_start(hrtimer_t * timer, uint64_t deadline)
+{
+    hrtimer_cancel(timer);
+
+    bool wasEnabled = arm_set_interrupt_state(false);
+    uint32_t cpu = cpu_get_current();
+    hrtimer_queue_t * queue = &s_queues[cpu];
+    bool isStarted = false;
+
+    if (queue->isInitialized)
+    {
+        ticket_lock_lock(&queue->lock);
+        if (queue->count < HRTIMER_MAX_PENDING)
+        {
+            timer->deadline = deadline;
+            timer->cpu = cpu;
+            queue->heap[queue->count] = timer;
+            hrtimer_sift_up(queue, queue->count++);
+
+            // Only a new earliest deadline changes the comparator.
+            if (timer->index == 0)
+            {
+                hrtimer_program(deadline);
+            }
+            isStarted = true;
+        }
+        ticket_lock_unlock(&queue->lock);
+    }
+
+    arm_set_interrupt_state(wasEnabled);
+    return isStarted;
+}
+
+bool hrtimer_cancel(hrtimer_t * timer)
+{
+    bool wasEnabled = arm_set_interrupt_state(false);
+    bool wasPending = false;
+    int32_t cpu;
+
+    // The timer may expire or be restarted on another core while the lock is taken, so check
+    // that it is still in the same queue once the lock is held.
+    while ((cpu = timer->cpu) >= 0)
+    {
+        hrtimer_queue_t * queue = &s_queues[cpu];
+        ticket_lock_lock(&queue->lock);
+        if (timer->cpu == cpu)
+        {
+            bool wasFirst = (timer->index == 0);
+            hrtimer_heap_remove(queue, timer->index);
+
+            // The comparator is banked, so only the owning core can reprogram it. Other cores
+            // leave it to the interrupt, which finds nothing to do and moves on.
+            if (wasFirst && cpu == cpu_get_current())
+            {
+                hrtimer_update_comparator(queue);
+            }
+            wasPending = true;
+        }
+        ticket_lock_unlock(&queue->lock);
+
+        if (wasPending)
+        {
+            break;
+        }
+    }
+
+    arm_set_interrupt_state(wasEnabled);
+    return wasPending;
+}
+
+bool hrtimer_can_sleep(void)
+{
+    return s_queues[cpu_get_current()].isInitialized && irq_get_nesting_level() == 0;
+}
+
+void sleep_until(uint64_t deadline)
+{
+    hrtimer_t wakeTimer;
+
+    hrtimer_setup(&wakeTimer, NULL, NULL);
+    if (!hrtimer_can_sleep() || !hrtimer_start(&wakeTimer, deadline))
+    {
+        while (time_get_microseconds() < deadline)
+        {
+        }
+        return;
+    }
+
+    // With IRQs masked the timer interrupt still ends WFI. Unmasking in between lets the
+    // handlers of the interrupts that woke us up run.
+    while (true)
+    {
+        bool wasEnabled = arm_set_interrupt_state(false);
+        bool isExpired = (time_get_microseconds() >= deadline);
+        if (!isExpired)
+        {
+            _ARM_WFI();
+        }
+        arm_set_interrupt_state(wasEnabled);
+
+        if (isExpired)
+        {
+            break;
+        }
+    }
+
+    hrtimer_cancel(&wakeTimer);
+}
+
+bool wait_event_timeout(hrtimer_condition_t condition, void * arg, uint32_t timeout, uint32_t pollInterval)
+{
+    uint64_t deadline = time_get_microseconds() + timeout;
+    bool canSleep = hrtimer_can_sleep();
+    bool isDone = false;
+    hrtimer_t wakeTimer;
+
+    hrtimer_setup(&wakeTimer, NULL, NULL);
+
+    while (!isDone)
+    {
+        uint64_t now = time_get_microseconds();
+        if (now >= deadline)
+        {
+            // Give the condition a last chance, the core may have slept past the deadline.
+            isDone = condition(arg);
+            break;
+        }
+
+        uint64_t wakeTime = deadline;
+        if (pollInterval && now + pollInterval < wakeTime)
+        {
+            wakeTime = now + pollInterval;
+        }
+
+        // The condition is evaluated with IRQs masked right before WFI, so an interrupt that
+        // makes it true after the check still wakes the core up.
+        bool wasEnabled = arm_set_interrupt_state(false);
+        isDone = condition(arg);
+        if (!isDone && canSleep && hrtimer_start(&wakeTimer, wakeTime))
+        {
+            _ARM_WFI();
+        }
+        arm_set_interrupt_state(wasEnabled);
+    }
+
+    hrtimer_cancel(&wakeTimer);
+    return isDone;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
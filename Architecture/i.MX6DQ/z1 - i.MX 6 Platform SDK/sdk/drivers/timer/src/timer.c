@@ -38,6 +38,7 @@
 #include <assert.h>
 #include "sdk.h"
 #include "timer/epit.h"
+#include "timer/hrtimer.h"
 #include "timer/timer.h"
 #include "registers/regsarmglobaltimer.h"
 #include "core/ccm_pll.h"
@@ -65,6 +66,12 @@ void hal_delay_us(uint32_t usecs)
         return;
     }
 
+    /* longer delays sleep in WFI on the timer service when this core can */
+    if (usecs >= HRTIMER_MIN_SLEEP_US && hrtimer_can_sleep()) {
+        sleep_until(time_get_microseconds() + usecs);
+        return;
+    }
+
     /* enable the counter first */
     epit_counter_enable(instance, usecs, POLLING_MODE);
     
@@ -88,6 +95,9 @@ void system_time_init(void)
     freq = get_main_clock(IPG_CLK);
     epit_init(g_system_timer_port, CLKSRC_IPG_CLK, freq / 1000000,
               SET_AND_FORGET, 1000, WAIT_MODE_EN | STOP_MODE_EN);
+
+    /* one-shot timers on the global timer comparator, for the boot core */
+    hrtimer_init_cpu();
 }
 
 //! Init the ARM global timer to a microsecond-frequency clock.
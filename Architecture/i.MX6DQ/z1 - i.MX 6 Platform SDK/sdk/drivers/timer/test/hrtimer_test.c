@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file hrtimer_test.c
+ * @brief Test of the one-shot timer service and the sleeping waits.
+ */
+
+#include <stdio.h>
+#include "timer/hrtimer.h"
+#include "timer/timer.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Number of timers started at once by the ordering test.
+#define ORDER_TIMER_COUNT (16)
+
+//! @brief Spacing between the deadlines of the ordering test, in microseconds.
+#define ORDER_SPACING_US (500)
+
+//! @brief Latest acceptable expiry after the deadline, in microseconds.
+#define MAX_LATENESS_US (100)
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void hrtimer_test(void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static hrtimer_t s_timers[ORDER_TIMER_COUNT];
+
+//! @brief Order in which the timers of the ordering test expired.
+static volatile uint32_t s_expiredOrder[ORDER_TIMER_COUNT];
+static volatile uint32_t s_expiredCount;
+
+//! @brief Largest difference between expiry and deadline seen by the callback.
+static volatile uint32_t s_maxLateness;
+
+//! @brief Set to true if a callback ran before its deadline.
+static volatile bool s_wasEarly;
+
+//! @brief Flag set by a timer callback for the wait_event_timeout() test.
+static volatile bool s_eventFlag;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+static void record_expiry(hrtimer_t * timer, void * arg)
+{
+    uint64_t now = time_get_microseconds();
+
+    if (now < timer->deadline)
+    {
+        s_wasEarly = true;
+    }
+    else if (now - timer->deadline > s_maxLateness)
+    {
+        s_maxLateness = now - timer->deadline;
+    }
+    s_expiredOrder[s_expiredCount++] = (uint32_t)arg;
+}
+
+static void set_event_flag(hrtimer_t * timer, void * arg)
+{
+    s_eventFlag = true;
+}
+
+static bool is_event_flag_set(void * arg)
+{
+    return s_eventFlag;
+}
+
+//! @brief Start timers in scrambled order, cancel every fourth and check the expiry order.
+static bool test_ordering(void)
+{
+    uint64_t start = time_get_microseconds() + 1000;
+    uint32_t i;
+
+    s_expiredCount = 0;
+    s_maxLateness = 0;
+    s_wasEarly = false;
+
+    for (i = 0; i < ORDER_TIMER_COUNT; ++i)
+    {
+        // Visits all slots once since the multiplier is odd.
+        uint32_t slot = (i * 7) % ORDER_TIMER_COUNT;
+        hrtimer_setup(&s_timers[slot], record_expiry, (void *)slot);
+        if (!hrtimer_start(&s_timers[slot], start + slot * ORDER_SPACING_US))
+        {
+            printf("  failed to start timer %d\n", slot);
+            return false;
+        }
+    }
+
+    uint32_t cancelled = 0;
+    for (i = 0; i < ORDER_TIMER_COUNT; i += 4)
+    {
+        cancelled += hrtimer_cancel(&s_timers[i]);
+    }
+
+    sleep_until(start + ORDER_TIMER_COUNT * ORDER_SPACING_US + MAX_LATENESS_US);
+
+    bool isOk = (cancelled == ORDER_TIMER_COUNT / 4) && (s_expiredCount == ORDER_TIMER_COUNT - cancelled);
+    uint32_t expected = 0;
+    for (i = 0; isOk && i < s_expiredCount; ++i, ++expected)
+    {
+        if ((expected % 4) == 0)
+        {
+            ++expected;
+        }
+        isOk = (s_expiredOrder[i] == expected);
+    }
+
+    printf("  %d timers expired, %d cancelled, max lateness %d us\n", s_expiredCount, cancelled, s_maxLateness);
+    if (s_wasEarly)
+    {
+        printf("  a timer expired before its deadline\n");
+    }
+    return isOk && !s_wasEarly && s_maxLateness <= MAX_LATENESS_US;
+}
+
+//! @brief Check that sleeping delays are neither short nor much too long.
+static bool test_sleep(void)
+{
+    bool isOk = true;
+    uint32_t delay;
+
+    for (delay = 50; delay <= 50000; delay *= 10)
+    {
+        uint64_t start = time_get_microseconds();
+        hal_delay_us(delay);
+        uint32_t elapsed = time_get_microseconds() - start;
+
+        printf("  hal_delay_us(%d) took %d us\n", delay, elapsed);
+        isOk = isOk && elapsed >= delay && elapsed <= delay + MAX_LATENESS_US;
+    }
+    return isOk;
+}
+
+//! @brief Wait for an event raised by a timer, then for one that never comes.
+static bool test_wait_event(void)
+{
+    hrtimer_t eventTimer;
+    bool isOk = true;
+
+    s_eventFlag = false;
+    hrtimer_setup(&eventTimer, set_event_flag, NULL);
+    uint64_t start = time_get_microseconds();
+    hrtimer_start(&eventTimer, start + 5000);
+    bool isSet = wait_event_timeout(is_event_flag_set, NULL, 50000, 0);
+    uint32_t elapsed = time_get_microseconds() - start;
+
+    printf("  event after %d us, %s\n", elapsed, isSet ? "signaled" : "timed out");
+    isOk = isSet && elapsed >= 5000 && elapsed <= 5000 + MAX_LATENESS_US;
+
+    s_eventFlag = false;
+    start = time_get_microseconds();
+    isSet = wait_event_timeout(is_event_flag_set, NULL, 10000, 1000);
+    elapsed = time_get_microseconds() - start;
+
+    printf("  no event after %d us, %s\n", elapsed, isSet ? "signaled" : "timed out");
+    return isOk && !isSet && elapsed >= 10000 && elapsed <= 10000 + MAX_LATENESS_US;
+}
+
+void hrtimer_test(void)
+{
+    bool isOk = true;
+
+    printf("Running the timer service test\n");
+
+    if (!hrtimer_can_sleep())
+    {
+        printf("  timer service is not enabled on this core\n");
+        isOk = false;
+    }
+    else
+    {
+        isOk = test_ordering() && isOk;
+        isOk = test_sleep() && isOk;
+        isOk = test_wait_event() && isOk;
+    }
+
+    printf("Timer service test %s\n", isOk ? "PASSED" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -83,14 +83,17 @@ extern "C" {
 
 //! @brief Delay for a given number of microseconds.
 //!
-//! system_time_init() must have been called before using this function.
+//! system_time_init() must have been called before using this function. Delays of at least
+//! #HRTIMER_MIN_SLEEP_US microseconds sleep in WFI on the timer service if the calling core
+//! can sleep, see hrtimer_can_sleep(). Other delays busy-wait on the EPIT.
 //!
 //! @param usecs Delay in microseconds.
 void hal_delay_us(uint32_t usecs);
 
 //! @brief Init system timer facilities.
 //!
-//! Inits the EPIT timer used for delay, and inits the microsecond counter.
+//! Inits the EPIT timer used for delay, inits the microsecond counter and enables the
+//! one-shot timer service on the calling core.
 void system_time_init(void);
 
 //! @brief Return the current microsecond counter value.
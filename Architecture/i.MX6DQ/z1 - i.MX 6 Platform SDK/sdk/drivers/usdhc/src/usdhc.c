@@ -36,7 +36,9 @@
 #include "registers/regsusdhc.h"
 #include "buffers.h"
 #include "core/cortex_a9.h"
+#include "core/dma_alloc.h"
 #include "utility/menu.h"
+#include "utility/work_queue.h"
 
 /* Global Variables */
 
@@ -148,8 +150,180 @@ static int card_init_interrupt(uint32_t instance)
     /* Register interrupt */
     register_interrupt_routine(usdhc_device[idx].intr_id, usdhc_device[idx].isr);
 
-    /* Enable interrupt */
-    enable_interrupt(usdhc_device[idx].intr_id, CPU_0, 0);
+    /* Enable interrupt, at a low priority so card transfers never delay other interrupts */
+    enable_interrupt(usdhc_device[idx].intr_id, CPU_0, kIrqPriority_Low);
+
+    return SUCCESS;
+}
+
+/*!
+ * @brief Forget the block length and capabilities of the card in the slot
+ *
+ * @param instance     Instance number of the uSDHC module.
+ */
+static void card_reset_state(uint32_t instance)
+{
+    int idx = card_get_port(instance);
+
+    if (idx == USDHC_NUMBER_PORTS) {
+        return;
+    }
+
+    usdhc_device[idx].blk_len = 0;
+    usdhc_device[idx].cmd23 = FALSE;
+}
+
+/*!
+ * @brief Run the completion of a scatter-gather transfer as deferred work
+ *
+ * @param arg          The uSDHC device of the transfer.
+ */
+static void card_xfer_sg_work(void *arg)
+{
+    card_xfer_sg_done((usdhc_inst_t *) arg - usdhc_device);
+}
+
+/*!
+ * @brief Return the card to the transfer state after a failed transfer
+ *
+ * @param instance     Instance number of the uSDHC module.
+ * 
+ * @return             0 if successful; 1 otherwise
+ */
+static int card_stop_transmission(uint32_t instance)
+{
+    command_t cmd;
+
+    /* Configure CMD12 */
+    card_cmd_config(&cmd, CMD12, NO_ARG, READ, RESPONSE_48_CHECK_BUSY, DATA_PRESENT_NONE, TRUE, TRUE);
+
+    usdhc_printf("Send CMD12.\n");
+
+    return host_send_cmd(instance, &cmd);
+}
+
+/*!
+ * @brief Start a scatter-gather multi-block transfer
+ *
+ * @param instance     Instance number of the uSDHC module.
+ * @param is_read      TRUE to read from card, FALSE to write to it.
+ * @param block        First block of the transfer, in units of BLK_LEN bytes.
+ * @param iov          Buffers of the transfer.
+ * @param count        Number of buffers.
+ * @param callback     Called when the transfer completes.
+ * @param arg          Argument of the callback.
+ * 
+ * @return             0 if the transfer was started; 1 otherwise
+ */
+static int card_xfer_sg(uint32_t instance, int is_read, uint32_t block, const usdhc_iovec_t *iov,
+                        uint32_t count, usdhc_xfer_callback_t callback, void *arg)
+{
+    command_t cmd;
+    usdhc_inst_t *dev;
+    uint32_t idx, length = 0;
+    int port, sector, wml;
+
+    /* Get uSDHC port according to instance */
+    port = card_get_port(instance);
+    if (port == USDHC_NUMBER_PORTS) {
+        printf("Base address: 0x%x not in address table.\n", REGS_USDHC_BASE(instance));
+        return FAIL;
+    }
+
+    dev = &usdhc_device[port];
+
+    if ((callback == NULL) || (iov == NULL) || (count == 0)) {
+        return FAIL;
+    }
+
+    /* Only one transfer per port at a time */
+    if (dev->sg_callback != NULL) {
+        usdhc_printf("card_xfer_sg: SD%d busy.\n", port + 1);
+        return FAIL;
+    }
+
+    /* ADMA2 needs word aligned buffers, and the transfer whole blocks */
+    for (idx = 0; idx < count; idx++) {
+        if ((((uint32_t) iov[idx].buffer | iov[idx].length) & 3) != 0) {
+            usdhc_printf("card_xfer_sg: buffer %d not word aligned.\n", idx);
+            return FAIL;
+        }
+
+        length += iov[idx].length;
+    }
+
+    sector = length / BLK_LEN;
+    if ((length % BLK_LEN) != 0 || sector == 0 || sector > MAX_BLK_COUNT) {
+        usdhc_printf("card_xfer_sg: invalid length 0x%x.\n", length);
+        return FAIL;
+    }
+
+    usdhc_printf("card_xfer_sg: %s %d blocks of SD%d at block 0x%x in %d buffers.\n",
+                 is_read ? "Read" : "Write", sector, port + 1, block, count);
+
+    /* Block addressed cards take the block number, the others a byte offset */
+    if (dev->addr_mode != SECT_MODE) {
+        block = block * BLK_LEN;
+    }
+
+    /* Set block length to card, usually a no-op */
+    if (card_set_blklen(instance, BLK_LEN) == FAIL) {
+        printf("Fail to set block length to card.\n");
+        return FAIL;
+    }
+
+    /* One descriptor table for all of the buffers */
+    if (host_setup_adma_sg(instance, iov, count) == FAIL) {
+        usdhc_printf("card_xfer_sg: too many ADMA descriptors.\n");
+        return FAIL;
+    }
+
+    for (idx = 0; idx < count; idx++) {
+        dma_sync_for_device(iov[idx].buffer, iov[idx].length, is_read ? kDmaFromDevice : kDmaToDevice);
+    }
+
+    /* Announce the block count, so the transfer needs no stop command */
+    if (dev->cmd23) {
+        card_cmd_config(&cmd, CMD23, sector, READ, RESPONSE_48, DATA_PRESENT_NONE, TRUE, TRUE);
+
+        usdhc_printf("card_xfer_sg: Send CMD23.\n");
+
+        if (host_send_cmd(instance, &cmd) == FAIL) {
+            printf("Fail to send CMD23.\n");
+            return FAIL;
+        }
+    }
+
+    /* Configure block length/number and watermark */
+    if (is_read) {
+        host_clear_fifo(instance);
+        wml = ESDHC_BLKATTR_WML_BLOCK;
+    } else {
+        wml = ESDHC_BLKATTR_WML_BLOCK << ESDHC_WML_WRITE_SHIFT;
+    }
+
+    host_cfg_block(instance, BLK_LEN, sector, wml);
+
+    /* The interrupt may come as soon as the command is sent */
+    dev->sg_read = is_read;
+    dev->sg_arg = arg;
+    work_item_init(&dev->sg_work, card_xfer_sg_work, dev);
+    dev->sg_callback = callback;
+
+    /* Use CMD18/CMD25, always with ADMA and interrupt completion */
+    card_cmd_config(&cmd, is_read ? CMD18 : CMD25, block, is_read ? READ : WRITE, RESPONSE_48,
+                    DATA_PRESENT, TRUE, TRUE);
+    cmd.dma_enable = TRUE;
+    cmd.intr_enable = TRUE;
+    cmd.acmd12_enable = !dev->cmd23;
+
+    usdhc_printf("card_xfer_sg: Send CMD%d.\n", cmd.command);
+
+    if (host_send_cmd(instance, &cmd) == FAIL) {
+        printf("Fail to send CMD%d.\n", cmd.command);
+        dev->sg_callback = NULL;
+        return FAIL;
+    }
 
     return SUCCESS;
 }
@@ -193,6 +367,9 @@ int card_init(uint32_t instance, int bus_width)
     int init_status = FAIL;
     const char* indent = menu_get_indent();
 
+    /* Forget what was known about the previous card */
+    card_reset_state(instance);
+
     /* Initialize uSDHC Controller */
     host_init(instance);
 
@@ -268,12 +445,20 @@ int card_emmc_init(uint32_t instance)
 {
     int init_status = FAIL;
 
+    /* Forget what was known about the previous card */
+    card_reset_state(instance);
+
     /* Initialize uSDHC Controller */
     host_init(instance);
 
     /* Software Reset to Interface Controller */
     host_reset(instance, ESDHC_ONE_BIT_SUPPORT, ESDHC_LITTLE_ENDIAN_MODE);
 
+    /* Initialize interrupt, scatter-gather transfers complete through it */
+    if (card_init_interrupt(instance) == FAIL) {
+        return init_status;
+    }
+
     /* Enable Identification Frequency */
     host_cfg_clock(instance, IDENTIFICATION_FREQ);
 
@@ -350,12 +535,14 @@ void card_cmd_config(command_t * cmd, int index, int argument, xfer_type_t trans
     cmd->block_count_enable_check = FALSE;
     cmd->multi_single_block = SINGLE;
     cmd->acmd12_enable = FALSE;
+    cmd->intr_enable = FALSE;
     cmd->ddren = FALSE;
 
     /* Multi Block R/W Setting */
     if ((CMD18 == index) || (CMD25 == index)) {
         if (SDHC_ADMA_mode == TRUE) {
             cmd->dma_enable = TRUE;
+            cmd->intr_enable = SDHC_INTR_mode;
         }
 
         cmd->block_count_enable_check = TRUE;
@@ -502,7 +689,13 @@ int card_get_port(uint32_t instance)
 int card_set_blklen(uint32_t instance, int len)
 {
     command_t cmd;
-    int status = FAIL;
+    int port, status = FAIL;
+
+    /* Skip CMD16 if the card already uses this length */
+    port = card_get_port(instance);
+    if (port < USDHC_NUMBER_PORTS && usdhc_device[port].blk_len == len) {
+        return SUCCESS;
+    }
 
     /* Configure CMD16 */
     card_cmd_config(&cmd, CMD16, len, READ, RESPONSE_48, DATA_PRESENT_NONE, TRUE, TRUE);
@@ -512,18 +705,30 @@ int card_set_blklen(uint32_t instance, int len)
     /* Send CMD16 */
     if (host_send_cmd(instance, &cmd) == SUCCESS) {
         status = SUCCESS;
+
+        if (port < USDHC_NUMBER_PORTS) {
+            usdhc_device[port].blk_len = len;
+        }
     } 
     
     return status;
 }
 
-static void card_buffer_flush(void *buffer, int length)
+/*!
+ * @brief Hand the buffer of a completed interrupt mode read back to the CPU
+ *
+ * @param instance     Instance number of the uSDHC module.
+ */
+static void card_buffer_sync_for_cpu(uint32_t instance)
 {
-    if(!arm_dcache_state_query())
+    int port = card_get_port(instance);
+
+    if (port == USDHC_NUMBER_PORTS || usdhc_device[port].dma_buffer == NULL) {
         return;
+    }
 
-        arm_dcache_flush_mlines(buffer, length);
-        arm_dcache_invalidate_mlines(buffer, length);
+    dma_sync_for_cpu(usdhc_device[port].dma_buffer, usdhc_device[port].dma_length, kDmaFromDevice);
+    usdhc_device[port].dma_buffer = NULL;
 }
 
 /*!
@@ -588,7 +793,7 @@ int card_data_read(uint32_t instance, int *dst_ptr, int length, uint32_t offset)
     /* If DMA mode enabled, configure BD chain */
     if (SDHC_ADMA_mode == TRUE) {
         host_setup_adma(instance, dst_ptr, length);
-        card_buffer_flush(dst_ptr, length);
+        dma_sync_for_device(dst_ptr, length, kDmaFromDevice);
     }
 
     /* Use CMD18 for multi-block read */
@@ -609,6 +814,12 @@ int card_data_read(uint32_t instance, int *dst_ptr, int length, uint32_t offset)
                 printf("Fail to read data from card.\n");
                 return FAIL;
             }
+        } else if (SDHC_INTR_mode == TRUE) {
+            /* Transfer still running, give the buffer back in card_wait_xfer_done() */
+            usdhc_device[port].dma_buffer = dst_ptr;
+            usdhc_device[port].dma_length = length;
+        } else {
+            dma_sync_for_cpu(dst_ptr, length, kDmaFromDevice);
         }
     }
 
@@ -676,7 +887,7 @@ int card_data_write(uint32_t instance, int *src_ptr, int length, int offset)
     /* If DMA mode enabled, configure BD chain */
     if (SDHC_ADMA_mode == TRUE) {
         host_setup_adma(instance, src_ptr, length);
-        card_buffer_flush(src_ptr, length);        
+        dma_sync_for_device(src_ptr, length, kDmaToDevice);
     }
 
     /* Use CMD25 for multi-block write */
@@ -704,6 +915,71 @@ int card_data_write(uint32_t instance, int *src_ptr, int length, int offset)
     return SUCCESS;
 }
 
+/*!
+ * @brief Start reading card blocks into a list of buffers
+ *
+ * @param instance     Instance number of the uSDHC module.
+ * @param block        First block to read
+ * @param iov          Buffers to fill
+ * @param count        Number of buffers
+ * @param callback     Called when the transfer completes
+ * @param arg          Argument of the callback
+ * 
+ * @return             0 if the transfer was started; 1 otherwise
+ */
+int card_read_sg(uint32_t instance, uint32_t block, const usdhc_iovec_t *iov, uint32_t count,
+                 usdhc_xfer_callback_t callback, void *arg)
+{
+    return card_xfer_sg(instance, TRUE, block, iov, count, callback, arg);
+}
+
+/*!
+ * @brief Start writing a list of buffers to card blocks
+ *
+ * @param instance     Instance number of the uSDHC module.
+ * @param block        First block to write
+ * @param iov          Buffers to write
+ * @param count        Number of buffers
+ * @param callback     Called when the transfer completes
+ * @param arg          Argument of the callback
+ * 
+ * @return             0 if the transfer was started; 1 otherwise
+ */
+int card_write_sg(uint32_t instance, uint32_t block, const usdhc_iovec_t *iov, uint32_t count,
+                  usdhc_xfer_callback_t callback, void *arg)
+{
+    return card_xfer_sg(instance, FALSE, block, iov, count, callback, arg);
+}
+
+/*!
+ * @brief Finish a scatter-gather transfer, called once the uSDHC interrupt has set the status
+ *
+ * @param idx          Index of uSDHC device.
+ */
+void card_xfer_sg_done(int idx)
+{
+    usdhc_inst_t *dev = &usdhc_device[idx];
+    uint32_t instance = REGS_USDHC_INSTANCE(dev->reg_base);
+    usdhc_xfer_callback_t callback = dev->sg_callback;
+    adma_bd_t *bd = (adma_bd_t *) dev->adma_ptr;
+    int status = (dev->status == INTR_TC) ? SUCCESS : FAIL;
+
+    /* Give the buffers of a read back to the CPU, the ADMA table still lists them */
+    if (dev->sg_read) {
+        do {
+            dma_sync_for_cpu((void *)bd->address, bd->length, kDmaFromDevice);
+        } while (!((bd++)->attribute & ESDHC_ADMA_BD_END));
+    }
+
+    /* Without the stop command a failed transfer leaves the card in the data state */
+    if ((status == FAIL) && dev->cmd23) {
+        card_stop_transmission(instance);
+    }
+
+    dev->sg_callback = NULL;
+    callback(instance, status, dev->sg_arg);
+}
+
 /*!
  * @brief Get card status
  *
@@ -741,8 +1017,10 @@ int card_wait_xfer_done(uint32_t instance)
     {
         while (timeout--) {
             card_xfer_result(instance, &usdhc_status);
-            if (usdhc_status == 1)
+            if (usdhc_status == 1) {
+                card_buffer_sync_for_cpu(instance);
                 return SUCCESS;
+            }
         }
      } else {
             /*do nothing, since in PIO/DMA mode, will check the flag in host send data*/
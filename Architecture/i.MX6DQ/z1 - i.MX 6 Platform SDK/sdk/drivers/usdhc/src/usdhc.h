@@ -31,6 +31,8 @@
 #define __USDHC_H__
 
 #include "sdk.h"
+#include "usdhc/usdhc_ifc.h"
+#include "utility/work_queue.h"
 
 #ifdef USDHC_DEBUG
 #define usdhc_printf(args...) printf(args)
@@ -56,6 +58,9 @@
 
 #define CARD_BUSY_BIT 0x80000000
 
+/* Largest block count of a single CMD18/CMD25 */
+#define MAX_BLK_COUNT 0xFFFF
+
 /* MMC Defines */
 #define MMC_SWITCH_SETBW_ARG(bus_width) (unsigned int)(0x03b70001 | ((bus_width >> 2) << 8))
 #define MMC_HV_HC_OCR_VALUE 0x40FF8000
@@ -71,6 +76,9 @@
 
 #define SD_R1_STATUS_APP_CMD_MSK 0x20
 
+#define SD_SCR_LEN 8
+#define SD_SCR_CMD23_SUPPORT 0x02   /* CMD_SUPPORT bit for CMD23 in byte 3 of SCR */
+
 #define SD_OCR_VALUE_HV_LC 0x00ff8000
 #define SD_OCR_VALUE_HV_HC 0x40ff8000
 #define SD_OCR_VALUE_LV_HC 0x40000080
@@ -105,6 +113,7 @@ enum commands {
     CMD16 = 16,
     CMD17 = 17,
     CMD18 = 18,
+    CMD23 = 23,
     CMD24 = 24,
     CMD25 = 25,
     CMD26 = 26,
@@ -190,6 +199,7 @@ typedef struct {
     multi_single_block_select multi_single_block;
     unsigned int dma_enable;
     unsigned int acmd12_enable;
+    unsigned int intr_enable;   /* DMA command completes through the uSDHC interrupt */
     ddren_enable ddren;
 } command_t;
 
@@ -210,6 +220,15 @@ typedef struct {
     unsigned char addr_mode;    //addressing mode
     unsigned char intr_id;      //interrupt ID
     unsigned char status;       //interrupt status
+    void *dma_buffer;           //buffer of the pending interrupt mode read
+    int dma_length;             //length of the pending interrupt mode read
+
+    int blk_len;                //block length last set with CMD16, 0 if unknown
+    unsigned char cmd23;        //card supports CMD23 SET_BLOCK_COUNT
+    unsigned char sg_read;      //pending scatter-gather transfer is a read
+    usdhc_xfer_callback_t sg_callback;  //completion callback of the pending scatter-gather transfer
+    void *sg_arg;               //argument of the completion callback
+    work_item_t sg_work;        //runs the completion outside of the interrupt handler
 } usdhc_inst_t;
 
 /* uSDHC device table */
@@ -298,7 +317,8 @@ extern int card_trans_status(uint32_t instance);
 extern int card_get_port(uint32_t instance);
 
 /*!
- * @brief Set block length (in bytes) for read and write
+ * @brief Set block length (in bytes) for read and write. CMD16 is only sent when the
+ * length differs from the one the card was last set to.
  *
  * @param instance     Instance number of the uSDHC module.
  * @param len          Block length to be set
@@ -307,6 +327,13 @@ extern int card_get_port(uint32_t instance);
  */
 extern int card_set_blklen(uint32_t instance, int len);
 
+/*!
+ * @brief Finish a scatter-gather transfer, called once the uSDHC interrupt has set the status
+ *
+ * @param idx          Index of uSDHC device.
+ */
+extern void card_xfer_sg_done(int idx);
+
 /*!
  * @brief Read data from card
  *
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file usdhc_blk.c
+ * @brief Block device for a request queue on top of the scatter-gather card transfers.
+ */
+
+#include "usdhc.h"
+#include "usdhc_host.h"
+#include "usdhc/usdhc_ifc.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// Definitions
+/////////////////////////////////////////////////////////////////////////////
+
+//! @brief Largest request in blocks, 1MB
+#define USDHC_BLK_MAX_SECTORS   2048
+
+//! @brief Largest number of buffers in a request, leaving descriptors for splitting long ones
+#define USDHC_BLK_MAX_SEGMENTS  128
+
+//////////////////////////////////////////////////////////////////////////////
+// Variables
+/////////////////////////////////////////////////////////////////////////////
+
+//! @brief Buffers of the request each port transfers
+static usdhc_iovec_t card_blk_iov[USDHC_NUMBER_PORTS][USDHC_BLK_MAX_SEGMENTS];
+
+//////////////////////////////////////////////////////////////////////////////
+// Code
+/////////////////////////////////////////////////////////////////////////////
+
+static void card_blk_done(uint32_t instance, int status, void *arg)
+{
+    blk_request_complete((blk_request_t *) arg, status == SUCCESS ? kBlkSuccess : kBlkError);
+}
+
+static int card_blk_submit(blk_device_t * device, blk_request_t * request)
+{
+    uint32_t instance = (uint32_t) device->context;
+    int port = card_get_port(instance);
+    usdhc_iovec_t *iov;
+    blk_bio_t *bio;
+    uint32_t count = 0;
+    int result;
+
+    if (port == USDHC_NUMBER_PORTS) {
+        return kBlkError;
+    }
+
+    iov = card_blk_iov[port];
+
+    for (bio = request->bios; bio; bio = bio->next) {
+        iov[count].buffer = bio->buffer;
+        iov[count].length = bio->count * device->sectorSize;
+        count++;
+    }
+
+    if (request->op == kBlkWrite) {
+        result = card_write_sg(instance, request->sector, iov, count, card_blk_done, request);
+    } else {
+        result = card_read_sg(instance, request->sector, iov, count, card_blk_done, request);
+    }
+
+    return result == SUCCESS ? kBlkSuccess : kBlkError;
+}
+
+void card_blk_device_init(uint32_t instance, blk_device_t * device)
+{
+    device->name = "usdhc";
+    device->sectorSize = 512;
+    device->sectorCount = 0;
+    device->maxSectors = USDHC_BLK_MAX_SECTORS;
+    device->maxSegments = USDHC_BLK_MAX_SEGMENTS;
+    device->queueDepth = 1;
+    device->submit = card_blk_submit;
+    device->poll = NULL;
+    device->context = (void *)instance;
+}
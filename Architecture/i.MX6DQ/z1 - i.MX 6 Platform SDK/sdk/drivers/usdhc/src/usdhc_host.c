@@ -120,8 +120,8 @@ static void usdhc_cmd_cfg(uint32_t instance, command_t * cmd)
     /* Clear the DMAS field */
     HW_USDHC_PROT_CTRL_CLR(instance, BM_USDHC_PROT_CTRL_DMASEL);
 
-    /* If ADMA mode enabled and command with DMA, enable ADMA2 */
-    if ((cmd->dma_enable == TRUE) && (read_usdhc_adma_mode() == TRUE)) {
+    /* If command with DMA, enable ADMA2 */
+    if (cmd->dma_enable == TRUE) {
     	BW_USDHC_PROT_CTRL_DMASEL(instance, ESDHC_PRTCTL_ADMA2_VAL);
     }
 
@@ -266,6 +266,13 @@ static void usdhc_handle_isr(int idx)
 
     /* Clear interrupt enable */
     HW_USDHC_INT_SIGNAL_EN_WR(instance, 0);
+
+    /* Finish a scatter-gather transfer with interrupts enabled if possible */
+    if (usdhc_device[idx].sg_callback != NULL) {
+        if (!work_queue(&usdhc_device[idx].sg_work)) {
+            card_xfer_sg_done(idx);
+        }
+    }
 }
 
 /*---------------------------------------------- Global Function ------------------------------------------------*/
@@ -365,7 +372,7 @@ int host_send_cmd(uint32_t instance, command_t * cmd)
     HW_USDHC_INT_STATUS(instance).U |= ESDHC_STATUS_END_CMD_RESP_TIME_MSK;
 
     /* Enable interrupt when sending DMA commands */
-    if ((read_usdhc_intr_mode() == TRUE) && (cmd->dma_enable == TRUE)) {
+    if ((cmd->intr_enable == TRUE) && (cmd->dma_enable == TRUE)) {
         int idx = card_get_port(instance);
 
         /* Set interrupt flag to busy */
@@ -381,7 +388,7 @@ int host_send_cmd(uint32_t instance, command_t * cmd)
     /* If DMA Enabled */
     if (cmd->dma_enable == TRUE) {
         /* Return in interrupt mode */
-        if (read_usdhc_intr_mode() == TRUE) {     
+        if (cmd->intr_enable == TRUE) {
             return SUCCESS;
         }
 
@@ -551,8 +558,26 @@ void host_clear_fifo(uint32_t instance)
  */
 void host_setup_adma(uint32_t instance, int *ptr, int length)
 {
-    unsigned int dst_ptr = (unsigned int)ptr;
-    unsigned int port, bd_id = 0;
+    usdhc_iovec_t iov;
+
+    iov.buffer = ptr;
+    iov.length = length;
+
+    host_setup_adma_sg(instance, &iov, 1);
+}
+
+/*!
+ * @brief uSDHC Controller Sets up a scatter-gather ADMA transfer
+ * 
+ * @param instance     Instance number of the uSDHC module.
+ * @param iov          Buffers of the transfer, each word aligned
+ * @param count        Number of buffers
+ * 
+ * @return             0 if successful; 1 if the buffers need more than ESDHC_ADMA_BD_COUNT descriptors
+ */
+int host_setup_adma_sg(uint32_t instance, const usdhc_iovec_t *iov, uint32_t count)
+{
+    unsigned int dst_ptr, length, port, bd_id = 0;
     adma_bd_t *bd_addr;
 
     /* Get uSDHC port according to base address */
@@ -561,28 +586,46 @@ void host_setup_adma(uint32_t instance, int *ptr, int length)
     /* Get BD pointer */
     bd_addr = (adma_bd_t *) usdhc_device[port].adma_ptr;
 
-    /* Setup BD chain */
-    while (length > 0) {
-        bd_addr[bd_id].address = dst_ptr;
-        if (length > ESDHC_ADMA_BD_MAX_LEN) {
-            bd_addr[bd_id].length = ESDHC_ADMA_BD_MAX_LEN;
+    /* Setup BD chain, one or more descriptors per buffer */
+    for (; count > 0; count--, iov++) {
+        dst_ptr = (unsigned int)iov->buffer;
+        length = iov->length;
+
+        while (length > 0) {
+            if (bd_id == ESDHC_ADMA_BD_COUNT) {
+                return FAIL;
+            }
+
+            bd_addr[bd_id].address = dst_ptr;
             bd_addr[bd_id].attribute = ESDHC_ADMA_BD_ACT | ESDHC_ADMA_BD_VALID;
-            length -= ESDHC_ADMA_BD_MAX_LEN;
-            dst_ptr += ESDHC_ADMA_BD_MAX_LEN;
-        } else {
-            bd_addr[bd_id].length = length;
-            bd_addr[bd_id].attribute = ESDHC_ADMA_BD_ACT | ESDHC_ADMA_BD_VALID | ESDHC_ADMA_BD_END;
-            length = 0;
+
+            if (length > ESDHC_ADMA_BD_MAX_LEN) {
+                bd_addr[bd_id].length = ESDHC_ADMA_BD_MAX_LEN;
+                length -= ESDHC_ADMA_BD_MAX_LEN;
+                dst_ptr += ESDHC_ADMA_BD_MAX_LEN;
+            } else {
+                bd_addr[bd_id].length = length;
+                length = 0;
+            }
+
+            bd_id++;
         }
+    }
 
-        bd_id++;
+    if (bd_id == 0) {
+        return FAIL;
     }
 
+    /* Terminate the chain at the last descriptor */
+    bd_addr[bd_id - 1].attribute |= ESDHC_ADMA_BD_END;
+
     /* Setup BD pointer */
     HW_USDHC_ADMA_SYS_ADDR(instance).U = (unsigned int)bd_addr;
 
     /* Clear interrupt status */
     HW_USDHC_INT_STATUS_WR(instance, ESDHC_CLEAR_INTERRUPT);
+
+    return SUCCESS;
 }
 
 /*!
@@ -156,6 +156,7 @@
 #define ESDHC_ADMA_BD_END             ((unsigned char)0x02)
 #define ESDHC_ADMA_BD_VALID           ((unsigned char)0x01)
 #define ESDHC_ADMA_BD_MAX_LEN         ((unsigned short)(64*1024-512))
+#define ESDHC_ADMA_BD_COUNT           (0x1000 / sizeof(adma_bd_t))  /* Descriptors in a 4KB ADMA buffer */
 
 //#define ESDHC_INTSTAT_BRR             (0x00000020)
 //#define ESDHC_INTSTAT_BWR             (0x00000010)
@@ -323,6 +324,19 @@ extern void host_clear_fifo(uint32_t instance);
  */
 extern void host_setup_adma(uint32_t instance, int *ptr, int length);
 
+/*!
+ * @brief uSDHC Controller Sets up a scatter-gather ADMA transfer
+ *
+ * Buffers longer than a descriptor can hold are split over several descriptors.
+ * 
+ * @param instance     Instance number of the uSDHC module.
+ * @param iov          Buffers of the transfer, each word aligned
+ * @param count        Number of buffers
+ * 
+ * @return             0 if successful; 1 if the buffers need more than ESDHC_ADMA_BD_COUNT descriptors
+ */
+extern int host_setup_adma_sg(uint32_t instance, const usdhc_iovec_t *iov, uint32_t count);
+
 /*!
  * @brief uSDHC Controller reads data
  * 
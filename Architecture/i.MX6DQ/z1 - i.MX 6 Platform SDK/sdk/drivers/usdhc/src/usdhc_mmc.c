@@ -177,12 +177,7 @@ static int mmc_read_esd(uint32_t instance)
     command_t cmd;
 
     /* Set block length */
-    card_cmd_config(&cmd, CMD16, BLK_LEN, READ, RESPONSE_48, DATA_PRESENT_NONE, TRUE, TRUE);
-
-    usdhc_printf("Send CMD16.\n");
-
-    /* Send CMD16 */
-    if (SUCCESS == host_send_cmd(instance, &cmd)) {
+    if (SUCCESS == card_set_blklen(instance, BLK_LEN)) {
         /* Configure block attribute */
         host_cfg_block(instance, BLK_LEN, ONE, ESDHC_BLKATTR_WML_BLOCK);
 
@@ -271,6 +266,9 @@ int mmc_init(uint32_t instance, int bus_width)
                     /* Set Host Bus Width */
                     host_set_bus_width(instance, bus_width);
 
+                    /* CMD23 is mandatory since MMC 3.1 */
+                    usdhc_device[card_get_port(instance)].cmd23 = TRUE;
+
                     /* Set High Speed Here */
                     {
                         status = SUCCESS;
@@ -310,6 +308,9 @@ int emmc_init(uint32_t instance)
 
             status = SUCCESS;
 
+            /* CMD23 is mandatory since MMC 3.1 */
+            usdhc_device[card_get_port(instance)].cmd23 = TRUE;
+
             retv = mmc_get_spec_ver(instance);
 
             /* Obtain CSD structure */
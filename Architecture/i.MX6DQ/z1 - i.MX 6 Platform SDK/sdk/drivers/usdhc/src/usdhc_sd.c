@@ -148,6 +148,62 @@ static int sd_set_bus_width(uint32_t instance, int bus_width)
     return status;
 }
 
+/*!
+ * @brief Read the SCR (SD configuration register) and note the commands the card supports
+ * 
+ * @param instance     Instance number of the uSDHC module.
+ * 
+ * @return             0 if successful; 1 otherwise
+ */
+static int sd_read_scr(uint32_t instance)
+{
+    command_t cmd;
+    int port, address, status = FAIL;
+    command_response_t response;
+    unsigned int scr[SD_SCR_LEN / FOUR];
+
+    /* Check uSDHC Port */
+    port = card_get_port(instance);
+    if (port == USDHC_NUMBER_PORTS) {
+        printf("Base address: 0x%x not in address table.\n", REGS_USDHC_BASE(instance));
+        return status;
+    }
+
+    address = usdhc_device[port].rca << RCA_SHIFT;
+
+    /* Configure CMD55 */
+    card_cmd_config(&cmd, CMD55, address, READ, RESPONSE_48, DATA_PRESENT_NONE, TRUE, TRUE);
+
+    usdhc_printf("Send CMD55.\n");
+
+    /* Send ACMD51 */
+    if (host_send_cmd(instance, &cmd) == SUCCESS) {
+        /* Check Response of Application Command */
+        response.format = RESPONSE_48;
+        host_read_response(instance, &response);
+
+        if (response.cmd_rsp0 & SD_R1_STATUS_APP_CMD_MSK) {
+            /* SCR is a single 8 byte block */
+            host_cfg_block(instance, SD_SCR_LEN, ONE, SD_SCR_LEN / FOUR);
+
+            /* Configure ACMD51 */
+            card_cmd_config(&cmd, ACMD51, NO_ARG, READ, RESPONSE_48, DATA_PRESENT, TRUE, TRUE);
+
+            usdhc_printf("Send ACMD51.\n");
+
+            if ((host_send_cmd(instance, &cmd) == SUCCESS) &&
+                (host_data_read(instance, (int *)scr, SD_SCR_LEN, SD_SCR_LEN / FOUR) == SUCCESS)) {
+                /* SCR is sent most significant byte first */
+                usdhc_device[port].cmd23 = ((scr[0] >> 24) & SD_SCR_CMD23_SUPPORT) ? TRUE : FALSE;
+
+                status = SUCCESS;
+            }
+        }
+    }
+
+    return status;
+}
+
 /********************************************* Global Function ******************************************/
 /*!
  * @brief Initialize SD - Get Card ID, Set RCA, Frequency and bus width.
@@ -189,6 +245,11 @@ int sd_init(uint32_t instance, int bus_width)
                     /* Set Bus Width for Controller */
                     host_set_bus_width(instance, bus_width);
 
+                    /* Check for CMD23, without it transfers are stopped with CMD12 */
+                    if (sd_read_scr(instance) == FAIL) {
+                        usdhc_printf("Read SCR failed.\n");
+                    }
+
                     /* Set High Speed Here */
                     {
                         status = SUCCESS;
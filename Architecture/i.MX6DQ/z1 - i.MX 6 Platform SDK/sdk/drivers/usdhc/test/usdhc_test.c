@@ -40,6 +40,7 @@
 static int usdhc_test_pio(void);
 static int usdhc_test_adma(void);
 static int usdhc_test_adma_intr(void);
+static int usdhc_test_sg(void);
 static int usdhc_test_emmc(void);
 static int emmc_test_dump(void);
 static int emmc_test_boot(void);
@@ -51,6 +52,7 @@ static usdhc_test_t usdhc_tests[] = {
     {"usdhc polling IO", usdhc_test_pio},
     {"usdhc ADMA polling", usdhc_test_adma},
     {"usdhc ADMA interrupt", usdhc_test_adma_intr},
+    {"usdhc scatter-gather", usdhc_test_sg},
     {"**emmc special", usdhc_test_emmc},
 };
 
@@ -87,6 +89,10 @@ static int mmc_test_src[MMC_TEST_BUF_SIZE + MMC_CARD_SECTOR_BUFFER];
 static int mmc_test_dst[MMC_TEST_BUF_SIZE + MMC_CARD_SECTOR_BUFFER];
 static int mmc_test_tmp[MMC_TEST_BUF_SIZE + MMC_CARD_SECTOR_BUFFER];
 
+/* Scatter-gather completion */
+static volatile int sg_test_done;
+static volatile int sg_test_result;
+
 /********************************************* Global Function ******************************************/
 test_return_t mmc_sd_test(unsigned int bus_width, uint32_t instance)
 {
@@ -177,6 +183,114 @@ static int usdhc_test_adma_intr(void)
     return retv;
 }
 
+static void sg_test_callback(uint32_t instance, int status, void *arg)
+{
+    sg_test_result = status;
+    sg_test_done = TRUE;
+}
+
+static int sg_test_xfer(uint32_t instance, int is_read, const usdhc_iovec_t *iov, uint32_t count)
+{
+    int status;
+
+    sg_test_done = FALSE;
+
+    if (is_read) {
+        status = card_read_sg(instance, MMC_TEST_OFFSET / MMC_TEST_BLK_LEN, iov, count, sg_test_callback, NULL);
+    } else {
+        status = card_write_sg(instance, MMC_TEST_OFFSET / MMC_TEST_BLK_LEN, iov, count, sg_test_callback, NULL);
+    }
+
+    if (status == FAIL) {
+        return FAIL;
+    }
+
+    /* Wait for the callback */
+    while (!sg_test_done) ;
+
+    return sg_test_result;
+}
+
+static int usdhc_test_sg(void)
+{
+    int idx;
+    usdhc_iovec_t iov[3];
+    uint32_t instance = HW_USDHC3;
+    const char* indent = menu_get_indent();
+
+    printf("%s1. Init card.\n", indent);
+
+    /* MMC - 8 bit, SD - 4 bit  */
+    if (card_init(instance, 8) == FAIL) {
+        printf("%sSD/MMC initialize failed.\n", indent);
+        return FALSE;
+    }
+
+    /* Number the words, so misplaced pieces show up */
+    for (idx = 0; idx < MMC_TEST_SG_WORDS; idx++) {
+        mmc_test_src[idx] = 0x5A000000 | idx;
+    }
+    memset(mmc_test_dst, 0xA5, MMC_TEST_SG_WORDS * sizeof(int));
+
+    printf("%s2. Card -> TMP.\n", indent);
+
+    iov[0].buffer = mmc_test_tmp;
+    iov[0].length = MMC_TEST_SG_WORDS * sizeof(int);
+
+    if (sg_test_xfer(instance, TRUE, iov, 1) == FAIL) {
+        printf("%s%d: SD/MMC data read failed.\n", indent, __LINE__);
+        return FALSE;
+    }
+
+    printf("%s3. SRC -> Card, in 3 pieces.\n", indent);
+
+    iov[0].buffer = mmc_test_src;
+    iov[0].length = 1000 * sizeof(int);
+    iov[1].buffer = mmc_test_src + 1000;
+    iov[1].length = 4000 * sizeof(int);
+    iov[2].buffer = mmc_test_src + 5000;
+    iov[2].length = (MMC_TEST_SG_WORDS - 5000) * sizeof(int);
+
+    if (sg_test_xfer(instance, FALSE, iov, 3) == FAIL) {
+        printf("%s%d: SD/MMC data write failed.\n", indent, __LINE__);
+        return FALSE;
+    }
+
+    printf("%s4. Card -> DST, in 2 pieces.\n", indent);
+
+    iov[0].buffer = mmc_test_dst;
+    iov[0].length = 12 * sizeof(int);
+    iov[1].buffer = mmc_test_dst + 12;
+    iov[1].length = (MMC_TEST_SG_WORDS - 12) * sizeof(int);
+
+    if (sg_test_xfer(instance, TRUE, iov, 2) == FAIL) {
+        printf("%s%d: SD/MMC data read failed.\n", indent, __LINE__);
+        return FALSE;
+    }
+
+    printf("%s5. TMP -> Card.\n", indent);
+
+    iov[0].buffer = mmc_test_tmp;
+    iov[0].length = MMC_TEST_SG_WORDS * sizeof(int);
+
+    if (sg_test_xfer(instance, FALSE, iov, 1) == FAIL) {
+        printf("%s%d: SD/MMC data write failed.\n", indent, __LINE__);
+        return FALSE;
+    }
+
+    printf("%s6. Compare SRC & DST.\n", indent);
+
+    for (idx = 0; idx < MMC_TEST_SG_WORDS; idx++) {
+        if (mmc_test_src[idx] != mmc_test_dst[idx]) {
+            printf("%sWord %d mismatch: source - 0x%x, destination - 0x%x\n", indent, idx + 1,
+                   mmc_test_src[idx], mmc_test_dst[idx]);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 static int emmc_test_dump(void)
 {
 //    emmc_print_cfg_info(emmc_base_addr);
@@ -38,6 +38,9 @@
 
 #define MMC_CARD_SECTOR_BUFFER 0x80
 
+#define MMC_TEST_BLK_LEN   512
+#define MMC_TEST_SG_WORDS  (48 * MMC_TEST_BLK_LEN / 4)   /* Whole blocks within MMC_TEST_BUF_SIZE */
+
 typedef struct {
     const char *name;
     int (*test) (void);
@@ -41,6 +41,7 @@
 
 #include "sdk.h"
 #include "registers/regsusdhc.h"
+#include "utility/block_queue.h"
 
 //////////////////////////////////////////////////////////////////////////////
 // Definitions
@@ -70,6 +71,24 @@ typedef enum {
     EMMC_BOOT_DDR8
 } emmc_bus_width_e;
 
+//! @brief One buffer of a scatter-gather transfer.
+typedef struct {
+    void *buffer;       //!< Start of the buffer, word aligned.
+    uint32_t length;    //!< Length of the buffer in bytes, a multiple of 4.
+} usdhc_iovec_t;
+
+/*!
+ * @brief Completion callback of a scatter-gather transfer.
+ *
+ * Called from deferred work, or from the uSDHC interrupt handler when no work queue runs on
+ * the core. The buffers already belong to the CPU again when it is called.
+ *
+ * @param instance     Instance number of the uSDHC module.
+ * @param status       0 if the transfer succeeded; 1 otherwise.
+ * @param arg          Argument passed to card_read_sg() or card_write_sg().
+ */
+typedef void (*usdhc_xfer_callback_t)(uint32_t instance, int status, void *arg);
+
 //////////////////////////////////////////////////////////////////////////////////
 // API
 //////////////////////////////////////////////////////////////////////////////////
@@ -130,6 +149,46 @@ extern int card_data_read(uint32_t instance, int *dst_ptr,  int length, uint32_t
 */
 extern int card_data_write(uint32_t instance, int *src_ptr, int length, int offset);
 
+/*!
+ * @brief Start reading consecutive blocks from card into a list of buffers
+ *
+ * The buffers are described by a single ADMA2 descriptor table, and the block count is
+ * announced with CMD23 before CMD18 when the card supports it, so the card needs neither
+ * CMD16 (unless the block length changed) nor a stop command. The function returns once
+ * the transfer is started; @a callback is called when it is done. Works whatever mode
+ * set_card_access_mode() selected, and only one transfer may be pending per instance.
+ *
+ * @param   instance       Instance number of the uSDHC module.
+ * @param   block          First block to read, in units of 512 bytes.
+ * @param   iov            Buffers to fill, in order. Their total length is a multiple of 512.
+ * @param   count          Number of entries in @a iov.
+ * @param   callback       Called when the transfer completes. Must not be NULL.
+ * @param   arg            Passed to @a callback.
+ *
+ * @return  0 if the transfer was started; non-zero otherwise, in which case @a callback
+ *          is not called.
+ */
+extern int card_read_sg(uint32_t instance, uint32_t block, const usdhc_iovec_t *iov, uint32_t count,
+                        usdhc_xfer_callback_t callback, void *arg);
+
+/*!
+ * @brief Start writing a list of buffers to consecutive blocks of card
+ *
+ * The counterpart of card_read_sg(), using CMD23 and CMD25.
+ *
+ * @param   instance       Instance number of the uSDHC module.
+ * @param   block          First block to write, in units of 512 bytes.
+ * @param   iov            Buffers to write, in order. Their total length is a multiple of 512.
+ * @param   count          Number of entries in @a iov.
+ * @param   callback       Called when the transfer completes. Must not be NULL.
+ * @param   arg            Passed to @a callback.
+ *
+ * @return  0 if the transfer was started; non-zero otherwise, in which case @a callback
+ *          is not called.
+ */
+extern int card_write_sg(uint32_t instance, uint32_t block, const usdhc_iovec_t *iov, uint32_t count,
+                         usdhc_xfer_callback_t callback, void *arg);
+
 /*!
  * @brief Read the data transfer status(only in interrupt mode)
  * 
@@ -140,6 +199,17 @@ extern int card_data_write(uint32_t instance, int *src_ptr, int length, int offs
  */
 extern int card_xfer_result(uint32_t instance, int *status);
 
+/*!
+ * @brief Set up a block device for a request queue
+ *
+ * Requests are carried out with card_read_sg() and card_write_sg(), one at a time, and
+ * complete from their callback. The card must have been initialized.
+ *
+ * @param   instance       Instance number of the uSDHC module.
+ * @param   device         Filled in with the device description.
+ */
+extern void card_blk_device_init(uint32_t instance, blk_device_t *device);
+
 /*!
  * @brief Wait for the transfer complete. It covers the interrupt mode, DMA mode and PIO mode
  *
@@ -74,6 +74,11 @@
 #define F_BIT        0x40    //!< When F bit is set, FIQ is disabled
 //@}
 
+//! @name FPEXC fields
+//@{
+#define FPEXC_EN     (1 << 30)  //!< VFP and NEON instructions are enabled
+//@}
+
 //! @name Stack sizes
 //@{
 
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if !defined(__BLOCK_QUEUE_H__)
+#define __BLOCK_QUEUE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "utility/work_queue.h"
+
+//! @addtogroup block_queue
+//! @{
+
+/*!
+ * @file block_queue.h
+ * @brief Request queue between filesystems and block storage drivers.
+ *
+ * Callers describe transfers with bios, which are queued without blocking and completed
+ * through a callback. The queue merges a bio into a waiting request for adjacent sectors in
+ * the same direction, in front or behind, so small sequential transfers reach the device as
+ * one large request. The deadline elevator dispatches requests in ascending sector order from
+ * the end of the previous one, wrapping around at the end of the disk, unless a request has
+ * waited longer than its deadline. Requests that overlap an older request, where either of
+ * them writes, are never dispatched before it.
+ *
+ * At most blk_device_t::queueDepth requests are handed to the device at a time. While the
+ * queue is plugged with blk_plug() bios accumulate and merge without being dispatched.
+ *
+ * Submitters, the device's completions and the work queue all drive the queue through
+ * blk_queue_run(). Bios and completions are pushed onto lock-free stacks and a single caller
+ * at a time processes them, so the queue can be used from thread code, interrupt handlers
+ * and other cores without a lock. Completion callbacks run from that caller.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Number of requests of a queue, waiting or handed to the device.
+#if !defined(BLK_QUEUE_REQUESTS)
+#define BLK_QUEUE_REQUESTS (32)
+#endif
+
+//! @brief Default time after which a read request is dispatched out of order, in microseconds.
+#if !defined(BLK_READ_EXPIRE_US)
+#define BLK_READ_EXPIRE_US (50000)
+#endif
+
+//! @brief Default time after which a write request is dispatched out of order, in microseconds.
+#if !defined(BLK_WRITE_EXPIRE_US)
+#define BLK_WRITE_EXPIRE_US (500000)
+#endif
+
+//! @brief Status of a bio or request.
+enum _blk_status
+{
+    kBlkSuccess = 0,    //!< The transfer completed.
+    kBlkError = 1,      //!< The device failed the transfer.
+    kBlkInvalid = 2     //!< The bio is empty, too large or beyond the end of the device.
+};
+
+//! @brief Direction of a transfer.
+typedef enum _blk_op
+{
+    kBlkRead = 0,
+    kBlkWrite = 1
+} blk_op_t;
+
+//! @brief Order in which waiting requests are dispatched.
+typedef enum _blk_elevator
+{
+    kBlkElevatorFifo,       //!< Arrival order, for media without seek cost. Requests still merge.
+    kBlkElevatorDeadline    //!< Sector order from the head position, expired requests first.
+} blk_elevator_t;
+
+struct _blk_bio;
+struct _blk_queue;
+struct _blk_device;
+
+//! @brief Completion callback of a bio.
+//!
+//! @param bio The completed bio, owned by the caller again.
+//! @param status #kBlkSuccess or another #_blk_status value.
+typedef void (*blk_bio_callback_t)(struct _blk_bio * bio, int status);
+
+//! @brief A transfer between consecutive sectors and one buffer.
+//!
+//! Bios are owned by the caller and must stay valid until their callback is called. Use
+//! blk_bio_init() to initialize one.
+typedef struct _blk_bio {
+    struct _blk_bio * volatile next;    //!< Next bio in the incoming stack or in a request.
+    blk_op_t op;                        //!< Direction.
+    uint32_t sector;                    //!< First sector, in units of blk_device_t::sectorSize.
+    uint32_t count;                     //!< Number of sectors.
+    void * buffer;                      //!< Data, @a count sectors long.
+    blk_bio_callback_t callback;        //!< Called when the transfer completed.
+    void * arg;                         //!< For use by the callback.
+    uint64_t submitTime;                //!< Set by blk_submit_bio(), in microseconds.
+} blk_bio_t;
+
+//! @brief Merged bios handed to a device as one transfer.
+//!
+//! The bios are in ascending sector order and linked by their @a next members, starting at
+//! @a bios. Each one covers the next blk_bio_t::count sectors of the request.
+typedef struct _blk_request {
+    struct _blk_request * next;             //!< Link in the lists of the queue.
+    struct _blk_request * volatile nextCompleted;   //!< Link in the stack of completed requests.
+    struct _blk_queue * queue;              //!< Queue the request belongs to.
+    blk_op_t op;                            //!< Direction of all the bios.
+    uint32_t sector;                        //!< First sector.
+    uint32_t count;                         //!< Number of sectors.
+    uint32_t segments;                      //!< Number of bios.
+    blk_bio_t * bios;                       //!< First bio.
+    blk_bio_t * lastBio;                    //!< Last bio.
+    uint32_t sequence;                      //!< Arrival order of the oldest bio.
+    uint64_t deadline;                      //!< Time after which the request is dispatched first.
+    int status;                             //!< Status passed to blk_request_complete().
+    void * driverData;                      //!< For use by the device while it owns the request.
+} blk_request_t;
+
+//! @brief A block device as seen by the queue.
+typedef struct _blk_device {
+    const char * name;          //!< Name for statistics.
+    uint32_t sectorSize;        //!< Bytes per sector.
+    uint32_t sectorCount;       //!< Capacity in sectors, or 0 if unknown.
+    uint32_t maxSectors;        //!< Largest request in sectors. Larger bios are invalid.
+    uint32_t maxSegments;       //!< Largest number of bios in a request, or 0 for no limit.
+    uint32_t queueDepth;        //!< Requests the device accepts at a time.
+
+    //! @brief Start a request.
+    //!
+    //! The device calls blk_request_complete() when it is done, which may be before this
+    //! function returns. Called with the queue busy, so it must not wait for other requests.
+    //!
+    //! @retval #kBlkSuccess The request was started.
+    //! @retval other The request was not started; it completes with this status.
+    int (*submit)(struct _blk_device * device, blk_request_t * request);
+
+    //! @brief Check the device for completed requests, may be NULL.
+    //!
+    //! Called while a caller waits in blk_transfer() or blk_queue_drain(), for devices that
+    //! complete requests without an interrupt.
+    void (*poll)(struct _blk_device * device);
+
+    void * context;             //!< For use by the device.
+} blk_device_t;
+
+//! @brief Statistics of a queue.
+typedef struct _blk_stats {
+    uint32_t bios;              //!< Bios submitted.
+    uint32_t requests;          //!< Requests dispatched to the device.
+    uint32_t frontMerges;       //!< Bios merged in front of a waiting request.
+    uint32_t backMerges;        //!< Bios merged behind a waiting request.
+    uint32_t expired;           //!< Requests dispatched out of order because of their deadline.
+    uint32_t errors;            //!< Bios completed with an error.
+    uint32_t maxInFlight;       //!< Most requests owned by the device at a time.
+    uint32_t maxLatency;        //!< Longest time from submission to completion of a bio, in microseconds.
+    uint64_t totalLatency;      //!< Sum of the bio latencies, in microseconds.
+    uint64_t sectorsRead;       //!< Sectors read by completed requests.
+    uint64_t sectorsWritten;    //!< Sectors written by completed requests.
+    uint64_t busyTime;          //!< Time with at least one request at the device, in microseconds.
+} blk_stats_t;
+
+//! @brief A request queue for one device.
+//!
+//! Owned by the caller. Use blk_queue_init() to initialize it.
+typedef struct _blk_queue {
+    blk_device_t * device;                      //!< The device.
+    blk_elevator_t elevator;                    //!< Dispatch order.
+    uint32_t readExpire;                        //!< Deadline of reads, in microseconds.
+    uint32_t writeExpire;                       //!< Deadline of writes, in microseconds.
+    blk_bio_t * volatile incoming;              //!< Bios pushed by submitters, newest first.
+    blk_request_t * volatile completed;         //!< Requests completed by the device.
+    volatile uint32_t runState;                 //!< Whether blk_queue_run() is running.
+    volatile int32_t plugCount;                 //!< Nesting of blk_plug().
+    volatile int32_t outstanding;               //!< Bios whose callback has not returned.
+    blk_bio_t * backlog;                        //!< Oldest bio waiting for a free request.
+    blk_bio_t * backlogTail;                    //!< Newest bio waiting for a free request.
+    blk_request_t * pending;                    //!< Requests waiting for the device.
+    blk_request_t * active;                     //!< Requests owned by the device.
+    blk_request_t * freeRequests;               //!< Unused requests.
+    uint32_t inFlight;                          //!< Number of requests owned by the device.
+    uint32_t headSector;                        //!< Sector after the last dispatched request.
+    uint32_t sequence;                          //!< Arrival counter of bios.
+    uint64_t busyStart;                         //!< Time the device got its first request.
+    blk_stats_t stats;                          //!< Statistics since they were last read.
+    work_item_t work;                           //!< Runs the queue after completions.
+    blk_request_t requests[BLK_QUEUE_REQUESTS]; //!< Storage of the requests.
+} blk_queue_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @brief Initialize a queue for a device.
+//!
+//! Deadlines are set to #BLK_READ_EXPIRE_US and #BLK_WRITE_EXPIRE_US; they can be changed
+//! in the queue before it is used.
+void blk_queue_init(blk_queue_t * queue, blk_device_t * device, blk_elevator_t elevator);
+
+//! @brief Initialize a bio.
+void blk_bio_init(blk_bio_t * bio, blk_op_t op, uint32_t sector, uint32_t count, void * buffer,
+                  blk_bio_callback_t callback, void * arg);
+
+//! @brief Queue a bio.
+//!
+//! Never blocks. The callback may be called before this function returns.
+void blk_submit_bio(blk_queue_t * queue, blk_bio_t * bio);
+
+//! @brief Transfer sectors and wait for the transfer to complete.
+//!
+//! Must not be called with the queue plugged by the caller, or from an interrupt handler.
+//!
+//! @return #kBlkSuccess or another #_blk_status value.
+int blk_transfer(blk_queue_t * queue, blk_op_t op, uint32_t sector, uint32_t count, void * buffer);
+
+//! @brief Hold back dispatching, so the following bios can merge. Calls nest.
+void blk_plug(blk_queue_t * queue);
+
+//! @brief Undo one blk_plug(), dispatching the queued requests after the last one.
+void blk_unplug(blk_queue_t * queue);
+
+//! @brief Process submitted bios and completed requests, and dispatch requests.
+//!
+//! Returns immediately if another caller is running the queue, which then does the work.
+void blk_queue_run(blk_queue_t * queue);
+
+//! @brief Wait until all bios submitted so far completed.
+//!
+//! Must not be called with the queue plugged, or from an interrupt handler.
+void blk_queue_drain(blk_queue_t * queue);
+
+//! @brief Report the completion of a request. For use by devices.
+//!
+//! May be called from interrupt handlers. The queue processes the completion from the work
+//! queue of the core, or right away if there is none.
+//!
+//! @param request The request passed to blk_device_t::submit.
+//! @param status #kBlkSuccess or another #_blk_status value, passed to the callbacks of its bios.
+void blk_request_complete(blk_request_t * request, int status);
+
+//! @brief Read and clear the statistics of a queue.
+void blk_queue_get_stats(blk_queue_t * queue, blk_stats_t * stats);
+
+#if defined(__cplusplus)
+}
+#endif
+
+//! @}
+
+#endif // __BLOCK_QUEUE_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//! @addtogroup fast_string
+//! @{
+
+/*!
+ * @file fast_string.h
+ * @brief Memory copy, move, fill and compare tuned for the Cortex-A9.
+ *
+ * On the target these are NEON routines that align the destination to 16 bytes, move 64 bytes
+ * per iteration and preload the source #FAST_STRING_PLD_DISTANCE bytes ahead. Sources that
+ * stay misaligned are loaded with byte-element loads, which the A9 handles at full speed as
+ * long as they do not cross a cache line. Requests under 64 bytes skip the NEON setup.
+ *
+ * Builds without NEON, such as the host build of the tests, get a portable C version that
+ * copies words when source and destination share their alignment.
+ *
+ * The routines use NEON registers, so the FPU must have been enabled with enable_neon_fpu()
+ * before they are called. They may be called from interrupt handlers, since the IRQ entry
+ * saves the caller-saved NEON registers of the interrupted code.
+ */
+
+#if !defined(__FAST_STRING_H__)
+#define __FAST_STRING_H__
+
+#if !defined(__ASSEMBLER__)
+#include <stddef.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Whether the NEON versions of the routines are built.
+//!
+//! Decided from the target rather than from __ARM_NEON__, which the preprocessor run on the
+//! assembly sources does not see because it gets no -mfpu option.
+#if defined(__arm__) && !defined(__linux__)
+#define FAST_STRING_HAS_NEON (1)
+#else
+#define FAST_STRING_HAS_NEON (0)
+#endif
+
+//! @brief How far ahead of the loads the NEON loops preload the source, in bytes.
+//!
+//! Six 32-byte lines cover the latency of DDR behind the L2 at the A9 clock rates.
+#define FAST_STRING_PLD_DISTANCE (192)
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(__ASSEMBLER__)
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @brief Copy @a n bytes between buffers that do not overlap.
+//! @return @a dst
+void * fast_memcpy(void * dst, const void * src, size_t n);
+
+//! @brief Copy @a n bytes between buffers that may overlap.
+//! @return @a dst
+void * fast_memmove(void * dst, const void * src, size_t n);
+
+//! @brief Fill @a n bytes with the low byte of @a c.
+//! @return @a dst
+void * fast_memset(void * dst, int c, size_t n);
+
+//! @brief Compare @a n bytes.
+//! @return Difference of the first pair of bytes that differ, as unsigned chars, or 0.
+int fast_memcmp(const void * a, const void * b, size_t n);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // !defined(__ASSEMBLER__)
+
+//! @}
+
+#endif // __FAST_STRING_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
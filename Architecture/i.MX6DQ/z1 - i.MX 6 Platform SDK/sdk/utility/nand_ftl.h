@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if !defined(__NAND_FTL_H__)
+#define __NAND_FTL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "utility/block_queue.h"
+
+//! @addtogroup nand_ftl
+//! @{
+
+/*!
+ * @file nand_ftl.h
+ * @brief Log-structured flash translation layer for raw NAND.
+ *
+ * Logical pages are written to the next free physical page of a single log, so a block is
+ * always programmed in page order and only erased once everything in it is stale. The
+ * logical to physical page map is itself stored in the log as map pages, of which only a few
+ * are cached in RAM. A directory of where each map page lives, the valid page count and
+ * erase count of each block and the block states are the only per-device tables kept in RAM.
+ *
+ * Every page carries an #ftl_spare_t in its spare area with what it holds and a sequence
+ * number. Checkpoints of the RAM tables and the changes to the cached map pages are
+ * written to the first #FTL_CHECKPOINT_BLOCKS blocks of the device. Blocks only become free
+ * again at a checkpoint and are allocated in an order fixed by the last checkpoint, so
+ * mounting reads the newest checkpoint and then follows that order through the blocks
+ * written since, instead of scanning the device.
+ *
+ * Blocks are reclaimed by garbage collection of the block with the fewest valid pages, from
+ * the write path when free blocks run out or ahead of time from ftl_background(). Free blocks
+ * are allocated lowest erase count first, and ftl_background() also moves cold data out of
+ * the least worn block once the erase counts spread by more than
+ * ftl_config_t::wearLevelThreshold. Blocks whose reads needed many corrections are
+ * rewritten, and blocks that fail to program or erase are retired to the bad block table.
+ *
+ * An FTL is not reentrant. All calls for one FTL, including the block device submit
+ * function and ftl_background(), must come from one context at a time.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Blocks at the start of the device that hold the checkpoints.
+#if !defined(FTL_CHECKPOINT_BLOCKS)
+#define FTL_CHECKPOINT_BLOCKS (8)
+#endif
+
+//! @brief Free blocks kept for garbage collection and checkpoints.
+#if !defined(FTL_GC_RESERVE_BLOCKS)
+#define FTL_GC_RESERVE_BLOCKS (3)
+#endif
+
+//! @brief Largest request of the block device in pages.
+#if !defined(FTL_BLK_MAX_PAGES)
+#define FTL_BLK_MAX_PAGES (64)
+#endif
+
+//! @brief Bytes of the spare area used by #ftl_spare_t.
+#define FTL_SPARE_BYTES (9)
+
+//! @brief Physical page of a logical page that was never written.
+#define FTL_UNMAPPED (0xffffffff)
+
+//! @brief Status of an FTL call.
+enum _ftl_status
+{
+    kFtlSuccess = 0,        //!< The call completed.
+    kFtlError = 1,          //!< The NAND failed, or data could not be corrected.
+    kFtlInvalid = 2,        //!< An argument is out of range or the geometry is unsupported.
+    kFtlNoSpace = 3,        //!< No block could be reclaimed for the write.
+    kFtlNotFormatted = 4    //!< No valid checkpoint was found.
+};
+
+//! @brief Status of a NAND operation, returned by the #ftl_nand_t functions.
+enum _ftl_nand_status
+{
+    kFtlNandSuccess = 0,    //!< The operation completed.
+    kFtlNandCorrected = 1,  //!< The read needed enough corrections that the page should be rewritten.
+    kFtlNandEccError = 2,   //!< The read data is uncorrectable.
+    kFtlNandFailed = 3      //!< The program or erase failed, or the NAND did not respond.
+};
+
+//! @brief Contents of a page, stored in ftl_spare_t::type.
+enum _ftl_page_type
+{
+    kFtlPageData = 0x01,        //!< A logical page, ftl_spare_t::id is its number.
+    kFtlPageMap = 0x02,         //!< A map page, ftl_spare_t::id is its index.
+    kFtlPageCheckpoint = 0x03,  //!< Checkpoint data, ftl_spare_t::id is the page within the checkpoint.
+    kFtlPageCommit = 0x04,      //!< Last checkpoint page, ending with the commit record.
+    kFtlPageErased = 0xff       //!< The page is erased.
+};
+
+//! @brief Metadata the FTL stores with every page.
+//!
+//! The NAND functions keep it in the ECC protected spare area, in #FTL_SPARE_BYTES bytes. A
+//! read of an erased page returns #kFtlPageErased in @a type.
+typedef struct _ftl_spare {
+    uint8_t type;           //!< One of #_ftl_page_type.
+    uint32_t id;            //!< Depends on @a type.
+    uint32_t sequence;      //!< Order in which the pages were written.
+} ftl_spare_t;
+
+//! @brief Raw NAND access for an FTL.
+//!
+//! Pages are numbered from the start of the device, page @a n being page
+//! n % pagesPerBlock of block n / pagesPerBlock. The functions return one of
+//! #_ftl_nand_status.
+typedef struct _ftl_nand {
+    uint32_t pageSize;          //!< Data bytes of a page.
+    uint32_t pagesPerBlock;     //!< Pages of an erase block.
+    uint32_t blockCount;        //!< Erase blocks of the device.
+
+    //! @brief Read the data and spare area of a page.
+    //!
+    //! @a data is NULL when only the spare area is needed.
+    int (*read)(const struct _ftl_nand * nand, uint32_t page, void * data, ftl_spare_t * spare);
+
+    //! @brief Program the data and spare area of an erased page.
+    int (*program)(const struct _ftl_nand * nand, uint32_t page, const void * data, const ftl_spare_t * spare);
+
+    //! @brief Erase a block.
+    int (*erase)(const struct _ftl_nand * nand, uint32_t block);
+
+    //! @brief Whether a block carries a bad block marker.
+    bool (*isBad)(const struct _ftl_nand * nand, uint32_t block);
+
+    //! @brief Put a bad block marker on a block, erasing whatever it holds.
+    void (*markBad)(const struct _ftl_nand * nand, uint32_t block);
+
+    void * context;             //!< For use by the functions.
+} ftl_nand_t;
+
+//! @brief Tunables of an FTL, used by ftl_format() and ftl_mount().
+typedef struct _ftl_config {
+    uint32_t mapCachePages;         //!< Map pages cached in RAM, at least 2, most of the map for random writes.
+    uint32_t reservePercent;        //!< Share of the good blocks not exported, used by ftl_format().
+    uint32_t checkpointInterval;    //!< Blocks written between checkpoints.
+    uint32_t backgroundFreeBlocks;  //!< ftl_background() reclaims blocks until this many are free.
+    uint32_t wearLevelThreshold;    //!< Erase count spread at which cold data is moved, 0 for never.
+} ftl_config_t;
+
+//! @brief Statistics of an FTL, in pages unless noted otherwise.
+typedef struct _ftl_stats {
+    uint32_t hostReads;         //!< Logical pages read.
+    uint32_t hostWrites;        //!< Logical pages written.
+    uint32_t nandReads;         //!< Physical page and spare reads.
+    uint32_t nandWrites;        //!< Physical pages programmed, for all purposes.
+    uint32_t erases;            //!< Blocks erased.
+    uint32_t gcCopies;          //!< Valid pages moved by garbage collection and wear leveling.
+    uint32_t gcBlocks;          //!< Blocks reclaimed.
+    uint32_t wearLevelBlocks;   //!< Blocks reclaimed to move cold data.
+    uint32_t refreshBlocks;     //!< Blocks reclaimed because of corrected bit errors.
+    uint32_t mapReads;          //!< Map pages loaded into the cache.
+    uint32_t mapWrites;         //!< Map pages written back from the cache.
+    uint32_t checkpoints;       //!< Checkpoints written.
+    uint32_t badBlocks;         //!< Blocks retired since mounting.
+    uint32_t eccErrors;         //!< Uncorrectable reads.
+    uint32_t mountReads;        //!< NAND reads of the last mount.
+    uint32_t replayedPages;     //!< Pages replayed by the last mount.
+} ftl_stats_t;
+
+//! @brief A cached map page.
+typedef struct _ftl_map_slot {
+    uint32_t index;             //!< Map page held, or #FTL_UNMAPPED.
+    uint32_t lastUse;           //!< Age for replacement.
+    uint32_t changedEntries;    //!< Entries changed since the map page was written, dirty if any.
+    uint32_t * changed;         //!< Bitmap of the changed entries.
+    uint32_t * entries;         //!< Physical page of each logical page of the map page.
+} ftl_map_slot_t;
+
+//! @brief A mounted FTL.
+//!
+//! Owned by the caller. ftl_format() or ftl_mount() fill it in and allocate its tables,
+//! ftl_unmount() frees them again.
+typedef struct _ftl {
+    const ftl_nand_t * nand;        //!< The NAND.
+    ftl_config_t config;            //!< Tunables.
+    uint32_t logicalPages;          //!< Exported capacity in pages.
+    uint32_t mapPages;              //!< Number of map pages.
+    uint32_t entriesPerMapPage;     //!< Logical pages covered by a map page.
+    uint32_t * directory;           //!< Physical page of each map page.
+    uint16_t * validCount;          //!< Valid pages of each block.
+    uint32_t * eraseCount;          //!< Erase count of each block.
+    uint8_t * blockState;           //!< State and flags of each block.
+    ftl_map_slot_t * cache;         //!< Cached map pages.
+    uint32_t cacheClock;            //!< Source of ftl_map_slot_t::lastUse.
+    uint8_t * pageBuffer;           //!< Page sized buffer for copies and checkpoints.
+    uint32_t sequence;              //!< Sequence number of the next page written.
+    uint32_t checkpointSequence;    //!< Sequence number at the last checkpoint.
+    uint32_t activeBlock;           //!< Block the log is written to.
+    uint32_t activePage;            //!< Next page of the active block.
+    uint32_t checkpointBlock;       //!< Block holding the last checkpoint.
+    uint32_t checkpointPage;        //!< Next page of the checkpoint block.
+    uint32_t freeBlocks;            //!< Blocks that can be allocated.
+    uint32_t pendingBlocks;         //!< Reclaimed blocks that become free at the next checkpoint.
+    uint32_t blocksSinceCheckpoint; //!< Blocks allocated since the last checkpoint.
+    bool isReplaying;               //!< Mounting replays the log, blocks are not freed yet.
+    ftl_stats_t stats;              //!< Statistics.
+} ftl_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @brief Fill in the default tunables.
+void ftl_get_default_config(ftl_config_t * config);
+
+//! @brief Erase the device and mount an empty FTL on it.
+//!
+//! Blocks carrying a bad block marker are left alone. The first checkpoint is written before
+//! this returns.
+//!
+//! @param ftl The FTL to fill in.
+//! @param nand The NAND, which must stay valid while mounted.
+//! @param config Tunables, or NULL for the defaults.
+//! @retval #kFtlSuccess The FTL is mounted.
+//! @retval #kFtlInvalid The geometry is unsupported or the device has too few good blocks.
+//! @retval #kFtlError No checkpoint could be written.
+int ftl_format(ftl_t * ftl, const ftl_nand_t * nand, const ftl_config_t * config);
+
+//! @brief Mount the FTL on a formatted device.
+//!
+//! The newest checkpoint is loaded and the pages written after it are replayed. If there
+//! were any, a new checkpoint is written.
+//!
+//! @param ftl The FTL to fill in.
+//! @param nand The NAND, which must stay valid while mounted.
+//! @param config Tunables, or NULL for the defaults. ftl_config_t::reservePercent is ignored.
+//! @retval #kFtlSuccess The FTL is mounted.
+//! @retval #kFtlInvalid The map cache is smaller than the journaled map pages of the checkpoint.
+//! @retval #kFtlNotFormatted No valid checkpoint was found.
+//! @retval #kFtlError A read or the checkpoint failed.
+int ftl_mount(ftl_t * ftl, const ftl_nand_t * nand, const ftl_config_t * config);
+
+//! @brief Write a checkpoint if anything changed and free the tables.
+int ftl_unmount(ftl_t * ftl);
+
+//! @brief Read logical pages.
+//!
+//! Pages that were never written read as 0xff bytes.
+//!
+//! @retval #kFtlSuccess All pages were read.
+//! @retval #kFtlInvalid The range is beyond the end of the FTL.
+//! @retval #kFtlError A page could not be read. The other pages are still read.
+int ftl_read(ftl_t * ftl, uint32_t page, uint32_t count, void * buffer);
+
+//! @brief Write logical pages.
+//!
+//! The pages are on the NAND when this returns and survive a power loss without a
+//! checkpoint.
+//!
+//! @retval #kFtlSuccess All pages were written.
+//! @retval #kFtlInvalid The range is beyond the end of the FTL.
+//! @retval #kFtlNoSpace No block could be reclaimed.
+//! @retval #kFtlError The NAND failed.
+int ftl_write(ftl_t * ftl, uint32_t page, uint32_t count, const void * buffer);
+
+//! @brief Write a checkpoint if anything changed since the last one.
+//!
+//! This only shortens the next mount, written data is durable without it.
+int ftl_sync(ftl_t * ftl);
+
+//! @brief Do one step of background work.
+//!
+//! Reclaims one block, preferring blocks with corrected bit errors, then the least worn block
+//! if the erase counts spread too far, then the block with the fewest valid pages while fewer
+//! than ftl_config_t::backgroundFreeBlocks blocks are free. Reclaimed blocks are freed by a
+//! checkpoint. Call it while the FTL is otherwise idle, for instance from a work queue.
+//!
+//! @retval true Work was done and there may be more.
+//! @retval false There is nothing left to do.
+bool ftl_background(ftl_t * ftl);
+
+//! @brief Set up a block device for a request queue on top of the FTL.
+//!
+//! Sectors are logical pages. Requests complete before the submit function returns.
+//!
+//! @param device Filled in with the device description.
+//! @param ftl A mounted FTL.
+void ftl_blk_device_init(blk_device_t * device, ftl_t * ftl);
+
+#if defined(__cplusplus)
+}
+#endif
+
+//! @}
+
+#endif // __NAND_FTL_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#if !defined(__SCHEDULER_H__)
+#define __SCHEDULER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//! @addtogroup scheduler
+//! @{
+
+/*!
+ * @file scheduler.h
+ * @brief Work-stealing task scheduler for multicore applications.
+ *
+ * Each core runs a worker with its own double-ended queue of tasks. A worker pushes and pops
+ * tasks at the bottom of its own queue without any locking, and idle workers steal from the
+ * top of the other queues (Chase-Lev). Workers that find nothing to do sleep in WFI until a
+ * new task is spawned, which wakes them with the software interrupt #SCHEDULER_SGI.
+ *
+ * Tasks are grouped in task_group_t objects for fork-join parallelism: spawn tasks into a
+ * group, then wait for the group, helping to run tasks while waiting. parallel_for() builds a
+ * recursively split loop on top of this.
+ *
+ * The scheduler uses the functions of atomics.h. Built for Linux, it runs each worker in
+ * a POSIX thread instead of a core, so it can be tested and benchmarked on a host.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Maximum number of workers.
+#if !defined(SCHEDULER_MAX_WORKERS)
+#define SCHEDULER_MAX_WORKERS (4)
+#endif
+
+//! @brief Number of tasks each worker queue holds, a power of two.
+//!
+//! A task spawned into a full queue is run immediately by the spawning worker.
+#if !defined(SCHEDULER_QUEUE_SIZE)
+#define SCHEDULER_QUEUE_SIZE (256)
+#endif
+
+//! @brief Software interrupt used to wake sleeping workers, SW_INTERRUPT_13 by default.
+#if !defined(SCHEDULER_SGI)
+#define SCHEDULER_SGI (13)
+#endif
+
+//! @brief Function run by a task.
+typedef void (*task_function_t)(void * arg);
+
+//! @brief Body of a parallel_for() loop, called for the range [@a begin, @a end).
+typedef void (*parallel_for_body_t)(uint32_t begin, uint32_t end, void * arg);
+
+//! @brief Per-core setup run by each worker before it starts taking tasks.
+//!
+//! Used to enable the caches and join SMP on secondary cores, without which they are not
+//! coherent with the other cores. Called with the worker's core number.
+typedef void (*scheduler_cpu_init_t)(uint32_t cpu);
+
+//! @brief A set of tasks that can be waited for together.
+typedef struct _task_group {
+    volatile int32_t pending;   //!< Number of tasks spawned into the group that have not finished.
+} task_group_t;
+
+//! @brief Statistics of one worker.
+typedef struct _scheduler_stats {
+    uint32_t executed;  //!< Tasks run by the worker.
+    uint32_t stolen;    //!< Tasks the worker stole from other queues.
+    uint32_t stealAttempts; //!< Attempts to steal, successful or not.
+    uint32_t inlined;   //!< Tasks run at spawn time because the queue was full.
+    uint32_t sleeps;    //!< Times the worker went to sleep for lack of tasks.
+} scheduler_stats_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @name Scheduler
+//@{
+//! @brief Start the workers.
+//!
+//! Must be called on core 0, or the main thread on a host, which becomes worker 0 and runs
+//! tasks whenever it waits for a task group. The other workers are started on cores 1 to
+//! @a workerCount - 1 with cpu_start_secondary(), or as threads on a host.
+//!
+//! On the target, interrupts must already be enabled on core 0, as platform_init() does.
+//!
+//! @param workerCount Number of workers, limited to #SCHEDULER_MAX_WORKERS and on the target
+//!     to the number of cores.
+//! @param cpuInit Function each worker calls on its own core before it takes any task, or
+//!     NULL. Worker 0 calls it from scheduler_start().
+//! @return The number of workers started, including the calling one.
+uint32_t scheduler_start(uint32_t workerCount, scheduler_cpu_init_t cpuInit);
+
+//! @brief Stop the workers started by scheduler_start().
+//!
+//! All task groups must have been waited for. On the target the secondary cores are put
+//! back into reset.
+void scheduler_stop(void);
+
+//! @brief Returns the index of the worker running the caller.
+uint32_t scheduler_current_worker(void);
+
+//! @brief Read and clear the statistics of a worker.
+void scheduler_get_stats(uint32_t worker, scheduler_stats_t * stats);
+//@}
+
+//! @name Tasks
+//@{
+//! @brief Prepare a task group for use.
+void task_group_init(task_group_t * group);
+
+//! @brief Spawn a task into a group.
+//!
+//! The task is pushed onto the queue of the calling worker, where other workers can steal it.
+//! @a arg must stay valid until the group has been waited for. Must be called from a worker.
+//!
+//! @param group The group the task belongs to.
+//! @param function Function to run.
+//! @param arg Argument passed to @a function.
+void task_spawn(task_group_t * group, task_function_t function, void * arg);
+
+//! @brief Wait until all tasks of a group have finished.
+//!
+//! The caller runs queued tasks, its own or stolen ones, while it waits, so waiting never
+//! blocks a worker. Must be called from a worker.
+void task_group_wait(task_group_t * group);
+
+//! @brief Run a loop body in parallel over a range.
+//!
+//! The range is split in halves recursively until pieces are at most @a grain long, and the
+//! pieces run as tasks. Returns once @a body has been called for every piece.
+//!
+//! @param begin First index.
+//! @param end Index past the last one.
+//! @param grain Largest range passed to a single call of @a body, at least 1.
+//! @param body Function called for each piece.
+//! @param arg Argument passed to @a body.
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, parallel_for_body_t body, void * arg);
+//@}
+
+#if defined(__cplusplus)
+}
+#endif
+
+//! @}
+
+#endif // __SCHEDULER_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#if !defined(__SMP_MALLOC_H__)
+#define __SMP_MALLOC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//! @addtogroup smp_malloc
+//! @{
+
+/*!
+ * @file smp_malloc.h
+ * @brief Multicore heap allocator that replaces newlib's malloc.
+ *
+ * Requests up to #SMP_MALLOC_MAX_SMALL_SIZE bytes are rounded up to one of a set of size
+ * classes, all multiples of the 32 byte cache line. Each core keeps a small cache of free
+ * blocks per class, so most malloc() and free() calls touch no shared data. The caches are
+ * refilled from, and drained to, a central depot protected by a spinlock. The depot carves
+ * blocks out of 64KB spans of the heap. Larger requests take runs of whole spans directly.
+ *
+ * Because classes are multiples of the cache line and spans are aligned, every block starts
+ * on a cache line and no two blocks share one, so any block can be used as a DMA buffer.
+ *
+ * Interrupts are masked while the allocator runs, so it can be called from interrupt
+ * handlers.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Set to 1 to provide malloc(), free() and the other newlib allocation functions.
+//!
+//! Defaults to 1 except in Linux builds, where the allocator is tested under its own names.
+#if !defined(SMP_MALLOC_REPLACE_LIBC)
+#if defined(__linux__)
+#define SMP_MALLOC_REPLACE_LIBC (0)
+#else
+#define SMP_MALLOC_REPLACE_LIBC (1)
+#endif
+#endif
+
+//! @brief Number of cores with a block cache.
+#define SMP_MALLOC_MAX_CPUS (4)
+
+//! @brief Size and alignment of the spans the heap is divided into.
+#define SMP_MALLOC_SPAN_SIZE (0x10000)
+
+//! @brief Largest request served from a size class.
+#define SMP_MALLOC_MAX_SMALL_SIZE (8192)
+
+//! @brief Number of size classes.
+#define SMP_MALLOC_CLASS_COUNT (28)
+
+//! @brief Allocation statistics.
+typedef struct _smp_malloc_stats {
+    uint32_t heapSize;          //!< Bytes of the heap region.
+    uint32_t heapUsed;          //!< Bytes of spans taken from the heap region so far.
+    uint32_t bytesInUse;        //!< Bytes of allocated blocks, rounded up to their class or span run.
+    uint32_t blocksInUse;       //!< Number of allocated blocks.
+    uint32_t mallocs;           //!< Successful allocations.
+    uint32_t frees;             //!< Blocks freed.
+    uint32_t cacheHits;         //!< Small allocations served from the core's own cache.
+    uint32_t depotTransfers;    //!< Batches moved between the core caches and the depot.
+    uint32_t largeMallocs;      //!< Allocations served with span runs.
+    uint32_t failures;          //!< Allocations that failed for lack of memory.
+    uint32_t classBlocksInUse[SMP_MALLOC_CLASS_COUNT]; //!< Allocated blocks of each size class.
+} smp_malloc_stats_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @brief Give the allocator its heap.
+//!
+//! On the target the first allocation does this with the heap the linker script defines
+//! between free_memory_start and free_memory_end, so there is no need to call it.
+//!
+//! @param start First byte of the heap.
+//! @param end Byte past the end of the heap.
+void smp_malloc_init(void * start, void * end);
+
+//! @brief Allocate @a size bytes, aligned to a cache line.
+//! @return The block, or NULL if the heap is exhausted.
+void * smp_malloc(size_t size);
+
+//! @brief Free a block returned by any of the allocation functions. NULL is ignored.
+void smp_free(void * ptr);
+
+//! @brief Resize a block, moving it if it does not fit in place.
+void * smp_realloc(void * ptr, size_t size);
+
+//! @brief Allocate a zeroed array of @a count elements of @a size bytes.
+void * smp_calloc(size_t count, size_t size);
+
+//! @brief Allocate @a size bytes aligned to @a align, a power of two.
+void * smp_memalign(size_t align, size_t size);
+
+//! @brief Returns the number of bytes that can be used in a block.
+size_t smp_malloc_usable_size(void * ptr);
+
+//! @brief Get the allocation statistics, summed over all cores.
+void smp_malloc_get_stats(smp_malloc_stats_t * stats);
+
+//! @brief Print the allocation statistics.
+void smp_malloc_print_stats(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+//! @}
+
+#endif // __SMP_MALLOC_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
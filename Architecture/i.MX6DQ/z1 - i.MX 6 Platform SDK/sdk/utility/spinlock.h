@@ -57,6 +57,77 @@ enum _spinlock_timeouts
     kSpinlockWaitForever = 0xffffffff
 };
 
+//! @brief Set to 1 to collect statistics in the ticket, MCS and reader-writer locks.
+//!
+//! This changes the size of the lock types, so the SDK library and the application must be
+//! built with the same value. mk/config.mk passes the SPINLOCK_STATS make variable.
+#if !defined(SPINLOCK_STATS)
+#define SPINLOCK_STATS (0)
+#endif
+
+//! @brief Number of CPUs that can queue on an MCS lock.
+#define SPINLOCK_MAX_CPUS (4)
+
+//! @brief Contention statistics of a lock, present when #SPINLOCK_STATS is 1.
+typedef struct _spinlock_stats {
+    uint32_t acquisitions;  //!< Number of times the lock was taken.
+    uint32_t contentions;   //!< Acquisitions that had to wait.
+    uint32_t spins;         //!< Total number of wait loop iterations.
+    uint32_t maxHoldTime;   //!< Longest time the lock was held, in microseconds. Writers only for rw locks.
+    uint64_t lockTime;      //!< Time the current holder took the lock.
+} spinlock_stats_t;
+
+//! @brief Address of the statistics of a ticket, MCS or reader-writer lock, or NULL if
+//!     #SPINLOCK_STATS is 0.
+#if SPINLOCK_STATS
+#define SPINLOCK_STATS_OF(lock) (&(lock)->stats)
+#else
+#define SPINLOCK_STATS_OF(lock) ((const spinlock_stats_t *)0)
+#endif
+
+//! @brief FIFO spinlock.
+//!
+//! Each locker takes a ticket and waits until it is served, so the lock is granted in
+//! the order it was requested.
+typedef struct _ticket_lock {
+    volatile uint32_t next;     //!< Next ticket to hand out.
+    volatile uint32_t owner;    //!< Ticket of the current holder.
+#if SPINLOCK_STATS
+    spinlock_stats_t stats;     //!< Statistics.
+#endif
+} ticket_lock_t __attribute__ ((aligned (32)));
+
+//! @brief Queue node of one CPU for an MCS lock.
+typedef struct _mcs_node {
+    volatile uint32_t next;         //!< Number plus one of the CPU queued behind this one, or 0.
+    volatile uint32_t isWaiting;    //!< Cleared by the previous holder to hand the lock over.
+    uint32_t _cacheLineFiller[6];   //!< Padding so each CPU spins on its own cache line.
+} mcs_node_t __attribute__ ((aligned (32)));
+
+//! @brief MCS queue spinlock.
+//!
+//! Waiters form a queue and each spins on its own node, so a release only touches the
+//! cache line of the next waiter. The lock is granted in FIFO order.
+typedef struct _mcs_lock {
+    volatile uint32_t tail;         //!< Number plus one of the last CPU in the queue, or 0 if unlocked.
+    uint32_t _cacheLineFiller[7];   //!< Padding to keep the tail off the node cache lines.
+    mcs_node_t nodes[SPINLOCK_MAX_CPUS];    //!< Queue node of each CPU.
+#if SPINLOCK_STATS
+    spinlock_stats_t stats;         //!< Statistics.
+#endif
+} mcs_lock_t __attribute__ ((aligned (32)));
+
+//! @brief Reader-writer spinlock.
+//!
+//! Any number of readers or a single writer can hold the lock. A waiting writer keeps new
+//! readers out, so writers are not starved.
+typedef struct _rw_spinlock {
+    volatile uint32_t state;    //!< Reader count, plus the writer and writer waiting bits.
+#if SPINLOCK_STATS
+    spinlock_stats_t stats;     //!< Statistics. Reader acquisitions are counted atomically.
+#endif
+} rw_spinlock_t __attribute__ ((aligned (32)));
+
 ////////////////////////////////////////////////////////////////////////////////
 // Code
 ////////////////////////////////////////////////////////////////////////////////
@@ -108,6 +179,119 @@ void spinlock_unlock(spinlock_t * lock);
 //! @param lock Pointer to the spinlock to test.
 bool spinlock_is_locked(spinlock_t * lock);
 
+//! @brief Lock a spinlock, backing off between attempts.
+//!
+//! Works like spinlock_lock(), and the lock is released with spinlock_unlock(). Instead of
+//! retrying as soon as the lock is seen free, the delay between attempts doubles after every
+//! failed one, up to a limit. This keeps the waiters from hammering the lock's cache line
+//! when it is heavily contended.
+//!
+//! @param lock Pointer to the spinlock to lock.
+//! @param timeout Maximum number of microseconds to wait, or #kSpinlockNoWait or
+//!     #kSpinlockWaitForever.
+//!
+//! @retval 0 The spinlock was locked successfully.
+//! @retval 1 A timeout occurred while waiting for the spinlock to be unlocked.
+int spinlock_trylock_backoff(spinlock_t * lock, uint32_t timeout);
+
+//@}
+
+//! @name Ticket lock API
+//!
+//! A ticket cannot be given back, so there is no timeout. Use ticket_lock_trylock() to avoid
+//! waiting.
+//@{
+
+//! @brief Initialize a ticket lock in the unlocked state.
+void ticket_lock_init(ticket_lock_t * lock);
+
+//! @brief Lock a ticket lock, waiting for the callers that came before.
+void ticket_lock_lock(ticket_lock_t * lock);
+
+//! @brief Lock a ticket lock only if it is free.
+//! @retval true The lock was taken.
+//! @retval false The lock is held or has waiters.
+bool ticket_lock_trylock(ticket_lock_t * lock);
+
+//! @brief Unlock a ticket lock, handing it to the next waiter.
+void ticket_lock_unlock(ticket_lock_t * lock);
+
+//! @brief Check whether a ticket lock is currently locked.
+bool ticket_lock_is_locked(ticket_lock_t * lock);
+
+//@}
+
+//! @name MCS lock API
+//!
+//! Each CPU has a queue node in the lock, so a CPU must not try to take an MCS lock it
+//! already holds, for instance from an interrupt handler.
+//@{
+
+//! @brief Initialize an MCS lock in the unlocked state.
+void mcs_lock_init(mcs_lock_t * lock);
+
+//! @brief Lock an MCS lock, waiting for the CPUs queued before.
+void mcs_lock_lock(mcs_lock_t * lock);
+
+//! @brief Lock an MCS lock only if it is free.
+//! @retval true The lock was taken.
+//! @retval false The lock is held.
+bool mcs_lock_trylock(mcs_lock_t * lock);
+
+//! @brief Unlock an MCS lock, handing it to the next CPU in the queue.
+void mcs_lock_unlock(mcs_lock_t * lock);
+
+//! @brief Check whether an MCS lock is currently locked.
+bool mcs_lock_is_locked(mcs_lock_t * lock);
+
+//@}
+
+//! @name Reader-writer lock API
+//@{
+
+//! @brief Initialize a reader-writer lock in the unlocked state.
+void rw_spinlock_init(rw_spinlock_t * lock);
+
+//! @brief Take a reader-writer lock for reading.
+//!
+//! Waits while a writer holds the lock or waits for it.
+void rw_spinlock_read_lock(rw_spinlock_t * lock);
+
+//! @brief Take a reader-writer lock for reading only if no writer holds it or waits for it.
+//! @retval true The lock was taken for reading.
+//! @retval false A writer holds or waits for the lock.
+bool rw_spinlock_read_trylock(rw_spinlock_t * lock);
+
+//! @brief Release a reader-writer lock taken for reading.
+void rw_spinlock_read_unlock(rw_spinlock_t * lock);
+
+//! @brief Take a reader-writer lock for writing.
+//!
+//! Waits until the current readers and writer are done.
+void rw_spinlock_write_lock(rw_spinlock_t * lock);
+
+//! @brief Take a reader-writer lock for writing only if it is free.
+//! @retval true The lock was taken for writing.
+//! @retval false The lock has readers or a writer.
+bool rw_spinlock_write_trylock(rw_spinlock_t * lock);
+
+//! @brief Release a reader-writer lock taken for writing.
+void rw_spinlock_write_unlock(rw_spinlock_t * lock);
+
+//@}
+
+//! @name Statistics
+//@{
+
+//! @brief Print the statistics of a lock.
+//!
+//! Does nothing unless #SPINLOCK_STATS is 1.
+//!
+//! @param name Name printed with the statistics.
+//! @param stats Statistics of a ticket, MCS or reader-writer lock, as returned by
+//!     #SPINLOCK_STATS_OF.
+void spinlock_print_stats(const char * name, const spinlock_stats_t * stats);
+
 //@}
 
 #if defined(__cplusplus)
@@ -0,0 +1,661 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file block_queue.c
+ * @brief Request queue with merging and a deadline elevator.
+ *
+ * Submitted bios and completed requests are pushed onto lock-free stacks. Whoever calls
+ * blk_queue_run() first becomes the runner and has the waiting lists, the free requests and
+ * the statistics to itself; callers that find the queue running only flag it to be run
+ * again. The runner turns bios into requests in arrival order, so the arrival sequence of a
+ * request is also the order in which overlapping transfers must reach the device.
+ */
+
+#if defined(__linux__)
+#include <stddef.h>
+#else
+#include "sdk.h"
+#include "timer/timer.h"
+#endif
+#include "utility/atomics.h"
+#include "utility/block_queue.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__linux__)
+// Host builds, where the application provides time_get_microseconds().
+uint64_t time_get_microseconds(void);
+
+#define BLK_BARRIER() __sync_synchronize()
+#define BLK_POINTER_CAS(p, o, n) __sync_bool_compare_and_swap((p), (o), (n))
+#else
+//! @brief Memory barrier between the cores.
+#define BLK_BARRIER() __asm__ volatile ("dmb" : : : "memory")
+
+//! @brief Compare and swap of a pointer, which is a word on the target.
+#define BLK_POINTER_CAS(p, o, n) \
+    atomic_compare_and_swap((volatile uint32_t *)(p), (uint32_t)(o), (uint32_t)(n))
+#endif
+
+//! @brief Values of blk_queue_t::runState.
+enum _blk_run_state
+{
+    kBlkIdle = 0,       //!< Nobody runs the queue.
+    kBlkRunning = 1,    //!< A runner is processing the queue.
+    kBlkRerun = 2       //!< Work arrived while running, the runner has to go round once more.
+};
+
+//! @brief State of a caller waiting in blk_transfer().
+typedef struct _blk_waiter {
+    volatile uint32_t isDone;
+    int status;
+} blk_waiter_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Become the runner, or make the current runner go round once more.
+static bool blk_enter(blk_queue_t * queue)
+{
+    for (;;)
+    {
+        uint32_t state = queue->runState;
+        if (state == kBlkIdle)
+        {
+            if (atomic_compare_and_swap(&queue->runState, kBlkIdle, kBlkRunning))
+            {
+                return true;
+            }
+        }
+        else if ((state & kBlkRerun) || atomic_compare_and_swap(&queue->runState, state, state | kBlkRerun))
+        {
+            return false;
+        }
+    }
+}
+
+//! @brief Stop being the runner, unless another caller asked for one more round.
+static bool blk_leave(blk_queue_t * queue)
+{
+    for (;;)
+    {
+        if (atomic_compare_and_swap(&queue->runState, kBlkRunning, kBlkIdle))
+        {
+            return true;
+        }
+        if (atomic_compare_and_swap(&queue->runState, kBlkRunning | kBlkRerun, kBlkRunning))
+        {
+            return false;
+        }
+    }
+}
+
+//! @brief Whether two transfers must reach the device in their arrival order.
+static bool blk_is_hazard(blk_op_t op1, uint32_t sector1, uint32_t count1,
+                          blk_op_t op2, uint32_t sector2, uint32_t count2)
+{
+    return (op1 == kBlkWrite || op2 == kBlkWrite)
+        && sector1 < sector2 + count2 && sector2 < sector1 + count1;
+}
+
+//! @brief Whether a bio overlaps a request that is waiting or at the device.
+static bool blk_bio_conflicts(blk_queue_t * queue, blk_bio_t * bio)
+{
+    blk_request_t * lists[2] = { queue->pending, queue->active };
+    uint32_t i;
+
+    for (i = 0; i < 2; ++i)
+    {
+        blk_request_t * request;
+        for (request = lists[i]; request; request = request->next)
+        {
+            if (blk_is_hazard(bio->op, bio->sector, bio->count, request->op, request->sector, request->count))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//! @brief Whether a waiting request has to wait for an older overlapping one.
+static bool blk_request_is_blocked(blk_queue_t * queue, blk_request_t * request)
+{
+    blk_request_t * other;
+
+    for (other = queue->active; other; other = other->next)
+    {
+        if (blk_is_hazard(request->op, request->sector, request->count, other->op, other->sector, other->count))
+        {
+            return true;
+        }
+    }
+    for (other = queue->pending; other; other = other->next)
+    {
+        if ((int32_t)(other->sequence - request->sequence) < 0
+            && blk_is_hazard(request->op, request->sector, request->count, other->op, other->sector, other->count))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//! @brief Add a request to the waiting list, in the order the elevator wants.
+static void blk_insert(blk_queue_t * queue, blk_request_t * request)
+{
+    blk_request_t ** link = &queue->pending;
+
+    if (queue->elevator == kBlkElevatorDeadline)
+    {
+        while (*link && (*link)->sector <= request->sector)
+        {
+            link = &(*link)->next;
+        }
+    }
+    else
+    {
+        while (*link)
+        {
+            link = &(*link)->next;
+        }
+    }
+    request->next = *link;
+    *link = request;
+}
+
+//! @brief Remove a request from a list.
+static void blk_unlink(blk_request_t ** list, blk_request_t * request)
+{
+    while (*list != request)
+    {
+        list = &(*list)->next;
+    }
+    *list = request->next;
+}
+
+//! @brief Call the callback of a bio and account for it.
+static void blk_finish_bio(blk_queue_t * queue, blk_bio_t * bio, int status, uint64_t now)
+{
+    uint32_t latency = (uint32_t)(now - bio->submitTime);
+
+    queue->stats.totalLatency += latency;
+    if (latency > queue->stats.maxLatency)
+    {
+        queue->stats.maxLatency = latency;
+    }
+    if (status != kBlkSuccess)
+    {
+        ++queue->stats.errors;
+    }
+
+    bio->callback(bio, status);
+    atomic_decrement(&queue->outstanding);
+}
+
+//! @brief Merge a bio into a waiting request, or give it a request of its own.
+//!
+//! @retval false No request is free; the bio stays in the backlog.
+static bool blk_place(blk_queue_t * queue, blk_bio_t * bio, uint64_t now)
+{
+    blk_device_t * device = queue->device;
+    blk_request_t * request;
+
+    if (bio->count == 0 || bio->count > device->maxSectors
+        || (device->sectorCount && (bio->sector >= device->sectorCount
+                                    || bio->count > device->sectorCount - bio->sector)))
+    {
+        blk_finish_bio(queue, bio, kBlkInvalid, now);
+        return true;
+    }
+
+    // Merging would move the bio ahead of older transfers it overlaps.
+    if (!blk_bio_conflicts(queue, bio))
+    {
+        for (request = queue->pending; request; request = request->next)
+        {
+            if (request->op != bio->op || request->count + bio->count > device->maxSectors
+                || (device->maxSegments && request->segments >= device->maxSegments))
+            {
+                continue;
+            }
+
+            if (request->sector + request->count == bio->sector)
+            {
+                bio->next = NULL;
+                request->lastBio->next = bio;
+                request->lastBio = bio;
+                request->count += bio->count;
+                ++request->segments;
+                ++queue->stats.backMerges;
+                return true;
+            }
+
+            if (bio->sector + bio->count == request->sector)
+            {
+                bio->next = request->bios;
+                request->bios = bio;
+                request->sector = bio->sector;
+                request->count += bio->count;
+                ++request->segments;
+                ++queue->stats.frontMerges;
+
+                // The request starts lower now.
+                if (queue->elevator == kBlkElevatorDeadline)
+                {
+                    blk_unlink(&queue->pending, request);
+                    blk_insert(queue, request);
+                }
+                return true;
+            }
+        }
+    }
+
+    request = queue->freeRequests;
+    if (!request)
+    {
+        return false;
+    }
+    queue->freeRequests = request->next;
+
+    bio->next = NULL;
+    request->op = bio->op;
+    request->sector = bio->sector;
+    request->count = bio->count;
+    request->segments = 1;
+    request->bios = bio;
+    request->lastBio = bio;
+    request->sequence = queue->sequence++;
+    request->deadline = now + (bio->op == kBlkWrite ? queue->writeExpire : queue->readExpire);
+    request->status = kBlkSuccess;
+    request->driverData = NULL;
+    blk_insert(queue, request);
+    return true;
+}
+
+//! @brief Move the submitted bios to the backlog, in submission order, and place them.
+static void blk_take_incoming(blk_queue_t * queue, uint64_t now)
+{
+    blk_bio_t * list;
+    do {
+        list = queue->incoming;
+    } while (list && !BLK_POINTER_CAS(&queue->incoming, list, NULL));
+
+    // The stack has the newest bio first.
+    blk_bio_t * reversed = NULL;
+    blk_bio_t * last = list;
+    while (list)
+    {
+        blk_bio_t * next = list->next;
+        list->next = reversed;
+        reversed = list;
+        list = next;
+        ++queue->stats.bios;
+    }
+
+    if (reversed)
+    {
+        if (queue->backlogTail)
+        {
+            queue->backlogTail->next = reversed;
+        }
+        else
+        {
+            queue->backlog = reversed;
+        }
+        queue->backlogTail = last;
+    }
+
+    while (queue->backlog)
+    {
+        blk_bio_t * bio = queue->backlog;
+        blk_bio_t * next = bio->next;
+
+        if (!blk_place(queue, bio, now))
+        {
+            break;
+        }
+        queue->backlog = next;
+        if (!next)
+        {
+            queue->backlogTail = NULL;
+        }
+    }
+}
+
+//! @brief Complete the bios of the requests the device finished, and free the requests.
+static void blk_take_completed(blk_queue_t * queue, uint64_t now)
+{
+    blk_request_t * list;
+    do {
+        list = queue->completed;
+    } while (list && !BLK_POINTER_CAS(&queue->completed, list, NULL));
+
+    while (list)
+    {
+        blk_request_t * request = list;
+        blk_bio_t * bio = request->bios;
+        int status = request->status;
+        list = request->nextCompleted;
+
+        blk_unlink(&queue->active, request);
+        if (--queue->inFlight == 0)
+        {
+            queue->stats.busyTime += now - queue->busyStart;
+        }
+        if (status == kBlkSuccess)
+        {
+            if (request->op == kBlkWrite)
+            {
+                queue->stats.sectorsWritten += request->count;
+            }
+            else
+            {
+                queue->stats.sectorsRead += request->count;
+            }
+        }
+
+        request->next = queue->freeRequests;
+        queue->freeRequests = request;
+
+        // A callback may submit the bio again, which changes its link.
+        while (bio)
+        {
+            blk_bio_t * next = bio->next;
+            blk_finish_bio(queue, bio, status, now);
+            bio = next;
+        }
+    }
+}
+
+//! @brief Choose the next request for the device.
+static blk_request_t * blk_pick(blk_queue_t * queue, uint64_t now)
+{
+    blk_request_t * request;
+    blk_request_t * best = NULL;
+
+    if (queue->elevator == kBlkElevatorDeadline)
+    {
+        // The request that is overdue the longest goes first.
+        for (request = queue->pending; request; request = request->next)
+        {
+            if (request->deadline <= now && (!best || request->deadline < best->deadline)
+                && !blk_request_is_blocked(queue, request))
+            {
+                best = request;
+            }
+        }
+        if (best)
+        {
+            ++queue->stats.expired;
+            return best;
+        }
+
+        // Otherwise continue upwards from the head, then wrap around to the lowest sector.
+        for (request = queue->pending; request; request = request->next)
+        {
+            if (request->sector >= queue->headSector && !blk_request_is_blocked(queue, request))
+            {
+                return request;
+            }
+        }
+    }
+
+    for (request = queue->pending; request; request = request->next)
+    {
+        if (!blk_request_is_blocked(queue, request))
+        {
+            return request;
+        }
+    }
+    return NULL;
+}
+
+//! @brief Hand waiting requests to the device, up to its queue depth.
+static void blk_dispatch(blk_queue_t * queue, uint64_t now)
+{
+    blk_device_t * device = queue->device;
+    blk_request_t * request;
+
+    while (queue->inFlight < device->queueDepth && (request = blk_pick(queue, now)))
+    {
+        blk_unlink(&queue->pending, request);
+        request->next = queue->active;
+        queue->active = request;
+
+        if (queue->inFlight++ == 0)
+        {
+            queue->busyStart = now;
+        }
+        if (queue->inFlight > queue->stats.maxInFlight)
+        {
+            queue->stats.maxInFlight = queue->inFlight;
+        }
+        ++queue->stats.requests;
+        queue->headSector = request->sector + request->count;
+
+        int status = device->submit(device, request);
+        if (status != kBlkSuccess)
+        {
+            blk_request_complete(request, status);
+        }
+    }
+}
+
+//! @brief Work item function, runs the queue after completions.
+static void blk_queue_work(void * arg)
+{
+    blk_queue_run((blk_queue_t *)arg);
+}
+
+//! @brief Callback of the bio of blk_transfer().
+static void blk_transfer_done(blk_bio_t * bio, int status)
+{
+    blk_waiter_t * waiter = (blk_waiter_t *)bio->arg;
+
+    waiter->status = status;
+    BLK_BARRIER();
+    waiter->isDone = 1;
+}
+
+//! @brief Run the queue and poll the device until a counter reaches zero.
+static void blk_wait(blk_queue_t * queue, volatile uint32_t * isDone, volatile int32_t * count)
+{
+    blk_device_t * device = queue->device;
+
+    while (isDone ? !*isDone : *count != 0)
+    {
+        if (device->poll)
+        {
+            device->poll(device);
+        }
+        blk_queue_run(queue);
+    }
+    BLK_BARRIER();
+}
+
+void blk_queue_init(blk_queue_t * queue, blk_device_t * device, blk_elevator_t elevator)
+{
+    uint32_t i;
+
+    queue->device = device;
+    queue->elevator = elevator;
+    queue->readExpire = BLK_READ_EXPIRE_US;
+    queue->writeExpire = BLK_WRITE_EXPIRE_US;
+    queue->incoming = NULL;
+    queue->completed = NULL;
+    queue->runState = kBlkIdle;
+    queue->plugCount = 0;
+    queue->outstanding = 0;
+    queue->backlog = NULL;
+    queue->backlogTail = NULL;
+    queue->pending = NULL;
+    queue->active = NULL;
+    queue->freeRequests = NULL;
+    queue->inFlight = 0;
+    queue->headSector = 0;
+    queue->sequence = 0;
+    queue->busyStart = 0;
+
+    for (i = 0; i < BLK_QUEUE_REQUESTS; ++i)
+    {
+        queue->requests[i].queue = queue;
+        queue->requests[i].next = queue->freeRequests;
+        queue->freeRequests = &queue->requests[i];
+    }
+
+    blk_queue_get_stats(queue, NULL);
+    work_item_init(&queue->work, blk_queue_work, queue);
+}
+
+void blk_bio_init(blk_bio_t * bio, blk_op_t op, uint32_t sector, uint32_t count, void * buffer,
+                  blk_bio_callback_t callback, void * arg)
+{
+    bio->next = NULL;
+    bio->op = op;
+    bio->sector = sector;
+    bio->count = count;
+    bio->buffer = buffer;
+    bio->callback = callback;
+    bio->arg = arg;
+    bio->submitTime = 0;
+}
+
+void blk_submit_bio(blk_queue_t * queue, blk_bio_t * bio)
+{
+    blk_bio_t * first;
+
+    bio->submitTime = time_get_microseconds();
+    atomic_increment(&queue->outstanding);
+
+    do {
+        first = queue->incoming;
+        bio->next = first;
+    } while (!BLK_POINTER_CAS(&queue->incoming, first, bio));
+
+    blk_queue_run(queue);
+}
+
+int blk_transfer(blk_queue_t * queue, blk_op_t op, uint32_t sector, uint32_t count, void * buffer)
+{
+    blk_waiter_t waiter = { 0, kBlkSuccess };
+    blk_bio_t bio;
+
+    blk_bio_init(&bio, op, sector, count, buffer, blk_transfer_done, &waiter);
+    blk_submit_bio(queue, &bio);
+    blk_wait(queue, &waiter.isDone, NULL);
+
+    return waiter.status;
+}
+
+void blk_plug(blk_queue_t * queue)
+{
+    atomic_increment(&queue->plugCount);
+}
+
+void blk_unplug(blk_queue_t * queue)
+{
+    if (atomic_decrement(&queue->plugCount) == 1)
+    {
+        blk_queue_run(queue);
+    }
+}
+
+void blk_queue_run(blk_queue_t * queue)
+{
+    if (!blk_enter(queue))
+    {
+        return;
+    }
+
+    do {
+        uint64_t now = time_get_microseconds();
+
+        // Completions first, they free requests for the backlog.
+        blk_take_completed(queue, now);
+        blk_take_incoming(queue, now);
+        if (queue->plugCount == 0)
+        {
+            blk_dispatch(queue, now);
+        }
+    } while (queue->completed || queue->incoming || !blk_leave(queue));
+}
+
+void blk_queue_drain(blk_queue_t * queue)
+{
+    blk_wait(queue, NULL, &queue->outstanding);
+}
+
+void blk_request_complete(blk_request_t * request, int status)
+{
+    blk_queue_t * queue = request->queue;
+    blk_request_t * first;
+
+    request->status = status;
+
+    do {
+        first = queue->completed;
+        request->nextCompleted = first;
+    } while (!BLK_POINTER_CAS(&queue->completed, first, request));
+
+    if (!work_queue(&queue->work))
+    {
+        blk_queue_run(queue);
+    }
+}
+
+void blk_queue_get_stats(blk_queue_t * queue, blk_stats_t * stats)
+{
+    if (stats)
+    {
+        *stats = queue->stats;
+    }
+
+    queue->stats.bios = 0;
+    queue->stats.requests = 0;
+    queue->stats.frontMerges = 0;
+    queue->stats.backMerges = 0;
+    queue->stats.expired = 0;
+    queue->stats.errors = 0;
+    queue->stats.maxInFlight = 0;
+    queue->stats.maxLatency = 0;
+    queue->stats.totalLatency = 0;
+    queue->stats.sectorsRead = 0;
+    queue->stats.sectorsWritten = 0;
+    queue->stats.busyTime = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
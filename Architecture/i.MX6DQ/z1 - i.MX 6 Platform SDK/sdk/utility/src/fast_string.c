@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file fast_string.c
+ * @brief Portable versions of the routines in fast_string.h.
+ *
+ * Used when the target has no NEON, such as the host build of the tests. Whole words are moved when both pointers
+ * share their alignment within a word, bytes otherwise.
+ */
+
+#include <stdint.h>
+#include "utility/fast_string.h"
+
+#if !FAST_STRING_HAS_NEON
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Word type that may alias the bytes of any object.
+typedef uintptr_t __attribute__((__may_alias__)) word_t;
+
+//! @brief Mask of the address bits within a word.
+#define WORD_MASK (sizeof(word_t) - 1)
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+void * fast_memcpy(void * dst, const void * src, size_t n)
+{
+    uint8_t * d = (uint8_t *)dst;
+    const uint8_t * s = (const uint8_t *)src;
+
+    if ((((uintptr_t)d ^ (uintptr_t)s) & WORD_MASK) == 0)
+    {
+        while (n && ((uintptr_t)d & WORD_MASK))
+        {
+            *d++ = *s++;
+            --n;
+        }
+        while (n >= 4 * sizeof(word_t))
+        {
+            ((word_t *)d)[0] = ((const word_t *)s)[0];
+            ((word_t *)d)[1] = ((const word_t *)s)[1];
+            ((word_t *)d)[2] = ((const word_t *)s)[2];
+            ((word_t *)d)[3] = ((const word_t *)s)[3];
+            d += 4 * sizeof(word_t);
+            s += 4 * sizeof(word_t);
+            n -= 4 * sizeof(word_t);
+        }
+        while (n >= sizeof(word_t))
+        {
+            *(word_t *)d = *(const word_t *)s;
+            d += sizeof(word_t);
+            s += sizeof(word_t);
+            n -= sizeof(word_t);
+        }
+    }
+    while (n--)
+    {
+        *d++ = *s++;
+    }
+    return dst;
+}
+
+void * fast_memmove(void * dst, const void * src, size_t n)
+{
+    uint8_t * d;
+    const uint8_t * s;
+
+    // A destination below the source, or past its end, is safe to copy forward.
+    if ((uintptr_t)dst - (uintptr_t)src >= n)
+    {
+        return fast_memcpy(dst, src, n);
+    }
+
+    d = (uint8_t *)dst + n;
+    s = (const uint8_t *)src + n;
+    if ((((uintptr_t)d ^ (uintptr_t)s) & WORD_MASK) == 0)
+    {
+        while (n && ((uintptr_t)d & WORD_MASK))
+        {
+            *--d = *--s;
+            --n;
+        }
+        while (n >= sizeof(word_t))
+        {
+            d -= sizeof(word_t);
+            s -= sizeof(word_t);
+            n -= sizeof(word_t);
+            *(word_t *)d = *(const word_t *)s;
+        }
+    }
+    while (n--)
+    {
+        *--d = *--s;
+    }
+    return dst;
+}
+
+void * fast_memset(void * dst, int c, size_t n)
+{
+    uint8_t * d = (uint8_t *)dst;
+    word_t pattern = (uint8_t)c;
+
+    pattern |= pattern << 8;
+    pattern |= pattern << 16;
+    if (sizeof(word_t) > 4)
+    {
+        pattern |= (pattern << 16) << 16;
+    }
+
+    while (n && ((uintptr_t)d & WORD_MASK))
+    {
+        *d++ = (uint8_t)c;
+        --n;
+    }
+    while (n >= 4 * sizeof(word_t))
+    {
+        ((word_t *)d)[0] = pattern;
+        ((word_t *)d)[1] = pattern;
+        ((word_t *)d)[2] = pattern;
+        ((word_t *)d)[3] = pattern;
+        d += 4 * sizeof(word_t);
+        n -= 4 * sizeof(word_t);
+    }
+    while (n >= sizeof(word_t))
+    {
+        *(word_t *)d = pattern;
+        d += sizeof(word_t);
+        n -= sizeof(word_t);
+    }
+    while (n--)
+    {
+        *d++ = (uint8_t)c;
+    }
+    return dst;
+}
+
+int fast_memcmp(const void * a, const void * b, size_t n)
+{
+    const uint8_t * pa = (const uint8_t *)a;
+    const uint8_t * pb = (const uint8_t *)b;
+
+    // Skip equal words, then find the differing byte one at a time.
+    if ((((uintptr_t)pa ^ (uintptr_t)pb) & WORD_MASK) == 0)
+    {
+        while (n && ((uintptr_t)pa & WORD_MASK))
+        {
+            if (*pa != *pb)
+            {
+                return *pa - *pb;
+            }
+            ++pa;
+            ++pb;
+            --n;
+        }
+        while (n >= sizeof(word_t) && *(const word_t *)pa == *(const word_t *)pb)
+        {
+            pa += sizeof(word_t);
+            pb += sizeof(word_t);
+            n -= sizeof(word_t);
+        }
+    }
+    for (; n; --n, ++pa, ++pb)
+    {
+        if (*pa != *pb)
+        {
+            return *pa - *pb;
+        }
+    }
+    return 0;
+}
+
+#endif // !FAST_STRING_HAS_NEON
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
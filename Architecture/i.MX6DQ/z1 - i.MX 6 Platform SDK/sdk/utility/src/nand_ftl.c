@@ -0,0 +1,1798 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file nand_ftl.c
+ * @brief Log-structured flash translation layer for raw NAND.
+ *
+ * A block that is reclaimed, by garbage collection or because all its pages were
+ * overwritten, stays pending until the next checkpoint has been committed. Everything the
+ * last checkpoint refers to is therefore still on the NAND after a power loss. Between
+ * checkpoints the free blocks neither gain members nor change erase counts, so the order in
+ * which they are allocated, lowest erase count and then lowest block number first, is fixed
+ * by the checkpoint. Mounting walks that order for as long as the first page of each block
+ * was written after the checkpoint, and replays the data pages of those blocks in order.
+ * Map pages written after the checkpoint are ignored by the replay; the map is rebuilt from
+ * the checkpointed map pages and the replayed data pages instead. Checkpoints carry a journal of
+ * the entries that changed in the cached map pages, so a map page only goes to the log when
+ * it is evicted or its journal grows too long.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "utility/nand_ftl.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Identifies checkpoint headers and commit pages, "FTLC".
+#define FTL_CHECKPOINT_MAGIC (0x434c5446)
+
+//! @brief Layout version of the checkpoint.
+#define FTL_CHECKPOINT_VERSION (1)
+
+//! @brief Block number meaning no block.
+#define FTL_NO_BLOCK (0xffffffff)
+
+//! @brief Free blocks a collect may use up: one for the copies and one for the map pages
+//! they evict from the cache.
+#define FTL_COLLECT_BLOCKS (2)
+
+//! @brief A map page is written back to the log rather than journaled once its changes take
+//! more than this fraction of a page.
+#define FTL_JOURNAL_SHARE (4)
+
+//! @brief Values of ftl_t::blockState.
+enum _ftl_block_state
+{
+    kFtlBlockFree = 0,          //!< Can be allocated. May still hold stale pages.
+    kFtlBlockUsed = 1,          //!< Part of the log.
+    kFtlBlockPending = 2,       //!< No valid pages left, becomes free at the next checkpoint.
+    kFtlBlockCheckpoint = 3,    //!< One of the checkpoint blocks.
+    kFtlBlockBad = 4,           //!< Retired.
+    kFtlBlockStateMask = 0x0f,
+    kFtlBlockRefresh = 0x40,    //!< Reads needed many corrections, reclaim it soon.
+    kFtlBlockRetire = 0x80      //!< A program failed, retire it once reclaimed.
+};
+
+//! @brief Start of a checkpoint, followed by the tables.
+typedef struct _ftl_checkpoint_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sequence;          //!< Pages with this sequence number and later are replayed.
+    uint32_t pageSize;
+    uint32_t pagesPerBlock;
+    uint32_t blockCount;
+    uint32_t logicalPages;
+    uint32_t mapPages;
+    uint32_t activeBlock;
+    uint32_t activePage;
+    uint32_t journalPages;      //!< Map pages with changes in the journal after the tables.
+    uint32_t journalBytes;      //!< Size of the journal.
+} ftl_checkpoint_header_t;
+
+//! @brief Start of the changes of a map page in the journal of a checkpoint.
+typedef struct _ftl_journal_header {
+    uint32_t index;             //!< The map page.
+    uint32_t count;             //!< Changed entries that follow, ftl_t::entriesPerMapPage for the whole page.
+} ftl_journal_header_t;
+
+//! @brief A changed entry in the journal of a checkpoint.
+typedef struct _ftl_journal_entry {
+    uint32_t offset;            //!< Entry within the map page.
+    uint32_t page;              //!< Physical page it maps to.
+} ftl_journal_entry_t;
+
+//! @brief Commit record at the end of the last page of a checkpoint.
+typedef struct _ftl_commit {
+    uint32_t magic;
+    uint32_t pages;             //!< Checkpoint pages before the one with the commit record.
+    uint32_t bytes;             //!< Checkpoint bytes.
+    uint32_t crc;               //!< CRC-32 of the checkpoint bytes.
+} ftl_commit_t;
+
+//! @brief Position in a checkpoint while it is written or read.
+typedef struct _ftl_stream {
+    uint32_t firstPage;         //!< Physical page of the first checkpoint page.
+    uint32_t page;              //!< Checkpoint page that ftl_t::pageBuffer belongs to.
+    uint32_t offset;            //!< Bytes of ftl_t::pageBuffer used.
+    uint32_t crc;               //!< CRC-32 of the bytes so far.
+    int status;                 //!< First error, or #kFtlSuccess.
+} ftl_stream_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+static int ftl_checkpoint(ftl_t * ftl);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief CRC-32 of each nibble value, polynomial 0xedb88320.
+static const uint32_t s_crcTable[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Continue a CRC-32 over more bytes, starting with 0.
+static uint32_t ftl_crc32(uint32_t crc, const void * data, uint32_t length)
+{
+    const uint8_t * bytes = (const uint8_t *)data;
+
+    crc = ~crc;
+    while (length--)
+    {
+        crc ^= *bytes++;
+        crc = (crc >> 4) ^ s_crcTable[crc & 0xf];
+        crc = (crc >> 4) ^ s_crcTable[crc & 0xf];
+    }
+    return ~crc;
+}
+
+static inline uint32_t ftl_block_state(const ftl_t * ftl, uint32_t block)
+{
+    return ftl->blockState[block] & kFtlBlockStateMask;
+}
+
+static inline void ftl_set_block_state(ftl_t * ftl, uint32_t block, uint32_t state)
+{
+    ftl->blockState[block] = (ftl->blockState[block] & ~kFtlBlockStateMask) | state;
+}
+
+//! @brief Size of the bitmap of changed entries of a cached map page.
+static inline uint32_t ftl_changed_bytes(const ftl_t * ftl)
+{
+    return (ftl->entriesPerMapPage + 31) / 32 * sizeof(uint32_t);
+}
+
+static inline bool ftl_is_changed(const ftl_map_slot_t * slot, uint32_t offset)
+{
+    return (slot->changed[offset / 32] >> (offset % 32)) & 1;
+}
+
+//! @brief Count an entry of a cached map page as changed.
+static inline void ftl_set_changed(ftl_map_slot_t * slot, uint32_t offset)
+{
+    if (!ftl_is_changed(slot, offset))
+    {
+        slot->changed[offset / 32] |= 1u << (offset % 32);
+        ++slot->changedEntries;
+    }
+}
+
+//! @brief Read a page, flagging its block for a refresh if it needed many corrections.
+static int ftl_nand_read(ftl_t * ftl, uint32_t page, void * data, ftl_spare_t * spare)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    int status = nand->read(nand, page, data, spare);
+    uint32_t block = page / nand->pagesPerBlock;
+
+    ++ftl->stats.nandReads;
+    if (status == kFtlNandCorrected)
+    {
+        if (ftl->blockState && ftl_block_state(ftl, block) == kFtlBlockUsed)
+        {
+            ftl->blockState[block] |= kFtlBlockRefresh;
+        }
+        status = kFtlNandSuccess;
+    }
+    else if (status == kFtlNandEccError)
+    {
+        ++ftl->stats.eccErrors;
+    }
+    return status;
+}
+
+//! @brief Retire a block to the bad block table.
+static void ftl_retire_block(ftl_t * ftl, uint32_t block)
+{
+    ftl->nand->markBad(ftl->nand, block);
+    ftl->blockState[block] = kFtlBlockBad;
+    ftl->validCount[block] = 0;
+    ++ftl->stats.badBlocks;
+}
+
+//! @brief Erase a block, retiring it if that fails.
+static bool ftl_erase_block(ftl_t * ftl, uint32_t block)
+{
+    ++ftl->stats.erases;
+    if (ftl->nand->erase(ftl->nand, block) != kFtlNandSuccess)
+    {
+        ftl_retire_block(ftl, block);
+        return false;
+    }
+    ++ftl->eraseCount[block];
+    return true;
+}
+
+//! @brief The free block allocated next: lowest erase count, then lowest number.
+static uint32_t ftl_next_free_block(const ftl_t * ftl)
+{
+    uint32_t best = FTL_NO_BLOCK;
+    uint32_t block;
+
+    for (block = FTL_CHECKPOINT_BLOCKS; block < ftl->nand->blockCount; ++block)
+    {
+        if (ftl->blockState[block] == kFtlBlockFree
+            && (best == FTL_NO_BLOCK || ftl->eraseCount[block] < ftl->eraseCount[best]))
+        {
+            best = block;
+        }
+    }
+    return best;
+}
+
+//! @brief Make a used block pending once nothing in it is valid and it is not written to.
+static void ftl_check_empty(ftl_t * ftl, uint32_t block)
+{
+    if (!ftl->isReplaying && block != ftl->activeBlock && ftl->validCount[block] == 0
+        && ftl_block_state(ftl, block) == kFtlBlockUsed)
+    {
+        ftl_set_block_state(ftl, block, kFtlBlockPending);
+        ++ftl->pendingBlocks;
+    }
+}
+
+//! @brief Drop a physical page from the valid pages of its block.
+static void ftl_invalidate(ftl_t * ftl, uint32_t page)
+{
+    uint32_t block;
+
+    if (page == FTL_UNMAPPED)
+    {
+        return;
+    }
+
+    block = page / ftl->nand->pagesPerBlock;
+    if (ftl->validCount[block])
+    {
+        --ftl->validCount[block];
+    }
+    ftl_check_empty(ftl, block);
+}
+
+//! @brief Erase the next free block and make it the active block.
+static int ftl_open_block(ftl_t * ftl)
+{
+    uint32_t previous = ftl->activeBlock;
+
+    for (;;)
+    {
+        uint32_t block = ftl_next_free_block(ftl);
+        if (block == FTL_NO_BLOCK)
+        {
+            return kFtlNoSpace;
+        }
+
+        --ftl->freeBlocks;
+        if (ftl_erase_block(ftl, block))
+        {
+            ftl->blockState[block] = kFtlBlockUsed;
+            ftl->validCount[block] = 0;
+            ftl->activeBlock = block;
+            ftl->activePage = 0;
+            ++ftl->blocksSinceCheckpoint;
+            break;
+        }
+    }
+
+    if (previous != FTL_NO_BLOCK)
+    {
+        ftl_check_empty(ftl, previous);
+    }
+    return kFtlSuccess;
+}
+
+//! @brief Write a page at the head of the log.
+//!
+//! Never reclaims blocks itself, so it is safe to use from garbage collection.
+static int ftl_append(ftl_t * ftl, uint8_t type, uint32_t id, const void * data, uint32_t * page)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    ftl_spare_t spare;
+
+    for (;;)
+    {
+        int status;
+
+        if (ftl->activeBlock == FTL_NO_BLOCK || ftl->activePage >= nand->pagesPerBlock)
+        {
+            status = ftl_open_block(ftl);
+            if (status != kFtlSuccess)
+            {
+                return status;
+            }
+        }
+
+        *page = ftl->activeBlock * nand->pagesPerBlock + ftl->activePage++;
+        spare.type = type;
+        spare.id = id;
+        spare.sequence = ftl->sequence++;
+
+        ++ftl->stats.nandWrites;
+        if (nand->program(nand, *page, data, &spare) == kFtlNandSuccess)
+        {
+            ++ftl->validCount[ftl->activeBlock];
+            return kFtlSuccess;
+        }
+
+        // Give up on the block. If nothing was written to it yet it can go right away,
+        // otherwise it is retired once its pages have been moved.
+        if (ftl->activePage == 1)
+        {
+            ftl_retire_block(ftl, ftl->activeBlock);
+            ftl->activeBlock = FTL_NO_BLOCK;
+        }
+        else
+        {
+            ftl->blockState[ftl->activeBlock] |= kFtlBlockRetire;
+            ftl->activePage = nand->pagesPerBlock;
+        }
+    }
+}
+
+//! @brief Write a cached map page back to the log.
+static int ftl_map_flush(ftl_t * ftl, ftl_map_slot_t * slot)
+{
+    uint32_t page;
+    int status = ftl_append(ftl, kFtlPageMap, slot->index, slot->entries, &page);
+
+    if (status == kFtlSuccess)
+    {
+        ftl_invalidate(ftl, ftl->directory[slot->index]);
+        ftl->directory[slot->index] = page;
+        memset(slot->changed, 0, ftl_changed_bytes(ftl));
+        slot->changedEntries = 0;
+        ++ftl->stats.mapWrites;
+    }
+    return status;
+}
+
+//! @brief Get a map page into the cache, replacing the least recently used one.
+static ftl_map_slot_t * ftl_map_load(ftl_t * ftl, uint32_t index, int * status)
+{
+    ftl_map_slot_t * slot = NULL;
+    uint32_t i;
+
+    for (i = 0; i < ftl->config.mapCachePages; ++i)
+    {
+        ftl_map_slot_t * candidate = &ftl->cache[i];
+        if (candidate->index == index)
+        {
+            candidate->lastUse = ++ftl->cacheClock;
+            return candidate;
+        }
+        if (!slot || candidate->lastUse < slot->lastUse)
+        {
+            slot = candidate;
+        }
+    }
+
+    if (slot->changedEntries)
+    {
+        *status = ftl_map_flush(ftl, slot);
+        if (*status != kFtlSuccess)
+        {
+            return NULL;
+        }
+    }
+
+    slot->index = FTL_UNMAPPED;
+    slot->lastUse = 0;
+    if (ftl->directory[index] == FTL_UNMAPPED)
+    {
+        memset(slot->entries, 0xff, ftl->nand->pageSize);
+    }
+    else
+    {
+        ftl_spare_t spare;
+        if (ftl_nand_read(ftl, ftl->directory[index], slot->entries, &spare) != kFtlNandSuccess)
+        {
+            *status = kFtlError;
+            return NULL;
+        }
+        ++ftl->stats.mapReads;
+    }
+
+    slot->index = index;
+    slot->lastUse = ++ftl->cacheClock;
+    return slot;
+}
+
+//! @brief Physical page of a logical page.
+static int ftl_map_lookup(ftl_t * ftl, uint32_t logicalPage, uint32_t * page)
+{
+    int status = kFtlSuccess;
+    ftl_map_slot_t * slot = ftl_map_load(ftl, logicalPage / ftl->entriesPerMapPage, &status);
+
+    if (slot)
+    {
+        *page = slot->entries[logicalPage % ftl->entriesPerMapPage];
+    }
+    return status;
+}
+
+//! @brief Point a logical page at a new physical page, which counts as valid from now on.
+static void ftl_map_update(ftl_t * ftl, ftl_map_slot_t * slot, uint32_t logicalPage, uint32_t page)
+{
+    uint32_t offset = logicalPage % ftl->entriesPerMapPage;
+    uint32_t old = slot->entries[offset];
+
+    slot->entries[offset] = page;
+    ftl_set_changed(slot, offset);
+    ftl_invalidate(ftl, old);
+}
+
+//! @brief Write a logical page to the log and map it.
+static int ftl_write_page(ftl_t * ftl, uint8_t type, uint32_t id, const void * data)
+{
+    int status = kFtlSuccess;
+    uint32_t page;
+
+    if (type == kFtlPageMap)
+    {
+        status = ftl_append(ftl, type, id, data, &page);
+        if (status == kFtlSuccess)
+        {
+            ftl_invalidate(ftl, ftl->directory[id]);
+            ftl->directory[id] = page;
+        }
+    }
+    else
+    {
+        // Load the map page first, so nothing can fail between writing and mapping the page.
+        ftl_map_slot_t * slot = ftl_map_load(ftl, id / ftl->entriesPerMapPage, &status);
+        if (slot)
+        {
+            status = ftl_append(ftl, type, id, data, &page);
+            if (status == kFtlSuccess)
+            {
+                ftl_map_update(ftl, slot, id, page);
+            }
+        }
+    }
+    return status;
+}
+
+//! @brief Move the valid pages out of a block, which becomes pending.
+static int ftl_collect(ftl_t * ftl, uint32_t block)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    uint32_t firstPage = block * nand->pagesPerBlock;
+    uint32_t i;
+
+    for (i = 0; i < nand->pagesPerBlock && ftl->validCount[block]; ++i)
+    {
+        uint32_t page = firstPage + i;
+        ftl_spare_t spare;
+        uint32_t current = FTL_UNMAPPED;
+        int status = ftl_nand_read(ftl, page, ftl->pageBuffer, &spare);
+
+        if (status != kFtlNandSuccess && status != kFtlNandEccError)
+        {
+            return kFtlError;
+        }
+        if (spare.type == kFtlPageErased && status == kFtlNandSuccess)
+        {
+            break;
+        }
+
+        // A page whose spare area is uncorrectable cannot be identified and is lost. Pages
+        // with only uncorrectable data are still moved, so the error is kept.
+        if (spare.type == kFtlPageData && spare.id < ftl->logicalPages)
+        {
+            status = ftl_map_lookup(ftl, spare.id, &current);
+        }
+        else if (spare.type == kFtlPageMap && spare.id < ftl->mapPages)
+        {
+            current = ftl->directory[spare.id];
+            status = kFtlSuccess;
+        }
+        if (status != kFtlSuccess)
+        {
+            return status;
+        }
+
+        if (current == page)
+        {
+            status = ftl_write_page(ftl, spare.type, spare.id, ftl->pageBuffer);
+            if (status != kFtlSuccess)
+            {
+                return status;
+            }
+            ++ftl->stats.gcCopies;
+        }
+    }
+
+    // Whatever could not be identified is given up.
+    if (ftl->validCount[block])
+    {
+        ftl->validCount[block] = 0;
+        ftl_check_empty(ftl, block);
+    }
+    ++ftl->stats.gcBlocks;
+    return kFtlSuccess;
+}
+
+//! @brief The used block with the fewest valid pages, if any of them is stale.
+static uint32_t ftl_pick_victim(const ftl_t * ftl)
+{
+    uint32_t best = FTL_NO_BLOCK;
+    uint32_t block;
+
+    for (block = FTL_CHECKPOINT_BLOCKS; block < ftl->nand->blockCount; ++block)
+    {
+        if (ftl_block_state(ftl, block) != kFtlBlockUsed || block == ftl->activeBlock
+            || ftl->validCount[block] >= ftl->nand->pagesPerBlock)
+        {
+            continue;
+        }
+        if (best == FTL_NO_BLOCK || ftl->validCount[block] < ftl->validCount[best]
+            || (ftl->validCount[block] == ftl->validCount[best] && ftl->eraseCount[block] < ftl->eraseCount[best]))
+        {
+            best = block;
+        }
+    }
+    return best;
+}
+
+//! @brief Write back the map pages whose changes grew too many to journal, unless the free
+//! blocks are needed for reclaiming.
+static int ftl_trim_journal(ftl_t * ftl)
+{
+    uint32_t i;
+
+    for (i = 0; i < ftl->config.mapCachePages && ftl->freeBlocks > FTL_GC_RESERVE_BLOCKS; ++i)
+    {
+        ftl_map_slot_t * slot = &ftl->cache[i];
+        if (slot->changedEntries * sizeof(ftl_journal_entry_t) > ftl->nand->pageSize / FTL_JOURNAL_SHARE)
+        {
+            int status = ftl_map_flush(ftl, slot);
+            if (status != kFtlSuccess)
+            {
+                return status;
+            }
+        }
+    }
+    return kFtlSuccess;
+}
+
+//! @brief Make sure a page can be appended for the host, reclaiming blocks if needed.
+//!
+//! The host never takes the free blocks a collect may need. Reclaimed blocks only become
+//! free with a checkpoint, so as many victims are collected as the free blocks allow before
+//! committing one. Victims can be nearly full, so the rounds are bounded by pages rather than
+//! blocks; running out of them means the reserve or the map cache is too small for the
+//! workload.
+static int ftl_make_space(ftl_t * ftl)
+{
+    uint32_t rounds = ftl->nand->blockCount * ftl->nand->pagesPerBlock;
+    int status = ftl_trim_journal(ftl);
+
+    // Checkpoints taken while the free blocks are short cannot trim the journal themselves.
+    if (status != kFtlSuccess)
+    {
+        return status;
+    }
+
+    while (ftl->freeBlocks <= FTL_GC_RESERVE_BLOCKS && rounds--)
+    {
+        uint32_t victim = FTL_NO_BLOCK;
+
+        if (ftl->freeBlocks >= FTL_COLLECT_BLOCKS)
+        {
+            victim = ftl_pick_victim(ftl);
+        }
+
+        if (victim != FTL_NO_BLOCK)
+        {
+            status = ftl_collect(ftl, victim);
+        }
+        else if (ftl->pendingBlocks)
+        {
+            status = ftl_checkpoint(ftl);
+        }
+        else
+        {
+            break;
+        }
+        if (status != kFtlSuccess)
+        {
+            return status;
+        }
+    }
+    return (ftl->freeBlocks > FTL_GC_RESERVE_BLOCKS) ? kFtlSuccess : kFtlNoSpace;
+}
+
+//! @brief Program the current checkpoint page, padding it with 0xff bytes.
+static void ftl_stream_flush(ftl_t * ftl, ftl_stream_t * stream, uint8_t type)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    ftl_spare_t spare;
+
+    if ((stream->offset == 0 && type == kFtlPageCheckpoint) || stream->status != kFtlSuccess)
+    {
+        return;
+    }
+
+    memset(ftl->pageBuffer + stream->offset, 0xff, nand->pageSize - stream->offset);
+    spare.type = type;
+    spare.id = stream->page;
+    spare.sequence = ftl->sequence++;
+
+    ++ftl->stats.nandWrites;
+    if (nand->program(nand, stream->firstPage + stream->page, ftl->pageBuffer, &spare) != kFtlNandSuccess)
+    {
+        stream->status = kFtlError;
+    }
+    ++stream->page;
+    stream->offset = 0;
+}
+
+//! @brief Add bytes to a checkpoint, programming each page as it fills up.
+static void ftl_stream_write(ftl_t * ftl, ftl_stream_t * stream, const void * data, uint32_t length)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    const uint8_t * bytes = (const uint8_t *)data;
+
+    stream->crc = ftl_crc32(stream->crc, data, length);
+    while (length && stream->status == kFtlSuccess)
+    {
+        uint32_t chunk = nand->pageSize - stream->offset;
+        if (chunk > length)
+        {
+            chunk = length;
+        }
+        memcpy(ftl->pageBuffer + stream->offset, bytes, chunk);
+        stream->offset += chunk;
+        bytes += chunk;
+        length -= chunk;
+
+        if (stream->offset == nand->pageSize)
+        {
+            ftl_stream_flush(ftl, stream, kFtlPageCheckpoint);
+        }
+    }
+}
+
+//! @brief Take bytes from a checkpoint, reading each page as it is needed.
+static void ftl_stream_read(ftl_t * ftl, ftl_stream_t * stream, void * data, uint32_t length)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    uint8_t * bytes = (uint8_t *)data;
+
+    while (length && stream->status == kFtlSuccess)
+    {
+        uint32_t chunk;
+
+        if (stream->offset == 0)
+        {
+            ftl_spare_t spare;
+            if (ftl_nand_read(ftl, stream->firstPage + stream->page, ftl->pageBuffer, &spare) != kFtlNandSuccess
+                || (spare.type != kFtlPageCheckpoint && spare.type != kFtlPageCommit) || spare.id != stream->page)
+            {
+                stream->status = kFtlError;
+                break;
+            }
+        }
+
+        chunk = nand->pageSize - stream->offset;
+        if (chunk > length)
+        {
+            chunk = length;
+        }
+        memcpy(bytes, ftl->pageBuffer + stream->offset, chunk);
+        stream->crc = ftl_crc32(stream->crc, bytes, chunk);
+        stream->offset += chunk;
+        bytes += chunk;
+        length -= chunk;
+
+        if (stream->offset == nand->pageSize)
+        {
+            ++stream->page;
+            stream->offset = 0;
+        }
+    }
+}
+
+//! @brief Size of a checkpoint in bytes.
+static uint32_t ftl_checkpoint_bytes(const ftl_t * ftl, uint32_t journalBytes)
+{
+    uint32_t blockCount = ftl->nand->blockCount;
+
+    return sizeof(ftl_checkpoint_header_t) + ftl->mapPages * sizeof(uint32_t)
+        + blockCount * (sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint8_t)) + journalBytes;
+}
+
+//! @brief Size of a checkpoint in pages, including the commit record.
+static uint32_t ftl_checkpoint_pages(const ftl_t * ftl, uint32_t journalBytes)
+{
+    uint32_t pageSize = ftl->nand->pageSize;
+
+    return (ftl_checkpoint_bytes(ftl, journalBytes) + sizeof(ftl_commit_t) + pageSize - 1) / pageSize;
+}
+
+//! @brief Whether the journal holds a whole cached map page rather than its changed entries.
+static inline bool ftl_journal_is_whole(const ftl_t * ftl, const ftl_map_slot_t * slot)
+{
+    return slot->changedEntries * sizeof(ftl_journal_entry_t) >= ftl->nand->pageSize;
+}
+
+//! @brief Size of the changes of a cached map page in the journal.
+static uint32_t ftl_journal_bytes(const ftl_t * ftl, const ftl_map_slot_t * slot)
+{
+    if (ftl_journal_is_whole(ftl, slot))
+    {
+        return sizeof(ftl_journal_header_t) + ftl->nand->pageSize;
+    }
+    return sizeof(ftl_journal_header_t) + slot->changedEntries * sizeof(ftl_journal_entry_t);
+}
+
+//! @brief Erase the next good checkpoint block after the current one.
+static uint32_t ftl_next_checkpoint_block(ftl_t * ftl)
+{
+    uint32_t start = (ftl->checkpointBlock == FTL_NO_BLOCK) ? 0 : ftl->checkpointBlock + 1;
+    uint32_t i;
+
+    for (i = 0; i < FTL_CHECKPOINT_BLOCKS; ++i)
+    {
+        uint32_t block = (start + i) % FTL_CHECKPOINT_BLOCKS;
+        if (block != ftl->checkpointBlock && ftl->blockState[block] == kFtlBlockCheckpoint
+            && ftl_erase_block(ftl, block))
+        {
+            return block;
+        }
+    }
+    return FTL_NO_BLOCK;
+}
+
+//! @brief Write the tables and the journal of the dirty map pages as a checkpoint at the
+//! current checkpoint position.
+//!
+//! Journaling the changed entries instead of the whole map pages keeps checkpoints small, so
+//! the checkpoint blocks wear little faster than the rest.
+static int ftl_write_checkpoint(ftl_t * ftl, uint32_t journalPages, uint32_t journalBytes)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    ftl_checkpoint_header_t header;
+    ftl_stream_t stream;
+    ftl_commit_t commit;
+    uint8_t states[64];
+    uint32_t block;
+    uint32_t i;
+
+    header.magic = FTL_CHECKPOINT_MAGIC;
+    header.version = FTL_CHECKPOINT_VERSION;
+    header.sequence = ftl->sequence;
+    header.pageSize = nand->pageSize;
+    header.pagesPerBlock = nand->pagesPerBlock;
+    header.blockCount = nand->blockCount;
+    header.logicalPages = ftl->logicalPages;
+    header.mapPages = ftl->mapPages;
+    header.activeBlock = ftl->activeBlock;
+    header.activePage = ftl->activePage;
+    header.journalPages = journalPages;
+    header.journalBytes = journalBytes;
+
+    memset(&stream, 0, sizeof(stream));
+    stream.firstPage = ftl->checkpointBlock * nand->pagesPerBlock + ftl->checkpointPage;
+    ftl_stream_write(ftl, &stream, &header, sizeof(header));
+    ftl_stream_write(ftl, &stream, ftl->directory, ftl->mapPages * sizeof(uint32_t));
+    ftl_stream_write(ftl, &stream, ftl->eraseCount, nand->blockCount * sizeof(uint32_t));
+    ftl_stream_write(ftl, &stream, ftl->validCount, nand->blockCount * sizeof(uint16_t));
+
+    // Pending blocks are free as soon as this checkpoint is committed.
+    for (block = 0; block < nand->blockCount; block += sizeof(states))
+    {
+        uint32_t count = nand->blockCount - block;
+
+        if (count > sizeof(states))
+        {
+            count = sizeof(states);
+        }
+        for (i = 0; i < count; ++i)
+        {
+            states[i] = ftl->blockState[block + i];
+            if ((states[i] & kFtlBlockStateMask) == kFtlBlockPending)
+            {
+                states[i] = (states[i] & kFtlBlockRetire) | kFtlBlockFree;
+            }
+        }
+        ftl_stream_write(ftl, &stream, states, count);
+    }
+
+    for (i = 0; i < ftl->config.mapCachePages; ++i)
+    {
+        const ftl_map_slot_t * slot = &ftl->cache[i];
+        ftl_journal_header_t record;
+        ftl_journal_entry_t entry;
+
+        if (!slot->changedEntries)
+        {
+            continue;
+        }
+        record.index = slot->index;
+        record.count = ftl_journal_is_whole(ftl, slot) ? ftl->entriesPerMapPage : slot->changedEntries;
+        ftl_stream_write(ftl, &stream, &record, sizeof(record));
+        if (record.count == ftl->entriesPerMapPage)
+        {
+            ftl_stream_write(ftl, &stream, slot->entries, nand->pageSize);
+            continue;
+        }
+        for (entry.offset = 0; entry.offset < ftl->entriesPerMapPage; ++entry.offset)
+        {
+            if (ftl_is_changed(slot, entry.offset))
+            {
+                entry.page = slot->entries[entry.offset];
+                ftl_stream_write(ftl, &stream, &entry, sizeof(entry));
+            }
+        }
+    }
+
+    // The commit record goes at the end of the last page, which is programmed last.
+    if (stream.offset + sizeof(commit) > nand->pageSize)
+    {
+        ftl_stream_flush(ftl, &stream, kFtlPageCheckpoint);
+    }
+    commit.magic = FTL_CHECKPOINT_MAGIC;
+    commit.pages = stream.page;
+    commit.bytes = ftl_checkpoint_bytes(ftl, journalBytes);
+    commit.crc = stream.crc;
+    memset(ftl->pageBuffer + stream.offset, 0xff, nand->pageSize - stream.offset);
+    memcpy(ftl->pageBuffer + nand->pageSize - sizeof(commit), &commit, sizeof(commit));
+    stream.offset = nand->pageSize;
+    ftl_stream_flush(ftl, &stream, kFtlPageCommit);
+    return stream.status;
+}
+
+//! @brief Free the pending blocks, retiring those that failed a program.
+static void ftl_release_pending(ftl_t * ftl)
+{
+    uint32_t block;
+
+    for (block = FTL_CHECKPOINT_BLOCKS; block < ftl->nand->blockCount; ++block)
+    {
+        uint32_t state = ftl_block_state(ftl, block);
+        if (state == kFtlBlockPending || (state == kFtlBlockFree && (ftl->blockState[block] & kFtlBlockRetire)))
+        {
+            if (state == kFtlBlockFree)
+            {
+                --ftl->freeBlocks;
+            }
+            if (ftl->blockState[block] & kFtlBlockRetire)
+            {
+                ftl_retire_block(ftl, block);
+            }
+            else
+            {
+                ftl->blockState[block] = kFtlBlockFree;
+                ++ftl->freeBlocks;
+            }
+        }
+    }
+    ftl->pendingBlocks = 0;
+}
+
+//! @brief Commit a checkpoint.
+static int ftl_checkpoint(ftl_t * ftl)
+{
+    uint32_t journalPages = 0;
+    uint32_t journalBytes = 0;
+    uint32_t pages;
+    uint32_t attempt;
+    uint32_t i;
+    int status = ftl_trim_journal(ftl);
+
+    if (status != kFtlSuccess)
+    {
+        return status;
+    }
+    for (i = 0; i < ftl->config.mapCachePages; ++i)
+    {
+        if (ftl->cache[i].changedEntries)
+        {
+            ++journalPages;
+            journalBytes += ftl_journal_bytes(ftl, &ftl->cache[i]);
+        }
+    }
+    pages = ftl_checkpoint_pages(ftl, journalBytes);
+
+    // A failed checkpoint leaves the previous one valid, so just try the next block.
+    for (attempt = 0; attempt < FTL_CHECKPOINT_BLOCKS; ++attempt)
+    {
+        if (ftl->checkpointBlock == FTL_NO_BLOCK || ftl->checkpointPage + pages > ftl->nand->pagesPerBlock)
+        {
+            uint32_t block = ftl_next_checkpoint_block(ftl);
+            if (block == FTL_NO_BLOCK)
+            {
+                return kFtlError;
+            }
+            ftl->checkpointBlock = block;
+            ftl->checkpointPage = 0;
+        }
+
+        if (ftl_write_checkpoint(ftl, journalPages, journalBytes) == kFtlSuccess)
+        {
+            ftl->checkpointPage += pages;
+            ftl_release_pending(ftl);
+            ftl->blocksSinceCheckpoint = 0;
+            ftl->checkpointSequence = ftl->sequence;
+            ++ftl->stats.checkpoints;
+            return kFtlSuccess;
+        }
+        ftl->checkpointPage = ftl->nand->pagesPerBlock;
+    }
+    return kFtlError;
+}
+
+//! @brief Free the tables.
+static void ftl_free_tables(ftl_t * ftl)
+{
+    if (ftl->cache)
+    {
+        free(ftl->cache[0].entries);
+        free(ftl->cache[0].changed);
+    }
+    free(ftl->cache);
+    free(ftl->directory);
+    free(ftl->validCount);
+    free(ftl->eraseCount);
+    free(ftl->blockState);
+    free(ftl->pageBuffer);
+    ftl->cache = NULL;
+    ftl->directory = NULL;
+    ftl->validCount = NULL;
+    ftl->eraseCount = NULL;
+    ftl->blockState = NULL;
+    ftl->pageBuffer = NULL;
+}
+
+//! @brief Allocate the tables for the map size, with an empty map.
+static int ftl_alloc_tables(ftl_t * ftl)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    uint32_t slots = ftl->config.mapCachePages;
+    uint32_t changedWords = ftl_changed_bytes(ftl) / sizeof(uint32_t);
+    uint32_t * entries;
+    uint32_t * changed;
+    uint32_t i;
+
+    ftl->directory = (uint32_t *)malloc(ftl->mapPages * sizeof(uint32_t));
+    ftl->validCount = (uint16_t *)calloc(nand->blockCount, sizeof(uint16_t));
+    ftl->eraseCount = (uint32_t *)calloc(nand->blockCount, sizeof(uint32_t));
+    ftl->blockState = (uint8_t *)calloc(nand->blockCount, sizeof(uint8_t));
+    if (!ftl->pageBuffer)
+    {
+        ftl->pageBuffer = (uint8_t *)malloc(nand->pageSize);
+    }
+    ftl->cache = (ftl_map_slot_t *)calloc(slots, sizeof(ftl_map_slot_t));
+    entries = (uint32_t *)malloc(slots * nand->pageSize);
+    changed = (uint32_t *)calloc(slots * changedWords, sizeof(uint32_t));
+    if (ftl->cache)
+    {
+        ftl->cache[0].entries = entries;
+        ftl->cache[0].changed = changed;
+    }
+    if (!ftl->directory || !ftl->validCount || !ftl->eraseCount || !ftl->blockState
+        || !ftl->pageBuffer || !ftl->cache || !entries || !changed)
+    {
+        if (!ftl->cache)
+        {
+            free(entries);
+            free(changed);
+        }
+        ftl_free_tables(ftl);
+        return kFtlError;
+    }
+
+    memset(ftl->directory, 0xff, ftl->mapPages * sizeof(uint32_t));
+    for (i = 0; i < slots; ++i)
+    {
+        ftl->cache[i].index = FTL_UNMAPPED;
+        ftl->cache[i].entries = entries + i * ftl->entriesPerMapPage;
+        ftl->cache[i].changed = changed + i * changedWords;
+    }
+    return kFtlSuccess;
+}
+
+//! @brief Reset an FTL to the unmounted state for a NAND.
+static int ftl_setup(ftl_t * ftl, const ftl_nand_t * nand, const ftl_config_t * config)
+{
+    memset(ftl, 0, sizeof(*ftl));
+    ftl->nand = nand;
+    if (config)
+    {
+        ftl->config = *config;
+    }
+    else
+    {
+        ftl_get_default_config(&ftl->config);
+    }
+    if (ftl->config.mapCachePages < 2)
+    {
+        ftl->config.mapCachePages = 2;
+    }
+    ftl->entriesPerMapPage = nand->pageSize / sizeof(uint32_t);
+    ftl->activeBlock = FTL_NO_BLOCK;
+    ftl->checkpointBlock = FTL_NO_BLOCK;
+
+    // Valid page counts are 16 bits, and map pages hold whole entries.
+    if (nand->pagesPerBlock < 2 || nand->pagesPerBlock > 0xffff || nand->pageSize < 64
+        || (nand->pageSize % sizeof(uint32_t))
+        || nand->blockCount < FTL_CHECKPOINT_BLOCKS + FTL_GC_RESERVE_BLOCKS + 2)
+    {
+        return kFtlInvalid;
+    }
+    return kFtlSuccess;
+}
+
+void ftl_get_default_config(ftl_config_t * config)
+{
+    config->mapCachePages = 16;
+    config->reservePercent = 5;
+    config->checkpointInterval = 32;
+    config->backgroundFreeBlocks = 8;
+    config->wearLevelThreshold = 200;
+}
+
+int ftl_format(ftl_t * ftl, const ftl_nand_t * nand, const ftl_config_t * config)
+{
+    uint32_t goodBlocks = 0;
+    uint32_t checkpointBlocks = 0;
+    uint32_t reserve;
+    uint32_t block;
+    int status = ftl_setup(ftl, nand, config);
+
+    if (status != kFtlSuccess)
+    {
+        return status;
+    }
+
+    for (block = FTL_CHECKPOINT_BLOCKS; block < nand->blockCount; ++block)
+    {
+        if (!nand->isBad(nand, block))
+        {
+            ++goodBlocks;
+        }
+    }
+
+    // Keep a share of the blocks as slack for garbage collection and for blocks going bad.
+    reserve = goodBlocks * ftl->config.reservePercent / 100;
+    if (reserve < FTL_GC_RESERVE_BLOCKS + 2)
+    {
+        reserve = FTL_GC_RESERVE_BLOCKS + 2;
+    }
+    if (goodBlocks <= reserve)
+    {
+        return kFtlInvalid;
+    }
+
+    // The map pages live in the log as well.
+    ftl->logicalPages = (goodBlocks - reserve) * nand->pagesPerBlock;
+    ftl->mapPages = (ftl->logicalPages + ftl->entriesPerMapPage - 1) / ftl->entriesPerMapPage;
+    ftl->logicalPages -= ftl->mapPages;
+    ftl->mapPages = (ftl->logicalPages + ftl->entriesPerMapPage - 1) / ftl->entriesPerMapPage;
+    if (ftl_checkpoint_pages(ftl, ftl->config.mapCachePages * (sizeof(ftl_journal_header_t) + nand->pageSize))
+        > nand->pagesPerBlock)
+    {
+        return kFtlInvalid;
+    }
+
+    status = ftl_alloc_tables(ftl);
+    if (status != kFtlSuccess)
+    {
+        return status;
+    }
+
+    // Erase everything, so no stale page can be mistaken for part of the new log.
+    for (block = 0; block < nand->blockCount; ++block)
+    {
+        if (nand->isBad(nand, block))
+        {
+            ftl->blockState[block] = kFtlBlockBad;
+        }
+        else if (ftl_erase_block(ftl, block))
+        {
+            if (block < FTL_CHECKPOINT_BLOCKS)
+            {
+                ftl->blockState[block] = kFtlBlockCheckpoint;
+                ++checkpointBlocks;
+            }
+            else
+            {
+                ftl->blockState[block] = kFtlBlockFree;
+                ++ftl->freeBlocks;
+            }
+        }
+    }
+
+    ftl->sequence = 1;
+    status = (checkpointBlocks >= 2) ? ftl_checkpoint(ftl) : kFtlInvalid;
+    if (status != kFtlSuccess)
+    {
+        ftl_free_tables(ftl);
+    }
+    return status;
+}
+
+//! @brief Whether a page is erased, which unreadable pages are not.
+static bool ftl_page_is_erased(ftl_t * ftl, uint32_t page, uint32_t * sequence)
+{
+    ftl_spare_t spare;
+
+    if (ftl_nand_read(ftl, page, NULL, &spare) != kFtlNandSuccess)
+    {
+        return false;
+    }
+    if (sequence && spare.type != kFtlPageErased)
+    {
+        *sequence = spare.sequence;
+    }
+    return spare.type == kFtlPageErased;
+}
+
+//! @brief Number of pages written to a block, found by bisection since they are in order.
+static uint32_t ftl_written_pages(ftl_t * ftl, uint32_t block, uint32_t start)
+{
+    uint32_t ppb = ftl->nand->pagesPerBlock;
+    uint32_t low = start;
+    uint32_t high = ppb;
+
+    while (low < high)
+    {
+        uint32_t middle = (low + high) / 2;
+        if (ftl_page_is_erased(ftl, block * ppb + middle, NULL))
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return low;
+}
+
+//! @brief Read the journal of a checkpoint into the cache.
+//!
+//! Only the changed entries are filled in, the rest of each map page is read once the
+//! checkpoint has been verified.
+static void ftl_read_journal(ftl_t * ftl, ftl_stream_t * stream, uint32_t journalPages)
+{
+    uint32_t i;
+
+    for (i = 0; i < ftl->config.mapCachePages; ++i)
+    {
+        ftl_map_slot_t * slot = &ftl->cache[i];
+
+        slot->index = FTL_UNMAPPED;
+        slot->lastUse = 0;
+        slot->changedEntries = 0;
+        memset(slot->changed, 0, ftl_changed_bytes(ftl));
+    }
+
+    for (i = 0; i < journalPages && stream->status == kFtlSuccess; ++i)
+    {
+        ftl_map_slot_t * slot = &ftl->cache[i];
+        ftl_journal_header_t record;
+        ftl_journal_entry_t entry;
+        uint32_t j;
+
+        ftl_stream_read(ftl, stream, &record, sizeof(record));
+        if (record.index >= ftl->mapPages || record.count > ftl->entriesPerMapPage)
+        {
+            stream->status = kFtlError;
+            break;
+        }
+        slot->index = record.index;
+        slot->lastUse = ++ftl->cacheClock;
+
+        if (record.count == ftl->entriesPerMapPage)
+        {
+            ftl_stream_read(ftl, stream, slot->entries, ftl->nand->pageSize);
+            for (j = 0; j < ftl->entriesPerMapPage; ++j)
+            {
+                ftl_set_changed(slot, j);
+            }
+            continue;
+        }
+        for (j = 0; j < record.count && stream->status == kFtlSuccess; ++j)
+        {
+            ftl_stream_read(ftl, stream, &entry, sizeof(entry));
+            if (entry.offset >= ftl->entriesPerMapPage)
+            {
+                stream->status = kFtlError;
+                break;
+            }
+            slot->entries[entry.offset] = entry.page;
+            ftl_set_changed(slot, entry.offset);
+        }
+    }
+}
+
+//! @brief Fill in the unchanged entries of the journaled map pages from the log.
+static int ftl_merge_journal(ftl_t * ftl, uint32_t journalPages)
+{
+    const uint32_t * stored = (const uint32_t *)ftl->pageBuffer;
+    uint32_t i;
+
+    for (i = 0; i < journalPages; ++i)
+    {
+        ftl_map_slot_t * slot = &ftl->cache[i];
+        uint32_t page = ftl->directory[slot->index];
+        uint32_t j;
+
+        if (slot->changedEntries == ftl->entriesPerMapPage)
+        {
+            continue;
+        }
+        if (page == FTL_UNMAPPED)
+        {
+            memset(ftl->pageBuffer, 0xff, ftl->nand->pageSize);
+        }
+        else
+        {
+            ftl_spare_t spare;
+            if (page >= ftl->nand->blockCount * ftl->nand->pagesPerBlock
+                || ftl_nand_read(ftl, page, ftl->pageBuffer, &spare) != kFtlNandSuccess)
+            {
+                return kFtlError;
+            }
+            ++ftl->stats.mapReads;
+        }
+        for (j = 0; j < ftl->entriesPerMapPage; ++j)
+        {
+            if (!ftl_is_changed(slot, j))
+            {
+                slot->entries[j] = stored[j];
+            }
+        }
+    }
+    return kFtlSuccess;
+}
+
+//! @brief Load a checkpoint ending with a commit page.
+static int ftl_load_checkpoint(ftl_t * ftl, uint32_t commitPage, uint32_t * sequence)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    ftl_checkpoint_header_t header;
+    ftl_stream_t stream;
+    ftl_commit_t commit;
+    ftl_spare_t spare;
+
+    if (ftl_nand_read(ftl, commitPage, ftl->pageBuffer, &spare) != kFtlNandSuccess || spare.type != kFtlPageCommit)
+    {
+        return kFtlError;
+    }
+    memcpy(&commit, ftl->pageBuffer + nand->pageSize - sizeof(commit), sizeof(commit));
+    if (commit.magic != FTL_CHECKPOINT_MAGIC || commit.pages != spare.id
+        || commit.pages > commitPage % nand->pagesPerBlock)
+    {
+        return kFtlError;
+    }
+
+    memset(&stream, 0, sizeof(stream));
+    stream.firstPage = commitPage - commit.pages;
+    ftl_stream_read(ftl, &stream, &header, sizeof(header));
+    if (stream.status != kFtlSuccess || header.magic != FTL_CHECKPOINT_MAGIC
+        || header.version != FTL_CHECKPOINT_VERSION || header.pageSize != nand->pageSize
+        || header.pagesPerBlock != nand->pagesPerBlock || header.blockCount != nand->blockCount)
+    {
+        return kFtlError;
+    }
+
+    // The journaled map pages have to fit into the cache again.
+    if (header.journalPages > ftl->config.mapCachePages)
+    {
+        return kFtlInvalid;
+    }
+    if (!ftl->directory)
+    {
+        ftl->logicalPages = header.logicalPages;
+        ftl->mapPages = header.mapPages;
+        if (ftl_checkpoint_bytes(ftl, header.journalBytes) != commit.bytes || ftl_alloc_tables(ftl) != kFtlSuccess)
+        {
+            return kFtlError;
+        }
+    }
+    else if (header.logicalPages != ftl->logicalPages || header.mapPages != ftl->mapPages)
+    {
+        return kFtlError;
+    }
+
+    ftl_stream_read(ftl, &stream, ftl->directory, ftl->mapPages * sizeof(uint32_t));
+    ftl_stream_read(ftl, &stream, ftl->eraseCount, nand->blockCount * sizeof(uint32_t));
+    ftl_stream_read(ftl, &stream, ftl->validCount, nand->blockCount * sizeof(uint16_t));
+    ftl_stream_read(ftl, &stream, ftl->blockState, nand->blockCount);
+    ftl_read_journal(ftl, &stream, header.journalPages);
+    if (stream.status != kFtlSuccess || stream.crc != commit.crc)
+    {
+        return kFtlError;
+    }
+    if (ftl_merge_journal(ftl, header.journalPages) != kFtlSuccess)
+    {
+        return kFtlError;
+    }
+
+    // New pages have to come after everything in the checkpoint block.
+    if (spare.sequence + nand->pagesPerBlock > ftl->sequence)
+    {
+        ftl->sequence = spare.sequence + nand->pagesPerBlock;
+    }
+    ftl->activeBlock = header.activeBlock;
+    ftl->activePage = header.activePage;
+    *sequence = header.sequence;
+    return kFtlSuccess;
+}
+
+//! @brief Find and load the newest valid checkpoint.
+static int ftl_find_checkpoint(ftl_t * ftl, uint32_t * checkpointSequence)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    uint32_t firstSequence[FTL_CHECKPOINT_BLOCKS];
+    bool isCandidate[FTL_CHECKPOINT_BLOCKS];
+    uint32_t block;
+
+    // Checkpoint blocks are tried newest first, by the sequence number of their first page.
+    for (block = 0; block < FTL_CHECKPOINT_BLOCKS; ++block)
+    {
+        ftl_spare_t spare = { kFtlPageErased, 0, 0 };
+        isCandidate[block] = !nand->isBad(nand, block)
+            && ftl_nand_read(ftl, block * nand->pagesPerBlock, NULL, &spare) == kFtlNandSuccess
+            && (spare.type == kFtlPageCheckpoint || spare.type == kFtlPageCommit);
+        firstSequence[block] = spare.sequence;
+        ++ftl->stats.nandReads;
+        if (isCandidate[block] && spare.sequence + nand->pagesPerBlock > ftl->sequence)
+        {
+            ftl->sequence = spare.sequence + nand->pagesPerBlock;
+        }
+    }
+
+    for (;;)
+    {
+        uint32_t newest = FTL_NO_BLOCK;
+        uint32_t written;
+        uint32_t page;
+
+        for (block = 0; block < FTL_CHECKPOINT_BLOCKS; ++block)
+        {
+            if (isCandidate[block] && (newest == FTL_NO_BLOCK || firstSequence[block] > firstSequence[newest]))
+            {
+                newest = block;
+            }
+        }
+        if (newest == FTL_NO_BLOCK)
+        {
+            return kFtlNotFormatted;
+        }
+        isCandidate[newest] = false;
+
+        // Try the commit pages from the last one backwards.
+        written = ftl_written_pages(ftl, newest, 1);
+        for (page = written; page-- > 0;)
+        {
+            int status = ftl_load_checkpoint(ftl, newest * nand->pagesPerBlock + page, checkpointSequence);
+            if (status == kFtlSuccess)
+            {
+                ftl->checkpointBlock = newest;
+                ftl->checkpointPage = written;
+                return kFtlSuccess;
+            }
+
+            // An older checkpoint would silently lose data.
+            if (status == kFtlInvalid)
+            {
+                return status;
+            }
+        }
+    }
+}
+
+//! @brief Replay the data pages of a block from a page on.
+static int ftl_replay_block(ftl_t * ftl, uint32_t block, uint32_t start, uint32_t end, uint32_t checkpointSequence)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    uint32_t i;
+
+    for (i = start; i < end; ++i)
+    {
+        uint32_t page = block * nand->pagesPerBlock + i;
+        ftl_map_slot_t * slot;
+        ftl_spare_t spare;
+        int status = ftl_nand_read(ftl, page, NULL, &spare);
+
+        if (status == kFtlNandEccError)
+        {
+            continue;
+        }
+        if (status != kFtlNandSuccess)
+        {
+            return kFtlError;
+        }
+        if (spare.type == kFtlPageErased)
+        {
+            break;
+        }
+        if (spare.sequence + 1 > ftl->sequence)
+        {
+            ftl->sequence = spare.sequence + 1;
+        }
+
+        // Map pages written since the checkpoint are redundant with the data pages.
+        if (spare.type != kFtlPageData || spare.id >= ftl->logicalPages || spare.sequence < checkpointSequence)
+        {
+            continue;
+        }
+
+        slot = ftl_map_load(ftl, spare.id / ftl->entriesPerMapPage, &status);
+        if (!slot)
+        {
+            return status;
+        }
+        ftl_map_update(ftl, slot, spare.id, page);
+        ++ftl->validCount[block];
+        ++ftl->stats.replayedPages;
+    }
+    return kFtlSuccess;
+}
+
+int ftl_mount(ftl_t * ftl, const ftl_nand_t * nand, const ftl_config_t * config)
+{
+    uint32_t checkpointSequence = 0;
+    uint32_t * chain = NULL;
+    uint32_t chainLength = 0;
+    uint32_t checkpointActive;
+    uint32_t checkpointPage;
+    uint32_t lastBlock;
+    uint32_t lastStart;
+    uint32_t lastEnd;
+    uint32_t block;
+    uint32_t i;
+    int status = ftl_setup(ftl, nand, config);
+
+    // The checkpoint is read through the page buffer before the tables are allocated.
+    if (status == kFtlSuccess)
+    {
+        ftl->pageBuffer = (uint8_t *)malloc(nand->pageSize);
+        status = ftl->pageBuffer ? ftl_find_checkpoint(ftl, &checkpointSequence) : kFtlError;
+    }
+    if (status != kFtlSuccess)
+    {
+        ftl_free_tables(ftl);
+        return status;
+    }
+
+    // Finish retiring blocks and count the free ones.
+    for (block = FTL_CHECKPOINT_BLOCKS; block < nand->blockCount; ++block)
+    {
+        if (ftl_block_state(ftl, block) == kFtlBlockFree)
+        {
+            ++ftl->freeBlocks;
+        }
+    }
+    ftl_release_pending(ftl);
+
+    // Follow the allocation order through the blocks written since the checkpoint.
+    chain = (uint32_t *)malloc(nand->blockCount * sizeof(uint32_t));
+    if (!chain)
+    {
+        ftl_free_tables(ftl);
+        return kFtlError;
+    }
+    while ((block = ftl_next_free_block(ftl)) != FTL_NO_BLOCK)
+    {
+        uint32_t sequence = 0;
+
+        ++ftl->stats.nandReads;
+        if (nand->isBad(nand, block))
+        {
+            ftl->blockState[block] = kFtlBlockBad;
+            --ftl->freeBlocks;
+            continue;
+        }
+        if (ftl_page_is_erased(ftl, block * nand->pagesPerBlock, &sequence) || sequence < checkpointSequence)
+        {
+            break;
+        }
+        ftl->blockState[block] = kFtlBlockUsed;
+        ftl->validCount[block] = 0;
+        ++ftl->eraseCount[block];
+        --ftl->freeBlocks;
+        chain[chainLength++] = block;
+    }
+
+    // New pages go after the last page written, so find that before replaying.
+    checkpointActive = ftl->activeBlock;
+    checkpointPage = ftl->activePage;
+    if (chainLength)
+    {
+        lastBlock = chain[chainLength - 1];
+        lastStart = 0;
+    }
+    else
+    {
+        lastBlock = ftl->activeBlock;
+        lastStart = ftl->activePage;
+    }
+    lastEnd = lastStart;
+    if (lastBlock != FTL_NO_BLOCK)
+    {
+        lastEnd = ftl_written_pages(ftl, lastBlock, lastStart);
+    }
+
+    // Map pages evicted while replaying are appended after that.
+    ftl->isReplaying = true;
+    ftl->activeBlock = lastBlock;
+    ftl->activePage = lastEnd;
+    if (chainLength && checkpointActive != FTL_NO_BLOCK)
+    {
+        status = ftl_replay_block(ftl, checkpointActive, checkpointPage, nand->pagesPerBlock, checkpointSequence);
+    }
+    for (i = 0; i + 1 < chainLength && status == kFtlSuccess; ++i)
+    {
+        status = ftl_replay_block(ftl, chain[i], 0, nand->pagesPerBlock, checkpointSequence);
+    }
+    if (status == kFtlSuccess && lastBlock != FTL_NO_BLOCK)
+    {
+        status = ftl_replay_block(ftl, lastBlock, lastStart, lastEnd, checkpointSequence);
+    }
+    ftl->isReplaying = false;
+    free(chain);
+
+    if (status == kFtlSuccess && (chainLength || lastEnd != lastStart))
+    {
+        for (block = FTL_CHECKPOINT_BLOCKS; block < nand->blockCount; ++block)
+        {
+            ftl_check_empty(ftl, block);
+        }
+        ftl->blocksSinceCheckpoint = chainLength;
+        status = ftl_checkpoint(ftl);
+    }
+    ftl->checkpointSequence = ftl->sequence;
+    ftl->stats.mountReads = ftl->stats.nandReads;
+
+    if (status != kFtlSuccess)
+    {
+        ftl_free_tables(ftl);
+    }
+    return status;
+}
+
+int ftl_sync(ftl_t * ftl)
+{
+    if (ftl->sequence == ftl->checkpointSequence && !ftl->pendingBlocks)
+    {
+        return kFtlSuccess;
+    }
+    return ftl_checkpoint(ftl);
+}
+
+int ftl_unmount(ftl_t * ftl)
+{
+    int status = ftl_sync(ftl);
+
+    ftl_free_tables(ftl);
+    return status;
+}
+
+int ftl_read(ftl_t * ftl, uint32_t page, uint32_t count, void * buffer)
+{
+    uint8_t * data = (uint8_t *)buffer;
+    int result = kFtlSuccess;
+
+    if (page >= ftl->logicalPages || count > ftl->logicalPages - page)
+    {
+        return kFtlInvalid;
+    }
+
+    for (; count; --count, ++page, data += ftl->nand->pageSize)
+    {
+        uint32_t physical = FTL_UNMAPPED;
+        ftl_spare_t spare;
+        int status = ftl_map_lookup(ftl, page, &physical);
+
+        if (status != kFtlSuccess)
+        {
+            return status;
+        }
+
+        ++ftl->stats.hostReads;
+        if (physical == FTL_UNMAPPED)
+        {
+            memset(data, 0xff, ftl->nand->pageSize);
+        }
+        else if (ftl_nand_read(ftl, physical, data, &spare) != kFtlNandSuccess)
+        {
+            result = kFtlError;
+        }
+    }
+    return result;
+}
+
+int ftl_write(ftl_t * ftl, uint32_t page, uint32_t count, const void * buffer)
+{
+    const uint8_t * data = (const uint8_t *)buffer;
+
+    if (page >= ftl->logicalPages || count > ftl->logicalPages - page)
+    {
+        return kFtlInvalid;
+    }
+
+    for (; count; --count, ++page, data += ftl->nand->pageSize)
+    {
+        int status = ftl_make_space(ftl);
+        if (status == kFtlSuccess)
+        {
+            status = ftl_write_page(ftl, kFtlPageData, page, data);
+        }
+        if (status == kFtlSuccess && ftl->blocksSinceCheckpoint >= ftl->config.checkpointInterval)
+        {
+            status = ftl_checkpoint(ftl);
+        }
+        if (status != kFtlSuccess)
+        {
+            return status;
+        }
+        ++ftl->stats.hostWrites;
+    }
+    return kFtlSuccess;
+}
+
+bool ftl_background(ftl_t * ftl)
+{
+    const ftl_nand_t * nand = ftl->nand;
+    uint32_t victim = FTL_NO_BLOCK;
+    uint32_t coldest = FTL_NO_BLOCK;
+    uint32_t maxErase = 0;
+    uint32_t * counter = NULL;
+    bool isBusy = false;
+    uint32_t block;
+
+    for (block = FTL_CHECKPOINT_BLOCKS; block < nand->blockCount; ++block)
+    {
+        uint32_t state = ftl_block_state(ftl, block);
+        if (state == kFtlBlockBad)
+        {
+            continue;
+        }
+        if (ftl->eraseCount[block] > maxErase)
+        {
+            maxErase = ftl->eraseCount[block];
+        }
+        if (state != kFtlBlockUsed || block == ftl->activeBlock)
+        {
+            continue;
+        }
+        if (victim == FTL_NO_BLOCK && (ftl->blockState[block] & (kFtlBlockRefresh | kFtlBlockRetire)))
+        {
+            victim = block;
+        }
+        if (coldest == FTL_NO_BLOCK || ftl->eraseCount[block] < ftl->eraseCount[coldest])
+        {
+            coldest = block;
+        }
+    }
+
+    // Wear leveling goes before reclaiming space, which the write path does anyway.
+    if (victim != FTL_NO_BLOCK)
+    {
+        counter = &ftl->stats.refreshBlocks;
+    }
+    else if (coldest != FTL_NO_BLOCK && ftl->config.wearLevelThreshold
+        && maxErase - ftl->eraseCount[coldest] > ftl->config.wearLevelThreshold)
+    {
+        victim = coldest;
+        counter = &ftl->stats.wearLevelBlocks;
+    }
+    else if (ftl->freeBlocks + ftl->pendingBlocks < ftl->config.backgroundFreeBlocks)
+    {
+        victim = ftl_pick_victim(ftl);
+    }
+
+    // Moving a block may take two new ones, so leave the write path its reserve.
+    if (victim != FTL_NO_BLOCK && ftl->freeBlocks > FTL_GC_RESERVE_BLOCKS)
+    {
+        if (ftl_collect(ftl, victim) != kFtlSuccess)
+        {
+            return false;
+        }
+        if (counter)
+        {
+            ++*counter;
+        }
+        isBusy = true;
+    }
+
+    // Every checkpoint wears the few checkpoint blocks, so pending blocks are batched up.
+    if (ftl->pendingBlocks >= FTL_GC_RESERVE_BLOCKS || (ftl->pendingBlocks && ftl->freeBlocks <= FTL_GC_RESERVE_BLOCKS))
+    {
+        return ftl_checkpoint(ftl) == kFtlSuccess;
+    }
+    return isBusy;
+}
+
+//! @brief Transfer the bios of a request one after the other and complete it.
+static int ftl_blk_submit(blk_device_t * device, blk_request_t * request)
+{
+    ftl_t * ftl = (ftl_t *)device->context;
+    uint32_t page = request->sector;
+    int status = kBlkSuccess;
+    blk_bio_t * bio;
+
+    for (bio = request->bios; bio && status == kBlkSuccess; bio = bio->next)
+    {
+        int result;
+
+        if (request->op == kBlkRead)
+        {
+            result = ftl_read(ftl, page, bio->count, bio->buffer);
+        }
+        else
+        {
+            result = ftl_write(ftl, page, bio->count, bio->buffer);
+        }
+        if (result == kFtlInvalid)
+        {
+            status = kBlkInvalid;
+        }
+        else if (result != kFtlSuccess)
+        {
+            status = kBlkError;
+        }
+        page += bio->count;
+    }
+
+    blk_request_complete(request, status);
+    return kBlkSuccess;
+}
+
+void ftl_blk_device_init(blk_device_t * device, ftl_t * ftl)
+{
+    device->name = "ftl";
+    device->sectorSize = ftl->nand->pageSize;
+    device->sectorCount = ftl->logicalPages;
+    device->maxSectors = FTL_BLK_MAX_PAGES;
+    device->maxSegments = 0;
+    device->queueDepth = 1;
+    device->submit = ftl_blk_submit;
+    device->poll = NULL;
+    device->context = ftl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -54,14 +54,6 @@
 #undef errno
 extern int errno;
 
-//! @name Malloc heap extents
-//! 
-//! Defined in the linker script.
-//@{
-extern int free_memory_start;
-extern int free_memory_end;
-//@}
-
 //! @name Environment
 //@{
 char * __env[1] = { 0 };
@@ -224,38 +216,19 @@ int _raw_puts(char str[])
 }
 
 /*!
- * @brief The low level system call upon which malloc is built.
- *
- * Here is a very simple implementation. The heap ranges from the variables
- * @i free_memory_start to @i free_memory_end that must be defined in the linker
- * script. Allocation starts at @i free_memory_start.
+ * @brief The low level system call upon which newlib's malloc is built.
  *
- * If we run out of memory, a message is printed and abort() is called.
+ * The heap between @i free_memory_start and @i free_memory_end belongs to the allocator
+ * in smp_malloc.c, which replaces newlib's malloc and does not use this call. Handing out
+ * the same memory here would corrupt it, so any other attempt to grow the heap fails.
  *
  * @param   nbytes  the number of bytes to be allocated from the heap
- * @return  the previous heap address
+ * @return  (caddr_t)-1 with errno set to ENOMEM
  */
 caddr_t _sbrk(int nbytes)
 {
-    static caddr_t heap_ptr = NULL;
-    caddr_t base;
-
-    if (heap_ptr == NULL)
-    {
-        heap_ptr = (caddr_t)&free_memory_start;
-    }
-
-    base = heap_ptr;
-    heap_ptr += nbytes;
-    
-    // Abort if we run out of memory.
-    if (heap_ptr > (caddr_t)&free_memory_end)
-    {
-        _write(1, "** Heap ran out of memory! **\n", 24);
-        abort();
-    }
-    
-    return base;
+    errno = ENOMEM;
+    return (caddr_t)-1;
 }
 
 __attribute__ ((noreturn)) void _exit(int status)
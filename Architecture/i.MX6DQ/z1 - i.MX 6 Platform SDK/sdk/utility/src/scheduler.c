@@ -0,0 +1,669 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file scheduler.c
+ * @brief Work-stealing task scheduler.
+ *
+ * The queues follow "Correct and Efficient Work-Stealing for Weak Memory Models" by Le,
+ * Pop, Cohen and Zappa Nardelli, which places the barriers a Chase-Lev deque needs on ARM.
+ */
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#else
+#include "sdk.h"
+#include "core/cortex_a9.h"
+#include "core/gic.h"
+#include "core/interrupt.h"
+#include "cpu_utility/cpu_utility.h"
+#endif
+#include "utility/atomics.h"
+#include "utility/scheduler.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Number of rounds an idle worker tries to steal before going to sleep.
+#define SCHEDULER_SPIN_ROUNDS (64)
+
+//! @brief Priority of the wake-up interrupt.
+#define SCHEDULER_IRQ_PRIORITY (0)
+
+#define SCHEDULER_QUEUE_MASK (SCHEDULER_QUEUE_SIZE - 1)
+
+#if (SCHEDULER_QUEUE_SIZE & SCHEDULER_QUEUE_MASK) != 0
+#error "SCHEDULER_QUEUE_SIZE must be a power of two"
+#endif
+
+//! @brief Full memory barrier between the cores.
+#if defined(__linux__)
+#define SCHEDULER_BARRIER() __sync_synchronize()
+#else
+#define SCHEDULER_BARRIER() __asm__ volatile ("dmb" : : : "memory")
+#endif
+
+//! @brief Called when a worker found nothing to run.
+//!
+//! On the target each worker has its own core. On Linux there may be more worker threads than
+//! CPUs, and a thread spinning away its time slice would keep the one holding the task it
+//! waits for off the CPU.
+#if defined(__linux__)
+#define SCHEDULER_RELAX() sched_yield()
+#else
+#define SCHEDULER_RELAX() do { } while (0)
+#endif
+
+//! @brief A queued task.
+typedef struct _task_entry {
+    task_function_t function;   //!< Function to run.
+    void * arg;                 //!< Argument of the function.
+    task_group_t * group;       //!< Group whose pending count drops once the task is done.
+} task_entry_t;
+
+//! @brief State of one worker.
+//!
+//! The top index is written by thieves and the bottom index by the owner, so each has its own
+//! cache line to avoid false sharing.
+typedef struct _scheduler_worker {
+    volatile uint32_t top;          //!< Index of the oldest task, where thieves steal.
+    uint32_t _topFiller[7];         //!< Padding to the end of the cache line.
+    volatile uint32_t bottom;       //!< Index past the newest task, only written by the owner.
+    uint32_t _bottomFiller[7];      //!< Padding to the end of the cache line.
+    task_entry_t tasks[SCHEDULER_QUEUE_SIZE];   //!< Circular array of tasks.
+    uint32_t random;                //!< State of the generator used to pick victims.
+    scheduler_stats_t stats;        //!< Statistics, only written by the owner.
+#if defined(__linux__)
+    pthread_t thread;               //!< Thread running the worker.
+#endif
+} __attribute__ ((aligned (32))) scheduler_worker_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Workers, indexed by core number.
+static scheduler_worker_t s_workers[SCHEDULER_MAX_WORKERS];
+
+//! @brief Number of started workers.
+static uint32_t s_workerCount = 1;
+
+//! @brief Mask of workers that are asleep or about to sleep.
+static volatile uint32_t s_sleepingWorkers;
+
+//! @brief Number of secondary workers that are running.
+static volatile int32_t s_activeWorkers;
+
+//! @brief Set by scheduler_stop() to make the workers exit.
+static volatile uint32_t s_isStopping;
+
+//! @brief Per-core setup function passed to scheduler_start().
+static scheduler_cpu_init_t s_cpuInit;
+
+#if defined(__linux__)
+//! @brief Index of the worker the current thread runs.
+static __thread uint32_t s_currentWorker;
+
+//! @brief Protects sleeping workers against missed wake-ups.
+static pthread_mutex_t s_sleepMutex = PTHREAD_MUTEX_INITIALIZER;
+
+//! @brief Signalled to wake sleeping workers.
+static pthread_cond_t s_wakeCondition = PTHREAD_COND_INITIALIZER;
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Push a task at the bottom of the owner's queue.
+//! @retval false The queue is full.
+static bool queue_push(scheduler_worker_t * worker, const task_entry_t * entry)
+{
+    uint32_t b = worker->bottom;
+    uint32_t t = worker->top;
+
+    // A stale top only makes the queue look fuller than it is.
+    if ((int32_t)(b - t) >= SCHEDULER_QUEUE_SIZE)
+    {
+        return false;
+    }
+
+    worker->tasks[b & SCHEDULER_QUEUE_MASK] = *entry;
+
+    // Publish the task before the new bottom.
+    SCHEDULER_BARRIER();
+    worker->bottom = b + 1;
+
+    return true;
+}
+
+//! @brief Pop the newest task from the bottom of the owner's queue.
+//! @retval false The queue is empty, or a thief took its last task.
+static bool queue_take(scheduler_worker_t * worker, task_entry_t * entry)
+{
+    uint32_t b = worker->bottom - 1;
+    uint32_t t;
+    bool isTaken = true;
+
+    // Reserve the bottom task before looking at top, so a thief either sees the reservation
+    // or the owner sees the thief's increment of top.
+    worker->bottom = b;
+    SCHEDULER_BARRIER();
+    t = worker->top;
+
+    if ((int32_t)(b - t) < 0)
+    {
+        // Empty queue.
+        worker->bottom = b + 1;
+        return false;
+    }
+
+    *entry = worker->tasks[b & SCHEDULER_QUEUE_MASK];
+
+    if (b == t)
+    {
+        // This is the last task, race the thieves for it.
+        isTaken = atomic_compare_and_swap(&worker->top, t, t + 1);
+        worker->bottom = b + 1;
+    }
+
+    return isTaken;
+}
+
+//! @brief Steal the oldest task from the top of another worker's queue.
+//! @retval false The queue is empty, or another worker took the task first.
+static bool queue_steal(scheduler_worker_t * worker, task_entry_t * entry)
+{
+    uint32_t t = worker->top;
+    uint32_t b;
+    task_entry_t stolen;
+
+    SCHEDULER_BARRIER();
+    b = worker->bottom;
+
+    if ((int32_t)(b - t) <= 0)
+    {
+        return false;
+    }
+
+    // Read the task only after the bottom index that published it.
+    SCHEDULER_BARRIER();
+    stolen = worker->tasks[t & SCHEDULER_QUEUE_MASK];
+
+    if (!atomic_compare_and_swap(&worker->top, t, t + 1))
+    {
+        return false;
+    }
+
+    *entry = stolen;
+    return true;
+}
+
+//! @brief Returns whether any queue holds a task.
+static bool scheduler_has_work(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < s_workerCount; ++i)
+    {
+        if ((int32_t)(s_workers[i].bottom - s_workers[i].top) > 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//! @brief Try to steal a task from the other workers, starting at a random victim.
+static bool scheduler_steal(uint32_t self, task_entry_t * entry)
+{
+    scheduler_worker_t * worker = &s_workers[self];
+    uint32_t count = s_workerCount;
+    uint32_t victim;
+    uint32_t i;
+
+    if (count < 2)
+    {
+        return false;
+    }
+
+    // xorshift32
+    worker->random ^= worker->random << 13;
+    worker->random ^= worker->random >> 17;
+    worker->random ^= worker->random << 5;
+    victim = worker->random % count;
+
+    for (i = 0; i < count; ++i, victim = (victim + 1) % count)
+    {
+        if (victim == self)
+        {
+            continue;
+        }
+
+        ++worker->stats.stealAttempts;
+        if (queue_steal(&s_workers[victim], entry))
+        {
+            ++worker->stats.stolen;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//! @brief Get a task from the worker's own queue, or steal one.
+static bool scheduler_find_task(uint32_t self, task_entry_t * entry)
+{
+    return queue_take(&s_workers[self], entry) || scheduler_steal(self, entry);
+}
+
+//! @brief Run a task and mark it finished in its group.
+static void scheduler_run_task(uint32_t self, const task_entry_t * entry)
+{
+    task_group_t * group = entry->group;
+
+    entry->function(entry->arg);
+    ++s_workers[self].stats.executed;
+
+    // The barrier in atomic_decrement() makes the task's results visible before the count drops.
+    atomic_decrement(&group->pending);
+}
+
+//! @brief Wake the workers in @a mask.
+static void scheduler_wake(uint32_t mask)
+{
+#if defined(__linux__)
+    (void)mask;
+    pthread_mutex_lock(&s_sleepMutex);
+    pthread_cond_broadcast(&s_wakeCondition);
+    pthread_mutex_unlock(&s_sleepMutex);
+#else
+    gic_send_sgi(SCHEDULER_SGI, mask, kGicSgiFilter_UseTargetList);
+#endif
+}
+
+//! @brief Wake the workers that are asleep, if any.
+//!
+//! The mask is cleared while taking it, so each sleeper is woken once instead of once per
+//! task spawned until it gets to run. A worker sets its bit again before it goes back to sleep.
+static void scheduler_wake_sleepers(void)
+{
+    uint32_t mask;
+
+    do {
+        mask = s_sleepingWorkers;
+        if (!mask)
+        {
+            return;
+        }
+    } while (!atomic_compare_and_swap(&s_sleepingWorkers, mask, 0));
+
+    scheduler_wake(mask);
+}
+
+//! @brief Set or clear the bit of a worker in the sleeping mask.
+static void scheduler_set_sleeping(uint32_t self, bool isSleeping)
+{
+    uint32_t mask;
+
+    do {
+        mask = s_sleepingWorkers;
+    } while (!atomic_compare_and_swap(&s_sleepingWorkers, mask,
+        isSleeping ? (mask | (1 << self)) : (mask & ~(1 << self))));
+}
+
+//! @brief Put an idle worker to sleep until a task is spawned or the scheduler stops.
+//!
+//! The worker announces itself in the sleeping mask before checking the queues one last time,
+//! and spawners check the mask after pushing, so either the worker sees the task or the
+//! spawner sees the worker and wakes it.
+static void scheduler_sleep(uint32_t self)
+{
+#if defined(__linux__)
+    pthread_mutex_lock(&s_sleepMutex);
+    scheduler_set_sleeping(self, true);
+    SCHEDULER_BARRIER();
+    if (!s_isStopping && !scheduler_has_work())
+    {
+        ++s_workers[self].stats.sleeps;
+        pthread_cond_wait(&s_wakeCondition, &s_sleepMutex);
+    }
+    scheduler_set_sleeping(self, false);
+    pthread_mutex_unlock(&s_sleepMutex);
+#else
+    // With IRQs masked a pending wake-up still ends WFI, it is just taken after re-enabling.
+    arm_set_interrupt_state(false);
+    scheduler_set_sleeping(self, true);
+    SCHEDULER_BARRIER();
+    if (!s_isStopping && !scheduler_has_work())
+    {
+        ++s_workers[self].stats.sleeps;
+        _ARM_WFI();
+    }
+    scheduler_set_sleeping(self, false);
+    arm_set_interrupt_state(true);
+#endif
+}
+
+//! @brief Main loop of the secondary workers.
+static void scheduler_worker_loop(uint32_t self)
+{
+    task_entry_t entry;
+    uint32_t idleRounds = 0;
+
+    atomic_increment(&s_activeWorkers);
+
+    while (!s_isStopping)
+    {
+        if (scheduler_find_task(self, &entry))
+        {
+            scheduler_run_task(self, &entry);
+            idleRounds = 0;
+        }
+        else if (++idleRounds >= SCHEDULER_SPIN_ROUNDS)
+        {
+            scheduler_sleep(self);
+            idleRounds = 0;
+        }
+        else
+        {
+            SCHEDULER_RELAX();
+        }
+    }
+
+    atomic_decrement(&s_activeWorkers);
+}
+
+#if defined(__linux__)
+//! @brief Thread entry point of the secondary workers.
+static void * scheduler_thread_entry(void * arg)
+{
+    uint32_t self = (uint32_t)(uintptr_t)arg;
+
+    s_currentWorker = self;
+    if (s_cpuInit)
+    {
+        s_cpuInit(self);
+    }
+
+    scheduler_worker_loop(self);
+    return NULL;
+}
+#else
+//! @brief Handler of the wake-up interrupt.
+//!
+//! Nothing to do, the interrupt only ends the WFI of a sleeping worker.
+static void scheduler_wake_isr(void)
+{
+}
+
+//! @brief Entry point of the secondary cores.
+static void scheduler_secondary_entry(void * arg)
+{
+    uint32_t cpu = cpu_get_current();
+
+    if (s_cpuInit)
+    {
+        s_cpuInit(cpu);
+    }
+
+    gic_init_cpu();
+    enable_interrupt(SCHEDULER_SGI, cpu, SCHEDULER_IRQ_PRIORITY);
+    arm_set_interrupt_state(true);
+
+    scheduler_worker_loop(cpu);
+
+    // Park until scheduler_stop() puts the core back into reset.
+    arm_set_interrupt_state(false);
+    while (1)
+    {
+        _ARM_WFI();
+    }
+}
+#endif
+
+uint32_t scheduler_start(uint32_t workerCount, scheduler_cpu_init_t cpuInit)
+{
+    uint32_t i;
+
+    if (workerCount > SCHEDULER_MAX_WORKERS)
+    {
+        workerCount = SCHEDULER_MAX_WORKERS;
+    }
+#if !defined(__linux__)
+    if (workerCount > cpu_get_cores())
+    {
+        workerCount = cpu_get_cores();
+    }
+#endif
+    if (workerCount == 0)
+    {
+        workerCount = 1;
+    }
+
+    for (i = 0; i < workerCount; ++i)
+    {
+        scheduler_worker_t * worker = &s_workers[i];
+
+        worker->top = 0;
+        worker->bottom = 0;
+        worker->random = 0x9e3779b9 * (i + 1);
+        worker->stats = (scheduler_stats_t){ 0 };
+    }
+
+    s_workerCount = workerCount;
+    s_sleepingWorkers = 0;
+    s_activeWorkers = 0;
+    s_isStopping = false;
+    s_cpuInit = cpuInit;
+
+    if (cpuInit)
+    {
+        cpuInit(0);
+    }
+
+#if defined(__linux__)
+    s_currentWorker = 0;
+    for (i = 1; i < workerCount; ++i)
+    {
+        pthread_create(&s_workers[i].thread, NULL, scheduler_thread_entry, (void *)(uintptr_t)i);
+    }
+#else
+    register_interrupt_routine(SCHEDULER_SGI, scheduler_wake_isr);
+    enable_interrupt(SCHEDULER_SGI, 0, SCHEDULER_IRQ_PRIORITY);
+
+    for (i = 1; i < workerCount; ++i)
+    {
+        cpu_start_secondary(i, scheduler_secondary_entry, NULL);
+    }
+#endif
+
+    // Wait for every worker to be up so scheduler_stop() can wait for them to go down.
+    while (s_activeWorkers != (int32_t)(workerCount - 1))
+    {
+    }
+
+    return workerCount;
+}
+
+void scheduler_stop(void)
+{
+    uint32_t i;
+
+    s_isStopping = true;
+    SCHEDULER_BARRIER();
+    scheduler_wake(((1 << s_workerCount) - 1) & ~1);
+
+    while (s_activeWorkers != 0)
+    {
+        // A worker may have gone back to sleep between the wake-up and reading the flag.
+        if (s_sleepingWorkers)
+        {
+            scheduler_wake(s_sleepingWorkers);
+        }
+    }
+
+    for (i = 1; i < s_workerCount; ++i)
+    {
+#if defined(__linux__)
+        pthread_join(s_workers[i].thread, NULL);
+#else
+        cpu_disable(i);
+#endif
+    }
+
+#if !defined(__linux__)
+    disable_interrupt(SCHEDULER_SGI, 0);
+#endif
+
+    s_workerCount = 1;
+}
+
+uint32_t scheduler_current_worker(void)
+{
+#if defined(__linux__)
+    return s_currentWorker;
+#else
+    return cpu_get_current();
+#endif
+}
+
+void scheduler_get_stats(uint32_t worker, scheduler_stats_t * stats)
+{
+    if (worker >= SCHEDULER_MAX_WORKERS)
+    {
+        return;
+    }
+
+    *stats = s_workers[worker].stats;
+    s_workers[worker].stats = (scheduler_stats_t){ 0 };
+}
+
+void task_group_init(task_group_t * group)
+{
+    group->pending = 0;
+}
+
+void task_spawn(task_group_t * group, task_function_t function, void * arg)
+{
+    uint32_t self = scheduler_current_worker();
+    scheduler_worker_t * worker = &s_workers[self];
+    task_entry_t entry = { function, arg, group };
+
+    atomic_increment(&group->pending);
+
+    if (!queue_push(worker, &entry))
+    {
+        ++worker->stats.inlined;
+        scheduler_run_task(self, &entry);
+        return;
+    }
+
+    // Pairs with the barrier in scheduler_sleep().
+    SCHEDULER_BARRIER();
+    scheduler_wake_sleepers();
+}
+
+void task_group_wait(task_group_t * group)
+{
+    uint32_t self = scheduler_current_worker();
+    task_entry_t entry;
+
+    while (group->pending != 0)
+    {
+        if (scheduler_find_task(self, &entry))
+        {
+            scheduler_run_task(self, &entry);
+        }
+        else
+        {
+            SCHEDULER_RELAX();
+        }
+    }
+
+    // Make the results of tasks run by other workers visible to the caller.
+    SCHEDULER_BARRIER();
+}
+
+//! @brief Range handed to a spawned half of a parallel_for().
+typedef struct _parallel_for_range {
+    uint32_t begin;
+    uint32_t end;
+    uint32_t grain;
+    parallel_for_body_t body;
+    void * arg;
+} parallel_for_range_t;
+
+//! @brief Split a range until it is no longer than the grain, spawning the upper halves.
+static void parallel_for_split(void * arg)
+{
+    parallel_for_range_t * range = (parallel_for_range_t *)arg;
+    parallel_for_range_t upper;
+    task_group_t group;
+
+    if (range->end - range->begin <= range->grain)
+    {
+        range->body(range->begin, range->end, range->arg);
+        return;
+    }
+
+    upper = *range;
+    upper.begin = range->begin + (range->end - range->begin) / 2;
+
+    task_group_init(&group);
+    task_spawn(&group, parallel_for_split, &upper);
+
+    // Keep working on the lower half, which stays hot in this core's cache.
+    {
+        parallel_for_range_t lower = *range;
+        lower.end = upper.begin;
+        parallel_for_split(&lower);
+    }
+
+    task_group_wait(&group);
+}
+
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, parallel_for_body_t body, void * arg)
+{
+    parallel_for_range_t range = { begin, end, grain ? grain : 1, body, arg };
+
+    if (begin < end)
+    {
+        parallel_for_split(&range);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,780 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file smp_malloc.c
+ * @brief Multicore heap allocator with per-core caches.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "utility/smp_malloc.h"
+#include "utility/spinlock.h"
+#if defined(__linux__)
+// Host builds, where the application provides cpu_get_current().
+int cpu_get_current(void);
+#else
+#include <reent.h>
+#include "core/cortex_a9.h"
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+#define SPAN_SHIFT (16)
+#define CACHE_LINE_SIZE (32)
+
+#if (1 << SPAN_SHIFT) != SMP_MALLOC_SPAN_SIZE
+#error "SPAN_SHIFT does not match SMP_MALLOC_SPAN_SIZE"
+#endif
+
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((uintptr_t)(a) - 1))
+
+//! @brief Offset of the first block in a span, after the span header.
+#define SPAN_HEADER_SIZE ALIGN_UP(sizeof(malloc_span_t), CACHE_LINE_SIZE)
+
+//! @brief Masks interrupts on the current core while the allocator runs.
+#if defined(__linux__)
+#define MALLOC_IRQ_DISABLE() (false)
+#define MALLOC_IRQ_RESTORE(state) ((void)(state))
+#else
+#define MALLOC_IRQ_DISABLE() arm_set_interrupt_state(false)
+#define MALLOC_IRQ_RESTORE(state) arm_set_interrupt_state(state)
+#endif
+
+//! @brief Values of the type field of a span header.
+enum
+{
+    kSpanSmall = 0x534d4c4c,    //!< Span carved into blocks of one size class.
+    kSpanLarge = 0x4c524745,    //!< First span of a run holding a single large block.
+    kSpanFree = 0x46524545      //!< First span of a free run.
+};
+
+//! @brief Header at the start of each span, or of each run of spans.
+typedef struct _malloc_span {
+    uint32_t type;                  //!< One of the span types.
+    uint32_t sizeClass;             //!< Size class of the blocks of a small span.
+    uint32_t spanCount;             //!< Number of spans in a large or free run.
+    struct _malloc_span * next;     //!< Next free run, in address order.
+} malloc_span_t;
+
+//! @brief A free block, linked through its first word.
+typedef struct _free_block {
+    struct _free_block * next;
+} free_block_t;
+
+//! @brief List of free blocks of one size class.
+typedef struct _block_list {
+    free_block_t * head;
+    uint32_t count;
+} block_list_t;
+
+//! @brief Per-core state.
+//!
+//! Only the owning core touches it, with interrupts masked, so it needs no lock. The
+//! statistics are summed over the cores when read. Frees may happen on another core than
+//! the allocation, so the in-use counts of a core can wrap, only the sum is meaningful.
+typedef struct _malloc_cpu {
+    block_list_t cache[SMP_MALLOC_CLASS_COUNT];     //!< Free blocks of each class.
+    smp_malloc_stats_t stats;                       //!< Statistics of this core.
+} __attribute__ ((aligned (32))) malloc_cpu_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+#if !defined(__linux__)
+//! @name Malloc heap extents
+//!
+//! Defined in the linker script.
+//@{
+extern int free_memory_start;
+extern int free_memory_end;
+//@}
+#endif
+
+//! @brief Block size of each size class. Four classes per power of two above 256 bytes.
+static const uint16_t s_classSizes[SMP_MALLOC_CLASS_COUNT] = {
+    32, 64, 96, 128, 160, 192, 224, 256,
+    320, 384, 448, 512,
+    640, 768, 896, 1024,
+    1280, 1536, 1792, 2048,
+    2560, 3072, 3584, 4096,
+    5120, 6144, 7168, 8192
+};
+
+//! @brief ceil(2^32 / size) of each class, to find block starts without a division.
+#define RECIPROCAL(size) ((uint32_t)((0x100000000ULL + (size) - 1) / (size)))
+static const uint32_t s_classReciprocals[SMP_MALLOC_CLASS_COUNT] = {
+    RECIPROCAL(32), RECIPROCAL(64), RECIPROCAL(96), RECIPROCAL(128),
+    RECIPROCAL(160), RECIPROCAL(192), RECIPROCAL(224), RECIPROCAL(256),
+    RECIPROCAL(320), RECIPROCAL(384), RECIPROCAL(448), RECIPROCAL(512),
+    RECIPROCAL(640), RECIPROCAL(768), RECIPROCAL(896), RECIPROCAL(1024),
+    RECIPROCAL(1280), RECIPROCAL(1536), RECIPROCAL(1792), RECIPROCAL(2048),
+    RECIPROCAL(2560), RECIPROCAL(3072), RECIPROCAL(3584), RECIPROCAL(4096),
+    RECIPROCAL(5120), RECIPROCAL(6144), RECIPROCAL(7168), RECIPROCAL(8192)
+};
+
+static malloc_cpu_t s_cpus[SMP_MALLOC_MAX_CPUS];
+
+//! @brief Protects the depot, the free runs and the heap top. Unlocked when zeroed.
+static ticket_lock_t s_depotLock;
+
+//! @brief Free blocks of each class shared by all cores.
+static block_list_t s_depot[SMP_MALLOC_CLASS_COUNT];
+
+//! @brief Free runs of spans below the heap top, sorted by address.
+static malloc_span_t * s_freeRuns;
+
+//! @brief Header of the span or run each span of the heap belongs to.
+static malloc_span_t ** s_spanMap;
+
+static uintptr_t s_heapStart;   //!< First span of the heap, also the start of the span map.
+static uintptr_t s_heapTop;     //!< Spans below this have been handed out.
+static uintptr_t s_heapEnd;     //!< End of the heap.
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Returns the size class of a request of 1 to #SMP_MALLOC_MAX_SMALL_SIZE bytes.
+static uint32_t malloc_size_class(uint32_t size)
+{
+    uint32_t log2;
+
+    if (size <= 256)
+    {
+        return (size - 1) >> 5;
+    }
+
+    // Four classes between each power of two 2^log2 and the next one.
+    log2 = 31 - __builtin_clz(size - 1);
+    return 8 + (log2 - 8) * 4 + ((size - 1 - (1 << log2)) >> (log2 - 2));
+}
+
+//! @brief Number of blocks moved between a core cache and the depot at a time.
+static uint32_t malloc_batch_size(uint32_t sizeClass)
+{
+    uint32_t batch = 4096 / s_classSizes[sizeClass];
+
+    return batch < 4 ? 4 : (batch > 32 ? 32 : batch);
+}
+
+//! @brief Returns the offset of an address from the start of its block in a small span.
+//!
+//! Offsets within a span are below 2^16, which keeps the reciprocal multiplication exact.
+static inline uint32_t malloc_block_offset(const malloc_span_t * span, const void * ptr)
+{
+    uint32_t offset = (uintptr_t)ptr - (uintptr_t)span - SPAN_HEADER_SIZE;
+    uint32_t index = ((uint64_t)offset * s_classReciprocals[span->sizeClass]) >> 32;
+
+    return offset - index * s_classSizes[span->sizeClass];
+}
+
+//! @brief Returns the span header for an address in the heap.
+static inline malloc_span_t * malloc_span_of(const void * ptr)
+{
+    return s_spanMap[((uintptr_t)ptr - s_heapStart) >> SPAN_SHIFT];
+}
+
+//! @brief Set up the heap. Called with the depot lock held.
+static void malloc_init_locked(uintptr_t start, uintptr_t end)
+{
+    uint32_t mapSize;
+
+    start = ALIGN_UP(start, SMP_MALLOC_SPAN_SIZE);
+    end &= ~(uintptr_t)(SMP_MALLOC_SPAN_SIZE - 1);
+    if (end <= start)
+    {
+        return;
+    }
+
+    // The span map lives in the first spans of the heap.
+    mapSize = ((end - start) >> SPAN_SHIFT) * sizeof(malloc_span_t *);
+    s_spanMap = (malloc_span_t **)start;
+    memset(s_spanMap, 0, mapSize);
+
+    s_heapStart = start;
+    s_heapTop = ALIGN_UP(start + mapSize, SMP_MALLOC_SPAN_SIZE);
+    s_heapEnd = end;
+    s_freeRuns = NULL;
+}
+
+//! @brief Make sure the heap is set up. Called with the depot lock held.
+static bool malloc_check_init_locked(void)
+{
+#if !defined(__linux__)
+    if (!s_heapEnd)
+    {
+        malloc_init_locked((uintptr_t)&free_memory_start, (uintptr_t)&free_memory_end);
+    }
+#endif
+
+    return s_heapEnd != 0;
+}
+
+//! @brief Point the span map entries of a run at its header.
+static void malloc_map_run(malloc_span_t * run, uint32_t spanCount)
+{
+    uint32_t index = ((uintptr_t)run - s_heapStart) >> SPAN_SHIFT;
+
+    while (spanCount--)
+    {
+        s_spanMap[index++] = run;
+    }
+}
+
+//! @brief Take a run of spans, first fit from the free runs or else from the heap top.
+//!
+//! Called with the depot lock held.
+static malloc_span_t * malloc_alloc_run(uint32_t spanCount)
+{
+    malloc_span_t ** link = &s_freeRuns;
+    malloc_span_t * run;
+
+    for (run = s_freeRuns; run; link = &run->next, run = run->next)
+    {
+        if (run->spanCount >= spanCount)
+        {
+            if (run->spanCount > spanCount)
+            {
+                // Keep the tail of the run on the list.
+                malloc_span_t * rest = (malloc_span_t *)((uintptr_t)run + (spanCount << SPAN_SHIFT));
+                rest->type = kSpanFree;
+                rest->spanCount = run->spanCount - spanCount;
+                rest->next = run->next;
+                *link = rest;
+            }
+            else
+            {
+                *link = run->next;
+            }
+            break;
+        }
+    }
+
+    if (!run)
+    {
+        if (((s_heapEnd - s_heapTop) >> SPAN_SHIFT) < spanCount)
+        {
+            return NULL;
+        }
+
+        run = (malloc_span_t *)s_heapTop;
+        s_heapTop += spanCount << SPAN_SHIFT;
+    }
+
+    run->spanCount = spanCount;
+    run->next = NULL;
+    malloc_map_run(run, spanCount);
+    return run;
+}
+
+//! @brief Return a run of spans, merging it with its free neighbours.
+//!
+//! Called with the depot lock held.
+static void malloc_free_run(malloc_span_t * run)
+{
+    malloc_span_t ** link = &s_freeRuns;
+    malloc_span_t * previous = NULL;
+    malloc_span_t * next;
+
+    run->type = kSpanFree;
+
+    while (*link && *link < run)
+    {
+        previous = *link;
+        link = &previous->next;
+    }
+
+    next = *link;
+    run->next = next;
+    *link = run;
+
+    if (next && (uintptr_t)run + (run->spanCount << SPAN_SHIFT) == (uintptr_t)next)
+    {
+        run->spanCount += next->spanCount;
+        run->next = next->next;
+    }
+
+    if (previous && (uintptr_t)previous + (previous->spanCount << SPAN_SHIFT) == (uintptr_t)run)
+    {
+        previous->spanCount += run->spanCount;
+        previous->next = run->next;
+        run = previous;
+    }
+
+    // A run ending at the heap top is given back to it, so large runs can grow again.
+    if ((uintptr_t)run + (run->spanCount << SPAN_SHIFT) == s_heapTop)
+    {
+        for (link = &s_freeRuns; *link != run; link = &(*link)->next)
+        {
+        }
+        *link = run->next;
+        s_heapTop = (uintptr_t)run;
+    }
+}
+
+//! @brief Move up to a batch of free blocks from the depot to a core cache.
+//!
+//! Carves a new span when the depot is out of blocks of the class.
+static void malloc_depot_refill(uint32_t sizeClass, block_list_t * cache)
+{
+    block_list_t * depot = &s_depot[sizeClass];
+    uint32_t batch = malloc_batch_size(sizeClass);
+
+    ticket_lock_lock(&s_depotLock);
+
+    if (!depot->head && malloc_check_init_locked())
+    {
+        malloc_span_t * span = malloc_alloc_run(1);
+
+        if (span)
+        {
+            uint32_t size = s_classSizes[sizeClass];
+            uintptr_t block = (uintptr_t)span + SPAN_HEADER_SIZE;
+            uintptr_t end = (uintptr_t)span + SMP_MALLOC_SPAN_SIZE - size;
+
+            span->type = kSpanSmall;
+            span->sizeClass = sizeClass;
+
+            // Push the blocks in reverse so they are handed out in address order.
+            for (block = block + ((end - block) / size) * size; block >= (uintptr_t)span + SPAN_HEADER_SIZE; block -= size)
+            {
+                ((free_block_t *)block)->next = depot->head;
+                depot->head = (free_block_t *)block;
+                ++depot->count;
+            }
+        }
+    }
+
+    while (depot->head && batch--)
+    {
+        free_block_t * block = depot->head;
+
+        depot->head = block->next;
+        --depot->count;
+        block->next = cache->head;
+        cache->head = block;
+        ++cache->count;
+    }
+
+    ticket_lock_unlock(&s_depotLock);
+}
+
+//! @brief Move a batch of free blocks from a core cache back to the depot.
+static void malloc_depot_drain(uint32_t sizeClass, block_list_t * cache)
+{
+    block_list_t * depot = &s_depot[sizeClass];
+    uint32_t batch = malloc_batch_size(sizeClass);
+
+    ticket_lock_lock(&s_depotLock);
+
+    while (batch--)
+    {
+        free_block_t * block = cache->head;
+
+        cache->head = block->next;
+        --cache->count;
+        block->next = depot->head;
+        depot->head = block;
+        ++depot->count;
+    }
+
+    ticket_lock_unlock(&s_depotLock);
+}
+
+//! @brief Allocate a block of a size class.
+static void * malloc_small(uint32_t sizeClass)
+{
+    bool irqState = MALLOC_IRQ_DISABLE();
+    malloc_cpu_t * cpu = &s_cpus[cpu_get_current()];
+    block_list_t * cache = &cpu->cache[sizeClass];
+    free_block_t * block;
+
+    if (cache->head)
+    {
+        ++cpu->stats.cacheHits;
+    }
+    else
+    {
+        malloc_depot_refill(sizeClass, cache);
+        ++cpu->stats.depotTransfers;
+    }
+
+    block = cache->head;
+    if (block)
+    {
+        cache->head = block->next;
+        --cache->count;
+
+        ++cpu->stats.mallocs;
+        ++cpu->stats.blocksInUse;
+        ++cpu->stats.classBlocksInUse[sizeClass];
+        cpu->stats.bytesInUse += s_classSizes[sizeClass];
+    }
+    else
+    {
+        ++cpu->stats.failures;
+    }
+
+    MALLOC_IRQ_RESTORE(irqState);
+    return block;
+}
+
+//! @brief Allocate a run of spans for a block that no size class can hold.
+static void * malloc_large(size_t size, size_t align)
+{
+    bool irqState = MALLOC_IRQ_DISABLE();
+    malloc_cpu_t * cpu = &s_cpus[cpu_get_current()];
+    // The largest offset of an aligned block from the start of the run.
+    uintptr_t offset = ALIGN_UP(SPAN_HEADER_SIZE, align);
+    uint32_t spanCount;
+    malloc_span_t * run = NULL;
+
+    if (size <= SIZE_MAX - offset - SMP_MALLOC_SPAN_SIZE)
+    {
+        spanCount = (offset + size + SMP_MALLOC_SPAN_SIZE - 1) >> SPAN_SHIFT;
+
+        ticket_lock_lock(&s_depotLock);
+        if (malloc_check_init_locked())
+        {
+            run = malloc_alloc_run(spanCount);
+        }
+        ticket_lock_unlock(&s_depotLock);
+    }
+
+    if (run)
+    {
+        run->type = kSpanLarge;
+
+        ++cpu->stats.mallocs;
+        ++cpu->stats.largeMallocs;
+        ++cpu->stats.blocksInUse;
+        cpu->stats.bytesInUse += run->spanCount << SPAN_SHIFT;
+    }
+    else
+    {
+        ++cpu->stats.failures;
+    }
+
+    MALLOC_IRQ_RESTORE(irqState);
+
+    // Runs start on a span, so alignments above the span size are found within the run.
+    return run ? (void *)ALIGN_UP((uintptr_t)run + SPAN_HEADER_SIZE, align) : NULL;
+}
+
+void smp_malloc_init(void * start, void * end)
+{
+    ticket_lock_lock(&s_depotLock);
+    malloc_init_locked((uintptr_t)start, (uintptr_t)end);
+    ticket_lock_unlock(&s_depotLock);
+}
+
+void * smp_malloc(size_t size)
+{
+    if (size <= SMP_MALLOC_MAX_SMALL_SIZE)
+    {
+        return malloc_small(malloc_size_class(size ? size : 1));
+    }
+
+    return malloc_large(size, CACHE_LINE_SIZE);
+}
+
+void smp_free(void * ptr)
+{
+    malloc_span_t * span;
+    bool irqState;
+    malloc_cpu_t * cpu;
+
+    if (!ptr)
+    {
+        return;
+    }
+
+    span = malloc_span_of(ptr);
+    irqState = MALLOC_IRQ_DISABLE();
+    cpu = &s_cpus[cpu_get_current()];
+
+    ++cpu->stats.frees;
+    --cpu->stats.blocksInUse;
+
+    if (span->type == kSpanSmall)
+    {
+        uint32_t sizeClass = span->sizeClass;
+        uint32_t size = s_classSizes[sizeClass];
+        block_list_t * cache = &cpu->cache[sizeClass];
+        free_block_t * block;
+
+        // smp_memalign() can return a pointer inside a block, so find the block start.
+        block = (free_block_t *)((uintptr_t)ptr - malloc_block_offset(span, ptr));
+
+        block->next = cache->head;
+        cache->head = block;
+        ++cache->count;
+
+        --cpu->stats.classBlocksInUse[sizeClass];
+        cpu->stats.bytesInUse -= size;
+
+        if (cache->count > 2 * malloc_batch_size(sizeClass))
+        {
+            malloc_depot_drain(sizeClass, cache);
+            ++cpu->stats.depotTransfers;
+        }
+    }
+    else
+    {
+        cpu->stats.bytesInUse -= span->spanCount << SPAN_SHIFT;
+
+        ticket_lock_lock(&s_depotLock);
+        malloc_free_run(span);
+        ticket_lock_unlock(&s_depotLock);
+    }
+
+    MALLOC_IRQ_RESTORE(irqState);
+}
+
+size_t smp_malloc_usable_size(void * ptr)
+{
+    malloc_span_t * span;
+
+    if (!ptr)
+    {
+        return 0;
+    }
+
+    span = malloc_span_of(ptr);
+    if (span->type == kSpanSmall)
+    {
+        return s_classSizes[span->sizeClass] - malloc_block_offset(span, ptr);
+    }
+
+    return (uintptr_t)span + (span->spanCount << SPAN_SHIFT) - (uintptr_t)ptr;
+}
+
+void * smp_realloc(void * ptr, size_t size)
+{
+    size_t usable;
+    void * newPtr;
+
+    if (!ptr)
+    {
+        return smp_malloc(size);
+    }
+
+    if (size == 0)
+    {
+        smp_free(ptr);
+        return NULL;
+    }
+
+    usable = smp_malloc_usable_size(ptr);
+    if (size <= usable)
+    {
+        return ptr;
+    }
+
+    newPtr = smp_malloc(size);
+    if (newPtr)
+    {
+        memcpy(newPtr, ptr, usable);
+        smp_free(ptr);
+    }
+
+    return newPtr;
+}
+
+void * smp_calloc(size_t count, size_t size)
+{
+    void * ptr;
+
+    if (size && count > SIZE_MAX / size)
+    {
+        return NULL;
+    }
+
+    ptr = smp_malloc(count * size);
+    if (ptr)
+    {
+        memset(ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+void * smp_memalign(size_t align, size_t size)
+{
+    uintptr_t block;
+
+    if (align <= CACHE_LINE_SIZE)
+    {
+        return smp_malloc(size);
+    }
+
+    if (align & (align - 1))
+    {
+        return NULL;
+    }
+
+    // Blocks start on cache lines, so a class block at most align - 32 bytes larger always
+    // holds an aligned block of the requested size.
+    if (size <= SMP_MALLOC_MAX_SMALL_SIZE - (align - CACHE_LINE_SIZE) && align < SMP_MALLOC_MAX_SMALL_SIZE)
+    {
+        block = (uintptr_t)malloc_small(malloc_size_class((size ? size : 1) + align - CACHE_LINE_SIZE));
+        return block ? (void *)ALIGN_UP(block, align) : NULL;
+    }
+
+    return malloc_large(size, align);
+}
+
+void smp_malloc_get_stats(smp_malloc_stats_t * stats)
+{
+    uint32_t cpu;
+    uint32_t i;
+
+    memset(stats, 0, sizeof(*stats));
+
+    for (cpu = 0; cpu < SMP_MALLOC_MAX_CPUS; ++cpu)
+    {
+        const smp_malloc_stats_t * cpuStats = &s_cpus[cpu].stats;
+
+        stats->bytesInUse += cpuStats->bytesInUse;
+        stats->blocksInUse += cpuStats->blocksInUse;
+        stats->mallocs += cpuStats->mallocs;
+        stats->frees += cpuStats->frees;
+        stats->cacheHits += cpuStats->cacheHits;
+        stats->depotTransfers += cpuStats->depotTransfers;
+        stats->largeMallocs += cpuStats->largeMallocs;
+        stats->failures += cpuStats->failures;
+
+        for (i = 0; i < SMP_MALLOC_CLASS_COUNT; ++i)
+        {
+            stats->classBlocksInUse[i] += cpuStats->classBlocksInUse[i];
+        }
+    }
+
+    stats->heapSize = s_heapEnd - s_heapStart;
+    stats->heapUsed = s_heapTop - s_heapStart;
+}
+
+void smp_malloc_print_stats(void)
+{
+    smp_malloc_stats_t stats;
+    uint32_t i;
+
+    smp_malloc_get_stats(&stats);
+
+    printf("Heap: %d of %d bytes used by spans\n", stats.heapUsed, stats.heapSize);
+    printf("In use: %d blocks, %d bytes\n", stats.blocksInUse, stats.bytesInUse);
+    printf("%d mallocs (%d large, %d from core caches), %d frees, %d depot transfers, %d failed\n",
+           stats.mallocs, stats.largeMallocs, stats.cacheHits, stats.frees, stats.depotTransfers,
+           stats.failures);
+
+    for (i = 0; i < SMP_MALLOC_CLASS_COUNT; ++i)
+    {
+        if (stats.classBlocksInUse[i])
+        {
+            printf("  %4d bytes: %d blocks\n", s_classSizes[i], stats.classBlocksInUse[i]);
+        }
+    }
+}
+
+#if SMP_MALLOC_REPLACE_LIBC
+//! @name newlib allocation functions
+//!
+//! Defining both the plain and the reentrant versions keeps newlib's own allocator out of the
+//! link. newlib's __malloc_lock() is not needed since the allocator does its own locking.
+//@{
+void * malloc(size_t size)
+{
+    return smp_malloc(size);
+}
+
+void free(void * ptr)
+{
+    smp_free(ptr);
+}
+
+void * realloc(void * ptr, size_t size)
+{
+    return smp_realloc(ptr, size);
+}
+
+void * calloc(size_t count, size_t size)
+{
+    return smp_calloc(count, size);
+}
+
+void * memalign(size_t align, size_t size)
+{
+    return smp_memalign(align, size);
+}
+
+size_t malloc_usable_size(void * ptr)
+{
+    return smp_malloc_usable_size(ptr);
+}
+
+void * _malloc_r(struct _reent * reent, size_t size)
+{
+    return smp_malloc(size);
+}
+
+void _free_r(struct _reent * reent, void * ptr)
+{
+    smp_free(ptr);
+}
+
+void * _realloc_r(struct _reent * reent, void * ptr, size_t size)
+{
+    return smp_realloc(ptr, size);
+}
+
+void * _calloc_r(struct _reent * reent, size_t count, size_t size)
+{
+    return smp_calloc(count, size);
+}
+
+void * _memalign_r(struct _reent * reent, size_t align, size_t size)
+{
+    return smp_memalign(align, size);
+}
+
+size_t _malloc_usable_size_r(struct _reent * reent, void * ptr)
+{
+    return smp_malloc_usable_size(ptr);
+}
+//@}
+#endif // SMP_MALLOC_REPLACE_LIBC
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
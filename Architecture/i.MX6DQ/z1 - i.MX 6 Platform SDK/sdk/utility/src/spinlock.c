@@ -28,9 +28,15 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <stdio.h>
 #include "utility/spinlock.h"
 #include "utility/atomics.h"
+#if defined(__linux__)
+#include <sched.h>
+#else
+#include "core/cortex_a9.h"
 #include "timer/timer.h"
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 // Constants
@@ -41,6 +47,70 @@ enum
     kUnlocked = 0xff  //!< Unlocked value for the spinlock.
 };
 
+//! @brief Bits of the reader-writer lock state.
+enum
+{
+    kRwWriter = 0x80000000,         //!< A writer holds the lock.
+    kRwWriterWaiting = 0x40000000,  //!< A writer waits for the lock, keeping new readers out.
+    kRwReaderMask = 0x3fffffff      //!< Number of readers holding the lock.
+};
+
+//! @brief Longest delay between two attempts of spinlock_trylock_backoff(), in loop iterations.
+#define SPINLOCK_MAX_BACKOFF (1024)
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__linux__)
+// Host builds, where the application provides cpu_get_current() and time_get_microseconds().
+int cpu_get_current(void);
+uint64_t time_get_microseconds(void);
+
+#define SPINLOCK_BARRIER() __sync_synchronize()
+#define SPINLOCK_WAIT() sched_yield()
+#define SPINLOCK_SIGNAL() do { } while (0)
+#define SPINLOCK_RELAX() __asm__ volatile ("" : : : "memory")
+#else
+//! @brief Memory barrier between the cores.
+#define SPINLOCK_BARRIER() __asm__ volatile ("dmb" : : : "memory")
+
+//! @brief Wait for a lock holder to signal a release.
+//!
+//! The event register latches a SEV sent after the lock was last checked, so no release is missed.
+#define SPINLOCK_WAIT() _ARM_WFE()
+
+//! @brief Wake the cores waiting in SPINLOCK_WAIT() after a release.
+#define SPINLOCK_SIGNAL() do { _ARM_DSB(); _ARM_SEV(); } while (0)
+
+//! @brief One iteration of a delay loop.
+#define SPINLOCK_RELAX() _ARM_NOP()
+#endif
+
+#if SPINLOCK_STATS
+//! @brief Account for an acquisition, after the lock has been taken.
+#define SPINLOCK_STATS_ACQUIRED(lock, spinCount) \
+    do { \
+        ++(lock)->stats.acquisitions; \
+        if (spinCount) { ++(lock)->stats.contentions; (lock)->stats.spins += (spinCount); } \
+        (lock)->stats.lockTime = time_get_microseconds(); \
+    } while (0)
+
+//! @brief Account for the hold time, before the lock is released.
+#define SPINLOCK_STATS_RELEASED(lock) \
+    do { \
+        uint32_t holdTime = (uint32_t)(time_get_microseconds() - (lock)->stats.lockTime); \
+        if (holdTime > (lock)->stats.maxHoldTime) { (lock)->stats.maxHoldTime = holdTime; } \
+    } while (0)
+
+//! @brief Count wait loop iterations.
+#define SPINLOCK_STATS_SPIN(spinCount) (++(spinCount))
+#else
+#define SPINLOCK_STATS_ACQUIRED(lock, spinCount) do { (void)(spinCount); } while (0)
+#define SPINLOCK_STATS_RELEASED(lock) do { } while (0)
+#define SPINLOCK_STATS_SPIN(spinCount) ((void)(spinCount))
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 // Code
 ////////////////////////////////////////////////////////////////////////////////
@@ -80,6 +150,343 @@ bool spinlock_is_locked(spinlock_t * lock)
     return (lock->owner != kUnlocked);
 }
 
+#if defined(__linux__)
+// C versions of spinlock_lock_unlock.S for host builds.
+int spinlock_lock(spinlock_t * lock, uint32_t timeout)
+{
+    return spinlock_trylock_backoff(lock, timeout);
+}
+
+void spinlock_unlock(spinlock_t * lock)
+{
+    SPINLOCK_BARRIER();
+    lock->owner = kUnlocked;
+}
+#endif
+
+int spinlock_trylock_backoff(spinlock_t * lock, uint32_t timeout)
+{
+    uint32_t cpu = cpu_get_current();
+    uint32_t backoff = 1;
+    uint64_t startTime = 0;
+    uint32_t i;
+
+    if (timeout != kSpinlockNoWait && timeout != kSpinlockWaitForever)
+    {
+        startTime = time_get_microseconds();
+    }
+
+    while (1)
+    {
+        // Only attempt the exclusive access when the lock looks free, so waiting does not
+        // take the cache line away from the owner.
+        if (lock->owner == kUnlocked
+            && atomic_compare_and_swap((volatile uint32_t *)&lock->owner, kUnlocked, cpu))
+        {
+            SPINLOCK_BARRIER();
+            return 0;
+        }
+
+        if (timeout == kSpinlockNoWait
+            || (timeout != kSpinlockWaitForever && time_get_microseconds() - startTime >= timeout))
+        {
+            return 1;
+        }
+
+        for (i = 0; i < backoff; ++i)
+        {
+            SPINLOCK_RELAX();
+        }
+
+        if (backoff < SPINLOCK_MAX_BACKOFF)
+        {
+            backoff <<= 1;
+        }
+#if defined(__linux__)
+        SPINLOCK_WAIT();
+#endif
+    }
+}
+
+void ticket_lock_init(ticket_lock_t * lock)
+{
+    lock->next = 0;
+    lock->owner = 0;
+#if SPINLOCK_STATS
+    lock->stats = (spinlock_stats_t){ 0 };
+#endif
+}
+
+void ticket_lock_lock(ticket_lock_t * lock)
+{
+    uint32_t ticket = (uint32_t)atomic_increment((volatile int32_t *)&lock->next);
+    uint32_t spinCount = 0;
+
+    while (lock->owner != ticket)
+    {
+        SPINLOCK_STATS_SPIN(spinCount);
+        SPINLOCK_WAIT();
+    }
+
+    SPINLOCK_BARRIER();
+    SPINLOCK_STATS_ACQUIRED(lock, spinCount);
+}
+
+bool ticket_lock_trylock(ticket_lock_t * lock)
+{
+    uint32_t owner = lock->owner;
+
+    // Only take a ticket if it would be served right away.
+    if (lock->next != owner || !atomic_compare_and_swap(&lock->next, owner, owner + 1))
+    {
+        return false;
+    }
+
+    SPINLOCK_BARRIER();
+    SPINLOCK_STATS_ACQUIRED(lock, 0);
+    return true;
+}
+
+void ticket_lock_unlock(ticket_lock_t * lock)
+{
+    SPINLOCK_STATS_RELEASED(lock);
+
+    // Only the holder writes the owner field, so no exclusive access is needed.
+    SPINLOCK_BARRIER();
+    lock->owner = lock->owner + 1;
+    SPINLOCK_SIGNAL();
+}
+
+bool ticket_lock_is_locked(ticket_lock_t * lock)
+{
+    return lock->next != lock->owner;
+}
+
+void mcs_lock_init(mcs_lock_t * lock)
+{
+    uint32_t i;
+
+    lock->tail = 0;
+    for (i = 0; i < SPINLOCK_MAX_CPUS; ++i)
+    {
+        lock->nodes[i].next = 0;
+        lock->nodes[i].isWaiting = 0;
+    }
+#if SPINLOCK_STATS
+    lock->stats = (spinlock_stats_t){ 0 };
+#endif
+}
+
+void mcs_lock_lock(mcs_lock_t * lock)
+{
+    uint32_t self = cpu_get_current() + 1;
+    mcs_node_t * node = &lock->nodes[self - 1];
+    uint32_t previous;
+    uint32_t spinCount = 0;
+
+    node->next = 0;
+    node->isWaiting = 1;
+
+    // Append ourselves to the queue.
+    do {
+        previous = lock->tail;
+    } while (!atomic_compare_and_swap(&lock->tail, previous, self));
+
+    if (previous)
+    {
+        // Link behind the previous CPU and wait for it to hand the lock over.
+        SPINLOCK_BARRIER();
+        lock->nodes[previous - 1].next = self;
+
+        while (node->isWaiting)
+        {
+            SPINLOCK_STATS_SPIN(spinCount);
+            SPINLOCK_WAIT();
+        }
+    }
+
+    SPINLOCK_BARRIER();
+    SPINLOCK_STATS_ACQUIRED(lock, spinCount);
+}
+
+bool mcs_lock_trylock(mcs_lock_t * lock)
+{
+    uint32_t self = cpu_get_current() + 1;
+    mcs_node_t * node = &lock->nodes[self - 1];
+
+    node->next = 0;
+    node->isWaiting = 0;
+
+    if (lock->tail != 0 || !atomic_compare_and_swap(&lock->tail, 0, self))
+    {
+        return false;
+    }
+
+    SPINLOCK_BARRIER();
+    SPINLOCK_STATS_ACQUIRED(lock, 0);
+    return true;
+}
+
+void mcs_lock_unlock(mcs_lock_t * lock)
+{
+    uint32_t self = cpu_get_current() + 1;
+    mcs_node_t * node = &lock->nodes[self - 1];
+    uint32_t next;
+
+    SPINLOCK_STATS_RELEASED(lock);
+
+    if (node->next == 0)
+    {
+        // Nobody queued behind us, the lock becomes free unless a CPU is just joining.
+        if (atomic_compare_and_swap(&lock->tail, self, 0))
+        {
+            return;
+        }
+
+        // A CPU swapped itself into the tail, wait until it has linked behind us.
+        while (node->next == 0)
+        {
+        }
+    }
+
+    next = node->next;
+    SPINLOCK_BARRIER();
+    lock->nodes[next - 1].isWaiting = 0;
+    SPINLOCK_SIGNAL();
+}
+
+bool mcs_lock_is_locked(mcs_lock_t * lock)
+{
+    return lock->tail != 0;
+}
+
+void rw_spinlock_init(rw_spinlock_t * lock)
+{
+    lock->state = 0;
+#if SPINLOCK_STATS
+    lock->stats = (spinlock_stats_t){ 0 };
+#endif
+}
+
+void rw_spinlock_read_lock(rw_spinlock_t * lock)
+{
+    uint32_t spinCount = 0;
+
+    while (!rw_spinlock_read_trylock(lock))
+    {
+        SPINLOCK_STATS_SPIN(spinCount);
+        SPINLOCK_WAIT();
+    }
+
+#if SPINLOCK_STATS
+    // Several readers may hold the lock, so only the counters are updated, atomically.
+    if (spinCount)
+    {
+        atomic_increment((volatile int32_t *)&lock->stats.contentions);
+        atomic_add((volatile int32_t *)&lock->stats.spins, spinCount);
+    }
+#endif
+}
+
+bool rw_spinlock_read_trylock(rw_spinlock_t * lock)
+{
+    uint32_t state = lock->state;
+
+    if ((state & (kRwWriter | kRwWriterWaiting))
+        || !atomic_compare_and_swap(&lock->state, state, state + 1))
+    {
+        return false;
+    }
+
+    SPINLOCK_BARRIER();
+#if SPINLOCK_STATS
+    atomic_increment((volatile int32_t *)&lock->stats.acquisitions);
+#endif
+    return true;
+}
+
+void rw_spinlock_read_unlock(rw_spinlock_t * lock)
+{
+    // Complete the reads before the count drops.
+    SPINLOCK_BARRIER();
+    atomic_decrement((volatile int32_t *)&lock->state);
+    SPINLOCK_SIGNAL();
+}
+
+void rw_spinlock_write_lock(rw_spinlock_t * lock)
+{
+    uint32_t spinCount = 0;
+    uint32_t state;
+
+    while (1)
+    {
+        state = lock->state;
+
+        if ((state & ~kRwWriterWaiting) == 0)
+        {
+            // No readers and no writer, take the lock. This also clears the waiting bit, which
+            // other waiting writers set again on their next attempt.
+            if (atomic_compare_and_swap(&lock->state, state, kRwWriter))
+            {
+                break;
+            }
+        }
+        else if (!(state & kRwWriterWaiting))
+        {
+            // Keep new readers out until we get the lock.
+            atomic_compare_and_swap(&lock->state, state, state | kRwWriterWaiting);
+        }
+        else
+        {
+            SPINLOCK_STATS_SPIN(spinCount);
+            SPINLOCK_WAIT();
+        }
+    }
+
+    SPINLOCK_BARRIER();
+    SPINLOCK_STATS_ACQUIRED(lock, spinCount);
+}
+
+bool rw_spinlock_write_trylock(rw_spinlock_t * lock)
+{
+    uint32_t state = lock->state;
+
+    if ((state & ~kRwWriterWaiting) != 0
+        || !atomic_compare_and_swap(&lock->state, state, kRwWriter))
+    {
+        return false;
+    }
+
+    SPINLOCK_BARRIER();
+    SPINLOCK_STATS_ACQUIRED(lock, 0);
+    return true;
+}
+
+void rw_spinlock_write_unlock(rw_spinlock_t * lock)
+{
+    uint32_t state;
+
+    SPINLOCK_STATS_RELEASED(lock);
+
+    // Waiting writers may set their bit at the same time.
+    do {
+        state = lock->state;
+    } while (!atomic_compare_and_swap(&lock->state, state, state & ~kRwWriter));
+
+    SPINLOCK_SIGNAL();
+}
+
+void spinlock_print_stats(const char * name, const spinlock_stats_t * stats)
+{
+#if SPINLOCK_STATS
+    printf("%s: %d acquisitions, %d contended, %d spins, max hold %d us\n", name,
+           stats->acquisitions, stats->contentions, stats->spins, stats->maxHoldTime);
+#else
+    (void)name;
+    (void)stats;
+#endif
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // EOF
 ////////////////////////////////////////////////////////////////////////////////
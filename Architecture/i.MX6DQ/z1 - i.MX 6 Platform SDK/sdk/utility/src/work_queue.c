@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file work_queue.c
+ * @brief Per-core queues of deferred work.
+ *
+ * Producers push items onto a lock-free stack with a compare and swap. The dispatcher of the
+ * core takes the whole stack at once, reverses it and appends it to a list only it touches,
+ * so items run in the order they were queued and no producer ever waits for the dispatcher.
+ */
+
+#if defined(__linux__)
+#include <stddef.h>
+#else
+#include "sdk.h"
+#include "core/cortex_a9.h"
+#include "core/gic.h"
+#include "core/interrupt.h"
+#include "timer/hrtimer.h"
+#include "timer/timer.h"
+#endif
+#include "utility/atomics.h"
+#include "utility/work_queue.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__linux__)
+// Host builds, where the application provides cpu_get_current() and time_get_microseconds().
+int cpu_get_current(void);
+uint64_t time_get_microseconds(void);
+
+#define WORK_BARRIER() __sync_synchronize()
+#define WORK_POINTER_CAS(p, o, n) __sync_bool_compare_and_swap((p), (o), (n))
+#define WORK_DISABLE_IRQ() (false)
+#define WORK_RESTORE_IRQ(state) ((void)(state))
+#else
+//! @brief Memory barrier between the cores.
+#define WORK_BARRIER() __asm__ volatile ("dmb" : : : "memory")
+
+//! @brief Compare and swap of a pointer, which is a word on the target.
+#define WORK_POINTER_CAS(p, o, n) \
+    atomic_compare_and_swap((volatile uint32_t *)(p), (uint32_t)(o), (uint32_t)(n))
+
+//! @brief Mask IRQs on the calling core, returning whether they were enabled.
+#define WORK_DISABLE_IRQ() arm_set_interrupt_state(false)
+
+//! @brief Restore the IRQ state returned by WORK_DISABLE_IRQ().
+#define WORK_RESTORE_IRQ(state) arm_set_interrupt_state(state)
+#endif
+
+//! @brief Queue of deferred work of one core.
+typedef struct _work_queue {
+    work_item_t * volatile incoming;    //!< Items pushed by producers, newest first.
+    work_item_t * head;                 //!< Oldest item taken by the dispatcher.
+    work_item_t * tail;                 //!< Newest item taken by the dispatcher.
+    volatile bool isRunning;            //!< The dispatcher is running on the core.
+    volatile bool isInitialized;        //!< Set by work_queue_init_cpu().
+    work_stats_t stats;                 //!< Statistics since they were last read.
+#if !defined(__linux__)
+    hrtimer_t rescheduleTimer;          //!< Wakes the core to run work left by an exhausted pass.
+#endif
+} __attribute__ ((aligned (32))) work_queue_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static work_queue_t s_queues[WORK_MAX_CPUS];
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Make a core run its queue as soon as it can.
+static void work_kick(uint32_t cpu)
+{
+#if !defined(__linux__)
+    gic_send_sgi(WORK_SGI, 1 << cpu, kGicSgiFilter_UseTargetList);
+#endif
+}
+
+//! @brief Push an item onto the queue of a core.
+static bool work_push(work_item_t * item, uint32_t cpu)
+{
+    if (cpu >= WORK_MAX_CPUS || !s_queues[cpu].isInitialized)
+    {
+        return false;
+    }
+
+    // Of concurrent callers, only the first one queues the item.
+    if (!atomic_compare_and_swap(&item->isQueued, 0, 1))
+    {
+        return true;
+    }
+
+    work_queue_t * queue = &s_queues[cpu];
+    work_item_t * first;
+    do {
+        first = queue->incoming;
+        item->next = first;
+    } while (!WORK_POINTER_CAS(&queue->incoming, first, item));
+
+    atomic_increment((volatile int32_t *)&queue->stats.queued);
+    return true;
+}
+
+//! @brief Move the items pushed by the producers to the dispatcher's list, in queueing order.
+static void work_take_incoming(work_queue_t * queue)
+{
+    work_item_t * list;
+    do {
+        list = queue->incoming;
+    } while (list && !WORK_POINTER_CAS(&queue->incoming, list, NULL));
+
+    // The stack has the newest item first.
+    work_item_t * reversed = NULL;
+    work_item_t * last = list;
+    while (list)
+    {
+        work_item_t * next = list->next;
+        list->next = reversed;
+        reversed = list;
+        list = next;
+    }
+
+    if (reversed)
+    {
+        if (queue->tail)
+        {
+            queue->tail->next = reversed;
+        }
+        else
+        {
+            queue->head = reversed;
+        }
+        queue->tail = last;
+    }
+}
+
+#if !defined(__linux__)
+//! @brief Runs the queue of the core when its outermost interrupt handler returns.
+static void work_irq_exit(void)
+{
+    work_run_pending();
+}
+
+//! @brief Handler of #WORK_SGI. The work itself runs on interrupt exit.
+static void work_sgi_isr(void)
+{
+}
+#endif
+
+void work_queue_init_cpu(void)
+{
+    uint32_t cpu = cpu_get_current();
+    work_queue_t * queue = &s_queues[cpu];
+
+    if (cpu >= WORK_MAX_CPUS || queue->isInitialized)
+    {
+        return;
+    }
+
+#if !defined(__linux__)
+    hrtimer_setup(&queue->rescheduleTimer, NULL, NULL);
+    register_irq_exit_routine(work_irq_exit);
+    register_interrupt_routine(WORK_SGI, work_sgi_isr);
+    enable_interrupt(WORK_SGI, cpu, kIrqPriority_Low);
+#endif
+
+    WORK_BARRIER();
+    queue->isInitialized = true;
+}
+
+void work_item_init(work_item_t * item, work_function_t function, void * arg)
+{
+    item->next = NULL;
+    item->function = function;
+    item->arg = arg;
+    item->isQueued = 0;
+}
+
+bool work_queue(work_item_t * item)
+{
+    bool wasEnabled = WORK_DISABLE_IRQ();
+    uint32_t cpu = cpu_get_current();
+    bool isQueued = work_push(item, cpu);
+
+#if !defined(__linux__)
+    // Handlers and the dispatcher itself get to the item before returning, thread code needs
+    // an interrupt.
+    if (isQueued && irq_get_nesting_level() == 0 && !s_queues[cpu].isRunning)
+    {
+        work_kick(cpu);
+    }
+#endif
+
+    WORK_RESTORE_IRQ(wasEnabled);
+    return isQueued;
+}
+
+bool work_queue_on(work_item_t * item, uint32_t cpu)
+{
+    if (cpu == cpu_get_current())
+    {
+        return work_queue(item);
+    }
+
+    bool isQueued = work_push(item, cpu);
+    if (isQueued)
+    {
+        work_kick(cpu);
+    }
+    return isQueued;
+}
+
+uint32_t work_run_pending(void)
+{
+    bool wasEnabled = WORK_DISABLE_IRQ();
+    uint32_t cpu = cpu_get_current();
+    work_queue_t * queue = &s_queues[cpu];
+
+    // A dispatcher interrupted on this core finishes the work when it resumes.
+    if (cpu >= WORK_MAX_CPUS || !queue->isInitialized || queue->isRunning)
+    {
+        WORK_RESTORE_IRQ(wasEnabled);
+        return 0;
+    }
+    queue->isRunning = true;
+    WORK_RESTORE_IRQ(wasEnabled);
+
+    uint64_t start = time_get_microseconds();
+    uint64_t now = start;
+    uint32_t executed = 0;
+    bool isExhausted = false;
+
+    while (true)
+    {
+        if (!queue->head)
+        {
+            work_take_incoming(queue);
+            if (!queue->head)
+            {
+                break;
+            }
+        }
+
+        if (executed == WORK_BATCH_BUDGET || now - start >= WORK_TIME_BUDGET_US)
+        {
+            isExhausted = true;
+            break;
+        }
+
+        work_item_t * item = queue->head;
+        queue->head = item->next;
+        if (!queue->head)
+        {
+            queue->tail = NULL;
+        }
+
+        // Cleared before the call, so the function may queue its item again.
+        item->isQueued = 0;
+        WORK_BARRIER();
+        item->function(item->arg);
+
+        ++executed;
+        now = time_get_microseconds();
+    }
+
+    if (executed)
+    {
+        uint32_t passTime = (uint32_t)(now - start);
+        queue->stats.executed += executed;
+        ++queue->stats.passes;
+        if (passTime > queue->stats.maxPassTime)
+        {
+            queue->stats.maxPassTime = passTime;
+        }
+    }
+
+    if (isExhausted)
+    {
+        // Give the interrupted code some time before running the rest.
+        ++queue->stats.exhausted;
+#if !defined(__linux__)
+        if (!hrtimer_start(&queue->rescheduleTimer, now + WORK_RESCHEDULE_US))
+        {
+            work_kick(cpu);
+        }
+#endif
+    }
+
+    wasEnabled = WORK_DISABLE_IRQ();
+    queue->isRunning = false;
+
+    // An interrupt may have queued work after the last check and seen the dispatcher running.
+    if (!isExhausted && queue->incoming)
+    {
+        work_kick(cpu);
+    }
+    WORK_RESTORE_IRQ(wasEnabled);
+
+    return executed;
+}
+
+bool work_has_pending(void)
+{
+    work_queue_t * queue = &s_queues[cpu_get_current()];
+    return queue->head != NULL || queue->incoming != NULL;
+}
+
+void work_get_stats(uint32_t cpu, work_stats_t * stats)
+{
+    if (cpu >= WORK_MAX_CPUS)
+    {
+        return;
+    }
+
+    work_queue_t * queue = &s_queues[cpu];
+    bool wasEnabled = WORK_DISABLE_IRQ();
+    *stats = queue->stats;
+    queue->stats.queued = 0;
+    queue->stats.executed = 0;
+    queue->stats.passes = 0;
+    queue->stats.exhausted = 0;
+    queue->stats.maxPassTime = 0;
+    WORK_RESTORE_IRQ(wasEnabled);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
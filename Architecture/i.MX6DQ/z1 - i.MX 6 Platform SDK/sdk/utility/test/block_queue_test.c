@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file block_queue_test.c
+ * @brief Test of the block request queue with a RAM-backed fake device.
+ *
+ * The fake device keeps the requests it was given until it is polled, then completes them in
+ * random order, like a disk with native command queuing. Random reads and writes are checked
+ * against a copy of the disk updated in submission order, which only holds if overlapping
+ * transfers reach the device in order. Merging, the elevator order and the deadlines are
+ * checked with plugged batches of bios.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utility/block_queue.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Sector size of the fake device.
+#define FAKE_SECTOR_SIZE (512)
+
+//! @brief Capacity of the fake device in sectors.
+#define FAKE_SECTOR_COUNT (1024)
+
+//! @brief Largest request of the fake device in sectors.
+#define FAKE_MAX_SECTORS (64)
+
+//! @brief Requests the fake device accepts at a time.
+#define FAKE_QUEUE_DEPTH (4)
+
+//! @brief Number of random bios.
+#define RANDOM_BIO_COUNT (2000)
+
+//! @brief Bios in flight at a time in the random test.
+#define RANDOM_BIO_SLOTS (48)
+
+//! @brief Largest random bio in sectors.
+#define RANDOM_MAX_SECTORS (8)
+
+//! @brief Random bios stay within this many sectors, so they overlap often.
+#define RANDOM_SECTOR_RANGE (256)
+
+//! @brief Requests whose start sectors the fake device records.
+#define DISPATCH_LOG_SIZE (64)
+
+//! @brief A disk in RAM that completes its requests when polled.
+typedef struct _fake_disk {
+    uint8_t data[FAKE_SECTOR_COUNT * FAKE_SECTOR_SIZE];
+    blk_request_t * inFlight[FAKE_QUEUE_DEPTH];
+    uint32_t inFlightCount;
+    bool isSynchronous;                     //!< Complete requests in submit.
+    uint32_t dispatchLog[DISPATCH_LOG_SIZE];
+    uint32_t dispatchCount;
+    uint32_t overflows;                     //!< Requests beyond the queue depth.
+} fake_disk_t;
+
+//! @brief A random bio with the data it has to read or write.
+typedef struct _random_slot {
+    blk_bio_t bio;
+    uint8_t buffer[RANDOM_MAX_SECTORS * FAKE_SECTOR_SIZE];
+    uint8_t expected[RANDOM_MAX_SECTORS * FAKE_SECTOR_SIZE];
+    volatile bool isBusy;
+} random_slot_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void block_queue_test(void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static fake_disk_t s_disk;
+static blk_device_t s_device;
+static blk_queue_t s_queue;
+
+//! @brief The disk as it has to look after all submitted writes.
+static uint8_t s_shadow[FAKE_SECTOR_COUNT * FAKE_SECTOR_SIZE];
+
+static random_slot_t s_slots[RANDOM_BIO_SLOTS];
+static uint32_t s_mismatches;
+static uint32_t s_failures;
+
+static blk_bio_t s_batch[FAKE_MAX_SECTORS];
+static uint8_t s_batchBuffer[FAKE_MAX_SECTORS * FAKE_SECTOR_SIZE];
+static volatile uint32_t s_batchDone;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Carry out a request on the RAM disk and complete it.
+static void fake_complete(fake_disk_t * disk, blk_request_t * request)
+{
+    uint8_t * sector = &disk->data[request->sector * FAKE_SECTOR_SIZE];
+    blk_bio_t * bio;
+
+    for (bio = request->bios; bio; bio = bio->next)
+    {
+        uint32_t size = bio->count * FAKE_SECTOR_SIZE;
+        if (request->op == kBlkWrite)
+        {
+            memcpy(sector, bio->buffer, size);
+        }
+        else
+        {
+            memcpy(bio->buffer, sector, size);
+        }
+        sector += size;
+    }
+    blk_request_complete(request, kBlkSuccess);
+}
+
+static int fake_submit(blk_device_t * device, blk_request_t * request)
+{
+    fake_disk_t * disk = (fake_disk_t *)device->context;
+
+    if (disk->dispatchCount < DISPATCH_LOG_SIZE)
+    {
+        disk->dispatchLog[disk->dispatchCount] = request->sector;
+    }
+    ++disk->dispatchCount;
+
+    if (disk->isSynchronous)
+    {
+        fake_complete(disk, request);
+    }
+    else if (disk->inFlightCount < FAKE_QUEUE_DEPTH)
+    {
+        disk->inFlight[disk->inFlightCount++] = request;
+    }
+    else
+    {
+        ++disk->overflows;
+        return kBlkError;
+    }
+    return kBlkSuccess;
+}
+
+//! @brief Complete one of the outstanding requests, chosen at random.
+static void fake_poll(blk_device_t * device)
+{
+    fake_disk_t * disk = (fake_disk_t *)device->context;
+
+    if (disk->inFlightCount)
+    {
+        uint32_t i = rand() % disk->inFlightCount;
+        blk_request_t * request = disk->inFlight[i];
+
+        disk->inFlight[i] = disk->inFlight[--disk->inFlightCount];
+        fake_complete(disk, request);
+    }
+}
+
+static void fake_init(blk_elevator_t elevator, bool isSynchronous)
+{
+    s_disk.inFlightCount = 0;
+    s_disk.isSynchronous = isSynchronous;
+    s_disk.dispatchCount = 0;
+    s_disk.overflows = 0;
+
+    s_device.name = "ramdisk";
+    s_device.sectorSize = FAKE_SECTOR_SIZE;
+    s_device.sectorCount = FAKE_SECTOR_COUNT;
+    s_device.maxSectors = FAKE_MAX_SECTORS;
+    s_device.maxSegments = 0;
+    s_device.queueDepth = FAKE_QUEUE_DEPTH;
+    s_device.submit = fake_submit;
+    s_device.poll = fake_poll;
+    s_device.context = &s_disk;
+
+    blk_queue_init(&s_queue, &s_device, elevator);
+}
+
+static void random_done(blk_bio_t * bio, int status)
+{
+    random_slot_t * slot = (random_slot_t *)bio->arg;
+
+    if (status != kBlkSuccess)
+    {
+        ++s_failures;
+    }
+    else if (bio->op == kBlkRead && memcmp(slot->buffer, slot->expected, bio->count * FAKE_SECTOR_SIZE))
+    {
+        ++s_mismatches;
+    }
+    slot->isBusy = false;
+}
+
+//! @brief Random overlapping reads and writes, completed out of order by the device.
+static bool random_test(blk_elevator_t elevator)
+{
+    uint32_t submitted = 0;
+    uint32_t i;
+    blk_stats_t stats;
+
+    fake_init(elevator, false);
+    memset(s_disk.data, 0, sizeof(s_disk.data));
+    memset(s_shadow, 0, sizeof(s_shadow));
+    s_mismatches = 0;
+    s_failures = 0;
+
+    while (submitted < RANDOM_BIO_COUNT)
+    {
+        // Submit into every free slot, then let the device complete something.
+        blk_plug(&s_queue);
+        for (i = 0; i < RANDOM_BIO_SLOTS && submitted < RANDOM_BIO_COUNT; ++i)
+        {
+            random_slot_t * slot = &s_slots[i];
+            if (slot->isBusy)
+            {
+                continue;
+            }
+
+            uint32_t count = 1 + rand() % RANDOM_MAX_SECTORS;
+            uint32_t sector = rand() % (RANDOM_SECTOR_RANGE - count);
+            uint32_t size = count * FAKE_SECTOR_SIZE;
+            uint8_t * shadow = &s_shadow[sector * FAKE_SECTOR_SIZE];
+            blk_op_t op = (rand() & 1) ? kBlkWrite : kBlkRead;
+
+            if (op == kBlkWrite)
+            {
+                uint32_t j;
+                for (j = 0; j < size; ++j)
+                {
+                    slot->buffer[j] = (uint8_t)(submitted * 7 + j);
+                }
+                memcpy(shadow, slot->buffer, size);
+            }
+            else
+            {
+                memcpy(slot->expected, shadow, size);
+            }
+
+            slot->isBusy = true;
+            blk_bio_init(&slot->bio, op, sector, count, slot->buffer, random_done, slot);
+            blk_submit_bio(&s_queue, &slot->bio);
+            ++submitted;
+        }
+        blk_unplug(&s_queue);
+
+        fake_poll(&s_device);
+        blk_queue_run(&s_queue);
+    }
+    blk_queue_drain(&s_queue);
+
+    blk_queue_get_stats(&s_queue, &stats);
+    printf("  %s: %d bios in %d requests, %d front and %d back merges, %d expired, max in flight %d\n",
+           elevator == kBlkElevatorDeadline ? "deadline" : "fifo", stats.bios, stats.requests,
+           stats.frontMerges, stats.backMerges, stats.expired, stats.maxInFlight);
+
+    if (s_mismatches || s_failures || s_disk.overflows || memcmp(s_disk.data, s_shadow, sizeof(s_shadow)))
+    {
+        printf("  %d mismatches, %d failures, %d overflows\n", s_mismatches, s_failures, s_disk.overflows);
+        return false;
+    }
+    return stats.bios == RANDOM_BIO_COUNT && stats.maxInFlight == FAKE_QUEUE_DEPTH
+        && stats.requests < stats.bios;
+}
+
+static void batch_done(blk_bio_t * bio, int status)
+{
+    if (status == kBlkSuccess)
+    {
+        ++s_batchDone;
+    }
+}
+
+//! @brief Single sectors submitted ascending and descending merge into one request each.
+static bool merge_test(void)
+{
+    const uint32_t half = FAKE_MAX_SECTORS / 2;
+    blk_stats_t stats;
+    uint32_t i;
+
+    fake_init(kBlkElevatorDeadline, true);
+    s_batchDone = 0;
+
+    blk_plug(&s_queue);
+    for (i = 0; i < half; ++i)
+    {
+        blk_bio_init(&s_batch[i], kBlkWrite, 100 + i, 1, &s_batchBuffer[i * FAKE_SECTOR_SIZE], batch_done, NULL);
+        blk_submit_bio(&s_queue, &s_batch[i]);
+    }
+    for (i = FAKE_MAX_SECTORS; i > half; --i)
+    {
+        blk_bio_init(&s_batch[i - 1], kBlkWrite, 500 + i - 1, 1, &s_batchBuffer[(i - 1) * FAKE_SECTOR_SIZE], batch_done, NULL);
+        blk_submit_bio(&s_queue, &s_batch[i - 1]);
+    }
+    blk_unplug(&s_queue);
+    blk_queue_drain(&s_queue);
+
+    blk_queue_get_stats(&s_queue, &stats);
+    printf("  merge: %d bios in %d requests, %d front and %d back merges\n",
+           stats.bios, stats.requests, stats.frontMerges, stats.backMerges);
+    return s_batchDone == FAKE_MAX_SECTORS && stats.requests == 2
+        && stats.frontMerges == half - 1 && stats.backMerges == half - 1
+        && memcmp(&s_disk.data[100 * FAKE_SECTOR_SIZE], s_batchBuffer, half * FAKE_SECTOR_SIZE) == 0;
+}
+
+//! @brief Scattered requests go out in ascending order, unless one has expired.
+static bool elevator_test(void)
+{
+    static const uint32_t sectors[] = { 700, 100, 900, 300, 500 };
+    static const uint32_t sorted[] = { 100, 300, 500, 700, 900 };
+    const uint32_t count = sizeof(sectors) / sizeof(sectors[0]);
+    blk_stats_t stats;
+    bool isOk = true;
+    uint32_t i;
+
+    // Sector order with every deadline in the future.
+    fake_init(kBlkElevatorDeadline, true);
+    s_device.queueDepth = 1;
+    blk_plug(&s_queue);
+    for (i = 0; i < count; ++i)
+    {
+        blk_bio_init(&s_batch[i], kBlkWrite, sectors[i], 1, s_batchBuffer, batch_done, NULL);
+        blk_submit_bio(&s_queue, &s_batch[i]);
+    }
+    blk_unplug(&s_queue);
+    blk_queue_drain(&s_queue);
+    isOk = memcmp(s_disk.dispatchLog, sorted, sizeof(sorted)) == 0;
+
+    // An expired read jumps ahead of the writes.
+    fake_init(kBlkElevatorDeadline, true);
+    s_device.queueDepth = 1;
+    s_queue.readExpire = 0;
+    blk_plug(&s_queue);
+    for (i = 0; i < count; ++i)
+    {
+        blk_bio_init(&s_batch[i], i == 2 ? kBlkRead : kBlkWrite, sectors[i], 1,
+                     &s_batchBuffer[i * FAKE_SECTOR_SIZE], batch_done, NULL);
+        blk_submit_bio(&s_queue, &s_batch[i]);
+    }
+    blk_unplug(&s_queue);
+    blk_queue_drain(&s_queue);
+    blk_queue_get_stats(&s_queue, &stats);
+    isOk = isOk && s_disk.dispatchLog[0] == sectors[2] && stats.expired == 1
+        && s_disk.dispatchLog[1] == 100;
+
+    // Arrival order.
+    fake_init(kBlkElevatorFifo, true);
+    s_device.queueDepth = 1;
+    blk_plug(&s_queue);
+    for (i = 0; i < count; ++i)
+    {
+        blk_bio_init(&s_batch[i], kBlkWrite, sectors[i], 1, s_batchBuffer, batch_done, NULL);
+        blk_submit_bio(&s_queue, &s_batch[i]);
+    }
+    blk_unplug(&s_queue);
+    blk_queue_drain(&s_queue);
+    isOk = isOk && memcmp(s_disk.dispatchLog, sectors, sizeof(sectors)) == 0;
+
+    printf("  elevator: order %s\n", isOk ? "ok" : "wrong");
+    return isOk;
+}
+
+//! @brief Bios beyond the end of the device fail, transfers in range succeed.
+static bool limits_test(void)
+{
+    uint8_t buffer[FAKE_SECTOR_SIZE * 2];
+
+    fake_init(kBlkElevatorDeadline, false);
+    return blk_transfer(&s_queue, kBlkWrite, FAKE_SECTOR_COUNT - 1, 2, buffer) == kBlkInvalid
+        && blk_transfer(&s_queue, kBlkRead, 0, FAKE_MAX_SECTORS + 1, s_batchBuffer) == kBlkInvalid
+        && blk_transfer(&s_queue, kBlkRead, 0, 0, buffer) == kBlkInvalid
+        && blk_transfer(&s_queue, kBlkWrite, FAKE_SECTOR_COUNT - 2, 2, buffer) == kBlkSuccess;
+}
+
+void block_queue_test(void)
+{
+    bool isOk = true;
+
+    printf("Running the block queue test\n");
+    srand(1);
+
+    isOk = random_test(kBlkElevatorDeadline) && isOk;
+    isOk = random_test(kBlkElevatorFifo) && isOk;
+    isOk = merge_test() && isOk;
+    isOk = elevator_test() && isOk;
+    isOk = limits_test() && isOk;
+
+    printf("Block queue test %s\n", isOk ? "PASSED" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
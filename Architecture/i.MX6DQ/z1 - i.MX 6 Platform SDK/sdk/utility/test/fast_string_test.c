@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file fast_string_test.c
+ * @brief Test of the memory copy, fill and compare routines.
+ *
+ * Every size up to a few cache lines is checked at all combinations of source and
+ * destination alignment within 16 bytes, plus a few large sizes, against the C library.
+ * Bytes around the destination are checked too, so overruns are caught.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "utility/fast_string.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Sizes up to this are all tested.
+#define SMALL_SIZE_LIMIT (300)
+
+//! @brief Room left around the tested ranges to catch overruns.
+#define GUARD_SIZE (32)
+
+//! @brief Size of each test buffer.
+#define BUFFER_SIZE (8192 + 2 * GUARD_SIZE + 32)
+
+//! @brief Byte that no routine writes into the guard area.
+#define GUARD_BYTE (0xa5)
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void fast_string_test(void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static uint8_t s_src[BUFFER_SIZE] __attribute__((aligned(64)));
+static uint8_t s_dst[BUFFER_SIZE] __attribute__((aligned(64)));
+static uint8_t s_expected[BUFFER_SIZE] __attribute__((aligned(64)));
+
+//! @brief Sizes tested above #SMALL_SIZE_LIMIT.
+static const size_t s_largeSizes[] = { 511, 512, 1023, 1024, 1500, 4095, 4096, 8191, 8192 };
+
+//! @brief State of the pattern generator.
+static uint32_t s_seed;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+static void fill_pattern(uint8_t * buffer, size_t length)
+{
+    size_t i;
+
+    for (i = 0; i < length; ++i)
+    {
+        s_seed = s_seed * 1103515245 + 12345;
+        buffer[i] = (uint8_t)(s_seed >> 16);
+    }
+}
+
+static int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+//! @brief Runs all four routines for one size and alignment.
+//!
+//! Only the start of the buffers, up to the guard area past the tested range, is checked.
+static bool check_one(size_t size, uint32_t dstOffset, uint32_t srcOffset)
+{
+    uint8_t * dst = &s_dst[GUARD_SIZE + dstOffset];
+    const uint8_t * src = &s_src[GUARD_SIZE + srcOffset];
+    size_t span = size + 2 * GUARD_SIZE + 32;
+    int32_t delta;
+    bool isOk = true;
+
+    // Copy.
+    memset(s_dst, GUARD_BYTE, span);
+    memcpy(s_expected, s_dst, span);
+    memcpy(&s_expected[GUARD_SIZE + dstOffset], src, size);
+    if (fast_memcpy(dst, src, size) != dst || memcmp(s_dst, s_expected, span) != 0)
+    {
+        printf("  fast_memcpy failed, size %d, dst +%d, src +%d\n", (int)size, dstOffset, srcOffset);
+        isOk = false;
+    }
+
+    // Fill.
+    memset(s_dst, GUARD_BYTE, span);
+    memcpy(s_expected, s_dst, span);
+    memset(&s_expected[GUARD_SIZE + dstOffset], 0x15a, size);
+    if (fast_memset(dst, 0x15a, size) != dst || memcmp(s_dst, s_expected, span) != 0)
+    {
+        printf("  fast_memset failed, size %d, dst +%d\n", (int)size, dstOffset);
+        isOk = false;
+    }
+
+    // Compare, equal and with one byte changed at either end.
+    memcpy(dst, src, size);
+    if (fast_memcmp(dst, src, size) != 0)
+    {
+        printf("  fast_memcmp of equal buffers failed, size %d\n", (int)size);
+        isOk = false;
+    }
+    if (size)
+    {
+        size_t index = (dstOffset & 1) ? 0 : size - 1;
+
+        dst[index] ^= 1 << (srcOffset & 7);
+        if (sign(fast_memcmp(dst, src, size)) != sign(memcmp(dst, src, size))
+            || sign(fast_memcmp(src, dst, size)) != sign(memcmp(src, dst, size)))
+        {
+            printf("  fast_memcmp failed, size %d, byte %d\n", (int)size, (int)index);
+            isOk = false;
+        }
+    }
+
+    // Move within one buffer, in both directions.
+    for (delta = -(int32_t)(dstOffset + 1); delta <= (int32_t)(dstOffset + 1); delta += dstOffset + 1)
+    {
+        uint8_t * from = &s_dst[GUARD_SIZE + 16 + srcOffset];
+        uint8_t * to = from + delta;
+
+        memcpy(s_dst, s_src, span);
+        memcpy(s_expected, s_dst, span);
+        memmove(&s_expected[to - s_dst], from, size);
+        if (fast_memmove(to, from, size) != to || memcmp(s_dst, s_expected, span) != 0)
+        {
+            printf("  fast_memmove failed, size %d, src +%d, delta %d\n", (int)size, srcOffset, delta);
+            isOk = false;
+        }
+    }
+
+    return isOk;
+}
+
+void fast_string_test(void)
+{
+    size_t size;
+    uint32_t dstOffset;
+    uint32_t srcOffset;
+    uint32_t i;
+    bool isOk = true;
+
+    printf("Running the fast string test\n");
+
+    s_seed = 1;
+    fill_pattern(s_src, sizeof(s_src));
+
+    for (size = 0; size <= SMALL_SIZE_LIMIT && isOk; ++size)
+    {
+        for (dstOffset = 0; dstOffset < 16 && isOk; ++dstOffset)
+        {
+            for (srcOffset = 0; srcOffset < 16 && isOk; ++srcOffset)
+            {
+                isOk = check_one(size, dstOffset, srcOffset);
+            }
+        }
+    }
+
+    for (i = 0; i < sizeof(s_largeSizes) / sizeof(s_largeSizes[0]) && isOk; ++i)
+    {
+        for (dstOffset = 0; dstOffset < 16 && isOk; dstOffset += 5)
+        {
+            for (srcOffset = 0; srcOffset < 16 && isOk; srcOffset += 3)
+            {
+                isOk = check_one(s_largeSizes[i], dstOffset, srcOffset);
+            }
+        }
+    }
+
+    printf("Fast string test %s\n", isOk ? "PASSED" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
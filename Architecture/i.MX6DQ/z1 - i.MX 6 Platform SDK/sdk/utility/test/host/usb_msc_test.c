@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file usb_msc_test.c
+ * @brief Test of the LBA data pipeline of the USB mass storage class.
+ *
+ * The device layer below the class is replaced by a queue of transfers that the test
+ * completes one at a time, in order, as the controller would. The media is a RAM disk whose
+ * callback either copies right away or leaves the access pending and finishes it later.
+ * Reads and writes of several lengths check the data that reaches the host or the disk, that
+ * exactly one CSW is sent, and that the media is only accessed from deferred work, never
+ * from the completion callbacks that run in place of the USB interrupt.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "usb_msc.h"
+#include "utility/work_queue.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Block size of the RAM disk.
+#define DISK_BLOCK_SIZE (512)
+
+//! @brief Number of blocks of the RAM disk.
+#define DISK_BLOCKS (64)
+
+//! @brief Longest transfer tested, in blocks.
+#define MAX_TEST_BLOCKS (9)
+
+//! @brief Depth of the controller queue of each direction.
+#define CONTROLLER_QUEUE_DEPTH (MSC_LBA_BUFF_COUNT + 1)
+
+//! @brief Steps after which a transfer is considered stuck.
+#define MAX_STEPS (10000)
+
+//! @brief A transfer queued on the controller.
+typedef struct _test_xfer {
+    boolean isIn;
+    uint_8_ptr buffer;
+    uint_32 size;
+} test_xfer_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void usb_msc_test(void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+extern MSC_GLOBAL_VARIABLE_STRUCT g_msc;
+
+static USB_ENDPOINTS s_endpoints = {
+    MSC_DESC_ENDPOINT_COUNT,
+    {
+        { BULK_IN_ENDPOINT, USB_BULK_PIPE, USB_SEND, BULK_IN_ENDP_PACKET_SIZE },
+        { BULK_OUT_ENDPOINT, USB_BULK_PIPE, USB_RECV, BULK_OUT_ENDP_PACKET_SIZE },
+    }
+};
+
+static test_xfer_t s_queue[64];
+static uint32_t s_head;
+static uint32_t s_tail;
+
+static uint8_t s_disk[DISK_BLOCKS * DISK_BLOCK_SIZE];
+static uint8_t s_host[MAX_TEST_BLOCKS * DISK_BLOCK_SIZE];
+static uint32_t s_hostPos;
+
+//! @brief Whether the media callback leaves its accesses pending.
+static boolean s_isDeferred;
+static boolean s_hasPending;
+static uint8_t s_pendingEvent;
+static LBA_APP_STRUCT s_pending;
+
+//! @brief Set while the test runs the work queue.
+static boolean s_inWork;
+
+static uint32_t s_mediaAccesses;
+static uint32_t s_accessesOutsideWork;
+static uint32_t s_cswSent;
+static uint32_t s_stalls;
+
+////////////////////////////////////////////////////////////////////////////////
+// Device layer
+////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t queued(boolean isIn)
+{
+    uint32_t count = 0;
+    uint32_t i;
+
+    for (i = s_head; i < s_tail; ++i)
+    {
+        if (s_queue[i].isIn == isIn)
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+static uint_8 queue_xfer(boolean isIn, uint_8_ptr buffer, uint_32 size)
+{
+    if (queued(isIn) >= CONTROLLER_QUEUE_DEPTH || s_tail == sizeof(s_queue) / sizeof(s_queue[0]))
+    {
+        return isIn ? USBERR_TX_FAILED : USBERR_RX_FAILED;
+    }
+    s_queue[s_tail].isIn = isIn;
+    s_queue[s_tail].buffer = buffer;
+    s_queue[s_tail].size = size;
+    ++s_tail;
+    return USB_OK;
+}
+
+USB_ENDPOINTS * USB_Desc_Get_Endpoints(uint_8 controller_ID)
+{
+    return &s_endpoints;
+}
+
+uint_8 USB_Class_Send_Data(uint_8 controller_ID, uint_8 ep_num, uint_8_ptr buff_ptr, USB_PACKET_SIZE size)
+{
+    return queue_xfer(TRUE, buff_ptr, size);
+}
+
+uint_8 _usb_device_recv_data(_usb_device_handle handle, uint_8 ep_num, uint_8_ptr buff_ptr, USB_PACKET_SIZE size)
+{
+    return queue_xfer(FALSE, buff_ptr, size);
+}
+
+uint_8 _usb_device_set_status(_usb_device_handle handle, uint_8 component, uint_8 setting)
+{
+    ++s_stalls;
+    return USB_OK;
+}
+
+uint_8 _usb_device_init(uint_8 device_number, _usb_device_handle * handle, uint_8 number_of_endpoints, boolean bVregEn)
+{
+    return USB_OK;
+}
+
+uint_8 _usb_device_deinit(void)
+{
+    return USB_OK;
+}
+
+uint_8 _usb_device_init_endpoint(_usb_device_handle handle, uint_8 endpoint_number, uint_16 max_packet_size,
+                                 uint_8 direction, uint_8 endpoint_type, boolean flag)
+{
+    return USB_OK;
+}
+
+uint_8 _usb_device_deinit_endpoint(_usb_device_handle handle, uint_8 endpoint_number, uint_8 direction)
+{
+    return USB_OK;
+}
+
+uint_8 USB_Class_Init(uint_8 controller_ID, USB_CLASS_CALLBACK class_callback, USB_REQ_FUNC other_req_callback)
+{
+    return USB_OK;
+}
+
+uint_8 USB_Class_DeInit(uint_8 controller_ID)
+{
+    return USB_OK;
+}
+
+uint_8 USB_MSC_SCSI_Init(uint_8 controller_ID, USB_CLASS_CALLBACK callback)
+{
+    return USB_OK;
+}
+
+//! @brief The SCSI commands are not used, the test starts the data phases itself.
+#define SCSI_COMMAND_STUB(name) \
+    uint_8 name(uint_8 controller_ID, PTR_CBW cbw_ptr, uint_32 * csw_residue_ptr, uint_8 * csw_status_ptr) \
+    { \
+        return USB_OK; \
+    }
+
+SCSI_COMMAND_STUB(msc_inquiry_command)
+SCSI_COMMAND_STUB(msc_read_command)
+SCSI_COMMAND_STUB(msc_request_sense_command)
+SCSI_COMMAND_STUB(msc_test_unit_ready_command)
+SCSI_COMMAND_STUB(msc_write_command)
+SCSI_COMMAND_STUB(msc_prevent_allow_medium_removal)
+SCSI_COMMAND_STUB(msc_format_unit_command)
+SCSI_COMMAND_STUB(msc_read_capacity_command)
+SCSI_COMMAND_STUB(msc_mode_sense_command)
+SCSI_COMMAND_STUB(msc_mode_select_command)
+SCSI_COMMAND_STUB(msc_read_format_capacity_command)
+SCSI_COMMAND_STUB(msc_send_diagnostic_command)
+SCSI_COMMAND_STUB(msc_verify_command)
+SCSI_COMMAND_STUB(msc_start_stop_unit_command)
+SCSI_COMMAND_STUB(msc_unsupported_command)
+
+////////////////////////////////////////////////////////////////////////////////
+// Media
+////////////////////////////////////////////////////////////////////////////////
+
+static void media_copy(uint8_t event, LBA_APP_STRUCT * lba)
+{
+    if (event == USB_MSC_DEVICE_READ_REQUEST)
+    {
+        memcpy(lba->buff_ptr, &s_disk[lba->offset], lba->size);
+    }
+    else
+    {
+        memcpy(&s_disk[lba->offset], lba->buff_ptr, lba->size);
+    }
+}
+
+static void media_callback(uint_8 controller_ID, uint_8 event_type, void * val)
+{
+    LBA_APP_STRUCT * lba = (LBA_APP_STRUCT *)val;
+    PTR_DEVICE_LBA_INFO_STRUCT info;
+
+    switch (event_type)
+    {
+        case USB_MSC_DEVICE_GET_INFO:
+            info = (PTR_DEVICE_LBA_INFO_STRUCT)val;
+            info->total_lba_device_supports = DISK_BLOCKS;
+            info->length_of_each_lba_of_device = DISK_BLOCK_SIZE;
+            info->num_lun_supported = 1;
+            break;
+
+        case USB_MSC_DEVICE_READ_REQUEST:
+        case USB_MSC_DEVICE_WRITE_REQUEST:
+            ++s_mediaAccesses;
+            if (!s_inWork)
+            {
+                ++s_accessesOutsideWork;
+            }
+            if (s_isDeferred)
+            {
+                s_pending = *lba;
+                s_pendingEvent = event_type;
+                s_hasPending = TRUE;
+                lba->pending = TRUE;
+            }
+            else
+            {
+                media_copy(event_type, lba);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+//! @brief Finish the pending media access, as the interrupt of a media controller would.
+static void finish_media(void)
+{
+    s_hasPending = FALSE;
+    media_copy(s_pendingEvent, &s_pending);
+    USB_MSC_LBA_Complete(0);
+}
+
+static void run_work(void)
+{
+    s_inWork = TRUE;
+    work_run_pending();
+    s_inWork = FALSE;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Complete the oldest transfer on the controller, as the USB interrupt would.
+static void complete_xfer(uint32_t * writePos)
+{
+    test_xfer_t xfer = s_queue[s_head++];
+    USB_DEV_EVENT_STRUCT event;
+
+    memset(&event, 0, sizeof(event));
+    event.buffer_ptr = xfer.buffer;
+    event.len = xfer.size;
+
+    if (xfer.isIn)
+    {
+        event.ep_num = BULK_IN_ENDPOINT;
+        event.direction = USB_SEND;
+        if (xfer.buffer == (uint_8_ptr)&g_msc.csw_struct)
+        {
+            ++s_cswSent;
+        }
+        else
+        {
+            memcpy(&s_host[s_hostPos], xfer.buffer, xfer.size);
+            s_hostPos += xfer.size;
+        }
+        USB_Service_Bulk_In(&event);
+    }
+    else
+    {
+        if (xfer.buffer == (uint_8_ptr)&g_msc.cbw_struct)
+        {
+            // The next CBW is armed, the host has nothing more to send.
+            return;
+        }
+        event.ep_num = BULK_OUT_ENDPOINT;
+        event.direction = USB_RECV;
+        memcpy(xfer.buffer, &s_host[*writePos], xfer.size);
+        *writePos += xfer.size;
+        USB_Service_Bulk_Out(&event);
+    }
+}
+
+//! @brief Run one LBA data phase until its CSW is sent.
+static bool run_transfer(boolean direction, uint32_t lba, uint32_t blocks, boolean isDeferred)
+{
+    LBA_INFO_STRUCT info = { lba, blocks };
+    uint32_t bytes = blocks * DISK_BLOCK_SIZE;
+    uint32_t writePos = 0;
+    uint32_t steps;
+    uint32_t i;
+    bool isOk = true;
+
+    s_head = s_tail = 0;
+    s_hostPos = 0;
+    s_cswSent = 0;
+    s_hasPending = FALSE;
+    s_isDeferred = isDeferred;
+    s_mediaAccesses = 0;
+    s_accessesOutsideWork = 0;
+
+    if (direction == USB_RECV)
+    {
+        for (i = 0; i < bytes; ++i)
+        {
+            s_host[i] = (uint8_t)(i * 13 + lba + blocks);
+        }
+    }
+
+    // The command was taken from the CBW, as process_mass_storage_command() leaves it.
+    g_msc.in_flag = (boolean)(direction == USB_SEND);
+    g_msc.out_flag = (boolean)(direction == USB_RECV);
+    g_msc.csw_struct.signature = USB_DCSWSIGNATURE;
+
+    if (USB_MSC_LBA_Transfer(0, direction, &info) != USB_OK)
+    {
+        printf("  transfer of %d blocks could not start\n", blocks);
+        return false;
+    }
+
+    // Deferred work runs first, as on interrupt exit, then the media or the bus moves on.
+    for (steps = 0; steps < MAX_STEPS && !(s_cswSent && s_head == s_tail); ++steps)
+    {
+        if (work_has_pending())
+        {
+            run_work();
+        }
+        else if (s_hasPending && (steps % 3 == 0 || s_head == s_tail))
+        {
+            finish_media();
+        }
+        else if (s_head < s_tail)
+        {
+            complete_xfer(&writePos);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (s_cswSent != 1)
+    {
+        printf("  %s of %d blocks: %d CSWs sent\n", direction == USB_SEND ? "read" : "write", blocks, s_cswSent);
+        isOk = false;
+    }
+    if (direction == USB_SEND && (s_hostPos != bytes || memcmp(s_host, &s_disk[lba * DISK_BLOCK_SIZE], bytes)))
+    {
+        printf("  read of %d blocks: wrong data sent\n", blocks);
+        isOk = false;
+    }
+    if (direction == USB_RECV && memcmp(&s_disk[lba * DISK_BLOCK_SIZE], s_host, bytes))
+    {
+        printf("  write of %d blocks: wrong data on the media\n", blocks);
+        isOk = false;
+    }
+    if (s_accessesOutsideWork)
+    {
+        printf("  %d of %d media accesses ran outside of deferred work\n", s_accessesOutsideWork, s_mediaAccesses);
+        isOk = false;
+    }
+    if (g_msc.lba_pipe.active)
+    {
+        printf("  data phase still active\n");
+        isOk = false;
+    }
+    return isOk;
+}
+
+void usb_msc_test(void)
+{
+    uint32_t blocks;
+    uint32_t i;
+    boolean isDeferred;
+    bool isOk = true;
+
+    printf("Running the USB mass storage test\n");
+
+    work_queue_init_cpu();
+    USB_Class_MSC_Init(0, NULL, NULL, media_callback);
+
+    for (i = 0; i < sizeof(s_disk); ++i)
+    {
+        s_disk[i] = (uint8_t)(i * 7 + i / DISK_BLOCK_SIZE);
+    }
+
+    for (isDeferred = FALSE; isDeferred <= TRUE; ++isDeferred)
+    {
+        for (blocks = 1; blocks <= MAX_TEST_BLOCKS; blocks += 2)
+        {
+            isOk = run_transfer(USB_SEND, 3, blocks, isDeferred) && isOk;
+            isOk = run_transfer(USB_RECV, 5 + blocks, blocks, isDeferred) && isOk;
+        }
+    }
+    printf("  reads and writes of 1 to %d blocks, with media done at once and later\n", MAX_TEST_BLOCKS);
+
+    // CASE 5: the zero length packet queued behind the data is held until the data is sent.
+    {
+        LBA_INFO_STRUCT info = { 0, 4 };
+        uint32_t steps;
+
+        s_head = s_tail = 0;
+        s_hostPos = 0;
+        s_cswSent = 0;
+        s_isDeferred = TRUE;
+        g_msc.in_flag = TRUE;
+        g_msc.out_flag = FALSE;
+
+        USB_MSC_LBA_Transfer(0, USB_SEND, &info);
+        USB_Class_MSC_Send_Data(0, BULK_IN_ENDPOINT, s_host, 0);
+        for (steps = 0; steps < MAX_STEPS && (s_hasPending || s_head < s_tail || work_has_pending()); ++steps)
+        {
+            if (work_has_pending())
+            {
+                run_work();
+            }
+            else if (s_hasPending)
+            {
+                finish_media();
+            }
+            else
+            {
+                uint32_t writePos = 0;
+                complete_xfer(&writePos);
+            }
+        }
+        if (s_hostPos != 4 * DISK_BLOCK_SIZE || s_cswSent != 1)
+        {
+            printf("  case 5: %d bytes and %d CSWs sent\n", s_hostPos, s_cswSent);
+            isOk = false;
+        }
+    }
+
+    printf("USB mass storage test %s\n", isOk ? "PASSED" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
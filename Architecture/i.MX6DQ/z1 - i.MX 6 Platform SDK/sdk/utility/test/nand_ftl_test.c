@@ -0,0 +1,605 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file nand_ftl_test.c
+ * @brief Test and benchmark of the flash translation layer on a simulated NAND.
+ *
+ * Every logical page is written with a pattern derived from its number and a version, and
+ * the versions are tracked, so any page read back can be checked. Random writes with a hot
+ * set drive garbage collection, remounts check the checkpoints and the replay, and power
+ * cuts at random programs and erases check that every completed write survives. Wear
+ * leveling and bad block handling run on a NAND with low endurance, and refreshes on one
+ * with frequent correctable bit errors.
+ *
+ * Uniform random writes over the whole device need a map cache that covers most of the map,
+ * otherwise every page garbage collection moves also evicts a map page. The tests that
+ * exercise map paging therefore use a small cache with a workload that has locality.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utility/nand_ftl.h"
+#include "nand_sim.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Page size of the simulated NAND.
+#define SIM_PAGE_SIZE (2048)
+
+//! @brief Pages per block of the simulated NAND.
+#define SIM_PAGES_PER_BLOCK (32)
+
+//! @brief Blocks of the simulated NAND.
+#define SIM_BLOCK_COUNT (256)
+
+//! @brief Largest random write in pages.
+#define MAX_WRITE_PAGES (4)
+
+//! @brief Number of power cuts.
+#define POWER_CUT_COUNT (40)
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void nand_ftl_test(void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static nand_sim_t s_sim;
+static ftl_nand_t s_nand;
+static ftl_t s_ftl;
+static ftl_config_t s_config;
+
+//! @brief Version of each logical page, 0 if it was never written.
+static uint32_t * s_versions;
+static uint32_t s_nextVersion;
+
+static uint32_t s_buffer[MAX_WRITE_PAGES * SIM_PAGE_SIZE / sizeof(uint32_t)];
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Contents of a logical page in one version.
+static void fill_page(uint32_t * data, uint32_t page, uint32_t version)
+{
+    uint32_t i;
+
+    for (i = 0; i < SIM_PAGE_SIZE / sizeof(uint32_t); ++i)
+    {
+        data[i] = (page * 0x9e3779b9) ^ (version * 0x85ebca6b) ^ i;
+    }
+}
+
+//! @brief Which version a logical page holds, 0 for never written, or -1 for garbage.
+static int page_version(const uint32_t * data, uint32_t page, uint32_t version, uint32_t other)
+{
+    uint32_t expected[SIM_PAGE_SIZE / sizeof(uint32_t)];
+    uint32_t versions[2] = { version, other };
+    uint32_t i;
+
+    for (i = 0; i < 2; ++i)
+    {
+        if (versions[i] == 0)
+        {
+            memset(expected, 0xff, sizeof(expected));
+        }
+        else
+        {
+            fill_page(expected, page, versions[i]);
+        }
+        if (memcmp(data, expected, sizeof(expected)) == 0)
+        {
+            return (int)versions[i];
+        }
+    }
+    return -1;
+}
+
+//! @brief Write logical pages with new versions.
+static int write_pages(uint32_t page, uint32_t count)
+{
+    uint32_t i;
+    int status;
+
+    for (i = 0; i < count; ++i)
+    {
+        fill_page(s_buffer + i * SIM_PAGE_SIZE / sizeof(uint32_t), page + i, s_nextVersion + i);
+    }
+    status = ftl_write(&s_ftl, page, count, s_buffer);
+    if (status == kFtlSuccess)
+    {
+        for (i = 0; i < count; ++i)
+        {
+            s_versions[page + i] = s_nextVersion++;
+        }
+    }
+    return status;
+}
+
+//! @brief Read back all logical pages and count the ones that do not match.
+static uint32_t verify_all(void)
+{
+    uint32_t mismatches = 0;
+    uint32_t page;
+
+    for (page = 0; page < s_ftl.logicalPages; ++page)
+    {
+        if (ftl_read(&s_ftl, page, 1, s_buffer) != kFtlSuccess
+            || page_version(s_buffer, page, s_versions[page], s_versions[page]) < 0)
+        {
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+//! @brief A random logical page, from the first tenth most of the time.
+static uint32_t random_page(uint32_t hotPercent)
+{
+    uint32_t range = s_ftl.logicalPages;
+
+    if ((uint32_t)(rand() % 100) < hotPercent)
+    {
+        range /= 10;
+    }
+    return rand() % range;
+}
+
+//! @brief Write random pages, running the background work every now and then.
+static bool random_writes(uint32_t count, uint32_t hotPercent)
+{
+    while (count)
+    {
+        uint32_t pages = 1 + rand() % MAX_WRITE_PAGES;
+        uint32_t page = random_page(hotPercent);
+
+        if (pages > count)
+        {
+            pages = count;
+        }
+        if (page + pages > s_ftl.logicalPages)
+        {
+            page = s_ftl.logicalPages - pages;
+        }
+        if (write_pages(page, pages) != kFtlSuccess)
+        {
+            return false;
+        }
+        count -= pages;
+
+        if ((rand() & 63) == 0)
+        {
+            ftl_background(&s_ftl);
+        }
+    }
+    return true;
+}
+
+//! @brief Set up a NAND and format it, with state for all its logical pages.
+static bool setup(const nand_sim_config_t * simConfig)
+{
+    if (!nand_sim_init(&s_sim, simConfig, &s_nand))
+    {
+        return false;
+    }
+    if (ftl_format(&s_ftl, &s_nand, &s_config) != kFtlSuccess)
+    {
+        nand_sim_free(&s_sim);
+        return false;
+    }
+    s_versions = (uint32_t *)calloc(s_ftl.logicalPages, sizeof(uint32_t));
+    s_nextVersion = 1;
+    return s_versions != NULL;
+}
+
+static void teardown(void)
+{
+    ftl_unmount(&s_ftl);
+    nand_sim_free(&s_sim);
+    free(s_versions);
+    s_versions = NULL;
+}
+
+//! @brief The default FTL tunables of the tests, with frequent checkpoints.
+static void default_config(void)
+{
+    ftl_get_default_config(&s_config);
+    s_config.checkpointInterval = 8;
+}
+
+//! @brief The default NAND of the tests.
+static void sim_config(nand_sim_config_t * config)
+{
+    nand_sim_get_default_config(config);
+    config->pageSize = SIM_PAGE_SIZE;
+    config->pagesPerBlock = SIM_PAGES_PER_BLOCK;
+    config->blockCount = SIM_BLOCK_COUNT;
+    config->badBlocks = 6;
+}
+
+//! @brief Print what a workload cost.
+static void print_cost(const char * name, const ftl_stats_t * before, const nand_sim_stats_t * simBefore)
+{
+    uint32_t host = s_ftl.stats.hostWrites - before->hostWrites;
+    uint32_t programs = s_sim.stats.programs - simBefore->programs;
+    uint64_t busy = s_sim.stats.busyTime - simBefore->busyTime;
+
+    if (host == 0)
+    {
+        printf("  %s: no pages written\n", name);
+        return;
+    }
+    printf("  %s: %d pages, write amplification %d.%02d, %d erases, %d us NAND time per page\n",
+           name, host, programs / host, programs * 100 / host % 100,
+           s_sim.stats.erases - simBefore->erases, (int)(busy / host));
+}
+
+//! @brief Formatting, unwritten pages, limits and the block device.
+static bool basic_test(void)
+{
+    nand_sim_config_t simConfig;
+    blk_device_t device;
+    blk_queue_t queue;
+    uint32_t mismatches;
+    uint32_t index;
+    bool isOk;
+
+    // Page the map through the smallest cache.
+    default_config();
+    s_config.mapCachePages = 2;
+    sim_config(&simConfig);
+    if (!setup(&simConfig))
+    {
+        printf("  basic: setup failed\n");
+        return false;
+    }
+
+    isOk = ftl_read(&s_ftl, 0, 1, s_buffer) == kFtlSuccess && page_version(s_buffer, 0, 0, 0) == 0
+        && ftl_read(&s_ftl, s_ftl.logicalPages - 1, 2, s_buffer) == kFtlInvalid
+        && ftl_write(&s_ftl, s_ftl.logicalPages, 1, s_buffer) == kFtlInvalid;
+
+    // Through a request queue.
+    ftl_blk_device_init(&device, &s_ftl);
+    blk_queue_init(&queue, &device, kBlkElevatorFifo);
+    fill_page(s_buffer, 10, 7);
+    fill_page(s_buffer + SIM_PAGE_SIZE / sizeof(uint32_t), 11, 8);
+    isOk = isOk && blk_transfer(&queue, kBlkWrite, 10, 2, s_buffer) == kBlkSuccess;
+    memset(s_buffer, 0, sizeof(s_buffer));
+    isOk = isOk && blk_transfer(&queue, kBlkRead, 10, 2, s_buffer) == kBlkSuccess
+        && page_version(s_buffer, 10, 7, 7) == 7
+        && page_version(s_buffer + SIM_PAGE_SIZE / sizeof(uint32_t), 11, 8, 8) == 8
+        && blk_transfer(&queue, kBlkRead, device.sectorCount - 1, 2, s_buffer) == kBlkInvalid;
+    s_versions[10] = 7;
+    s_versions[11] = 8;
+    s_nextVersion = 9;
+
+    // A few pages behind every map page, read back through remounts.
+    for (index = 0; index < s_ftl.mapPages && isOk; ++index)
+    {
+        uint32_t page = index * s_ftl.entriesPerMapPage + index % 7;
+        if (page + 2 <= s_ftl.logicalPages)
+        {
+            isOk = write_pages(page, 2) == kFtlSuccess;
+        }
+    }
+    mismatches = verify_all();
+    isOk = isOk && ftl_unmount(&s_ftl) == kFtlSuccess && ftl_mount(&s_ftl, &s_nand, &s_config) == kFtlSuccess;
+    mismatches += verify_all();
+    nand_sim_cut_power(&s_sim, 0);
+    ftl_unmount(&s_ftl);
+    nand_sim_restore_power(&s_sim);
+    isOk = isOk && ftl_mount(&s_ftl, &s_nand, &s_config) == kFtlSuccess;
+    mismatches += verify_all();
+    isOk = isOk && !mismatches;
+
+    printf("  basic: %d logical pages in %d map pages, %d map reads, %s\n",
+           s_ftl.logicalPages, s_ftl.mapPages, s_ftl.stats.mapReads, isOk ? "ok" : "wrong");
+    teardown();
+    return isOk;
+}
+
+//! @brief Garbage collection under sequential and random writes, and remounting.
+static bool gc_test(void)
+{
+    nand_sim_config_t simConfig;
+    nand_sim_stats_t simBefore;
+    ftl_stats_t before;
+    uint32_t mismatches;
+    uint32_t fullScan;
+    uint32_t page;
+    bool isOk = true;
+
+    default_config();
+    sim_config(&simConfig);
+    if (!setup(&simConfig))
+    {
+        printf("  gc: setup failed\n");
+        return false;
+    }
+
+    before = s_ftl.stats;
+    simBefore = s_sim.stats;
+    for (page = 0; page < s_ftl.logicalPages && isOk; page += MAX_WRITE_PAGES)
+    {
+        uint32_t count = s_ftl.logicalPages - page;
+        isOk = write_pages(page, count < MAX_WRITE_PAGES ? count : MAX_WRITE_PAGES) == kFtlSuccess;
+    }
+    print_cost("sequential", &before, &simBefore);
+
+    before = s_ftl.stats;
+    simBefore = s_sim.stats;
+    isOk = isOk && random_writes(s_ftl.logicalPages * 3, 0);
+    print_cost("uniform random", &before, &simBefore);
+
+    before = s_ftl.stats;
+    simBefore = s_sim.stats;
+    isOk = isOk && random_writes(s_ftl.logicalPages * 3, 90);
+    print_cost("hot random", &before, &simBefore);
+
+    mismatches = verify_all();
+    printf("  gc: %d blocks reclaimed, %d pages copied, %d map reads, %d map writes, %d checkpoints\n",
+           s_ftl.stats.gcBlocks, s_ftl.stats.gcCopies, s_ftl.stats.mapReads, s_ftl.stats.mapWrites, s_ftl.stats.checkpoints);
+
+    // Remount after a clean unmount, then after dropping the FTL without a checkpoint.
+    isOk = isOk && ftl_unmount(&s_ftl) == kFtlSuccess && ftl_mount(&s_ftl, &s_nand, &s_config) == kFtlSuccess;
+    mismatches += verify_all();
+    fullScan = SIM_BLOCK_COUNT * SIM_PAGES_PER_BLOCK;
+    printf("  clean mount: %d NAND reads, %d for a full scan\n", s_ftl.stats.mountReads, fullScan);
+    isOk = isOk && s_ftl.stats.mountReads < SIM_BLOCK_COUNT;
+
+    isOk = isOk && random_writes(s_config.checkpointInterval * SIM_PAGES_PER_BLOCK / 2, 50);
+    nand_sim_cut_power(&s_sim, 0);
+    ftl_unmount(&s_ftl);
+    nand_sim_restore_power(&s_sim);
+    isOk = isOk && ftl_mount(&s_ftl, &s_nand, &s_config) == kFtlSuccess;
+    mismatches += verify_all();
+    printf("  mount after a crash: %d NAND reads, %d pages replayed\n", s_ftl.stats.mountReads, s_ftl.stats.replayedPages);
+
+    if (mismatches || s_sim.stats.violations)
+    {
+        printf("  gc: %d mismatches, %d NAND violations\n", mismatches, s_sim.stats.violations);
+    }
+    isOk = isOk && !mismatches && !s_sim.stats.violations;
+    teardown();
+    return isOk;
+}
+
+//! @brief Power cuts at random programs and erases.
+static bool power_cut_test(void)
+{
+    nand_sim_config_t simConfig;
+    uint32_t mismatches = 0;
+    uint32_t lostMounts = 0;
+    uint32_t cut;
+    bool isOk = true;
+
+    // Cut the power while map pages are evicted as well.
+    default_config();
+    s_config.mapCachePages = 4;
+    sim_config(&simConfig);
+    if (!setup(&simConfig))
+    {
+        printf("  power cut: setup failed\n");
+        return false;
+    }
+    isOk = random_writes(s_ftl.logicalPages, 90);
+
+    for (cut = 0; cut < POWER_CUT_COUNT && isOk; ++cut)
+    {
+        uint32_t page = 0;
+        uint32_t pages = 0;
+        uint32_t i;
+
+        nand_sim_cut_power(&s_sim, rand() % (SIM_PAGES_PER_BLOCK * 24));
+
+        // Write until the power fails. The interrupted write may or may not have made it.
+        for (;;)
+        {
+            pages = 1 + rand() % MAX_WRITE_PAGES;
+            page = random_page(90);
+            if (page + pages > s_ftl.logicalPages)
+            {
+                page = s_ftl.logicalPages - pages;
+            }
+            if (write_pages(page, pages) != kFtlSuccess)
+            {
+                break;
+            }
+            if ((rand() & 15) == 0)
+            {
+                ftl_background(&s_ftl);
+            }
+        }
+
+        ftl_unmount(&s_ftl);
+        nand_sim_restore_power(&s_sim);
+        if (ftl_mount(&s_ftl, &s_nand, &s_config) != kFtlSuccess)
+        {
+            ++lostMounts;
+            isOk = false;
+            break;
+        }
+
+        // Accept either version of the interrupted pages, the rest has to be intact.
+        for (i = 0; i < pages; ++i)
+        {
+            int version;
+
+            if (ftl_read(&s_ftl, page + i, 1, s_buffer) != kFtlSuccess)
+            {
+                ++mismatches;
+                continue;
+            }
+            version = page_version(s_buffer, page + i, s_versions[page + i], s_nextVersion + i);
+            if (version < 0)
+            {
+                ++mismatches;
+            }
+            else
+            {
+                s_versions[page + i] = version;
+            }
+        }
+        s_nextVersion += MAX_WRITE_PAGES;
+        mismatches += verify_all();
+    }
+
+    printf("  power cut: %d cuts, %d mismatches, %d failed mounts, %d NAND violations\n",
+           cut, mismatches, lostMounts, s_sim.stats.violations);
+    isOk = isOk && !mismatches && !s_sim.stats.violations;
+    teardown();
+    return isOk;
+}
+
+//! @brief Static wear leveling, with the checkpoint blocks wearing no faster than the rest.
+static bool wear_test(void)
+{
+    nand_sim_config_t simConfig;
+    uint32_t minErase = 0xffffffff;
+    uint32_t maxErase = 0;
+    uint32_t checkpointErase = 0;
+    uint32_t mismatches;
+    uint32_t block;
+    uint32_t page;
+    bool isOk = true;
+
+    default_config();
+    s_config.wearLevelThreshold = 30;
+    sim_config(&simConfig);
+    simConfig.endurance = 400;
+    simConfig.wearBitErrors = 4;
+    if (!setup(&simConfig))
+    {
+        printf("  wear: setup failed\n");
+        return false;
+    }
+
+    // Cold data everywhere, then rewrite a small hot set over and over.
+    for (page = 0; page < s_ftl.logicalPages && isOk; page += MAX_WRITE_PAGES)
+    {
+        uint32_t count = s_ftl.logicalPages - page;
+        isOk = write_pages(page, count < MAX_WRITE_PAGES ? count : MAX_WRITE_PAGES) == kFtlSuccess;
+    }
+    while (isOk && s_ftl.stats.hostWrites < s_ftl.logicalPages * 10)
+    {
+        page = rand() % (SIM_PAGES_PER_BLOCK * 4);
+        isOk = write_pages(page, 1) == kFtlSuccess;
+        if ((rand() & 15) == 0)
+        {
+            ftl_background(&s_ftl);
+        }
+    }
+
+    for (block = 0; block < FTL_CHECKPOINT_BLOCKS; ++block)
+    {
+        checkpointErase = (s_sim.eraseCount[block] > checkpointErase) ? s_sim.eraseCount[block] : checkpointErase;
+    }
+    for (block = FTL_CHECKPOINT_BLOCKS; block < SIM_BLOCK_COUNT; ++block)
+    {
+        if (!s_sim.isBad[block])
+        {
+            minErase = (s_sim.eraseCount[block] < minErase) ? s_sim.eraseCount[block] : minErase;
+            maxErase = (s_sim.eraseCount[block] > maxErase) ? s_sim.eraseCount[block] : maxErase;
+        }
+    }
+    mismatches = verify_all();
+
+    printf("  wear: erase counts %d to %d, %d for checkpoint blocks, %d blocks moved for wear leveling, "
+           "%d retired, %d mismatches\n", minErase, maxErase, checkpointErase, s_ftl.stats.wearLevelBlocks,
+           s_ftl.stats.badBlocks, mismatches);
+    isOk = isOk && !mismatches && s_ftl.stats.wearLevelBlocks && maxErase - minErase <= 4 * s_config.wearLevelThreshold
+        && checkpointErase <= maxErase;
+    teardown();
+    return isOk;
+}
+
+//! @brief Refreshing blocks with many corrected bit errors, and failing programs.
+static bool error_test(void)
+{
+    nand_sim_config_t simConfig;
+    uint32_t mismatches;
+    uint32_t i;
+    bool isOk;
+
+    default_config();
+    sim_config(&simConfig);
+    simConfig.burstRate = 2000;
+    simConfig.programFailRate = 100;
+    if (!setup(&simConfig))
+    {
+        printf("  errors: setup failed\n");
+        return false;
+    }
+
+    // Reads flag blocks for a refresh, which the background work then does.
+    isOk = random_writes(s_ftl.logicalPages * 2, 50);
+    mismatches = 0;
+    for (i = 0; i < 4; ++i)
+    {
+        mismatches += verify_all();
+        while (ftl_background(&s_ftl))
+        {
+        }
+    }
+
+    printf("  errors: %d corrected reads, %d blocks refreshed, %d program failures, %d retired, %d mismatches\n",
+           s_sim.stats.corrected, s_ftl.stats.refreshBlocks, s_sim.stats.failures, s_ftl.stats.badBlocks, mismatches);
+    isOk = isOk && !mismatches && s_ftl.stats.refreshBlocks && s_ftl.stats.badBlocks;
+    teardown();
+    return isOk;
+}
+
+void nand_ftl_test(void)
+{
+    bool isOk = true;
+
+    printf("Running the NAND FTL test\n");
+    srand(1);
+
+    isOk = basic_test() && isOk;
+    isOk = gc_test() && isOk;
+    isOk = power_cut_test() && isOk;
+    isOk = wear_test() && isOk;
+    isOk = error_test() && isOk;
+
+    printf("NAND FTL test %s\n", isOk ? "PASSED" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
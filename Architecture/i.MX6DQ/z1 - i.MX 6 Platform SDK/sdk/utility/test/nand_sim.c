@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file nand_sim.c
+ * @brief NAND simulator in RAM for testing and benchmarking the FTL.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "nand_sim.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Values of nand_sim_t::pageState.
+enum _nand_sim_page_state
+{
+    kSimPageErased = 0,
+    kSimPageProgrammed = 1,
+    kSimPageTorn = 2            //!< Interrupted program or erase, unreadable.
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Next number of an xorshift generator.
+static uint32_t sim_random(nand_sim_t * sim)
+{
+    uint32_t x = sim->random;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->random = x;
+    return x;
+}
+
+//! @brief Whether the power fails at this program or erase.
+static bool sim_is_torn(nand_sim_t * sim)
+{
+    if (sim->powerCut && --sim->powerCut == 0)
+    {
+        sim->isPowerLost = true;
+        return true;
+    }
+    return false;
+}
+
+static int sim_read(const ftl_nand_t * nand, uint32_t page, void * data, ftl_spare_t * spare)
+{
+    nand_sim_t * sim = (nand_sim_t *)nand->context;
+    const nand_sim_config_t * config = &sim->config;
+    uint32_t block = page / config->pagesPerBlock;
+    uint32_t bitErrors = 0;
+
+    if (sim->isPowerLost)
+    {
+        return kFtlNandFailed;
+    }
+
+    ++sim->stats.reads;
+    sim->stats.busyTime += config->readTime;
+
+    if (sim->pageState[page] == kSimPageTorn)
+    {
+        memset(spare, 0, sizeof(*spare));
+        if (data)
+        {
+            memset(data, 0x5a, config->pageSize);
+        }
+        ++sim->stats.uncorrectable;
+        return kFtlNandEccError;
+    }
+
+    if (data)
+    {
+        memcpy(data, sim->data + (uint64_t)page * config->pageSize, config->pageSize);
+    }
+    *spare = sim->spare[page];
+
+    // Erased pages read as all ones without errors, like with erased page detection.
+    if (sim->pageState[page] == kSimPageErased)
+    {
+        return kFtlNandSuccess;
+    }
+
+    if (config->endurance)
+    {
+        bitErrors = config->wearBitErrors * sim->eraseCount[block] / config->endurance;
+    }
+    if ((sim_random(sim) & 0xffff) < config->burstRate)
+    {
+        bitErrors += 1 + sim_random(sim) % config->eccStrength;
+    }
+
+    if (bitErrors > config->eccStrength)
+    {
+        if (data)
+        {
+            ((uint8_t *)data)[sim_random(sim) % config->pageSize] ^= 0x10;
+        }
+        ++sim->stats.uncorrectable;
+        return kFtlNandEccError;
+    }
+    if (config->refreshThreshold && bitErrors >= config->refreshThreshold)
+    {
+        ++sim->stats.corrected;
+        return kFtlNandCorrected;
+    }
+    return kFtlNandSuccess;
+}
+
+static int sim_program(const ftl_nand_t * nand, uint32_t page, const void * data, const ftl_spare_t * spare)
+{
+    nand_sim_t * sim = (nand_sim_t *)nand->context;
+    const nand_sim_config_t * config = &sim->config;
+    uint32_t block = page / config->pagesPerBlock;
+    uint32_t index = page % config->pagesPerBlock;
+
+    if (sim->isPowerLost)
+    {
+        return kFtlNandFailed;
+    }
+
+    ++sim->stats.programs;
+    sim->stats.busyTime += config->programTime;
+
+    if (sim->pageState[page] != kSimPageErased || index < sim->nextPage[block])
+    {
+        ++sim->stats.violations;
+    }
+    sim->nextPage[block] = index + 1;
+
+    if (sim_is_torn(sim) || (sim_random(sim) & 0xffff) < config->programFailRate)
+    {
+        sim->pageState[page] = kSimPageTorn;
+        ++sim->stats.failures;
+        return kFtlNandFailed;
+    }
+
+    memcpy(sim->data + (uint64_t)page * config->pageSize, data, config->pageSize);
+    sim->spare[page] = *spare;
+    sim->pageState[page] = kSimPageProgrammed;
+    return kFtlNandSuccess;
+}
+
+static int sim_erase(const ftl_nand_t * nand, uint32_t block)
+{
+    nand_sim_t * sim = (nand_sim_t *)nand->context;
+    const nand_sim_config_t * config = &sim->config;
+    uint32_t firstPage = block * config->pagesPerBlock;
+    bool isWornOut;
+
+    if (sim->isPowerLost)
+    {
+        return kFtlNandFailed;
+    }
+
+    ++sim->stats.erases;
+    sim->stats.busyTime += config->eraseTime;
+
+    if (sim_is_torn(sim))
+    {
+        memset(sim->pageState + firstPage, kSimPageTorn, config->pagesPerBlock);
+        return kFtlNandFailed;
+    }
+
+    isWornOut = config->endurance && sim->eraseCount[block] >= config->endurance && (sim_random(sim) & 0xf) == 0;
+    if (sim->isBad[block] || isWornOut)
+    {
+        ++sim->stats.failures;
+        return kFtlNandFailed;
+    }
+
+    memset(sim->data + (uint64_t)firstPage * config->pageSize, 0xff, (uint64_t)config->pagesPerBlock * config->pageSize);
+    memset(sim->spare + firstPage, 0xff, config->pagesPerBlock * sizeof(ftl_spare_t));
+    memset(sim->pageState + firstPage, kSimPageErased, config->pagesPerBlock);
+    sim->nextPage[block] = 0;
+    ++sim->eraseCount[block];
+    return kFtlNandSuccess;
+}
+
+static bool sim_is_bad(const ftl_nand_t * nand, uint32_t block)
+{
+    nand_sim_t * sim = (nand_sim_t *)nand->context;
+
+    return sim->isBad[block] != 0;
+}
+
+static void sim_mark_bad(const ftl_nand_t * nand, uint32_t block)
+{
+    nand_sim_t * sim = (nand_sim_t *)nand->context;
+
+    if (!sim->isPowerLost)
+    {
+        sim->isBad[block] = 1;
+    }
+}
+
+void nand_sim_get_default_config(nand_sim_config_t * config)
+{
+    memset(config, 0, sizeof(*config));
+    config->pageSize = 2048;
+    config->pagesPerBlock = 64;
+    config->blockCount = 256;
+    config->eccStrength = 8;
+    config->refreshThreshold = 6;
+    config->seed = 1;
+    config->readTime = 50;
+    config->programTime = 300;
+    config->eraseTime = 2000;
+}
+
+bool nand_sim_init(nand_sim_t * sim, const nand_sim_config_t * config, ftl_nand_t * nand)
+{
+    uint32_t pageCount = config->pagesPerBlock * config->blockCount;
+    uint32_t i;
+
+    memset(sim, 0, sizeof(*sim));
+    sim->config = *config;
+    sim->random = config->seed ? config->seed : 1;
+    sim->data = (uint8_t *)malloc((uint64_t)pageCount * config->pageSize);
+    sim->spare = (ftl_spare_t *)malloc(pageCount * sizeof(ftl_spare_t));
+    sim->pageState = (uint8_t *)malloc(pageCount);
+    sim->eraseCount = (uint32_t *)calloc(config->blockCount, sizeof(uint32_t));
+    sim->nextPage = (uint16_t *)calloc(config->blockCount, sizeof(uint16_t));
+    sim->isBad = (uint8_t *)calloc(config->blockCount, sizeof(uint8_t));
+    if (!sim->data || !sim->spare || !sim->pageState || !sim->eraseCount || !sim->nextPage || !sim->isBad)
+    {
+        nand_sim_free(sim);
+        return false;
+    }
+
+    // Start out erased.
+    memset(sim->data, 0xff, (uint64_t)pageCount * config->pageSize);
+    memset(sim->spare, 0xff, pageCount * sizeof(ftl_spare_t));
+    memset(sim->pageState, kSimPageErased, pageCount);
+
+    for (i = 0; i < config->badBlocks && i + 1 < config->blockCount; ++i)
+    {
+        uint32_t block;
+        do {
+            block = 1 + sim_random(sim) % (config->blockCount - 1);
+        } while (sim->isBad[block]);
+        sim->isBad[block] = 1;
+    }
+
+    nand->pageSize = config->pageSize;
+    nand->pagesPerBlock = config->pagesPerBlock;
+    nand->blockCount = config->blockCount;
+    nand->read = sim_read;
+    nand->program = sim_program;
+    nand->erase = sim_erase;
+    nand->isBad = sim_is_bad;
+    nand->markBad = sim_mark_bad;
+    nand->context = sim;
+    return true;
+}
+
+void nand_sim_free(nand_sim_t * sim)
+{
+    free(sim->data);
+    free(sim->spare);
+    free(sim->pageState);
+    free(sim->eraseCount);
+    free(sim->nextPage);
+    free(sim->isBad);
+    memset(sim, 0, sizeof(*sim));
+}
+
+void nand_sim_cut_power(nand_sim_t * sim, uint32_t operations)
+{
+    sim->powerCut = operations + 1;
+}
+
+void nand_sim_restore_power(nand_sim_t * sim)
+{
+    sim->powerCut = 0;
+    sim->isPowerLost = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
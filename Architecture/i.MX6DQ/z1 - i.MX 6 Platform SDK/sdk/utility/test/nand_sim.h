@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if !defined(__NAND_SIM_H__)
+#define __NAND_SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "utility/nand_ftl.h"
+
+/*!
+ * @file nand_sim.h
+ * @brief NAND simulator in RAM for testing and benchmarking the FTL.
+ *
+ * Pages have to be programmed in order within their block and only once between erases,
+ * otherwise the access is counted as a violation. Reads see raw bit errors that grow with
+ * the erase count of the block, plus random correctable bursts, and report them like an ECC
+ * engine of the configured strength would. Blocks wear out beyond their endurance and then
+ * fail to erase at random. A power cut can be scheduled, which tears the program or erase it
+ * hits and fails all operations after it until power is restored.
+ *
+ * Busy times of the operations are added up, so benchmarks can report the NAND time a
+ * workload would take.
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Geometry and behavior of a simulated NAND.
+typedef struct _nand_sim_config {
+    uint32_t pageSize;          //!< Data bytes of a page.
+    uint32_t pagesPerBlock;     //!< Pages of an erase block.
+    uint32_t blockCount;        //!< Erase blocks.
+    uint32_t badBlocks;         //!< Factory bad blocks, placed at random but never in block 0.
+    uint32_t endurance;         //!< Erase cycles after which erases may fail, 0 for unlimited.
+    uint32_t eccStrength;       //!< Bit errors per page that are corrected.
+    uint32_t refreshThreshold;  //!< Bit errors at which a read reports #kFtlNandCorrected.
+    uint32_t wearBitErrors;     //!< Raw bit errors of a page at the endurance limit.
+    uint32_t burstRate;         //!< Chance of a burst of bit errors on a read, in 1/65536.
+    uint32_t programFailRate;   //!< Chance of a failed program, in 1/65536.
+    uint32_t seed;              //!< Seed of the random number generator.
+    uint32_t readTime;          //!< Busy time of a page read, in microseconds.
+    uint32_t programTime;       //!< Busy time of a page program, in microseconds.
+    uint32_t eraseTime;         //!< Busy time of a block erase, in microseconds.
+} nand_sim_config_t;
+
+//! @brief Statistics of a simulated NAND.
+typedef struct _nand_sim_stats {
+    uint32_t reads;             //!< Page and spare reads.
+    uint32_t programs;          //!< Page programs.
+    uint32_t erases;            //!< Block erases.
+    uint32_t corrected;         //!< Reads reported as #kFtlNandCorrected.
+    uint32_t uncorrectable;     //!< Reads reported as #kFtlNandEccError.
+    uint32_t failures;          //!< Programs and erases that failed.
+    uint32_t violations;        //!< Programs out of order or of a page that was not erased.
+    uint64_t busyTime;          //!< Sum of the busy times, in microseconds.
+} nand_sim_stats_t;
+
+//! @brief A simulated NAND.
+typedef struct _nand_sim {
+    nand_sim_config_t config;   //!< Geometry and behavior.
+    uint8_t * data;             //!< Page data.
+    ftl_spare_t * spare;        //!< Spare area of each page.
+    uint8_t * pageState;        //!< Whether each page is erased, programmed or torn.
+    uint32_t * eraseCount;      //!< Erase count of each block.
+    uint16_t * nextPage;        //!< Lowest page of each block that may be programmed.
+    uint8_t * isBad;            //!< Bad block marker of each block.
+    uint32_t random;            //!< State of the random number generator.
+    uint32_t powerCut;          //!< Programs and erases until the power cut, 0 for none.
+    bool isPowerLost;           //!< All operations fail.
+    nand_sim_stats_t stats;     //!< Statistics.
+} nand_sim_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @brief Fill in a small NAND without errors and typical timings.
+void nand_sim_get_default_config(nand_sim_config_t * config);
+
+//! @brief Allocate an erased NAND and the FTL access to it.
+//!
+//! @retval true The NAND was set up.
+//! @retval false Out of memory.
+bool nand_sim_init(nand_sim_t * sim, const nand_sim_config_t * config, ftl_nand_t * nand);
+
+//! @brief Free a NAND.
+void nand_sim_free(nand_sim_t * sim);
+
+//! @brief Cut the power at a program or erase.
+//!
+//! @param operations Programs and erases that still complete, the next one is torn.
+void nand_sim_cut_power(nand_sim_t * sim, uint32_t operations);
+
+//! @brief Restore the power after a cut.
+void nand_sim_restore_power(nand_sim_t * sim);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // __NAND_SIM_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file scheduler_test.c
+ * @brief Test and benchmark of the work-stealing task scheduler.
+ *
+ * Also builds for Linux, see host/Makefile.
+ */
+
+#include <stdio.h>
+#include "utility/atomics.h"
+#include "utility/scheduler.h"
+#if defined(__linux__)
+#include <time.h>
+#include <unistd.h>
+#else
+#include "sdk.h"
+#include "core/cortex_a9.h"
+#include "core/pl310.h"
+#include "cpu_utility/cpu_utility.h"
+#include "timer/timer.h"
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Fibonacci number computed by the fork-join test.
+//!
+//! Large enough that the run takes milliseconds, far longer than waking the workers.
+#define FIB_N (30)
+
+//! @brief Below this, fib() recurses without spawning tasks.
+#define FIB_CUTOFF (16)
+
+//! @brief Number of timed fib() runs, the fastest counts.
+#define FIB_RUNS (3)
+
+//! @brief Smallest accepted speedup, in percent of the number of workers.
+//!
+//! Only checked when each worker has a CPU of its own.
+#define MIN_SPEEDUP_PERCENT (60)
+
+//! @brief Number of elements summed by the parallel_for test.
+#define SUM_COUNT (16384)
+
+//! @brief Arguments and result of a fib() task.
+typedef struct _fib_task {
+    uint32_t n;
+    uint32_t result;
+} fib_task_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void scheduler_test(void);
+void scheduler_test_cpu_init(uint32_t cpu);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static uint32_t s_sumInput[SUM_COUNT];
+static volatile int32_t s_sum;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Number of CPUs the workers can run on.
+static uint32_t get_cpu_count(void)
+{
+#if defined(__linux__)
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t)count : 1;
+#else
+    return (uint32_t)cpu_get_cores();
+#endif
+}
+
+static uint32_t get_microseconds(void)
+{
+#if defined(__linux__)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000000 + now.tv_nsec / 1000);
+#else
+    return (uint32_t)time_get_microseconds();
+#endif
+}
+
+//! @brief Enable the caches and join SMP, as in the smp_primes app.
+//!
+//! The secondary cores come out of reset with their caches disabled, and the exclusive
+//! accesses of the atomics only work between cores in coherent memory. Also used by the
+//! spinlock test.
+void scheduler_test_cpu_init(uint32_t cpu)
+{
+#if !defined(__linux__)
+    if (cpu == 0)
+    {
+        scu_enable();
+    }
+
+    arm_branch_target_cache_invalidate();
+    arm_branch_prediction_enable();
+    arm_dcache_enable();
+    arm_dcache_invalidate();
+    arm_icache_enable();
+    arm_icache_invalidate();
+
+    if (cpu == 0)
+    {
+        pl310_enable();
+    }
+
+    scu_secure_invalidate(cpu, 0xf);
+    scu_join_smp();
+    scu_enable_maintenance_broadcast();
+#else
+    (void)cpu;
+#endif
+}
+
+static uint32_t fib_serial(uint32_t n)
+{
+    return n < 2 ? n : fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+static void fib_task(void * arg)
+{
+    fib_task_t * task = (fib_task_t *)arg;
+    fib_task_t left;
+    fib_task_t right;
+    task_group_t group;
+
+    if (task->n < FIB_CUTOFF)
+    {
+        task->result = fib_serial(task->n);
+        return;
+    }
+
+    left.n = task->n - 1;
+    right.n = task->n - 2;
+
+    task_group_init(&group);
+    task_spawn(&group, fib_task, &left);
+    fib_task(&right);
+    task_group_wait(&group);
+
+    task->result = left.result + right.result;
+}
+
+static void sum_body(uint32_t begin, uint32_t end, void * arg)
+{
+    uint32_t * input = (uint32_t *)arg;
+    int32_t sum = 0;
+
+    for (; begin < end; ++begin)
+    {
+        sum += input[begin];
+    }
+
+    atomic_add(&s_sum, sum);
+}
+
+//! @brief Run the fork-join and parallel_for tests with a number of workers.
+//! @param[in,out] workerCount Number of workers to start, then the number started.
+//! @return The fastest time fib() took, in microseconds, or 0 if a result was wrong.
+static uint32_t scheduler_test_run(uint32_t * workerCount, uint32_t expectedFib)
+{
+    fib_task_t fib;
+    scheduler_stats_t stats;
+    uint32_t start;
+    uint32_t elapsed = 0;
+    uint32_t run;
+    uint32_t i;
+    bool isOk = true;
+
+    *workerCount = scheduler_start(*workerCount, scheduler_test_cpu_init);
+
+    for (run = 0; run < FIB_RUNS; ++run)
+    {
+        fib.n = FIB_N;
+        fib.result = 0;
+
+        start = get_microseconds();
+        fib_task(&fib);
+        start = get_microseconds() - start;
+
+        if (run == 0 || start < elapsed)
+        {
+            elapsed = start;
+        }
+
+        if (fib.result != expectedFib)
+        {
+            printf("  fib(%d) = %d, expected %d\n", FIB_N, fib.result, expectedFib);
+            isOk = false;
+        }
+    }
+
+    s_sum = 0;
+    parallel_for(0, SUM_COUNT, 64, sum_body, s_sumInput);
+    if (s_sum != (SUM_COUNT * (SUM_COUNT - 1)) / 2)
+    {
+        printf("  parallel_for sum = %d, expected %d\n", s_sum, (SUM_COUNT * (SUM_COUNT - 1)) / 2);
+        isOk = false;
+    }
+
+    scheduler_stop();
+
+    printf("  %d worker(s): fib(%d) in %d us, best of %d\n", *workerCount, FIB_N, elapsed, FIB_RUNS);
+    for (i = 0; i < *workerCount; ++i)
+    {
+        scheduler_get_stats(i, &stats);
+        printf("    worker %d: %d executed, %d stolen of %d attempts, %d inlined, %d sleeps\n",
+               i, stats.executed, stats.stolen, stats.stealAttempts, stats.inlined, stats.sleeps);
+    }
+
+    return isOk ? elapsed : 0;
+}
+
+void scheduler_test(void)
+{
+    uint32_t expectedFib;
+    uint32_t serialTime;
+    uint32_t parallelTime;
+    uint32_t workerCount;
+    uint32_t cpuCount = get_cpu_count();
+    uint32_t speedup;
+    uint32_t i;
+
+    printf("Running the task scheduler test\n");
+
+    for (i = 0; i < SUM_COUNT; ++i)
+    {
+        s_sumInput[i] = i;
+    }
+
+    expectedFib = fib_serial(FIB_N);
+
+    workerCount = 1;
+    serialTime = scheduler_test_run(&workerCount, expectedFib);
+    workerCount = SCHEDULER_MAX_WORKERS;
+    parallelTime = scheduler_test_run(&workerCount, expectedFib);
+
+    if (serialTime == 0 || parallelTime == 0)
+    {
+        printf("Task scheduler test FAILED\n");
+        return;
+    }
+
+    speedup = serialTime * 100 / parallelTime;
+    printf("Speedup with %d workers: %d.%02d\n", workerCount, speedup / 100, speedup % 100);
+
+    // With fewer CPUs than workers, the threads only take turns and nothing can be gained.
+    if (workerCount > 1 && cpuCount >= workerCount)
+    {
+        if (speedup < workerCount * MIN_SPEEDUP_PERCENT)
+        {
+            printf("  expected at least %d.%02d\n", workerCount * MIN_SPEEDUP_PERCENT / 100,
+                   workerCount * MIN_SPEEDUP_PERCENT % 100);
+            printf("Task scheduler test FAILED\n");
+            return;
+        }
+    }
+    else
+    {
+        printf("  %d CPU(s) for %d workers, speedup not checked\n", cpuCount, workerCount);
+    }
+
+    printf("Task scheduler test PASSED\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file smp_malloc_test.c
+ * @brief Test of the multicore heap allocator.
+ *
+ * Every worker of the task scheduler allocates and frees at the same time, so this runs on
+ * all cores, or on POSIX threads when built for Linux, see host/Makefile.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "utility/atomics.h"
+#include "utility/smp_malloc.h"
+#include "utility/scheduler.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Number of stress test rounds, each handled by one task.
+#define STRESS_ROUNDS (64)
+
+//! @brief Blocks each stress round keeps allocated at once.
+#define STRESS_SLOTS (64)
+
+//! @brief Allocations done by each stress round.
+#define STRESS_ALLOCATIONS (1000)
+
+#if defined(__linux__)
+//! @brief Heap used on a host, where the allocator does not replace malloc().
+#define HOST_HEAP_SIZE (8 * 1024 * 1024)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void smp_malloc_test(void);
+void scheduler_test_cpu_init(uint32_t cpu);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__linux__)
+static uint8_t s_hostHeap[HOST_HEAP_SIZE] __attribute__ ((aligned (SMP_MALLOC_SPAN_SIZE)));
+#endif
+
+//! @brief Number of corrupted blocks found by the stress test.
+static volatile int32_t s_stressErrors;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Fill a block with a pattern derived from its tag.
+static void fill_block(uint8_t * block, uint32_t size, uint32_t tag)
+{
+    uint32_t i;
+
+    for (i = 0; i < size; ++i)
+    {
+        block[i] = (uint8_t)(tag + i);
+    }
+}
+
+//! @brief Check the pattern written by fill_block().
+static bool check_block(const uint8_t * block, uint32_t size, uint32_t tag)
+{
+    uint32_t i;
+
+    for (i = 0; i < size; ++i)
+    {
+        if (block[i] != (uint8_t)(tag + i))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//! @brief Check single block properties from one worker.
+static bool test_basic(void)
+{
+    static const uint32_t sizes[] = { 1, 31, 32, 33, 100, 256, 257, 1000, 4096, 8192, 8193, 100000 };
+    void * blocks[sizeof(sizes) / sizeof(sizes[0])];
+    uint8_t * ptr;
+    uint32_t i;
+    bool isOk = true;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        blocks[i] = smp_malloc(sizes[i]);
+        if (!blocks[i] || ((uintptr_t)blocks[i] & 31) || smp_malloc_usable_size(blocks[i]) < sizes[i]
+            || (smp_malloc_usable_size(blocks[i]) & 31))
+        {
+            printf("  malloc(%d) returned %p with %d usable bytes\n", sizes[i], blocks[i],
+                   (uint32_t)smp_malloc_usable_size(blocks[i]));
+            isOk = false;
+        }
+        else
+        {
+            fill_block(blocks[i], sizes[i], i);
+        }
+    }
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+    {
+        if (blocks[i] && !check_block(blocks[i], sizes[i], i))
+        {
+            printf("  block of %d bytes was overwritten\n", sizes[i]);
+            isOk = false;
+        }
+        smp_free(blocks[i]);
+    }
+
+    // Growing a block keeps its contents.
+    ptr = smp_malloc(40);
+    fill_block(ptr, 40, 7);
+    ptr = smp_realloc(ptr, 20000);
+    if (!ptr || !check_block(ptr, 40, 7))
+    {
+        printf("  realloc lost the contents\n");
+        isOk = false;
+    }
+    smp_free(ptr);
+
+    ptr = smp_calloc(100, 3);
+    for (i = 0; ptr && i < 300; ++i)
+    {
+        isOk = isOk && ptr[i] == 0;
+    }
+    smp_free(ptr);
+
+    // Aligned blocks from a size class and from a span run.
+    for (i = 64; i <= 2 * SMP_MALLOC_SPAN_SIZE; i <<= 1)
+    {
+        ptr = smp_memalign(i, 1000);
+        if (!ptr || ((uintptr_t)ptr & (i - 1)) || smp_malloc_usable_size(ptr) < 1000)
+        {
+            printf("  memalign(%d) returned %p\n", i, ptr);
+            isOk = false;
+        }
+        else
+        {
+            fill_block(ptr, 1000, i);
+        }
+        smp_free(ptr);
+    }
+
+    return isOk;
+}
+
+//! @brief Allocate and free blocks of random sizes, checking none of them overlap.
+static void stress_body(uint32_t begin, uint32_t end, void * arg)
+{
+    uint8_t * blocks[STRESS_SLOTS] = { 0 };
+    uint32_t sizes[STRESS_SLOTS];
+    uint32_t random = begin * 2654435761u + 1;
+    uint32_t i;
+    uint32_t slot;
+
+    for (i = 0; i < STRESS_ALLOCATIONS; ++i)
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        slot = random % STRESS_SLOTS;
+
+        if (blocks[slot])
+        {
+            if (!check_block(blocks[slot], sizes[slot], slot))
+            {
+                atomic_increment(&s_stressErrors);
+            }
+            smp_free(blocks[slot]);
+        }
+
+        // Mostly small blocks, sometimes a large one.
+        sizes[slot] = (random >> 8) % ((random & 0xf0) == 0 ? 3 * SMP_MALLOC_SPAN_SIZE : 2048) + 1;
+        blocks[slot] = smp_malloc(sizes[slot]);
+        if (blocks[slot])
+        {
+            fill_block(blocks[slot], sizes[slot], slot);
+        }
+    }
+
+    for (slot = 0; slot < STRESS_SLOTS; ++slot)
+    {
+        if (blocks[slot] && !check_block(blocks[slot], sizes[slot], slot))
+        {
+            atomic_increment(&s_stressErrors);
+        }
+        smp_free(blocks[slot]);
+    }
+}
+
+void smp_malloc_test(void)
+{
+    smp_malloc_stats_t before;
+    smp_malloc_stats_t after;
+    uint32_t workerCount;
+    bool isOk;
+
+    printf("Running the malloc test\n");
+
+#if defined(__linux__)
+    smp_malloc_init(s_hostHeap, s_hostHeap + HOST_HEAP_SIZE);
+#endif
+
+    workerCount = scheduler_start(SCHEDULER_MAX_WORKERS, scheduler_test_cpu_init);
+    printf("  %d worker(s)\n", workerCount);
+
+    smp_malloc_get_stats(&before);
+
+    isOk = test_basic();
+
+    s_stressErrors = 0;
+    parallel_for(0, STRESS_ROUNDS, 1, stress_body, NULL);
+    if (s_stressErrors)
+    {
+        printf("  %d blocks were corrupted\n", s_stressErrors);
+        isOk = false;
+    }
+
+    scheduler_stop();
+
+    smp_malloc_get_stats(&after);
+    if (after.blocksInUse != before.blocksInUse || after.bytesInUse != before.bytesInUse)
+    {
+        printf("  %d blocks leaked\n", after.blocksInUse - before.blocksInUse);
+        isOk = false;
+    }
+
+    smp_malloc_print_stats();
+    printf("Malloc test %s\n", isOk ? "PASSED" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file spinlock_test.c
+ * @brief Stress test of the spinlock family.
+ *
+ * Every worker of the task scheduler hammers the same lock, so this runs on all cores, or
+ * on POSIX threads when built for Linux, see host/Makefile.
+ */
+
+#include <stdio.h>
+#include "utility/spinlock.h"
+#include "utility/scheduler.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Number of lock and unlock pairs done by all workers together.
+#define LOCK_ITERATIONS (20000)
+
+//! @brief Iterations handed to one task.
+#define LOCK_GRAIN (500)
+
+//! @brief Every this many iterations of the reader-writer test is a write.
+#define RW_WRITE_RATIO (8)
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void spinlock_test(void);
+void scheduler_test_cpu_init(uint32_t cpu);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static spinlock_t s_spinlock;
+static ticket_lock_t s_ticketLock;
+static mcs_lock_t s_mcsLock;
+static rw_spinlock_t s_rwLock;
+
+//! @brief Counter incremented without atomics under the lock being tested.
+static volatile uint32_t s_counter;
+
+//! @brief Pair of values written together under the reader-writer lock.
+static volatile uint32_t s_rwFirst;
+static volatile uint32_t s_rwSecond;
+
+//! @brief Number of times a reader saw a torn pair.
+static volatile uint32_t s_rwErrors;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Read-modify-write of the counter, slow enough for an unprotected one to lose updates.
+static void increment_counter(void)
+{
+    uint32_t value = s_counter;
+    s_counter = value + 1;
+}
+
+static void spinlock_body(uint32_t begin, uint32_t end, void * arg)
+{
+    for (; begin < end; ++begin)
+    {
+        spinlock_trylock_backoff(&s_spinlock, kSpinlockWaitForever);
+        increment_counter();
+        spinlock_unlock(&s_spinlock);
+    }
+}
+
+static void ticket_body(uint32_t begin, uint32_t end, void * arg)
+{
+    for (; begin < end; ++begin)
+    {
+        ticket_lock_lock(&s_ticketLock);
+        increment_counter();
+        ticket_lock_unlock(&s_ticketLock);
+    }
+}
+
+static void mcs_body(uint32_t begin, uint32_t end, void * arg)
+{
+    for (; begin < end; ++begin)
+    {
+        mcs_lock_lock(&s_mcsLock);
+        increment_counter();
+        mcs_lock_unlock(&s_mcsLock);
+    }
+}
+
+static void rw_body(uint32_t begin, uint32_t end, void * arg)
+{
+    for (; begin < end; ++begin)
+    {
+        if (begin % RW_WRITE_RATIO == 0)
+        {
+            rw_spinlock_write_lock(&s_rwLock);
+            s_rwFirst = s_rwFirst + 1;
+            increment_counter();
+            s_rwSecond = s_rwSecond + 1;
+            rw_spinlock_write_unlock(&s_rwLock);
+        }
+        else
+        {
+            rw_spinlock_read_lock(&s_rwLock);
+            if (s_rwFirst != s_rwSecond)
+            {
+                ++s_rwErrors;
+            }
+            rw_spinlock_read_unlock(&s_rwLock);
+        }
+    }
+}
+
+//! @brief Run a body on all workers and check that no increment was lost.
+static bool run_lock_test(const char * name, parallel_for_body_t body, uint32_t expected)
+{
+    s_counter = 0;
+    parallel_for(0, LOCK_ITERATIONS, LOCK_GRAIN, body, NULL);
+
+    if (s_counter != expected)
+    {
+        printf("  %s: counter is %d, expected %d\n", name, s_counter, expected);
+        return false;
+    }
+
+    return true;
+}
+
+//! @brief Check the trylock functions from a single worker.
+static bool test_trylocks(void)
+{
+    bool isOk = true;
+
+    ticket_lock_lock(&s_ticketLock);
+    isOk = isOk && ticket_lock_is_locked(&s_ticketLock) && !ticket_lock_trylock(&s_ticketLock);
+    ticket_lock_unlock(&s_ticketLock);
+    isOk = isOk && ticket_lock_trylock(&s_ticketLock);
+    ticket_lock_unlock(&s_ticketLock);
+    isOk = isOk && !ticket_lock_is_locked(&s_ticketLock);
+
+    isOk = isOk && mcs_lock_trylock(&s_mcsLock) && mcs_lock_is_locked(&s_mcsLock);
+    mcs_lock_unlock(&s_mcsLock);
+    isOk = isOk && !mcs_lock_is_locked(&s_mcsLock);
+
+    isOk = isOk && rw_spinlock_read_trylock(&s_rwLock) && rw_spinlock_read_trylock(&s_rwLock);
+    isOk = isOk && !rw_spinlock_write_trylock(&s_rwLock);
+    rw_spinlock_read_unlock(&s_rwLock);
+    rw_spinlock_read_unlock(&s_rwLock);
+    isOk = isOk && rw_spinlock_write_trylock(&s_rwLock) && !rw_spinlock_read_trylock(&s_rwLock);
+    rw_spinlock_write_unlock(&s_rwLock);
+
+    isOk = isOk && spinlock_trylock_backoff(&s_spinlock, kSpinlockNoWait) == 0;
+    isOk = isOk && spinlock_trylock_backoff(&s_spinlock, 100) == 1;
+    spinlock_unlock(&s_spinlock);
+
+    if (!isOk)
+    {
+        printf("  trylock checks failed\n");
+    }
+
+    return isOk;
+}
+
+void spinlock_test(void)
+{
+    uint32_t workerCount;
+    bool isOk;
+
+    printf("Running the spinlock test\n");
+
+    spinlock_init(&s_spinlock);
+    ticket_lock_init(&s_ticketLock);
+    mcs_lock_init(&s_mcsLock);
+    rw_spinlock_init(&s_rwLock);
+    s_rwFirst = 0;
+    s_rwSecond = 0;
+    s_rwErrors = 0;
+
+    workerCount = scheduler_start(SCHEDULER_MAX_WORKERS, scheduler_test_cpu_init);
+    printf("  %d worker(s)\n", workerCount);
+
+    isOk = test_trylocks();
+    isOk = run_lock_test("backoff spinlock", spinlock_body, LOCK_ITERATIONS) && isOk;
+    isOk = run_lock_test("ticket lock", ticket_body, LOCK_ITERATIONS) && isOk;
+    isOk = run_lock_test("mcs lock", mcs_body, LOCK_ITERATIONS) && isOk;
+    isOk = run_lock_test("rw lock", rw_body, LOCK_ITERATIONS / RW_WRITE_RATIO) && isOk;
+
+    scheduler_stop();
+
+    if (s_rwErrors)
+    {
+        printf("  rw lock: readers saw %d torn writes\n", s_rwErrors);
+        isOk = false;
+    }
+
+    spinlock_print_stats("  ticket lock", SPINLOCK_STATS_OF(&s_ticketLock));
+    spinlock_print_stats("  mcs lock", SPINLOCK_STATS_OF(&s_mcsLock));
+    spinlock_print_stats("  rw lock", SPINLOCK_STATS_OF(&s_rwLock));
+
+    printf("Spinlock test %s\n", isOk ? "PASSED" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
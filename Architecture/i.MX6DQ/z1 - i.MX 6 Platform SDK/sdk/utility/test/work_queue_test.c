@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*!
+ * @file work_queue_test.c
+ * @brief Test of the deferred work queues.
+ *
+ * All scheduler workers queue items to core 0 at once, which stresses the lock-free push.
+ * On the target the items run from interrupt exit, on a host from work_run_pending().
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "utility/atomics.h"
+#include "utility/scheduler.h"
+#include "utility/work_queue.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Number of items queued by all workers together.
+#define WORK_ITEM_COUNT (256)
+
+//! @brief Items queued by one task.
+#define WORK_GRAIN (8)
+
+//! @brief Number of times the self-queueing item runs.
+#define REQUEUE_COUNT (100)
+
+//! @brief Time allowed for the queued work to finish, in microseconds.
+#define DRAIN_TIMEOUT_US (1000000)
+
+////////////////////////////////////////////////////////////////////////////////
+// Prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+void work_queue_test(void);
+void scheduler_test_cpu_init(uint32_t cpu);
+int cpu_get_current(void);
+uint64_t time_get_microseconds(void);
+
+////////////////////////////////////////////////////////////////////////////////
+// Variables
+////////////////////////////////////////////////////////////////////////////////
+
+static work_item_t s_items[WORK_ITEM_COUNT];
+
+//! @brief Number of times each item ran.
+static volatile uint32_t s_runCount[WORK_ITEM_COUNT];
+
+//! @brief Number of items run, by any core.
+static volatile int32_t s_executed;
+
+//! @brief Number of items that ran on another core than the one they were queued to.
+static volatile int32_t s_wrongCpu;
+
+static work_item_t s_requeueItem;
+static volatile uint32_t s_requeueCount;
+
+////////////////////////////////////////////////////////////////////////////////
+// Code
+////////////////////////////////////////////////////////////////////////////////
+
+static void count_work(void * arg)
+{
+    uint32_t index = (uint32_t)(uintptr_t)arg;
+
+    ++s_runCount[index];
+    if (cpu_get_current() != 0)
+    {
+        atomic_increment(&s_wrongCpu);
+    }
+    atomic_increment(&s_executed);
+}
+
+static void requeue_work(void * arg)
+{
+    if (++s_requeueCount < REQUEUE_COUNT)
+    {
+        work_queue(&s_requeueItem);
+    }
+}
+
+static void queue_body(uint32_t begin, uint32_t end, void * arg)
+{
+    for (; begin < end; ++begin)
+    {
+        work_queue_on(&s_items[begin], 0);
+    }
+}
+
+//! @brief Run the queue of core 0 until a condition is met or the timeout expires.
+static bool drain(volatile uint32_t * value, uint32_t expected)
+{
+    uint64_t deadline = time_get_microseconds() + DRAIN_TIMEOUT_US;
+
+    while (*value < expected && time_get_microseconds() < deadline)
+    {
+        work_run_pending();
+    }
+    return *value == expected;
+}
+
+void work_queue_test(void)
+{
+    work_stats_t stats;
+    uint32_t workerCount;
+    uint32_t i;
+    bool isOk = true;
+
+    printf("Running the work queue test\n");
+
+    work_queue_init_cpu();
+    work_get_stats(0, &stats);
+    s_executed = 0;
+    s_wrongCpu = 0;
+    for (i = 0; i < WORK_ITEM_COUNT; ++i)
+    {
+        work_item_init(&s_items[i], count_work, (void *)(uintptr_t)i);
+        s_runCount[i] = 0;
+    }
+
+    workerCount = scheduler_start(SCHEDULER_MAX_WORKERS, scheduler_test_cpu_init);
+    printf("  %d worker(s)\n", workerCount);
+
+    parallel_for(0, WORK_ITEM_COUNT, WORK_GRAIN, queue_body, NULL);
+    if (!drain((volatile uint32_t *)&s_executed, WORK_ITEM_COUNT))
+    {
+        printf("  only %d of %d items ran\n", s_executed, WORK_ITEM_COUNT);
+        isOk = false;
+    }
+
+    scheduler_stop();
+
+    for (i = 0; i < WORK_ITEM_COUNT; ++i)
+    {
+        if (s_runCount[i] != 1)
+        {
+            printf("  item %d ran %d times\n", i, s_runCount[i]);
+            isOk = false;
+        }
+    }
+    if (s_wrongCpu)
+    {
+        printf("  %d items ran on the wrong core\n", s_wrongCpu);
+        isOk = false;
+    }
+
+    // More runs than the batch budget, so passes have to stop and pick up again later.
+    s_requeueCount = 0;
+    work_item_init(&s_requeueItem, requeue_work, NULL);
+    work_queue(&s_requeueItem);
+    if (!drain(&s_requeueCount, REQUEUE_COUNT))
+    {
+        printf("  self-queueing item ran %d of %d times\n", s_requeueCount, REQUEUE_COUNT);
+        isOk = false;
+    }
+
+    work_get_stats(0, &stats);
+    printf("  queued %d, executed %d, passes %d, exhausted %d, longest pass %d us\n",
+           stats.queued, stats.executed, stats.passes, stats.exhausted, stats.maxPassTime);
+    if (stats.executed != WORK_ITEM_COUNT + REQUEUE_COUNT || stats.exhausted < REQUEUE_COUNT / WORK_BATCH_BUDGET)
+    {
+        isOk = false;
+    }
+
+    printf("Work queue test %s\n", isOk ? "PASSED" : "FAILED");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2013, Freescale Semiconductor, Inc.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * o Redistributions of source code must retain the above copyright notice, this list
+ *   of conditions and the following disclaimer.
+ *
+ * o Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#if !defined(__WORK_QUEUE_H__)
+#define __WORK_QUEUE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//! @addtogroup work_queue
+//! @{
+
+/*!
+ * @file work_queue.h
+ * @brief Deferred work for interrupt handlers, the bottom halves of drivers.
+ *
+ * An interrupt handler acknowledges its device, queues a work item and returns. Each core has
+ * its own queue. Producers push onto it with a compare and swap, so handlers of any priority
+ * and other cores can queue without taking a lock. The queue of a core is run when the
+ * outermost interrupt handler of that core returns, with IRQs enabled, so the work can be
+ * preempted by any interrupt. It can also be run from thread code with work_run_pending().
+ *
+ * A pass runs at most #WORK_BATCH_BUDGET items and stops after #WORK_TIME_BUDGET_US. Items
+ * left over run #WORK_RESCHEDULE_US later, from the timer service, so a flood of work cannot
+ * starve the interrupted code.
+ *
+ * Built for Linux, each scheduler worker thread stands for a core, and queues are only run
+ * by work_run_pending().
+ */
+
+////////////////////////////////////////////////////////////////////////////////
+// Definitions
+////////////////////////////////////////////////////////////////////////////////
+
+//! @brief Maximum number of cores with a work queue.
+#define WORK_MAX_CPUS (4)
+
+//! @brief Maximum number of items run by one pass of the dispatcher.
+#if !defined(WORK_BATCH_BUDGET)
+#define WORK_BATCH_BUDGET (32)
+#endif
+
+//! @brief Time after which a pass of the dispatcher stops, in microseconds.
+#if !defined(WORK_TIME_BUDGET_US)
+#define WORK_TIME_BUDGET_US (2000)
+#endif
+
+//! @brief Delay before work left over by an exhausted pass runs, in microseconds.
+#if !defined(WORK_RESCHEDULE_US)
+#define WORK_RESCHEDULE_US (100)
+#endif
+
+//! @brief Software interrupt that makes a core run its queue, SW_INTERRUPT_12 by default.
+#if !defined(WORK_SGI)
+#define WORK_SGI (12)
+#endif
+
+//! @brief Function run by a work item.
+typedef void (*work_function_t)(void * arg);
+
+//! @brief A unit of deferred work.
+//!
+//! Items are owned by the caller and usually embedded in a driver's state. An item is in at
+//! most one queue at a time. Use work_item_init() to initialize it.
+typedef struct _work_item {
+    struct _work_item * volatile next;  //!< Next item in the queue.
+    work_function_t function;           //!< Function to run.
+    void * arg;                         //!< Argument passed to the function.
+    volatile uint32_t isQueued;         //!< Set from queueing until the function is called.
+} work_item_t;
+
+//! @brief Statistics of the queue of one core.
+typedef struct _work_stats {
+    uint32_t queued;        //!< Items queued to this core.
+    uint32_t executed;      //!< Items run.
+    uint32_t passes;        //!< Passes of the dispatcher that ran at least one item.
+    uint32_t exhausted;     //!< Passes that stopped on a budget with work left over.
+    uint32_t maxPassTime;   //!< Longest pass in microseconds.
+} work_stats_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// API
+////////////////////////////////////////////////////////////////////////////////
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//! @brief Enable the work queue of the calling core.
+//!
+//! Hooks the dispatcher to interrupt exit and enables #WORK_SGI on the core. platform_init()
+//! calls this for the boot core; other cores call it before work is queued to them.
+void work_queue_init_cpu(void);
+
+//! @brief Initialize a work item.
+void work_item_init(work_item_t * item, work_function_t function, void * arg);
+
+//! @brief Queue an item to the calling core.
+//!
+//! Safe to call from interrupt handlers. From thread code the core is interrupted with
+//! #WORK_SGI to run the item.
+//!
+//! @retval true The item is queued, or was already queued and has not started yet.
+//! @retval false The work queue of the core is not enabled. The caller should do the work
+//!     itself.
+bool work_queue(work_item_t * item);
+
+//! @brief Queue an item to another core.
+//!
+//! The target core is interrupted with #WORK_SGI to run it.
+//!
+//! @param item The item to queue.
+//! @param cpu The core that will run the item.
+//! @retval true The item is queued, or was already queued and has not started yet.
+//! @retval false The work queue of @a cpu is not enabled.
+bool work_queue_on(work_item_t * item, uint32_t cpu);
+
+//! @brief Run the work queued to the calling core.
+//!
+//! Runs one pass of the dispatcher, within the budgets. Does nothing if the dispatcher is
+//! already running on the core further down the stack.
+//!
+//! @return The number of items run.
+uint32_t work_run_pending(void);
+
+//! @brief Returns whether the calling core has queued work.
+bool work_has_pending(void);
+
+//! @brief Read and clear the statistics of a core.
+void work_get_stats(uint32_t cpu, work_stats_t * stats);
+
+#if defined(__cplusplus)
+}
+#endif
+
+//! @}
+
+#endif // __WORK_QUEUE_H__
+////////////////////////////////////////////////////////////////////////////////
+// EOF
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,119 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2013, Freescale Semiconductor, Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification,
+# are permitted provided that the following conditions are met:
+#
+# o Redistributions of source code must retain the above copyright notice, this list
+#   of conditions and the following disclaimer.
+#
+# o Redistributions in binary form must reproduce the above copyright notice, this
+#   list of conditions and the following disclaimer in the documentation and/or
+#   other materials provided with the distribution.
+#
+# o Neither the name of Freescale Semiconductor, Inc. nor the names of its
+#   contributors may be used to endorse or promote products derived from this
+#   software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+# WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+# DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+# ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+# (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+# LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+# ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+"""Summarize the output of profile_dump() per function.
+
+Usage: profile_report.py [--nm arm-none-eabi-nm] [--top N] app.elf console.log
+
+The console log may contain other output; only the lines between the first
+"# profile" line and the following "# end" line are used. Samples are attributed
+to the function whose symbol precedes the start address of their histogram
+bucket.
+"""
+
+import bisect
+import subprocess
+import sys
+from collections import defaultdict
+from optparse import OptionParser
+
+
+def read_symbols(nm, elf):
+    """Return sorted lists of text symbol addresses and names."""
+    output = subprocess.check_output([nm, '-n', '--defined-only', elf])
+    addresses = []
+    names = []
+    for line in output.decode('ascii', 'replace').splitlines():
+        fields = line.split()
+        if len(fields) != 3 or fields[1] not in 'TtWw':
+            continue
+        # Skip ARM mapping symbols such as $a, $t and $d.
+        if fields[2].startswith('$'):
+            continue
+        addresses.append(int(fields[0], 16) & ~1)
+        names.append(fields[2])
+    return addresses, names
+
+
+def read_profile(log):
+    """Return the header lines and a dict of per-cpu {address: count}."""
+    headers = []
+    histograms = defaultdict(dict)
+    cpu = None
+    inside = False
+    for line in open(log):
+        line = line.strip()
+        if line.startswith('# profile'):
+            inside = True
+        if not inside:
+            continue
+        if line == '# end':
+            break
+        if line.startswith('#'):
+            headers.append(line)
+            fields = line.split()
+            if len(fields) > 2 and fields[1] == 'cpu':
+                cpu = int(fields[2])
+        elif line.startswith('0x') and cpu is not None:
+            address, count = line.split()
+            histograms[cpu][int(address, 16)] = int(count)
+    return headers, histograms
+
+
+def main():
+    parser = OptionParser(usage='%prog [options] app.elf console.log')
+    parser.add_option('--nm', default='arm-none-eabi-nm', help='nm program for the ELF file')
+    parser.add_option('--top', type='int', default=20, help='number of functions to list')
+    options, args = parser.parse_args()
+    if len(args) != 2:
+        parser.error('expected an ELF file and a console log')
+
+    addresses, names = read_symbols(options.nm, args[0])
+    headers, histograms = read_profile(args[1])
+    for line in headers:
+        print(line)
+
+    for cpu in sorted(histograms):
+        functions = defaultdict(int)
+        total = 0
+        for address, count in histograms[cpu].items():
+            index = bisect.bisect_right(addresses, address) - 1
+            functions[names[index] if index >= 0 else '<unknown>'] += count
+            total += count
+        print('')
+        print('cpu %d: %d samples' % (cpu, total))
+        ranked = sorted(functions.items(), key=lambda item: item[1], reverse=True)
+        for name, count in ranked[:options.top]:
+            print('  %6.2f%% %8d  %s' % (100.0 * count / total, count, name))
+
+
+if __name__ == '__main__':
+    main()